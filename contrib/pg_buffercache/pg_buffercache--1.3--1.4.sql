@@ -0,0 +1,28 @@
+/* contrib/pg_buffercache/pg_buffercache--1.3--1.4.sql */
+
+-- complain if script is sourced in psql, rather than via ALTER EXTENSION
+\echo Use "ALTER EXTENSION pg_buffercache UPDATE TO '1.4'" to load this file. \quit
+
+-- Register the function.
+CREATE FUNCTION pg_buffercache_tiers(
+	OUT tier text,
+	OUT buffers int8,
+	OUT admitted int8,
+	OUT promoted int8,
+	OUT demoted int8,
+	OUT evicted int8
+)
+RETURNS SETOF RECORD
+AS 'MODULE_PATHNAME', 'pg_buffercache_tiers'
+LANGUAGE C PARALLEL SAFE;
+
+-- Create a view for convenient access.
+CREATE VIEW pg_buffercache_tiers AS
+	SELECT * FROM pg_buffercache_tiers();
+
+-- Don't want these to be available to public.
+REVOKE ALL ON FUNCTION pg_buffercache_tiers() FROM PUBLIC;
+REVOKE ALL ON pg_buffercache_tiers FROM PUBLIC;
+
+GRANT EXECUTE ON FUNCTION pg_buffercache_tiers() TO pg_monitor;
+GRANT SELECT ON pg_buffercache_tiers TO pg_monitor;
@@ -0,0 +1,29 @@
+/* contrib/pg_buffercache/pg_buffercache--1.4--1.5.sql */
+
+-- complain if script is sourced in psql, rather than via ALTER EXTENSION
+\echo Use "ALTER EXTENSION pg_buffercache UPDATE TO '1.5'" to load this file. \quit
+
+-- Register the function.
+CREATE FUNCTION pg_buffercache_numa(
+	OUT node int4,
+	OUT numa_node int4,
+	OUT buffers int8,
+	OUT hits int8,
+	OUT remote_hits int8,
+	OUT misses int8,
+	OUT remote_misses int8
+)
+RETURNS SETOF RECORD
+AS 'MODULE_PATHNAME', 'pg_buffercache_numa'
+LANGUAGE C PARALLEL SAFE;
+
+-- Create a view for convenient access.
+CREATE VIEW pg_buffercache_numa AS
+	SELECT * FROM pg_buffercache_numa();
+
+-- Don't want these to be available to public.
+REVOKE ALL ON FUNCTION pg_buffercache_numa() FROM PUBLIC;
+REVOKE ALL ON pg_buffercache_numa FROM PUBLIC;
+
+GRANT EXECUTE ON FUNCTION pg_buffercache_numa() TO pg_monitor;
+GRANT SELECT ON pg_buffercache_numa TO pg_monitor;
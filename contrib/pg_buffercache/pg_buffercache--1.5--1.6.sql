@@ -0,0 +1,31 @@
+/* contrib/pg_buffercache/pg_buffercache--1.5--1.6.sql */
+
+-- complain if script is sourced in psql, rather than via ALTER EXTENSION
+\echo Use "ALTER EXTENSION pg_buffercache UPDATE TO '1.6'" to load this file. \quit
+
+-- Register the function.
+CREATE FUNCTION pg_buffercache_compressed(
+	OUT partition int4,
+	OUT pages int8,
+	OUT bytes int8,
+	OUT capacity int8,
+	OUT hits int8,
+	OUT misses int8,
+	OUT stored int8,
+	OUT rejected int8,
+	OUT evicted int8
+)
+RETURNS SETOF RECORD
+AS 'MODULE_PATHNAME', 'pg_buffercache_compressed'
+LANGUAGE C PARALLEL SAFE;
+
+-- Create a view for convenient access.
+CREATE VIEW pg_buffercache_compressed AS
+	SELECT * FROM pg_buffercache_compressed();
+
+-- Don't want these to be available to public.
+REVOKE ALL ON FUNCTION pg_buffercache_compressed() FROM PUBLIC;
+REVOKE ALL ON pg_buffercache_compressed FROM PUBLIC;
+
+GRANT EXECUTE ON FUNCTION pg_buffercache_compressed() TO pg_monitor;
+GRANT SELECT ON pg_buffercache_compressed TO pg_monitor;
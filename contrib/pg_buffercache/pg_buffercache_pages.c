@@ -11,12 +11,17 @@
 #include "access/htup_details.h"
 #include "catalog/pg_type.h"
 #include "funcapi.h"
+#include "miscadmin.h"
 #include "storage/buf_internals.h"
 #include "storage/bufmgr.h"
+#include "utils/builtins.h"
 
 
 #define NUM_BUFFERCACHE_PAGES_MIN_ELEM	8
 #define NUM_BUFFERCACHE_PAGES_ELEM	9
+#define NUM_BUFFERCACHE_TIERS_ELEM	6
+#define NUM_BUFFERCACHE_NUMA_ELEM	7
+#define NUM_BUFFERCACHE_COMPRESSED_ELEM	9
 
 PG_MODULE_MAGIC;
 
@@ -237,3 +242,223 @@ pg_buffercache_pages(PG_FUNCTION_ARGS)
 	else
 		SRF_RETURN_DONE(funcctx);
 }
+
+/*
+ * Function returning statistics about the tiers of the buffer replacement
+ * policy, one row per tier.
+ */
+PG_FUNCTION_INFO_V1(pg_buffercache_tiers);
+
+Datum
+pg_buffercache_tiers(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	BufferTierStats stats[NUM_BUF_TIERS];
+	static const char *const tier_names[NUM_BUF_TIERS] = {
+		"probation",				/* BUF_TIER_PROBATION */
+		"protected"					/* BUF_TIER_PROTECTED */
+	};
+	int			i;
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not " \
+						"allowed in this context")));
+
+	/* Switch into long-lived context to construct returned data structures */
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+	if (tupdesc->natts != NUM_BUFFERCACHE_TIERS_ELEM)
+		elog(ERROR, "incorrect number of output arguments");
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	StrategyGetTierStats(stats);
+
+	for (i = 0; i < NUM_BUF_TIERS; i++)
+	{
+		Datum		values[NUM_BUFFERCACHE_TIERS_ELEM];
+		bool		nulls[NUM_BUFFERCACHE_TIERS_ELEM];
+
+		memset(nulls, 0, sizeof(nulls));
+		values[0] = CStringGetTextDatum(tier_names[i]);
+		values[1] = Int64GetDatum((int64) stats[i].buffers);
+		values[2] = Int64GetDatum((int64) stats[i].admitted);
+		values[3] = Int64GetDatum((int64) stats[i].promoted);
+		values[4] = Int64GetDatum((int64) stats[i].demoted);
+		values[5] = Int64GetDatum((int64) stats[i].evicted);
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	/* clean up and return the tuplestore */
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
+
+/*
+ * Function returning statistics about the buffer nodes shared buffers are
+ * divided into, one row per buffer node.
+ */
+PG_FUNCTION_INFO_V1(pg_buffercache_numa);
+
+Datum
+pg_buffercache_numa(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	BufferNodeStats stats[MAX_BUFFER_NODES];
+	int			nnodes;
+	int			i;
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not " \
+						"allowed in this context")));
+
+	/* Switch into long-lived context to construct returned data structures */
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+	if (tupdesc->natts != NUM_BUFFERCACHE_NUMA_ELEM)
+		elog(ERROR, "incorrect number of output arguments");
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	nnodes = StrategyGetNodeStats(stats);
+
+	for (i = 0; i < nnodes; i++)
+	{
+		Datum		values[NUM_BUFFERCACHE_NUMA_ELEM];
+		bool		nulls[NUM_BUFFERCACHE_NUMA_ELEM];
+
+		memset(nulls, 0, sizeof(nulls));
+		values[0] = Int32GetDatum(i);
+		if (stats[i].numaNode >= 0)
+			values[1] = Int32GetDatum(stats[i].numaNode);
+		else
+			nulls[1] = true;
+		values[2] = Int64GetDatum((int64) stats[i].buffers);
+		values[3] = Int64GetDatum((int64) stats[i].hits);
+		values[4] = Int64GetDatum((int64) stats[i].remoteHits);
+		values[5] = Int64GetDatum((int64) stats[i].misses);
+		values[6] = Int64GetDatum((int64) stats[i].remoteMisses);
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	/* clean up and return the tuplestore */
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
+
+/*
+ * Function returning statistics about the compressed buffer tier, one row
+ * per partition.  Returns no rows if the tier is disabled.
+ */
+PG_FUNCTION_INFO_V1(pg_buffercache_compressed);
+
+Datum
+pg_buffercache_compressed(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	CompressedBufferPartitionStats stats[NUM_CBUF_PARTITIONS];
+	int			nparts;
+	int			i;
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not " \
+						"allowed in this context")));
+
+	/* Switch into long-lived context to construct returned data structures */
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+	if (tupdesc->natts != NUM_BUFFERCACHE_COMPRESSED_ELEM)
+		elog(ERROR, "incorrect number of output arguments");
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	nparts = CompressedBufferStats(stats);
+
+	for (i = 0; i < nparts; i++)
+	{
+		Datum		values[NUM_BUFFERCACHE_COMPRESSED_ELEM];
+		bool		nulls[NUM_BUFFERCACHE_COMPRESSED_ELEM];
+
+		memset(nulls, 0, sizeof(nulls));
+		values[0] = Int32GetDatum(i);
+		values[1] = Int64GetDatum((int64) stats[i].pages);
+		values[2] = Int64GetDatum((int64) stats[i].bytes);
+		values[3] = Int64GetDatum((int64) stats[i].capacity);
+		values[4] = Int64GetDatum((int64) stats[i].hits);
+		values[5] = Int64GetDatum((int64) stats[i].misses);
+		values[6] = Int64GetDatum((int64) stats[i].stored);
+		values[7] = Int64GetDatum((int64) stats[i].rejected);
+		values[8] = Int64GetDatum((int64) stats[i].evicted);
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	/* clean up and return the tuplestore */
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
@@ -0,0 +1,25 @@
+CREATE EXTENSION pg_buffercache;
+
+-- one row per buffer
+SELECT count(*) = (SELECT setting::bigint
+                   FROM pg_settings
+                   WHERE name = 'shared_buffers') AS all_buffers
+FROM pg_buffercache;
+
+-- a relation's pages are found in its buffers
+CREATE TABLE pgbc_tab (a int);
+INSERT INTO pgbc_tab SELECT generate_series(1, 1000);
+SELECT count(*) > 0 AS cached FROM pg_buffercache
+  WHERE relfilenode = pg_relation_filenode('pgbc_tab') AND relforknumber = 0;
+DROP TABLE pgbc_tab;
+
+-- only superusers and members of pg_monitor may look
+CREATE ROLE regress_pgbc_user;
+SET ROLE regress_pgbc_user;
+SELECT count(*) FROM pg_buffercache;
+RESET ROLE;
+GRANT pg_monitor TO regress_pgbc_user;
+SET ROLE regress_pgbc_user;
+SELECT count(*) > 0 AS visible FROM pg_buffercache;
+RESET ROLE;
+DROP ROLE regress_pgbc_user;
@@ -0,0 +1,50 @@
+--
+-- Buffer nodes, divided by debug_buffer_nodes without NUMA placement
+--
+SHOW debug_buffer_nodes;
+
+-- the view comes with version 1.5
+DROP EXTENSION pg_buffercache;
+CREATE EXTENSION pg_buffercache VERSION '1.4';
+ALTER EXTENSION pg_buffercache UPDATE TO '1.5';
+SELECT extversion FROM pg_extension WHERE extname = 'pg_buffercache';
+
+SELECT node, numa_node, buffers FROM pg_buffercache_numa ORDER BY node;
+
+-- every buffer is in one node
+SELECT sum(buffers) = (SELECT setting::bigint
+                       FROM pg_settings
+                       WHERE name = 'shared_buffers') AS all_buffers
+FROM pg_buffercache_numa;
+
+-- One row per page, in a table three times as large as shared buffers
+CREATE TABLE pgbc_numa (id int, filler text) WITH (fillfactor = 10);
+INSERT INTO pgbc_numa SELECT g, repeat('x', 500) FROM generate_series(0, 383) g;
+
+CREATE TEMP TABLE pgbc_numa_before AS SELECT * FROM pg_buffercache_numa;
+
+-- Read each page twice in a row, without a buffer access strategy: a miss,
+-- then a hit.  The backend prefers one node, but takes free buffers from the
+-- others too, and once its node's clock sweep is a pass ahead of theirs,
+-- evicts from them; those count as remote misses.
+DO $$
+BEGIN
+  FOR b IN 0..383 LOOP
+    PERFORM FROM pgbc_numa WHERE ctid = format('(%s,1)', b)::tid;
+    PERFORM FROM pgbc_numa WHERE ctid = format('(%s,1)', b)::tid;
+  END LOOP;
+END
+$$;
+
+SELECT n.node,
+       n.misses + n.remote_misses > b.misses + b.remote_misses AS missed
+FROM pg_buffercache_numa n JOIN pgbc_numa_before b USING (node)
+ORDER BY node;
+SELECT sum(n.remote_misses) > sum(b.remote_misses) AS remote_missed,
+       sum(n.hits + n.remote_hits) > sum(b.hits + b.remote_hits) AS hit
+FROM pg_buffercache_numa n JOIN pgbc_numa_before b USING (node);
+
+DROP TABLE pgbc_numa;
+
+ALTER EXTENSION pg_buffercache UPDATE;
+SELECT extversion FROM pg_extension WHERE extname = 'pg_buffercache';
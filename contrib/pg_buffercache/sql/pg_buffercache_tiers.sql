@@ -0,0 +1,50 @@
+--
+-- Buffer tiers of the 2Q replacement policy
+--
+SHOW buffer_replacement_policy;
+
+SELECT tier FROM pg_buffercache_tiers;
+
+-- every buffer is in one tier
+SELECT sum(buffers) = (SELECT setting::bigint
+                       FROM pg_settings
+                       WHERE name = 'shared_buffers') AS all_buffers
+FROM pg_buffercache_tiers;
+
+-- One row per page, in a table three times as large as shared buffers
+CREATE TABLE pgbc_cold (id int, filler text) WITH (fillfactor = 10);
+INSERT INTO pgbc_cold SELECT g, repeat('x', 500) FROM generate_series(0, 383) g;
+
+CREATE TEMP TABLE pgbc_tiers_before AS SELECT * FROM pg_buffercache_tiers;
+
+-- Read each page once, without a buffer access strategy.  That evicts the
+-- pages that were read first again, and remembers them in ghost entries.
+-- Then read the pages in the opposite order: the ones evicted last are
+-- read back soon enough to be admitted to the protected tier.
+DO $$
+BEGIN
+  FOR b IN 0..383 LOOP
+    PERFORM FROM pgbc_cold WHERE ctid = format('(%s,1)', b)::tid;
+  END LOOP;
+  FOR b IN REVERSE 383..0 LOOP
+    PERFORM FROM pgbc_cold WHERE ctid = format('(%s,1)', b)::tid;
+  END LOOP;
+END
+$$;
+
+-- Pages used more than once, such as catalog pages, have been promoted
+SELECT t.tier,
+       t.admitted > b.admitted AS admitted,
+       t.promoted > b.promoted AS promoted
+FROM pg_buffercache_tiers t JOIN pgbc_tiers_before b USING (tier)
+ORDER BY tier;
+SELECT t.evicted > b.evicted AS evicted
+FROM pg_buffercache_tiers t JOIN pgbc_tiers_before b USING (tier)
+WHERE tier = 'probation';
+
+SELECT sum(buffers) = (SELECT setting::bigint
+                       FROM pg_settings
+                       WHERE name = 'shared_buffers') AS all_buffers
+FROM pg_buffercache_tiers;
+
+DROP TABLE pgbc_cold;
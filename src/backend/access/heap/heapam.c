@@ -70,6 +70,7 @@
 #include "utils/datum.h"
 #include "utils/inval.h"
 #include "utils/lsyscache.h"
+#include "utils/memutils.h"
 #include "utils/relcache.h"
 #include "utils/snapmgr.h"
 #include "utils/syscache.h"
@@ -92,6 +93,12 @@ static HeapScanDesc heap_beginscan_internal(Relation relation,
 						bool temp_snap);
 static void heap_parallelscan_startblock_init(HeapScanDesc scan);
 static BlockNumber heap_parallelscan_nextpage(HeapScanDesc scan);
+static void heap_scan_begin_stream(HeapScanDesc scan);
+static void heap_scan_end_stream(HeapScanDesc scan);
+static BlockNumber heap_scan_stream_next(ReadStream *stream,
+					  void *callback_private_data,
+					  void *per_buffer_data);
+static BlockNumber heap_scan_next_parallel_page(HeapScanDesc scan);
 static HeapTuple heap_prepare_insert(Relation relation, HeapTuple tup,
 					TransactionId xid, CommandId cid, int options);
 static XLogRecPtr log_heap_update(Relation reln, Buffer oldbuf,
@@ -371,9 +378,34 @@ heapgetpage(HeapScanDesc scan, BlockNumber page)
 	 */
 	CHECK_FOR_INTERRUPTS();
 
-	/* read page using selected strategy */
-	scan->rs_cbuf = ReadBufferExtended(scan->rs_rd, MAIN_FORKNUM, page,
-									   RBM_NORMAL, scan->rs_strategy);
+	/*
+	 * Read page using selected strategy.  In a forward scan, the page comes
+	 * from the read stream; a parallel scan has already taken it out.  If
+	 * it's not the page the stream expected, the scan isn't moving forward
+	 * after all, so stop reading ahead.
+	 */
+	if (BufferIsValid(scan->rs_nextbuf))
+	{
+		Assert(BufferGetBlockNumber(scan->rs_nextbuf) == page);
+		scan->rs_cbuf = scan->rs_nextbuf;
+		scan->rs_nextbuf = InvalidBuffer;
+	}
+	else if (scan->rs_read_stream != NULL && scan->rs_parallel == NULL)
+	{
+		scan->rs_cbuf = read_stream_next_buffer(scan->rs_read_stream, NULL);
+		if (!BufferIsValid(scan->rs_cbuf) ||
+			BufferGetBlockNumber(scan->rs_cbuf) != page)
+		{
+			if (BufferIsValid(scan->rs_cbuf))
+				ReleaseBuffer(scan->rs_cbuf);
+			heap_scan_end_stream(scan);
+			scan->rs_cbuf = ReadBufferExtended(scan->rs_rd, MAIN_FORKNUM, page,
+											   RBM_NORMAL, scan->rs_strategy);
+		}
+	}
+	else
+		scan->rs_cbuf = ReadBufferExtended(scan->rs_rd, MAIN_FORKNUM, page,
+										   RBM_NORMAL, scan->rs_strategy);
 	scan->rs_cblock = page;
 
 	if (!scan->rs_pageatatime)
@@ -454,6 +486,109 @@ heapgetpage(HeapScanDesc scan, BlockNumber page)
 	scan->rs_ntuples = ntup;
 }
 
+/*
+ * heap_scan_begin_stream - start reading ahead for a forward scan
+ *
+ * The stream returns the pages in the order heapgettup() visits them, see
+ * heap_scan_stream_next.  It's allocated in the scan descriptor's memory
+ * context, since it must survive as long as the scan.
+ */
+static void
+heap_scan_begin_stream(HeapScanDesc scan)
+{
+	MemoryContext oldcxt;
+
+	Assert(scan->rs_read_stream == NULL);
+
+	/* A single page can't be read ahead of anything */
+	if (scan->rs_nblocks < 2)
+		return;
+
+	scan->rs_stream_block = scan->rs_startblock;
+	if (scan->rs_numblocks != InvalidBlockNumber)
+		scan->rs_stream_left = Min(scan->rs_numblocks, scan->rs_nblocks);
+	else
+		scan->rs_stream_left = scan->rs_nblocks;
+
+	oldcxt = MemoryContextSwitchTo(GetMemoryChunkContext(scan));
+	scan->rs_read_stream = read_stream_begin_relation(scan->rs_rd,
+													  MAIN_FORKNUM,
+													  scan->rs_strategy,
+													  heap_scan_stream_next,
+													  scan,
+													  0);
+	MemoryContextSwitchTo(oldcxt);
+}
+
+/*
+ * heap_scan_end_stream - stop reading ahead, releasing the pages read ahead
+ */
+static void
+heap_scan_end_stream(HeapScanDesc scan)
+{
+	if (BufferIsValid(scan->rs_nextbuf))
+	{
+		ReleaseBuffer(scan->rs_nextbuf);
+		scan->rs_nextbuf = InvalidBuffer;
+	}
+	if (scan->rs_read_stream != NULL)
+	{
+		read_stream_end(scan->rs_read_stream);
+		scan->rs_read_stream = NULL;
+	}
+}
+
+/*
+ * heap_scan_stream_next - read stream callback for forward heap scans
+ *
+ * A parallel scan's pages are claimed here, as they're read ahead; see
+ * heap_scan_next_parallel_page.  Otherwise, we go from rs_startblock to the
+ * end of the relation, and then wrap around, like heapgettup().
+ */
+static BlockNumber
+heap_scan_stream_next(ReadStream *stream, void *callback_private_data,
+					  void *per_buffer_data)
+{
+	HeapScanDesc scan = (HeapScanDesc) callback_private_data;
+	BlockNumber page;
+
+	if (scan->rs_parallel != NULL)
+		return heap_parallelscan_nextpage(scan);
+
+	if (scan->rs_stream_left == 0)
+		return InvalidBlockNumber;
+
+	page = scan->rs_stream_block++;
+	if (scan->rs_stream_block >= scan->rs_nblocks)
+		scan->rs_stream_block = 0;
+	scan->rs_stream_left--;
+
+	return page;
+}
+
+/*
+ * heap_scan_next_parallel_page - get the next page of a parallel scan
+ *
+ * If we're reading ahead, the page has already been claimed by the read
+ * stream; its buffer is kept in rs_nextbuf for heapgetpage().
+ */
+static BlockNumber
+heap_scan_next_parallel_page(HeapScanDesc scan)
+{
+	Buffer		buffer;
+
+	if (scan->rs_read_stream == NULL)
+		return heap_parallelscan_nextpage(scan);
+
+	Assert(!BufferIsValid(scan->rs_nextbuf));
+	buffer = read_stream_next_buffer(scan->rs_read_stream, NULL);
+	if (!BufferIsValid(buffer))
+		return InvalidBlockNumber;
+
+	scan->rs_nextbuf = buffer;
+	return BufferGetBlockNumber(buffer);
+}
+
 /* ----------------
  *		heapgettup - fetch next heap tuple
  *
@@ -513,19 +648,24 @@ heapgettup(HeapScanDesc scan,
 			if (scan->rs_parallel != NULL)
 			{
 				heap_parallelscan_startblock_init(scan);
+				heap_scan_begin_stream(scan);
 
-				page = heap_parallelscan_nextpage(scan);
+				page = heap_scan_next_parallel_page(scan);
 
 				/* Other processes might have already finished the scan. */
 				if (page == InvalidBlockNumber)
 				{
 					Assert(!BufferIsValid(scan->rs_cbuf));
+					heap_scan_end_stream(scan);
 					tuple->t_data = NULL;
 					return;
 				}
 			}
 			else
+			{
+				heap_scan_begin_stream(scan);
 				page = scan->rs_startblock; /* first page */
+			}
 			heapgetpage(scan, page);
 			lineoff = FirstOffsetNumber;	/* first offnum */
 			scan->rs_inited = true;
@@ -706,7 +846,7 @@ heapgettup(HeapScanDesc scan,
 		}
 		else if (scan->rs_parallel != NULL)
 		{
-			page = heap_parallelscan_nextpage(scan);
+			page = heap_scan_next_parallel_page(scan);
 			finished = (page == InvalidBlockNumber);
 		}
 		else
@@ -742,6 +882,7 @@ heapgettup(HeapScanDesc scan,
 				ReleaseBuffer(scan->rs_cbuf);
 			scan->rs_cbuf = InvalidBuffer;
 			scan->rs_cblock = InvalidBlockNumber;
+			heap_scan_end_stream(scan);
 			tuple->t_data = NULL;
 			scan->rs_inited = false;
 			return;
@@ -817,19 +958,24 @@ heapgettup_pagemode(HeapScanDesc scan,
 			if (scan->rs_parallel != NULL)
 			{
 				heap_parallelscan_startblock_init(scan);
+				heap_scan_begin_stream(scan);
 
-				page = heap_parallelscan_nextpage(scan);
+				page = heap_scan_next_parallel_page(scan);
 
 				/* Other processes might have already finished the scan. */
 				if (page == InvalidBlockNumber)
 				{
 					Assert(!BufferIsValid(scan->rs_cbuf));
+					heap_scan_end_stream(scan);
 					tuple->t_data = NULL;
 					return;
 				}
 			}
 			else
+			{
+				heap_scan_begin_stream(scan);
 				page = scan->rs_startblock; /* first page */
+			}
 			heapgetpage(scan, page);
 			lineindex = 0;
 			scan->rs_inited = true;
@@ -996,7 +1142,7 @@ heapgettup_pagemode(HeapScanDesc scan,
 		}
 		else if (scan->rs_parallel != NULL)
 		{
-			page = heap_parallelscan_nextpage(scan);
+			page = heap_scan_next_parallel_page(scan);
 			finished = (page == InvalidBlockNumber);
 		}
 		else
@@ -1032,6 +1178,7 @@ heapgettup_pagemode(HeapScanDesc scan,
 				ReleaseBuffer(scan->rs_cbuf);
 			scan->rs_cbuf = InvalidBuffer;
 			scan->rs_cblock = InvalidBlockNumber;
+			heap_scan_end_stream(scan);
 			tuple->t_data = NULL;
 			scan->rs_inited = false;
 			return;
@@ -1475,6 +1622,8 @@ heap_beginscan_internal(Relation relation, Snapshot snapshot,
 	scan->rs_bitmapscan = is_bitmapscan;
 	scan->rs_samplescan = is_samplescan;
 	scan->rs_strategy = NULL;	/* set in initscan */
+	scan->rs_read_stream = NULL;
+	scan->rs_nextbuf = InvalidBuffer;
 	scan->rs_allow_strat = allow_strat;
 	scan->rs_allow_sync = allow_sync;
 	scan->rs_temp_snap = temp_snap;
@@ -1529,6 +1678,7 @@ heap_rescan(HeapScanDesc scan,
 	 */
 	if (BufferIsValid(scan->rs_cbuf))
 		ReleaseBuffer(scan->rs_cbuf);
+	heap_scan_end_stream(scan);
 
 	/*
 	 * reinitialize scan descriptor
@@ -1574,6 +1724,7 @@ heap_endscan(HeapScanDesc scan)
 	 */
 	if (BufferIsValid(scan->rs_cbuf))
 		ReleaseBuffer(scan->rs_cbuf);
+	heap_scan_end_stream(scan);
 
 	/*
 	 * decrement relation reference count and free scan descriptor storage
@@ -2363,6 +2514,9 @@ GetBulkInsertState(void)
 	bistate = (BulkInsertState) palloc(sizeof(BulkInsertStateData));
 	bistate->strategy = GetAccessStrategy(BAS_BULKWRITE);
 	bistate->current_buf = InvalidBuffer;
+	bistate->next_free = InvalidBlockNumber;
+	bistate->last_free = InvalidBlockNumber;
+	bistate->extend_blocks = 0;
 	return bistate;
 }
 
@@ -2380,6 +2534,9 @@ FreeBulkInsertState(BulkInsertState bistate)
 
 /*
  * ReleaseBulkInsertStatePin - release a buffer currently held in bistate
+ *
+ * This must be called before using the bistate for another relation, so it
+ * also forgets the pages added in bulk to the previous one.
  */
 void
 ReleaseBulkInsertStatePin(BulkInsertState bistate)
@@ -2387,6 +2544,9 @@ ReleaseBulkInsertStatePin(BulkInsertState bistate)
 	if (bistate->current_buf != InvalidBuffer)
 		ReleaseBuffer(bistate->current_buf);
 	bistate->current_buf = InvalidBuffer;
+	bistate->next_free = InvalidBlockNumber;
+	bistate->last_free = InvalidBlockNumber;
+	bistate->extend_blocks = 0;
 }
 
 
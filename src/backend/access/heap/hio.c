@@ -74,22 +74,34 @@ RelationPutHeapTuple(Relation relation,
 }
 
 /*
- * Read in a buffer, using bulk-insert strategy if bistate isn't NULL.
+ * The first bulk extension adds BULK_EXTEND_MIN_BLOCKS pages, and each one
+ * after that twice as many as the one before, up to BULK_EXTEND_MAX_BLOCKS.
+ */
+#define BULK_EXTEND_MIN_BLOCKS	16
+#define BULK_EXTEND_MAX_BLOCKS	Max((8 * 1024 * 1024) / BLCKSZ, \
+									BULK_EXTEND_MIN_BLOCKS)
+
+
+/*
+ * Read in a buffer in the given mode, using bulk-insert strategy if bistate
+ * isn't NULL.
  */
 static Buffer
 ReadBufferBI(Relation relation, BlockNumber targetBlock,
-			 BulkInsertState bistate)
+			 ReadBufferMode mode, BulkInsertState bistate)
 {
 	Buffer		buffer;
 
 	/* If not bulk-insert, exactly like ReadBuffer */
 	if (!bistate)
-		return ReadBuffer(relation, targetBlock);
+		return ReadBufferExtended(relation, MAIN_FORKNUM, targetBlock,
+								  mode, NULL);
 
 	/* If we have the desired block already pinned, re-pin and return it */
 	if (bistate->current_buf != InvalidBuffer)
 	{
-		if (BufferGetBlockNumber(bistate->current_buf) == targetBlock)
+		if (mode == RBM_NORMAL &&
+			BufferGetBlockNumber(bistate->current_buf) == targetBlock)
 		{
 			IncrBufferRefCount(bistate->current_buf);
 			return bistate->current_buf;
@@ -101,7 +113,7 @@ ReadBufferBI(Relation relation, BlockNumber targetBlock,
 
 	/* Perform a read using the buffer strategy */
 	buffer = ReadBufferExtended(relation, MAIN_FORKNUM, targetBlock,
-								RBM_NORMAL, bistate->strategy);
+								mode, bistate->strategy);
 
 	/* Save the selected block as target for future inserts */
 	IncrBufferRefCount(buffer);
@@ -201,7 +213,7 @@ RelationAddExtraBlocks(Relation relation, BulkInsertState bistate)
 	while (extraBlocks-- >= 0)
 	{
 		/* Ouch - an unnecessary lseek() each time through the loop! */
-		buffer = ReadBufferBI(relation, P_NEW, bistate);
+		buffer = ReadBufferBI(relation, P_NEW, RBM_NORMAL, bistate);
 
 		/* Extend by one page. */
 		LockBuffer(buffer, BUFFER_LOCK_EXCLUSIVE);
@@ -237,6 +249,69 @@ RelationAddExtraBlocks(Relation relation, BulkInsertState bistate)
 	UpdateFreeSpaceMap(relation, firstBlock, blockNum, freespace);
 }
 
+/*
+ * Extend a relation by a large chunk of pages for a bulk insertion, and
+ * return the first of them, pinned and exclusive-locked.
+ *
+ * The pages are zero-filled on disk with a single smgrzeroextend() call,
+ * which usually just allocates the space, rather than being added one by one
+ * through the buffer manager.  They're left uninitialized; whoever first
+ * inserts into one initializes it.  The rest of the pages are remembered in
+ * bistate, so that we use them up before extending again, and if use_fsm
+ * they're recorded in the FSM too, so that concurrent inserters can use
+ * them rather than extending the relation themselves.
+ *
+ * The caller must hold the relation extension lock if needLock; we release
+ * it.
+ */
+static Buffer
+RelationAddBulkBlocks(Relation relation, BulkInsertState bistate,
+					  bool use_fsm, bool needLock)
+{
+	BlockNumber firstBlock;
+	BlockNumber nblocks;
+	Buffer		buffer;
+
+	/* Ramp up the size of the chunks as the insertion goes on */
+	if (bistate->extend_blocks == 0)
+		bistate->extend_blocks = BULK_EXTEND_MIN_BLOCKS;
+	nblocks = bistate->extend_blocks;
+	bistate->extend_blocks = Min(nblocks * 2, BULK_EXTEND_MAX_BLOCKS);
+
+	firstBlock = RelationGetNumberOfBlocks(relation);
+
+	RelationOpenSmgr(relation);
+	smgrzeroextend(relation->rd_smgr, MAIN_FORKNUM, firstBlock, nblocks,
+				   false);
+
+	/*
+	 * Lock the first page before releasing the extension lock, like when
+	 * extending by a single page; see vacuumlazy.c.  It's known to be all
+	 * zeros, so there's no need to read it.
+	 */
+	buffer = ReadBufferBI(relation, firstBlock, RBM_ZERO_AND_LOCK, bistate);
+
+	if (needLock)
+		UnlockRelationForExtension(relation, ExclusiveLock);
+
+	if (nblocks > 1)
+	{
+		bistate->next_free = firstBlock + 1;
+		bistate->last_free = firstBlock + nblocks - 1;
+
+		/*
+		 * All the pages are empty, so they have as much free space as a
+		 * freshly initialized page.
+		 */
+		if (use_fsm)
+			RecordPagesWithFreeSpace(relation, firstBlock + 1, nblocks - 1,
+									 BLCKSZ - SizeOfPageHeaderData -
+									 sizeof(ItemIdData));
+	}
+
+	return buffer;
+}
+
 /*
  * RelationGetBufferForTuple
  *
@@ -307,6 +382,7 @@ RelationGetBufferForTuple(Relation relation, Size len,
 	BlockNumber targetBlock,
 				otherBlock;
 	bool		needLock;
+	bool		bulkExtend;
 
 	len = MAXALIGN(len);		/* be conservative */
 
@@ -396,7 +472,7 @@ loop:
 		if (otherBuffer == InvalidBuffer)
 		{
 			/* easy case */
-			buffer = ReadBufferBI(relation, targetBlock, bistate);
+			buffer = ReadBufferBI(relation, targetBlock, RBM_NORMAL, bistate);
 			if (PageIsAllVisible(BufferGetPage(buffer)))
 				visibilitymap_pin(relation, targetBlock, vmbuffer);
 			LockBuffer(buffer, BUFFER_LOCK_EXCLUSIVE);
@@ -458,11 +534,23 @@ loop:
 								 otherBlock, targetBlock, vmbuffer_other,
 								 vmbuffer);
 
+		/*
+		 * A page that was added to the relation in bulk, but not used since,
+		 * is still uninitialized.  Initialize it now, so that the tuple can
+		 * be inserted.  The insertion's WAL record will initialize it again
+		 * on replay.
+		 */
+		page = BufferGetPage(buffer);
+		if (PageIsNew(page))
+		{
+			PageInit(page, BufferGetPageSize(buffer), 0);
+			MarkBufferDirty(buffer);
+		}
+
 		/*
 		 * Now we can check to see if there's enough free space here. If so,
 		 * we're done.
 		 */
-		page = BufferGetPage(buffer);
 		pageFreeSpace = PageGetHeapFreeSpace(page);
 		if (len + saveFreeSpace <= pageFreeSpace)
 		{
@@ -500,6 +588,23 @@ loop:
 													len + saveFreeSpace);
 	}
 
+	/*
+	 * In a bulk insertion, the tuple fits on any empty page, so first use up
+	 * the pages we've added to the relation in bulk before.  (We don't know
+	 * whether they're still empty, as they're in the FSM too, so they have to
+	 * go through the loop above.)
+	 */
+	bulkExtend = (bistate != NULL && len + saveFreeSpace <= MaxHeapTupleSize);
+	if (bulkExtend && bistate->next_free != InvalidBlockNumber)
+	{
+		targetBlock = bistate->next_free;
+		if (bistate->next_free < bistate->last_free)
+			bistate->next_free++;
+		else
+			bistate->next_free = bistate->last_free = InvalidBlockNumber;
+		goto loop;
+	}
+
 	/*
 	 * Have to extend the relation.
 	 *
@@ -542,41 +647,51 @@ loop:
 			}
 
 			/* Time to bulk-extend. */
-			RelationAddExtraBlocks(relation, bistate);
+			if (!bulkExtend)
+				RelationAddExtraBlocks(relation, bistate);
 		}
 	}
 
-	/*
-	 * In addition to whatever extension we performed above, we always add at
-	 * least one block to satisfy our own request.
-	 *
-	 * XXX This does an lseek - rather expensive - but at the moment it is the
-	 * only way to accurately determine how many blocks are in a relation.  Is
-	 * it worth keeping an accurate file length in shared memory someplace,
-	 * rather than relying on the kernel to do it for us?
-	 */
-	buffer = ReadBufferBI(relation, P_NEW, bistate);
+	if (bulkExtend)
+	{
+		/* Add a large chunk of pages, and take the first one */
+		buffer = RelationAddBulkBlocks(relation, bistate, use_fsm, needLock);
+	}
+	else
+	{
+		/*
+		 * In addition to whatever extension we performed above, we always
+		 * add at least one block to satisfy our own request.
+		 *
+		 * XXX This does an lseek - rather expensive - but at the moment it is
+		 * the only way to accurately determine how many blocks are in a
+		 * relation.  Is it worth keeping an accurate file length in shared
+		 * memory someplace, rather than relying on the kernel to do it for
+		 * us?
+		 */
+		buffer = ReadBufferBI(relation, P_NEW, RBM_NORMAL, bistate);
 
-	/*
-	 * We can be certain that locking the otherBuffer first is OK, since it
-	 * must have a lower page number.
-	 */
-	if (otherBuffer != InvalidBuffer)
-		LockBuffer(otherBuffer, BUFFER_LOCK_EXCLUSIVE);
+		/*
+		 * We can be certain that locking the otherBuffer first is OK, since
+		 * it must have a lower page number.
+		 */
+		if (otherBuffer != InvalidBuffer)
+			LockBuffer(otherBuffer, BUFFER_LOCK_EXCLUSIVE);
 
-	/*
-	 * Now acquire lock on the new page.
-	 */
-	LockBuffer(buffer, BUFFER_LOCK_EXCLUSIVE);
+		/*
+		 * Now acquire lock on the new page.
+		 */
+		LockBuffer(buffer, BUFFER_LOCK_EXCLUSIVE);
 
-	/*
-	 * Release the file-extension lock; it's now OK for someone else to extend
-	 * the relation some more.  Note that we cannot release this lock before
-	 * we have buffer lock on the new page, or we risk a race condition
-	 * against vacuumlazy.c --- see comments therein.
-	 */
-	if (needLock)
-		UnlockRelationForExtension(relation, ExclusiveLock);
+		/*
+		 * Release the file-extension lock; it's now OK for someone else to
+		 * extend the relation some more.  Note that we cannot release this
+		 * lock before we have buffer lock on the new page, or we risk a race
+		 * condition against vacuumlazy.c --- see comments therein.
+		 */
+		if (needLock)
+			UnlockRelationForExtension(relation, ExclusiveLock);
+	}
 
 	/*
 	 * We need to initialize the empty new page.  Double-check that it really
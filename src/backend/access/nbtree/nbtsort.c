@@ -75,6 +75,7 @@
 #include "catalog/index.h"
 #include "miscadmin.h"
 #include "pgstat.h"
+#include "storage/fd.h"
 #include "storage/smgr.h"
 #include "tcop/tcopprot.h"		/* pgrminclude ignore */
 #include "utils/rel.h"
@@ -630,17 +631,24 @@ _bt_blwritepage(BTWriteState *wstate, Page page, BlockNumber blkno)
 	 * zeroes until we come back and overwrite.  This is not logically
 	 * necessary on standard Unix filesystems (unwritten space will read as
 	 * zeroes anyway), but it should help to avoid fragmentation. The dummy
-	 * pages aren't WAL-logged though.
+	 * pages aren't WAL-logged though.  They're written with as few calls as
+	 * possible.
 	 */
 	while (blkno > wstate->btws_pages_written)
 	{
+		char	   *zeropages[PG_IOV_MAX];
+		BlockNumber nzero = Min(blkno - wstate->btws_pages_written,
+								PG_IOV_MAX);
+		int			i;
+
 		if (!wstate->btws_zeropage)
 			wstate->btws_zeropage = (Page) palloc0(BLCKSZ);
+		for (i = 0; i < nzero; i++)
+			zeropages[i] = (char *) wstate->btws_zeropage;
 		/* don't set checksum for all-zero page */
-		smgrextend(wstate->index->rd_smgr, MAIN_FORKNUM,
-				   wstate->btws_pages_written++,
-				   (char *) wstate->btws_zeropage,
-				   true);
+		smgrextendv(wstate->index->rd_smgr, MAIN_FORKNUM,
+					wstate->btws_pages_written, zeropages, nzero, true);
+		wstate->btws_pages_written += nzero;
 	}
 
 	PageSetChecksumInplace(page, blkno);
@@ -105,6 +105,7 @@
 #include "storage/smgr.h"
 #include "utils/builtins.h"
 #include "utils/memutils.h"
+#include "utils/sharedplancache.h"
 #include "utils/timestamp.h"
 
 
@@ -1487,6 +1488,7 @@ FinishPreparedTransaction(const char *gid, bool isCommit)
 	if (hdr->initfileinval)
 		RelationCacheInitFilePreInvalidate();
 	SendSharedInvalidMessages(invalmsgs, hdr->ninvalmsgs);
+	SharedPlanCacheInvalMessages(invalmsgs, hdr->ninvalmsgs);
 	if (hdr->initfileinval)
 		RelationCacheInitFilePostInvalidate();
 
@@ -34,6 +34,8 @@
 #include "access/xact.h"
 #include "access/xlog_internal.h"
 #include "access/xloginsert.h"
+#include "access/xlogprefetch.h"
+#include "access/xlogredo.h"
 #include "access/xlogreader.h"
 #include "access/xlogutils.h"
 #include "catalog/catversion.h"
@@ -96,7 +98,7 @@ char	   *XLogArchiveCommand = NULL;
 bool		EnableHotStandby = false;
 bool		fullPageWrites = true;
 bool		wal_log_hints = false;
-bool		wal_compression = false;
+int			wal_compression = WAL_COMPRESSION_NONE;
 char	   *wal_consistency_checking_string = NULL;
 bool	   *wal_consistency_checking = NULL;
 bool		log_checkpoints = false;
@@ -104,6 +106,7 @@ int			sync_method = DEFAULT_SYNC_METHOD;
 int			wal_level = WAL_LEVEL_MINIMAL;
 int			CommitDelay = 0;	/* precommit delay in microseconds */
 int			CommitSiblings = 5; /* # concurrent xacts needed to sleep */
+bool		wal_group_flush = true;
 int			wal_retrieve_retry_interval = 5000;
 
 #ifdef WAL_DEBUG
@@ -115,9 +118,10 @@ int			wal_segment_size = DEFAULT_XLOG_SEG_SIZE;
 /*
  * Number of WAL insertion locks to use. A higher value allows more insertions
  * to happen concurrently, but adds some CPU overhead to flushing the WAL,
- * which needs to iterate all the locks.
+ * which needs to iterate all the locks, and to WAL-logging operations that
+ * need to hold all of them.
  */
-#define NUM_XLOGINSERT_LOCKS  8
+int			wal_insert_locks = 8;
 
 /*
  * Max distance from last checkpoint, before triggering a new xlog-based
@@ -612,6 +616,19 @@ typedef struct XLogCtlData
 	 */
 	XLogRecPtr	InitializedUpTo;
 
+	/*
+	 * All WAL insertions before this point are known to have finished.  It's
+	 * advanced by WaitXLogInsertionsToFinish(), so that callers that need
+	 * WAL that is already known to be complete don't have to look at every
+	 * insertion lock.  Never goes backwards.
+	 */
+	pg_atomic_uint64 insertsFinishedUpto;
+
+	/*
+	 * Histogram of the sizes of WAL flush groups, see XLogFlushGroup().
+	 */
+	pg_atomic_uint64 flushGroupSizes[NUM_WAL_FLUSH_GROUP_BUCKETS];
+
 	/*
 	 * These values do not change after startup, although the pointed-to pages
 	 * and xlblocks values certainly do.  xlblock values are protected by
@@ -842,6 +859,11 @@ static bool bgwriterLaunched = false;
 static int	MyLockNo = 0;
 static bool holdingAllLocks = false;
 
+/* range of insertion locks WALInsertLockAcquire picks from, see there */
+static int	MyLockGroupNode = -1;
+static int	MyLockGroupFirst = 0;
+static int	MyLockGroupSize = 0;
+
 #ifdef WAL_DEBUG
 static MemoryContext walDebugCxt = NULL;
 #endif
@@ -851,6 +873,7 @@ static void exitArchiveRecovery(TimeLineID endTLI, XLogRecPtr endOfLog);
 static bool recoveryStopsBefore(XLogReaderState *record);
 static bool recoveryStopsAfter(XLogReaderState *record);
 static void recoveryPausesHere(void);
+static void SyncRedoWorkers(void);
 static bool recoveryApplyDelay(XLogReaderState *record);
 static void SetLatestXTime(TimestampTz xtime);
 static void SetCurrentChunkStartTime(TimestampTz xtime);
@@ -867,6 +890,7 @@ static XLogRecPtr XLogGetReplicationSlotMinimumLSN(void);
 static void AdvanceXLInsertBuffer(XLogRecPtr upto, bool opportunistic);
 static bool XLogCheckpointNeeded(XLogSegNo new_segno);
 static void XLogWrite(XLogwrtRqst WriteRqst, bool flexible);
+static void XLogFlushGroup(XLogRecPtr record);
 static bool InstallXLogFileSegment(XLogSegNo *segno, char *tmppath,
 					   bool find_free, XLogSegNo max_segno,
 					   bool use_lock);
@@ -926,6 +950,7 @@ static uint64 XLogRecPtrToBytePos(XLogRecPtr ptr);
 static void checkXLogConsistency(XLogReaderState *record);
 
 static void WALInsertLockAcquire(void);
+static bool WALInsertLockChooseGroup(void);
 static void WALInsertLockAcquireExclusive(void);
 static void WALInsertLockRelease(void);
 static void WALInsertLockUpdateInsertingAt(XLogRecPtr insertingAt);
@@ -995,8 +1020,8 @@ XLogInsertRecord(XLogRecData *rdata,
 	 * To keep track of which insertions are still in-progress, each concurrent
 	 * inserter acquires an insertion lock. In addition to just indicating that
 	 * an insertion is in progress, the lock tells others how far the inserter
-	 * has progressed. There is a small fixed number of insertion locks,
-	 * determined by NUM_XLOGINSERT_LOCKS. When an inserter crosses a page
+	 * has progressed. There is a small number of insertion locks, set by
+	 * wal_insert_locks at server start. When an inserter crosses a page
 	 * boundary, it updates the value stored in the lock to the how far it has
 	 * inserted, to allow the previous buffer to be flushed.
 	 *
@@ -1588,11 +1613,19 @@ WALInsertLockAcquire(void)
 	 * If this is the first time through in this backend, pick a lock
 	 * (semi-)randomly.  This allows the locks to be used evenly if you have a
 	 * lot of very short connections.
+	 *
+	 * When shared buffers are spread over NUMA nodes, the locks are divided
+	 * into one group per node, and we stick to the group of the node we're
+	 * running on, so that the lock's cache line mostly bounces between CPUs
+	 * of the same node.
 	 */
 	static int	lockToTry = -1;
 
 	if (lockToTry == -1)
-		lockToTry = MyProc->pgprocno % NUM_XLOGINSERT_LOCKS;
+	{
+		WALInsertLockChooseGroup();
+		lockToTry = MyLockGroupFirst + MyProc->pgprocno % MyLockGroupSize;
+	}
 	MyLockNo = lockToTry;
 
 	/*
@@ -1609,11 +1642,42 @@ WALInsertLockAcquire(void)
 		 * lock that no-one else is using.  On a system with more inserters
 		 * than locks, it still helps to distribute the inserters evenly
 		 * across the locks.
+		 *
+		 * We might have been moved to another NUMA node since we chose our
+		 * group, so check again while we're at it.  That's a system call,
+		 * but we've just slept anyway.
 		 */
-		lockToTry = (lockToTry + 1) % NUM_XLOGINSERT_LOCKS;
+		if (WALInsertLockChooseGroup())
+			lockToTry = MyLockGroupFirst + MyProc->pgprocno % MyLockGroupSize;
+		else
+			lockToTry = MyLockGroupFirst +
+				(lockToTry - MyLockGroupFirst + 1) % MyLockGroupSize;
 	}
 }
 
+/*
+ * Choose the group of insertion locks WALInsertLockAcquire picks from: the
+ * one of the buffer node of the NUMA node we're running on, or all locks
+ * if shared buffers aren't divided into nodes.  Returns true if the group
+ * changed.
+ */
+static bool
+WALInsertLockChooseGroup(void)
+{
+	int			ngroups = Min(BufferNodeCount(), wal_insert_locks);
+	int			node = 0;
+
+	if (ngroups > 1)
+		node = CurrentBufferNode() % ngroups;
+	if (node == MyLockGroupNode)
+		return false;
+
+	MyLockGroupNode = node;
+	MyLockGroupFirst = node * wal_insert_locks / ngroups;
+	MyLockGroupSize = (node + 1) * wal_insert_locks / ngroups - MyLockGroupFirst;
+	return true;
+}
+
 /*
  * Acquire all WAL insertion locks, to prevent other backends from inserting
  * to WAL.
@@ -1628,7 +1692,7 @@ WALInsertLockAcquireExclusive(void)
 	 * indicator is set to 0xFFFFFFFFFFFFFFFF, which is higher than any real
 	 * XLogRecPtr value, to make sure that no-one blocks waiting on those.
 	 */
-	for (i = 0; i < NUM_XLOGINSERT_LOCKS - 1; i++)
+	for (i = 0; i < wal_insert_locks - 1; i++)
 	{
 		LWLockAcquire(&WALInsertLocks[i].l.lock, LW_EXCLUSIVE);
 		LWLockUpdateVar(&WALInsertLocks[i].l.lock,
@@ -1654,7 +1718,7 @@ WALInsertLockRelease(void)
 	{
 		int			i;
 
-		for (i = 0; i < NUM_XLOGINSERT_LOCKS; i++)
+		for (i = 0; i < wal_insert_locks; i++)
 			LWLockReleaseClearVar(&WALInsertLocks[i].l.lock,
 								  &WALInsertLocks[i].l.insertingAt,
 								  0);
@@ -1682,8 +1746,8 @@ WALInsertLockUpdateInsertingAt(XLogRecPtr insertingAt)
 		 * We use the last lock to mark our actual position, see comments in
 		 * WALInsertLockAcquireExclusive.
 		 */
-		LWLockUpdateVar(&WALInsertLocks[NUM_XLOGINSERT_LOCKS - 1].l.lock,
-						&WALInsertLocks[NUM_XLOGINSERT_LOCKS - 1].l.insertingAt,
+		LWLockUpdateVar(&WALInsertLocks[wal_insert_locks - 1].l.lock,
+						&WALInsertLocks[wal_insert_locks - 1].l.insertingAt,
 						insertingAt);
 	}
 	else
@@ -1713,11 +1777,22 @@ WaitXLogInsertionsToFinish(XLogRecPtr upto)
 	XLogRecPtr	reservedUpto;
 	XLogRecPtr	finishedUpto;
 	XLogCtlInsert *Insert = &XLogCtl->Insert;
+	XLogRecPtr	knownFinishedUpto;
 	int			i;
 
 	if (MyProc == NULL)
 		elog(PANIC, "cannot wait without a PGPROC structure");
 
+	/*
+	 * If an earlier call already found that all insertions up to 'upto'
+	 * have finished, there's nothing to wait for.  That's often the case
+	 * when several backends flush WAL at about the same time, and saves
+	 * looking at all the insertion locks.
+	 */
+	knownFinishedUpto = pg_atomic_read_u64(&XLogCtl->insertsFinishedUpto);
+	if (upto <= knownFinishedUpto)
+		return knownFinishedUpto;
+
 	/* Read the current insert position */
 	SpinLockAcquire(&Insert->insertpos_lck);
 	bytepos = Insert->CurrBytePos;
@@ -1750,7 +1825,7 @@ WaitXLogInsertionsToFinish(XLogRecPtr upto)
 	 * out for any insertion that's still in progress.
 	 */
 	finishedUpto = reservedUpto;
-	for (i = 0; i < NUM_XLOGINSERT_LOCKS; i++)
+	for (i = 0; i < wal_insert_locks; i++)
 	{
 		XLogRecPtr	insertingat = InvalidXLogRecPtr;
 
@@ -1786,6 +1861,15 @@ WaitXLogInsertionsToFinish(XLogRecPtr upto)
 		if (insertingat != InvalidXLogRecPtr && insertingat < finishedUpto)
 			finishedUpto = insertingat;
 	}
+
+	/* Let others know, unless someone has already got further */
+	while (knownFinishedUpto < finishedUpto)
+	{
+		if (pg_atomic_compare_exchange_u64(&XLogCtl->insertsFinishedUpto,
+										   &knownFinishedUpto, finishedUpto))
+			break;
+	}
+
 	return finishedUpto;
 }
 
@@ -2792,6 +2876,13 @@ XLogFlush(XLogRecPtr record)
 
 	START_CRIT_SECTION();
 
+	/*
+	 * Let the leader of a flush group do the flush for us, if enabled.  The
+	 * loop below then normally finds the request satisfied right away.
+	 */
+	if (wal_group_flush)
+		XLogFlushGroup(record);
+
 	/*
 	 * Since fsync is usually a horribly expensive operation, we try to
 	 * piggyback as much data as we can on each fsync: if we see any more data
@@ -2924,6 +3015,193 @@ XLogFlush(XLogRecPtr record)
 			 (uint32) (LogwrtResult.Flush >> 32), (uint32) LogwrtResult.Flush);
 }
 
+/*
+ * Flush WAL up to 'record' together with other backends doing the same.
+ *
+ * Backends that need WAL flushed form a group: the first one to arrive
+ * becomes the leader, and the others add themselves to a list and sleep.
+ * The leader waits for any flush already in progress to complete, which is
+ * when other backends get to join, and then does one flush that covers the
+ * requests of all group members, and wakes them up.  This follows the same
+ * pattern as TransactionGroupUpdateXidStatus() in clog.c, and members sleep
+ * on their semaphores for the same reason: we're in a critical section, and
+ * WaitLatch() can't be used there.
+ *
+ * On return, LogwrtResult is up to date.  It normally covers 'record', but
+ * not if that was past the end of WAL; the caller complains about that.
+ */
+static void
+XLogFlushGroup(XLogRecPtr record)
+{
+	volatile PROC_HDR *procglobal = ProcGlobal;
+	PGPROC	   *proc = MyProc;
+	uint32		nextidx;
+	uint32		wakeidx;
+	XLogRecPtr	groupUpto;
+	XLogRecPtr	WriteRqstPtr;
+	XLogRecPtr	insertpos;
+	XLogwrtRqst WriteRqst;
+	int			groupSize;
+	int			bucket;
+
+	/* Add ourselves to the list of processes needing a flush. */
+	proc->walFlushGroupMember = true;
+	proc->walFlushGroupMemberLsn = record;
+
+	nextidx = pg_atomic_read_u32(&procglobal->walFlushGroupFirst);
+	while (true)
+	{
+		pg_atomic_write_u32(&proc->walFlushGroupNext, nextidx);
+
+		if (pg_atomic_compare_exchange_u32(&procglobal->walFlushGroupFirst,
+										   &nextidx,
+										   (uint32) proc->pgprocno))
+			break;
+	}
+
+	/*
+	 * If the list was not empty, the leader will flush our WAL.  It is
+	 * impossible to have followers without a leader because the first process
+	 * that has added itself to the list will always have nextidx as
+	 * INVALID_PGPROCNO.
+	 */
+	if (nextidx != INVALID_PGPROCNO)
+	{
+		int			extraWaits = 0;
+
+		/* Sleep until the leader has flushed our WAL. */
+		pgstat_report_wait_start(WAIT_EVENT_WAL_FLUSH_GROUP);
+		for (;;)
+		{
+			/* acts as a read barrier */
+			PGSemaphoreLock(proc->sem);
+			if (!proc->walFlushGroupMember)
+				break;
+			extraWaits++;
+		}
+		pgstat_report_wait_end();
+
+		Assert(pg_atomic_read_u32(&proc->walFlushGroupNext) == INVALID_PGPROCNO);
+
+		/* Fix semaphore count for any absorbed wakeups */
+		while (extraWaits-- > 0)
+			PGSemaphoreUnlock(proc->sem);
+
+		SpinLockAcquire(&XLogCtl->info_lck);
+		LogwrtResult = XLogCtl->LogwrtResult;
+		SpinLockRelease(&XLogCtl->info_lck);
+		return;
+	}
+
+	/*
+	 * We are the leader.  If a flush is in progress, wait for it to finish,
+	 * letting the group grow meanwhile.  We can't keep the lock even if we
+	 * get it right away, because we mustn't wait for insertions while
+	 * holding it.
+	 */
+	if (LWLockAcquireOrWait(WALWriteLock, LW_EXCLUSIVE))
+		LWLockRelease(WALWriteLock);
+
+	/*
+	 * Sleep before closing the group, to give further backends the
+	 * opportunity to join it.  As in XLogFlush(), we do not sleep if
+	 * enableFsync is not turned on, nor if there are fewer than
+	 * CommitSiblings other backends with active transactions.
+	 */
+	if (CommitDelay > 0 && enableFsync)
+	{
+		SpinLockAcquire(&XLogCtl->info_lck);
+		LogwrtResult = XLogCtl->LogwrtResult;
+		SpinLockRelease(&XLogCtl->info_lck);
+
+		if (record > LogwrtResult.Flush &&
+			MinimumActiveBackends(CommitSiblings))
+			pg_usleep(CommitDelay);
+	}
+
+	/*
+	 * Now close the group; anyone arriving from now on starts a new one.
+	 * Find out how far we need to flush for all members.
+	 */
+	nextidx = pg_atomic_exchange_u32(&procglobal->walFlushGroupFirst,
+									 INVALID_PGPROCNO);
+
+	/* Remember head of list so we can perform wakeups after the flush. */
+	wakeidx = nextidx;
+
+	groupUpto = InvalidXLogRecPtr;
+	groupSize = 0;
+	while (nextidx != INVALID_PGPROCNO)
+	{
+		PGPROC	   *member = &ProcGlobal->allProcs[nextidx];
+
+		if (groupUpto < member->walFlushGroupMemberLsn)
+			groupUpto = member->walFlushGroupMemberLsn;
+		groupSize++;
+
+		nextidx = pg_atomic_read_u32(&member->walFlushGroupNext);
+	}
+
+	/*
+	 * Flush as XLogFlush() does, piggybacking any other WAL that has been
+	 * requested to be written.
+	 */
+	SpinLockAcquire(&XLogCtl->info_lck);
+	WriteRqstPtr = Max(groupUpto, XLogCtl->LogwrtRqst.Write);
+	LogwrtResult = XLogCtl->LogwrtResult;
+	SpinLockRelease(&XLogCtl->info_lck);
+
+	if (groupUpto > LogwrtResult.Flush)
+	{
+		insertpos = WaitXLogInsertionsToFinish(WriteRqstPtr);
+
+		LWLockAcquire(WALWriteLock, LW_EXCLUSIVE);
+
+		/* Someone else might have flushed it while we waited for the lock */
+		LogwrtResult = XLogCtl->LogwrtResult;
+		if (groupUpto > LogwrtResult.Flush)
+		{
+			WriteRqst.Write = insertpos;
+			WriteRqst.Flush = insertpos;
+
+			XLogWrite(WriteRqst, false);
+		}
+
+		LWLockRelease(WALWriteLock);
+	}
+
+	/* Count the group in the histogram */
+	bucket = 0;
+	for (groupSize--; groupSize > 0; groupSize >>= 1)
+	{
+		if (bucket == NUM_WAL_FLUSH_GROUP_BUCKETS - 1)
+			break;
+		bucket++;
+	}
+	pg_atomic_fetch_add_u64(&XLogCtl->flushGroupSizes[bucket], 1);
+
+	/*
+	 * Now that we've released the lock, go back and wake everybody up.  We
+	 * don't do this under the lock so as to keep lock hold times to a
+	 * minimum.
+	 */
+	while (wakeidx != INVALID_PGPROCNO)
+	{
+		PGPROC	   *member = &ProcGlobal->allProcs[wakeidx];
+
+		wakeidx = pg_atomic_read_u32(&member->walFlushGroupNext);
+		pg_atomic_write_u32(&member->walFlushGroupNext, INVALID_PGPROCNO);
+
+		/* ensure all previous writes are visible before follower continues. */
+		pg_write_barrier();
+
+		member->walFlushGroupMember = false;
+
+		if (member != MyProc)
+			PGSemaphoreUnlock(member->sem);
+	}
+}
+
 /*
  * Write & flush xlog, but without specifying exactly where to.
  *
@@ -4862,7 +5140,7 @@ XLOGShmemSize(void)
 	size = sizeof(XLogCtlData);
 
 	/* WAL insertion locks, plus alignment */
-	size = add_size(size, mul_size(sizeof(WALInsertLockPadded), NUM_XLOGINSERT_LOCKS + 1));
+	size = add_size(size, mul_size(sizeof(WALInsertLockPadded), wal_insert_locks + 1));
 	/* xlblocks array */
 	size = add_size(size, mul_size(sizeof(XLogRecPtr), XLOGbuffers));
 	/* extra alignment padding for XLOG I/O buffers */
@@ -4927,6 +5205,9 @@ XLOGShmemInit(void)
 		return;
 	}
 	memset(XLogCtl, 0, sizeof(XLogCtlData));
+	pg_atomic_init_u64(&XLogCtl->insertsFinishedUpto, 0);
+	for (i = 0; i < NUM_WAL_FLUSH_GROUP_BUCKETS; i++)
+		pg_atomic_init_u64(&XLogCtl->flushGroupSizes[i], 0);
 
 	/*
 	 * Already have read control file locally, unless in bootstrap mode. Move
@@ -4954,10 +5235,10 @@ XLOGShmemInit(void)
 		((uintptr_t) allocptr) % sizeof(WALInsertLockPadded);
 	WALInsertLocks = XLogCtl->Insert.WALInsertLocks =
 		(WALInsertLockPadded *) allocptr;
-	allocptr += sizeof(WALInsertLockPadded) * NUM_XLOGINSERT_LOCKS;
+	allocptr += sizeof(WALInsertLockPadded) * wal_insert_locks;
 
 	LWLockRegisterTranche(LWTRANCHE_WAL_INSERT, "wal_insert");
-	for (i = 0; i < NUM_XLOGINSERT_LOCKS; i++)
+	for (i = 0; i < wal_insert_locks; i++)
 	{
 		LWLockInitialize(&WALInsertLocks[i].l.lock, LWTRANCHE_WAL_INSERT);
 		WALInsertLocks[i].l.insertingAt = InvalidXLogRecPtr;
@@ -5983,6 +6264,9 @@ recoveryPausesHere(void)
 	if (!LocalHotStandbyActive)
 		return;
 
+	/* Let the redo workers finish what they've been given */
+	SyncRedoWorkers();
+
 	ereport(LOG,
 			(errmsg("recovery has paused"),
 			 errhint("Execute pg_wal_replay_resume() to continue.")));
@@ -5994,6 +6278,22 @@ recoveryPausesHere(void)
 	}
 }
 
+/*
+ * Wait until the redo workers have replayed every record handed to them,
+ * and advance lastReplayedEndRecPtr past them.
+ */
+static void
+SyncRedoWorkers(void)
+{
+	if (!ParallelRedoWaitAll())
+		return;
+
+	SpinLockAcquire(&XLogCtl->info_lck);
+	XLogCtl->lastReplayedEndRecPtr = XLogCtl->replayEndRecPtr;
+	XLogCtl->lastReplayedTLI = XLogCtl->replayEndTLI;
+	SpinLockRelease(&XLogCtl->info_lck);
+}
+
 bool
 RecoveryIsPaused(void)
 {
@@ -7055,9 +7355,13 @@ StartupXLOG(void)
 		{
 			ErrorContextCallback errcallback;
 			TimestampTz xtime;
+			XLogPrefetcher *prefetcher;
 
 			InRedo = true;
 
+			/* Prepare to read ahead and prefetch referenced blocks */
+			prefetcher = XLogPrefetcherAllocate(wal_segment_size);
+
 			ereport(LOG,
 					(errmsg("redo starts at %X/%X",
 							(uint32) (ReadRecPtr >> 32), (uint32) ReadRecPtr)));
@@ -7068,6 +7372,7 @@ StartupXLOG(void)
 			do
 			{
 				bool		switchedTLI = false;
+				RedoDisposition redo;
 
 #ifdef WAL_DEBUG
 				if (XLOG_DEBUG ||
@@ -7091,6 +7396,9 @@ StartupXLOG(void)
 				/* Handle interrupt signals of startup process */
 				HandleStartupProcInterrupts();
 
+				/* Start reading blocks that upcoming records will need */
+				XLogPrefetcherReadAhead(prefetcher, xlogreader);
+
 				/*
 				 * Pause WAL replay, if requested by a hot-standby session via
 				 * SetRecoveryPause().
@@ -7198,6 +7506,15 @@ StartupXLOG(void)
 					}
 				}
 
+				/*
+				 * Decide whether a redo worker can replay this record.  If we
+				 * have to replay it ourselves after all records before it,
+				 * wait for the workers first.  See xlogredo.c.
+				 */
+				redo = ParallelRedoClassify(xlogreader);
+				if (redo == REDO_SERIAL)
+					SyncRedoWorkers();
+
 				/*
 				 * Update shared replayEndRecPtr before replaying this record,
 				 * so that XLogFlush will update minRecoveryPoint correctly.
@@ -7215,8 +7532,10 @@ StartupXLOG(void)
 					TransactionIdIsValid(record->xl_xid))
 					RecordKnownAssignedTransactionIds(record->xl_xid);
 
-				/* Now apply the WAL record itself */
-				RmgrTable[record->xl_rmid].rm_redo(xlogreader);
+				/* Now apply the WAL record itself, or have a worker do it */
+				if (redo != REDO_DISPATCH ||
+					!ParallelRedoDispatch(xlogreader))
+					RmgrTable[record->xl_rmid].rm_redo(xlogreader);
 
 				/*
 				 * After redo, check whether the backup pages associated with
@@ -7232,12 +7551,17 @@ StartupXLOG(void)
 
 				/*
 				 * Update lastReplayedEndRecPtr after this record has been
-				 * successfully replayed.
+				 * successfully replayed.  If the redo workers haven't
+				 * replayed all records before it yet, SyncRedoWorkers() will
+				 * do it later.
 				 */
-				SpinLockAcquire(&XLogCtl->info_lck);
-				XLogCtl->lastReplayedEndRecPtr = EndRecPtr;
-				XLogCtl->lastReplayedTLI = ThisTimeLineID;
-				SpinLockRelease(&XLogCtl->info_lck);
+				if (!ParallelRedoPending())
+				{
+					SpinLockAcquire(&XLogCtl->info_lck);
+					XLogCtl->lastReplayedEndRecPtr = EndRecPtr;
+					XLogCtl->lastReplayedTLI = ThisTimeLineID;
+					SpinLockRelease(&XLogCtl->info_lck);
+				}
 
 				/*
 				 * If rm_redo called XLogRequestWalReceiverReply, then we wake
@@ -7289,6 +7613,12 @@ StartupXLOG(void)
 			 * end of main redo apply loop
 			 */
 
+			XLogPrefetcherFree(prefetcher);
+
+			/* Wait for the redo workers to finish, too */
+			SyncRedoWorkers();
+			CheckRecoveryConsistency();
+
 			if (reachedStopPoint)
 			{
 				if (!reachedConsistency)
@@ -8274,7 +8604,7 @@ GetLastImportantRecPtr(void)
 	XLogRecPtr	res = InvalidXLogRecPtr;
 	int			i;
 
-	for (i = 0; i < NUM_XLOGINSERT_LOCKS; i++)
+	for (i = 0; i < wal_insert_locks; i++)
 	{
 		XLogRecPtr	last_important;
 
@@ -10029,10 +10359,19 @@ static int
 get_sync_bit(int method)
 {
 	int			o_direct_flag = 0;
+	int			forced_direct_flag = 0;
+
+	/*
+	 * With io_direct = wal, bypass the kernel cache whatever the sync method;
+	 * the database's own buffering in WAL buffers and the walwriter is relied
+	 * on instead.  Never in walreceiver though, see below.
+	 */
+	if ((io_direct_flags & IO_DIRECT_WAL) && !AmWalReceiverProcess())
+		forced_direct_flag = PG_O_DIRECT;
 
 	/* If fsync is disabled, never open in sync mode */
 	if (!enableFsync)
-		return 0;
+		return forced_direct_flag;
 
 	/*
 	 * Optimize writes by bypassing kernel cache with O_DIRECT when using
@@ -10050,6 +10389,7 @@ get_sync_bit(int method)
 	 */
 	if (!XLogIsNeeded() && !AmWalReceiverProcess())
 		o_direct_flag = PG_O_DIRECT;
+	o_direct_flag |= forced_direct_flag;
 
 	switch (method)
 	{
@@ -10062,7 +10402,7 @@ get_sync_bit(int method)
 		case SYNC_METHOD_FSYNC:
 		case SYNC_METHOD_FSYNC_WRITETHROUGH:
 		case SYNC_METHOD_FDATASYNC:
-			return 0;
+			return forced_direct_flag;
 #ifdef OPEN_SYNC_FLAG
 		case SYNC_METHOD_OPEN:
 			return OPEN_SYNC_FLAG | o_direct_flag;
@@ -11199,6 +11539,19 @@ GetXLogWriteRecPtr(void)
 	return LogwrtResult.Write;
 }
 
+/*
+ * Get the histogram of WAL flush group sizes, see XLogFlushGroup().
+ * 'groups' must have room for NUM_WAL_FLUSH_GROUP_BUCKETS counts.
+ */
+void
+GetWalFlushGroupStats(uint64 *groups)
+{
+	int			i;
+
+	for (i = 0; i < NUM_WAL_FLUSH_GROUP_BUCKETS; i++)
+		groups[i] = pg_atomic_read_u64(&XLogCtl->flushGroupSizes[i]);
+}
+
 /*
  * Returns the redo pointer of the last checkpoint or restartpoint. This is
  * the oldest point in WAL that we still need, if we have to restart recovery.
@@ -11881,6 +12234,9 @@ WaitForWALToBecomeAvailable(XLogRecPtr RecPtr, bool randAccess,
 						wait_time = wal_retrieve_retry_interval -
 							(secs * 1000 + usecs / 1000);
 
+						/* Report what the redo workers have replayed */
+						SyncRedoWorkers();
+
 						WaitLatch(&XLogCtl->recoveryWakeupLatch,
 								  WL_LATCH_SET | WL_TIMEOUT | WL_POSTMASTER_DEATH,
 								  wait_time, WAIT_EVENT_RECOVERY_WAL_STREAM);
@@ -12045,8 +12401,10 @@ WaitForWALToBecomeAvailable(XLogRecPtr RecPtr, bool randAccess,
 					 * far and are about to start waiting for more WAL, let's
 					 * tell the upstream server our replay location now so
 					 * that pg_stat_replication doesn't show stale
-					 * information.
+					 * information.  The redo workers must finish first, for
+					 * that to be true.
 					 */
+					SyncRedoWorkers();
 					if (!streaming_reply_sent)
 					{
 						WalRcvForceReply();
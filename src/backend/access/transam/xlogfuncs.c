@@ -698,3 +698,75 @@ pg_backup_start_time(PG_FUNCTION_ARGS)
 
 	PG_RETURN_DATUM(xtime);
 }
+
+/*
+ * Returns the histogram of WAL flush group sizes, one row per bucket.
+ */
+Datum
+pg_stat_get_wal_flush_groups(PG_FUNCTION_ARGS)
+{
+#define PG_STAT_GET_WAL_FLUSH_GROUPS_COLS	3
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	uint64		groups[NUM_WAL_FLUSH_GROUP_BUCKETS];
+	int			i;
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not " \
+						"allowed in this context")));
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	GetWalFlushGroupStats(groups);
+
+	for (i = 0; i < NUM_WAL_FLUSH_GROUP_BUCKETS; i++)
+	{
+		Datum		values[PG_STAT_GET_WAL_FLUSH_GROUPS_COLS];
+		bool		nulls[PG_STAT_GET_WAL_FLUSH_GROUPS_COLS];
+
+		MemSet(nulls, 0, sizeof(nulls));
+
+		/* bucket i holds groups of 2^(i-1)+1 to 2^i members */
+		if (i == 0)
+			values[0] = Int32GetDatum(1);
+		else
+			values[0] = Int32GetDatum((1 << (i - 1)) + 1);
+
+		/* the last bucket has no upper bound */
+		if (i == NUM_WAL_FLUSH_GROUP_BUCKETS - 1)
+			nulls[1] = true;
+		else
+			values[1] = Int32GetDatum(1 << i);
+
+		values[2] = Int64GetDatum((int64) groups[i]);
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	/* clean up and return the tuplestore */
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
@@ -24,6 +24,7 @@
 #include "access/xlog_internal.h"
 #include "access/xloginsert.h"
 #include "catalog/pg_control.h"
+#include "common/pg_lz4.h"
 #include "common/pg_lzcompress.h"
 #include "miscadmin.h"
 #include "replication/origin.h"
@@ -110,7 +111,8 @@ static XLogRecData *XLogRecordAssemble(RmgrId rmid, uint8 info,
 				   XLogRecPtr RedoRecPtr, bool doPageWrites,
 				   XLogRecPtr *fpw_lsn);
 static bool XLogCompressBackupBlock(char *page, uint16 hole_offset,
-						uint16 hole_length, char *dest, uint16 *dlen);
+						uint16 hole_length, WalCompression method,
+						char *dest, uint16 *dlen);
 
 /*
  * Begin constructing a WAL record. This must be called before the
@@ -492,6 +494,7 @@ XLogRecordAssemble(RmgrId rmid, uint8 info,
 	XLogRecData *rdt_datas_last;
 	XLogRecord *rechdr;
 	char	   *scratch = hdr_scratch;
+	WalCompression compression = (WalCompression) wal_compression;
 
 	/*
 	 * Note: this function can be called multiple times for the same record.
@@ -620,11 +623,12 @@ XLogRecordAssemble(RmgrId rmid, uint8 info,
 			/*
 			 * Try to compress a block image if wal_compression is enabled
 			 */
-			if (wal_compression)
+			if (compression != WAL_COMPRESSION_NONE)
 			{
 				is_compressed =
 					XLogCompressBackupBlock(page, bimg.hole_offset,
 											cbimg.hole_length,
+											compression,
 											regbuf->compressed_page,
 											&compressed_len);
 			}
@@ -656,6 +660,8 @@ XLogRecordAssemble(RmgrId rmid, uint8 info,
 			{
 				bimg.length = compressed_len;
 				bimg.bimg_info |= BKPIMAGE_IS_COMPRESSED;
+				if (compression == WAL_COMPRESSION_LZ4)
+					bimg.bimg_info |= BKPIMAGE_COMPRESS_LZ4;
 
 				rdt_datas_last->data = regbuf->compressed_page;
 				rdt_datas_last->len = compressed_len;
@@ -795,7 +801,8 @@ XLogRecordAssemble(RmgrId rmid, uint8 info,
 }
 
 /*
- * Create a compressed version of a backup block image.
+ * Create a compressed version of a backup block image, using the given
+ * method.
  *
  * Returns false if compression fails (i.e., compressed result is actually
  * bigger than original). Otherwise, returns true and sets 'dlen' to
@@ -803,7 +810,7 @@ XLogRecordAssemble(RmgrId rmid, uint8 info,
  */
 static bool
 XLogCompressBackupBlock(char *page, uint16 hole_offset, uint16 hole_length,
-						char *dest, uint16 *dlen)
+						WalCompression method, char *dest, uint16 *dlen)
 {
 	int32		orig_len = BLCKSZ - hole_length;
 	int32		len;
@@ -830,11 +837,29 @@ XLogCompressBackupBlock(char *page, uint16 hole_offset, uint16 hole_length,
 		source = page;
 
 	/*
-	 * We recheck the actual size even if pglz_compress() reports success and
-	 * see if the number of bytes saved by compression is larger than the
-	 * length of extra data needed for the compressed version of block image.
+	 * We recheck the actual size even if compression reports success and see
+	 * if the number of bytes saved by compression is larger than the length
+	 * of extra data needed for the compressed version of block image.  LZ4
+	 * can stop as soon as it's clear that won't be the case.
 	 */
-	len = pglz_compress(source, orig_len, dest, PGLZ_strategy_default);
+	switch (method)
+	{
+		case WAL_COMPRESSION_PGLZ:
+			len = pglz_compress(source, orig_len, dest, PGLZ_strategy_default);
+			break;
+
+		case WAL_COMPRESSION_LZ4:
+			len = pg_lz4_compress(source, orig_len, dest,
+								  orig_len - extra_bytes - 1);
+			break;
+
+		default:
+			elog(ERROR, "unrecognized WAL compression method: %d",
+				 (int) method);
+			len = -1;			/* keep compiler quiet */
+			break;
+	}
+
 	if (len >= 0 &&
 		len + extra_bytes < orig_len)
 	{
@@ -0,0 +1,509 @@
+/*-------------------------------------------------------------------------
+ *
+ * xlogprefetch.c
+ *		Prefetching of blocks referenced by upcoming WAL records
+ *
+ * Replaying WAL in the startup process is mostly a sequence of synchronous
+ * reads of data blocks that aren't in shared buffers, one after another.
+ * With recovery_prefetch_distance > 0, the startup process reads ahead in
+ * the WAL with a second XLogReaderState before replaying each record, up to
+ * that many bytes beyond the record being replayed, and asks the kernel to
+ * start reading the blocks referenced by those records.  By the time replay
+ * reaches them, the reads have hopefully completed.
+ *
+ * Blocks that will be restored from a full-page image or initialized from
+ * scratch are never read by replay, so they are skipped, and so are blocks
+ * that were prefetched very recently, which is common when consecutive
+ * records modify the same page.  Prefetching goes through the same path as
+ * PrefetchBuffer(), that is posix_fadvise(), rather than reading the blocks
+ * into shared buffers, because replay routines need to be the only holder
+ * of a pin on some pages in order to get a cleanup lock.  For the same
+ * reason it does nothing with io_direct = data.
+ *
+ * The read-ahead reader only looks at WAL segment files in pg_wal, on the
+ * timeline currently being replayed, and when streaming, only at WAL that
+ * the WAL receiver has written already.  WAL that is restored from the
+ * archive, or that isn't there yet, simply isn't prefetched: when it runs
+ * into anything it can't read, the prefetcher waits until replay or the
+ * WAL receiver gets past that point and tries again.  Nothing it reads
+ * affects replay, so unlike the main reader it never reports errors.
+ *
+ * Counters are published in shared memory for pg_stat_recovery_prefetch.
+ *
+ * Portions Copyright (c) 1996-2018, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/backend/access/transam/xlogprefetch.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "access/htup_details.h"
+#include "access/xlog.h"
+#include "access/xlog_internal.h"
+#include "access/xlogprefetch.h"
+#include "access/xlogreader.h"
+#include "catalog/pg_type.h"
+#include "funcapi.h"
+#include "pgstat.h"
+#include "port/atomics.h"
+#include "replication/walreceiver.h"
+#include "storage/bufmgr.h"
+#include "storage/fd.h"
+#include "storage/shmem.h"
+#include "storage/smgr.h"
+#include "utils/builtins.h"
+
+/* GUC variable */
+int			recovery_prefetch_distance = 0;
+
+/*
+ * Maximum number of prefetched blocks that replay hasn't reached yet.  Read
+ * ahead stops when there is no room for another record's blocks.
+ */
+#define XLOGPREFETCHER_QUEUE_SIZE	1024
+
+/* Number of recently prefetched blocks that aren't prefetched again */
+#define XLOGPREFETCHER_RECENT_SIZE	16
+
+/* Number of columns of pg_stat_recovery_prefetch */
+#define PG_STAT_GET_RECOVERY_PREFETCH_COLS	7
+
+/*
+ * Counters in shared memory.  Only the startup process writes them, so
+ * atomic reads and writes are enough.
+ */
+typedef struct XLogPrefetchStats
+{
+	pg_atomic_uint64 prefetch;	/* reads initiated */
+	pg_atomic_uint64 hit;		/* blocks found in shared buffers */
+	pg_atomic_uint64 skip_new;	/* blocks initialized, or file missing */
+	pg_atomic_uint64 skip_fpw;	/* blocks with a full-page image */
+	pg_atomic_uint64 skip_rep;	/* blocks prefetched very recently */
+	pg_atomic_uint32 wal_distance;	/* bytes read ahead of replay */
+	pg_atomic_uint32 block_distance;	/* blocks prefetched ahead of replay */
+} XLogPrefetchStats;
+
+static XLogPrefetchStats *PrefetchStats = NULL;
+
+/* A recently prefetched block */
+typedef struct XLogPrefetcherRecent
+{
+	RelFileNode rnode;
+	ForkNumber	forknum;
+	BlockNumber blkno;
+} XLogPrefetcherRecent;
+
+struct XLogPrefetcher
+{
+	/* reader positioned after the last record we looked at */
+	XLogReaderState *reader;
+
+	/* currently open WAL segment, or -1 */
+	int			readFile;
+	XLogSegNo	readSegNo;
+	TimeLineID	readTLI;
+
+	/* timeline to read from, and how far (invalid if unlimited) */
+	TimeLineID	tli;
+	XLogRecPtr	readLimit;
+
+	/* did the last read fail, and what was the limit then? */
+	bool		failed;
+	XLogRecPtr	failedLimit;
+
+	/* start LSNs of the records of in-flight prefetches, oldest first */
+	XLogRecPtr	queue[XLOGPREFETCHER_QUEUE_SIZE];
+	int			queue_head;
+	int			queue_count;
+
+	/* ring of recently prefetched blocks */
+	XLogPrefetcherRecent recent[XLOGPREFETCHER_RECENT_SIZE];
+	int			recent_next;
+
+	/* local copies of the counters */
+	uint64		prefetch;
+	uint64		hit;
+	uint64		skip_new;
+	uint64		skip_fpw;
+	uint64		skip_rep;
+};
+
+static int XLogPrefetcherPageRead(XLogReaderState *xlogreader,
+					   XLogRecPtr targetPagePtr, int reqLen,
+					   XLogRecPtr targetRecPtr, char *readBuf,
+					   TimeLineID *pageTLI);
+static void XLogPrefetcherScanBlocks(XLogPrefetcher *prefetcher);
+static bool XLogPrefetcherRecentlySeen(XLogPrefetcher *prefetcher,
+						   RelFileNode rnode, ForkNumber forknum,
+						   BlockNumber blkno);
+static void XLogPrefetcherReportStats(XLogPrefetcher *prefetcher,
+						  XLogReaderState *replay);
+
+/*
+ * Report shared-memory space needed by XLogPrefetchShmemInit
+ */
+Size
+XLogPrefetchShmemSize(void)
+{
+	return sizeof(XLogPrefetchStats);
+}
+
+/*
+ * Allocate and initialize the prefetch counters in shared memory
+ */
+void
+XLogPrefetchShmemInit(void)
+{
+	bool		found;
+
+	PrefetchStats = (XLogPrefetchStats *)
+		ShmemInitStruct("WAL Prefetch Stats", sizeof(XLogPrefetchStats),
+						&found);
+
+	if (found)
+		return;
+
+	pg_atomic_init_u64(&PrefetchStats->prefetch, 0);
+	pg_atomic_init_u64(&PrefetchStats->hit, 0);
+	pg_atomic_init_u64(&PrefetchStats->skip_new, 0);
+	pg_atomic_init_u64(&PrefetchStats->skip_fpw, 0);
+	pg_atomic_init_u64(&PrefetchStats->skip_rep, 0);
+	pg_atomic_init_u32(&PrefetchStats->wal_distance, 0);
+	pg_atomic_init_u32(&PrefetchStats->block_distance, 0);
+}
+
+/*
+ * Create a prefetcher for the startup process.  It is used for the whole of
+ * WAL replay, whatever recovery_prefetch_distance is set to at the moment.
+ */
+XLogPrefetcher *
+XLogPrefetcherAllocate(int wal_segment_size)
+{
+	XLogPrefetcher *prefetcher;
+
+	prefetcher = (XLogPrefetcher *) palloc0(sizeof(XLogPrefetcher));
+	prefetcher->reader = XLogReaderAllocate(wal_segment_size,
+											&XLogPrefetcherPageRead,
+											prefetcher);
+	if (prefetcher->reader == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of memory"),
+				 errdetail("Failed while allocating a WAL reading processor.")));
+	prefetcher->readFile = -1;
+
+	/* Start counting afresh for this recovery */
+	pg_atomic_write_u64(&PrefetchStats->prefetch, 0);
+	pg_atomic_write_u64(&PrefetchStats->hit, 0);
+	pg_atomic_write_u64(&PrefetchStats->skip_new, 0);
+	pg_atomic_write_u64(&PrefetchStats->skip_fpw, 0);
+	pg_atomic_write_u64(&PrefetchStats->skip_rep, 0);
+
+	return prefetcher;
+}
+
+/*
+ * Release a prefetcher at the end of recovery
+ */
+void
+XLogPrefetcherFree(XLogPrefetcher *prefetcher)
+{
+	if (prefetcher->readFile >= 0)
+		close(prefetcher->readFile);
+	XLogReaderFree(prefetcher->reader);
+
+	pg_atomic_write_u32(&PrefetchStats->wal_distance, 0);
+	pg_atomic_write_u32(&PrefetchStats->block_distance, 0);
+
+	pfree(prefetcher);
+}
+
+/*
+ * Called by the startup process before it replays the record that "replay"
+ * has just read.  Forget about prefetches that replay has caught up with,
+ * and read ahead to keep recovery_prefetch_distance bytes ahead of it.
+ */
+void
+XLogPrefetcherReadAhead(XLogPrefetcher *prefetcher, XLogReaderState *replay)
+{
+	XLogReaderState *reader = prefetcher->reader;
+
+	/* Replay has reached the blocks of this record, and any before it */
+	while (prefetcher->queue_count > 0 &&
+		   prefetcher->queue[prefetcher->queue_head] <= replay->ReadRecPtr)
+	{
+		prefetcher->queue_head =
+			(prefetcher->queue_head + 1) % XLOGPREFETCHER_QUEUE_SIZE;
+		prefetcher->queue_count--;
+	}
+
+	/*
+	 * If replay has overtaken us, because we were disabled, couldn't read
+	 * WAL or just started, continue from the record replay is at.
+	 */
+	if (reader->EndRecPtr < replay->EndRecPtr)
+	{
+		XLogReaderInvalReadState(reader);
+		reader->ReadRecPtr = replay->ReadRecPtr;
+		reader->EndRecPtr = replay->EndRecPtr;
+		prefetcher->failed = false;
+	}
+
+	/* Prefetching doesn't help with direct I/O, see above */
+	if (recovery_prefetch_distance <= 0 ||
+		(io_direct_flags & IO_DIRECT_DATA))
+	{
+		XLogPrefetcherReportStats(prefetcher, replay);
+		return;
+	}
+
+	if (reader->EndRecPtr - replay->EndRecPtr <
+		(XLogRecPtr) recovery_prefetch_distance &&
+		prefetcher->queue_count + XLR_MAX_BLOCK_ID + 1 <=
+		XLOGPREFETCHER_QUEUE_SIZE)
+	{
+		/* Don't read WAL that the WAL receiver is still writing */
+		if (WalRcvStreaming())
+			prefetcher->readLimit = GetWalRcvWriteRecPtr(NULL, NULL);
+		else
+			prefetcher->readLimit = InvalidXLogRecPtr;
+		prefetcher->tli = replay->readPageTLI;
+
+		/*
+		 * After a failed read, only try again once more WAL has been
+		 * streamed.  Otherwise, wait until replay gets past this point.
+		 */
+		if (prefetcher->failed &&
+			(XLogRecPtrIsInvalid(prefetcher->readLimit) ||
+			 prefetcher->readLimit <= prefetcher->failedLimit))
+		{
+			XLogPrefetcherReportStats(prefetcher, replay);
+			return;
+		}
+		prefetcher->failed = false;
+
+		while (reader->EndRecPtr - replay->EndRecPtr <
+			   (XLogRecPtr) recovery_prefetch_distance &&
+			   prefetcher->queue_count + XLR_MAX_BLOCK_ID + 1 <=
+			   XLOGPREFETCHER_QUEUE_SIZE)
+		{
+			char	   *errormsg;
+
+			if (XLogReadRecord(reader, InvalidXLogRecPtr, &errormsg) == NULL)
+			{
+				prefetcher->failed = true;
+				prefetcher->failedLimit = prefetcher->readLimit;
+				break;
+			}
+
+			XLogPrefetcherScanBlocks(prefetcher);
+		}
+	}
+
+	XLogPrefetcherReportStats(prefetcher, replay);
+}
+
+/*
+ * Initiate reads of the blocks of the record the prefetcher has just read
+ */
+static void
+XLogPrefetcherScanBlocks(XLogPrefetcher *prefetcher)
+{
+	XLogReaderState *reader = prefetcher->reader;
+	int			block_id;
+
+	for (block_id = 0; block_id <= reader->max_block_id; block_id++)
+	{
+		RelFileNode rnode;
+		ForkNumber	forknum;
+		BlockNumber blkno;
+		SMgrRelation reln;
+
+		if (!XLogRecGetBlockTag(reader, block_id, &rnode, &forknum, &blkno))
+			continue;
+
+		/* Replay won't read blocks it restores from an image ... */
+		if (XLogRecHasBlockImage(reader, block_id) &&
+			XLogRecBlockImageApply(reader, block_id))
+		{
+			prefetcher->skip_fpw++;
+			continue;
+		}
+
+		/* ... or initializes from scratch */
+		if (reader->blocks[block_id].flags & BKPBLOCK_WILL_INIT)
+		{
+			prefetcher->skip_new++;
+			continue;
+		}
+
+		if (XLogPrefetcherRecentlySeen(prefetcher, rnode, forknum, blkno))
+		{
+			prefetcher->skip_rep++;
+			continue;
+		}
+
+		reln = smgropen(rnode, InvalidBackendId);
+		switch (PrefetchSharedBuffer(reln, forknum, blkno))
+		{
+			case PREFETCH_BUFFER_HIT:
+				prefetcher->hit++;
+				break;
+			case PREFETCH_BUFFER_STARTED:
+				prefetcher->prefetch++;
+				prefetcher->queue[(prefetcher->queue_head +
+								   prefetcher->queue_count) %
+								  XLOGPREFETCHER_QUEUE_SIZE] = reader->ReadRecPtr;
+				prefetcher->queue_count++;
+				break;
+			case PREFETCH_BUFFER_NOFILE:
+				/* created by a later record, or dropped before this one */
+				prefetcher->skip_new++;
+				break;
+		}
+	}
+}
+
+/*
+ * Check whether a block is one of the last few we looked at, and remember
+ * it otherwise
+ */
+static bool
+XLogPrefetcherRecentlySeen(XLogPrefetcher *prefetcher, RelFileNode rnode,
+						   ForkNumber forknum, BlockNumber blkno)
+{
+	XLogPrefetcherRecent *recent;
+	int			i;
+
+	for (i = 0; i < XLOGPREFETCHER_RECENT_SIZE; i++)
+	{
+		recent = &prefetcher->recent[i];
+		if (recent->blkno == blkno && recent->forknum == forknum &&
+			RelFileNodeEquals(recent->rnode, rnode))
+			return true;
+	}
+
+	recent = &prefetcher->recent[prefetcher->recent_next];
+	recent->rnode = rnode;
+	recent->forknum = forknum;
+	recent->blkno = blkno;
+	prefetcher->recent_next =
+		(prefetcher->recent_next + 1) % XLOGPREFETCHER_RECENT_SIZE;
+
+	return false;
+}
+
+/*
+ * Publish the counters and distances in shared memory
+ */
+static void
+XLogPrefetcherReportStats(XLogPrefetcher *prefetcher, XLogReaderState *replay)
+{
+	XLogRecPtr	distance = 0;
+
+	if (prefetcher->reader->EndRecPtr > replay->EndRecPtr)
+		distance = prefetcher->reader->EndRecPtr - replay->EndRecPtr;
+
+	pg_atomic_write_u64(&PrefetchStats->prefetch, prefetcher->prefetch);
+	pg_atomic_write_u64(&PrefetchStats->hit, prefetcher->hit);
+	pg_atomic_write_u64(&PrefetchStats->skip_new, prefetcher->skip_new);
+	pg_atomic_write_u64(&PrefetchStats->skip_fpw, prefetcher->skip_fpw);
+	pg_atomic_write_u64(&PrefetchStats->skip_rep, prefetcher->skip_rep);
+	pg_atomic_write_u32(&PrefetchStats->wal_distance,
+						(uint32) Min(distance, PG_INT32_MAX));
+	pg_atomic_write_u32(&PrefetchStats->block_distance,
+						prefetcher->queue_count);
+}
+
+/*
+ * Page read callback of the read-ahead reader.
+ *
+ * Reads from the segment files in pg_wal, never waits for more WAL to
+ * arrive, and never throws errors.  Returns -1 if the page can't be read.
+ */
+static int
+XLogPrefetcherPageRead(XLogReaderState *xlogreader, XLogRecPtr targetPagePtr,
+					   int reqLen, XLogRecPtr targetRecPtr, char *readBuf,
+					   TimeLineID *pageTLI)
+{
+	XLogPrefetcher *prefetcher = (XLogPrefetcher *) xlogreader->private_data;
+	XLogSegNo	segno;
+	uint32		offset;
+	int			readLen = XLOG_BLCKSZ;
+
+	if (!XLogRecPtrIsInvalid(prefetcher->readLimit))
+	{
+		if (targetPagePtr + reqLen > prefetcher->readLimit)
+			return -1;
+		readLen = Min(XLOG_BLCKSZ, prefetcher->readLimit - targetPagePtr);
+	}
+
+	XLByteToSeg(targetPagePtr, segno, xlogreader->wal_segment_size);
+	if (prefetcher->readFile >= 0 &&
+		(segno != prefetcher->readSegNo ||
+		 prefetcher->tli != prefetcher->readTLI))
+	{
+		close(prefetcher->readFile);
+		prefetcher->readFile = -1;
+	}
+
+	if (prefetcher->readFile < 0)
+	{
+		char		path[MAXPGPATH];
+
+		XLogFilePath(path, prefetcher->tli, segno,
+					 xlogreader->wal_segment_size);
+		prefetcher->readFile = BasicOpenFile(path, O_RDONLY | PG_BINARY);
+		if (prefetcher->readFile < 0)
+			return -1;
+		prefetcher->readSegNo = segno;
+		prefetcher->readTLI = prefetcher->tli;
+	}
+
+	offset = XLogSegmentOffset(targetPagePtr, xlogreader->wal_segment_size);
+	if (lseek(prefetcher->readFile, (off_t) offset, SEEK_SET) < 0)
+		return -1;
+
+	pgstat_report_wait_start(WAIT_EVENT_WAL_READ);
+	if (read(prefetcher->readFile, readBuf, XLOG_BLCKSZ) != XLOG_BLCKSZ)
+	{
+		pgstat_report_wait_end();
+		return -1;
+	}
+	pgstat_report_wait_end();
+
+	*pageTLI = prefetcher->readTLI;
+	return readLen;
+}
+
+/*
+ * Returns the counters of WAL prefetching in recovery
+ */
+Datum
+pg_stat_get_recovery_prefetch(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	Datum		values[PG_STAT_GET_RECOVERY_PREFETCH_COLS];
+	bool		nulls[PG_STAT_GET_RECOVERY_PREFETCH_COLS];
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	MemSet(nulls, 0, sizeof(nulls));
+
+	values[0] = Int64GetDatum(pg_atomic_read_u64(&PrefetchStats->prefetch));
+	values[1] = Int64GetDatum(pg_atomic_read_u64(&PrefetchStats->hit));
+	values[2] = Int64GetDatum(pg_atomic_read_u64(&PrefetchStats->skip_new));
+	values[3] = Int64GetDatum(pg_atomic_read_u64(&PrefetchStats->skip_fpw));
+	values[4] = Int64GetDatum(pg_atomic_read_u64(&PrefetchStats->skip_rep));
+	values[5] = Int32GetDatum(pg_atomic_read_u32(&PrefetchStats->wal_distance));
+	values[6] = Int32GetDatum(pg_atomic_read_u32(&PrefetchStats->block_distance));
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
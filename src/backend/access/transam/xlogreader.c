@@ -22,6 +22,7 @@
 #include "access/xlog_internal.h"
 #include "access/xlogreader.h"
 #include "catalog/pg_control.h"
+#include "common/pg_lz4.h"
 #include "common/pg_lzcompress.h"
 #include "replication/origin.h"
 
@@ -1185,6 +1186,19 @@ DecodeXLogRecord(XLogReaderState *state, XLogRecord *record, char **errormsg)
 					goto err;
 				}
 
+				/*
+				 * cross-check that IS_COMPRESSED is set if the COMPRESS_LZ4
+				 * flag is set.
+				 */
+				if ((blk->bimg_info & BKPIMAGE_COMPRESS_LZ4) &&
+					!(blk->bimg_info & BKPIMAGE_IS_COMPRESSED))
+				{
+					report_invalid_record(state,
+										  "BKPIMAGE_COMPRESS_LZ4 set, but BKPIMAGE_IS_COMPRESSED not set at %X/%X",
+										  (uint32) (state->ReadRecPtr >> 32), (uint32) state->ReadRecPtr);
+					goto err;
+				}
+
 				/*
 				 * cross-check that bimg_len = BLCKSZ if neither HAS_HOLE nor
 				 * IS_COMPRESSED flag is set.
@@ -1396,9 +1410,16 @@ RestoreBlockImage(XLogReaderState *record, uint8 block_id, char *page)
 
 	if (bkpb->bimg_info & BKPIMAGE_IS_COMPRESSED)
 	{
+		int32		len;
+
 		/* If a backup block image is compressed, decompress it */
-		if (pglz_decompress(ptr, bkpb->bimg_len, tmp,
-							BLCKSZ - bkpb->hole_length) < 0)
+		if (bkpb->bimg_info & BKPIMAGE_COMPRESS_LZ4)
+			len = pg_lz4_decompress(ptr, bkpb->bimg_len, tmp,
+									BLCKSZ - bkpb->hole_length);
+		else
+			len = pglz_decompress(ptr, bkpb->bimg_len, tmp,
+								  BLCKSZ - bkpb->hole_length);
+		if (len < 0)
 		{
 			report_invalid_record(record, "invalid compressed image at %X/%X, block %d",
 								  (uint32) (record->ReadRecPtr >> 32),
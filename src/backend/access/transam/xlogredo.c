@@ -0,0 +1,983 @@
+/*-------------------------------------------------------------------------
+ *
+ * xlogredo.c
+ *		Parallel replay of WAL records by redo worker processes
+ *
+ * With recovery_workers > 0, the startup process still reads and decodes
+ * all WAL, but it hands records that only modify the blocks they reference
+ * to a pool of redo workers.  Records are partitioned by the blocks they
+ * touch, so all records for a block go to the same worker and are replayed
+ * in WAL order, while different blocks are replayed concurrently.
+ *
+ * Anything else acts as a barrier: the startup process waits until the
+ * workers have replayed everything handed to them, and then replays the
+ * record itself.  That covers records whose blocks belong to different
+ * workers, records with effects beyond their blocks (dropping relations,
+ * recovery conflicts, timeline switches and so on), and commit records when
+ * queries may be running on a hot standby, so that no transaction becomes
+ * visible before its changes.  A few records that touch no pages at all,
+ * such as commits during crash recovery, don't need to wait and are
+ * replayed by the startup process right away.
+ *
+ * Each worker has a ring buffer in shared memory, into which the startup
+ * process copies the raw records; the worker decodes them again with its
+ * own XLogReaderState.  The startup process only advances the replay
+ * position reported by GetXLogReplayRecPtr() once the workers have caught
+ * up, so consistency, hot standby feedback and remote_apply waits only see
+ * records that have been replayed.
+ *
+ * Workers report references to invalid pages to the startup process, which
+ * keeps the table in xlogutils.c.  A worker that fails while replaying a
+ * record makes the startup process fail too, as if the record had been
+ * replayed by the startup process itself.  The workers are started at
+ * postmaster start, and just sit idle once recovery has finished.  After a
+ * backend crash, the postmaster kills them along with all other background
+ * workers, and starts new ones for crash recovery.
+ *
+ * Portions Copyright (c) 1996-2018, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/backend/access/transam/xlogredo.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <signal.h>
+
+#include "access/clog.h"
+#include "access/heapam_xlog.h"
+#include "access/multixact.h"
+#include "access/nbtxlog.h"
+#include "access/rmgr.h"
+#include "access/xact.h"
+#include "access/xlog.h"
+#include "access/xlog_internal.h"
+#include "access/xlogredo.h"
+#include "access/xlogutils.h"
+#include "catalog/pg_control.h"
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "port/atomics.h"
+#include "postmaster/bgworker.h"
+#include "postmaster/startup.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "storage/proc.h"
+#include "storage/shmem.h"
+#include "storage/smgr.h"
+#include "storage/spin.h"
+#include "storage/standby.h"
+#include "utils/guc.h"
+#include "utils/hashutils.h"
+#include "utils/memutils.h"
+
+
+/* size of each worker's queue */
+#define REDO_QUEUE_SIZE			(1024 * 1024)
+
+/* records larger than this are replayed by the startup process */
+#define REDO_MAX_RECORD_SIZE	(REDO_QUEUE_SIZE / 4)
+
+/* invalid page references a worker can report before it has to wait */
+#define REDO_MAX_INVALID_PAGES	16
+
+/*
+ * A record in a worker's queue.  The raw record follows the header.  A
+ * zero length marks the end of the usable space before the queue wraps
+ * around; if there's no room for a header at all, the queue wraps around
+ * implicitly.
+ */
+typedef struct RedoQueueEntry
+{
+	XLogRecPtr	ReadRecPtr;		/* start of the record */
+	XLogRecPtr	EndRecPtr;		/* end+1 of the record */
+	uint32		len;			/* length of the record */
+} RedoQueueEntry;
+
+#define REDO_ENTRY_HDRSZ	MAXALIGN(sizeof(RedoQueueEntry))
+
+typedef struct RedoInvalidPage
+{
+	RelFileNode node;
+	ForkNumber	forkno;
+	BlockNumber blkno;
+	bool		present;
+} RedoInvalidPage;
+
+typedef struct RedoWorkerSlot
+{
+	slock_t		mutex;			/* protects the fields below */
+	Latch	   *latch;			/* worker's latch, NULL if not running */
+	bool		failed;			/* worker died while replaying a record */
+	int			ninvalid;		/* number of invalid page references */
+	RedoInvalidPage invalid[REDO_MAX_INVALID_PAGES];
+
+	/*
+	 * Byte positions in the queue, never wrapped around.  insert_pos is only
+	 * advanced by the startup process, done_pos only by the worker, after it
+	 * has replayed the record.
+	 */
+	pg_atomic_uint64 insert_pos;
+	pg_atomic_uint64 done_pos;
+} RedoWorkerSlot;
+
+typedef struct RedoCtlData
+{
+	/* startup process's latch, set by workers when startup_waiting */
+	Latch	   *startup_latch;
+	pg_atomic_uint32 startup_waiting;
+
+	/* advanced when a replayed record may have removed relation files */
+	pg_atomic_uint32 file_generation;
+
+	RedoWorkerSlot workers[FLEXIBLE_ARRAY_MEMBER];
+} RedoCtlData;
+
+/* GUC variable */
+int			recovery_workers = 0;
+
+static RedoCtlData *RedoCtl = NULL;
+static char *RedoQueues = NULL;
+
+#define RedoQueue(i)	(RedoQueues + (Size) (i) * REDO_QUEUE_SIZE)
+
+/*
+ * Startup process state: the workers records are currently handed to, the
+ * worker chosen by the last ParallelRedoClassify() call, and whether the
+ * workers need to close their files before the next record.
+ */
+static int	nactive = 0;
+static int	active_workers[MAX_RECOVERY_WORKERS];
+static int	dispatch_target = -1;
+static bool dispatched = false;
+static bool close_files = false;
+
+/* Redo worker state */
+static int	MyRedoWorkerId = -1;
+static bool replaying = false;
+
+/* flags set by signal handlers */
+static volatile sig_atomic_t got_SIGHUP = false;
+static volatile sig_atomic_t got_SIGTERM = false;
+
+static void redo_refresh_workers(void);
+static int	redo_choose_worker(XLogReaderState *record);
+static bool redo_record_is_block_local(XLogReaderState *record);
+static bool redo_record_is_standalone(XLogReaderState *record);
+static void redo_wait_for_worker(int worker, uint64 upto);
+static void redo_collect_invalid_pages(void);
+static void redo_worker_replay(XLogReaderState *reader, RedoQueueEntry *entry);
+static void redo_worker_error_callback(void *arg);
+static void redo_worker_shutdown(int code, Datum arg);
+static void redo_worker_sighup(SIGNAL_ARGS);
+static void redo_worker_sigterm(SIGNAL_ARGS);
+
+
+/*
+ * Report shared-memory space needed by ParallelRedoShmemInit
+ */
+Size
+ParallelRedoShmemSize(void)
+{
+	Size		size;
+
+	size = offsetof(RedoCtlData, workers);
+	size = add_size(size, mul_size(recovery_workers, sizeof(RedoWorkerSlot)));
+	size = add_size(size, mul_size(recovery_workers, REDO_QUEUE_SIZE));
+
+	return size;
+}
+
+/*
+ * Allocate and initialize the redo worker queues in shared memory
+ */
+void
+ParallelRedoShmemInit(void)
+{
+	bool		found;
+	int			i;
+
+	RedoCtl = (RedoCtlData *)
+		ShmemInitStruct("Redo Worker Data",
+						add_size(offsetof(RedoCtlData, workers),
+								 mul_size(recovery_workers,
+										  sizeof(RedoWorkerSlot))),
+						&found);
+	RedoQueues = (char *)
+		ShmemInitStruct("Redo Worker Queues",
+						mul_size(recovery_workers, REDO_QUEUE_SIZE),
+						&found);
+
+	if (found)
+		return;
+
+	RedoCtl->startup_latch = NULL;
+	pg_atomic_init_u32(&RedoCtl->startup_waiting, 0);
+	pg_atomic_init_u32(&RedoCtl->file_generation, 0);
+	for (i = 0; i < recovery_workers; i++)
+	{
+		RedoWorkerSlot *slot = &RedoCtl->workers[i];
+
+		SpinLockInit(&slot->mutex);
+		slot->latch = NULL;
+		slot->failed = false;
+		slot->ninvalid = 0;
+		pg_atomic_init_u64(&slot->insert_pos, 0);
+		pg_atomic_init_u64(&slot->done_pos, 0);
+	}
+}
+
+/*
+ * Register the redo workers with the postmaster.
+ */
+void
+ParallelRedoRegisterWorkers(void)
+{
+	BackgroundWorker bgw;
+	int			i;
+
+	for (i = 0; i < recovery_workers; i++)
+	{
+		memset(&bgw, 0, sizeof(bgw));
+		bgw.bgw_flags = BGWORKER_SHMEM_ACCESS;
+		bgw.bgw_start_time = BgWorkerStart_PostmasterStart;
+		snprintf(bgw.bgw_library_name, BGW_MAXLEN, "postgres");
+		snprintf(bgw.bgw_function_name, BGW_MAXLEN, "RedoWorkerMain");
+		snprintf(bgw.bgw_name, BGW_MAXLEN, "redo worker %d", i);
+		snprintf(bgw.bgw_type, BGW_MAXLEN, "redo worker");
+		bgw.bgw_restart_time = 1;
+		bgw.bgw_notify_pid = 0;
+		bgw.bgw_main_arg = Int32GetDatum(i);
+
+		RegisterBackgroundWorker(&bgw);
+	}
+}
+
+/*
+ * Decide how the startup process should replay a record.
+ *
+ * For REDO_DISPATCH, the record must be passed to ParallelRedoDispatch()
+ * before classifying the next one.  For REDO_SERIAL, the caller must wait
+ * for the workers with ParallelRedoWaitAll() before replaying it.
+ */
+RedoDisposition
+ParallelRedoClassify(XLogReaderState *record)
+{
+	uint8		rmid = XLogRecGetRmid(record);
+
+	if (recovery_workers == 0)
+		return REDO_SERIAL;
+
+	/*
+	 * The workers in use can only change while they have nothing to do,
+	 * since the blocks would be assigned to different workers.
+	 */
+	if (!ParallelRedoPending())
+		redo_refresh_workers();
+
+	/* Consistency checks are done by the startup process */
+	if ((XLogRecGetInfo(record) & XLR_CHECK_CONSISTENCY) != 0)
+		return REDO_SERIAL;
+
+	if (redo_record_is_block_local(record))
+	{
+		if (nactive > 0 &&
+			XLogRecGetTotalLen(record) <= REDO_MAX_RECORD_SIZE)
+		{
+			dispatch_target = redo_choose_worker(record);
+			if (dispatch_target >= 0)
+				return REDO_DISPATCH;
+		}
+
+		/* Workers may still have records for some of the blocks */
+		return REDO_SERIAL;
+	}
+
+	if (redo_record_is_standalone(record))
+		return REDO_LOCAL;
+
+	/* The workers must not keep dropped relations open */
+	if (rmid == RM_SMGR_ID || rmid == RM_DBASE_ID ||
+		rmid == RM_TBLSPC_ID || rmid == RM_XACT_ID)
+		close_files = true;
+
+	return REDO_SERIAL;
+}
+
+/*
+ * Collect the running workers.
+ */
+static void
+redo_refresh_workers(void)
+{
+	int			i;
+
+	nactive = 0;
+	for (i = 0; i < recovery_workers; i++)
+	{
+		RedoWorkerSlot *slot = &RedoCtl->workers[i];
+
+		/* an unlocked read is fine, ParallelRedoDispatch checks again */
+		if (slot->latch != NULL)
+			active_workers[nactive++] = i;
+	}
+}
+
+/*
+ * Choose the worker for a record: the one all of its blocks belong to, or
+ * -1 if they belong to different workers.
+ */
+static int
+redo_choose_worker(XLogReaderState *record)
+{
+	int			target = -1;
+	int			block_id;
+
+	for (block_id = 0; block_id <= record->max_block_id; block_id++)
+	{
+		RelFileNode rnode;
+		ForkNumber	forknum;
+		BlockNumber blkno;
+		uint32		hash;
+		int			worker;
+
+		if (!XLogRecGetBlockTag(record, block_id, &rnode, &forknum, &blkno))
+			continue;
+
+		hash = murmurhash32(blkno);
+		hash = hash_combine(hash, rnode.relNode);
+		hash = hash_combine(hash, rnode.dbNode);
+		hash = hash_combine(hash, (uint32) forknum);
+		worker = active_workers[hash % nactive];
+
+		if (target >= 0 && worker != target)
+			return -1;
+		target = worker;
+	}
+
+	return target;
+}
+
+/*
+ * Can the record be replayed concurrently with records for other blocks?
+ *
+ * That's the case for records whose redo routine only modifies the blocks
+ * registered in the record, plus the visibility map and free space map
+ * bits for them, which are updated under buffer locks.  Records that can
+ * cause recovery conflicts on a hot standby are not included.
+ */
+static bool
+redo_record_is_block_local(XLogReaderState *record)
+{
+	uint8		info = XLogRecGetInfo(record) & ~XLR_INFO_MASK;
+
+	if (record->max_block_id < 0)
+		return false;
+
+	switch (XLogRecGetRmid(record))
+	{
+		case RM_XLOG_ID:
+			return (info == XLOG_FPI || info == XLOG_FPI_FOR_HINT);
+
+		case RM_HEAP_ID:
+			switch (info & XLOG_HEAP_OPMASK)
+			{
+				case XLOG_HEAP_INSERT:
+				case XLOG_HEAP_DELETE:
+				case XLOG_HEAP_UPDATE:
+				case XLOG_HEAP_HOT_UPDATE:
+				case XLOG_HEAP_CONFIRM:
+				case XLOG_HEAP_LOCK:
+				case XLOG_HEAP_INPLACE:
+					return true;
+			}
+			return false;
+
+		case RM_HEAP2_ID:
+			switch (info & XLOG_HEAP_OPMASK)
+			{
+				case XLOG_HEAP2_MULTI_INSERT:
+				case XLOG_HEAP2_LOCK_UPDATED:
+					return true;
+			}
+			return false;
+
+		case RM_BTREE_ID:
+			switch (info)
+			{
+				case XLOG_BTREE_INSERT_LEAF:
+				case XLOG_BTREE_INSERT_UPPER:
+				case XLOG_BTREE_INSERT_META:
+					return true;
+			}
+			return false;
+	}
+
+	return false;
+}
+
+/*
+ * Can the startup process replay the record without waiting for the
+ * workers?  That's the case for records that don't touch any relation
+ * pages, and whose effects can't be observed before the end of recovery,
+ * or are harmless if observed early.
+ */
+static bool
+redo_record_is_standalone(XLogReaderState *record)
+{
+	uint8		info = XLogRecGetInfo(record) & ~XLR_INFO_MASK;
+
+	switch (XLogRecGetRmid(record))
+	{
+		case RM_CLOG_ID:
+			return (info == CLOG_ZEROPAGE);
+
+		case RM_MULTIXACT_ID:
+			return (info != XLOG_MULTIXACT_TRUNCATE_ID);
+
+		case RM_XACT_ID:
+			{
+				uint8		xact_info = info & XLOG_XACT_OPMASK;
+
+				/* queries must not see a commit before its changes */
+				if (InHotStandby)
+					return false;
+
+				if (xact_info == XLOG_XACT_COMMIT)
+				{
+					xl_xact_parsed_commit parsed;
+
+					ParseCommitRecord(info,
+									  (xl_xact_commit *) XLogRecGetData(record),
+									  &parsed);
+					return (parsed.nrels == 0 &&
+							!XactCompletionApplyFeedback(parsed.xinfo));
+				}
+				if (xact_info == XLOG_XACT_ABORT)
+				{
+					xl_xact_parsed_abort parsed;
+
+					ParseAbortRecord(info,
+									 (xl_xact_abort *) XLogRecGetData(record),
+									 &parsed);
+					return (parsed.nrels == 0);
+				}
+				return false;
+			}
+	}
+
+	return false;
+}
+
+/*
+ * Hand a record to the worker chosen by ParallelRedoClassify().
+ *
+ * Returns false if the worker has exited meanwhile, in which case the
+ * caller must replay the record itself.  That's safe, because a worker
+ * only exits once it has replayed everything in its queue.
+ */
+bool
+ParallelRedoDispatch(XLogReaderState *record)
+{
+	RedoWorkerSlot *slot;
+	RedoQueueEntry *entry;
+	char	   *queue;
+	uint32		len = XLogRecGetTotalLen(record);
+	Size		need = REDO_ENTRY_HDRSZ + MAXALIGN(len);
+	Size		offset;
+	uint64		insert;
+	uint64		pos;
+	Latch	   *latch;
+
+	Assert(dispatch_target >= 0);
+	slot = &RedoCtl->workers[dispatch_target];
+	queue = RedoQueue(dispatch_target);
+
+	/* Make the workers reopen files the last barrier record might drop */
+	if (close_files)
+	{
+		pg_atomic_fetch_add_u32(&RedoCtl->file_generation, 1);
+		close_files = false;
+	}
+
+	/* Records are contiguous in the queue; skip the tail if needed */
+	insert = pg_atomic_read_u64(&slot->insert_pos);
+	pos = insert;
+	offset = pos % REDO_QUEUE_SIZE;
+	if (REDO_QUEUE_SIZE - offset < need)
+		pos += REDO_QUEUE_SIZE - offset;
+
+	if (pos + need > REDO_QUEUE_SIZE)
+		redo_wait_for_worker(dispatch_target, pos + need - REDO_QUEUE_SIZE);
+
+	if (pos != insert && REDO_QUEUE_SIZE - offset >= REDO_ENTRY_HDRSZ)
+		((RedoQueueEntry *) (queue + offset))->len = 0;
+
+	entry = (RedoQueueEntry *) (queue + pos % REDO_QUEUE_SIZE);
+	entry->ReadRecPtr = record->ReadRecPtr;
+	entry->EndRecPtr = record->EndRecPtr;
+	entry->len = len;
+	memcpy((char *) entry + REDO_ENTRY_HDRSZ, record->decoded_record, len);
+
+	SpinLockAcquire(&slot->mutex);
+	latch = slot->latch;
+	if (latch != NULL)
+	{
+		pg_write_barrier();
+		pg_atomic_write_u64(&slot->insert_pos, pos + need);
+	}
+	else if (slot->failed)
+	{
+		SpinLockRelease(&slot->mutex);
+		ereport(FATAL,
+				(errmsg("redo worker %d failed", dispatch_target)));
+	}
+	SpinLockRelease(&slot->mutex);
+
+	dispatch_target = -1;
+	if (latch == NULL)
+		return false;
+
+	SetLatch(latch);
+	dispatched = true;
+
+	return true;
+}
+
+/*
+ * Are there records the workers haven't replayed yet?
+ */
+bool
+ParallelRedoPending(void)
+{
+	int			i;
+
+	for (i = 0; i < nactive; i++)
+	{
+		RedoWorkerSlot *slot = &RedoCtl->workers[active_workers[i]];
+
+		if (pg_atomic_read_u64(&slot->done_pos) !=
+			pg_atomic_read_u64(&slot->insert_pos))
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Wait until the workers have replayed every record handed to them, and
+ * collect the invalid page references they reported.
+ *
+ * Returns true if any records were handed to the workers since the last
+ * call, meaning that the replay position can be advanced past them.
+ */
+bool
+ParallelRedoWaitAll(void)
+{
+	bool		result = dispatched;
+	int			i;
+
+	for (i = 0; i < nactive; i++)
+	{
+		int			worker = active_workers[i];
+
+		redo_wait_for_worker(worker,
+							 pg_atomic_read_u64(&RedoCtl->workers[worker].insert_pos));
+	}
+	redo_collect_invalid_pages();
+
+	dispatched = false;
+
+	return result;
+}
+
+/*
+ * Wait until a worker has replayed the records up to the given position
+ * in its queue.
+ */
+static void
+redo_wait_for_worker(int worker, uint64 upto)
+{
+	RedoWorkerSlot *slot = &RedoCtl->workers[worker];
+
+	if (RedoCtl->startup_latch != MyLatch)
+		RedoCtl->startup_latch = MyLatch;
+
+	while (pg_atomic_read_u64(&slot->done_pos) < upto)
+	{
+		bool		failed;
+
+		HandleStartupProcInterrupts();
+
+		/* The worker may be waiting for us to take its reports */
+		redo_collect_invalid_pages();
+
+		SpinLockAcquire(&slot->mutex);
+		failed = slot->failed;
+		SpinLockRelease(&slot->mutex);
+		if (failed)
+			ereport(FATAL,
+					(errmsg("redo worker %d failed", worker)));
+
+		ResetLatch(MyLatch);
+		pg_atomic_write_u32(&RedoCtl->startup_waiting, 1);
+		pg_memory_barrier();
+		if (pg_atomic_read_u64(&slot->done_pos) < upto)
+		{
+			int			rc;
+
+			rc = WaitLatch(MyLatch,
+						   WL_LATCH_SET | WL_POSTMASTER_DEATH,
+						   -1L,
+						   WAIT_EVENT_REDO_WORKERS);
+			if (rc & WL_POSTMASTER_DEATH)
+				proc_exit(1);
+		}
+		pg_atomic_write_u32(&RedoCtl->startup_waiting, 0);
+	}
+}
+
+/*
+ * Pass the invalid page references reported by the workers on to
+ * xlogutils.c.
+ */
+static void
+redo_collect_invalid_pages(void)
+{
+	int			i;
+
+	for (i = 0; i < recovery_workers; i++)
+	{
+		RedoWorkerSlot *slot = &RedoCtl->workers[i];
+		RedoInvalidPage invalid[REDO_MAX_INVALID_PAGES];
+		int			ninvalid;
+		Latch	   *latch;
+		int			j;
+
+		if (slot->ninvalid == 0)
+			continue;
+
+		SpinLockAcquire(&slot->mutex);
+		ninvalid = slot->ninvalid;
+		memcpy(invalid, slot->invalid, ninvalid * sizeof(RedoInvalidPage));
+		slot->ninvalid = 0;
+		latch = slot->latch;
+		SpinLockRelease(&slot->mutex);
+
+		for (j = 0; j < ninvalid; j++)
+			XLogRememberInvalidPage(invalid[j].node, invalid[j].forkno,
+									invalid[j].blkno, invalid[j].present);
+
+		if (latch != NULL)
+			SetLatch(latch);
+	}
+}
+
+/*
+ * Are we a redo worker?
+ */
+bool
+AmRedoWorker(void)
+{
+	return MyRedoWorkerId >= 0;
+}
+
+/*
+ * Report a reference to an invalid page to the startup process, waiting if
+ * it hasn't taken the previous ones yet.
+ */
+void
+ParallelRedoReportInvalidPage(RelFileNode node, ForkNumber forkno,
+							  BlockNumber blkno, bool present)
+{
+	RedoWorkerSlot *slot = &RedoCtl->workers[MyRedoWorkerId];
+
+	Assert(AmRedoWorker());
+
+	for (;;)
+	{
+		int			rc;
+
+		ResetLatch(MyLatch);
+
+		SpinLockAcquire(&slot->mutex);
+		if (slot->ninvalid < REDO_MAX_INVALID_PAGES)
+		{
+			RedoInvalidPage *invalid = &slot->invalid[slot->ninvalid++];
+
+			invalid->node = node;
+			invalid->forkno = forkno;
+			invalid->blkno = blkno;
+			invalid->present = present;
+			SpinLockRelease(&slot->mutex);
+			break;
+		}
+		SpinLockRelease(&slot->mutex);
+
+		if (RedoCtl->startup_latch != NULL)
+			SetLatch(RedoCtl->startup_latch);
+
+		rc = WaitLatch(MyLatch,
+					   WL_LATCH_SET | WL_POSTMASTER_DEATH,
+					   -1L,
+					   WAIT_EVENT_REDO_WORKERS);
+		if (rc & WL_POSTMASTER_DEATH)
+			proc_exit(1);
+	}
+}
+
+/*
+ * Main entry point for a redo worker
+ */
+void
+RedoWorkerMain(Datum main_arg)
+{
+	RedoWorkerSlot *slot;
+	XLogReaderState *reader;
+	MemoryContext redo_context;
+	char	   *queue;
+	uint32		file_generation;
+	bool		closed_files = true;
+
+	MyRedoWorkerId = DatumGetInt32(main_arg);
+	Assert(MyRedoWorkerId >= 0 && MyRedoWorkerId < recovery_workers);
+	slot = &RedoCtl->workers[MyRedoWorkerId];
+	queue = RedoQueue(MyRedoWorkerId);
+
+	pqsignal(SIGHUP, redo_worker_sighup);
+	pqsignal(SIGTERM, redo_worker_sigterm);
+	BackgroundWorkerUnblockSignals();
+
+	reader = XLogReaderAllocate(wal_segment_size, NULL, NULL);
+	if (reader == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of memory"),
+				 errdetail("Failed while allocating a WAL reading processor.")));
+
+	redo_context = AllocSetContextCreate(TopMemoryContext,
+										 "redo worker",
+										 ALLOCSET_DEFAULT_SIZES);
+
+	/* The redo routines expect to run in recovery */
+	InRecovery = true;
+
+	before_shmem_exit(redo_worker_shutdown, (Datum) 0);
+
+	SpinLockAcquire(&slot->mutex);
+	slot->latch = MyLatch;
+	slot->failed = false;
+	SpinLockRelease(&slot->mutex);
+
+	file_generation = pg_atomic_read_u32(&RedoCtl->file_generation);
+
+	for (;;)
+	{
+		RedoQueueEntry *entry;
+		uint64		done = pg_atomic_read_u64(&slot->done_pos);
+		Size		offset = done % REDO_QUEUE_SIZE;
+		Size		size;
+		uint32		generation;
+
+		if (got_SIGHUP)
+		{
+			got_SIGHUP = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
+
+		if (pg_atomic_read_u64(&slot->insert_pos) == done)
+		{
+			int			rc;
+			bool		idle;
+
+			/*
+			 * Don't keep files open while idle, the relations might get
+			 * dropped meanwhile.
+			 */
+			if (!closed_files)
+			{
+				smgrcloseall();
+				closed_files = true;
+			}
+
+			/* Exit only with an empty queue, see ParallelRedoDispatch */
+			if (got_SIGTERM)
+			{
+				SpinLockAcquire(&slot->mutex);
+				idle = (pg_atomic_read_u64(&slot->insert_pos) == done);
+				if (idle)
+					slot->latch = NULL;
+				SpinLockRelease(&slot->mutex);
+				if (idle)
+					break;
+				continue;
+			}
+
+			ResetLatch(MyLatch);
+			if (pg_atomic_read_u64(&slot->insert_pos) != done)
+				continue;
+
+			rc = WaitLatch(MyLatch,
+						   WL_LATCH_SET | WL_POSTMASTER_DEATH,
+						   -1L,
+						   WAIT_EVENT_REDO_WORKER_MAIN);
+			if (rc & WL_POSTMASTER_DEATH)
+				proc_exit(1);
+			continue;
+		}
+
+		pg_read_barrier();
+
+		/* The startup process may have removed relation files */
+		generation = pg_atomic_read_u32(&RedoCtl->file_generation);
+		if (generation != file_generation)
+		{
+			smgrcloseall();
+			file_generation = generation;
+		}
+
+		entry = (RedoQueueEntry *) (queue + offset);
+		if (REDO_QUEUE_SIZE - offset < REDO_ENTRY_HDRSZ || entry->len == 0)
+		{
+			/* wrap around */
+			pg_atomic_write_u64(&slot->done_pos,
+								done + REDO_QUEUE_SIZE - offset);
+			continue;
+		}
+		size = REDO_ENTRY_HDRSZ + MAXALIGN(entry->len);
+
+		closed_files = false;
+
+		MemoryContextSwitchTo(redo_context);
+		replaying = true;
+		redo_worker_replay(reader, entry);
+		replaying = false;
+		MemoryContextReset(redo_context);
+
+		/* Release the space only once we're done with the record */
+		pg_memory_barrier();
+		pg_atomic_write_u64(&slot->done_pos, done + size);
+
+		if (pg_atomic_read_u32(&RedoCtl->startup_waiting) != 0 &&
+			RedoCtl->startup_latch != NULL)
+			SetLatch(RedoCtl->startup_latch);
+	}
+
+	proc_exit(1);
+}
+
+/*
+ * Replay one record from the queue.
+ */
+static void
+redo_worker_replay(XLogReaderState *reader, RedoQueueEntry *entry)
+{
+	XLogRecord *record = (XLogRecord *) ((char *) entry + REDO_ENTRY_HDRSZ);
+	ErrorContextCallback errcallback;
+	MemoryContext oldcontext;
+	char	   *errormsg;
+	bool		decoded;
+
+	/* The decoder's buffers are reused for the following records */
+	oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+	reader->ReadRecPtr = entry->ReadRecPtr;
+	reader->EndRecPtr = entry->EndRecPtr;
+	decoded = DecodeXLogRecord(reader, record, &errormsg);
+	MemoryContextSwitchTo(oldcontext);
+
+	if (!decoded)
+		elog(ERROR, "could not decode WAL record at %X/%X: %s",
+			 (uint32) (entry->ReadRecPtr >> 32), (uint32) entry->ReadRecPtr,
+			 errormsg);
+
+	errcallback.callback = redo_worker_error_callback;
+	errcallback.arg = (void *) reader;
+	errcallback.previous = error_context_stack;
+	error_context_stack = &errcallback;
+
+	RmgrTable[record->xl_rmid].rm_redo(reader);
+
+	error_context_stack = errcallback.previous;
+}
+
+/*
+ * Error context callback for errors occurring during replay, like
+ * rm_redo_error_callback() in the startup process.
+ */
+static void
+redo_worker_error_callback(void *arg)
+{
+	XLogReaderState *record = (XLogReaderState *) arg;
+	RmgrId		rmid = XLogRecGetRmid(record);
+	uint8		info = XLogRecGetInfo(record);
+	const char *id;
+	StringInfoData buf;
+
+	initStringInfo(&buf);
+	appendStringInfoString(&buf, RmgrTable[rmid].rm_name);
+	appendStringInfoChar(&buf, '/');
+
+	id = RmgrTable[rmid].rm_identify(info);
+	if (id == NULL)
+		appendStringInfo(&buf, "UNKNOWN (%X): ", info & ~XLR_INFO_MASK);
+	else
+		appendStringInfo(&buf, "%s: ", id);
+
+	RmgrTable[rmid].rm_desc(&buf, record);
+
+	/* translator: %s is a WAL record description */
+	errcontext("WAL redo at %X/%X for %s",
+			   (uint32) (record->ReadRecPtr >> 32),
+			   (uint32) record->ReadRecPtr,
+			   buf.data);
+
+	pfree(buf.data);
+}
+
+/*
+ * If we die halfway through a record, the rest of the queue can't be
+ * replayed correctly, so make sure the startup process notices.
+ */
+static void
+redo_worker_shutdown(int code, Datum arg)
+{
+	RedoWorkerSlot *slot = &RedoCtl->workers[MyRedoWorkerId];
+
+	SpinLockAcquire(&slot->mutex);
+	if (slot->latch == MyLatch)
+	{
+		slot->latch = NULL;
+		slot->failed = replaying ||
+			pg_atomic_read_u64(&slot->insert_pos) !=
+			pg_atomic_read_u64(&slot->done_pos);
+	}
+	SpinLockRelease(&slot->mutex);
+
+	if (RedoCtl->startup_latch != NULL)
+		SetLatch(RedoCtl->startup_latch);
+}
+
+/* SIGHUP: set flag to reload the configuration file */
+static void
+redo_worker_sighup(SIGNAL_ARGS)
+{
+	int			save_errno = errno;
+
+	got_SIGHUP = true;
+	SetLatch(MyLatch);
+
+	errno = save_errno;
+}
+
+/* SIGTERM: set flag to exit once the queue is empty */
+static void
+redo_worker_sigterm(SIGNAL_ARGS)
+{
+	int			save_errno = errno;
+
+	got_SIGTERM = true;
+	SetLatch(MyLatch);
+
+	errno = save_errno;
+}
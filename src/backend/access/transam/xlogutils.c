@@ -22,10 +22,12 @@
 #include "access/timeline.h"
 #include "access/xlog.h"
 #include "access/xlog_internal.h"
+#include "access/xlogredo.h"
 #include "access/xlogutils.h"
 #include "catalog/catalog.h"
 #include "miscadmin.h"
 #include "pgstat.h"
+#include "storage/lmgr.h"
 #include "storage/smgr.h"
 #include "utils/guc.h"
 #include "utils/hsearch.h"
@@ -83,6 +85,13 @@ log_invalid_page(RelFileNode node, ForkNumber forkno, BlockNumber blkno,
 	xl_invalid_page *hentry;
 	bool		found;
 
+	/* Redo workers leave the bookkeeping to the startup process */
+	if (AmRedoWorker())
+	{
+		ParallelRedoReportInvalidPage(node, forkno, blkno, present);
+		return;
+	}
+
 	/*
 	 * Once recovery has reached a consistent state, the invalid-page table
 	 * should be empty and remain so. If a reference to an invalid page is
@@ -138,6 +147,16 @@ log_invalid_page(RelFileNode node, ForkNumber forkno, BlockNumber blkno,
 	}
 }
 
+/*
+ * Log a reference to an invalid page reported by a redo worker
+ */
+void
+XLogRememberInvalidPage(RelFileNode node, ForkNumber forkno,
+						BlockNumber blkno, bool present)
+{
+	log_invalid_page(node, forkno, blkno, present);
+}
+
 /* Forget any invalid pages >= minblkno, because they've been dropped */
 static void
 forget_invalid_pages(RelFileNode node, ForkNumber forkno, BlockNumber minblkno)
@@ -441,6 +460,7 @@ XLogReadBufferExtended(RelFileNode rnode, ForkNumber forknum,
 	BlockNumber lastblock;
 	Buffer		buffer;
 	SMgrRelation smgr;
+	Relation	fakerel = NULL;
 
 	Assert(blkno != P_NEW);
 
@@ -475,11 +495,38 @@ XLogReadBufferExtended(RelFileNode rnode, ForkNumber forknum,
 		}
 		if (mode == RBM_NORMAL_NO_LOG)
 			return InvalidBuffer;
-		/* OK to extend the file */
-		/* we do this in recovery only - no rel-extension lock needed */
+		/*
+		 * OK to extend the file.  We do this in recovery only.  Redo workers
+		 * can extend the same relation concurrently, so they take the
+		 * relation extension lock, and recheck the size once they have it.
+		 * The startup process only replays records touching relation pages
+		 * while the workers are idle, so it needs no lock.
+		 */
 		Assert(InRecovery);
+		if (AmRedoWorker())
+		{
+			fakerel = CreateFakeRelcacheEntry(rnode);
+			LockRelationForExtension(fakerel, ExclusiveLock);
+		}
+
 		buffer = InvalidBuffer;
-		do
+		if (fakerel == NULL || blkno >= smgrnblocks(smgr, forknum))
+		{
+			do
+			{
+				if (buffer != InvalidBuffer)
+				{
+					if (mode == RBM_ZERO_AND_LOCK || mode == RBM_ZERO_AND_CLEANUP_LOCK)
+						LockBuffer(buffer, BUFFER_LOCK_UNLOCK);
+					ReleaseBuffer(buffer);
+				}
+				buffer = ReadBufferWithoutRelcache(rnode, forknum,
+												   P_NEW, mode, NULL);
+			}
+			while (BufferGetBlockNumber(buffer) < blkno);
+		}
+		/* Handle the corner case that P_NEW returns non-consecutive pages */
+		if (buffer == InvalidBuffer || BufferGetBlockNumber(buffer) != blkno)
 		{
 			if (buffer != InvalidBuffer)
 			{
@@ -487,19 +534,15 @@ XLogReadBufferExtended(RelFileNode rnode, ForkNumber forknum,
 					LockBuffer(buffer, BUFFER_LOCK_UNLOCK);
 				ReleaseBuffer(buffer);
 			}
-			buffer = ReadBufferWithoutRelcache(rnode, forknum,
-											   P_NEW, mode, NULL);
-		}
-		while (BufferGetBlockNumber(buffer) < blkno);
-		/* Handle the corner case that P_NEW returns non-consecutive pages */
-		if (BufferGetBlockNumber(buffer) != blkno)
-		{
-			if (mode == RBM_ZERO_AND_LOCK || mode == RBM_ZERO_AND_CLEANUP_LOCK)
-				LockBuffer(buffer, BUFFER_LOCK_UNLOCK);
-			ReleaseBuffer(buffer);
 			buffer = ReadBufferWithoutRelcache(rnode, forknum, blkno,
 											   mode, NULL);
 		}
+
+		if (fakerel != NULL)
+		{
+			UnlockRelationForExtension(fakerel, ExclusiveLock);
+			FreeFakeRelcacheEntry(fakerel);
+		}
 	}
 
 	if (mode == RBM_NORMAL)
@@ -510,7 +553,7 @@ XLogReadBufferExtended(RelFileNode rnode, ForkNumber forknum,
 		/*
 		 * We assume that PageIsNew is safe without a lock. During recovery,
 		 * there should be no other backends that could modify the buffer at
-		 * the same time.
+		 * the same time, and redo workers never share a block.
 		 */
 		if (PageIsNew(page))
 		{
@@ -573,9 +616,9 @@ CreateFakeRelcacheEntry(RelFileNode rnode)
 	/*
 	 * We set up the lockRelId in case anything tries to lock the dummy
 	 * relation.  Note that this is fairly bogus since relNode may be
-	 * different from the relation's OID.  It shouldn't really matter though,
-	 * since we are presumably running by ourselves and can't have any lock
-	 * conflicts ...
+	 * different from the relation's OID.  It shouldn't really matter though:
+	 * the only locks taken during replay are relation extension locks, which
+	 * just have to be the same for everyone replaying the relation.
 	 */
 	rel->rd_lockInfo.lockRelId.dbId = rnode.dbNode;
 	rel->rd_lockInfo.lockRelId.relId = rnode.relNode;
@@ -51,6 +51,7 @@
 #include "catalog/storage.h"
 #include "commands/tablecmds.h"
 #include "commands/trigger.h"
+#include "commands/vacuum.h"
 #include "executor/executor.h"
 #include "miscadmin.h"
 #include "nodes/makefuncs.h"
@@ -2420,6 +2421,7 @@ IndexBuildHeapRangeScan(Relation heapRelation,
 	TransactionId OldestXmin;
 	BlockNumber root_blkno = InvalidBlockNumber;
 	OffsetNumber root_offsets[MaxHeapTuplesPerPage];
+	ColumnSketchState *sketches = NULL;
 
 	/*
 	 * sanity checks
@@ -2466,6 +2468,17 @@ IndexBuildHeapRangeScan(Relation heapRelation,
 	if (!IsBootstrapProcessingMode() && !indexInfo->ii_Concurrent)
 		OldestXmin = GetOldestXmin(heapRelation, PROCARRAY_FLAGS_VACUUM);
 
+	/*
+	 * A serial scan for a non-partial index sees every live row of the table,
+	 * so take the opportunity to sketch the distinct values of the indexed
+	 * columns for the planner.
+	 */
+	if (!scan && !anyvisible && predicate == NULL &&
+		start_blockno == 0 && numblocks == InvalidBlockNumber)
+		sketches = begin_column_sketches(heapRelation,
+										 indexInfo->ii_NumIndexAttrs,
+										 indexInfo->ii_KeyAttrNumbers);
+
 	if (!scan)
 	{
 		/*
@@ -2803,6 +2816,9 @@ IndexBuildHeapRangeScan(Relation heapRelation,
 					   values,
 					   isnull);
 
+		if (sketches && tupleIsAlive)
+			add_column_sketches(sketches, values, isnull);
+
 		/*
 		 * You'd think we should go ahead and build the index tuple here, but
 		 * some index AMs want to do further processing on the data first.  So
@@ -2843,6 +2859,9 @@ IndexBuildHeapRangeScan(Relation heapRelation,
 
 	heap_endscan(scan);
 
+	if (sketches)
+		end_column_sketches(sketches);
+
 	/* we can now forget our snapshot, if set and registered by us */
 	if (need_unregister_snapshot)
 		UnregisterSnapshot(snapshot);
@@ -186,6 +186,25 @@ static int partition_hash_bsearch(PartitionKey key,
 					   int modulus, int remainder);
 
 static int	get_partition_bound_num_indexes(PartitionBoundInfo b);
+static int32 partition_rbound_point_cmp(int partnatts, FmgrInfo *partsupfunc,
+						   Oid *partcollation,
+						   Datum *datums1, PartitionRangeDatumKind *kind1,
+						   Datum *datums2, PartitionRangeDatumKind *kind2);
+static PartitionBoundInfo partition_range_bounds_merge(int partnatts,
+							 FmgrInfo *partsupfunc, Oid *partcollation,
+							 PartitionBoundInfo outer_bi,
+							 PartitionBoundInfo inner_bi,
+							 int *outer_match, int *inner_match,
+							 int **outer_parts, int **inner_parts,
+							 int *nparts);
+static PartitionBoundInfo partition_list_bounds_merge(FmgrInfo *partsupfunc,
+							Oid *partcollation,
+							PartitionBoundInfo outer_bi,
+							PartitionBoundInfo inner_bi,
+							JoinType jointype,
+							int *outer_match, int *inner_match,
+							int **outer_parts, int **inner_parts,
+							int *nparts);
 static int	get_greatest_modulus(PartitionBoundInfo b);
 static uint64 compute_hash_value(PartitionKey key, Datum *values, bool *isnull);
 
@@ -943,6 +962,452 @@ partition_bounds_copy(PartitionBoundInfo src,
 	return dest;
 }
 
+/*
+ * partition_bounds_merge
+ *
+ * Match up the partitions of two relations that are to be joined on their
+ * partition keys, when their partition bounds are not the same.
+ *
+ * Each partition of one side may be matched with at most one partition of
+ * the other side, namely the one that can contain the same partition key
+ * values; if some partition could join to more than one partition of the
+ * other side, we give up and return NULL.  Partitions without any
+ * counterpart are left out of the result where the join type allows it:
+ * they can't produce any rows of an inner or semi join, and the inner
+ * side's ones can't produce any rows of a left or anti join.  An outer
+ * partition without a counterpart in a left, anti or full join, or an inner
+ * one in a full join, would have to be joined to an empty relation, which
+ * we don't support, so we give up in those cases as well.  We also give up
+ * if either side has a default partition, since that could hold any value,
+ * and for hash partitioning, where partitions either match exactly or not
+ * at all.
+ *
+ * On success, returns the bounds of the join, each of whose partitions
+ * covers the bounds of both partitions joined to produce it, and sets
+ * *nparts to the number of partitions of the join and *outer_parts and
+ * *inner_parts to palloc'd arrays of the indexes of the outer and inner
+ * partitions joined to produce each of them.  The result shares bound datums
+ * with the inputs.
+ */
+PartitionBoundInfo
+partition_bounds_merge(int partnatts, FmgrInfo *partsupfunc,
+					   Oid *partcollation,
+					   PartitionBoundInfo outer_bi, int outer_nparts,
+					   PartitionBoundInfo inner_bi, int inner_nparts,
+					   JoinType jointype,
+					   int **outer_parts, int **inner_parts, int *nparts)
+{
+	PartitionBoundInfo merged_bi;
+	int		   *outer_match;
+	int		   *inner_match;
+	int			i;
+
+	Assert(outer_bi->strategy == inner_bi->strategy);
+
+	if (partition_bound_has_default(outer_bi) ||
+		partition_bound_has_default(inner_bi))
+		return NULL;
+
+	/* Index of the partition of the join each partition is matched to */
+	outer_match = (int *) palloc(sizeof(int) * outer_nparts);
+	inner_match = (int *) palloc(sizeof(int) * inner_nparts);
+	for (i = 0; i < outer_nparts; i++)
+		outer_match[i] = -1;
+	for (i = 0; i < inner_nparts; i++)
+		inner_match[i] = -1;
+
+	switch (outer_bi->strategy)
+	{
+		case PARTITION_STRATEGY_RANGE:
+			merged_bi = partition_range_bounds_merge(partnatts, partsupfunc,
+													 partcollation,
+													 outer_bi, inner_bi,
+													 outer_match, inner_match,
+													 outer_parts, inner_parts,
+													 nparts);
+			break;
+
+		case PARTITION_STRATEGY_LIST:
+			merged_bi = partition_list_bounds_merge(partsupfunc,
+													partcollation,
+													outer_bi, inner_bi,
+													jointype,
+													outer_match, inner_match,
+													outer_parts, inner_parts,
+													nparts);
+			break;
+
+		default:
+			merged_bi = NULL;
+			break;
+	}
+
+	if (merged_bi == NULL || *nparts == 0)
+		return NULL;
+
+	/* Check that the join type can cope with the unmatched partitions */
+	if (jointype == JOIN_LEFT || jointype == JOIN_ANTI ||
+		jointype == JOIN_FULL)
+	{
+		for (i = 0; i < outer_nparts; i++)
+			if (outer_match[i] < 0)
+				return NULL;
+	}
+	if (jointype == JOIN_FULL)
+	{
+		for (i = 0; i < inner_nparts; i++)
+			if (inner_match[i] < 0)
+				return NULL;
+	}
+
+	pfree(outer_match);
+	pfree(inner_match);
+
+	return merged_bi;
+}
+
+/*
+ * partition_range_bounds_merge
+ *		Workhorse of partition_bounds_merge for range partitioning.
+ *
+ * Walks the ranges of both sides in order, pairing up the ones that overlap.
+ * If the ranges of one side overlap at most one range of the other side and
+ * vice versa, the union of each such pair can't overlap that of any other
+ * pair, so we can use those as the bounds of the join.
+ */
+static PartitionBoundInfo
+partition_range_bounds_merge(int partnatts, FmgrInfo *partsupfunc,
+							 Oid *partcollation,
+							 PartitionBoundInfo outer_bi,
+							 PartitionBoundInfo inner_bi,
+							 int *outer_match, int *inner_match,
+							 int **outer_parts, int **inner_parts,
+							 int *nparts)
+{
+	PartitionBoundInfo merged_bi;
+	int			maxparts = Min(outer_bi->ndatums, inner_bi->ndatums);
+	int			nmerged = 0;
+	int			o = 1;
+	int			i = 1;
+	int			k;
+	int			ndatums;
+	int		   *lower;
+	int		   *upper;
+	bool	   *lower_outer;
+	bool	   *upper_outer;
+
+	*outer_parts = (int *) palloc(sizeof(int) * maxparts);
+	*inner_parts = (int *) palloc(sizeof(int) * maxparts);
+
+	/* Positions in the datums arrays of the merged lower and upper bounds */
+	lower = (int *) palloc(sizeof(int) * maxparts);
+	upper = (int *) palloc(sizeof(int) * maxparts);
+	lower_outer = (bool *) palloc(sizeof(bool) * maxparts);
+	upper_outer = (bool *) palloc(sizeof(bool) * maxparts);
+
+	/*
+	 * The range of the partition at indexes[n] is [datums[n - 1], datums[n]);
+	 * a negative index marks a gap between partitions.
+	 */
+	for (;;)
+	{
+		int			outer_part;
+		int			inner_part;
+		int32		cmpval;
+
+		while (o < outer_bi->ndatums && outer_bi->indexes[o] < 0)
+			o++;
+		while (i < inner_bi->ndatums && inner_bi->indexes[i] < 0)
+			i++;
+		if (o >= outer_bi->ndatums || i >= inner_bi->ndatums)
+			break;
+
+		/* Does the outer range end before the inner one starts? */
+		if (partition_rbound_point_cmp(partnatts, partsupfunc, partcollation,
+									   outer_bi->datums[o],
+									   outer_bi->kind[o],
+									   inner_bi->datums[i - 1],
+									   inner_bi->kind[i - 1]) <= 0)
+		{
+			o++;
+			continue;
+		}
+
+		/* Or the other way around? */
+		if (partition_rbound_point_cmp(partnatts, partsupfunc, partcollation,
+									   inner_bi->datums[i],
+									   inner_bi->kind[i],
+									   outer_bi->datums[o - 1],
+									   outer_bi->kind[o - 1]) <= 0)
+		{
+			i++;
+			continue;
+		}
+
+		/* They overlap, so they had better not overlap anything else */
+		outer_part = outer_bi->indexes[o];
+		inner_part = inner_bi->indexes[i];
+		if (outer_match[outer_part] >= 0 || inner_match[inner_part] >= 0)
+			return NULL;
+
+		outer_match[outer_part] = inner_match[inner_part] = nmerged;
+		(*outer_parts)[nmerged] = outer_part;
+		(*inner_parts)[nmerged] = inner_part;
+
+		lower_outer[nmerged] =
+			partition_rbound_point_cmp(partnatts, partsupfunc, partcollation,
+									   outer_bi->datums[o - 1],
+									   outer_bi->kind[o - 1],
+									   inner_bi->datums[i - 1],
+									   inner_bi->kind[i - 1]) <= 0;
+		lower[nmerged] = lower_outer[nmerged] ? o - 1 : i - 1;
+
+		cmpval = partition_rbound_point_cmp(partnatts, partsupfunc,
+											partcollation,
+											outer_bi->datums[o],
+											outer_bi->kind[o],
+											inner_bi->datums[i],
+											inner_bi->kind[i]);
+		upper_outer[nmerged] = cmpval >= 0;
+		upper[nmerged] = upper_outer[nmerged] ? o : i;
+		nmerged++;
+
+		/* Move past whichever range ends first, or both */
+		if (cmpval <= 0)
+			o++;
+		if (cmpval >= 0)
+			i++;
+	}
+
+	*nparts = nmerged;
+	if (nmerged == 0)
+		return NULL;
+
+	/* Each partition adds its upper bound, and a lower one after a gap */
+	merged_bi = (PartitionBoundInfoData *) palloc(sizeof(PartitionBoundInfoData));
+	merged_bi->strategy = PARTITION_STRATEGY_RANGE;
+	merged_bi->datums = (Datum **) palloc(sizeof(Datum *) * 2 * nmerged);
+	merged_bi->kind = (PartitionRangeDatumKind **)
+		palloc(sizeof(PartitionRangeDatumKind *) * 2 * nmerged);
+	merged_bi->indexes = (int *) palloc(sizeof(int) * (2 * nmerged + 1));
+	merged_bi->null_index = -1;
+	merged_bi->default_index = -1;
+
+	ndatums = 0;
+	for (k = 0; k < nmerged; k++)
+	{
+		PartitionBoundInfo lbi = lower_outer[k] ? outer_bi : inner_bi;
+		PartitionBoundInfo ubi = upper_outer[k] ? outer_bi : inner_bi;
+
+		if (ndatums == 0 ||
+			partition_rbound_point_cmp(partnatts, partsupfunc, partcollation,
+									   merged_bi->datums[ndatums - 1],
+									   merged_bi->kind[ndatums - 1],
+									   lbi->datums[lower[k]],
+									   lbi->kind[lower[k]]) != 0)
+		{
+			merged_bi->datums[ndatums] = lbi->datums[lower[k]];
+			merged_bi->kind[ndatums] = lbi->kind[lower[k]];
+			merged_bi->indexes[ndatums] = -1;
+			ndatums++;
+		}
+		merged_bi->datums[ndatums] = ubi->datums[upper[k]];
+		merged_bi->kind[ndatums] = ubi->kind[upper[k]];
+		merged_bi->indexes[ndatums] = k;
+		ndatums++;
+	}
+	merged_bi->indexes[ndatums] = -1;
+	merged_bi->ndatums = ndatums;
+
+	pfree(lower);
+	pfree(upper);
+	pfree(lower_outer);
+	pfree(upper_outer);
+
+	return merged_bi;
+}
+
+/*
+ * partition_list_bounds_merge
+ *		Workhorse of partition_bounds_merge for list partitioning.
+ *
+ * Partitions match if they share a value; the values of a partition of the
+ * join are those of both partitions joined to produce it.  The NULL values
+ * of a side whose rows may appear in the join without a join partner go
+ * with the partition of the join holding that side's null partition.
+ */
+static PartitionBoundInfo
+partition_list_bounds_merge(FmgrInfo *partsupfunc, Oid *partcollation,
+							PartitionBoundInfo outer_bi,
+							PartitionBoundInfo inner_bi,
+							JoinType jointype,
+							int *outer_match, int *inner_match,
+							int **outer_parts, int **inner_parts,
+							int *nparts)
+{
+	PartitionBoundInfo merged_bi;
+	int			maxparts = Min(outer_bi->ndatums, inner_bi->ndatums);
+	int			nmerged = 0;
+	int			ndatums = 0;
+	int			o;
+	int			i;
+
+	*outer_parts = (int *) palloc(sizeof(int) * Max(maxparts, 1));
+	*inner_parts = (int *) palloc(sizeof(int) * Max(maxparts, 1));
+
+	/* First pair up the partitions sharing a value */
+	o = i = 0;
+	while (o < outer_bi->ndatums && i < inner_bi->ndatums)
+	{
+		int32		cmpval;
+		int			outer_part;
+		int			inner_part;
+
+		cmpval = DatumGetInt32(FunctionCall2Coll(&partsupfunc[0],
+												 partcollation[0],
+												 outer_bi->datums[o][0],
+												 inner_bi->datums[i][0]));
+		if (cmpval < 0)
+		{
+			o++;
+			continue;
+		}
+		if (cmpval > 0)
+		{
+			i++;
+			continue;
+		}
+
+		outer_part = outer_bi->indexes[o];
+		inner_part = inner_bi->indexes[i];
+		if (outer_match[outer_part] < 0 && inner_match[inner_part] < 0)
+		{
+			outer_match[outer_part] = inner_match[inner_part] = nmerged;
+			(*outer_parts)[nmerged] = outer_part;
+			(*inner_parts)[nmerged] = inner_part;
+			nmerged++;
+		}
+		else if (outer_match[outer_part] != inner_match[inner_part])
+			return NULL;
+		o++;
+		i++;
+	}
+
+	*nparts = nmerged;
+	if (nmerged == 0)
+		return NULL;
+
+	/* Then collect the values of the matched partitions, in order */
+	merged_bi = (PartitionBoundInfoData *) palloc(sizeof(PartitionBoundInfoData));
+	merged_bi->strategy = PARTITION_STRATEGY_LIST;
+	merged_bi->kind = NULL;
+	merged_bi->datums = (Datum **)
+		palloc(sizeof(Datum *) * (outer_bi->ndatums + inner_bi->ndatums));
+	merged_bi->indexes = (int *)
+		palloc(sizeof(int) * (outer_bi->ndatums + inner_bi->ndatums));
+	merged_bi->default_index = -1;
+
+	o = i = 0;
+	while (o < outer_bi->ndatums || i < inner_bi->ndatums)
+	{
+		int32		cmpval;
+		int			merged_part;
+
+		if (o >= outer_bi->ndatums)
+			cmpval = 1;
+		else if (i >= inner_bi->ndatums)
+			cmpval = -1;
+		else
+			cmpval = DatumGetInt32(FunctionCall2Coll(&partsupfunc[0],
+													 partcollation[0],
+													 outer_bi->datums[o][0],
+													 inner_bi->datums[i][0]));
+
+		if (cmpval <= 0)
+		{
+			merged_part = outer_match[outer_bi->indexes[o]];
+			merged_bi->datums[ndatums] = outer_bi->datums[o];
+		}
+		else
+		{
+			merged_part = inner_match[inner_bi->indexes[i]];
+			merged_bi->datums[ndatums] = inner_bi->datums[i];
+		}
+		if (cmpval <= 0)
+			o++;
+		if (cmpval >= 0)
+			i++;
+
+		if (merged_part >= 0)
+		{
+			merged_bi->indexes[ndatums] = merged_part;
+			ndatums++;
+		}
+	}
+	merged_bi->ndatums = ndatums;
+
+	/*
+	 * With strict join operators, NULL keys only survive the join as rows of
+	 * the outer side of an outer join, or either side of a full join.
+	 */
+	merged_bi->null_index = -1;
+	if (jointype == JOIN_LEFT || jointype == JOIN_ANTI ||
+		jointype == JOIN_FULL)
+	{
+		if (partition_bound_accepts_nulls(outer_bi))
+			merged_bi->null_index = outer_match[outer_bi->null_index];
+	}
+	if (jointype == JOIN_FULL && partition_bound_accepts_nulls(inner_bi))
+	{
+		int			inner_null = inner_match[inner_bi->null_index];
+
+		if (merged_bi->null_index >= 0 && inner_null >= 0 &&
+			merged_bi->null_index != inner_null)
+			return NULL;
+		if (inner_null >= 0)
+			merged_bi->null_index = inner_null;
+	}
+
+	return merged_bi;
+}
+
+/*
+ * partition_rbound_point_cmp
+ *
+ * Compare two range bound datum tuples, as found in the datums and kind
+ * arrays of a PartitionBoundInfo, using the given comparison functions.
+ */
+static int32
+partition_rbound_point_cmp(int partnatts, FmgrInfo *partsupfunc,
+						   Oid *partcollation,
+						   Datum *datums1, PartitionRangeDatumKind *kind1,
+						   Datum *datums2, PartitionRangeDatumKind *kind2)
+{
+	int			i;
+
+	for (i = 0; i < partnatts; i++)
+	{
+		int32		cmpval;
+
+		/* Unbounded columns compare by kind, and end the comparison */
+		if (kind1[i] < kind2[i])
+			return -1;
+		else if (kind1[i] > kind2[i])
+			return 1;
+		else if (kind1[i] != PARTITION_RANGE_DATUM_VALUE)
+			return 0;
+
+		cmpval = DatumGetInt32(FunctionCall2Coll(&partsupfunc[i],
+												 partcollation[i],
+												 datums1[i],
+												 datums2[i]));
+		if (cmpval != 0)
+			return cmpval;
+	}
+
+	return 0;
+}
+
 /*
  * check_new_partition_bound
  *
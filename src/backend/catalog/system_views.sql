@@ -754,6 +754,33 @@ CREATE VIEW pg_stat_wal_receiver AS
     FROM pg_stat_get_wal_receiver() s
     WHERE s.pid IS NOT NULL;
 
+CREATE VIEW pg_stat_recovery_prefetch AS
+    SELECT
+            s.prefetch,
+            s.hit,
+            s.skip_new,
+            s.skip_fpw,
+            s.skip_rep,
+            s.wal_distance,
+            s.block_distance
+    FROM pg_stat_get_recovery_prefetch() s;
+
+CREATE VIEW pg_stat_wal_flush_groups AS
+    SELECT
+            s.min_size,
+            s.max_size,
+            s.groups
+    FROM pg_stat_get_wal_flush_groups() s;
+
+CREATE VIEW pg_stat_shared_plan_cache AS
+    SELECT
+            s.entries,
+            s.hits,
+            s.misses,
+            s.stores,
+            s.evictions
+    FROM pg_stat_get_shared_plan_cache() s;
+
 CREATE VIEW pg_stat_subscription AS
     SELECT
             su.oid AS subid,
@@ -1147,6 +1174,8 @@ REVOKE EXECUTE ON FUNCTION lo_export(oid, text) FROM public;
 REVOKE EXECUTE ON FUNCTION pg_ls_logdir() FROM public;
 REVOKE EXECUTE ON FUNCTION pg_ls_waldir() FROM public;
 
+REVOKE EXECUTE ON FUNCTION pg_calibrate_costs(regclass, integer) FROM public;
+
 --
 -- We also set up some things as accessible to standard roles.
 --
@@ -17,6 +17,7 @@
 #include <math.h>
 
 #include "access/multixact.h"
+#include "access/parallel.h"
 #include "access/sysattr.h"
 #include "access/transam.h"
 #include "access/tupconvert.h"
@@ -35,8 +36,10 @@
 #include "commands/vacuum.h"
 #include "executor/executor.h"
 #include "foreign/fdwapi.h"
+#include "lib/hyperloglog.h"
 #include "miscadmin.h"
 #include "nodes/nodeFuncs.h"
+#include "optimizer/paths.h"
 #include "parser/parse_oper.h"
 #include "parser/parse_relation.h"
 #include "pgstat.h"
@@ -47,6 +50,8 @@
 #include "storage/lmgr.h"
 #include "storage/proc.h"
 #include "storage/procarray.h"
+#include "storage/read_stream.h"
+#include "storage/shm_mq.h"
 #include "utils/acl.h"
 #include "utils/attoptcache.h"
 #include "utils/builtins.h"
@@ -57,10 +62,12 @@
 #include "utils/memutils.h"
 #include "utils/pg_rusage.h"
 #include "utils/sampling.h"
+#include "utils/snapmgr.h"
 #include "utils/sortsupport.h"
 #include "utils/syscache.h"
 #include "utils/timestamp.h"
 #include "utils/tqual.h"
+#include "utils/typcache.h"
 
 
 /* Per-index data for ANALYZE */
@@ -73,9 +80,62 @@ typedef struct AnlIndexData
 } AnlIndexData;
 
 
+/*
+ * Running state of the row sampling done by acquire_sample_rows().  In a
+ * parallel sample, each participant keeps its own.
+ */
+typedef struct AnlSampleState
+{
+	HeapTuple  *rows;			/* the reservoir */
+	int			targrows;		/* size of the reservoir */
+	int			numrows;		/* # rows now in reservoir */
+	double		samplerows;		/* total # rows collected */
+	double		liverows;		/* # live rows seen */
+	double		deadrows;		/* # dead rows seen */
+	double		rowstoskip;		/* -1 means not set yet */
+	ReservoirStateData rstate;
+} AnlSampleState;
+
+/*
+ * Shared state of a parallel sample.  The leader chooses the blocks to read
+ * up front, and all participants then take them one at a time.
+ */
+typedef struct AnlParallelShared
+{
+	Oid			relid;
+	TransactionId OldestXmin;
+	int			targrows;
+	uint32		seed;			/* base of the workers' random seeds */
+	pg_atomic_uint32 nextblock; /* index of next blocks[] entry to read */
+	int			nblocks;
+	BlockNumber blocks[FLEXIBLE_ARRAY_MEMBER];
+} AnlParallelShared;
+
+/* What a worker sends ahead of the rows it sampled */
+typedef struct AnlWorkerSummary
+{
+	int			numrows;
+	double		samplerows;
+	double		liverows;
+	double		deadrows;
+} AnlWorkerSummary;
+
+/* Magic numbers for parallel ANALYZE's shared memory */
+#define PARALLEL_KEY_ANALYZE_SHARED		UINT64CONST(0xB000000000000001)
+#define PARALLEL_KEY_ANALYZE_QUEUES		UINT64CONST(0xB000000000000002)
+
+/* Size of the queue each worker sends its sample through */
+#define ANALYZE_QUEUE_SIZE				65536
+
+/* Bit width of the HyperLogLog sketches kept in pg_statistic */
+#define ANALYZE_SKETCH_BWIDTH			10
+
 /* Default statistics target (GUC parameter) */
 int			default_statistics_target = 100;
 
+/* Merge partitions' statistics into their parent's? (GUC parameter) */
+bool		analyze_merge_partition_stats = false;
+
 /* A few variables that don't seem worth passing around as parameters */
 static MemoryContext anl_context = NULL;
 static BufferAccessStrategy vac_strategy;
@@ -94,10 +154,48 @@ static VacAttrStats *examine_attribute(Relation onerel, int attnum,
 static int acquire_sample_rows(Relation onerel, int elevel,
 					HeapTuple *rows, int targrows,
 					double *totalrows, double *totaldeadrows);
+static BlockNumber acquire_sample_rows_next(ReadStream *stream,
+						 void *callback_private_data,
+						 void *per_buffer_data);
+static void acquire_sample_rows_block(Relation onerel, Buffer targbuffer,
+						  TransactionId OldestXmin, AnlSampleState *sstate);
+static int	analyze_parallel_workers(Relation onerel, BlockNumber nblocks);
+static void acquire_sample_rows_parallel(Relation onerel, BlockSampler bs,
+							 BlockNumber maxblocks, TransactionId OldestXmin,
+							 AnlSampleState *sstate, int nworkers);
+static void sample_shared_blocks(Relation onerel, AnlParallelShared *shared,
+					 AnlSampleState *sstate);
+static BlockNumber sample_shared_blocks_next(ReadStream *stream,
+						  void *callback_private_data,
+						  void *per_buffer_data);
+static void receive_worker_sample(shm_mq_handle *mqh, Oid relid,
+					  AnlSampleState *wstate);
+static void merge_samples(AnlSampleState *sstate, AnlSampleState *wstates,
+			  int nworkers);
 static int	compare_rows(const void *a, const void *b);
 static int acquire_inherited_sample_rows(Relation onerel, int elevel,
 							  HeapTuple *rows, int targrows,
 							  double *totalrows, double *totaldeadrows);
+static bool merge_partition_stats(Relation onerel, int elevel,
+					  int attr_cnt, VacAttrStats **vacattrstats);
+static bool merge_partition_attr_stats(VacAttrStats *stats,
+						   int nparts, HeapTuple *statstuples,
+						   double *reltuples);
+static int	compare_part_items(const void *a, const void *b, void *arg);
+static int	compare_part_mcvs(const void *a, const void *b, void *arg);
+static void compute_distinct_sketch(VacAttrStatsP stats,
+						AnalyzeAttrFetchFunc fetchfunc,
+						int samplerows, double totalrows, bool inh);
+static void store_distinct_sketch(VacAttrStatsP stats, int slot,
+					  hyperLogLogState *sketch, double nvalues,
+					  bool wholetable);
+static float4 *form_distinct_sketch(hyperLogLogState *sketch,
+					 double nvalues, bool wholetable);
+static double sketch_stadistinct(hyperLogLogState *sketch, double nvalues,
+				   double totalrows);
+static void update_distinct_sketch(Oid relid, AttrNumber attnum, Oid eqopr,
+					   hyperLogLogState *sketch, double nvalues,
+					   double totalrows);
 static void update_attstats(Oid relid, bool inh,
 				int natts, VacAttrStats **vacattrstats);
 static Datum std_fetch_func(VacAttrStatsP stats, int rownum, bool *isNull);
@@ -541,17 +639,47 @@ do_analyze_rel(Relation onerel, int options, VacuumParams *params,
 	}
 
 	/*
-	 * Acquire the sample rows
+	 * The statistics of a partitioned table can be put together from those
+	 * of its partitions, if they're all available; then there's no need to
+	 * sample the partitions again.
 	 */
-	rows = (HeapTuple *) palloc(targrows * sizeof(HeapTuple));
-	if (inh)
-		numrows = acquire_inherited_sample_rows(onerel, elevel,
-												rows, targrows,
-												&totalrows, &totaldeadrows);
+	if (inh && analyze_merge_partition_stats &&
+		onerel->rd_rel->relkind == RELKIND_PARTITIONED_TABLE &&
+		merge_partition_stats(onerel, elevel, attr_cnt, vacattrstats))
+	{
+		for (i = 0; i < attr_cnt; i++)
+		{
+			VacAttrStats *stats = vacattrstats[i];
+			AttributeOpts *aopt;
+
+			aopt = get_attribute_options(onerel->rd_id, stats->attr->attnum);
+			if (aopt != NULL && aopt->n_distinct_inherited != 0.0)
+				stats->stadistinct = aopt->n_distinct_inherited;
+		}
+
+		update_attstats(RelationGetRelid(onerel), inh,
+						attr_cnt, vacattrstats);
+
+		/* Nothing else to do for a partitioned table */
+		rows = NULL;
+		numrows = 0;
+		totalrows = totaldeadrows = 0;
+	}
 	else
-		numrows = (*acquirefunc) (onerel, elevel,
-								  rows, targrows,
-								  &totalrows, &totaldeadrows);
+	{
+		/*
+		 * Acquire the sample rows
+		 */
+		rows = (HeapTuple *) palloc(targrows * sizeof(HeapTuple));
+		if (inh)
+			numrows = acquire_inherited_sample_rows(onerel, elevel,
+													rows, targrows,
+													&totalrows, &totaldeadrows);
+		else
+			numrows = (*acquirefunc) (onerel, elevel,
+									  rows, targrows,
+									  &totalrows, &totaldeadrows);
+	}
 
 	/*
 	 * Compute the statistics.  Temporary results during the calculations for
@@ -580,6 +708,8 @@ do_analyze_rel(Relation onerel, int options, VacuumParams *params,
 								 std_fetch_func,
 								 numrows,
 								 totalrows);
+			compute_distinct_sketch(stats, std_fetch_func,
+									numrows, totalrows, inh);
 
 			/*
 			 * If the appropriate flavor of the n_distinct option is
@@ -1043,15 +1173,11 @@ acquire_sample_rows(Relation onerel, int elevel,
 					HeapTuple *rows, int targrows,
 					double *totalrows, double *totaldeadrows)
 {
-	int			numrows = 0;	/* # rows now in reservoir */
-	double		samplerows = 0; /* total # rows collected */
-	double		liverows = 0;	/* # live rows seen */
-	double		deadrows = 0;	/* # dead rows seen */
-	double		rowstoskip = -1;	/* -1 means not set yet */
+	AnlSampleState sstate;
 	BlockNumber totalblocks;
 	TransactionId OldestXmin;
 	BlockSamplerData bs;
-	ReservoirStateData rstate;
+	int			nworkers;
 
 	Assert(targrows > 0);
 
@@ -1063,178 +1189,45 @@ acquire_sample_rows(Relation onerel, int elevel,
 	/* Prepare for sampling block numbers */
 	BlockSampler_Init(&bs, totalblocks, targrows, random());
 	/* Prepare for sampling rows */
-	reservoir_init_selection_state(&rstate, targrows);
-
-	/* Outer loop over blocks to sample */
-	while (BlockSampler_HasMore(&bs))
+	sstate.rows = rows;
+	sstate.targrows = targrows;
+	sstate.numrows = 0;
+	sstate.samplerows = 0;
+	sstate.liverows = 0;
+	sstate.deadrows = 0;
+	sstate.rowstoskip = -1;
+	reservoir_init_selection_state(&sstate.rstate, targrows);
+
+	/* Reading many blocks may be worth doing in parallel */
+	nworkers = analyze_parallel_workers(onerel, Min(totalblocks, targrows));
+
+	if (nworkers > 0)
+		acquire_sample_rows_parallel(onerel, &bs, Min(totalblocks, targrows),
+									 OldestXmin, &sstate, nworkers);
+	else
 	{
-		BlockNumber targblock = BlockSampler_Next(&bs);
+		ReadStream *stream;
 		Buffer		targbuffer;
-		Page		targpage;
-		OffsetNumber targoffset,
-					maxoffset;
-
-		vacuum_delay_point();
 
 		/*
-		 * We must maintain a pin on the target page's buffer to ensure that
-		 * the maxoffset value stays good (else concurrent VACUUM might delete
-		 * tuples out from under us).  Hence, pin the page until we are done
-		 * looking at it.  We also choose to hold sharelock on the buffer
-		 * throughout --- we could release and re-acquire sharelock for each
-		 * tuple, but since we aren't doing much work per tuple, the extra
-		 * lock traffic is probably better avoided.
+		 * Outer loop over blocks to sample.  The sampled blocks are read
+		 * ahead of time through a read stream.
 		 */
-		targbuffer = ReadBufferExtended(onerel, MAIN_FORKNUM, targblock,
-										RBM_NORMAL, vac_strategy);
-		LockBuffer(targbuffer, BUFFER_LOCK_SHARE);
-		targpage = BufferGetPage(targbuffer);
-		maxoffset = PageGetMaxOffsetNumber(targpage);
-
-		/* Inner loop over all tuples on the selected page */
-		for (targoffset = FirstOffsetNumber; targoffset <= maxoffset; targoffset++)
+		stream = read_stream_begin_relation(onerel, MAIN_FORKNUM,
+											vac_strategy,
+											acquire_sample_rows_next, &bs,
+											0);
+		for (;;)
 		{
-			ItemId		itemid;
-			HeapTupleData targtuple;
-			bool		sample_it = false;
-
-			itemid = PageGetItemId(targpage, targoffset);
-
-			/*
-			 * We ignore unused and redirect line pointers.  DEAD line
-			 * pointers should be counted as dead, because we need vacuum to
-			 * run to get rid of them.  Note that this rule agrees with the
-			 * way that heap_page_prune() counts things.
-			 */
-			if (!ItemIdIsNormal(itemid))
-			{
-				if (ItemIdIsDead(itemid))
-					deadrows += 1;
-				continue;
-			}
-
-			ItemPointerSet(&targtuple.t_self, targblock, targoffset);
-
-			targtuple.t_tableOid = RelationGetRelid(onerel);
-			targtuple.t_data = (HeapTupleHeader) PageGetItem(targpage, itemid);
-			targtuple.t_len = ItemIdGetLength(itemid);
-
-			switch (HeapTupleSatisfiesVacuum(&targtuple,
-											 OldestXmin,
-											 targbuffer))
-			{
-				case HEAPTUPLE_LIVE:
-					sample_it = true;
-					liverows += 1;
-					break;
-
-				case HEAPTUPLE_DEAD:
-				case HEAPTUPLE_RECENTLY_DEAD:
-					/* Count dead and recently-dead rows */
-					deadrows += 1;
-					break;
-
-				case HEAPTUPLE_INSERT_IN_PROGRESS:
-
-					/*
-					 * Insert-in-progress rows are not counted.  We assume
-					 * that when the inserting transaction commits or aborts,
-					 * it will send a stats message to increment the proper
-					 * count.  This works right only if that transaction ends
-					 * after we finish analyzing the table; if things happen
-					 * in the other order, its stats update will be
-					 * overwritten by ours.  However, the error will be large
-					 * only if the other transaction runs long enough to
-					 * insert many tuples, so assuming it will finish after us
-					 * is the safer option.
-					 *
-					 * A special case is that the inserting transaction might
-					 * be our own.  In this case we should count and sample
-					 * the row, to accommodate users who load a table and
-					 * analyze it in one transaction.  (pgstat_report_analyze
-					 * has to adjust the numbers we send to the stats
-					 * collector to make this come out right.)
-					 */
-					if (TransactionIdIsCurrentTransactionId(HeapTupleHeaderGetXmin(targtuple.t_data)))
-					{
-						sample_it = true;
-						liverows += 1;
-					}
-					break;
-
-				case HEAPTUPLE_DELETE_IN_PROGRESS:
-
-					/*
-					 * We count delete-in-progress rows as still live, using
-					 * the same reasoning given above; but we don't bother to
-					 * include them in the sample.
-					 *
-					 * If the delete was done by our own transaction, however,
-					 * we must count the row as dead to make
-					 * pgstat_report_analyze's stats adjustments come out
-					 * right.  (Note: this works out properly when the row was
-					 * both inserted and deleted in our xact.)
-					 */
-					if (TransactionIdIsCurrentTransactionId(HeapTupleHeaderGetUpdateXid(targtuple.t_data)))
-						deadrows += 1;
-					else
-						liverows += 1;
-					break;
-
-				default:
-					elog(ERROR, "unexpected HeapTupleSatisfiesVacuum result");
-					break;
-			}
-
-			if (sample_it)
-			{
-				/*
-				 * The first targrows sample rows are simply copied into the
-				 * reservoir. Then we start replacing tuples in the sample
-				 * until we reach the end of the relation.  This algorithm is
-				 * from Jeff Vitter's paper (see full citation below). It
-				 * works by repeatedly computing the number of tuples to skip
-				 * before selecting a tuple, which replaces a randomly chosen
-				 * element of the reservoir (current set of tuples).  At all
-				 * times the reservoir is a true random sample of the tuples
-				 * we've passed over so far, so when we fall off the end of
-				 * the relation we're done.
-				 */
-				if (numrows < targrows)
-					rows[numrows++] = heap_copytuple(&targtuple);
-				else
-				{
-					/*
-					 * t in Vitter's paper is the number of records already
-					 * processed.  If we need to compute a new S value, we
-					 * must use the not-yet-incremented value of samplerows as
-					 * t.
-					 */
-					if (rowstoskip < 0)
-						rowstoskip = reservoir_get_next_S(&rstate, samplerows, targrows);
-
-					if (rowstoskip <= 0)
-					{
-						/*
-						 * Found a suitable tuple, so save it, replacing one
-						 * old tuple at random
-						 */
-						int			k = (int) (targrows * sampler_random_fract(rstate.randstate));
-
-						Assert(k >= 0 && k < targrows);
-						heap_freetuple(rows[k]);
-						rows[k] = heap_copytuple(&targtuple);
-					}
+			vacuum_delay_point();
 
-					rowstoskip -= 1;
-				}
+			targbuffer = read_stream_next_buffer(stream, NULL);
+			if (!BufferIsValid(targbuffer))
+				break;
 
-				samplerows += 1;
-			}
+			acquire_sample_rows_block(onerel, targbuffer, OldestXmin, &sstate);
 		}
-
-		/* Now release the lock and pin on the page */
-		UnlockReleaseBuffer(targbuffer);
+		read_stream_end(stream);
 	}
 
 	/*
@@ -1243,10 +1236,10 @@ acquire_sample_rows(Relation onerel, int elevel,
 	 *
 	 * Otherwise we need to sort the collected tuples by position
 	 * (itempointer). It's not worth worrying about corner cases where the
-	 * tuples are already sorted.
+	 * tuples are already sorted.  A parallel sample is never in order.
 	 */
-	if (numrows == targrows)
-		qsort((void *) rows, numrows, sizeof(HeapTuple), compare_rows);
+	if (sstate.numrows == targrows || nworkers > 0)
+		qsort((void *) rows, sstate.numrows, sizeof(HeapTuple), compare_rows);
 
 	/*
 	 * Estimate total numbers of rows in relation.  For live rows, use
@@ -1257,9 +1250,9 @@ acquire_sample_rows(Relation onerel, int elevel,
 	*totalrows = vac_estimate_reltuples(onerel, true,
 										totalblocks,
 										bs.m,
-										liverows);
+										sstate.liverows);
 	if (bs.m > 0)
-		*totaldeadrows = floor((deadrows / bs.m) * totalblocks + 0.5);
+		*totaldeadrows = floor((sstate.deadrows / bs.m) * totalblocks + 0.5);
 	else
 		*totaldeadrows = 0.0;
 
@@ -1272,645 +1265,1543 @@ acquire_sample_rows(Relation onerel, int elevel,
 					"%d rows in sample, %.0f estimated total rows",
 					RelationGetRelationName(onerel),
 					bs.m, totalblocks,
-					liverows, deadrows,
-					numrows, *totalrows)));
+					sstate.liverows, sstate.deadrows,
+					sstate.numrows, *totalrows)));
 
-	return numrows;
+	return sstate.numrows;
 }
 
 /*
- * qsort comparator for sorting rows[] array
+ * acquire_sample_rows_next -- read stream callback returning sampled blocks
  */
-static int
-compare_rows(const void *a, const void *b)
+static BlockNumber
+acquire_sample_rows_next(ReadStream *stream, void *callback_private_data,
+						 void *per_buffer_data)
 {
-	HeapTuple	ha = *(const HeapTuple *) a;
-	HeapTuple	hb = *(const HeapTuple *) b;
-	BlockNumber ba = ItemPointerGetBlockNumber(&ha->t_self);
-	OffsetNumber oa = ItemPointerGetOffsetNumber(&ha->t_self);
-	BlockNumber bb = ItemPointerGetBlockNumber(&hb->t_self);
-	OffsetNumber ob = ItemPointerGetOffsetNumber(&hb->t_self);
+	BlockSampler bs = (BlockSampler) callback_private_data;
 
-	if (ba < bb)
-		return -1;
-	if (ba > bb)
-		return 1;
-	if (oa < ob)
-		return -1;
-	if (oa > ob)
-		return 1;
-	return 0;
+	if (!BlockSampler_HasMore(bs))
+		return InvalidBlockNumber;
+	return BlockSampler_Next(bs);
 }
 
-
 /*
- * acquire_inherited_sample_rows -- acquire sample rows from inheritance tree
+ * acquire_sample_rows_block -- add the rows of one block to a sample
  *
- * This has the same API as acquire_sample_rows, except that rows are
- * collected from all inheritance children as well as the specified table.
- * We fail and return zero if there are no inheritance children, or if all
- * children are foreign tables that don't support ANALYZE.
+ * targbuffer is the pinned buffer of the block; it is released here.
  */
-static int
-acquire_inherited_sample_rows(Relation onerel, int elevel,
-							  HeapTuple *rows, int targrows,
-							  double *totalrows, double *totaldeadrows)
+static void
+acquire_sample_rows_block(Relation onerel, Buffer targbuffer,
+						  TransactionId OldestXmin, AnlSampleState *sstate)
 {
-	List	   *tableOIDs;
-	Relation   *rels;
-	AcquireSampleRowsFunc *acquirefuncs;
-	double	   *relblocks;
-	double		totalblocks;
-	int			numrows,
-				nrels,
-				i;
-	ListCell   *lc;
-	bool		has_child;
-
-	/*
-	 * Find all members of inheritance set.  We only need AccessShareLock on
-	 * the children.
-	 */
-	tableOIDs =
-		find_all_inheritors(RelationGetRelid(onerel), AccessShareLock, NULL);
+	HeapTuple  *rows = sstate->rows;
+	int			targrows = sstate->targrows;
+	BlockNumber targblock = BufferGetBlockNumber(targbuffer);
+	Page		targpage;
+	OffsetNumber targoffset,
+				maxoffset;
 
 	/*
-	 * Check that there's at least one descendant, else fail.  This could
-	 * happen despite analyze_rel's relhassubclass check, if table once had a
-	 * child but no longer does.  In that case, we can clear the
-	 * relhassubclass field so as not to make the same mistake again later.
-	 * (This is safe because we hold ShareUpdateExclusiveLock.)
+	 * We must maintain a pin on the target page's buffer to ensure that the
+	 * maxoffset value stays good (else concurrent VACUUM might delete tuples
+	 * out from under us).  Hence, the page stays pinned until we are done
+	 * looking at it.  We also choose to hold sharelock on the buffer
+	 * throughout --- we could release and re-acquire sharelock for each
+	 * tuple, but since we aren't doing much work per tuple, the extra lock
+	 * traffic is probably better avoided.
 	 */
-	if (list_length(tableOIDs) < 2)
-	{
-		/* CCI because we already updated the pg_class row in this command */
-		CommandCounterIncrement();
-		SetRelationHasSubclass(RelationGetRelid(onerel), false);
-		ereport(elevel,
-				(errmsg("skipping analyze of \"%s.%s\" inheritance tree --- this inheritance tree contains no child tables",
-						get_namespace_name(RelationGetNamespace(onerel)),
-						RelationGetRelationName(onerel))));
-		return 0;
-	}
+	LockBuffer(targbuffer, BUFFER_LOCK_SHARE);
+	targpage = BufferGetPage(targbuffer);
+	maxoffset = PageGetMaxOffsetNumber(targpage);
 
-	/*
-	 * Identify acquirefuncs to use, and count blocks in all the relations.
-	 * The result could overflow BlockNumber, so we use double arithmetic.
-	 */
-	rels = (Relation *) palloc(list_length(tableOIDs) * sizeof(Relation));
-	acquirefuncs = (AcquireSampleRowsFunc *)
-		palloc(list_length(tableOIDs) * sizeof(AcquireSampleRowsFunc));
-	relblocks = (double *) palloc(list_length(tableOIDs) * sizeof(double));
-	totalblocks = 0;
-	nrels = 0;
-	has_child = false;
-	foreach(lc, tableOIDs)
+	/* Inner loop over all tuples on the selected page */
+	for (targoffset = FirstOffsetNumber; targoffset <= maxoffset; targoffset++)
 	{
-		Oid			childOID = lfirst_oid(lc);
-		Relation	childrel;
-		AcquireSampleRowsFunc acquirefunc = NULL;
-		BlockNumber relpages = 0;
+		ItemId		itemid;
+		HeapTupleData targtuple;
+		bool		sample_it = false;
 
-		/* We already got the needed lock */
-		childrel = heap_open(childOID, NoLock);
+		itemid = PageGetItemId(targpage, targoffset);
 
-		/* Ignore if temp table of another backend */
-		if (RELATION_IS_OTHER_TEMP(childrel))
+		/*
+		 * We ignore unused and redirect line pointers.  DEAD line pointers
+		 * should be counted as dead, because we need vacuum to run to get rid
+		 * of them.  Note that this rule agrees with the way that
+		 * heap_page_prune() counts things.
+		 */
+		if (!ItemIdIsNormal(itemid))
 		{
-			/* ... but release the lock on it */
-			Assert(childrel != onerel);
-			heap_close(childrel, AccessShareLock);
+			if (ItemIdIsDead(itemid))
+				sstate->deadrows += 1;
 			continue;
 		}
 
-		/* Check table type (MATVIEW can't happen, but might as well allow) */
-		if (childrel->rd_rel->relkind == RELKIND_RELATION ||
-			childrel->rd_rel->relkind == RELKIND_MATVIEW)
-		{
-			/* Regular table, so use the regular row acquisition function */
-			acquirefunc = acquire_sample_rows;
-			relpages = RelationGetNumberOfBlocks(childrel);
-		}
-		else if (childrel->rd_rel->relkind == RELKIND_FOREIGN_TABLE)
+		ItemPointerSet(&targtuple.t_self, targblock, targoffset);
+
+		targtuple.t_tableOid = RelationGetRelid(onerel);
+		targtuple.t_data = (HeapTupleHeader) PageGetItem(targpage, itemid);
+		targtuple.t_len = ItemIdGetLength(itemid);
+
+		switch (HeapTupleSatisfiesVacuum(&targtuple,
+										 OldestXmin,
+										 targbuffer))
 		{
-			/*
-			 * For a foreign table, call the FDW's hook function to see
-			 * whether it supports analysis.
-			 */
-			FdwRoutine *fdwroutine;
-			bool		ok = false;
+			case HEAPTUPLE_LIVE:
+				sample_it = true;
+				sstate->liverows += 1;
+				break;
 
-			fdwroutine = GetFdwRoutineForRelation(childrel, false);
+			case HEAPTUPLE_DEAD:
+			case HEAPTUPLE_RECENTLY_DEAD:
+				/* Count dead and recently-dead rows */
+				sstate->deadrows += 1;
+				break;
 
-			if (fdwroutine->AnalyzeForeignTable != NULL)
-				ok = fdwroutine->AnalyzeForeignTable(childrel,
-													 &acquirefunc,
-													 &relpages);
+			case HEAPTUPLE_INSERT_IN_PROGRESS:
 
-			if (!ok)
-			{
-				/* ignore, but release the lock on it */
-				Assert(childrel != onerel);
-				heap_close(childrel, AccessShareLock);
-				continue;
-			}
+				/*
+				 * Insert-in-progress rows are not counted.  We assume that
+				 * when the inserting transaction commits or aborts, it will
+				 * send a stats message to increment the proper count.  This
+				 * works right only if that transaction ends after we finish
+				 * analyzing the table; if things happen in the other order,
+				 * its stats update will be overwritten by ours.  However, the
+				 * error will be large only if the other transaction runs long
+				 * enough to insert many tuples, so assuming it will finish
+				 * after us is the safer option.
+				 *
+				 * A special case is that the inserting transaction might be
+				 * our own.  In this case we should count and sample the row,
+				 * to accommodate users who load a table and analyze it in one
+				 * transaction.  (pgstat_report_analyze has to adjust the
+				 * numbers we send to the stats collector to make this come
+				 * out right.)
+				 */
+				if (TransactionIdIsCurrentTransactionId(HeapTupleHeaderGetXmin(targtuple.t_data)))
+				{
+					sample_it = true;
+					sstate->liverows += 1;
+				}
+				break;
+
+			case HEAPTUPLE_DELETE_IN_PROGRESS:
+
+				/*
+				 * We count delete-in-progress rows as still live, using the
+				 * same reasoning given above; but we don't bother to include
+				 * them in the sample.
+				 *
+				 * If the delete was done by our own transaction, however, we
+				 * must count the row as dead to make pgstat_report_analyze's
+				 * stats adjustments come out right.  (Note: this works out
+				 * properly when the row was both inserted and deleted in our
+				 * xact.)
+				 */
+				if (TransactionIdIsCurrentTransactionId(HeapTupleHeaderGetUpdateXid(targtuple.t_data)))
+					sstate->deadrows += 1;
+				else
+					sstate->liverows += 1;
+				break;
+
+			default:
+				elog(ERROR, "unexpected HeapTupleSatisfiesVacuum result");
+				break;
 		}
-		else
+
+		if (sample_it)
 		{
 			/*
-			 * ignore, but release the lock on it.  don't try to unlock the
-			 * passed-in relation
+			 * The first targrows sample rows are simply copied into the
+			 * reservoir. Then we start replacing tuples in the sample until
+			 * we reach the end of the relation.  This algorithm is from Jeff
+			 * Vitter's paper (see full citation below). It works by
+			 * repeatedly computing the number of tuples to skip before
+			 * selecting a tuple, which replaces a randomly chosen element of
+			 * the reservoir (current set of tuples).  At all times the
+			 * reservoir is a true random sample of the tuples we've passed
+			 * over so far, so when we fall off the end of the relation we're
+			 * done.
 			 */
-			Assert(childrel->rd_rel->relkind == RELKIND_PARTITIONED_TABLE);
-			if (childrel != onerel)
-				heap_close(childrel, AccessShareLock);
+			if (sstate->numrows < targrows)
+				rows[sstate->numrows++] = heap_copytuple(&targtuple);
 			else
-				heap_close(childrel, NoLock);
-			continue;
-		}
+			{
+				/*
+				 * t in Vitter's paper is the number of records already
+				 * processed.  If we need to compute a new S value, we must
+				 * use the not-yet-incremented value of samplerows as t.
+				 */
+				if (sstate->rowstoskip < 0)
+					sstate->rowstoskip = reservoir_get_next_S(&sstate->rstate,
+															  sstate->samplerows,
+															  targrows);
 
-		/* OK, we'll process this child */
-		has_child = true;
-		rels[nrels] = childrel;
-		acquirefuncs[nrels] = acquirefunc;
-		relblocks[nrels] = (double) relpages;
-		totalblocks += (double) relpages;
-		nrels++;
+				if (sstate->rowstoskip <= 0)
+				{
+					/*
+					 * Found a suitable tuple, so save it, replacing one old
+					 * tuple at random
+					 */
+					int			k = (int) (targrows * sampler_random_fract(sstate->rstate.randstate));
+
+					Assert(k >= 0 && k < targrows);
+					heap_freetuple(rows[k]);
+					rows[k] = heap_copytuple(&targtuple);
+				}
+
+				sstate->rowstoskip -= 1;
+			}
+
+			sstate->samplerows += 1;
+		}
 	}
 
-	/*
-	 * If we don't have at least one child table to consider, fail.  If the
-	 * relation is a partitioned table, it's not counted as a child table.
-	 */
-	if (!has_child)
-	{
-		ereport(elevel,
-				(errmsg("skipping analyze of \"%s.%s\" inheritance tree --- this inheritance tree contains no analyzable child tables",
-						get_namespace_name(RelationGetNamespace(onerel)),
-						RelationGetRelationName(onerel))));
-		return 0;
-	}
+	/* Now release the lock and pin on the page */
+	UnlockReleaseBuffer(targbuffer);
+}
+
+/*
+ * analyze_parallel_workers -- choose how many workers to sample a relation
+ *		with, given the number of blocks to read
+ *
+ * As for a parallel sequential scan, we ask for one worker once the blocks
+ * to read add up to min_parallel_table_scan_size, and for one more each time
+ * that amount triples.  The parallel_workers reloption overrides that, and
+ * max_parallel_maintenance_workers caps the result.
+ */
+static int
+analyze_parallel_workers(Relation onerel, BlockNumber nblocks)
+{
+	int			parallel_workers;
 
 	/*
-	 * Now sample rows from each relation, proportionally to its fraction of
-	 * the total block count.  (This might be less than desirable if the child
-	 * rels have radically different free-space percentages, but it's not
-	 * clear that it's worth working harder.)
+	 * Workers can't read the leader's local buffers, nor be launched from
+	 * within another parallel operation.  They also need a snapshot to be
+	 * handed over, though they don't actually use it.
 	 */
-	numrows = 0;
-	*totalrows = 0;
-	*totaldeadrows = 0;
-	for (i = 0; i < nrels; i++)
+	if (max_parallel_maintenance_workers == 0 ||
+		RelationUsesLocalBuffers(onerel) ||
+		IsInParallelMode() ||
+		!ActiveSnapshotSet())
+		return 0;
+
+	parallel_workers = RelationGetParallelWorkers(onerel, -1);
+	if (parallel_workers < 0)
 	{
-		Relation	childrel = rels[i];
-		AcquireSampleRowsFunc acquirefunc = acquirefuncs[i];
-		double		childblocks = relblocks[i];
+		BlockNumber threshold = Max(min_parallel_table_scan_size, 1);
 
-		if (childblocks > 0)
+		parallel_workers = 0;
+		while (nblocks >= threshold)
 		{
-			int			childtargrows;
-
-			childtargrows = (int) rint(targrows * childblocks / totalblocks);
-			/* Make sure we don't overrun due to roundoff error */
-			childtargrows = Min(childtargrows, targrows - numrows);
-			if (childtargrows > 0)
-			{
-				int			childrows;
-				double		trows,
-							tdrows;
-
-				/* Fetch a random sample of the child's rows */
-				childrows = (*acquirefunc) (childrel, elevel,
-											rows + numrows, childtargrows,
-											&trows, &tdrows);
-
-				/* We may need to convert from child's rowtype to parent's */
-				if (childrows > 0 &&
-					!equalTupleDescs(RelationGetDescr(childrel),
-									 RelationGetDescr(onerel)))
-				{
-					TupleConversionMap *map;
-
-					map = convert_tuples_by_name(RelationGetDescr(childrel),
-												 RelationGetDescr(onerel),
-												 gettext_noop("could not convert row type"));
-					if (map != NULL)
-					{
-						int			j;
-
-						for (j = 0; j < childrows; j++)
-						{
-							HeapTuple	newtup;
-
-							newtup = do_convert_tuple(rows[numrows + j], map);
-							heap_freetuple(rows[numrows + j]);
-							rows[numrows + j] = newtup;
-						}
-						free_conversion_map(map);
-					}
-				}
-
-				/* And add to counts */
-				numrows += childrows;
-				*totalrows += trows;
-				*totaldeadrows += tdrows;
-			}
+			parallel_workers++;
+			if (threshold > MaxBlockNumber / 3)
+				break;
+			threshold *= 3;
 		}
-
-		/*
-		 * Note: we cannot release the child-table locks, since we may have
-		 * pointers to their TOAST tables in the sampled rows.
-		 */
-		heap_close(childrel, NoLock);
 	}
 
-	return numrows;
+	return Min(parallel_workers, max_parallel_maintenance_workers);
 }
 
-
 /*
- *	update_attstats() -- update attribute statistics for one relation
- *
- *		Statistics are stored in several places: the pg_class row for the
- *		relation has stats about the whole relation, and there is a
- *		pg_statistic row for each (non-system) attribute that has ever
- *		been analyzed.  The pg_class values are updated by VACUUM, not here.
- *
- *		pg_statistic rows are just added or updated normally.  This means
- *		that pg_statistic will probably contain some deleted rows at the
- *		completion of a vacuum cycle, unless it happens to get vacuumed last.
+ * acquire_sample_rows_parallel -- read the blocks chosen by the block
+ *		sampler with the help of parallel workers
  *
- *		To keep things simple, we punt for pg_statistic, and don't try
- *		to compute or store rows for pg_statistic itself in pg_statistic.
- *		This could possibly be made to work, but it's not worth the trouble.
- *		Note analyze_rel() has seen to it that we won't come here when
- *		vacuuming pg_statistic itself.
+ * Every participant builds a reservoir sample of the rows in the blocks it
+ * happened to read.  The leader then draws the final sample from those,
+ * taking each row from a participant with probability proportional to the
+ * number of rows that participant saw and has not contributed yet.  So, as
+ * in the serial case, every row of the chosen blocks is equally likely to
+ * end up in the sample.
  *
- *		Note: there would be a race condition here if two backends could
- *		ANALYZE the same table concurrently.  Presently, we lock that out
- *		by taking a self-exclusive lock on the relation in analyze_rel().
+ * If no worker can be launched, the leader simply reads all the blocks
+ * itself.
  */
 static void
-update_attstats(Oid relid, bool inh, int natts, VacAttrStats **vacattrstats)
+acquire_sample_rows_parallel(Relation onerel, BlockSampler bs,
+							 BlockNumber maxblocks, TransactionId OldestXmin,
+							 AnlSampleState *sstate, int nworkers)
 {
-	Relation	sd;
-	int			attno;
-
-	if (natts <= 0)
-		return;					/* nothing to do */
-
-	sd = heap_open(StatisticRelationId, RowExclusiveLock);
+	ParallelContext *pcxt;
+	AnlParallelShared *shared;
+	AnlSampleState *wstates;
+	shm_mq_handle **mqh;
+	char	   *mqspace;
+	Size		estshared;
+	int			nblocks;
+	int			nlaunched;
+	int			i;
 
-	for (attno = 0; attno < natts; attno++)
+	EnterParallelMode();
+	pcxt = CreateParallelContext("postgres", "parallel_analyze_main",
+								 nworkers, true);
+
+	/* Estimate space for the shared state and the workers' queues */
+	estshared = add_size(offsetof(AnlParallelShared, blocks),
+						 mul_size(sizeof(BlockNumber), maxblocks));
+	shm_toc_estimate_chunk(&pcxt->estimator, estshared);
+	shm_toc_estimate_chunk(&pcxt->estimator,
+						   mul_size(ANALYZE_QUEUE_SIZE, pcxt->nworkers));
+	shm_toc_estimate_keys(&pcxt->estimator, 2);
+
+	InitializeParallelDSM(pcxt);
+
+	/* Store the shared state, including all the blocks to read */
+	shared = (AnlParallelShared *) shm_toc_allocate(pcxt->toc, estshared);
+	shared->relid = RelationGetRelid(onerel);
+	shared->OldestXmin = OldestXmin;
+	shared->targrows = sstate->targrows;
+	shared->seed = (uint32) random();
+	pg_atomic_init_u32(&shared->nextblock, 0);
+	nblocks = 0;
+	while (BlockSampler_HasMore(bs))
+		shared->blocks[nblocks++] = BlockSampler_Next(bs);
+	Assert(nblocks <= maxblocks);
+	shared->nblocks = nblocks;
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_ANALYZE_SHARED, shared);
+
+	/* Set up a queue for each worker to send its sample through */
+	mqspace = shm_toc_allocate(pcxt->toc,
+							   mul_size(ANALYZE_QUEUE_SIZE, pcxt->nworkers));
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_ANALYZE_QUEUES, mqspace);
+	mqh = (shm_mq_handle **) palloc(pcxt->nworkers * sizeof(shm_mq_handle *));
+	for (i = 0; i < pcxt->nworkers; i++)
 	{
-		VacAttrStats *stats = vacattrstats[attno];
-		HeapTuple	stup,
-					oldtup;
-		int			i,
-					k,
-					n;
-		Datum		values[Natts_pg_statistic];
-		bool		nulls[Natts_pg_statistic];
-		bool		replaces[Natts_pg_statistic];
+		shm_mq	   *mq;
 
-		/* Ignore attr if we weren't able to collect stats */
-		if (!stats->stats_valid)
-			continue;
+		mq = shm_mq_create(mqspace + (Size) i * ANALYZE_QUEUE_SIZE,
+						   ANALYZE_QUEUE_SIZE);
+		shm_mq_set_receiver(mq, MyProc);
+		mqh[i] = shm_mq_attach(mq, pcxt->seg, NULL);
+	}
 
-		/*
-		 * Construct a new pg_statistic tuple
-		 */
-		for (i = 0; i < Natts_pg_statistic; ++i)
-		{
-			nulls[i] = false;
-			replaces[i] = true;
-		}
+	LaunchParallelWorkers(pcxt);
+	nlaunched = pcxt->nworkers_launched;
+	for (i = 0; i < nlaunched; i++)
+		shm_mq_set_handle(mqh[i], pcxt->worker[i].bgwhandle);
 
-		values[Anum_pg_statistic_starelid - 1] = ObjectIdGetDatum(relid);
-		values[Anum_pg_statistic_staattnum - 1] = Int16GetDatum(stats->attr->attnum);
-		values[Anum_pg_statistic_stainherit - 1] = BoolGetDatum(inh);
-		values[Anum_pg_statistic_stanullfrac - 1] = Float4GetDatum(stats->stanullfrac);
-		values[Anum_pg_statistic_stawidth - 1] = Int32GetDatum(stats->stawidth);
-		values[Anum_pg_statistic_stadistinct - 1] = Float4GetDatum(stats->stadistinct);
-		i = Anum_pg_statistic_stakind1 - 1;
-		for (k = 0; k < STATISTIC_NUM_SLOTS; k++)
-		{
-			values[i++] = Int16GetDatum(stats->stakind[k]); /* stakindN */
-		}
-		i = Anum_pg_statistic_staop1 - 1;
-		for (k = 0; k < STATISTIC_NUM_SLOTS; k++)
-		{
-			values[i++] = ObjectIdGetDatum(stats->staop[k]);	/* staopN */
-		}
-		i = Anum_pg_statistic_stanumbers1 - 1;
-		for (k = 0; k < STATISTIC_NUM_SLOTS; k++)
-		{
-			int			nnum = stats->numnumbers[k];
+	/* Read blocks ourselves until none are left */
+	sample_shared_blocks(onerel, shared, sstate);
 
-			if (nnum > 0)
-			{
-				Datum	   *numdatums = (Datum *) palloc(nnum * sizeof(Datum));
-				ArrayType  *arry;
+	/* Collect the workers' samples */
+	wstates = (AnlSampleState *) palloc0(Max(nlaunched, 1) *
+										 sizeof(AnlSampleState));
+	for (i = 0; i < nlaunched; i++)
+		receive_worker_sample(mqh[i], shared->relid, &wstates[i]);
 
-				for (n = 0; n < nnum; n++)
-					numdatums[n] = Float4GetDatum(stats->stanumbers[k][n]);
-				/* XXX knows more than it should about type float4: */
-				arry = construct_array(numdatums, nnum,
-									   FLOAT4OID,
-									   sizeof(float4), FLOAT4PASSBYVAL, 'i');
-				values[i++] = PointerGetDatum(arry);	/* stanumbersN */
-			}
-			else
-			{
-				nulls[i] = true;
-				values[i++] = (Datum) 0;
-			}
-		}
-		i = Anum_pg_statistic_stavalues1 - 1;
-		for (k = 0; k < STATISTIC_NUM_SLOTS; k++)
-		{
-			if (stats->numvalues[k] > 0)
-			{
-				ArrayType  *arry;
+	WaitForParallelWorkersToFinish(pcxt);
+	DestroyParallelContext(pcxt);
+	ExitParallelMode();
 
-				arry = construct_array(stats->stavalues[k],
-									   stats->numvalues[k],
-									   stats->statypid[k],
-									   stats->statyplen[k],
-									   stats->statypbyval[k],
-									   stats->statypalign[k]);
-				values[i++] = PointerGetDatum(arry);	/* stavaluesN */
-			}
-			else
-			{
-				nulls[i] = true;
-				values[i++] = (Datum) 0;
-			}
-		}
+	merge_samples(sstate, wstates, nlaunched);
+}
 
-		/* Is there already a pg_statistic tuple for this attribute? */
-		oldtup = SearchSysCache3(STATRELATTINH,
-								 ObjectIdGetDatum(relid),
-								 Int16GetDatum(stats->attr->attnum),
-								 BoolGetDatum(inh));
+/*
+ * sample_shared_blocks -- take part in a parallel sample
+ */
+static void
+sample_shared_blocks(Relation onerel, AnlParallelShared *shared,
+					 AnlSampleState *sstate)
+{
+	ReadStream *stream;
+	Buffer		targbuffer;
 
-		if (HeapTupleIsValid(oldtup))
-		{
-			/* Yes, replace it */
-			stup = heap_modify_tuple(oldtup,
-									 RelationGetDescr(sd),
-									 values,
-									 nulls,
-									 replaces);
-			ReleaseSysCache(oldtup);
-			CatalogTupleUpdate(sd, &stup->t_self, stup);
-		}
-		else
-		{
-			/* No, insert new tuple */
-			stup = heap_form_tuple(RelationGetDescr(sd), values, nulls);
-			CatalogTupleInsert(sd, stup);
-		}
+	/* Blocks are claimed as the stream reads ahead */
+	stream = read_stream_begin_relation(onerel, MAIN_FORKNUM, vac_strategy,
+										sample_shared_blocks_next, shared, 0);
+	for (;;)
+	{
+		vacuum_delay_point();
 
-		heap_freetuple(stup);
-	}
+		targbuffer = read_stream_next_buffer(stream, NULL);
+		if (!BufferIsValid(targbuffer))
+			break;
 
-	heap_close(sd, RowExclusiveLock);
+		acquire_sample_rows_block(onerel, targbuffer, shared->OldestXmin,
+								  sstate);
+	}
+	read_stream_end(stream);
 }
 
 /*
- * Standard fetch function for use by compute_stats subroutines.
- *
- * This exists to provide some insulation between compute_stats routines
- * and the actual storage of the sample data.
+ * sample_shared_blocks_next -- read stream callback claiming shared blocks
  */
-static Datum
-std_fetch_func(VacAttrStatsP stats, int rownum, bool *isNull)
+static BlockNumber
+sample_shared_blocks_next(ReadStream *stream, void *callback_private_data,
+						  void *per_buffer_data)
 {
-	int			attnum = stats->tupattnum;
-	HeapTuple	tuple = stats->rows[rownum];
-	TupleDesc	tupDesc = stats->tupDesc;
+	AnlParallelShared *shared = (AnlParallelShared *) callback_private_data;
+	uint32		i = pg_atomic_fetch_add_u32(&shared->nextblock, 1);
 
-	return heap_getattr(tuple, attnum, tupDesc, isNull);
+	if (i >= shared->nblocks)
+		return InvalidBlockNumber;
+	return shared->blocks[i];
 }
 
 /*
- * Fetch function for analyzing index expressions.
+ * receive_worker_sample -- read the sample of one parallel worker
  *
- * We have not bothered to construct index tuples, instead the data is
- * just in Datum arrays.
+ * A worker that exits without sending anything is taken to have read no
+ * blocks; if it failed, the error is reported when we wait for it to finish.
  */
-static Datum
-ind_fetch_func(VacAttrStatsP stats, int rownum, bool *isNull)
+static void
+receive_worker_sample(shm_mq_handle *mqh, Oid relid, AnlSampleState *wstate)
 {
-	int			i;
+	AnlWorkerSummary summary;
+	Size		nbytes;
+	void	   *data;
 
-	/* exprvals and exprnulls are already offset for proper column */
-	i = rownum * stats->rowstride;
-	*isNull = stats->exprnulls[i];
-	return stats->exprvals[i];
+	if (shm_mq_receive(mqh, &nbytes, &data, false) != SHM_MQ_SUCCESS)
+		return;
+	if (nbytes != sizeof(AnlWorkerSummary))
+		elog(ERROR, "invalid message from parallel ANALYZE worker");
+	memcpy(&summary, data, sizeof(AnlWorkerSummary));
+
+	wstate->rows = (HeapTuple *) palloc(Max(summary.numrows, 1) *
+										sizeof(HeapTuple));
+	wstate->samplerows = summary.samplerows;
+	wstate->liverows = summary.liverows;
+	wstate->deadrows = summary.deadrows;
+
+	while (wstate->numrows < summary.numrows)
+	{
+		HeapTuple	tuple;
+
+		if (shm_mq_receive(mqh, &nbytes, &data, false) != SHM_MQ_SUCCESS)
+			elog(ERROR, "lost connection to parallel ANALYZE worker");
+		if (nbytes < sizeof(ItemPointerData) + SizeofHeapTupleHeader)
+			elog(ERROR, "invalid message from parallel ANALYZE worker");
+
+		/* Each row arrives as its TID followed by the tuple proper */
+		nbytes -= sizeof(ItemPointerData);
+		tuple = (HeapTuple) palloc(HEAPTUPLESIZE + nbytes);
+		memcpy(&tuple->t_self, data, sizeof(ItemPointerData));
+		tuple->t_len = nbytes;
+		tuple->t_tableOid = relid;
+		tuple->t_data = (HeapTupleHeader) ((char *) tuple + HEAPTUPLESIZE);
+		memcpy(tuple->t_data, (char *) data + sizeof(ItemPointerData), nbytes);
+
+		wstate->rows[wstate->numrows++] = tuple;
+	}
 }
 
+/*
+ * merge_samples -- combine the samples of the participants of a parallel
+ *		sample into sstate, which holds the leader's own
+ */
+static void
+merge_samples(AnlSampleState *sstate, AnlSampleState *wstates, int nworkers)
+{
+	int			nparts = nworkers + 1;
+	AnlSampleState *parts;
+	double		remaining;
+	int			numrows = 0;
+	int			p;
+
+	/* Move the leader's sample out of the way of the final one */
+	parts = (AnlSampleState *) palloc(nparts * sizeof(AnlSampleState));
+	parts[0] = *sstate;
+	parts[0].rows = (HeapTuple *) palloc(Max(sstate->numrows, 1) *
+										 sizeof(HeapTuple));
+	memcpy(parts[0].rows, sstate->rows, sstate->numrows * sizeof(HeapTuple));
+	memcpy(parts + 1, wstates, nworkers * sizeof(AnlSampleState));
+
+	remaining = 0;
+	for (p = 0; p < nparts; p++)
+		remaining += parts[p].samplerows;
 
-/*==========================================================================
- *
- * Code below this point represents the "standard" type-specific statistics
- * analysis algorithms.  This code can be replaced on a per-data-type basis
- * by setting a nonzero value in pg_type.typanalyze.
- *
- *==========================================================================
- */
-
+	/*
+	 * Each participant's reservoir holds min(targrows, samplerows) rows, so
+	 * it can't run dry before we've taken all the rows we want from it.
+	 */
+	while (numrows < sstate->targrows && remaining > 0)
+	{
+		double		r = remaining * sampler_random_fract(sstate->rstate.randstate);
+		int			k;
 
-/*
- * To avoid consuming too much memory during analysis and/or too much space
- * in the resulting pg_statistic rows, we ignore varlena datums that are wider
- * than WIDTH_THRESHOLD (after detoasting!).  This is legitimate for MCV
- * and distinct-value calculations since a wide value is unlikely to be
- * duplicated at all, much less be a most-common value.  For the same reason,
- * ignoring wide values will not affect our estimates of histogram bin
- * boundaries very much.
- */
-#define WIDTH_THRESHOLD  1024
+		for (p = 0; p < nparts - 1; p++)
+		{
+			if (r < parts[p].samplerows)
+				break;
+			r -= parts[p].samplerows;
+		}
+		/* Guard against roundoff landing us on an exhausted participant */
+		while (parts[p].samplerows <= 0)
+			p = (p + nparts - 1) % nparts;
+		Assert(parts[p].numrows > 0);
+
+		k = (int) (parts[p].numrows * sampler_random_fract(sstate->rstate.randstate));
+		sstate->rows[numrows++] = parts[p].rows[k];
+		parts[p].rows[k] = parts[p].rows[--parts[p].numrows];
+		parts[p].samplerows -= 1;
+		remaining -= 1;
+	}
 
-#define swapInt(a,b)	do {int _tmp; _tmp=a; a=b; b=_tmp;} while(0)
-#define swapDatum(a,b)	do {Datum _tmp; _tmp=a; a=b; b=_tmp;} while(0)
+	/* Release the rows that didn't make it, and add up the counts */
+	sstate->numrows = numrows;
+	for (p = 0; p < nparts; p++)
+	{
+		while (parts[p].numrows > 0)
+			heap_freetuple(parts[p].rows[--parts[p].numrows]);
+		if (p > 0)
+		{
+			sstate->liverows += parts[p].liverows;
+			sstate->deadrows += parts[p].deadrows;
+		}
+	}
+}
 
 /*
- * Extra information used by the default analysis routines
+ * parallel_analyze_main -- entry point of a parallel ANALYZE worker
  */
-typedef struct
-{
-	int			count;			/* # of duplicates */
-	int			first;			/* values[] index of first occurrence */
-} ScalarMCVItem;
-
-typedef struct
+void
+parallel_analyze_main(dsm_segment *seg, shm_toc *toc)
 {
-	SortSupport ssup;
-	int		   *tupnoLink;
-} CompareScalarsContext;
+	AnlParallelShared *shared;
+	AnlSampleState sstate;
+	AnlWorkerSummary summary;
+	Relation	onerel;
+	char	   *mqspace;
+	shm_mq	   *mq;
+	shm_mq_handle *mqh;
+	int			i;
 
+	shared = shm_toc_lookup(toc, PARALLEL_KEY_ANALYZE_SHARED, false);
+
+	/* Attach to our queue */
+	mqspace = shm_toc_lookup(toc, PARALLEL_KEY_ANALYZE_QUEUES, false);
+	mq = (shm_mq *) (mqspace + (Size) ParallelWorkerNumber * ANALYZE_QUEUE_SIZE);
+	shm_mq_set_sender(mq, MyProc);
+	mqh = shm_mq_attach(mq, seg, NULL);
+
+	/* The leader already holds a lock strong enough for us */
+	onerel = heap_open(shared->relid, AccessShareLock);
+	vac_strategy = GetAccessStrategy(BAS_VACUUM);
+
+	sstate.rows = (HeapTuple *) palloc(shared->targrows * sizeof(HeapTuple));
+	sstate.targrows = shared->targrows;
+	sstate.numrows = 0;
+	sstate.samplerows = 0;
+	sstate.liverows = 0;
+	sstate.deadrows = 0;
+	sstate.rowstoskip = -1;
+	reservoir_init_selection_state(&sstate.rstate, shared->targrows);
+	/* Don't draw the same random numbers as the other participants */
+	sampler_random_init_state(shared->seed + ParallelWorkerNumber + 1,
+							  sstate.rstate.randstate);
+
+	sample_shared_blocks(onerel, shared, &sstate);
+
+	/* Send the counts, then the rows */
+	summary.numrows = sstate.numrows;
+	summary.samplerows = sstate.samplerows;
+	summary.liverows = sstate.liverows;
+	summary.deadrows = sstate.deadrows;
+	if (shm_mq_send(mqh, sizeof(AnlWorkerSummary), &summary,
+					false) == SHM_MQ_SUCCESS)
+	{
+		for (i = 0; i < sstate.numrows; i++)
+		{
+			shm_mq_iovec iov[2];
 
-static void compute_trivial_stats(VacAttrStatsP stats,
-					  AnalyzeAttrFetchFunc fetchfunc,
-					  int samplerows,
-					  double totalrows);
-static void compute_distinct_stats(VacAttrStatsP stats,
-					   AnalyzeAttrFetchFunc fetchfunc,
-					   int samplerows,
-					   double totalrows);
-static void compute_scalar_stats(VacAttrStatsP stats,
-					 AnalyzeAttrFetchFunc fetchfunc,
-					 int samplerows,
-					 double totalrows);
-static int	compare_scalars(const void *a, const void *b, void *arg);
-static int	compare_mcvs(const void *a, const void *b);
+			iov[0].data = (const char *) &sstate.rows[i]->t_self;
+			iov[0].len = sizeof(ItemPointerData);
+			iov[1].data = (const char *) sstate.rows[i]->t_data;
+			iov[1].len = sstate.rows[i]->t_len;
+			if (shm_mq_sendv(mqh, iov, 2, false) != SHM_MQ_SUCCESS)
+				break;
+		}
+	}
 
+	heap_close(onerel, AccessShareLock);
+}
 
 /*
- * std_typanalyze -- the default type-specific typanalyze function
+ * qsort comparator for sorting rows[] array
  */
-bool
-std_typanalyze(VacAttrStats *stats)
+static int
+compare_rows(const void *a, const void *b)
 {
-	Form_pg_attribute attr = stats->attr;
-	Oid			ltopr;
-	Oid			eqopr;
-	StdAnalyzeData *mystats;
-
-	/* If the attstattarget column is negative, use the default value */
-	/* NB: it is okay to scribble on stats->attr since it's a copy */
-	if (attr->attstattarget < 0)
-		attr->attstattarget = default_statistics_target;
-
-	/* Look for default "<" and "=" operators for column's type */
-	get_sort_group_operators(stats->attrtypid,
-							 false, false, false,
-							 &ltopr, &eqopr, NULL,
-							 NULL);
-
-	/* Save the operator info for compute_stats routines */
-	mystats = (StdAnalyzeData *) palloc(sizeof(StdAnalyzeData));
-	mystats->eqopr = eqopr;
-	mystats->eqfunc = OidIsValid(eqopr) ? get_opcode(eqopr) : InvalidOid;
-	mystats->ltopr = ltopr;
-	stats->extra_data = mystats;
-
-	/*
-	 * Determine which standard statistics algorithm to use
-	 */
-	if (OidIsValid(eqopr) && OidIsValid(ltopr))
-	{
-		/* Seems to be a scalar datatype */
-		stats->compute_stats = compute_scalar_stats;
-		/*--------------------
-		 * The following choice of minrows is based on the paper
-		 * "Random sampling for histogram construction: how much is enough?"
-		 * by Surajit Chaudhuri, Rajeev Motwani and Vivek Narasayya, in
-		 * Proceedings of ACM SIGMOD International Conference on Management
-		 * of Data, 1998, Pages 436-447.  Their Corollary 1 to Theorem 5
-		 * says that for table size n, histogram size k, maximum relative
-		 * error in bin size f, and error probability gamma, the minimum
-		 * random sample size is
-		 *		r = 4 * k * ln(2*n/gamma) / f^2
-		 * Taking f = 0.5, gamma = 0.01, n = 10^6 rows, we obtain
-		 *		r = 305.82 * k
-		 * Note that because of the log function, the dependence on n is
-		 * quite weak; even at n = 10^12, a 300*k sample gives <= 0.66
-		 * bin size error with probability 0.99.  So there's no real need to
-		 * scale for n, which is a good thing because we don't necessarily
-		 * know it at this point.
-		 *--------------------
-		 */
-		stats->minrows = 300 * attr->attstattarget;
-	}
-	else if (OidIsValid(eqopr))
-	{
-		/* We can still recognize distinct values */
-		stats->compute_stats = compute_distinct_stats;
-		/* Might as well use the same minrows as above */
-		stats->minrows = 300 * attr->attstattarget;
-	}
-	else
-	{
-		/* Can't do much but the trivial stuff */
-		stats->compute_stats = compute_trivial_stats;
-		/* Might as well use the same minrows as above */
-		stats->minrows = 300 * attr->attstattarget;
-	}
+	HeapTuple	ha = *(const HeapTuple *) a;
+	HeapTuple	hb = *(const HeapTuple *) b;
+	BlockNumber ba = ItemPointerGetBlockNumber(&ha->t_self);
+	OffsetNumber oa = ItemPointerGetOffsetNumber(&ha->t_self);
+	BlockNumber bb = ItemPointerGetBlockNumber(&hb->t_self);
+	OffsetNumber ob = ItemPointerGetOffsetNumber(&hb->t_self);
 
-	return true;
+	if (ba < bb)
+		return -1;
+	if (ba > bb)
+		return 1;
+	if (oa < ob)
+		return -1;
+	if (oa > ob)
+		return 1;
+	return 0;
 }
 
 
 /*
- *	compute_trivial_stats() -- compute very basic column statistics
- *
- *	We use this when we cannot find a hash "=" operator for the datatype.
+ * acquire_inherited_sample_rows -- acquire sample rows from inheritance tree
  *
- *	We determine the fraction of non-null rows and the average datum width.
+ * This has the same API as acquire_sample_rows, except that rows are
+ * collected from all inheritance children as well as the specified table.
+ * We fail and return zero if there are no inheritance children, or if all
+ * children are foreign tables that don't support ANALYZE.
  */
-static void
-compute_trivial_stats(VacAttrStatsP stats,
-					  AnalyzeAttrFetchFunc fetchfunc,
-					  int samplerows,
-					  double totalrows)
+static int
+acquire_inherited_sample_rows(Relation onerel, int elevel,
+							  HeapTuple *rows, int targrows,
+							  double *totalrows, double *totaldeadrows)
 {
-	int			i;
-	int			null_cnt = 0;
-	int			nonnull_cnt = 0;
-	double		total_width = 0;
-	bool		is_varlena = (!stats->attrtype->typbyval &&
-							  stats->attrtype->typlen == -1);
-	bool		is_varwidth = (!stats->attrtype->typbyval &&
-							   stats->attrtype->typlen < 0);
+	List	   *tableOIDs;
+	Relation   *rels;
+	AcquireSampleRowsFunc *acquirefuncs;
+	double	   *relblocks;
+	double		totalblocks;
+	int			numrows,
+				nrels,
+				i;
+	ListCell   *lc;
+	bool		has_child;
 
-	for (i = 0; i < samplerows; i++)
+	/*
+	 * Find all members of inheritance set.  We only need AccessShareLock on
+	 * the children.
+	 */
+	tableOIDs =
+		find_all_inheritors(RelationGetRelid(onerel), AccessShareLock, NULL);
+
+	/*
+	 * Check that there's at least one descendant, else fail.  This could
+	 * happen despite analyze_rel's relhassubclass check, if table once had a
+	 * child but no longer does.  In that case, we can clear the
+	 * relhassubclass field so as not to make the same mistake again later.
+	 * (This is safe because we hold ShareUpdateExclusiveLock.)
+	 */
+	if (list_length(tableOIDs) < 2)
 	{
-		Datum		value;
-		bool		isnull;
+		/* CCI because we already updated the pg_class row in this command */
+		CommandCounterIncrement();
+		SetRelationHasSubclass(RelationGetRelid(onerel), false);
+		ereport(elevel,
+				(errmsg("skipping analyze of \"%s.%s\" inheritance tree --- this inheritance tree contains no child tables",
+						get_namespace_name(RelationGetNamespace(onerel)),
+						RelationGetRelationName(onerel))));
+		return 0;
+	}
 
-		vacuum_delay_point();
+	/*
+	 * Identify acquirefuncs to use, and count blocks in all the relations.
+	 * The result could overflow BlockNumber, so we use double arithmetic.
+	 */
+	rels = (Relation *) palloc(list_length(tableOIDs) * sizeof(Relation));
+	acquirefuncs = (AcquireSampleRowsFunc *)
+		palloc(list_length(tableOIDs) * sizeof(AcquireSampleRowsFunc));
+	relblocks = (double *) palloc(list_length(tableOIDs) * sizeof(double));
+	totalblocks = 0;
+	nrels = 0;
+	has_child = false;
+	foreach(lc, tableOIDs)
+	{
+		Oid			childOID = lfirst_oid(lc);
+		Relation	childrel;
+		AcquireSampleRowsFunc acquirefunc = NULL;
+		BlockNumber relpages = 0;
 
-		value = fetchfunc(stats, i, &isnull);
+		/* We already got the needed lock */
+		childrel = heap_open(childOID, NoLock);
 
-		/* Check for null/nonnull */
-		if (isnull)
+		/* Ignore if temp table of another backend */
+		if (RELATION_IS_OTHER_TEMP(childrel))
 		{
-			null_cnt++;
+			/* ... but release the lock on it */
+			Assert(childrel != onerel);
+			heap_close(childrel, AccessShareLock);
 			continue;
 		}
-		nonnull_cnt++;
 
-		/*
-		 * If it's a variable-width field, add up widths for average width
-		 * calculation.  Note that if the value is toasted, we use the toasted
-		 * width.  We don't bother with this calculation if it's a fixed-width
-		 * type.
-		 */
-		if (is_varlena)
-		{
-			total_width += VARSIZE_ANY(DatumGetPointer(value));
+		/* Check table type (MATVIEW can't happen, but might as well allow) */
+		if (childrel->rd_rel->relkind == RELKIND_RELATION ||
+			childrel->rd_rel->relkind == RELKIND_MATVIEW)
+		{
+			/* Regular table, so use the regular row acquisition function */
+			acquirefunc = acquire_sample_rows;
+			relpages = RelationGetNumberOfBlocks(childrel);
+		}
+		else if (childrel->rd_rel->relkind == RELKIND_FOREIGN_TABLE)
+		{
+			/*
+			 * For a foreign table, call the FDW's hook function to see
+			 * whether it supports analysis.
+			 */
+			FdwRoutine *fdwroutine;
+			bool		ok = false;
+
+			fdwroutine = GetFdwRoutineForRelation(childrel, false);
+
+			if (fdwroutine->AnalyzeForeignTable != NULL)
+				ok = fdwroutine->AnalyzeForeignTable(childrel,
+													 &acquirefunc,
+													 &relpages);
+
+			if (!ok)
+			{
+				/* ignore, but release the lock on it */
+				Assert(childrel != onerel);
+				heap_close(childrel, AccessShareLock);
+				continue;
+			}
+		}
+		else
+		{
+			/*
+			 * ignore, but release the lock on it.  don't try to unlock the
+			 * passed-in relation
+			 */
+			Assert(childrel->rd_rel->relkind == RELKIND_PARTITIONED_TABLE);
+			if (childrel != onerel)
+				heap_close(childrel, AccessShareLock);
+			else
+				heap_close(childrel, NoLock);
+			continue;
+		}
+
+		/* OK, we'll process this child */
+		has_child = true;
+		rels[nrels] = childrel;
+		acquirefuncs[nrels] = acquirefunc;
+		relblocks[nrels] = (double) relpages;
+		totalblocks += (double) relpages;
+		nrels++;
+	}
+
+	/*
+	 * If we don't have at least one child table to consider, fail.  If the
+	 * relation is a partitioned table, it's not counted as a child table.
+	 */
+	if (!has_child)
+	{
+		ereport(elevel,
+				(errmsg("skipping analyze of \"%s.%s\" inheritance tree --- this inheritance tree contains no analyzable child tables",
+						get_namespace_name(RelationGetNamespace(onerel)),
+						RelationGetRelationName(onerel))));
+		return 0;
+	}
+
+	/*
+	 * Now sample rows from each relation, proportionally to its fraction of
+	 * the total block count.  (This might be less than desirable if the child
+	 * rels have radically different free-space percentages, but it's not
+	 * clear that it's worth working harder.)
+	 */
+	numrows = 0;
+	*totalrows = 0;
+	*totaldeadrows = 0;
+	for (i = 0; i < nrels; i++)
+	{
+		Relation	childrel = rels[i];
+		AcquireSampleRowsFunc acquirefunc = acquirefuncs[i];
+		double		childblocks = relblocks[i];
+
+		if (childblocks > 0)
+		{
+			int			childtargrows;
+
+			childtargrows = (int) rint(targrows * childblocks / totalblocks);
+			/* Make sure we don't overrun due to roundoff error */
+			childtargrows = Min(childtargrows, targrows - numrows);
+			if (childtargrows > 0)
+			{
+				int			childrows;
+				double		trows,
+							tdrows;
+
+				/* Fetch a random sample of the child's rows */
+				childrows = (*acquirefunc) (childrel, elevel,
+											rows + numrows, childtargrows,
+											&trows, &tdrows);
+
+				/* We may need to convert from child's rowtype to parent's */
+				if (childrows > 0 &&
+					!equalTupleDescs(RelationGetDescr(childrel),
+									 RelationGetDescr(onerel)))
+				{
+					TupleConversionMap *map;
+
+					map = convert_tuples_by_name(RelationGetDescr(childrel),
+												 RelationGetDescr(onerel),
+												 gettext_noop("could not convert row type"));
+					if (map != NULL)
+					{
+						int			j;
+
+						for (j = 0; j < childrows; j++)
+						{
+							HeapTuple	newtup;
+
+							newtup = do_convert_tuple(rows[numrows + j], map);
+							heap_freetuple(rows[numrows + j]);
+							rows[numrows + j] = newtup;
+						}
+						free_conversion_map(map);
+					}
+				}
+
+				/* And add to counts */
+				numrows += childrows;
+				*totalrows += trows;
+				*totaldeadrows += tdrows;
+			}
+		}
+
+		/*
+		 * Note: we cannot release the child-table locks, since we may have
+		 * pointers to their TOAST tables in the sampled rows.
+		 */
+		heap_close(childrel, NoLock);
+	}
+
+	return numrows;
+}
+
+
+/*
+ *	update_attstats() -- update attribute statistics for one relation
+ *
+ *		Statistics are stored in several places: the pg_class row for the
+ *		relation has stats about the whole relation, and there is a
+ *		pg_statistic row for each (non-system) attribute that has ever
+ *		been analyzed.  The pg_class values are updated by VACUUM, not here.
+ *
+ *		pg_statistic rows are just added or updated normally.  This means
+ *		that pg_statistic will probably contain some deleted rows at the
+ *		completion of a vacuum cycle, unless it happens to get vacuumed last.
+ *
+ *		To keep things simple, we punt for pg_statistic, and don't try
+ *		to compute or store rows for pg_statistic itself in pg_statistic.
+ *		This could possibly be made to work, but it's not worth the trouble.
+ *		Note analyze_rel() has seen to it that we won't come here when
+ *		vacuuming pg_statistic itself.
+ *
+ *		Note: there would be a race condition here if two backends could
+ *		ANALYZE the same table concurrently.  Presently, we lock that out
+ *		by taking a self-exclusive lock on the relation in analyze_rel().
+ */
+static void
+update_attstats(Oid relid, bool inh, int natts, VacAttrStats **vacattrstats)
+{
+	Relation	sd;
+	int			attno;
+
+	if (natts <= 0)
+		return;					/* nothing to do */
+
+	sd = heap_open(StatisticRelationId, RowExclusiveLock);
+
+	for (attno = 0; attno < natts; attno++)
+	{
+		VacAttrStats *stats = vacattrstats[attno];
+		HeapTuple	stup,
+					oldtup;
+		int			i,
+					k,
+					n;
+		Datum		values[Natts_pg_statistic];
+		bool		nulls[Natts_pg_statistic];
+		bool		replaces[Natts_pg_statistic];
+
+		/* Ignore attr if we weren't able to collect stats */
+		if (!stats->stats_valid)
+			continue;
+
+		/*
+		 * Construct a new pg_statistic tuple
+		 */
+		for (i = 0; i < Natts_pg_statistic; ++i)
+		{
+			nulls[i] = false;
+			replaces[i] = true;
+		}
+
+		values[Anum_pg_statistic_starelid - 1] = ObjectIdGetDatum(relid);
+		values[Anum_pg_statistic_staattnum - 1] = Int16GetDatum(stats->attr->attnum);
+		values[Anum_pg_statistic_stainherit - 1] = BoolGetDatum(inh);
+		values[Anum_pg_statistic_stanullfrac - 1] = Float4GetDatum(stats->stanullfrac);
+		values[Anum_pg_statistic_stawidth - 1] = Int32GetDatum(stats->stawidth);
+		values[Anum_pg_statistic_stadistinct - 1] = Float4GetDatum(stats->stadistinct);
+		i = Anum_pg_statistic_stakind1 - 1;
+		for (k = 0; k < STATISTIC_NUM_SLOTS; k++)
+		{
+			values[i++] = Int16GetDatum(stats->stakind[k]); /* stakindN */
+		}
+		i = Anum_pg_statistic_staop1 - 1;
+		for (k = 0; k < STATISTIC_NUM_SLOTS; k++)
+		{
+			values[i++] = ObjectIdGetDatum(stats->staop[k]);	/* staopN */
+		}
+		i = Anum_pg_statistic_stanumbers1 - 1;
+		for (k = 0; k < STATISTIC_NUM_SLOTS; k++)
+		{
+			int			nnum = stats->numnumbers[k];
+
+			if (nnum > 0)
+			{
+				Datum	   *numdatums = (Datum *) palloc(nnum * sizeof(Datum));
+				ArrayType  *arry;
+
+				for (n = 0; n < nnum; n++)
+					numdatums[n] = Float4GetDatum(stats->stanumbers[k][n]);
+				/* XXX knows more than it should about type float4: */
+				arry = construct_array(numdatums, nnum,
+									   FLOAT4OID,
+									   sizeof(float4), FLOAT4PASSBYVAL, 'i');
+				values[i++] = PointerGetDatum(arry);	/* stanumbersN */
+			}
+			else
+			{
+				nulls[i] = true;
+				values[i++] = (Datum) 0;
+			}
+		}
+		i = Anum_pg_statistic_stavalues1 - 1;
+		for (k = 0; k < STATISTIC_NUM_SLOTS; k++)
+		{
+			if (stats->numvalues[k] > 0)
+			{
+				ArrayType  *arry;
+
+				arry = construct_array(stats->stavalues[k],
+									   stats->numvalues[k],
+									   stats->statypid[k],
+									   stats->statyplen[k],
+									   stats->statypbyval[k],
+									   stats->statypalign[k]);
+				values[i++] = PointerGetDatum(arry);	/* stavaluesN */
+			}
+			else
+			{
+				nulls[i] = true;
+				values[i++] = (Datum) 0;
+			}
+		}
+
+		/* Is there already a pg_statistic tuple for this attribute? */
+		oldtup = SearchSysCache3(STATRELATTINH,
+								 ObjectIdGetDatum(relid),
+								 Int16GetDatum(stats->attr->attnum),
+								 BoolGetDatum(inh));
+
+		if (HeapTupleIsValid(oldtup))
+		{
+			/* Yes, replace it */
+			stup = heap_modify_tuple(oldtup,
+									 RelationGetDescr(sd),
+									 values,
+									 nulls,
+									 replaces);
+			ReleaseSysCache(oldtup);
+			CatalogTupleUpdate(sd, &stup->t_self, stup);
+		}
+		else
+		{
+			/* No, insert new tuple */
+			stup = heap_form_tuple(RelationGetDescr(sd), values, nulls);
+			CatalogTupleInsert(sd, stup);
+		}
+
+		heap_freetuple(stup);
+	}
+
+	heap_close(sd, RowExclusiveLock);
+}
+
+/*
+ * Standard fetch function for use by compute_stats subroutines.
+ *
+ * This exists to provide some insulation between compute_stats routines
+ * and the actual storage of the sample data.
+ */
+static Datum
+std_fetch_func(VacAttrStatsP stats, int rownum, bool *isNull)
+{
+	int			attnum = stats->tupattnum;
+	HeapTuple	tuple = stats->rows[rownum];
+	TupleDesc	tupDesc = stats->tupDesc;
+
+	return heap_getattr(tuple, attnum, tupDesc, isNull);
+}
+
+/*
+ * Fetch function for analyzing index expressions.
+ *
+ * We have not bothered to construct index tuples, instead the data is
+ * just in Datum arrays.
+ */
+static Datum
+ind_fetch_func(VacAttrStatsP stats, int rownum, bool *isNull)
+{
+	int			i;
+
+	/* exprvals and exprnulls are already offset for proper column */
+	i = rownum * stats->rowstride;
+	*isNull = stats->exprnulls[i];
+	return stats->exprvals[i];
+}
+
+
+/*==========================================================================
+ *
+ * Code below this point represents the "standard" type-specific statistics
+ * analysis algorithms.  This code can be replaced on a per-data-type basis
+ * by setting a nonzero value in pg_type.typanalyze.
+ *
+ *==========================================================================
+ */
+
+
+/*
+ * To avoid consuming too much memory during analysis and/or too much space
+ * in the resulting pg_statistic rows, we ignore varlena datums that are wider
+ * than WIDTH_THRESHOLD (after detoasting!).  This is legitimate for MCV
+ * and distinct-value calculations since a wide value is unlikely to be
+ * duplicated at all, much less be a most-common value.  For the same reason,
+ * ignoring wide values will not affect our estimates of histogram bin
+ * boundaries very much.
+ */
+#define WIDTH_THRESHOLD  1024
+
+#define swapInt(a,b)	do {int _tmp; _tmp=a; a=b; b=_tmp;} while(0)
+#define swapDatum(a,b)	do {Datum _tmp; _tmp=a; a=b; b=_tmp;} while(0)
+
+/*
+ * Extra information used by the default analysis routines
+ */
+typedef struct
+{
+	int			count;			/* # of duplicates */
+	int			first;			/* values[] index of first occurrence */
+} ScalarMCVItem;
+
+typedef struct
+{
+	SortSupport ssup;
+	int		   *tupnoLink;
+} CompareScalarsContext;
+
+
+static void compute_trivial_stats(VacAttrStatsP stats,
+					  AnalyzeAttrFetchFunc fetchfunc,
+					  int samplerows,
+					  double totalrows);
+static void compute_distinct_stats(VacAttrStatsP stats,
+					   AnalyzeAttrFetchFunc fetchfunc,
+					   int samplerows,
+					   double totalrows);
+static void compute_scalar_stats(VacAttrStatsP stats,
+					 AnalyzeAttrFetchFunc fetchfunc,
+					 int samplerows,
+					 double totalrows);
+static int	compare_scalars(const void *a, const void *b, void *arg);
+static int	compare_mcvs(const void *a, const void *b);
+
+
+/*
+ * std_typanalyze -- the default type-specific typanalyze function
+ */
+bool
+std_typanalyze(VacAttrStats *stats)
+{
+	Form_pg_attribute attr = stats->attr;
+	Oid			ltopr;
+	Oid			eqopr;
+	StdAnalyzeData *mystats;
+
+	/* If the attstattarget column is negative, use the default value */
+	/* NB: it is okay to scribble on stats->attr since it's a copy */
+	if (attr->attstattarget < 0)
+		attr->attstattarget = default_statistics_target;
+
+	/* Look for default "<" and "=" operators for column's type */
+	get_sort_group_operators(stats->attrtypid,
+							 false, false, false,
+							 &ltopr, &eqopr, NULL,
+							 NULL);
+
+	/* Save the operator info for compute_stats routines */
+	mystats = (StdAnalyzeData *) palloc(sizeof(StdAnalyzeData));
+	mystats->eqopr = eqopr;
+	mystats->eqfunc = OidIsValid(eqopr) ? get_opcode(eqopr) : InvalidOid;
+	mystats->ltopr = ltopr;
+	stats->extra_data = mystats;
+
+	/*
+	 * Determine which standard statistics algorithm to use
+	 */
+	if (OidIsValid(eqopr) && OidIsValid(ltopr))
+	{
+		/* Seems to be a scalar datatype */
+		stats->compute_stats = compute_scalar_stats;
+		/*--------------------
+		 * The following choice of minrows is based on the paper
+		 * "Random sampling for histogram construction: how much is enough?"
+		 * by Surajit Chaudhuri, Rajeev Motwani and Vivek Narasayya, in
+		 * Proceedings of ACM SIGMOD International Conference on Management
+		 * of Data, 1998, Pages 436-447.  Their Corollary 1 to Theorem 5
+		 * says that for table size n, histogram size k, maximum relative
+		 * error in bin size f, and error probability gamma, the minimum
+		 * random sample size is
+		 *		r = 4 * k * ln(2*n/gamma) / f^2
+		 * Taking f = 0.5, gamma = 0.01, n = 10^6 rows, we obtain
+		 *		r = 305.82 * k
+		 * Note that because of the log function, the dependence on n is
+		 * quite weak; even at n = 10^12, a 300*k sample gives <= 0.66
+		 * bin size error with probability 0.99.  So there's no real need to
+		 * scale for n, which is a good thing because we don't necessarily
+		 * know it at this point.
+		 *--------------------
+		 */
+		stats->minrows = 300 * attr->attstattarget;
+	}
+	else if (OidIsValid(eqopr))
+	{
+		/* We can still recognize distinct values */
+		stats->compute_stats = compute_distinct_stats;
+		/* Might as well use the same minrows as above */
+		stats->minrows = 300 * attr->attstattarget;
+	}
+	else
+	{
+		/* Can't do much but the trivial stuff */
+		stats->compute_stats = compute_trivial_stats;
+		/* Might as well use the same minrows as above */
+		stats->minrows = 300 * attr->attstattarget;
+	}
+
+	return true;
+}
+
+
+/*
+ *	compute_trivial_stats() -- compute very basic column statistics
+ *
+ *	We use this when we cannot find a hash "=" operator for the datatype.
+ *
+ *	We determine the fraction of non-null rows and the average datum width.
+ */
+static void
+compute_trivial_stats(VacAttrStatsP stats,
+					  AnalyzeAttrFetchFunc fetchfunc,
+					  int samplerows,
+					  double totalrows)
+{
+	int			i;
+	int			null_cnt = 0;
+	int			nonnull_cnt = 0;
+	double		total_width = 0;
+	bool		is_varlena = (!stats->attrtype->typbyval &&
+							  stats->attrtype->typlen == -1);
+	bool		is_varwidth = (!stats->attrtype->typbyval &&
+							   stats->attrtype->typlen < 0);
+
+	for (i = 0; i < samplerows; i++)
+	{
+		Datum		value;
+		bool		isnull;
+
+		vacuum_delay_point();
+
+		value = fetchfunc(stats, i, &isnull);
+
+		/* Check for null/nonnull */
+		if (isnull)
+		{
+			null_cnt++;
+			continue;
+		}
+		nonnull_cnt++;
+
+		/*
+		 * If it's a variable-width field, add up widths for average width
+		 * calculation.  Note that if the value is toasted, we use the toasted
+		 * width.  We don't bother with this calculation if it's a fixed-width
+		 * type.
+		 */
+		if (is_varlena)
+		{
+			total_width += VARSIZE_ANY(DatumGetPointer(value));
+		}
+		else if (is_varwidth)
+		{
+			/* must be cstring */
+			total_width += strlen(DatumGetCString(value)) + 1;
+		}
+	}
+
+	/* We can only compute average width if we found some non-null values. */
+	if (nonnull_cnt > 0)
+	{
+		stats->stats_valid = true;
+		/* Do the simple null-frac and width stats */
+		stats->stanullfrac = (double) null_cnt / (double) samplerows;
+		if (is_varwidth)
+			stats->stawidth = total_width / (double) nonnull_cnt;
+		else
+			stats->stawidth = stats->attrtype->typlen;
+		stats->stadistinct = 0.0;	/* "unknown" */
+	}
+	else if (null_cnt > 0)
+	{
+		/* We found only nulls; assume the column is entirely null */
+		stats->stats_valid = true;
+		stats->stanullfrac = 1.0;
+		if (is_varwidth)
+			stats->stawidth = 0;	/* "unknown" */
+		else
+			stats->stawidth = stats->attrtype->typlen;
+		stats->stadistinct = 0.0;	/* "unknown" */
+	}
+}
+
+
+/*
+ *	compute_distinct_stats() -- compute column statistics including ndistinct
+ *
+ *	We use this when we can find only an "=" operator for the datatype.
+ *
+ *	We determine the fraction of non-null rows, the average width, the
+ *	most common values, and the (estimated) number of distinct values.
+ *
+ *	The most common values are determined by brute force: we keep a list
+ *	of previously seen values, ordered by number of times seen, as we scan
+ *	the samples.  A newly seen value is inserted just after the last
+ *	multiply-seen value, causing the bottommost (oldest) singly-seen value
+ *	to drop off the list.  The accuracy of this method, and also its cost,
+ *	depend mainly on the length of the list we are willing to keep.
+ */
+static void
+compute_distinct_stats(VacAttrStatsP stats,
+					   AnalyzeAttrFetchFunc fetchfunc,
+					   int samplerows,
+					   double totalrows)
+{
+	int			i;
+	int			null_cnt = 0;
+	int			nonnull_cnt = 0;
+	int			toowide_cnt = 0;
+	double		total_width = 0;
+	bool		is_varlena = (!stats->attrtype->typbyval &&
+							  stats->attrtype->typlen == -1);
+	bool		is_varwidth = (!stats->attrtype->typbyval &&
+							   stats->attrtype->typlen < 0);
+	FmgrInfo	f_cmpeq;
+	typedef struct
+	{
+		Datum		value;
+		int			count;
+	} TrackItem;
+	TrackItem  *track;
+	int			track_cnt,
+				track_max;
+	int			num_mcv = stats->attr->attstattarget;
+	StdAnalyzeData *mystats = (StdAnalyzeData *) stats->extra_data;
+
+	/*
+	 * We track up to 2*n values for an n-element MCV list; but at least 10
+	 */
+	track_max = 2 * num_mcv;
+	if (track_max < 10)
+		track_max = 10;
+	track = (TrackItem *) palloc(track_max * sizeof(TrackItem));
+	track_cnt = 0;
+
+	fmgr_info(mystats->eqfunc, &f_cmpeq);
+
+	for (i = 0; i < samplerows; i++)
+	{
+		Datum		value;
+		bool		isnull;
+		bool		match;
+		int			firstcount1,
+					j;
+
+		vacuum_delay_point();
+
+		value = fetchfunc(stats, i, &isnull);
+
+		/* Check for null/nonnull */
+		if (isnull)
+		{
+			null_cnt++;
+			continue;
+		}
+		nonnull_cnt++;
+
+		/*
+		 * If it's a variable-width field, add up widths for average width
+		 * calculation.  Note that if the value is toasted, we use the toasted
+		 * width.  We don't bother with this calculation if it's a fixed-width
+		 * type.
+		 */
+		if (is_varlena)
+		{
+			total_width += VARSIZE_ANY(DatumGetPointer(value));
+
+			/*
+			 * If the value is toasted, we want to detoast it just once to
+			 * avoid repeated detoastings and resultant excess memory usage
+			 * during the comparisons.  Also, check to see if the value is
+			 * excessively wide, and if so don't detoast at all --- just
+			 * ignore the value.
+			 */
+			if (toast_raw_datum_size(value) > WIDTH_THRESHOLD)
+			{
+				toowide_cnt++;
+				continue;
+			}
+			value = PointerGetDatum(PG_DETOAST_DATUM(value));
 		}
 		else if (is_varwidth)
 		{
-			/* must be cstring */
-			total_width += strlen(DatumGetCString(value)) + 1;
-		}
-	}
+			/* must be cstring */
+			total_width += strlen(DatumGetCString(value)) + 1;
+		}
+
+		/*
+		 * See if the value matches anything we're already tracking.
+		 */
+		match = false;
+		firstcount1 = track_cnt;
+		for (j = 0; j < track_cnt; j++)
+		{
+			/* We always use the default collation for statistics */
+			if (DatumGetBool(FunctionCall2Coll(&f_cmpeq,
+											   DEFAULT_COLLATION_OID,
+											   value, track[j].value)))
+			{
+				match = true;
+				break;
+			}
+			if (j < firstcount1 && track[j].count == 1)
+				firstcount1 = j;
+		}
+
+		if (match)
+		{
+			/* Found a match */
+			track[j].count++;
+			/* This value may now need to "bubble up" in the track list */
+			while (j > 0 && track[j].count > track[j - 1].count)
+			{
+				swapDatum(track[j].value, track[j - 1].value);
+				swapInt(track[j].count, track[j - 1].count);
+				j--;
+			}
+		}
+		else
+		{
+			/* No match.  Insert at head of count-1 list */
+			if (track_cnt < track_max)
+				track_cnt++;
+			for (j = track_cnt - 1; j > firstcount1; j--)
+			{
+				track[j].value = track[j - 1].value;
+				track[j].count = track[j - 1].count;
+			}
+			if (firstcount1 < track_cnt)
+			{
+				track[firstcount1].value = value;
+				track[firstcount1].count = 1;
+			}
+		}
+	}
+
+	/* We can only compute real stats if we found some non-null values. */
+	if (nonnull_cnt > 0)
+	{
+		int			nmultiple,
+					summultiple;
+
+		stats->stats_valid = true;
+		/* Do the simple null-frac and width stats */
+		stats->stanullfrac = (double) null_cnt / (double) samplerows;
+		if (is_varwidth)
+			stats->stawidth = total_width / (double) nonnull_cnt;
+		else
+			stats->stawidth = stats->attrtype->typlen;
+
+		/* Count the number of values we found multiple times */
+		summultiple = 0;
+		for (nmultiple = 0; nmultiple < track_cnt; nmultiple++)
+		{
+			if (track[nmultiple].count == 1)
+				break;
+			summultiple += track[nmultiple].count;
+		}
+
+		if (nmultiple == 0)
+		{
+			/*
+			 * If we found no repeated non-null values, assume it's a unique
+			 * column; but be sure to discount for any nulls we found.
+			 */
+			stats->stadistinct = -1.0 * (1.0 - stats->stanullfrac);
+		}
+		else if (track_cnt < track_max && toowide_cnt == 0 &&
+				 nmultiple == track_cnt)
+		{
+			/*
+			 * Our track list includes every value in the sample, and every
+			 * value appeared more than once.  Assume the column has just
+			 * these values.  (This case is meant to address columns with
+			 * small, fixed sets of possible values, such as boolean or enum
+			 * columns.  If there are any values that appear just once in the
+			 * sample, including too-wide values, we should assume that that's
+			 * not what we're dealing with.)
+			 */
+			stats->stadistinct = track_cnt;
+		}
+		else
+		{
+			/*----------
+			 * Estimate the number of distinct values using the estimator
+			 * proposed by Haas and Stokes in IBM Research Report RJ 10025:
+			 *		n*d / (n - f1 + f1*n/N)
+			 * where f1 is the number of distinct values that occurred
+			 * exactly once in our sample of n rows (from a total of N),
+			 * and d is the total number of distinct values in the sample.
+			 * This is their Duj1 estimator; the other estimators they
+			 * recommend are considerably more complex, and are numerically
+			 * very unstable when n is much smaller than N.
+			 *
+			 * In this calculation, we consider only non-nulls.  We used to
+			 * include rows with null values in the n and N counts, but that
+			 * leads to inaccurate answers in columns with many nulls, and
+			 * it's intuitively bogus anyway considering the desired result is
+			 * the number of distinct non-null values.
+			 *
+			 * We assume (not very reliably!) that all the multiply-occurring
+			 * values are reflected in the final track[] list, and the other
+			 * nonnull values all appeared but once.  (XXX this usually
+			 * results in a drastic overestimate of ndistinct.  Can we do
+			 * any better?)
+			 *----------
+			 */
+			int			f1 = nonnull_cnt - summultiple;
+			int			d = f1 + nmultiple;
+			double		n = samplerows - null_cnt;
+			double		N = totalrows * (1.0 - stats->stanullfrac);
+			double		stadistinct;
+
+			/* N == 0 shouldn't happen, but just in case ... */
+			if (N > 0)
+				stadistinct = (n * d) / ((n - f1) + f1 * n / N);
+			else
+				stadistinct = 0;
+
+			/* Clamp to sane range in case of roundoff error */
+			if (stadistinct < d)
+				stadistinct = d;
+			if (stadistinct > N)
+				stadistinct = N;
+			/* And round to integer */
+			stats->stadistinct = floor(stadistinct + 0.5);
+		}
+
+		/*
+		 * If we estimated the number of distinct values at more than 10% of
+		 * the total row count (a very arbitrary limit), then assume that
+		 * stadistinct should scale with the row count rather than be a fixed
+		 * value.
+		 */
+		if (stats->stadistinct > 0.1 * totalrows)
+			stats->stadistinct = -(stats->stadistinct / totalrows);
+
+		/*
+		 * Decide how many values are worth storing as most-common values. If
+		 * we are able to generate a complete MCV list (all the values in the
+		 * sample will fit, and we think these are all the ones in the table),
+		 * then do so.  Otherwise, store only those values that are
+		 * significantly more common than the (estimated) average. We set the
+		 * threshold rather arbitrarily at 25% more than average, with at
+		 * least 2 instances in the sample.
+		 *
+		 * Note: the first of these cases is meant to address columns with
+		 * small, fixed sets of possible values, such as boolean or enum
+		 * columns.  If we can *completely* represent the column population by
+		 * an MCV list that will fit into the stats target, then we should do
+		 * so and thus provide the planner with complete information.  But if
+		 * the MCV list is not complete, it's generally worth being more
+		 * selective, and not just filling it all the way up to the stats
+		 * target.  So for an incomplete list, we try to take only MCVs that
+		 * are significantly more common than average.
+		 */
+		if (track_cnt < track_max && toowide_cnt == 0 &&
+			stats->stadistinct > 0 &&
+			track_cnt <= num_mcv)
+		{
+			/* Track list includes all values seen, and all will fit */
+			num_mcv = track_cnt;
+		}
+		else
+		{
+			double		ndistinct_table = stats->stadistinct;
+			double		avgcount,
+						mincount;
+
+			/* Re-extract estimate of # distinct nonnull values in table */
+			if (ndistinct_table < 0)
+				ndistinct_table = -ndistinct_table * totalrows;
+			/* estimate # occurrences in sample of a typical nonnull value */
+			avgcount = (double) nonnull_cnt / ndistinct_table;
+			/* set minimum threshold count to store a value */
+			mincount = avgcount * 1.25;
+			if (mincount < 2)
+				mincount = 2;
+			if (num_mcv > track_cnt)
+				num_mcv = track_cnt;
+			for (i = 0; i < num_mcv; i++)
+			{
+				if (track[i].count < mincount)
+				{
+					num_mcv = i;
+					break;
+				}
+			}
+		}
+
+		/* Generate MCV slot entry */
+		if (num_mcv > 0)
+		{
+			MemoryContext old_context;
+			Datum	   *mcv_values;
+			float4	   *mcv_freqs;
 
-	/* We can only compute average width if we found some non-null values. */
-	if (nonnull_cnt > 0)
-	{
-		stats->stats_valid = true;
-		/* Do the simple null-frac and width stats */
-		stats->stanullfrac = (double) null_cnt / (double) samplerows;
-		if (is_varwidth)
-			stats->stawidth = total_width / (double) nonnull_cnt;
-		else
-			stats->stawidth = stats->attrtype->typlen;
-		stats->stadistinct = 0.0;	/* "unknown" */
+			/* Must copy the target values into anl_context */
+			old_context = MemoryContextSwitchTo(stats->anl_context);
+			mcv_values = (Datum *) palloc(num_mcv * sizeof(Datum));
+			mcv_freqs = (float4 *) palloc(num_mcv * sizeof(float4));
+			for (i = 0; i < num_mcv; i++)
+			{
+				mcv_values[i] = datumCopy(track[i].value,
+										  stats->attrtype->typbyval,
+										  stats->attrtype->typlen);
+				mcv_freqs[i] = (double) track[i].count / (double) samplerows;
+			}
+			MemoryContextSwitchTo(old_context);
+
+			stats->stakind[0] = STATISTIC_KIND_MCV;
+			stats->staop[0] = mystats->eqopr;
+			stats->stanumbers[0] = mcv_freqs;
+			stats->numnumbers[0] = num_mcv;
+			stats->stavalues[0] = mcv_values;
+			stats->numvalues[0] = num_mcv;
+
+			/*
+			 * Accept the defaults for stats->statypid and others. They have
+			 * been set before we were called (see vacuum.h)
+			 */
+		}
 	}
 	else if (null_cnt > 0)
 	{
@@ -1923,29 +2814,28 @@ compute_trivial_stats(VacAttrStatsP stats,
 			stats->stawidth = stats->attrtype->typlen;
 		stats->stadistinct = 0.0;	/* "unknown" */
 	}
+
+	/* We don't need to bother cleaning up any of our temporary palloc's */
 }
 
 
 /*
- *	compute_distinct_stats() -- compute column statistics including ndistinct
+ *	compute_scalar_stats() -- compute column statistics
  *
- *	We use this when we can find only an "=" operator for the datatype.
+ *	We use this when we can find "=" and "<" operators for the datatype.
  *
  *	We determine the fraction of non-null rows, the average width, the
- *	most common values, and the (estimated) number of distinct values.
+ *	most common values, the (estimated) number of distinct values, the
+ *	distribution histogram, and the correlation of physical to logical order.
  *
- *	The most common values are determined by brute force: we keep a list
- *	of previously seen values, ordered by number of times seen, as we scan
- *	the samples.  A newly seen value is inserted just after the last
- *	multiply-seen value, causing the bottommost (oldest) singly-seen value
- *	to drop off the list.  The accuracy of this method, and also its cost,
- *	depend mainly on the length of the list we are willing to keep.
+ *	The desired stats can be determined fairly easily after sorting the
+ *	data values into order.
  */
 static void
-compute_distinct_stats(VacAttrStatsP stats,
-					   AnalyzeAttrFetchFunc fetchfunc,
-					   int samplerows,
-					   double totalrows)
+compute_scalar_stats(VacAttrStatsP stats,
+					 AnalyzeAttrFetchFunc fetchfunc,
+					 int samplerows,
+					 double totalrows)
 {
 	int			i;
 	int			null_cnt = 0;
@@ -1956,36 +2846,41 @@ compute_distinct_stats(VacAttrStatsP stats,
 							  stats->attrtype->typlen == -1);
 	bool		is_varwidth = (!stats->attrtype->typbyval &&
 							   stats->attrtype->typlen < 0);
-	FmgrInfo	f_cmpeq;
-	typedef struct
-	{
-		Datum		value;
-		int			count;
-	} TrackItem;
-	TrackItem  *track;
-	int			track_cnt,
-				track_max;
+	double		corr_xysum;
+	SortSupportData ssup;
+	ScalarItem *values;
+	int			values_cnt = 0;
+	int		   *tupnoLink;
+	ScalarMCVItem *track;
+	int			track_cnt = 0;
 	int			num_mcv = stats->attr->attstattarget;
+	int			num_bins = stats->attr->attstattarget;
 	StdAnalyzeData *mystats = (StdAnalyzeData *) stats->extra_data;
 
+	values = (ScalarItem *) palloc(samplerows * sizeof(ScalarItem));
+	tupnoLink = (int *) palloc(samplerows * sizeof(int));
+	track = (ScalarMCVItem *) palloc(num_mcv * sizeof(ScalarMCVItem));
+
+	memset(&ssup, 0, sizeof(ssup));
+	ssup.ssup_cxt = CurrentMemoryContext;
+	/* We always use the default collation for statistics */
+	ssup.ssup_collation = DEFAULT_COLLATION_OID;
+	ssup.ssup_nulls_first = false;
+
 	/*
-	 * We track up to 2*n values for an n-element MCV list; but at least 10
+	 * For now, don't perform abbreviated key conversion, because full values
+	 * are required for MCV slot generation.  Supporting that optimization
+	 * would necessitate teaching compare_scalars() to call a tie-breaker.
 	 */
-	track_max = 2 * num_mcv;
-	if (track_max < 10)
-		track_max = 10;
-	track = (TrackItem *) palloc(track_max * sizeof(TrackItem));
-	track_cnt = 0;
+	ssup.abbreviate = false;
 
-	fmgr_info(mystats->eqfunc, &f_cmpeq);
+	PrepareSortSupportFromOrderingOp(mystats->ltopr, &ssup);
 
+	/* Initial scan to find sortable values */
 	for (i = 0; i < samplerows; i++)
 	{
 		Datum		value;
 		bool		isnull;
-		bool		match;
-		int			firstcount1,
-					j;
 
 		vacuum_delay_point();
 
@@ -2029,60 +2924,92 @@ compute_distinct_stats(VacAttrStatsP stats,
 			total_width += strlen(DatumGetCString(value)) + 1;
 		}
 
+		/* Add it to the list to be sorted */
+		values[values_cnt].value = value;
+		values[values_cnt].tupno = values_cnt;
+		tupnoLink[values_cnt] = values_cnt;
+		values_cnt++;
+	}
+
+	/* We can only compute real stats if we found some sortable values. */
+	if (values_cnt > 0)
+	{
+		int			ndistinct,	/* # distinct values in sample */
+					nmultiple,	/* # that appear multiple times */
+					num_hist,
+					dups_cnt;
+		int			slot_idx = 0;
+		CompareScalarsContext cxt;
+
+		/* Sort the collected values */
+		cxt.ssup = &ssup;
+		cxt.tupnoLink = tupnoLink;
+		qsort_arg((void *) values, values_cnt, sizeof(ScalarItem),
+				  compare_scalars, (void *) &cxt);
+
 		/*
-		 * See if the value matches anything we're already tracking.
+		 * Now scan the values in order, find the most common ones, and also
+		 * accumulate ordering-correlation statistics.
+		 *
+		 * To determine which are most common, we first have to count the
+		 * number of duplicates of each value.  The duplicates are adjacent in
+		 * the sorted list, so a brute-force approach is to compare successive
+		 * datum values until we find two that are not equal. However, that
+		 * requires N-1 invocations of the datum comparison routine, which are
+		 * completely redundant with work that was done during the sort.  (The
+		 * sort algorithm must at some point have compared each pair of items
+		 * that are adjacent in the sorted order; otherwise it could not know
+		 * that it's ordered the pair correctly.) We exploit this by having
+		 * compare_scalars remember the highest tupno index that each
+		 * ScalarItem has been found equal to.  At the end of the sort, a
+		 * ScalarItem's tupnoLink will still point to itself if and only if it
+		 * is the last item of its group of duplicates (since the group will
+		 * be ordered by tupno).
 		 */
-		match = false;
-		firstcount1 = track_cnt;
-		for (j = 0; j < track_cnt; j++)
+		corr_xysum = 0;
+		ndistinct = 0;
+		nmultiple = 0;
+		dups_cnt = 0;
+		for (i = 0; i < values_cnt; i++)
 		{
-			/* We always use the default collation for statistics */
-			if (DatumGetBool(FunctionCall2Coll(&f_cmpeq,
-											   DEFAULT_COLLATION_OID,
-											   value, track[j].value)))
-			{
-				match = true;
-				break;
-			}
-			if (j < firstcount1 && track[j].count == 1)
-				firstcount1 = j;
-		}
+			int			tupno = values[i].tupno;
 
-		if (match)
-		{
-			/* Found a match */
-			track[j].count++;
-			/* This value may now need to "bubble up" in the track list */
-			while (j > 0 && track[j].count > track[j - 1].count)
-			{
-				swapDatum(track[j].value, track[j - 1].value);
-				swapInt(track[j].count, track[j - 1].count);
-				j--;
-			}
-		}
-		else
-		{
-			/* No match.  Insert at head of count-1 list */
-			if (track_cnt < track_max)
-				track_cnt++;
-			for (j = track_cnt - 1; j > firstcount1; j--)
-			{
-				track[j].value = track[j - 1].value;
-				track[j].count = track[j - 1].count;
-			}
-			if (firstcount1 < track_cnt)
+			corr_xysum += ((double) i) * ((double) tupno);
+			dups_cnt++;
+			if (tupnoLink[tupno] == tupno)
 			{
-				track[firstcount1].value = value;
-				track[firstcount1].count = 1;
+				/* Reached end of duplicates of this value */
+				ndistinct++;
+				if (dups_cnt > 1)
+				{
+					nmultiple++;
+					if (track_cnt < num_mcv ||
+						dups_cnt > track[track_cnt - 1].count)
+					{
+						/*
+						 * Found a new item for the mcv list; find its
+						 * position, bubbling down old items if needed. Loop
+						 * invariant is that j points at an empty/ replaceable
+						 * slot.
+						 */
+						int			j;
+
+						if (track_cnt < num_mcv)
+							track_cnt++;
+						for (j = track_cnt - 1; j > 0; j--)
+						{
+							if (dups_cnt <= track[j - 1].count)
+								break;
+							track[j].count = track[j - 1].count;
+							track[j].first = track[j - 1].first;
+						}
+						track[j].count = dups_cnt;
+						track[j].first = i + 1 - dups_cnt;
+					}
+				}
+				dups_cnt = 0;
 			}
 		}
-	}
-
-	/* We can only compute real stats if we found some non-null values. */
-	if (nonnull_cnt > 0)
-	{
-		int			nmultiple,
-					summultiple;
 
 		stats->stats_valid = true;
 		/* Do the simple null-frac and width stats */
@@ -2092,15 +3019,6 @@ compute_distinct_stats(VacAttrStatsP stats,
 		else
 			stats->stawidth = stats->attrtype->typlen;
 
-		/* Count the number of values we found multiple times */
-		summultiple = 0;
-		for (nmultiple = 0; nmultiple < track_cnt; nmultiple++)
-		{
-			if (track[nmultiple].count == 1)
-				break;
-			summultiple += track[nmultiple].count;
-		}
-
 		if (nmultiple == 0)
 		{
 			/*
@@ -2109,19 +3027,17 @@ compute_distinct_stats(VacAttrStatsP stats,
 			 */
 			stats->stadistinct = -1.0 * (1.0 - stats->stanullfrac);
 		}
-		else if (track_cnt < track_max && toowide_cnt == 0 &&
-				 nmultiple == track_cnt)
+		else if (toowide_cnt == 0 && nmultiple == ndistinct)
 		{
 			/*
-			 * Our track list includes every value in the sample, and every
-			 * value appeared more than once.  Assume the column has just
-			 * these values.  (This case is meant to address columns with
-			 * small, fixed sets of possible values, such as boolean or enum
-			 * columns.  If there are any values that appear just once in the
-			 * sample, including too-wide values, we should assume that that's
-			 * not what we're dealing with.)
+			 * Every value in the sample appeared more than once.  Assume the
+			 * column has just these values.  (This case is meant to address
+			 * columns with small, fixed sets of possible values, such as
+			 * boolean or enum columns.  If there are any values that appear
+			 * just once in the sample, including too-wide values, we should
+			 * assume that that's not what we're dealing with.)
 			 */
-			stats->stadistinct = track_cnt;
+			stats->stadistinct = ndistinct;
 		}
 		else
 		{
@@ -2142,14 +3058,10 @@ compute_distinct_stats(VacAttrStatsP stats,
 			 * it's intuitively bogus anyway considering the desired result is
 			 * the number of distinct non-null values.
 			 *
-			 * We assume (not very reliably!) that all the multiply-occurring
-			 * values are reflected in the final track[] list, and the other
-			 * nonnull values all appeared but once.  (XXX this usually
-			 * results in a drastic overestimate of ndistinct.  Can we do
-			 * any better?)
+			 * Overwidth values are assumed to have been distinct.
 			 *----------
 			 */
-			int			f1 = nonnull_cnt - summultiple;
+			int			f1 = ndistinct - nmultiple + toowide_cnt;
 			int			d = f1 + nmultiple;
 			double		n = samplerows - null_cnt;
 			double		N = totalrows * (1.0 - stats->stanullfrac);
@@ -2186,7 +3098,12 @@ compute_distinct_stats(VacAttrStatsP stats,
 		 * then do so.  Otherwise, store only those values that are
 		 * significantly more common than the (estimated) average. We set the
 		 * threshold rather arbitrarily at 25% more than average, with at
-		 * least 2 instances in the sample.
+		 * least 2 instances in the sample.  Also, we won't suppress values
+		 * that have a frequency of at least 1/K where K is the intended
+		 * number of histogram bins; such values might otherwise cause us to
+		 * emit duplicate histogram bin boundaries.  (We might end up with
+		 * duplicate histogram entries anyway, if the distribution is skewed;
+		 * but we prefer to treat such values as MCVs if at all possible.)
 		 *
 		 * Note: the first of these cases is meant to address columns with
 		 * small, fixed sets of possible values, such as boolean or enum
@@ -2198,7 +3115,7 @@ compute_distinct_stats(VacAttrStatsP stats,
 		 * target.  So for an incomplete list, we try to take only MCVs that
 		 * are significantly more common than average.
 		 */
-		if (track_cnt < track_max && toowide_cnt == 0 &&
+		if (track_cnt == ndistinct && toowide_cnt == 0 &&
 			stats->stadistinct > 0 &&
 			track_cnt <= num_mcv)
 		{
@@ -2209,7 +3126,8 @@ compute_distinct_stats(VacAttrStatsP stats,
 		{
 			double		ndistinct_table = stats->stadistinct;
 			double		avgcount,
-						mincount;
+						mincount,
+						maxmincount;
 
 			/* Re-extract estimate of # distinct nonnull values in table */
 			if (ndistinct_table < 0)
@@ -2220,6 +3138,10 @@ compute_distinct_stats(VacAttrStatsP stats,
 			mincount = avgcount * 1.25;
 			if (mincount < 2)
 				mincount = 2;
+			/* don't let threshold exceed 1/K, however */
+			maxmincount = (double) values_cnt / (double) num_bins;
+			if (mincount > maxmincount)
+				mincount = maxmincount;
 			if (num_mcv > track_cnt)
 				num_mcv = track_cnt;
 			for (i = 0; i < num_mcv; i++)
@@ -2245,26 +3167,192 @@ compute_distinct_stats(VacAttrStatsP stats,
 			mcv_freqs = (float4 *) palloc(num_mcv * sizeof(float4));
 			for (i = 0; i < num_mcv; i++)
 			{
-				mcv_values[i] = datumCopy(track[i].value,
+				mcv_values[i] = datumCopy(values[track[i].first].value,
 										  stats->attrtype->typbyval,
 										  stats->attrtype->typlen);
 				mcv_freqs[i] = (double) track[i].count / (double) samplerows;
 			}
 			MemoryContextSwitchTo(old_context);
 
-			stats->stakind[0] = STATISTIC_KIND_MCV;
-			stats->staop[0] = mystats->eqopr;
-			stats->stanumbers[0] = mcv_freqs;
-			stats->numnumbers[0] = num_mcv;
-			stats->stavalues[0] = mcv_values;
-			stats->numvalues[0] = num_mcv;
+			stats->stakind[slot_idx] = STATISTIC_KIND_MCV;
+			stats->staop[slot_idx] = mystats->eqopr;
+			stats->stanumbers[slot_idx] = mcv_freqs;
+			stats->numnumbers[slot_idx] = num_mcv;
+			stats->stavalues[slot_idx] = mcv_values;
+			stats->numvalues[slot_idx] = num_mcv;
+
+			/*
+			 * Accept the defaults for stats->statypid and others. They have
+			 * been set before we were called (see vacuum.h)
+			 */
+			slot_idx++;
+		}
+
+		/*
+		 * Generate a histogram slot entry if there are at least two distinct
+		 * values not accounted for in the MCV list.  (This ensures the
+		 * histogram won't collapse to empty or a singleton.)
+		 */
+		num_hist = ndistinct - num_mcv;
+		if (num_hist > num_bins)
+			num_hist = num_bins + 1;
+		if (num_hist >= 2)
+		{
+			MemoryContext old_context;
+			Datum	   *hist_values;
+			int			nvals;
+			int			pos,
+						posfrac,
+						delta,
+						deltafrac;
+
+			/* Sort the MCV items into position order to speed next loop */
+			qsort((void *) track, num_mcv,
+				  sizeof(ScalarMCVItem), compare_mcvs);
+
+			/*
+			 * Collapse out the MCV items from the values[] array.
+			 *
+			 * Note we destroy the values[] array here... but we don't need it
+			 * for anything more.  We do, however, still need values_cnt.
+			 * nvals will be the number of remaining entries in values[].
+			 */
+			if (num_mcv > 0)
+			{
+				int			src,
+							dest;
+				int			j;
+
+				src = dest = 0;
+				j = 0;			/* index of next interesting MCV item */
+				while (src < values_cnt)
+				{
+					int			ncopy;
+
+					if (j < num_mcv)
+					{
+						int			first = track[j].first;
+
+						if (src >= first)
+						{
+							/* advance past this MCV item */
+							src = first + track[j].count;
+							j++;
+							continue;
+						}
+						ncopy = first - src;
+					}
+					else
+						ncopy = values_cnt - src;
+					memmove(&values[dest], &values[src],
+							ncopy * sizeof(ScalarItem));
+					src += ncopy;
+					dest += ncopy;
+				}
+				nvals = dest;
+			}
+			else
+				nvals = values_cnt;
+			Assert(nvals >= num_hist);
+
+			/* Must copy the target values into anl_context */
+			old_context = MemoryContextSwitchTo(stats->anl_context);
+			hist_values = (Datum *) palloc(num_hist * sizeof(Datum));
+
+			/*
+			 * The object of this loop is to copy the first and last values[]
+			 * entries along with evenly-spaced values in between.  So the
+			 * i'th value is values[(i * (nvals - 1)) / (num_hist - 1)].  But
+			 * computing that subscript directly risks integer overflow when
+			 * the stats target is more than a couple thousand.  Instead we
+			 * add (nvals - 1) / (num_hist - 1) to pos at each step, tracking
+			 * the integral and fractional parts of the sum separately.
+			 */
+			delta = (nvals - 1) / (num_hist - 1);
+			deltafrac = (nvals - 1) % (num_hist - 1);
+			pos = posfrac = 0;
+
+			for (i = 0; i < num_hist; i++)
+			{
+				hist_values[i] = datumCopy(values[pos].value,
+										   stats->attrtype->typbyval,
+										   stats->attrtype->typlen);
+				pos += delta;
+				posfrac += deltafrac;
+				if (posfrac >= (num_hist - 1))
+				{
+					/* fractional part exceeds 1, carry to integer part */
+					pos++;
+					posfrac -= (num_hist - 1);
+				}
+			}
+
+			MemoryContextSwitchTo(old_context);
+
+			stats->stakind[slot_idx] = STATISTIC_KIND_HISTOGRAM;
+			stats->staop[slot_idx] = mystats->ltopr;
+			stats->stavalues[slot_idx] = hist_values;
+			stats->numvalues[slot_idx] = num_hist;
 
 			/*
 			 * Accept the defaults for stats->statypid and others. They have
 			 * been set before we were called (see vacuum.h)
 			 */
+			slot_idx++;
+		}
+
+		/* Generate a correlation entry if there are multiple values */
+		if (values_cnt > 1)
+		{
+			MemoryContext old_context;
+			float4	   *corrs;
+			double		corr_xsum,
+						corr_x2sum;
+
+			/* Must copy the target values into anl_context */
+			old_context = MemoryContextSwitchTo(stats->anl_context);
+			corrs = (float4 *) palloc(sizeof(float4));
+			MemoryContextSwitchTo(old_context);
+
+			/*----------
+			 * Since we know the x and y value sets are both
+			 *		0, 1, ..., values_cnt-1
+			 * we have sum(x) = sum(y) =
+			 *		(values_cnt-1)*values_cnt / 2
+			 * and sum(x^2) = sum(y^2) =
+			 *		(values_cnt-1)*values_cnt*(2*values_cnt-1) / 6.
+			 *----------
+			 */
+			corr_xsum = ((double) (values_cnt - 1)) *
+				((double) values_cnt) / 2.0;
+			corr_x2sum = ((double) (values_cnt - 1)) *
+				((double) values_cnt) * (double) (2 * values_cnt - 1) / 6.0;
+
+			/* And the correlation coefficient reduces to */
+			corrs[0] = (values_cnt * corr_xysum - corr_xsum * corr_xsum) /
+				(values_cnt * corr_x2sum - corr_xsum * corr_xsum);
+
+			stats->stakind[slot_idx] = STATISTIC_KIND_CORRELATION;
+			stats->staop[slot_idx] = mystats->ltopr;
+			stats->stanumbers[slot_idx] = corrs;
+			stats->numnumbers[slot_idx] = 1;
+			slot_idx++;
 		}
 	}
+	else if (nonnull_cnt > 0)
+	{
+		/* We found some non-null values, but they were all too wide */
+		Assert(nonnull_cnt == toowide_cnt);
+		stats->stats_valid = true;
+		/* Do the simple null-frac and width stats */
+		stats->stanullfrac = (double) null_cnt / (double) samplerows;
+		if (is_varwidth)
+			stats->stawidth = total_width / (double) nonnull_cnt;
+		else
+			stats->stawidth = stats->attrtype->typlen;
+		/* Assume all too-wide values are distinct, so it's a unique column */
+		stats->stadistinct = -1.0 * (1.0 - stats->stanullfrac);
+	}
 	else if (null_cnt > 0)
 	{
 		/* We found only nulls; assume the column is entirely null */
@@ -2280,601 +3368,1045 @@ compute_distinct_stats(VacAttrStatsP stats,
 	/* We don't need to bother cleaning up any of our temporary palloc's */
 }
 
-
 /*
- *	compute_scalar_stats() -- compute column statistics
- *
- *	We use this when we can find "=" and "<" operators for the datatype.
- *
- *	We determine the fraction of non-null rows, the average width, the
- *	most common values, the (estimated) number of distinct values, the
- *	distribution histogram, and the correlation of physical to logical order.
+ * qsort_arg comparator for sorting ScalarItems
  *
- *	The desired stats can be determined fairly easily after sorting the
- *	data values into order.
+ * Aside from sorting the items, we update the tupnoLink[] array
+ * whenever two ScalarItems are found to contain equal datums.  The array
+ * is indexed by tupno; for each ScalarItem, it contains the highest
+ * tupno that that item's datum has been found to be equal to.  This allows
+ * us to avoid additional comparisons in compute_scalar_stats().
  */
-static void
-compute_scalar_stats(VacAttrStatsP stats,
-					 AnalyzeAttrFetchFunc fetchfunc,
-					 int samplerows,
-					 double totalrows)
+static int
+compare_scalars(const void *a, const void *b, void *arg)
 {
-	int			i;
-	int			null_cnt = 0;
-	int			nonnull_cnt = 0;
-	int			toowide_cnt = 0;
-	double		total_width = 0;
-	bool		is_varlena = (!stats->attrtype->typbyval &&
-							  stats->attrtype->typlen == -1);
-	bool		is_varwidth = (!stats->attrtype->typbyval &&
-							   stats->attrtype->typlen < 0);
-	double		corr_xysum;
-	SortSupportData ssup;
-	ScalarItem *values;
-	int			values_cnt = 0;
-	int		   *tupnoLink;
-	ScalarMCVItem *track;
-	int			track_cnt = 0;
-	int			num_mcv = stats->attr->attstattarget;
-	int			num_bins = stats->attr->attstattarget;
-	StdAnalyzeData *mystats = (StdAnalyzeData *) stats->extra_data;
+	Datum		da = ((const ScalarItem *) a)->value;
+	int			ta = ((const ScalarItem *) a)->tupno;
+	Datum		db = ((const ScalarItem *) b)->value;
+	int			tb = ((const ScalarItem *) b)->tupno;
+	CompareScalarsContext *cxt = (CompareScalarsContext *) arg;
+	int			compare;
 
-	values = (ScalarItem *) palloc(samplerows * sizeof(ScalarItem));
-	tupnoLink = (int *) palloc(samplerows * sizeof(int));
-	track = (ScalarMCVItem *) palloc(num_mcv * sizeof(ScalarMCVItem));
+	compare = ApplySortComparator(da, false, db, false, cxt->ssup);
+	if (compare != 0)
+		return compare;
 
-	memset(&ssup, 0, sizeof(ssup));
-	ssup.ssup_cxt = CurrentMemoryContext;
-	/* We always use the default collation for statistics */
-	ssup.ssup_collation = DEFAULT_COLLATION_OID;
-	ssup.ssup_nulls_first = false;
+	/*
+	 * The two datums are equal, so update cxt->tupnoLink[].
+	 */
+	if (cxt->tupnoLink[ta] < tb)
+		cxt->tupnoLink[ta] = tb;
+	if (cxt->tupnoLink[tb] < ta)
+		cxt->tupnoLink[tb] = ta;
 
 	/*
-	 * For now, don't perform abbreviated key conversion, because full values
-	 * are required for MCV slot generation.  Supporting that optimization
-	 * would necessitate teaching compare_scalars() to call a tie-breaker.
+	 * For equal datums, sort by tupno
 	 */
-	ssup.abbreviate = false;
+	return ta - tb;
+}
 
-	PrepareSortSupportFromOrderingOp(mystats->ltopr, &ssup);
+/*
+ * qsort comparator for sorting ScalarMCVItems by position
+ */
+static int
+compare_mcvs(const void *a, const void *b)
+{
+	int			da = ((const ScalarMCVItem *) a)->first;
+	int			db = ((const ScalarMCVItem *) b)->first;
 
-	/* Initial scan to find sortable values */
-	for (i = 0; i < samplerows; i++)
-	{
-		Datum		value;
-		bool		isnull;
+	return da - db;
+}
 
-		vacuum_delay_point();
 
-		value = fetchfunc(stats, i, &isnull);
+/*
+ * merge_partition_stats -- build the statistics of a partitioned table from
+ *		those of its partitions
+ *
+ * This uses only the pg_statistic rows and reltuples of the leaf partitions,
+ * without reading any of their data.  We give up and return false unless
+ * all the columns use compute_scalar_stats(), and every nonempty partition
+ * has statistics including a distinct sketch for each of them; the caller
+ * then samples the partitions as usual.
+ */
+static bool
+merge_partition_stats(Relation onerel, int elevel,
+					  int attr_cnt, VacAttrStats **vacattrstats)
+{
+	List	   *tableOIDs;
+	Oid		   *partoids;
+	double	   *reltuples;
+	HeapTuple  *statstuples;
+	double	   *statsreltuples;
+	int			nparts;
+	int			i,
+				j;
+	ListCell   *lc;
+	bool		ok = true;
 
-		/* Check for null/nonnull */
-		if (isnull)
-		{
-			null_cnt++;
+	for (i = 0; i < attr_cnt; i++)
+	{
+		if (vacattrstats[i]->compute_stats != compute_scalar_stats)
+			return false;
+	}
+
+	/* Find the leaf partitions, and how many rows each of them has */
+	tableOIDs =
+		find_all_inheritors(RelationGetRelid(onerel), AccessShareLock, NULL);
+	partoids = (Oid *) palloc(list_length(tableOIDs) * sizeof(Oid));
+	reltuples = (double *) palloc(list_length(tableOIDs) * sizeof(double));
+	nparts = 0;
+	foreach(lc, tableOIDs)
+	{
+		Oid			childOID = lfirst_oid(lc);
+		Relation	childrel;
+
+		if (childOID == RelationGetRelid(onerel))
 			continue;
-		}
-		nonnull_cnt++;
 
-		/*
-		 * If it's a variable-width field, add up widths for average width
-		 * calculation.  Note that if the value is toasted, we use the toasted
-		 * width.  We don't bother with this calculation if it's a fixed-width
-		 * type.
-		 */
-		if (is_varlena)
+		/* We already got the needed lock */
+		childrel = heap_open(childOID, NoLock);
+		if (childrel->rd_rel->relkind != RELKIND_PARTITIONED_TABLE &&
+			!RELATION_IS_OTHER_TEMP(childrel))
 		{
-			total_width += VARSIZE_ANY(DatumGetPointer(value));
+			partoids[nparts] = childOID;
+			reltuples[nparts] = childrel->rd_rel->reltuples;
 
 			/*
-			 * If the value is toasted, we want to detoast it just once to
-			 * avoid repeated detoastings and resultant excess memory usage
-			 * during the comparisons.  Also, check to see if the value is
-			 * excessively wide, and if so don't detoast at all --- just
-			 * ignore the value.
+			 * A partition that was never vacuumed or analyzed has zero
+			 * reltuples, but it need not be empty.
 			 */
-			if (toast_raw_datum_size(value) > WIDTH_THRESHOLD)
-			{
-				toowide_cnt++;
-				continue;
-			}
-			value = PointerGetDatum(PG_DETOAST_DATUM(value));
-		}
-		else if (is_varwidth)
-		{
-			/* must be cstring */
-			total_width += strlen(DatumGetCString(value)) + 1;
+			if (reltuples[nparts] <= 0 &&
+				childrel->rd_rel->relkind != RELKIND_FOREIGN_TABLE &&
+				RelationGetNumberOfBlocks(childrel) > 0)
+				ok = false;
+			nparts++;
 		}
-
-		/* Add it to the list to be sorted */
-		values[values_cnt].value = value;
-		values[values_cnt].tupno = values_cnt;
-		tupnoLink[values_cnt] = values_cnt;
-		values_cnt++;
+		heap_close(childrel, NoLock);
 	}
 
-	/* We can only compute real stats if we found some sortable values. */
-	if (values_cnt > 0)
+	statstuples = (HeapTuple *) palloc(Max(nparts, 1) * sizeof(HeapTuple));
+	statsreltuples = (double *) palloc(Max(nparts, 1) * sizeof(double));
+	for (i = 0; i < attr_cnt && ok; i++)
 	{
-		int			ndistinct,	/* # distinct values in sample */
-					nmultiple,	/* # that appear multiple times */
-					num_hist,
-					dups_cnt;
-		int			slot_idx = 0;
-		CompareScalarsContext cxt;
-
-		/* Sort the collected values */
-		cxt.ssup = &ssup;
-		cxt.tupnoLink = tupnoLink;
-		qsort_arg((void *) values, values_cnt, sizeof(ScalarItem),
-				  compare_scalars, (void *) &cxt);
+		VacAttrStats *stats = vacattrstats[i];
+		int			nstats = 0;
 
-		/*
-		 * Now scan the values in order, find the most common ones, and also
-		 * accumulate ordering-correlation statistics.
-		 *
-		 * To determine which are most common, we first have to count the
-		 * number of duplicates of each value.  The duplicates are adjacent in
-		 * the sorted list, so a brute-force approach is to compare successive
-		 * datum values until we find two that are not equal. However, that
-		 * requires N-1 invocations of the datum comparison routine, which are
-		 * completely redundant with work that was done during the sort.  (The
-		 * sort algorithm must at some point have compared each pair of items
-		 * that are adjacent in the sorted order; otherwise it could not know
-		 * that it's ordered the pair correctly.) We exploit this by having
-		 * compare_scalars remember the highest tupno index that each
-		 * ScalarItem has been found equal to.  At the end of the sort, a
-		 * ScalarItem's tupnoLink will still point to itself if and only if it
-		 * is the last item of its group of duplicates (since the group will
-		 * be ordered by tupno).
-		 */
-		corr_xysum = 0;
-		ndistinct = 0;
-		nmultiple = 0;
-		dups_cnt = 0;
-		for (i = 0; i < values_cnt; i++)
+		for (j = 0; j < nparts; j++)
 		{
-			int			tupno = values[i].tupno;
+			AttrNumber	attnum;
+			HeapTuple	statstuple;
 
-			corr_xysum += ((double) i) * ((double) tupno);
-			dups_cnt++;
-			if (tupnoLink[tupno] == tupno)
+			/* Partitions' column numbers can differ from the parent's */
+			attnum = get_attnum(partoids[j], NameStr(stats->attr->attname));
+			if (attnum == InvalidAttrNumber)
 			{
-				/* Reached end of duplicates of this value */
-				ndistinct++;
-				if (dups_cnt > 1)
-				{
-					nmultiple++;
-					if (track_cnt < num_mcv ||
-						dups_cnt > track[track_cnt - 1].count)
-					{
-						/*
-						 * Found a new item for the mcv list; find its
-						 * position, bubbling down old items if needed. Loop
-						 * invariant is that j points at an empty/ replaceable
-						 * slot.
-						 */
-						int			j;
+				ok = false;
+				break;
+			}
 
-						if (track_cnt < num_mcv)
-							track_cnt++;
-						for (j = track_cnt - 1; j > 0; j--)
-						{
-							if (dups_cnt <= track[j - 1].count)
-								break;
-							track[j].count = track[j - 1].count;
-							track[j].first = track[j - 1].first;
-						}
-						track[j].count = dups_cnt;
-						track[j].first = i + 1 - dups_cnt;
-					}
-				}
-				dups_cnt = 0;
+			statstuple = SearchSysCache3(STATRELATTINH,
+										 ObjectIdGetDatum(partoids[j]),
+										 Int16GetDatum(attnum),
+										 BoolGetDatum(false));
+
+			/* An empty partition has no statistics, and needs none */
+			if (reltuples[j] <= 0)
+			{
+				if (HeapTupleIsValid(statstuple))
+					ReleaseSysCache(statstuple);
+				continue;
+			}
+			if (!HeapTupleIsValid(statstuple))
+			{
+				ok = false;
+				break;
 			}
+
+			statstuples[nstats] = statstuple;
+			statsreltuples[nstats] = reltuples[j];
+			nstats++;
 		}
 
-		stats->stats_valid = true;
-		/* Do the simple null-frac and width stats */
-		stats->stanullfrac = (double) null_cnt / (double) samplerows;
-		if (is_varwidth)
-			stats->stawidth = total_width / (double) nonnull_cnt;
-		else
-			stats->stawidth = stats->attrtype->typlen;
+		if (ok)
+			ok = merge_partition_attr_stats(stats, nstats, statstuples,
+											statsreltuples);
 
-		if (nmultiple == 0)
-		{
-			/*
-			 * If we found no repeated non-null values, assume it's a unique
-			 * column; but be sure to discount for any nulls we found.
-			 */
-			stats->stadistinct = -1.0 * (1.0 - stats->stanullfrac);
-		}
-		else if (toowide_cnt == 0 && nmultiple == ndistinct)
+		for (j = 0; j < nstats; j++)
+			ReleaseSysCache(statstuples[j]);
+	}
+
+	if (!ok)
+	{
+		/* Forget what we merged so far */
+		for (i = 0; i < attr_cnt; i++)
 		{
-			/*
-			 * Every value in the sample appeared more than once.  Assume the
-			 * column has just these values.  (This case is meant to address
-			 * columns with small, fixed sets of possible values, such as
-			 * boolean or enum columns.  If there are any values that appear
-			 * just once in the sample, including too-wide values, we should
-			 * assume that that's not what we're dealing with.)
-			 */
-			stats->stadistinct = ndistinct;
+			VacAttrStats *stats = vacattrstats[i];
+
+			stats->stats_valid = false;
+			memset(stats->stakind, 0, sizeof(stats->stakind));
+			memset(stats->staop, 0, sizeof(stats->staop));
+			memset(stats->numnumbers, 0, sizeof(stats->numnumbers));
+			memset(stats->stanumbers, 0, sizeof(stats->stanumbers));
+			memset(stats->numvalues, 0, sizeof(stats->numvalues));
+			memset(stats->stavalues, 0, sizeof(stats->stavalues));
 		}
-		else
-		{
-			/*----------
-			 * Estimate the number of distinct values using the estimator
-			 * proposed by Haas and Stokes in IBM Research Report RJ 10025:
-			 *		n*d / (n - f1 + f1*n/N)
-			 * where f1 is the number of distinct values that occurred
-			 * exactly once in our sample of n rows (from a total of N),
-			 * and d is the total number of distinct values in the sample.
-			 * This is their Duj1 estimator; the other estimators they
-			 * recommend are considerably more complex, and are numerically
-			 * very unstable when n is much smaller than N.
-			 *
-			 * In this calculation, we consider only non-nulls.  We used to
-			 * include rows with null values in the n and N counts, but that
-			 * leads to inaccurate answers in columns with many nulls, and
-			 * it's intuitively bogus anyway considering the desired result is
-			 * the number of distinct non-null values.
-			 *
-			 * Overwidth values are assumed to have been distinct.
-			 *----------
-			 */
-			int			f1 = ndistinct - nmultiple + toowide_cnt;
-			int			d = f1 + nmultiple;
-			double		n = samplerows - null_cnt;
-			double		N = totalrows * (1.0 - stats->stanullfrac);
-			double		stadistinct;
 
-			/* N == 0 shouldn't happen, but just in case ... */
-			if (N > 0)
-				stadistinct = (n * d) / ((n - f1) + f1 * n / N);
-			else
-				stadistinct = 0;
+		ereport(elevel,
+				(errmsg("statistics of partitions of \"%s.%s\" are incomplete, sampling them instead",
+						get_namespace_name(RelationGetNamespace(onerel)),
+						RelationGetRelationName(onerel))));
+		return false;
+	}
+
+	ereport(elevel,
+			(errmsg("merged statistics of %d partitions of \"%s.%s\"",
+					nparts,
+					get_namespace_name(RelationGetNamespace(onerel)),
+					RelationGetRelationName(onerel))));
+	return true;
+}
+
+/*
+ * A value seen in a partition's MCV list or histogram, and the number of
+ * rows it stands for
+ */
+typedef struct
+{
+	Datum		value;
+	double		mcvrows;		/* rows, per the MCV lists it appears in */
+	double		histrows;		/* rows, per the histograms it appears in */
+	bool		ismcv;			/* chosen for the merged MCV list? */
+} PartStatsItem;
 
-			/* Clamp to sane range in case of roundoff error */
-			if (stadistinct < d)
-				stadistinct = d;
-			if (stadistinct > N)
-				stadistinct = N;
-			/* And round to integer */
-			stats->stadistinct = floor(stadistinct + 0.5);
-		}
+/*
+ * merge_partition_attr_stats -- merge the statistics of one column
+ *
+ * statstuples[] are the column's pg_statistic rows for the nonempty
+ * partitions, whose reltuples are in reltuples[].
+ *
+ * Null fraction and width are averaged, weighted by the partitions' sizes.
+ * The number of distinct values is the sum of the partitions' estimates,
+ * scaled down by the overlap between partitions that their distinct
+ * sketches indicate.  The MCV lists are added up, and each histogram bound
+ * is taken to represent its share of the partition's rows; the merged
+ * histogram is then drawn from the weighted values that aren't MCVs.
+ */
+static bool
+merge_partition_attr_stats(VacAttrStats *stats, int nparts,
+						   HeapTuple *statstuples, double *reltuples)
+{
+	StdAnalyzeData *mystats = (StdAnalyzeData *) stats->extra_data;
+	int			num_mcv = stats->attr->attstattarget;
+	int			num_bins = stats->attr->attstattarget;
+	hyperLogLogState sketch;
+	double		sketchvalues = 0;
+	double		sketchsum = 0;
+	bool		sketchwhole = true;
+	double		totalrows = 0;
+	double		nonnullrows = 0;
+	double		widthsum = 0;
+	double		distinctsum = 0;
+	double		distinctmax = 0;
+	double		ndistinct;
+	PartStatsItem *items;
+	int			nitems = 0;
+	int			maxitems = 64;
+	int		   *order;
+	int			nmcv;
+	int			nhist;
+	int			slot_idx = 0;
+	int			i,
+				j;
+	SortSupportData ssup;
 
-		/*
-		 * If we estimated the number of distinct values at more than 10% of
-		 * the total row count (a very arbitrary limit), then assume that
-		 * stadistinct should scale with the row count rather than be a fixed
-		 * value.
-		 */
-		if (stats->stadistinct > 0.1 * totalrows)
-			stats->stadistinct = -(stats->stadistinct / totalrows);
+	if (nparts == 0)
+		return false;
 
-		/*
-		 * Decide how many values are worth storing as most-common values. If
-		 * we are able to generate a complete MCV list (all the values in the
-		 * sample will fit, and we think these are all the ones in the table),
-		 * then do so.  Otherwise, store only those values that are
-		 * significantly more common than the (estimated) average. We set the
-		 * threshold rather arbitrarily at 25% more than average, with at
-		 * least 2 instances in the sample.  Also, we won't suppress values
-		 * that have a frequency of at least 1/K where K is the intended
-		 * number of histogram bins; such values might otherwise cause us to
-		 * emit duplicate histogram bin boundaries.  (We might end up with
-		 * duplicate histogram entries anyway, if the distribution is skewed;
-		 * but we prefer to treat such values as MCVs if at all possible.)
-		 *
-		 * Note: the first of these cases is meant to address columns with
-		 * small, fixed sets of possible values, such as boolean or enum
-		 * columns.  If we can *completely* represent the column population by
-		 * an MCV list that will fit into the stats target, then we should do
-		 * so and thus provide the planner with complete information.  But if
-		 * the MCV list is not complete, it's generally worth being more
-		 * selective, and not just filling it all the way up to the stats
-		 * target.  So for an incomplete list, we try to take only MCVs that
-		 * are significantly more common than average.
-		 */
-		if (track_cnt == ndistinct && toowide_cnt == 0 &&
-			stats->stadistinct > 0 &&
-			track_cnt <= num_mcv)
+	items = (PartStatsItem *) palloc(maxitems * sizeof(PartStatsItem));
+	initHyperLogLog(&sketch, ANALYZE_SKETCH_BWIDTH);
+
+	for (i = 0; i < nparts; i++)
+	{
+		Form_pg_statistic stat = (Form_pg_statistic) GETSTRUCT(statstuples[i]);
+		double		rows = reltuples[i];
+		double		nonnull = rows * (1.0 - stat->stanullfrac);
+		double		mcvrows = 0;
+		hyperLogLogState partsketch;
+		double		partvalues;
+		bool		partwhole;
+		AttStatsSlot sslot;
+
+		if (!fetch_distinct_sketch(statstuples[i], &partsketch, &partvalues,
+								   &partwhole))
+			return false;
+		sketchsum += estimateHyperLogLog(&partsketch);
+		sketchvalues += partvalues;
+		if (!partwhole)
+			sketchwhole = false;
+		mergeHyperLogLog(&sketch, &partsketch);
+		freeHyperLogLog(&partsketch);
+
+		totalrows += rows;
+		nonnullrows += nonnull;
+		widthsum += nonnull * stat->stawidth;
+		if (stat->stadistinct >= 0)
 		{
-			/* Track list includes all values seen, and all will fit */
-			num_mcv = track_cnt;
+			distinctsum += stat->stadistinct;
+			distinctmax = Max(distinctmax, stat->stadistinct);
 		}
 		else
 		{
-			double		ndistinct_table = stats->stadistinct;
-			double		avgcount,
-						mincount,
-						maxmincount;
+			distinctsum += -stat->stadistinct * rows;
+			distinctmax = Max(distinctmax, -stat->stadistinct * rows);
+		}
 
-			/* Re-extract estimate of # distinct nonnull values in table */
-			if (ndistinct_table < 0)
-				ndistinct_table = -ndistinct_table * totalrows;
-			/* estimate # occurrences in sample of a typical nonnull value */
-			avgcount = (double) nonnull_cnt / ndistinct_table;
-			/* set minimum threshold count to store a value */
-			mincount = avgcount * 1.25;
-			if (mincount < 2)
-				mincount = 2;
-			/* don't let threshold exceed 1/K, however */
-			maxmincount = (double) values_cnt / (double) num_bins;
-			if (mincount > maxmincount)
-				mincount = maxmincount;
-			if (num_mcv > track_cnt)
-				num_mcv = track_cnt;
-			for (i = 0; i < num_mcv; i++)
+		if (get_attstatsslot(&sslot, statstuples[i],
+							 STATISTIC_KIND_MCV, mystats->eqopr,
+							 ATTSTATSSLOT_VALUES | ATTSTATSSLOT_NUMBERS))
+		{
+			for (j = 0; j < sslot.nvalues; j++)
 			{
-				if (track[i].count < mincount)
+				if (nitems >= maxitems)
 				{
-					num_mcv = i;
-					break;
+					maxitems *= 2;
+					items = (PartStatsItem *)
+						repalloc(items, maxitems * sizeof(PartStatsItem));
 				}
+				items[nitems].value = datumCopy(sslot.values[j],
+												stats->attrtype->typbyval,
+												stats->attrtype->typlen);
+				items[nitems].mcvrows = sslot.numbers[j] * rows;
+				items[nitems].histrows = 0;
+				items[nitems].ismcv = false;
+				mcvrows += items[nitems].mcvrows;
+				nitems++;
 			}
+			free_attstatsslot(&sslot);
 		}
 
-		/* Generate MCV slot entry */
-		if (num_mcv > 0)
+		if (get_attstatsslot(&sslot, statstuples[i],
+							 STATISTIC_KIND_HISTOGRAM, mystats->ltopr,
+							 ATTSTATSSLOT_VALUES))
 		{
-			MemoryContext old_context;
-			Datum	   *mcv_values;
-			float4	   *mcv_freqs;
-
-			/* Must copy the target values into anl_context */
-			old_context = MemoryContextSwitchTo(stats->anl_context);
-			mcv_values = (Datum *) palloc(num_mcv * sizeof(Datum));
-			mcv_freqs = (float4 *) palloc(num_mcv * sizeof(float4));
-			for (i = 0; i < num_mcv; i++)
+			if (sslot.nvalues >= 2)
 			{
-				mcv_values[i] = datumCopy(values[track[i].first].value,
-										  stats->attrtype->typbyval,
-										  stats->attrtype->typlen);
-				mcv_freqs[i] = (double) track[i].count / (double) samplerows;
+				double		binrows;
+
+				/* The end bounds each get half a bin's rows */
+				binrows = Max(nonnull - mcvrows, 0) / (sslot.nvalues - 1);
+				for (j = 0; j < sslot.nvalues; j++)
+				{
+					if (nitems >= maxitems)
+					{
+						maxitems *= 2;
+						items = (PartStatsItem *)
+							repalloc(items, maxitems * sizeof(PartStatsItem));
+					}
+					items[nitems].value = datumCopy(sslot.values[j],
+													stats->attrtype->typbyval,
+													stats->attrtype->typlen);
+					items[nitems].mcvrows = 0;
+					items[nitems].histrows =
+						(j == 0 || j == sslot.nvalues - 1) ? binrows / 2 : binrows;
+					items[nitems].ismcv = false;
+					nitems++;
+				}
 			}
-			MemoryContextSwitchTo(old_context);
+			free_attstatsslot(&sslot);
+		}
+	}
 
-			stats->stakind[slot_idx] = STATISTIC_KIND_MCV;
-			stats->staop[slot_idx] = mystats->eqopr;
-			stats->stanumbers[slot_idx] = mcv_freqs;
-			stats->numnumbers[slot_idx] = num_mcv;
-			stats->stavalues[slot_idx] = mcv_values;
-			stats->numvalues[slot_idx] = num_mcv;
+	if (totalrows <= 0)
+		return false;
 
-			/*
-			 * Accept the defaults for stats->statypid and others. They have
-			 * been set before we were called (see vacuum.h)
-			 */
-			slot_idx++;
+	/*
+	 * Estimate the number of distinct values.  If the sketches say that the
+	 * partitions' values overlap, the sum of their counts is too high by the
+	 * same factor.
+	 */
+	ndistinct = distinctsum;
+	if (sketchsum > 0)
+		ndistinct *= estimateHyperLogLog(&sketch) / sketchsum;
+	ndistinct = Min(ndistinct, distinctsum);
+	ndistinct = Max(ndistinct, distinctmax);
+	ndistinct = Min(ndistinct, nonnullrows);
+	ndistinct = floor(ndistinct + 0.5);
+
+	stats->stats_valid = true;
+	stats->stanullfrac = 1.0 - nonnullrows / totalrows;
+	stats->stanullfrac = Max(stats->stanullfrac, 0.0);
+	if (nonnullrows > 0)
+		stats->stawidth = (int32) rint(widthsum / nonnullrows);
+	else
+		stats->stawidth = 0;
+	if (ndistinct > 0.1 * totalrows)
+		stats->stadistinct = -(ndistinct / totalrows);
+	else
+		stats->stadistinct = ndistinct;
+
+	/* Sort the values and merge duplicates */
+	memset(&ssup, 0, sizeof(ssup));
+	ssup.ssup_cxt = CurrentMemoryContext;
+	/* We always use the default collation for statistics */
+	ssup.ssup_collation = DEFAULT_COLLATION_OID;
+	ssup.ssup_nulls_first = false;
+	PrepareSortSupportFromOrderingOp(mystats->ltopr, &ssup);
+
+	if (nitems > 1)
+		qsort_arg((void *) items, nitems, sizeof(PartStatsItem),
+				  compare_part_items, (void *) &ssup);
+	j = 0;
+	for (i = 1; i < nitems; i++)
+	{
+		if (ApplySortComparator(items[j].value, false,
+								items[i].value, false, &ssup) == 0)
+		{
+			items[j].mcvrows += items[i].mcvrows;
+			items[j].histrows += items[i].histrows;
 		}
+		else
+			items[++j] = items[i];
+	}
+	if (nitems > 0)
+		nitems = j + 1;
 
-		/*
-		 * Generate a histogram slot entry if there are at least two distinct
-		 * values not accounted for in the MCV list.  (This ensures the
-		 * histogram won't collapse to empty or a singleton.)
-		 */
-		num_hist = ndistinct - num_mcv;
-		if (num_hist > num_bins)
-			num_hist = num_bins + 1;
-		if (num_hist >= 2)
+	/*
+	 * Choose the MCVs among the values that were an MCV in some partition.
+	 * Unless they'd all fit, we insist on them being more common than the
+	 * average value, as compute_scalar_stats does.
+	 */
+	order = (int *) palloc(Max(nitems, 1) * sizeof(int));
+	nmcv = 0;
+	for (i = 0; i < nitems; i++)
+	{
+		if (items[i].mcvrows > 0)
+			order[nmcv++] = i;
+	}
+	if (nmcv > 1)
+		qsort_arg((void *) order, nmcv, sizeof(int),
+				  compare_part_mcvs, (void *) items);
+	if (ndistinct > num_mcv)
+	{
+		double		avgcount = nonnullrows / ndistinct;
+
+		for (i = 0; i < nmcv && i < num_mcv; i++)
 		{
-			MemoryContext old_context;
-			Datum	   *hist_values;
-			int			nvals;
-			int			pos,
-						posfrac,
-						delta,
-						deltafrac;
+			if (items[order[i]].mcvrows < 1.25 * avgcount)
+				break;
+		}
+		nmcv = i;
+	}
+	nmcv = Min(nmcv, num_mcv);
 
-			/* Sort the MCV items into position order to speed next loop */
-			qsort((void *) track, num_mcv,
-				  sizeof(ScalarMCVItem), compare_mcvs);
+	if (nmcv > 0)
+	{
+		MemoryContext old_context;
+		Datum	   *mcv_values;
+		float4	   *mcv_freqs;
+
+		old_context = MemoryContextSwitchTo(stats->anl_context);
+		mcv_values = (Datum *) palloc(nmcv * sizeof(Datum));
+		mcv_freqs = (float4 *) palloc(nmcv * sizeof(float4));
+		for (i = 0; i < nmcv; i++)
+		{
+			PartStatsItem *item = &items[order[i]];
 
-			/*
-			 * Collapse out the MCV items from the values[] array.
-			 *
-			 * Note we destroy the values[] array here... but we don't need it
-			 * for anything more.  We do, however, still need values_cnt.
-			 * nvals will be the number of remaining entries in values[].
-			 */
-			if (num_mcv > 0)
-			{
-				int			src,
-							dest;
-				int			j;
+			item->ismcv = true;
+			mcv_values[i] = datumCopy(item->value,
+									  stats->attrtype->typbyval,
+									  stats->attrtype->typlen);
+			mcv_freqs[i] = item->mcvrows / totalrows;
+		}
+		MemoryContextSwitchTo(old_context);
 
-				src = dest = 0;
-				j = 0;			/* index of next interesting MCV item */
-				while (src < values_cnt)
-				{
-					int			ncopy;
+		stats->stakind[slot_idx] = STATISTIC_KIND_MCV;
+		stats->staop[slot_idx] = mystats->eqopr;
+		stats->stanumbers[slot_idx] = mcv_freqs;
+		stats->numnumbers[slot_idx] = nmcv;
+		stats->stavalues[slot_idx] = mcv_values;
+		stats->numvalues[slot_idx] = nmcv;
+		slot_idx++;
+	}
 
-					if (j < num_mcv)
-					{
-						int			first = track[j].first;
+	/*
+	 * Build the histogram from the remaining values, placing its bounds at
+	 * evenly spaced fractions of the rows they stand for.
+	 */
+	nhist = 0;
+	for (i = 0; i < nitems; i++)
+	{
+		if (!items[i].ismcv)
+			items[nhist++] = items[i];
+	}
+	if (nhist >= 2)
+	{
+		MemoryContext old_context;
+		Datum	   *hist_values;
+		int			num_hist = Min(num_bins + 1, nhist);
+		double		histrows = 0;
+		double		cumrows = 0;
+		int			k = 0;
+
+		for (i = 0; i < nhist; i++)
+			histrows += items[i].mcvrows + items[i].histrows;
+
+		old_context = MemoryContextSwitchTo(stats->anl_context);
+		hist_values = (Datum *) palloc(num_hist * sizeof(Datum));
+		for (i = 0; i < num_hist; i++)
+		{
+			double		target = histrows * i / (num_hist - 1);
 
-						if (src >= first)
-						{
-							/* advance past this MCV item */
-							src = first + track[j].count;
-							j++;
-							continue;
-						}
-						ncopy = first - src;
-					}
-					else
-						ncopy = values_cnt - src;
-					memmove(&values[dest], &values[src],
-							ncopy * sizeof(ScalarItem));
-					src += ncopy;
-					dest += ncopy;
+			/* Leave enough values for the remaining bounds */
+			if (i == num_hist - 1)
+				k = nhist - 1;
+			else
+			{
+				while (k < nhist - (num_hist - i) &&
+					   cumrows + items[k].mcvrows + items[k].histrows < target)
+				{
+					cumrows += items[k].mcvrows + items[k].histrows;
+					k++;
 				}
-				nvals = dest;
 			}
-			else
-				nvals = values_cnt;
-			Assert(nvals >= num_hist);
+			hist_values[i] = datumCopy(items[k].value,
+									   stats->attrtype->typbyval,
+									   stats->attrtype->typlen);
+			cumrows += items[k].mcvrows + items[k].histrows;
+			k++;
+		}
+		MemoryContextSwitchTo(old_context);
+
+		stats->stakind[slot_idx] = STATISTIC_KIND_HISTOGRAM;
+		stats->staop[slot_idx] = mystats->ltopr;
+		stats->stavalues[slot_idx] = hist_values;
+		stats->numvalues[slot_idx] = num_hist;
+		slot_idx++;
+	}
+
+	/*
+	 * The union of the partitions' sketches is the parent's.  It covers the
+	 * whole parent only if each of them covers its whole partition.
+	 */
+	store_distinct_sketch(stats, slot_idx, &sketch, sketchvalues,
+						  sketchwhole);
+	freeHyperLogLog(&sketch);
+
+	return true;
+}
+
+/*
+ * qsort_arg comparator for sorting PartStatsItems by value
+ */
+static int
+compare_part_items(const void *a, const void *b, void *arg)
+{
+	Datum		da = ((const PartStatsItem *) a)->value;
+	Datum		db = ((const PartStatsItem *) b)->value;
+
+	return ApplySortComparator(da, false, db, false, (SortSupport) arg);
+}
+
+/*
+ * qsort_arg comparator for sorting indexes of PartStatsItems by decreasing
+ * MCV row count
+ */
+static int
+compare_part_mcvs(const void *a, const void *b, void *arg)
+{
+	const PartStatsItem *items = (const PartStatsItem *) arg;
+	double		ra = items[*(const int *) a].mcvrows;
+	double		rb = items[*(const int *) b].mcvrows;
+
+	if (ra > rb)
+		return -1;
+	if (ra < rb)
+		return 1;
+	return *(const int *) a - *(const int *) b;
+}
+
+/*
+ *	compute_distinct_sketch() -- add a HyperLogLog sketch of the sampled
+ *		values to a column's statistics
+ *
+ *	The sketch goes into a slot that compute_stats left free, if any.  Types
+ *	without a hash opclass get none.
+ *
+ *	If the sample didn't include every row, and the column has a sketch that
+ *	a scan of the whole table built (see begin_column_sketches()), the sample
+ *	is added to that one instead, so that it keeps up with values inserted
+ *	since, and the number of distinct values is taken from the result rather
+ *	than from the sample.  Values that are gone can't be taken out of a
+ *	sketch, though; one that claims more distinct values than there are rows
+ *	is evidently out of date, and is dropped.
+ */
+static void
+compute_distinct_sketch(VacAttrStatsP stats,
+						AnalyzeAttrFetchFunc fetchfunc,
+						int samplerows, double totalrows, bool inh)
+{
+	TypeCacheEntry *typentry;
+	hyperLogLogState sketch;
+	double		nvalues = 0;
+	bool		wholetable = false;
+	int			slot;
+	int			i;
+
+	if (!stats->stats_valid)
+		return;
+
+	for (slot = 0; slot < STATISTIC_NUM_SLOTS; slot++)
+	{
+		if (stats->stakind[slot] == 0)
+			break;
+	}
+	if (slot >= STATISTIC_NUM_SLOTS)
+		return;
+
+	typentry = lookup_type_cache(stats->attrtypid, TYPECACHE_HASH_PROC_FINFO);
+	if (!OidIsValid(typentry->hash_proc))
+		return;
 
-			/* Must copy the target values into anl_context */
-			old_context = MemoryContextSwitchTo(stats->anl_context);
-			hist_values = (Datum *) palloc(num_hist * sizeof(Datum));
+	initHyperLogLog(&sketch, ANALYZE_SKETCH_BWIDTH);
+	for (i = 0; i < samplerows; i++)
+	{
+		Datum		value;
+		bool		isnull;
+		uint32		hash;
 
-			/*
-			 * The object of this loop is to copy the first and last values[]
-			 * entries along with evenly-spaced values in between.  So the
-			 * i'th value is values[(i * (nvals - 1)) / (num_hist - 1)].  But
-			 * computing that subscript directly risks integer overflow when
-			 * the stats target is more than a couple thousand.  Instead we
-			 * add (nvals - 1) / (num_hist - 1) to pos at each step, tracking
-			 * the integral and fractional parts of the sum separately.
-			 */
-			delta = (nvals - 1) / (num_hist - 1);
-			deltafrac = (nvals - 1) % (num_hist - 1);
-			pos = posfrac = 0;
+		vacuum_delay_point();
 
-			for (i = 0; i < num_hist; i++)
+		value = fetchfunc(stats, i, &isnull);
+		if (isnull)
+			continue;
+
+		hash = DatumGetUInt32(FunctionCall1Coll(&typentry->hash_proc_finfo,
+												DEFAULT_COLLATION_OID,
+												value));
+		addHyperLogLog(&sketch, hash);
+		nvalues += 1;
+	}
+
+	if (nvalues > 0 && samplerows < totalrows)
+	{
+		HeapTuple	statstuple;
+		hyperLogLogState oldsketch;
+		double		oldvalues;
+		bool		oldwhole;
+
+		statstuple = SearchSysCache3(STATRELATTINH,
+									 ObjectIdGetDatum(stats->attr->attrelid),
+									 Int16GetDatum(stats->attr->attnum),
+									 BoolGetDatum(inh));
+		if (HeapTupleIsValid(statstuple))
+		{
+			if (fetch_distinct_sketch(statstuple, &oldsketch, &oldvalues,
+									  &oldwhole))
 			{
-				hist_values[i] = datumCopy(values[pos].value,
-										   stats->attrtype->typbyval,
-										   stats->attrtype->typlen);
-				pos += delta;
-				posfrac += deltafrac;
-				if (posfrac >= (num_hist - 1))
+				double		nonnull = totalrows * (1.0 - stats->stanullfrac);
+
+				/* allow for the sketch's own error when checking it */
+				if (oldwhole &&
+					estimateHyperLogLog(&oldsketch) <= nonnull * 1.1)
 				{
-					/* fractional part exceeds 1, carry to integer part */
-					pos++;
-					posfrac -= (num_hist - 1);
+					mergeHyperLogLog(&sketch, &oldsketch);
+					nvalues = nonnull;
+					wholetable = true;
+					stats->stadistinct = sketch_stadistinct(&sketch, nvalues,
+															totalrows);
 				}
+				freeHyperLogLog(&oldsketch);
 			}
+			ReleaseSysCache(statstuple);
+		}
+	}
 
-			MemoryContextSwitchTo(old_context);
+	if (nvalues > 0)
+		store_distinct_sketch(stats, slot, &sketch, nvalues, wholetable);
+	freeHyperLogLog(&sketch);
+}
 
-			stats->stakind[slot_idx] = STATISTIC_KIND_HISTOGRAM;
-			stats->staop[slot_idx] = mystats->ltopr;
-			stats->stavalues[slot_idx] = hist_values;
-			stats->numvalues[slot_idx] = num_hist;
+/*
+ * store_distinct_sketch() -- put a distinct sketch into the given slot
+ */
+static void
+store_distinct_sketch(VacAttrStatsP stats, int slot,
+					  hyperLogLogState *sketch, double nvalues,
+					  bool wholetable)
+{
+	MemoryContext old_context;
 
-			/*
-			 * Accept the defaults for stats->statypid and others. They have
-			 * been set before we were called (see vacuum.h)
-			 */
-			slot_idx++;
-		}
+	if (slot >= STATISTIC_NUM_SLOTS)
+		return;
 
-		/* Generate a correlation entry if there are multiple values */
-		if (values_cnt > 1)
-		{
-			MemoryContext old_context;
-			float4	   *corrs;
-			double		corr_xsum,
-						corr_x2sum;
+	old_context = MemoryContextSwitchTo(stats->anl_context);
+	stats->stanumbers[slot] = form_distinct_sketch(sketch, nvalues,
+												   wholetable);
+	MemoryContextSwitchTo(old_context);
 
-			/* Must copy the target values into anl_context */
-			old_context = MemoryContextSwitchTo(stats->anl_context);
-			corrs = (float4 *) palloc(sizeof(float4));
-			MemoryContextSwitchTo(old_context);
+	stats->stakind[slot] = STATISTIC_KIND_DISTINCT_SKETCH;
+	stats->staop[slot] = lookup_type_cache(stats->attrtypid,
+										   TYPECACHE_EQ_OPR)->eq_opr;
+	stats->numnumbers[slot] = sketch->nRegisters + 2;
+}
 
-			/*----------
-			 * Since we know the x and y value sets are both
-			 *		0, 1, ..., values_cnt-1
-			 * we have sum(x) = sum(y) =
-			 *		(values_cnt-1)*values_cnt / 2
-			 * and sum(x^2) = sum(y^2) =
-			 *		(values_cnt-1)*values_cnt*(2*values_cnt-1) / 6.
-			 *----------
-			 */
-			corr_xsum = ((double) (values_cnt - 1)) *
-				((double) values_cnt) / 2.0;
-			corr_x2sum = ((double) (values_cnt - 1)) *
-				((double) values_cnt) * (double) (2 * values_cnt - 1) / 6.0;
+/*
+ * form_distinct_sketch() -- build the stanumbers array of a distinct sketch
+ */
+static float4 *
+form_distinct_sketch(hyperLogLogState *sketch, double nvalues,
+					 bool wholetable)
+{
+	float4	   *numbers;
+	Size		i;
 
-			/* And the correlation coefficient reduces to */
-			corrs[0] = (values_cnt * corr_xysum - corr_xsum * corr_xsum) /
-				(values_cnt * corr_x2sum - corr_xsum * corr_xsum);
+	numbers = (float4 *) palloc((sketch->nRegisters + 2) * sizeof(float4));
+	for (i = 0; i < sketch->nRegisters; i++)
+		numbers[i] = sketch->hashesArr[i];
+	numbers[sketch->nRegisters] = nvalues;
+	numbers[sketch->nRegisters + 1] = wholetable ? 1.0 : 0.0;
 
-			stats->stakind[slot_idx] = STATISTIC_KIND_CORRELATION;
-			stats->staop[slot_idx] = mystats->ltopr;
-			stats->stanumbers[slot_idx] = corrs;
-			stats->numnumbers[slot_idx] = 1;
-			slot_idx++;
-		}
+	return numbers;
+}
+
+/*
+ * fetch_distinct_sketch() -- load the distinct sketch of a pg_statistic row
+ *
+ * Also returns the number of values it stands for, and whether those were
+ * all of the table's rather than just ANALYZE's sample.  Returns false if
+ * there's no sketch, or if it's of a different size than the ones we make.
+ */
+bool
+fetch_distinct_sketch(HeapTuple statstuple, hyperLogLogState *sketch,
+					  double *nvalues, bool *wholetable)
+{
+	AttStatsSlot sslot;
+	Size		i;
+
+	if (!get_attstatsslot(&sslot, statstuple,
+						  STATISTIC_KIND_DISTINCT_SKETCH, InvalidOid,
+						  ATTSTATSSLOT_NUMBERS))
+		return false;
+
+	if (sslot.nnumbers != (1 << ANALYZE_SKETCH_BWIDTH) + 2)
+	{
+		free_attstatsslot(&sslot);
+		return false;
 	}
-	else if (nonnull_cnt > 0)
+
+	initHyperLogLog(sketch, ANALYZE_SKETCH_BWIDTH);
+	for (i = 0; i < sketch->nRegisters; i++)
+		sketch->hashesArr[i] = (uint8) sslot.numbers[i];
+	*nvalues = sslot.numbers[sketch->nRegisters];
+	*wholetable = sslot.numbers[sketch->nRegisters + 1] != 0;
+
+	free_attstatsslot(&sslot);
+	return true;
+}
+
+/*
+ * Sketches of columns that a full-table scan is building, one per column the
+ * scan was asked about that is worth it.
+ */
+typedef struct ColumnSketch
+{
+	int			position;		/* index of the column in values[] */
+	AttrNumber	attnum;
+	Oid			eqopr;			/* for the pg_statistic slot */
+	FmgrInfo	hashfn;
+	hyperLogLogState sketch;
+	double		nvalues;		/* number of values hashed so far */
+} ColumnSketch;
+
+struct ColumnSketchState
+{
+	Oid			relid;
+	int			samplerows;		/* rows ANALYZE would sample */
+	double		nrows;			/* rows added so far */
+	int			ncolumns;
+	ColumnSketch *columns;
+	MemoryContext hashcxt;		/* for garbage left by hash functions */
+};
+
+/*
+ * begin_column_sketches() -- start building distinct sketches of the given
+ *		columns of a relation, during a scan that sees all of its rows
+ *
+ * Operations that read the whole table anyway, such as CREATE INDEX and
+ * CLUSTER, can build a sketch of each column for much less than ANALYZE would
+ * need to look at every row.  Those sketches are stored in pg_statistic
+ * marked as covering the whole table, and the column's number of distinct
+ * values is taken from them rather than estimated from ANALYZE's sample,
+ * which tends to be much too low for large columns with a skewed
+ * distribution.  Subsequent ANALYZEs add their samples to them.
+ *
+ * The caller passes each row's values to add_column_sketches(), with
+ * values[i] belonging to attnums[i]; attribute numbers that aren't
+ * positive are ignored.  Only columns that have been analyzed are looked at,
+ * as their statistics are where the sketches go.  Returns NULL if there's
+ * nothing to do.
+ */
+ColumnSketchState *
+begin_column_sketches(Relation rel, int ncolumns, const AttrNumber *attnums)
+{
+	TupleDesc	tupdesc = RelationGetDescr(rel);
+	ColumnSketchState *state;
+	int			samplerows = 0;
+	int			i;
+
+	/* Catalogs are left alone, as is everything during bootstrap */
+	if (IsBootstrapProcessingMode() || IsSystemRelation(rel))
+		return NULL;
+	if (rel->rd_rel->relkind != RELKIND_RELATION &&
+		rel->rd_rel->relkind != RELKIND_MATVIEW)
+		return NULL;
+
+	/* See how big ANALYZE's sample is; cf. std_typanalyze() */
+	for (i = 0; i < tupdesc->natts; i++)
 	{
-		/* We found some non-null values, but they were all too wide */
-		Assert(nonnull_cnt == toowide_cnt);
-		stats->stats_valid = true;
-		/* Do the simple null-frac and width stats */
-		stats->stanullfrac = (double) null_cnt / (double) samplerows;
-		if (is_varwidth)
-			stats->stawidth = total_width / (double) nonnull_cnt;
-		else
-			stats->stawidth = stats->attrtype->typlen;
-		/* Assume all too-wide values are distinct, so it's a unique column */
-		stats->stadistinct = -1.0 * (1.0 - stats->stanullfrac);
+		Form_pg_attribute attr = TupleDescAttr(tupdesc, i);
+		int			target = attr->attstattarget;
+
+		if (attr->attisdropped)
+			continue;
+		if (target < 0)
+			target = default_statistics_target;
+		samplerows = Max(samplerows, 300 * target);
 	}
-	else if (null_cnt > 0)
+
+	state = (ColumnSketchState *) palloc0(sizeof(ColumnSketchState));
+	state->relid = RelationGetRelid(rel);
+	state->samplerows = samplerows;
+	state->columns = (ColumnSketch *) palloc0(ncolumns * sizeof(ColumnSketch));
+
+	for (i = 0; i < ncolumns; i++)
 	{
-		/* We found only nulls; assume the column is entirely null */
-		stats->stats_valid = true;
-		stats->stanullfrac = 1.0;
-		if (is_varwidth)
-			stats->stawidth = 0;	/* "unknown" */
-		else
-			stats->stawidth = stats->attrtype->typlen;
-		stats->stadistinct = 0.0;	/* "unknown" */
+		AttrNumber	attnum = attnums[i];
+		Form_pg_attribute attr;
+		TypeCacheEntry *typentry;
+		ColumnSketch *column;
+
+		if (attnum <= 0 || attnum > tupdesc->natts)
+			continue;
+		attr = TupleDescAttr(tupdesc, attnum - 1);
+		if (attr->attisdropped || attr->attstattarget == 0)
+			continue;
+		if (!SearchSysCacheExists3(STATRELATTINH,
+								   ObjectIdGetDatum(state->relid),
+								   Int16GetDatum(attnum),
+								   BoolGetDatum(false)))
+			continue;
+
+		typentry = lookup_type_cache(attr->atttypid,
+									 TYPECACHE_EQ_OPR |
+									 TYPECACHE_HASH_PROC_FINFO);
+		if (!OidIsValid(typentry->hash_proc))
+			continue;
+
+		column = &state->columns[state->ncolumns++];
+		column->position = i;
+		column->attnum = attnum;
+		column->eqopr = typentry->eq_opr;
+		fmgr_info_copy(&column->hashfn, &typentry->hash_proc_finfo,
+					   CurrentMemoryContext);
+		initHyperLogLog(&column->sketch, ANALYZE_SKETCH_BWIDTH);
 	}
 
-	/* We don't need to bother cleaning up any of our temporary palloc's */
+	if (state->ncolumns == 0)
+	{
+		pfree(state->columns);
+		pfree(state);
+		return NULL;
+	}
+
+	state->hashcxt = AllocSetContextCreate(CurrentMemoryContext,
+										   "Column Sketches",
+										   ALLOCSET_SMALL_SIZES);
+	return state;
 }
 
 /*
- * qsort_arg comparator for sorting ScalarItems
+ * add_column_sketches() -- add one row to the sketches
+ */
+void
+add_column_sketches(ColumnSketchState *state, Datum *values, bool *isnull)
+{
+	MemoryContext oldcxt;
+	int			i;
+
+	oldcxt = MemoryContextSwitchTo(state->hashcxt);
+	for (i = 0; i < state->ncolumns; i++)
+	{
+		ColumnSketch *column = &state->columns[i];
+		uint32		hash;
+
+		if (isnull[column->position])
+			continue;
+
+		hash = DatumGetUInt32(FunctionCall1Coll(&column->hashfn,
+												DEFAULT_COLLATION_OID,
+												values[column->position]));
+		addHyperLogLog(&column->sketch, hash);
+		column->nvalues += 1;
+	}
+	MemoryContextSwitchTo(oldcxt);
+	MemoryContextReset(state->hashcxt);
+
+	state->nrows += 1;
+}
+
+/*
+ * end_column_sketches() -- store the sketches, and clean up
  *
- * Aside from sorting the items, we update the tupnoLink[] array
- * whenever two ScalarItems are found to contain equal datums.  The array
- * is indexed by tupno; for each ScalarItem, it contains the highest
- * tupno that that item's datum has been found to be equal to.  This allows
- * us to avoid additional comparisons in compute_scalar_stats().
+ * Tables that ANALYZE looks at in whole get no sketches, as its estimates
+ * are exact there.  Neither does anything if another backend might be
+ * updating the statistics at the same time (say, a second CREATE INDEX);
+ * holding ShareUpdateExclusiveLock keeps ANALYZE and other builds of
+ * sketches away until we commit.
  */
-static int
-compare_scalars(const void *a, const void *b, void *arg)
+void
+end_column_sketches(ColumnSketchState *state)
 {
-	Datum		da = ((const ScalarItem *) a)->value;
-	int			ta = ((const ScalarItem *) a)->tupno;
-	Datum		db = ((const ScalarItem *) b)->value;
-	int			tb = ((const ScalarItem *) b)->tupno;
-	CompareScalarsContext *cxt = (CompareScalarsContext *) arg;
-	int			compare;
+	int			i;
 
-	compare = ApplySortComparator(da, false, db, false, cxt->ssup);
-	if (compare != 0)
-		return compare;
+	if (state->nrows > state->samplerows &&
+		ConditionalLockRelationOid(state->relid, ShareUpdateExclusiveLock))
+	{
+		for (i = 0; i < state->ncolumns; i++)
+		{
+			ColumnSketch *column = &state->columns[i];
 
-	/*
-	 * The two datums are equal, so update cxt->tupnoLink[].
-	 */
-	if (cxt->tupnoLink[ta] < tb)
-		cxt->tupnoLink[ta] = tb;
-	if (cxt->tupnoLink[tb] < ta)
-		cxt->tupnoLink[tb] = ta;
+			if (column->nvalues > 0)
+				update_distinct_sketch(state->relid, column->attnum,
+									   column->eqopr, &column->sketch,
+									   column->nvalues, state->nrows);
+		}
+	}
 
-	/*
-	 * For equal datums, sort by tupno
-	 */
-	return ta - tb;
+	for (i = 0; i < state->ncolumns; i++)
+		freeHyperLogLog(&state->columns[i].sketch);
+	MemoryContextDelete(state->hashcxt);
+	pfree(state->columns);
+	pfree(state);
 }
 
 /*
- * qsort comparator for sorting ScalarMCVItems by position
+ * sketch_stadistinct() -- stadistinct according to a whole-table sketch
+ *
+ * nvalues is the number of non-null values in the table, totalrows the
+ * number of rows.  As in compute_scalar_stats(), the result is negative if
+ * the number of distinct values seems to grow with the table.
  */
-static int
-compare_mcvs(const void *a, const void *b)
+static double
+sketch_stadistinct(hyperLogLogState *sketch, double nvalues,
+				   double totalrows)
 {
-	int			da = ((const ScalarMCVItem *) a)->first;
-	int			db = ((const ScalarMCVItem *) b)->first;
+	double		ndistinct;
 
-	return da - db;
+	ndistinct = Min(estimateHyperLogLog(sketch), nvalues);
+	if (ndistinct > 0.1 * totalrows)
+		return -(ndistinct / totalrows);
+
+	ndistinct = floor(ndistinct + 0.5);
+	return Max(ndistinct, 1.0);
+}
+
+/*
+ * update_distinct_sketch() -- store a whole-table sketch of a column
+ *
+ * It replaces the sketch in the column's existing pg_statistic row, or goes
+ * into a free slot of it; failing both, it's thrown away.  The row's
+ * stadistinct is updated to match, unless the column's n_distinct option
+ * overrides it.
+ */
+static void
+update_distinct_sketch(Oid relid, AttrNumber attnum, Oid eqopr,
+					   hyperLogLogState *sketch, double nvalues,
+					   double totalrows)
+{
+	Relation	sd;
+	HeapTuple	oldtup;
+	Form_pg_statistic statform;
+	int			slot;
+
+	sd = heap_open(StatisticRelationId, RowExclusiveLock);
+
+	oldtup = SearchSysCache3(STATRELATTINH,
+							 ObjectIdGetDatum(relid),
+							 Int16GetDatum(attnum),
+							 BoolGetDatum(false));
+	if (!HeapTupleIsValid(oldtup))
+	{
+		heap_close(sd, RowExclusiveLock);
+		return;
+	}
+	statform = (Form_pg_statistic) GETSTRUCT(oldtup);
+
+	for (slot = 0; slot < STATISTIC_NUM_SLOTS; slot++)
+	{
+		if ((&statform->stakind1)[slot] == STATISTIC_KIND_DISTINCT_SKETCH)
+			break;
+	}
+	if (slot >= STATISTIC_NUM_SLOTS)
+	{
+		for (slot = 0; slot < STATISTIC_NUM_SLOTS; slot++)
+		{
+			if ((&statform->stakind1)[slot] == 0)
+				break;
+		}
+	}
+
+	if (slot < STATISTIC_NUM_SLOTS)
+	{
+		Datum		values[Natts_pg_statistic];
+		bool		nulls[Natts_pg_statistic];
+		bool		replaces[Natts_pg_statistic];
+		float4	   *numbers;
+		Datum	   *numdatums;
+		int			nnum = sketch->nRegisters + 2;
+		ArrayType  *arry;
+		AttributeOpts *aopt;
+		HeapTuple	stup;
+		int			k;
+
+		numbers = form_distinct_sketch(sketch, nvalues, true);
+		numdatums = (Datum *) palloc(nnum * sizeof(Datum));
+		for (k = 0; k < nnum; k++)
+			numdatums[k] = Float4GetDatum(numbers[k]);
+		arry = construct_array(numdatums, nnum, FLOAT4OID,
+							   sizeof(float4), FLOAT4PASSBYVAL, 'i');
+
+		memset(nulls, false, sizeof(nulls));
+		memset(replaces, false, sizeof(replaces));
+
+		values[Anum_pg_statistic_stakind1 - 1 + slot] =
+			Int16GetDatum(STATISTIC_KIND_DISTINCT_SKETCH);
+		replaces[Anum_pg_statistic_stakind1 - 1 + slot] = true;
+		values[Anum_pg_statistic_staop1 - 1 + slot] = ObjectIdGetDatum(eqopr);
+		replaces[Anum_pg_statistic_staop1 - 1 + slot] = true;
+		values[Anum_pg_statistic_stanumbers1 - 1 + slot] =
+			PointerGetDatum(arry);
+		replaces[Anum_pg_statistic_stanumbers1 - 1 + slot] = true;
+		nulls[Anum_pg_statistic_stavalues1 - 1 + slot] = true;
+		replaces[Anum_pg_statistic_stavalues1 - 1 + slot] = true;
+
+		aopt = get_attribute_options(relid, attnum);
+		if (aopt == NULL || aopt->n_distinct == 0.0)
+		{
+			values[Anum_pg_statistic_stadistinct - 1] =
+				Float4GetDatum(sketch_stadistinct(sketch, nvalues, totalrows));
+			replaces[Anum_pg_statistic_stadistinct - 1] = true;
+		}
+
+		stup = heap_modify_tuple(oldtup, RelationGetDescr(sd),
+								 values, nulls, replaces);
+		CatalogTupleUpdate(sd, &stup->t_self, stup);
+
+		heap_freetuple(stup);
+		pfree(arry);
+		pfree(numdatums);
+		pfree(numbers);
+	}
+
+	ReleaseSysCache(oldtup);
+	heap_close(sd, RowExclusiveLock);
 }
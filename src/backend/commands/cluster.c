@@ -75,7 +75,8 @@ static List *get_tables_to_cluster(MemoryContext cluster_context);
 static void reform_and_rewrite_tuple(HeapTuple tuple,
 						 TupleDesc oldTupDesc, TupleDesc newTupDesc,
 						 Datum *values, bool *isnull,
-						 bool newRelHasOids, RewriteState rwstate);
+						 bool newRelHasOids, RewriteState rwstate,
+						 ColumnSketchState *sketches);
 
 
 /*---------------------------------------------------------------------------
@@ -770,6 +771,9 @@ copy_heap_data(Oid OIDNewHeap, Oid OIDOldHeap, Oid OIDOldIndex, bool verbose,
 	RewriteState rwstate;
 	bool		use_sort;
 	Tuplesortstate *tuplesort;
+	AttrNumber *attnums;
+	ColumnSketchState *sketches;
+	int			i;
 	double		num_tuples = 0,
 				tups_vacuumed = 0,
 				tups_recently_dead = 0;
@@ -802,6 +806,15 @@ copy_heap_data(Oid OIDNewHeap, Oid OIDOldHeap, Oid OIDOldIndex, bool verbose,
 	values = (Datum *) palloc(natts * sizeof(Datum));
 	isnull = (bool *) palloc(natts * sizeof(bool));
 
+	/*
+	 * Since we're looking at every row anyway, sketch the distinct values of
+	 * each column for the planner.
+	 */
+	attnums = (AttrNumber *) palloc(natts * sizeof(AttrNumber));
+	for (i = 0; i < natts; i++)
+		attnums[i] = i + 1;
+	sketches = begin_column_sketches(OldHeap, natts, attnums);
+
 	/*
 	 * If the OldHeap has a toast table, get lock on the toast table to keep
 	 * it from being vacuumed.  This is needed because autovacuum processes
@@ -1057,7 +1070,8 @@ copy_heap_data(Oid OIDNewHeap, Oid OIDOldHeap, Oid OIDOldIndex, bool verbose,
 			reform_and_rewrite_tuple(tuple,
 									 oldTupDesc, newTupDesc,
 									 values, isnull,
-									 NewHeap->rd_rel->relhasoids, rwstate);
+									 NewHeap->rd_rel->relhasoids, rwstate,
+									 sketches);
 	}
 
 	if (indexScan != NULL)
@@ -1086,7 +1100,8 @@ copy_heap_data(Oid OIDNewHeap, Oid OIDOldHeap, Oid OIDOldIndex, bool verbose,
 			reform_and_rewrite_tuple(tuple,
 									 oldTupDesc, newTupDesc,
 									 values, isnull,
-									 NewHeap->rd_rel->relhasoids, rwstate);
+									 NewHeap->rd_rel->relhasoids, rwstate,
+									 sketches);
 		}
 
 		tuplesort_end(tuplesort);
@@ -1095,6 +1110,9 @@ copy_heap_data(Oid OIDNewHeap, Oid OIDOldHeap, Oid OIDOldIndex, bool verbose,
 	/* Write out any remaining tuples, and fsync if needed */
 	end_heap_rewrite(rwstate);
 
+	if (sketches)
+		end_column_sketches(sketches);
+
 	/* Reset rd_toastoid just to be tidy --- it shouldn't be looked at again */
 	NewHeap->rd_toastoid = InvalidOid;
 
@@ -1749,13 +1767,17 @@ static void
 reform_and_rewrite_tuple(HeapTuple tuple,
 						 TupleDesc oldTupDesc, TupleDesc newTupDesc,
 						 Datum *values, bool *isnull,
-						 bool newRelHasOids, RewriteState rwstate)
+						 bool newRelHasOids, RewriteState rwstate,
+						 ColumnSketchState *sketches)
 {
 	HeapTuple	copiedTuple;
 	int			i;
 
 	heap_deform_tuple(tuple, oldTupDesc, values, isnull);
 
+	if (sketches)
+		add_column_sketches(sketches, values, isnull);
+
 	/* Be sure to null out any dropped columns */
 	for (i = 0; i < newTupDesc->natts; i++)
 	{
@@ -102,6 +102,7 @@ static void show_tablesample(TableSampleClause *tsc, PlanState *planstate,
 				 List *ancestors, ExplainState *es);
 static void show_sort_info(SortState *sortstate, ExplainState *es);
 static void show_hash_info(HashState *hashstate, ExplainState *es);
+static void show_nestloop_info(NestLoopState *nlstate, ExplainState *es);
 static void show_tidbitmap_info(BitmapHeapScanState *planstate,
 					ExplainState *es);
 static void show_instrumentation_count(const char *qlabel, int which,
@@ -1566,6 +1567,8 @@ ExplainNode(PlanState *planstate, List *ancestors,
 			if (plan->qual)
 				show_instrumentation_count("Rows Removed by Filter", 2,
 										   planstate, es);
+			if (es->analyze)
+				show_nestloop_info(castNode(NestLoopState, planstate), es);
 			break;
 		case T_MergeJoin:
 			show_upper_qual(((MergeJoin *) plan)->mergeclauses,
@@ -2373,6 +2376,31 @@ show_sort_info(SortState *sortstate, ExplainState *es)
 	}
 }
 
+/*
+ * Show how many times a nested loop switched to hashing its inner input,
+ * and when it first did.
+ */
+static void
+show_nestloop_info(NestLoopState *nlstate, ExplainState *es)
+{
+	if (nlstate->nl_Switches == 0)
+		return;
+
+	if (es->format == EXPLAIN_FORMAT_TEXT)
+	{
+		appendStringInfoSpaces(es->str, es->indent * 2);
+		appendStringInfo(es->str,
+						 "Switches to Hash: %ld  First After: %.0f outer rows\n",
+						 nlstate->nl_Switches, nlstate->nl_SwitchedAfter);
+	}
+	else
+	{
+		ExplainPropertyLong("Switches to Hash", nlstate->nl_Switches, es);
+		ExplainPropertyFloat("First Switch After Rows",
+							 nlstate->nl_SwitchedAfter, 0, es);
+	}
+}
+
 /*
  * Show information on hash buckets/batches.
  */
@@ -84,6 +84,7 @@
 #include "rewrite/rewriteHandler.h"
 #include "rewrite/rewriteManip.h"
 #include "storage/bufmgr.h"
+#include "storage/fd.h"
 #include "storage/lmgr.h"
 #include "storage/lock.h"
 #include "storage/predicate.h"
@@ -11013,20 +11014,25 @@ copy_relation_data(SMgrRelation src, SMgrRelation dst,
 				   ForkNumber forkNum, char relpersistence)
 {
 	char	   *buf;
-	Page		page;
+	char	   *pages[PG_IOV_MAX];
 	bool		use_wal;
 	bool		copying_initfork;
 	BlockNumber nblocks;
 	BlockNumber blkno;
+	BlockNumber nchunk;
+	int			i;
 
 	/*
 	 * palloc the buffer so that it's MAXALIGN'd.  If it were just a local
 	 * char[] array, the compiler might align it on any byte boundary, which
 	 * can seriously hurt transfer speed to and from the kernel; not to
 	 * mention possibly making log_newpage's accesses to the page header fail.
+	 * The blocks are copied in chunks of up to PG_IOV_MAX, with one read and
+	 * one write each.
 	 */
-	buf = (char *) palloc(BLCKSZ);
-	page = (Page) buf;
+	buf = (char *) palloc(PG_IOV_MAX * BLCKSZ);
+	for (i = 0; i < PG_IOV_MAX; i++)
+		pages[i] = buf + i * BLCKSZ;
 
 	/*
 	 * The init fork for an unlogged relation in many respects has to be
@@ -11045,38 +11051,46 @@ copy_relation_data(SMgrRelation src, SMgrRelation dst,
 
 	nblocks = smgrnblocks(src, forkNum);
 
-	for (blkno = 0; blkno < nblocks; blkno++)
+	for (blkno = 0; blkno < nblocks; blkno += nchunk)
 	{
+		nchunk = Min(nblocks - blkno, PG_IOV_MAX);
+
 		/* If we got a cancel signal during the copy of the data, quit */
 		CHECK_FOR_INTERRUPTS();
 
-		smgrread(src, forkNum, blkno, buf);
+		smgrreadv(src, forkNum, blkno, pages, nchunk);
 
-		if (!PageIsVerified(page, blkno))
-			ereport(ERROR,
-					(errcode(ERRCODE_DATA_CORRUPTED),
-					 errmsg("invalid page in block %u of relation %s",
-							blkno,
-							relpathbackend(src->smgr_rnode.node,
-										   src->smgr_rnode.backend,
-										   forkNum))));
+		for (i = 0; i < nchunk; i++)
+		{
+			Page		page = (Page) pages[i];
 
-		/*
-		 * WAL-log the copied page. Unfortunately we don't know what kind of a
-		 * page this is, so we have to log the full page including any unused
-		 * space.
-		 */
-		if (use_wal)
-			log_newpage(&dst->smgr_rnode.node, forkNum, blkno, page, false);
+			if (!PageIsVerified(page, blkno + i))
+				ereport(ERROR,
+						(errcode(ERRCODE_DATA_CORRUPTED),
+						 errmsg("invalid page in block %u of relation %s",
+								blkno + i,
+								relpathbackend(src->smgr_rnode.node,
+											   src->smgr_rnode.backend,
+											   forkNum))));
 
-		PageSetChecksumInplace(page, blkno);
+			/*
+			 * WAL-log the copied page. Unfortunately we don't know what kind
+			 * of a page this is, so we have to log the full page including
+			 * any unused space.
+			 */
+			if (use_wal)
+				log_newpage(&dst->smgr_rnode.node, forkNum, blkno + i, page,
+							false);
+
+			PageSetChecksumInplace(page, blkno + i);
+		}
 
 		/*
-		 * Now write the page.  We say isTemp = true even if it's not a temp
+		 * Now write the pages.  We say isTemp = true even if it's not a temp
 		 * rel, because there's no need for smgr to schedule an fsync for this
 		 * write; we'll do it ourselves below.
 		 */
-		smgrextend(dst, forkNum, blkno, buf, true);
+		smgrextendv(dst, forkNum, blkno, pages, nchunk, true);
 	}
 
 	pfree(buf);
@@ -56,6 +56,7 @@
 #include "storage/bufmgr.h"
 #include "storage/freespace.h"
 #include "storage/lmgr.h"
+#include "storage/read_stream.h"
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
 #include "utils/pg_rusage.h"
@@ -131,6 +132,30 @@ typedef struct LVRelStats
 	bool		lock_waiter_detected;
 } LVRelStats;
 
+/*
+ * State of the read stream of lazy_scan_heap, which decides which pages can
+ * be skipped according to the visibility map.
+ */
+typedef struct LVScanState
+{
+	Relation	onerel;
+	LVRelStats *vacrelstats;
+	int			options;
+	bool		aggressive;
+	BlockNumber nblocks;
+	BlockNumber next_block;		/* next page to consider */
+	BlockNumber next_unskippable_block;
+	bool		skipping_blocks;
+	Buffer		vmbuffer;		/* visibility map page to look pages up in */
+} LVScanState;
+
+/* State of the read stream of lazy_vacuum_heap */
+typedef struct LVVacuumState
+{
+	LVRelStats *vacrelstats;
+	int			next_tupindex;	/* first dead tuple of the next page */
+} LVVacuumState;
+
 
 /* A few variables that don't seem worth passing around as parameters */
 static int	elevel = -1;
@@ -146,7 +171,15 @@ static BufferAccessStrategy vac_strategy;
 static void lazy_scan_heap(Relation onerel, int options,
 			   LVRelStats *vacrelstats, Relation *Irel, int nindexes,
 			   bool aggressive);
+static BlockNumber lazy_scan_next_block(ReadStream *stream,
+					 void *callback_private_data,
+					 void *per_buffer_data);
+static BlockNumber lazy_scan_next_unskippable(LVScanState *scanstate,
+						   BlockNumber blkno);
 static void lazy_vacuum_heap(Relation onerel, LVRelStats *vacrelstats);
+static BlockNumber lazy_vacuum_next_block(ReadStream *stream,
+					   void *callback_private_data,
+					   void *per_buffer_data);
 static bool lazy_check_needs_freeze(Buffer buf, bool *hastup);
 static void lazy_vacuum_index(Relation indrel,
 				  IndexBulkDeleteResult **stats,
@@ -443,6 +476,13 @@ vacuum_log_cleanup_info(Relation rel, LVRelStats *vacrelstats)
 		(void) log_heap_cleanup_info(rel->rd_node, vacrelstats->latestRemovedXid);
 }
 
+/*
+ * Must we scan page blkno even if it could be skipped?  See the note in
+ * lazy_scan_heap about forcing scanning of the last page.
+ */
+#define FORCE_CHECK_PAGE() \
+	(blkno == nblocks - 1 && should_attempt_truncation(vacrelstats))
+
 /*
  *	lazy_scan_heap() -- scan an open heap relation
  *
@@ -479,8 +519,8 @@ lazy_scan_heap(Relation onerel, int options, LVRelStats *vacrelstats,
 	int			i;
 	PGRUsage	ru0;
 	Buffer		vmbuffer = InvalidBuffer;
-	BlockNumber next_unskippable_block;
-	bool		skipping_blocks;
+	LVScanState scanstate;
+	ReadStream *stream;
 	xl_heap_freeze_tuple *frozen;
 	StringInfoData buf;
 	const int	initprog_index[] = {
@@ -541,12 +581,13 @@ lazy_scan_heap(Relation onerel, int options, LVRelStats *vacrelstats,
 	 * such pages do not need freezing and do not affect the value that we can
 	 * safely set for relfrozenxid or relminmxid.
 	 *
-	 * Before entering the main loop, establish the invariant that
-	 * next_unskippable_block is the next block number >= blkno that we can't
-	 * skip based on the visibility map, either all-visible for a regular scan
-	 * or all-frozen for an aggressive scan.  We set it to nblocks if there's
-	 * no such block.  We also set up the skipping_blocks flag correctly at
-	 * this stage.
+	 * The pages are read through a read stream, whose callback
+	 * lazy_scan_next_block decides which ones to skip.  Before starting it,
+	 * establish the invariant that next_unskippable_block is the next block
+	 * number >= the next page to consider that we can't skip based on the
+	 * visibility map, either all-visible for a regular scan or all-frozen for
+	 * an aggressive scan.  We set it to nblocks if there's no such block.  We
+	 * also set up the skipping_blocks flag correctly at this stage.
 	 *
 	 * Note: The value returned by visibilitymap_get_status could be slightly
 	 * out-of-date, since we make this test before reading the corresponding
@@ -570,38 +611,33 @@ lazy_scan_heap(Relation onerel, int options, LVRelStats *vacrelstats,
 	 * the last page.  This is worth avoiding mainly because such a lock must
 	 * be replayed on any hot standby, where it can be disruptive.
 	 */
-	next_unskippable_block = 0;
-	if ((options & VACOPT_DISABLE_PAGE_SKIPPING) == 0)
-	{
-		while (next_unskippable_block < nblocks)
-		{
-			uint8		vmstatus;
-
-			vmstatus = visibilitymap_get_status(onerel, next_unskippable_block,
-												&vmbuffer);
-			if (aggressive)
-			{
-				if ((vmstatus & VISIBILITYMAP_ALL_FROZEN) == 0)
-					break;
-			}
-			else
-			{
-				if ((vmstatus & VISIBILITYMAP_ALL_VISIBLE) == 0)
-					break;
-			}
-			vacuum_delay_point();
-			next_unskippable_block++;
-		}
-	}
-
-	if (next_unskippable_block >= SKIP_PAGES_THRESHOLD)
-		skipping_blocks = true;
+	scanstate.onerel = onerel;
+	scanstate.vacrelstats = vacrelstats;
+	scanstate.options = options;
+	scanstate.aggressive = aggressive;
+	scanstate.nblocks = nblocks;
+	scanstate.next_block = 0;
+	scanstate.vmbuffer = InvalidBuffer;
+	scanstate.next_unskippable_block = lazy_scan_next_unskippable(&scanstate,
+																  0);
+
+	if (scanstate.next_unskippable_block >= SKIP_PAGES_THRESHOLD)
+		scanstate.skipping_blocks = true;
 	else
-		skipping_blocks = false;
+		scanstate.skipping_blocks = false;
+
+	/*
+	 * Each page comes with the all_visible_according_to_vm flag the callback
+	 * determined for it.
+	 */
+	stream = read_stream_begin_relation(onerel, MAIN_FORKNUM, vac_strategy,
+										lazy_scan_next_block, &scanstate,
+										sizeof(bool));
 
-	for (blkno = 0; blkno < nblocks; blkno++)
+	for (;;)
 	{
 		Buffer		buf;
+		void	   *per_buffer_data;
 		Page		page;
 		OffsetNumber offnum,
 					maxoff;
@@ -616,85 +652,14 @@ lazy_scan_heap(Relation onerel, int options, LVRelStats *vacrelstats,
 		bool		has_dead_tuples;
 		TransactionId visibility_cutoff_xid = InvalidTransactionId;
 
-		/* see note above about forcing scanning of last page */
-#define FORCE_CHECK_PAGE() \
-		(blkno == nblocks - 1 && should_attempt_truncation(vacrelstats))
+		buf = read_stream_next_buffer(stream, &per_buffer_data);
+		if (!BufferIsValid(buf))
+			break;
+		blkno = BufferGetBlockNumber(buf);
+		all_visible_according_to_vm = *(bool *) per_buffer_data;
 
 		pgstat_progress_update_param(PROGRESS_VACUUM_HEAP_BLKS_SCANNED, blkno);
 
-		if (blkno == next_unskippable_block)
-		{
-			/* Time to advance next_unskippable_block */
-			next_unskippable_block++;
-			if ((options & VACOPT_DISABLE_PAGE_SKIPPING) == 0)
-			{
-				while (next_unskippable_block < nblocks)
-				{
-					uint8		vmskipflags;
-
-					vmskipflags = visibilitymap_get_status(onerel,
-														   next_unskippable_block,
-														   &vmbuffer);
-					if (aggressive)
-					{
-						if ((vmskipflags & VISIBILITYMAP_ALL_FROZEN) == 0)
-							break;
-					}
-					else
-					{
-						if ((vmskipflags & VISIBILITYMAP_ALL_VISIBLE) == 0)
-							break;
-					}
-					vacuum_delay_point();
-					next_unskippable_block++;
-				}
-			}
-
-			/*
-			 * We know we can't skip the current block.  But set up
-			 * skipping_blocks to do the right thing at the following blocks.
-			 */
-			if (next_unskippable_block - blkno > SKIP_PAGES_THRESHOLD)
-				skipping_blocks = true;
-			else
-				skipping_blocks = false;
-
-			/*
-			 * Normally, the fact that we can't skip this block must mean that
-			 * it's not all-visible.  But in an aggressive vacuum we know only
-			 * that it's not all-frozen, so it might still be all-visible.
-			 */
-			if (aggressive && VM_ALL_VISIBLE(onerel, blkno, &vmbuffer))
-				all_visible_according_to_vm = true;
-		}
-		else
-		{
-			/*
-			 * The current block is potentially skippable; if we've seen a
-			 * long enough run of skippable blocks to justify skipping it, and
-			 * we're not forced to check it, then go ahead and skip.
-			 * Otherwise, the page must be at least all-visible if not
-			 * all-frozen, so we can set all_visible_according_to_vm = true.
-			 */
-			if (skipping_blocks && !FORCE_CHECK_PAGE())
-			{
-				/*
-				 * Tricky, tricky.  If this is in aggressive vacuum, the page
-				 * must have been all-frozen at the time we checked whether it
-				 * was skippable, but it might not be any more.  We must be
-				 * careful to count it as a skipped all-frozen page in that
-				 * case, or else we'll think we can't update relfrozenxid and
-				 * relminmxid.  If it's not an aggressive vacuum, we don't
-				 * know whether it was all-frozen, so we have to recheck; but
-				 * in this case an approximate answer is OK.
-				 */
-				if (aggressive || VM_ALL_FROZEN(onerel, blkno, &vmbuffer))
-					vacrelstats->frozenskipped_pages++;
-				continue;
-			}
-			all_visible_according_to_vm = true;
-		}
-
 		vacuum_delay_point();
 
 		/*
@@ -714,13 +679,20 @@ lazy_scan_heap(Relation onerel, int options, LVRelStats *vacrelstats,
 			 * Before beginning index vacuuming, we release any pin we may
 			 * hold on the visibility map page.  This isn't necessary for
 			 * correctness, but we do it anyway to avoid holding the pin
-			 * across a lengthy, unrelated operation.
+			 * across a lengthy, unrelated operation.  The pages the stream
+			 * has read ahead stay pinned; they're all beyond the ones whose
+			 * dead tuples are about to be removed.
 			 */
 			if (BufferIsValid(vmbuffer))
 			{
 				ReleaseBuffer(vmbuffer);
 				vmbuffer = InvalidBuffer;
 			}
+			if (BufferIsValid(scanstate.vmbuffer))
+			{
+				ReleaseBuffer(scanstate.vmbuffer);
+				scanstate.vmbuffer = InvalidBuffer;
+			}
 
 			/* Log cleanup info before we touch indexes */
 			vacuum_log_cleanup_info(onerel, vacrelstats);
@@ -765,16 +737,11 @@ lazy_scan_heap(Relation onerel, int options, LVRelStats *vacrelstats,
 		 * Pin the visibility map page in case we need to mark the page
 		 * all-visible.  In most cases this will be very cheap, because we'll
 		 * already have the correct page pinned anyway.  However, it's
-		 * possible that (a) next_unskippable_block is covered by a different
-		 * VM page than the current block or (b) we released our pin and did a
-		 * cycle of index vacuuming.
-		 *
+		 * possible that (a) this is the first page covered by a different VM
+		 * page or (b) we released our pin and did a cycle of index vacuuming.
 		 */
 		visibilitymap_pin(onerel, blkno, &vmbuffer);
 
-		buf = ReadBufferExtended(onerel, MAIN_FORKNUM, blkno,
-								 RBM_NORMAL, vac_strategy);
-
 		/* We need buffer cleanup lock so that we can prune HOT chains. */
 		if (!ConditionalLockBufferForCleanup(buf))
 		{
@@ -843,41 +810,25 @@ lazy_scan_heap(Relation onerel, int options, LVRelStats *vacrelstats,
 		{
 			/*
 			 * An all-zeroes page could be left over if a backend extends the
-			 * relation but crashes before initializing the page. Reclaim such
-			 * pages for use.
-			 *
-			 * We have to be careful here because we could be looking at a
-			 * page that someone has just added to the relation and not yet
-			 * been able to initialize (see RelationGetBufferForTuple). To
-			 * protect against that, release the buffer lock, grab the
-			 * relation extension lock momentarily, and re-lock the buffer. If
-			 * the page is still uninitialized by then, it must be left over
-			 * from a crashed backend, and we can initialize it.
-			 *
-			 * We don't really need the relation lock when this is a new or
-			 * temp relation, but it's probably not worth the code space to
-			 * check that, since this surely isn't a critical path.
+			 * relation but crashes before initializing the page, and bulk
+			 * insertions extend the relation by many pages that stay
+			 * uninitialized until they're used (see RelationAddBulkBlocks).
+			 * Either way, it's free space; make sure that the FSM knows about
+			 * it, if it doesn't already.
 			 *
-			 * Note: the comparable code in vacuum.c need not worry because
-			 * it's got exclusive lock on the whole relation.
+			 * We don't initialize the page: that would have to be WAL-logged,
+			 * and whoever inserts into it first initializes it anyway.  Not
+			 * touching it also means that we needn't worry about a page that
+			 * someone has just added to the relation and is about to
+			 * initialize.
 			 */
-			LockBuffer(buf, BUFFER_LOCK_UNLOCK);
-			LockRelationForExtension(onerel, ExclusiveLock);
-			UnlockRelationForExtension(onerel, ExclusiveLock);
-			LockBufferForCleanup(buf);
-			if (PageIsNew(page))
-			{
-				ereport(WARNING,
-						(errmsg("relation \"%s\" page %u is uninitialized --- fixing",
-								relname, blkno)));
-				PageInit(page, BufferGetPageSize(buf), 0);
-				empty_pages++;
-			}
-			freespace = PageGetHeapFreeSpace(page);
-			MarkBufferDirty(buf);
+			empty_pages++;
 			UnlockReleaseBuffer(buf);
 
-			RecordPageWithFreeSpace(onerel, blkno, freespace);
+			if (GetRecordedFreeSpace(onerel, blkno) == 0)
+				RecordPageWithFreeSpace(onerel, blkno,
+										BLCKSZ - SizeOfPageHeaderData -
+										sizeof(ItemIdData));
 			continue;
 		}
 
@@ -1275,6 +1226,9 @@ lazy_scan_heap(Relation onerel, int options, LVRelStats *vacrelstats,
 			RecordPageWithFreeSpace(onerel, blkno, freespace);
 	}
 
+	read_stream_end(stream);
+	blkno = nblocks;
+
 	/* report that everything is scanned and vacuumed */
 	pgstat_progress_update_param(PROGRESS_VACUUM_HEAP_BLKS_SCANNED, blkno);
 
@@ -1299,6 +1253,11 @@ lazy_scan_heap(Relation onerel, int options, LVRelStats *vacrelstats,
 		ReleaseBuffer(vmbuffer);
 		vmbuffer = InvalidBuffer;
 	}
+	if (BufferIsValid(scanstate.vmbuffer))
+	{
+		ReleaseBuffer(scanstate.vmbuffer);
+		scanstate.vmbuffer = InvalidBuffer;
+	}
 
 	/* If any tuples need to be deleted, perform final vacuum cycle */
 	/* XXX put a threshold on min number of tuples here? */
@@ -1385,6 +1344,119 @@ lazy_scan_heap(Relation onerel, int options, LVRelStats *vacrelstats,
 }
 
 
+/*
+ * lazy_scan_next_unskippable() -- find the next page we can't skip
+ *
+ * Returns the first block number >= blkno that can't be skipped based on the
+ * visibility map, or nblocks if there's no such block; see lazy_scan_heap.
+ */
+static BlockNumber
+lazy_scan_next_unskippable(LVScanState *scanstate, BlockNumber blkno)
+{
+	if ((scanstate->options & VACOPT_DISABLE_PAGE_SKIPPING) != 0)
+		return blkno;
+
+	while (blkno < scanstate->nblocks)
+	{
+		uint8		vmstatus;
+
+		vmstatus = visibilitymap_get_status(scanstate->onerel, blkno,
+											&scanstate->vmbuffer);
+		if (scanstate->aggressive)
+		{
+			if ((vmstatus & VISIBILITYMAP_ALL_FROZEN) == 0)
+				break;
+		}
+		else
+		{
+			if ((vmstatus & VISIBILITYMAP_ALL_VISIBLE) == 0)
+				break;
+		}
+		vacuum_delay_point();
+		blkno++;
+	}
+
+	return blkno;
+}
+
+/*
+ *	lazy_scan_next_block() -- read stream callback of lazy_scan_heap
+ *
+ *		Returns the next page to scan, skipping pages according to the
+ *		visibility map, and stores whether the page is all-visible according
+ *		to the visibility map into per_buffer_data.
+ */
+static BlockNumber
+lazy_scan_next_block(ReadStream *stream, void *callback_private_data,
+					 void *per_buffer_data)
+{
+	LVScanState *scanstate = (LVScanState *) callback_private_data;
+	Relation	onerel = scanstate->onerel;
+	LVRelStats *vacrelstats = scanstate->vacrelstats;
+	BlockNumber nblocks = scanstate->nblocks;
+	bool	   *all_visible_according_to_vm = (bool *) per_buffer_data;
+
+	while (scanstate->next_block < nblocks)
+	{
+		BlockNumber blkno = scanstate->next_block++;
+
+		if (blkno == scanstate->next_unskippable_block)
+		{
+			/* Time to advance next_unskippable_block */
+			scanstate->next_unskippable_block =
+				lazy_scan_next_unskippable(scanstate, blkno + 1);
+
+			/*
+			 * We know we can't skip the current block.  But set up
+			 * skipping_blocks to do the right thing at the following blocks.
+			 */
+			if (scanstate->next_unskippable_block - blkno > SKIP_PAGES_THRESHOLD)
+				scanstate->skipping_blocks = true;
+			else
+				scanstate->skipping_blocks = false;
+
+			/*
+			 * Normally, the fact that we can't skip this block must mean that
+			 * it's not all-visible.  But in an aggressive vacuum we know only
+			 * that it's not all-frozen, so it might still be all-visible.
+			 */
+			*all_visible_according_to_vm =
+				(scanstate->aggressive &&
+				 VM_ALL_VISIBLE(onerel, blkno, &scanstate->vmbuffer));
+			return blkno;
+		}
+
+		/*
+		 * The current block is potentially skippable; if we've seen a long
+		 * enough run of skippable blocks to justify skipping it, and we're
+		 * not forced to check it, then go ahead and skip.  Otherwise, the
+		 * page must be at least all-visible if not all-frozen, so we can set
+		 * all_visible_according_to_vm = true.
+		 */
+		if (scanstate->skipping_blocks && !FORCE_CHECK_PAGE())
+		{
+			/*
+			 * Tricky, tricky.  If this is in aggressive vacuum, the page must
+			 * have been all-frozen at the time we checked whether it was
+			 * skippable, but it might not be any more.  We must be careful to
+			 * count it as a skipped all-frozen page in that case, or else
+			 * we'll think we can't update relfrozenxid and relminmxid.  If
+			 * it's not an aggressive vacuum, we don't know whether it was
+			 * all-frozen, so we have to recheck; but in this case an
+			 * approximate answer is OK.
+			 */
+			if (scanstate->aggressive ||
+				VM_ALL_FROZEN(onerel, blkno, &scanstate->vmbuffer))
+				vacrelstats->frozenskipped_pages++;
+			continue;
+		}
+		*all_visible_according_to_vm = true;
+		return blkno;
+	}
+
+	return InvalidBlockNumber;
+}
+
 /*
  *	lazy_vacuum_heap() -- second pass over the heap
  *
@@ -1403,12 +1475,20 @@ lazy_vacuum_heap(Relation onerel, LVRelStats *vacrelstats)
 	int			npages;
 	PGRUsage	ru0;
 	Buffer		vmbuffer = InvalidBuffer;
+	LVVacuumState vacstate;
+	ReadStream *stream;
 
 	pg_rusage_init(&ru0);
 	npages = 0;
 
+	/* Read the pages with dead tuples ahead of time */
+	vacstate.vacrelstats = vacrelstats;
+	vacstate.next_tupindex = 0;
+	stream = read_stream_begin_relation(onerel, MAIN_FORKNUM, vac_strategy,
+										lazy_vacuum_next_block, &vacstate, 0);
+
 	tupindex = 0;
-	while (tupindex < vacrelstats->num_dead_tuples)
+	for (;;)
 	{
 		BlockNumber tblk;
 		Buffer		buf;
@@ -1417,13 +1497,19 @@ lazy_vacuum_heap(Relation onerel, LVRelStats *vacrelstats)
 
 		vacuum_delay_point();
 
-		tblk = ItemPointerGetBlockNumber(&vacrelstats->dead_tuples[tupindex]);
-		buf = ReadBufferExtended(onerel, MAIN_FORKNUM, tblk, RBM_NORMAL,
-								 vac_strategy);
+		buf = read_stream_next_buffer(stream, NULL);
+		if (!BufferIsValid(buf))
+			break;
+		tblk = BufferGetBlockNumber(buf);
+		Assert(tblk == ItemPointerGetBlockNumber(&vacrelstats->dead_tuples[tupindex]));
+
 		if (!ConditionalLockBufferForCleanup(buf))
 		{
+			/* Leave the page's dead tuples for some future vacuum */
 			ReleaseBuffer(buf);
-			++tupindex;
+			while (tupindex < vacrelstats->num_dead_tuples &&
+				   ItemPointerGetBlockNumber(&vacrelstats->dead_tuples[tupindex]) == tblk)
+				++tupindex;
 			continue;
 		}
 		tupindex = lazy_vacuum_page(onerel, tblk, buf, tupindex, vacrelstats,
@@ -1437,6 +1523,7 @@ lazy_vacuum_heap(Relation onerel, LVRelStats *vacrelstats)
 		RecordPageWithFreeSpace(onerel, tblk, freespace);
 		npages++;
 	}
+	read_stream_end(stream);
 
 	if (BufferIsValid(vmbuffer))
 	{
@@ -1451,6 +1538,30 @@ lazy_vacuum_heap(Relation onerel, LVRelStats *vacrelstats)
 			 errdetail_internal("%s", pg_rusage_show(&ru0))));
 }
 
+/*
+ *	lazy_vacuum_next_block() -- read stream callback of lazy_vacuum_heap
+ *
+ *		Returns the next page that has dead tuples recorded.
+ */
+static BlockNumber
+lazy_vacuum_next_block(ReadStream *stream, void *callback_private_data,
+					   void *per_buffer_data)
+{
+	LVVacuumState *vacstate = (LVVacuumState *) callback_private_data;
+	LVRelStats *vacrelstats = vacstate->vacrelstats;
+	BlockNumber tblk;
+
+	if (vacstate->next_tupindex >= vacrelstats->num_dead_tuples)
+		return InvalidBlockNumber;
+
+	tblk = ItemPointerGetBlockNumber(&vacrelstats->dead_tuples[vacstate->next_tupindex]);
+	while (vacstate->next_tupindex < vacrelstats->num_dead_tuples &&
+		   ItemPointerGetBlockNumber(&vacrelstats->dead_tuples[vacstate->next_tupindex]) == tblk)
+		vacstate->next_tupindex++;
+
+	return tblk;
+}
+
 /*
  *	lazy_vacuum_page() -- free dead tuples on a page
  *					 and repair its fragmentation.
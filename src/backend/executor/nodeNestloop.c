@@ -17,16 +17,73 @@
  *		ExecNestLoop	 - process a nestloop join of two plans
  *		ExecInitNestLoop - initialize the join
  *		ExecEndNestLoop  - shut down the join
+ *
+ *	 NOTES
+ *		A nestloop is usually chosen because the planner expects the outer
+ *		input to be small.  If that estimate is badly off and the inner input
+ *		doesn't depend on the outer tuple, rescanning the inner input for each
+ *		outer tuple can take forever.  So if the number of outer tuples
+ *		exceeds the estimate by a factor of adaptive_nestloop_threshold, and
+ *		the planner gave us hashjoinable join clauses, we read the inner input
+ *		once more into an in-memory hash table, and from then on fetch the
+ *		inner tuples matching each outer tuple from there.  The inner tuples
+ *		of each hash key are kept in their original order, so the join still
+ *		returns the same rows in the same order.  If the inner input doesn't
+ *		fit in work_mem, we just keep rescanning it.
  */
 
 #include "postgres.h"
 
+#include "access/htup_details.h"
 #include "executor/execdebug.h"
+#include "executor/executor.h"
 #include "executor/nodeNestloop.h"
 #include "miscadmin.h"
+#include "nodes/makefuncs.h"
+#include "utils/lsyscache.h"
 #include "utils/memutils.h"
 
 
+/* GUC parameter */
+double		adaptive_nestloop_threshold = 0.0;
+
+/*
+ * State for hashing the inner input.  Everything but the hash table itself
+ * is set up once, when the node is initialized; the hash table is built
+ * when switching to hashing, and reset when the inner input changes.
+ */
+typedef struct NestLoopHashTableData
+{
+	TupleHashTable hashtable;	/* inner tuples, as Lists of MinimalTuples,
+								 * or NULL if not switched */
+	MemoryContext tablecxt;		/* memory context holding the hash table */
+	MemoryContext tempcxt;		/* short-term context for hash lookups */
+	int			numkeys;		/* number of hash keys */
+	AttrNumber *keyColIdx;		/* column numbers 1..numkeys */
+	FmgrInfo   *tab_eq_funcs;	/* equality functions for inner keys */
+	FmgrInfo   *tab_hash_funcs; /* hash functions for inner keys */
+	FmgrInfo   *cur_eq_funcs;	/* equality functions for outer vs inner */
+	FmgrInfo   *outer_hash_funcs;	/* hash functions for outer keys */
+	ProjectionInfo *projOuter;	/* computes outer keys */
+	ProjectionInfo *projInner;	/* computes inner keys */
+	TupleTableSlot *innerslot;	/* holds inner tuples fetched from table */
+	ListCell   *nextmatch;		/* next match for current outer tuple */
+	Size		space;			/* approximate memory used by the table */
+} NestLoopHashTableData;
+
+static NestLoopHashTable ExecNestLoopInitHash(NestLoopState *node);
+static bool ExecNestLoopBuildHash(NestLoopState *node);
+static void ExecNestLoopResetHash(NestLoopState *node);
+static void ExecNestLoopProbeHash(NestLoopState *node,
+					  TupleTableSlot *outerTupleSlot);
+static TupleTableSlot *ExecNestLoopNextMatch(NestLoopState *node);
+static bool slot_has_nulls(TupleTableSlot *slot);
+
+/* has the node switched to hashing its inner input? */
+#define NestLoopIsHashing(node) \
+	((node)->nl_HashTable != NULL && (node)->nl_HashTable->hashtable != NULL)
+
+
 /* ----------------------------------------------------------------
  *		ExecNestLoop(node)
  *
@@ -146,10 +203,37 @@ ExecNestLoop(PlanState *pstate)
 			}
 
 			/*
-			 * now rescan the inner plan
+			 * If we've seen many more outer tuples than the planner expected,
+			 * try to switch to hashing the inner input.
 			 */
-			ENL1_printf("rescanning inner plan");
-			ExecReScan(innerPlan);
+			node->nl_OuterTuples += 1;
+			if (!NestLoopIsHashing(node) && node->nl_SwitchLimit > 0 &&
+				node->nl_OuterTuples > node->nl_SwitchLimit)
+			{
+				ENL1_printf("switching to hashing inner plan");
+				if (ExecNestLoopBuildHash(node))
+				{
+					if (node->nl_Switches == 0)
+						node->nl_SwitchedAfter = node->nl_OuterTuples - 1;
+					node->nl_Switches += 1;
+				}
+				else
+					node->nl_SwitchLimit = 0;	/* don't try again */
+			}
+
+			if (NestLoopIsHashing(node))
+			{
+				/* look up the inner tuples matching the outer tuple */
+				ExecNestLoopProbeHash(node, outerTupleSlot);
+			}
+			else
+			{
+				/*
+				 * now rescan the inner plan
+				 */
+				ENL1_printf("rescanning inner plan");
+				ExecReScan(innerPlan);
+			}
 		}
 
 		/*
@@ -157,7 +241,10 @@ ExecNestLoop(PlanState *pstate)
 		 */
 		ENL1_printf("getting new inner tuple");
 
-		innerTupleSlot = ExecProcNode(innerPlan);
+		if (NestLoopIsHashing(node))
+			innerTupleSlot = ExecNestLoopNextMatch(node);
+		else
+			innerTupleSlot = ExecProcNode(innerPlan);
 		econtext->ecxt_innertuple = innerTupleSlot;
 
 		if (TupIsNull(innerTupleSlot))
@@ -344,6 +431,26 @@ ExecInitNestLoop(NestLoop *node, EState *estate, int eflags)
 	ExecAssignResultTypeFromTL(&nlstate->js.ps);
 	ExecAssignProjectionInfo(&nlstate->js.ps, NULL);
 
+	/*
+	 * Decide after how many outer tuples to switch to hashing the inner
+	 * input, if we can do that at all, and prepare for it.  The hash table
+	 * itself is only built when needed.
+	 */
+	nlstate->nl_OuterTuples = 0;
+	nlstate->nl_Switches = 0;
+	nlstate->nl_SwitchedAfter = -1;
+	if (node->hashclauses != NIL && adaptive_nestloop_threshold > 0)
+	{
+		nlstate->nl_SwitchLimit = adaptive_nestloop_threshold *
+			Max(outerPlan(node)->plan_rows, 1.0);
+		nlstate->nl_HashTable = ExecNestLoopInitHash(nlstate);
+	}
+	else
+	{
+		nlstate->nl_SwitchLimit = 0;
+		nlstate->nl_HashTable = NULL;
+	}
+
 	/*
 	 * finally, wipe the current outer tuple clean.
 	 */
@@ -378,6 +485,17 @@ ExecEndNestLoop(NestLoopState *node)
 	 */
 	ExecClearTuple(node->js.ps.ps_ResultTupleSlot);
 
+	/*
+	 * free the hash table of the inner input, if any
+	 */
+	if (node->nl_HashTable != NULL)
+	{
+		ExecClearTuple(node->nl_HashTable->innerslot);
+		MemoryContextDelete(node->nl_HashTable->tablecxt);
+		MemoryContextDelete(node->nl_HashTable->tempcxt);
+		node->nl_HashTable->hashtable = NULL;
+	}
+
 	/*
 	 * close down subplans
 	 */
@@ -410,6 +528,260 @@ ExecReScanNestLoop(NestLoopState *node)
 	 * outer Vars are used as run-time keys...
 	 */
 
+	/*
+	 * If we switched to hashing the inner input, the hash table stays valid
+	 * unless the inner plan's parameters changed.
+	 */
+	if (NestLoopIsHashing(node) &&
+		innerPlanState(node)->chgParam != NULL)
+		ExecNestLoopResetHash(node);
+	node->nl_OuterTuples = 0;
+
 	node->nl_NeedNewOuter = true;
 	node->nl_MatchedOuter = false;
 }
+
+/*
+ * ExecNestLoopInitHash
+ *		Set up what's needed to hash the inner input, short of the hash
+ *		table itself.
+ *
+ * The equality and hash functions are set up much as for a hashed SubPlan,
+ * along with projections computing the outer and inner keys.
+ */
+static NestLoopHashTable
+ExecNestLoopInitHash(NestLoopState *node)
+{
+	NestLoop   *nl = (NestLoop *) node->js.ps.plan;
+	EState	   *estate = node->js.ps.state;
+	ExprContext *econtext = node->js.ps.ps_ExprContext;
+	NestLoopHashTable hashtable;
+	List	   *outertlist = NIL;
+	List	   *innertlist = NIL;
+	TupleTableSlot *slot;
+	ListCell   *lc;
+	int			i;
+
+	hashtable = (NestLoopHashTable) palloc0(sizeof(NestLoopHashTableData));
+	hashtable->tablecxt = AllocSetContextCreate(CurrentMemoryContext,
+												"NestLoop HashTable Context",
+												ALLOCSET_DEFAULT_SIZES);
+	hashtable->tempcxt = AllocSetContextCreate(CurrentMemoryContext,
+											   "NestLoop HashTable Temp Context",
+											   ALLOCSET_SMALL_SIZES);
+
+	hashtable->numkeys = list_length(nl->hashclauses);
+	hashtable->keyColIdx = (AttrNumber *)
+		palloc(hashtable->numkeys * sizeof(AttrNumber));
+	hashtable->tab_eq_funcs = (FmgrInfo *)
+		palloc(hashtable->numkeys * sizeof(FmgrInfo));
+	hashtable->tab_hash_funcs = (FmgrInfo *)
+		palloc(hashtable->numkeys * sizeof(FmgrInfo));
+	hashtable->cur_eq_funcs = (FmgrInfo *)
+		palloc(hashtable->numkeys * sizeof(FmgrInfo));
+	hashtable->outer_hash_funcs = (FmgrInfo *)
+		palloc(hashtable->numkeys * sizeof(FmgrInfo));
+	i = 0;
+	foreach(lc, nl->hashclauses)
+	{
+		OpExpr	   *opexpr = lfirst_node(OpExpr, lc);
+		Oid			rhs_eq_oper;
+		Oid			left_hashfn;
+		Oid			right_hashfn;
+
+		Assert(list_length(opexpr->args) == 2);
+		hashtable->keyColIdx[i] = i + 1;
+		outertlist = lappend(outertlist,
+							 makeTargetEntry(linitial(opexpr->args), i + 1,
+											 NULL, false));
+		innertlist = lappend(innertlist,
+							 makeTargetEntry(lsecond(opexpr->args), i + 1,
+											 NULL, false));
+
+		fmgr_info(get_opcode(opexpr->opno), &hashtable->cur_eq_funcs[i]);
+		fmgr_info_set_expr((Node *) opexpr, &hashtable->cur_eq_funcs[i]);
+		if (!get_compatible_hash_operators(opexpr->opno, NULL, &rhs_eq_oper))
+			elog(ERROR, "could not find compatible hash operator for operator %u",
+				 opexpr->opno);
+		fmgr_info(get_opcode(rhs_eq_oper), &hashtable->tab_eq_funcs[i]);
+		if (!get_op_hash_functions(opexpr->opno, &left_hashfn, &right_hashfn))
+			elog(ERROR, "could not find hash function for hash operator %u",
+				 opexpr->opno);
+		fmgr_info(left_hashfn, &hashtable->outer_hash_funcs[i]);
+		fmgr_info(right_hashfn, &hashtable->tab_hash_funcs[i]);
+		i++;
+	}
+
+	slot = ExecInitExtraTupleSlot(estate);
+	ExecSetSlotDescriptor(slot, ExecTypeFromTL(outertlist, false));
+	hashtable->projOuter = ExecBuildProjectionInfo(outertlist, econtext, slot,
+												   &node->js.ps, NULL);
+	slot = ExecInitExtraTupleSlot(estate);
+	ExecSetSlotDescriptor(slot, ExecTypeFromTL(innertlist, false));
+	hashtable->projInner = ExecBuildProjectionInfo(innertlist, econtext, slot,
+												   &node->js.ps, NULL);
+	hashtable->innerslot = ExecInitExtraTupleSlot(estate);
+	ExecSetSlotDescriptor(hashtable->innerslot,
+						  ExecGetResultType(innerPlanState(node)));
+
+	return hashtable;
+}
+
+/*
+ * ExecNestLoopResetHash
+ *		Throw away the hash table of the inner input.
+ */
+static void
+ExecNestLoopResetHash(NestLoopState *node)
+{
+	NestLoopHashTable hashtable = node->nl_HashTable;
+
+	ExecClearTuple(hashtable->innerslot);
+	MemoryContextReset(hashtable->tablecxt);
+	MemoryContextReset(hashtable->tempcxt);
+	hashtable->hashtable = NULL;
+	hashtable->nextmatch = NULL;
+	hashtable->space = 0;
+}
+
+/*
+ * ExecNestLoopBuildHash
+ *		Read the whole inner input into a hash table.
+ *
+ * Returns false, leaving the hash table unset, if the inner input doesn't
+ * fit in work_mem.  The caller has to rescan the inner input anyway.
+ */
+static bool
+ExecNestLoopBuildHash(NestLoopState *node)
+{
+	NestLoopHashTable hashtable = node->nl_HashTable;
+	PlanState  *innerPlan = innerPlanState(node);
+	ExprContext *econtext = node->js.ps.ps_ExprContext;
+	TupleTableSlot *outerTupleSlot = econtext->ecxt_outertuple;
+	MemoryContext oldcxt;
+	long		nbuckets;
+
+	Assert(hashtable != NULL && hashtable->hashtable == NULL);
+
+	nbuckets = (long) Min(innerPlan->plan->plan_rows, (double) (work_mem * 1024L / 64));
+	if (nbuckets < 1)
+		nbuckets = 1;
+	oldcxt = MemoryContextSwitchTo(hashtable->tablecxt);
+	hashtable->hashtable = BuildTupleHashTable(hashtable->numkeys,
+											   hashtable->keyColIdx,
+											   hashtable->tab_eq_funcs,
+											   hashtable->tab_hash_funcs,
+											   nbuckets,
+											   0,
+											   hashtable->tablecxt,
+											   hashtable->tempcxt,
+											   false);
+	MemoryContextSwitchTo(oldcxt);
+
+	/*
+	 * Read the inner input from the start, and store each tuple under its
+	 * hash key.  Tuples with a null key can't match anything, since
+	 * hashjoinable operators are strict.
+	 */
+	ExecReScan(innerPlan);
+	for (;;)
+	{
+		TupleTableSlot *innerTupleSlot = ExecProcNode(innerPlan);
+		TupleTableSlot *keyslot;
+		TupleHashEntry entry;
+		MinimalTuple tuple;
+		bool		isnew;
+
+		if (TupIsNull(innerTupleSlot))
+			break;
+
+		ResetExprContext(econtext);
+		econtext->ecxt_innertuple = innerTupleSlot;
+		keyslot = ExecProject(hashtable->projInner);
+		if (slot_has_nulls(keyslot))
+			continue;
+
+		entry = LookupTupleHashEntry(hashtable->hashtable, keyslot, &isnew);
+		if (isnew)
+			hashtable->space += sizeof(TupleHashEntryData) +
+				entry->firstTuple->t_len;
+
+		oldcxt = MemoryContextSwitchTo(hashtable->tablecxt);
+		tuple = ExecCopySlotMinimalTuple(innerTupleSlot);
+		entry->additional = lappend((List *) entry->additional, tuple);
+		MemoryContextSwitchTo(oldcxt);
+		hashtable->space += tuple->t_len + sizeof(ListCell);
+
+		if (hashtable->space > work_mem * 1024L)
+		{
+			/* Too big, give up */
+			ExecNestLoopResetHash(node);
+			ResetExprContext(econtext);
+			econtext->ecxt_outertuple = outerTupleSlot;
+			return false;
+		}
+	}
+
+	ResetExprContext(econtext);
+	econtext->ecxt_outertuple = outerTupleSlot;
+
+	return true;
+}
+
+/*
+ * ExecNestLoopProbeHash
+ *		Find the inner tuples matching the given outer tuple.
+ */
+static void
+ExecNestLoopProbeHash(NestLoopState *node, TupleTableSlot *outerTupleSlot)
+{
+	NestLoopHashTable hashtable = node->nl_HashTable;
+	ExprContext *econtext = node->js.ps.ps_ExprContext;
+	TupleTableSlot *keyslot;
+	TupleHashEntry entry = NULL;
+
+	econtext->ecxt_outertuple = outerTupleSlot;
+	keyslot = ExecProject(hashtable->projOuter);
+	if (!slot_has_nulls(keyslot))
+		entry = FindTupleHashEntry(hashtable->hashtable, keyslot,
+								   hashtable->cur_eq_funcs,
+								   hashtable->outer_hash_funcs);
+	hashtable->nextmatch = entry ? list_head((List *) entry->additional) : NULL;
+}
+
+/*
+ * ExecNestLoopNextMatch
+ *		Return the next inner tuple matching the current outer tuple, or NULL
+ *		if there are no more.
+ */
+static TupleTableSlot *
+ExecNestLoopNextMatch(NestLoopState *node)
+{
+	NestLoopHashTable hashtable = node->nl_HashTable;
+	MinimalTuple tuple;
+
+	if (hashtable->nextmatch == NULL)
+		return NULL;
+
+	tuple = (MinimalTuple) lfirst(hashtable->nextmatch);
+	hashtable->nextmatch = lnext(hashtable->nextmatch);
+
+	return ExecStoreMinimalTuple(tuple, hashtable->innerslot, false);
+}
+
+/*
+ * slot_has_nulls: is any of the slot's columns NULL?
+ */
+static bool
+slot_has_nulls(TupleTableSlot *slot)
+{
+	int			ncols = slot->tts_tupleDescriptor->natts;
+	int			i;
+
+	for (i = 1; i <= ncols; i++)
+	{
+		if (slot_attisnull(slot, i))
+			return true;
+	}
+	return false;
+}
@@ -1725,7 +1725,7 @@ SPI_plan_get_cached_plan(SPIPlanPtr plan)
 	/* Get the generic plan for the query */
 	cplan = GetCachedPlan(plansource, NULL, plan->saved,
 						  _SPI_current->queryEnv);
-	Assert(cplan == plansource->gplan);
+	Assert(cplan == plansource->buckets[0].gplan);
 
 	/* Pop the error context stack */
 	error_context_stack = spierrcontext.previous;
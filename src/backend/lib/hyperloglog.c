@@ -178,6 +178,24 @@ addHyperLogLog(hyperLogLogState *cState, uint32 hash)
 	cState->hashesArr[index] = Max(count, cState->hashesArr[index]);
 }
 
+/*
+ * Merges the state of another estimator into this one.
+ *
+ * Afterwards, cState estimates the cardinality of the union of the two
+ * multisets.  Both must have been initialized with the same bit width.
+ */
+void
+mergeHyperLogLog(hyperLogLogState *cState, const hyperLogLogState *oState)
+{
+	Size		i;
+
+	if (cState->registerWidth != oState->registerWidth)
+		elog(ERROR, "cannot merge HyperLogLog states with different bit widths");
+
+	for (i = 0; i < cState->nRegisters; i++)
+		cState->hashesArr[i] = Max(cState->hashesArr[i], oState->hashesArr[i]);
+}
+
 /*
  * Estimates cardinality, based on elements added so far
  */
@@ -480,6 +480,55 @@ bms_is_member(int x, const Bitmapset *a)
 	return false;
 }
 
+/*
+ * bms_member_index
+ *		determine 0-based index of member x in the bitmap
+ *
+ * Returns (-1) when x is not a member.
+ */
+int
+bms_member_index(Bitmapset *a, int x)
+{
+	int			i;
+	int			bitnum;
+	int			wordnum;
+	int			result = 0;
+	bitmapword	w;
+
+	/* return -1 if not a member of the bitmap */
+	if (!bms_is_member(x, a))
+		return -1;
+
+	wordnum = WORDNUM(x);
+	bitnum = BITNUM(x);
+
+	/* count bits in preceding words */
+	for (i = 0; i < wordnum; i++)
+	{
+		w = a->words[i];
+
+		/* we assume here that bitmapword is an unsigned type */
+		while (w != 0)
+		{
+			result += number_of_ones[w & 255];
+			w >>= 8;
+		}
+	}
+
+	/*
+	 * Now add bits of the last word, but only those before the item.  We do
+	 * that by masking out the item itself and all the bits after it.
+	 */
+	w = a->words[wordnum] & (((bitmapword) 1 << bitnum) - 1);
+	while (w != 0)
+	{
+		result += number_of_ones[w & 255];
+		w >>= 8;
+	}
+
+	return result;
+}
+
 /*
  * bms_overlap - do sets overlap (ie, have a nonempty intersection)?
  */
@@ -97,6 +97,7 @@ _copyPlannedStmt(const PlannedStmt *from)
 	COPY_NODE_FIELD(rowMarks);
 	COPY_NODE_FIELD(relationOids);
 	COPY_NODE_FIELD(invalItems);
+	COPY_NODE_FIELD(fkeyJoinRelOids);
 	COPY_NODE_FIELD(paramExecTypes);
 	COPY_NODE_FIELD(utilityStmt);
 	COPY_LOCATION_FIELD(stmt_location);
@@ -845,6 +846,7 @@ _copyNestLoop(const NestLoop *from)
 	 * copy remainder of node
 	 */
 	COPY_NODE_FIELD(nestParams);
+	COPY_NODE_FIELD(hashclauses);
 
 	return newnode;
 }
@@ -4683,6 +4685,8 @@ _copyForeignKeyCacheInfo(const ForeignKeyCacheInfo *from)
 
 	COPY_SCALAR_FIELD(conrelid);
 	COPY_SCALAR_FIELD(confrelid);
+	COPY_SCALAR_FIELD(convalidated);
+	COPY_SCALAR_FIELD(condeferrable);
 	COPY_SCALAR_FIELD(nkeys);
 	/* COPY_SCALAR_FIELD might work for these, but let's not assume that */
 	memcpy(newnode->conkey, from->conkey, sizeof(newnode->conkey));
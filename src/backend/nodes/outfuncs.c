@@ -282,6 +282,7 @@ _outPlannedStmt(StringInfo str, const PlannedStmt *node)
 	WRITE_NODE_FIELD(rowMarks);
 	WRITE_NODE_FIELD(relationOids);
 	WRITE_NODE_FIELD(invalItems);
+	WRITE_NODE_FIELD(fkeyJoinRelOids);
 	WRITE_NODE_FIELD(paramExecTypes);
 	WRITE_NODE_FIELD(utilityStmt);
 	WRITE_LOCATION_FIELD(stmt_location);
@@ -736,6 +737,7 @@ _outNestLoop(StringInfo str, const NestLoop *node)
 	_outJoinPlanInfo(str, (const Join *) node);
 
 	WRITE_NODE_FIELD(nestParams);
+	WRITE_NODE_FIELD(hashclauses);
 }
 
 static void
@@ -2188,6 +2190,7 @@ _outPlannerGlobal(StringInfo str, const PlannerGlobal *node)
 	WRITE_NODE_FIELD(rootResultRelations);
 	WRITE_NODE_FIELD(relationOids);
 	WRITE_NODE_FIELD(invalItems);
+	WRITE_NODE_FIELD(fkeyJoinRelOids);
 	WRITE_NODE_FIELD(paramExecTypes);
 	WRITE_UINT_FIELD(lastPHId);
 	WRITE_UINT_FIELD(lastRowMarkId);
@@ -3547,6 +3550,8 @@ _outForeignKeyCacheInfo(StringInfo str, const ForeignKeyCacheInfo *node)
 
 	WRITE_OID_FIELD(conrelid);
 	WRITE_OID_FIELD(confrelid);
+	WRITE_BOOL_FIELD(convalidated);
+	WRITE_BOOL_FIELD(condeferrable);
 	WRITE_INT_FIELD(nkeys);
 	appendStringInfoString(str, " :conkey");
 	for (i = 0; i < node->nkeys; i++)
@@ -128,6 +128,8 @@ bool		enable_mergejoin = true;
 bool		enable_hashjoin = true;
 bool		enable_gathermerge = true;
 bool		enable_partition_wise_join = false;
+bool		enable_partition_wise_agg = false;
+bool		enable_eager_aggregate = false;
 bool		enable_parallel_append = true;
 bool		enable_parallel_hash = true;
 
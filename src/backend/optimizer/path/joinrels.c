@@ -1290,7 +1290,8 @@ restriction_is_constant_false(List *restrictlist, bool only_pushed_down)
  *
  * Partition-wise join is possible when a. Joining relations have same
  * partitioning scheme b. There exists an equi-join between the partition keys
- * of the two relations.
+ * of the two relations c. Each partition of either relation can join to at
+ * most one partition of the other; see partition_bounds_merge().
  *
  * Partition-wise join is planned as follows (details: optimizer/README.)
  *
@@ -1308,8 +1309,11 @@ try_partition_wise_join(PlannerInfo *root, RelOptInfo *rel1, RelOptInfo *rel2,
 						RelOptInfo *joinrel, SpecialJoinInfo *parent_sjinfo,
 						List *parent_restrictlist)
 {
+	PartitionScheme part_scheme = joinrel->part_scheme;
 	int			nparts;
 	int			cnt_parts;
+	int		   *parts1;
+	int		   *parts2;
 
 	/* Guard against stack overflow due to overly deep partition hierarchy. */
 	check_stack_depth();
@@ -1331,10 +1335,13 @@ try_partition_wise_join(PlannerInfo *root, RelOptInfo *rel1, RelOptInfo *rel2,
 
 	/*
 	 * Since this join relation is partitioned, all the base relations
-	 * participating in this join must be partitioned and so are all the
-	 * intermediate join relations.
+	 * participating in this join must be partitioned.  The intermediate join
+	 * relations usually are too, but when the partition bounds differ, some
+	 * orders of joining the partitions might match them up while others
+	 * can't.
 	 */
-	Assert(IS_PARTITIONED_REL(rel1) && IS_PARTITIONED_REL(rel2));
+	if (!IS_PARTITIONED_REL(rel1) || !IS_PARTITIONED_REL(rel2))
+		return;
 	Assert(REL_HAS_ALL_PART_PROPS(rel1) && REL_HAS_ALL_PART_PROPS(rel2));
 
 	/*
@@ -1345,20 +1352,46 @@ try_partition_wise_join(PlannerInfo *root, RelOptInfo *rel1, RelOptInfo *rel2,
 		   joinrel->part_scheme == rel2->part_scheme);
 
 	/*
-	 * Since we allow partition-wise join only when the partition bounds of
-	 * the joining relations exactly match, the partition bounds of the join
-	 * should match those of the joining relations.
+	 * Find out which partitions of the joining relations make up each
+	 * partition of the join.  If the partition bounds of all three are the
+	 * same, the partitions simply match by position.  Otherwise, match them
+	 * up the same way build_joinrel_partition_info() did; the join relation
+	 * may have been built from another pair of joining relations, though, in
+	 * which case this pair's partitions might not match those of the join.
 	 */
-	Assert(partition_bounds_equal(joinrel->part_scheme->partnatts,
-								  joinrel->part_scheme->parttyplen,
-								  joinrel->part_scheme->parttypbyval,
-								  joinrel->boundinfo, rel1->boundinfo));
-	Assert(partition_bounds_equal(joinrel->part_scheme->partnatts,
-								  joinrel->part_scheme->parttyplen,
-								  joinrel->part_scheme->parttypbyval,
-								  joinrel->boundinfo, rel2->boundinfo));
-
 	nparts = joinrel->nparts;
+	if (rel1->nparts == nparts && rel2->nparts == nparts &&
+		partition_bounds_equal(part_scheme->partnatts,
+							   part_scheme->parttyplen,
+							   part_scheme->parttypbyval,
+							   joinrel->boundinfo, rel1->boundinfo) &&
+		partition_bounds_equal(part_scheme->partnatts,
+							   part_scheme->parttyplen,
+							   part_scheme->parttypbyval,
+							   joinrel->boundinfo, rel2->boundinfo))
+	{
+		parts1 = parts2 = NULL;
+	}
+	else
+	{
+		PartitionBoundInfo boundinfo;
+		int			merged_nparts;
+
+		boundinfo = partition_bounds_merge(part_scheme->partnatts,
+										   part_scheme->partsupfunc,
+										   part_scheme->partcollation,
+										   rel1->boundinfo, rel1->nparts,
+										   rel2->boundinfo, rel2->nparts,
+										   parent_sjinfo->jointype,
+										   &parts1, &parts2,
+										   &merged_nparts);
+		if (boundinfo == NULL || merged_nparts != nparts ||
+			!partition_bounds_equal(part_scheme->partnatts,
+									part_scheme->parttyplen,
+									part_scheme->parttypbyval,
+									joinrel->boundinfo, boundinfo))
+			return;
+	}
 
 	/* Allocate space to hold child-joins RelOptInfos, if not already done. */
 	if (!joinrel->part_rels)
@@ -1372,8 +1405,8 @@ try_partition_wise_join(PlannerInfo *root, RelOptInfo *rel1, RelOptInfo *rel2,
 	 */
 	for (cnt_parts = 0; cnt_parts < nparts; cnt_parts++)
 	{
-		RelOptInfo *child_rel1 = rel1->part_rels[cnt_parts];
-		RelOptInfo *child_rel2 = rel2->part_rels[cnt_parts];
+		RelOptInfo *child_rel1;
+		RelOptInfo *child_rel2;
 		SpecialJoinInfo *child_sjinfo;
 		List	   *child_restrictlist;
 		RelOptInfo *child_joinrel;
@@ -1381,6 +1414,9 @@ try_partition_wise_join(PlannerInfo *root, RelOptInfo *rel1, RelOptInfo *rel2,
 		AppendRelInfo **appinfos;
 		int			nappinfos;
 
+		child_rel1 = rel1->part_rels[parts1 ? parts1[cnt_parts] : cnt_parts];
+		child_rel2 = rel2->part_rels[parts2 ? parts2[cnt_parts] : cnt_parts];
+
 		/* We should never try to join two overlapping sets of rels. */
 		Assert(!bms_overlap(child_rel1->relids, child_rel2->relids));
 		child_joinrelids = bms_union(child_rel1->relids, child_rel2->relids);
@@ -10,6 +10,8 @@
  * and simplification steps based on the information extracted.  The penalty
  * is that we have to work harder to clean up after ourselves when we modify
  * the query, since the derived data structures have to be updated too.
+ * remove_redundant_inner_joins is the exception: it works on the Query
+ * tree before initsplan.c has seen it, so nothing derived exists yet.
  *
  * Portions Copyright (c) 1996-2018, PostgreSQL Global Development Group
  * Portions Copyright (c) 1994, Regents of the University of California
@@ -22,6 +24,13 @@
  */
 #include "postgres.h"
 
+#include "access/genam.h"
+#include "access/heapam.h"
+#include "access/stratnum.h"
+#include "catalog/pg_am.h"
+#include "catalog/pg_class.h"
+#include "commands/trigger.h"
+#include "nodes/makefuncs.h"
 #include "nodes/nodeFuncs.h"
 #include "optimizer/clauses.h"
 #include "optimizer/joininfo.h"
@@ -30,7 +39,18 @@
 #include "optimizer/planmain.h"
 #include "optimizer/tlist.h"
 #include "optimizer/var.h"
+#include "parser/parsetree.h"
+#include "rewrite/rewriteManip.h"
 #include "utils/lsyscache.h"
+#include "utils/rel.h"
+
+/* context for rte_referenced_walker */
+typedef struct
+{
+	int			rtindex;		/* RT index to look for */
+	int			sublevels_up;	/* current nesting depth */
+	List	   *ignore;			/* subtrees not to look into */
+} rte_referenced_context;
 
 /* local functions */
 static bool join_is_removable(PlannerInfo *root, SpecialJoinInfo *sjinfo);
@@ -46,6 +66,25 @@ static bool is_innerrel_unique_for(PlannerInfo *root,
 					   RelOptInfo *innerrel,
 					   JoinType jointype,
 					   List *restrictlist);
+static void collect_inner_join_rels(Node *jtnode, List **rtindexes,
+						List **quallists);
+static bool rte_is_removal_candidate(RangeTblEntry *rte);
+static bool rtr_is_removable(Node *jtnode, int rtindex);
+static bool remove_rtr_from_jointree(Node **jtnode, int rtindex);
+static bool try_remove_self_join(PlannerInfo *root, List *quallists,
+					 int keep, int remove);
+static bool try_remove_fkey_join(PlannerInfo *root, List *quallists,
+					 int referencing, int referenced);
+static OpExpr *find_self_join_clause(List *quallists, int rti1, int rti2,
+					  AttrNumber attno, Oid opfamily);
+static OpExpr *find_fkey_join_clause(List *quallists,
+					  int frti, AttrNumber fattno,
+					  int prti, AttrNumber pattno, Oid pfeqop);
+static void replace_join_clause(List *quallists, OpExpr *clause, int rtindex,
+					Relation rel);
+static Node *strip_relabel(Node *node);
+static bool rte_referenced_walker(Node *node,
+					  rte_referenced_context *context);
 
 
 /*
@@ -1121,3 +1160,606 @@ is_innerrel_unique_for(PlannerInfo *root,
 	/* Let rel_is_distinct_for() do the hard work */
 	return rel_is_distinct_for(root, innerrel, clause_list);
 }
+
+
+/*
+ * remove_redundant_inner_joins
+ *		Remove relations from inner joins where they can't affect the result.
+ *
+ * Two cases are recognized:
+ *
+ * 1. A relation inner-joined to another instance of itself, with equality
+ * clauses on all columns of a unique index.  Each row can only join to
+ * itself, so we can drop one instance, make its Vars refer to the other one,
+ * and replace the join clauses with IS NOT NULL tests.  Generated SQL often
+ * contains such joins.
+ *
+ * 2. A relation that is referenced by a validated, non-deferrable foreign key
+ * of another relation it's inner-joined to, with equality clauses on all the
+ * foreign key's columns, and which is not otherwise used in the query.  Each
+ * referencing row with non-null keys joins to exactly one referenced row, so
+ * again the join clauses can be replaced by IS NOT NULL tests.  Foreign keys
+ * are only guaranteed to hold when no RI triggers are pending, so we don't
+ * do this if the query has data-modifying CTEs or either relation has
+ * pending trigger events.
+ *
+ * Unlike the rest of this file, this works on the Query tree, before
+ * deconstruct_jointree.  The caller must have done expression preprocessing
+ * already, so that the quals are in implicit-AND form and join alias Vars
+ * have been flattened.  We only consider relations that are joined by inner
+ * joins at the top of the join tree; the quals of all those joins apply to
+ * the joined rows equally.
+ */
+void
+remove_redundant_inner_joins(PlannerInfo *root)
+{
+	Query	   *parse = root->parse;
+	bool		try_fkeys = !parse->hasModifyingCTE;
+	List	   *rtindexes;
+	List	   *quallists;
+	ListCell   *lc1;
+	ListCell   *lc2;
+
+	/* Row marks refer to the relations; just don't bother with them */
+	if (parse->commandType != CMD_SELECT || root->rowMarks != NIL)
+		return;
+
+restart:
+	rtindexes = NIL;
+	quallists = NIL;
+	collect_inner_join_rels((Node *) parse->jointree, &rtindexes, &quallists);
+	if (list_length(rtindexes) < 2)
+		return;
+
+	foreach(lc1, rtindexes)
+	{
+		foreach(lc2, rtindexes)
+		{
+			int			rti1 = lfirst_int(lc1);
+			int			rti2 = lfirst_int(lc2);
+
+			if (rti1 == rti2)
+				continue;
+
+			if (try_remove_self_join(root, quallists, rti1, rti2) ||
+				(try_fkeys &&
+				 try_remove_fkey_join(root, quallists, rti1, rti2)))
+			{
+				/* The join tree changed, so start over */
+				list_free(rtindexes);
+				list_free(quallists);
+				goto restart;
+			}
+		}
+	}
+}
+
+/*
+ * collect_inner_join_rels
+ *		Find the RT indexes of the relations inner-joined at the top of the
+ *		join tree, and pointers to the qual lists of those joins.
+ */
+static void
+collect_inner_join_rels(Node *jtnode, List **rtindexes, List **quallists)
+{
+	if (jtnode == NULL)
+		return;
+	if (IsA(jtnode, RangeTblRef))
+	{
+		*rtindexes = lappend_int(*rtindexes, ((RangeTblRef *) jtnode)->rtindex);
+	}
+	else if (IsA(jtnode, FromExpr))
+	{
+		FromExpr   *f = (FromExpr *) jtnode;
+		ListCell   *l;
+
+		foreach(l, f->fromlist)
+			collect_inner_join_rels(lfirst(l), rtindexes, quallists);
+		*quallists = lappend(*quallists, &f->quals);
+	}
+	else if (IsA(jtnode, JoinExpr))
+	{
+		JoinExpr   *j = (JoinExpr *) jtnode;
+
+		/* Outer joins are opaque to us */
+		if (j->jointype != JOIN_INNER)
+			return;
+		collect_inner_join_rels(j->larg, rtindexes, quallists);
+		collect_inner_join_rels(j->rarg, rtindexes, quallists);
+		*quallists = lappend(*quallists, &j->quals);
+	}
+	else
+		elog(ERROR, "unrecognized node type: %d",
+			 (int) nodeTag(jtnode));
+}
+
+/*
+ * rte_is_removal_candidate
+ *		Is this a plain table whose rows we can reason about?
+ *
+ * Inheritance children could contain duplicates of unique keys and rows
+ * without a referenced row, sampling and security quals would hide rows.
+ */
+static bool
+rte_is_removal_candidate(RangeTblEntry *rte)
+{
+	return (rte->rtekind == RTE_RELATION &&
+			(rte->relkind == RELKIND_RELATION ||
+			 rte->relkind == RELKIND_MATVIEW) &&
+			!rte->inh &&
+			rte->tablesample == NULL &&
+			rte->securityQuals == NIL);
+}
+
+/*
+ * rtr_is_removable
+ *		Can the RangeTblRef for rtindex be taken out of the join tree?
+ *
+ * We don't want to leave an empty FromExpr behind, so it mustn't be the only
+ * member of one.
+ */
+static bool
+rtr_is_removable(Node *jtnode, int rtindex)
+{
+	if (IsA(jtnode, FromExpr))
+	{
+		FromExpr   *f = (FromExpr *) jtnode;
+		ListCell   *l;
+
+		foreach(l, f->fromlist)
+		{
+			Node	   *item = (Node *) lfirst(l);
+
+			if (IsA(item, RangeTblRef) &&
+				((RangeTblRef *) item)->rtindex == rtindex)
+				return list_length(f->fromlist) > 1;
+			if (rtr_is_removable(item, rtindex))
+				return true;
+		}
+	}
+	else if (IsA(jtnode, JoinExpr))
+	{
+		JoinExpr   *j = (JoinExpr *) jtnode;
+
+		if (j->jointype != JOIN_INNER)
+			return false;
+		if ((IsA(j->larg, RangeTblRef) &&
+			 ((RangeTblRef *) j->larg)->rtindex == rtindex) ||
+			(IsA(j->rarg, RangeTblRef) &&
+			 ((RangeTblRef *) j->rarg)->rtindex == rtindex))
+			return true;
+		return (rtr_is_removable(j->larg, rtindex) ||
+				rtr_is_removable(j->rarg, rtindex));
+	}
+	return false;
+}
+
+/*
+ * remove_rtr_from_jointree
+ *		Take the RangeTblRef for rtindex out of the join tree.
+ *
+ * An inner JoinExpr that loses one of its inputs is replaced by a FromExpr
+ * holding the other input and the join's quals.
+ */
+static bool
+remove_rtr_from_jointree(Node **jtnode, int rtindex)
+{
+	if (IsA(*jtnode, FromExpr))
+	{
+		FromExpr   *f = (FromExpr *) *jtnode;
+		ListCell   *l;
+
+		foreach(l, f->fromlist)
+		{
+			Node	   *item = (Node *) lfirst(l);
+
+			if (IsA(item, RangeTblRef) &&
+				((RangeTblRef *) item)->rtindex == rtindex)
+			{
+				f->fromlist = list_delete_ptr(f->fromlist, item);
+				return true;
+			}
+			if (remove_rtr_from_jointree((Node **) &lfirst(l), rtindex))
+				return true;
+		}
+	}
+	else if (IsA(*jtnode, JoinExpr))
+	{
+		JoinExpr   *j = (JoinExpr *) *jtnode;
+
+		if (j->jointype != JOIN_INNER)
+			return false;
+		if (IsA(j->larg, RangeTblRef) &&
+			((RangeTblRef *) j->larg)->rtindex == rtindex)
+		{
+			*jtnode = (Node *) makeFromExpr(list_make1(j->rarg), j->quals);
+			return true;
+		}
+		if (IsA(j->rarg, RangeTblRef) &&
+			((RangeTblRef *) j->rarg)->rtindex == rtindex)
+		{
+			*jtnode = (Node *) makeFromExpr(list_make1(j->larg), j->quals);
+			return true;
+		}
+		return (remove_rtr_from_jointree(&j->larg, rtindex) ||
+				remove_rtr_from_jointree(&j->rarg, rtindex));
+	}
+	return false;
+}
+
+/*
+ * try_remove_self_join
+ *		If relation "remove" is joined to "keep" on a unique key of the same
+ *		table, merge it into "keep".
+ */
+static bool
+try_remove_self_join(PlannerInfo *root, List *quallists, int keep, int remove)
+{
+	Query	   *parse = root->parse;
+	RangeTblEntry *keeprte = rt_fetch(keep, parse->rtable);
+	RangeTblEntry *removerte = rt_fetch(remove, parse->rtable);
+	Relation	relation;
+	List	   *indexoidlist;
+	List	   *matched = NIL;
+	bool		found = false;
+	ListCell   *lc;
+
+	if (keeprte->rtekind != RTE_RELATION ||
+		removerte->rtekind != RTE_RELATION ||
+		keeprte->relid != removerte->relid ||
+		!rte_is_removal_candidate(keeprte) ||
+		!rte_is_removal_candidate(removerte) ||
+		!rtr_is_removable((Node *) parse->jointree, remove))
+		return false;
+
+	/* The relation is already locked by the parser */
+	relation = heap_open(keeprte->relid, NoLock);
+	indexoidlist = RelationGetIndexList(relation);
+
+	foreach(lc, indexoidlist)
+	{
+		Relation	indexRelation;
+		Form_pg_index index;
+		int			i;
+
+		indexRelation = index_open(lfirst_oid(lc), AccessShareLock);
+		index = indexRelation->rd_index;
+
+		/*
+		 * We need a valid, non-deferrable, non-partial unique btree index on
+		 * plain columns, and an equality join clause for each of them.
+		 */
+		if (index->indisunique && index->indimmediate &&
+			IndexIsValid(index) &&
+			indexRelation->rd_rel->relam == BTREE_AM_OID &&
+			RelationGetIndexPredicate(indexRelation) == NIL)
+		{
+			matched = NIL;
+			for (i = 0; i < index->indnatts; i++)
+			{
+				AttrNumber	attno = index->indkey.values[i];
+				OpExpr	   *clause;
+
+				if (attno == 0)
+					break;
+				clause = find_self_join_clause(quallists, keep, remove, attno,
+											   indexRelation->rd_opfamily[i]);
+				if (clause == NULL)
+					break;
+				matched = lappend(matched, clause);
+			}
+			found = (i == index->indnatts);
+		}
+
+		index_close(indexRelation, NoLock);
+		if (found)
+			break;
+		list_free(matched);
+		matched = NIL;
+	}
+	list_free(indexoidlist);
+
+	if (found)
+	{
+		foreach(lc, matched)
+			replace_join_clause(quallists, (OpExpr *) lfirst(lc), keep,
+								relation);
+		remove_rtr_from_jointree((Node **) &parse->jointree, remove);
+		ChangeVarNodes((Node *) parse, remove, keep, 0);
+	}
+
+	heap_close(relation, NoLock);
+
+	return found;
+}
+
+/*
+ * try_remove_fkey_join
+ *		If relation "referenced" is only joined to "referencing" along a
+ *		foreign key, remove it.
+ */
+static bool
+try_remove_fkey_join(PlannerInfo *root, List *quallists,
+					 int referencing, int referenced)
+{
+	Query	   *parse = root->parse;
+	RangeTblEntry *frte = rt_fetch(referencing, parse->rtable);
+	RangeTblEntry *prte = rt_fetch(referenced, parse->rtable);
+	Relation	relation;
+	List	   *matched = NIL;
+	bool		found = false;
+	ListCell   *lc;
+
+	if (!rte_is_removal_candidate(frte) ||
+		!rte_is_removal_candidate(prte) ||
+		!rtr_is_removable((Node *) parse->jointree, referenced))
+		return false;
+
+	/*
+	 * Not while the foreign keys might be transiently violated.  A cached
+	 * plan can be executed later, when that's the case; the plan cache
+	 * repeats this check for the tables we record below when it reuses the
+	 * plan.
+	 */
+	if (AfterTriggerPendingOnRel(frte->relid) ||
+		AfterTriggerPendingOnRel(prte->relid))
+		return false;
+
+	relation = heap_open(frte->relid, NoLock);
+
+	foreach(lc, RelationGetFKeyList(relation))
+	{
+		ForeignKeyCacheInfo *fkinfo = (ForeignKeyCacheInfo *) lfirst(lc);
+		rte_referenced_context context;
+		int			i;
+
+		if (fkinfo->confrelid != prte->relid ||
+			!fkinfo->convalidated || fkinfo->condeferrable)
+			continue;
+
+		matched = NIL;
+		for (i = 0; i < fkinfo->nkeys; i++)
+		{
+			OpExpr	   *clause;
+
+			clause = find_fkey_join_clause(quallists,
+										   referencing, fkinfo->conkey[i],
+										   referenced, fkinfo->confkey[i],
+										   fkinfo->conpfeqop[i]);
+			if (clause == NULL)
+				break;
+			matched = lappend(matched, clause);
+		}
+		if (i < fkinfo->nkeys)
+		{
+			list_free(matched);
+			continue;
+		}
+
+		/* The referenced relation mustn't be used anywhere else */
+		context.rtindex = referenced;
+		context.sublevels_up = 0;
+		context.ignore = matched;
+		if (!query_tree_walker(parse, rte_referenced_walker,
+							   (void *) &context, QTW_IGNORE_JOINALIASES))
+		{
+			found = true;
+			break;
+		}
+		list_free(matched);
+	}
+
+	if (found)
+	{
+		foreach(lc, matched)
+			replace_join_clause(quallists, (OpExpr *) lfirst(lc), referencing,
+								relation);
+		remove_rtr_from_jointree((Node **) &parse->jointree, referenced);
+
+		root->glob->fkeyJoinRelOids =
+			list_append_unique_oid(root->glob->fkeyJoinRelOids, frte->relid);
+		root->glob->fkeyJoinRelOids =
+			list_append_unique_oid(root->glob->fkeyJoinRelOids, prte->relid);
+	}
+
+	heap_close(relation, NoLock);
+
+	return found;
+}
+
+/*
+ * find_self_join_clause
+ *		Look for a clause "rti1.attno = rti2.attno" (in either order) using
+ *		the equality operator of the given btree opfamily.
+ */
+static OpExpr *
+find_self_join_clause(List *quallists, int rti1, int rti2,
+					  AttrNumber attno, Oid opfamily)
+{
+	ListCell   *lc1;
+	ListCell   *lc2;
+
+	foreach(lc1, quallists)
+	{
+		List	   *quals = (List *) *((Node **) lfirst(lc1));
+
+		foreach(lc2, quals)
+		{
+			OpExpr	   *clause = (OpExpr *) lfirst(lc2);
+			Var		   *left;
+			Var		   *right;
+
+			if (!is_opclause(clause) || list_length(clause->args) != 2)
+				continue;
+			left = (Var *) strip_relabel(linitial(clause->args));
+			right = (Var *) strip_relabel(lsecond(clause->args));
+			if (!IsA(left, Var) || !IsA(right, Var) ||
+				left->varlevelsup != 0 || right->varlevelsup != 0 ||
+				left->varattno != attno || right->varattno != attno)
+				continue;
+			if (!((left->varno == rti1 && right->varno == rti2) ||
+				  (left->varno == rti2 && right->varno == rti1)))
+				continue;
+			if (get_op_opfamily_strategy(clause->opno, opfamily) ==
+				BTEqualStrategyNumber)
+				return clause;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * find_fkey_join_clause
+ *		Look for a clause "prti.pattno = frti.fattno" using the foreign key's
+ *		equality operator, or its commutator with the inputs swapped.
+ */
+static OpExpr *
+find_fkey_join_clause(List *quallists,
+					  int frti, AttrNumber fattno,
+					  int prti, AttrNumber pattno, Oid pfeqop)
+{
+	ListCell   *lc1;
+	ListCell   *lc2;
+
+	foreach(lc1, quallists)
+	{
+		List	   *quals = (List *) *((Node **) lfirst(lc1));
+
+		foreach(lc2, quals)
+		{
+			OpExpr	   *clause = (OpExpr *) lfirst(lc2);
+			Var		   *left;
+			Var		   *right;
+
+			if (!is_opclause(clause) || list_length(clause->args) != 2)
+				continue;
+			left = (Var *) strip_relabel(linitial(clause->args));
+			right = (Var *) strip_relabel(lsecond(clause->args));
+			if (!IsA(left, Var) || !IsA(right, Var) ||
+				left->varlevelsup != 0 || right->varlevelsup != 0)
+				continue;
+			if (left->varno == prti && left->varattno == pattno &&
+				right->varno == frti && right->varattno == fattno &&
+				clause->opno == pfeqop)
+				return clause;
+			if (left->varno == frti && left->varattno == fattno &&
+				right->varno == prti && right->varattno == pattno &&
+				clause->opno == get_commutator(pfeqop))
+				return clause;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * replace_join_clause
+ *		Replace an equality join clause made redundant by a join removal with
+ *		a test that rtindex's side of it is not null.
+ *
+ * The test isn't needed at all if the column is marked NOT NULL.
+ */
+static void
+replace_join_clause(List *quallists, OpExpr *clause, int rtindex,
+					Relation rel)
+{
+	Var		   *var;
+	NullTest   *ntest = NULL;
+	ListCell   *lc1;
+	ListCell   *lc2;
+
+	var = (Var *) strip_relabel(linitial(clause->args));
+	if (var->varno != rtindex)
+		var = (Var *) strip_relabel(lsecond(clause->args));
+	Assert(IsA(var, Var) && var->varno == rtindex);
+
+	if (var->varattno <= 0 ||
+		!TupleDescAttr(RelationGetDescr(rel), var->varattno - 1)->attnotnull)
+	{
+		ntest = makeNode(NullTest);
+		ntest->arg = (Expr *) copyObject(var);
+		ntest->nulltesttype = IS_NOT_NULL;
+		ntest->argisrow = false;
+		ntest->location = -1;
+	}
+
+	foreach(lc1, quallists)
+	{
+		Node	  **qualptr = (Node **) lfirst(lc1);
+		List	   *quals = (List *) *qualptr;
+
+		foreach(lc2, quals)
+		{
+			if (lfirst(lc2) != (void *) clause)
+				continue;
+			if (ntest)
+				lfirst(lc2) = ntest;
+			else
+				*qualptr = (Node *) list_delete_ptr(quals, clause);
+			return;
+		}
+	}
+	elog(ERROR, "join clause to replace not found");
+}
+
+/*
+ * strip_relabel
+ *		Look through binary-compatible relabelings.
+ */
+static Node *
+strip_relabel(Node *node)
+{
+	while (node && IsA(node, RelabelType))
+		node = (Node *) ((RelabelType *) node)->arg;
+	return node;
+}
+
+/*
+ * rte_referenced_walker
+ *		Does the tree reference the given RT index, apart from the subtrees
+ *		in context->ignore?
+ *
+ * RangeTblRefs don't count.
+ */
+static bool
+rte_referenced_walker(Node *node, rte_referenced_context *context)
+{
+	if (node == NULL)
+		return false;
+	if (list_member_ptr(context->ignore, node))
+		return false;
+	if (IsA(node, Var))
+	{
+		Var		   *var = (Var *) node;
+
+		return (var->varno == context->rtindex &&
+				var->varlevelsup == context->sublevels_up);
+	}
+	if (IsA(node, CurrentOfExpr))
+	{
+		CurrentOfExpr *cexpr = (CurrentOfExpr *) node;
+
+		return (cexpr->cvarno == context->rtindex &&
+				context->sublevels_up == 0);
+	}
+	if (IsA(node, PlaceHolderVar))
+	{
+		PlaceHolderVar *phv = (PlaceHolderVar *) node;
+
+		if (phv->phlevelsup == context->sublevels_up &&
+			bms_is_member(context->rtindex, phv->phrels))
+			return true;
+		/* fall through to examine children */
+	}
+	if (IsA(node, Query))
+	{
+		bool		result;
+
+		context->sublevels_up++;
+		result = query_tree_walker((Query *) node, rte_referenced_walker,
+								   (void *) context, QTW_IGNORE_JOINALIASES);
+		context->sublevels_up--;
+		return result;
+	}
+	return expression_tree_walker(node, rte_referenced_walker,
+								  (void *) context);
+}
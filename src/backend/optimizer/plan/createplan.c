@@ -215,6 +215,7 @@ static BitmapAnd *make_bitmap_and(List *bitmapplans);
 static BitmapOr *make_bitmap_or(List *bitmapplans);
 static NestLoop *make_nestloop(List *tlist,
 			  List *joinclauses, List *otherclauses, List *nestParams,
+			  List *hashclauses,
 			  Plan *lefttree, Plan *righttree,
 			  JoinType jointype, bool inner_unique);
 static HashJoin *make_hashjoin(List *tlist,
@@ -3671,7 +3672,9 @@ create_nestloop_plan(PlannerInfo *root,
 	List	   *joinrestrictclauses = best_path->joinrestrictinfo;
 	List	   *joinclauses;
 	List	   *otherclauses;
+	List	   *hashclauses;
 	Relids		outerrelids;
+	Relids		innerrelids;
 	List	   *nestParams;
 	Relids		saveOuterRels = root->curOuterRels;
 	ListCell   *cell;
@@ -3752,10 +3755,45 @@ create_nestloop_plan(PlannerInfo *root,
 			prev = cell;
 	}
 
+	/*
+	 * If the inner side doesn't depend on the outer one, collect the
+	 * hashjoinable join clauses, rearranged so that the outer variable is
+	 * always on the left.  If the outer input turns out to be much larger
+	 * than estimated, the executor can use them to switch to probing a hash
+	 * table of the inner input instead of rescanning it for each outer row.
+	 */
+	hashclauses = NIL;
+	if (nestParams == NIL)
+	{
+		innerrelids = best_path->innerjoinpath->parent->relids;
+		foreach(cell, joinrestrictclauses)
+		{
+			RestrictInfo *rinfo = lfirst_node(RestrictInfo, cell);
+
+			/* For an outer join, only its own join clauses will do */
+			if (IS_OUTER_JOIN(best_path->jointype) && rinfo->is_pushed_down)
+				continue;
+			if (rinfo->pseudoconstant || !rinfo->can_join ||
+				rinfo->hashjoinoperator == InvalidOid)
+				continue;
+			if (!(bms_is_subset(rinfo->left_relids, outerrelids) &&
+				  bms_is_subset(rinfo->right_relids, innerrelids)) &&
+				!(bms_is_subset(rinfo->left_relids, innerrelids) &&
+				  bms_is_subset(rinfo->right_relids, outerrelids)))
+				continue;
+			hashclauses = lappend(hashclauses, rinfo);
+		}
+		hashclauses = get_switched_clauses(hashclauses, outerrelids);
+		if (best_path->path.param_info)
+			hashclauses = (List *)
+				replace_nestloop_params(root, (Node *) hashclauses);
+	}
+
 	join_plan = make_nestloop(tlist,
 							  joinclauses,
 							  otherclauses,
 							  nestParams,
+							  hashclauses,
 							  outer_plan,
 							  inner_plan,
 							  best_path->jointype,
@@ -5416,6 +5454,7 @@ make_nestloop(List *tlist,
 			  List *joinclauses,
 			  List *otherclauses,
 			  List *nestParams,
+			  List *hashclauses,
 			  Plan *lefttree,
 			  Plan *righttree,
 			  JoinType jointype,
@@ -5432,6 +5471,7 @@ make_nestloop(List *tlist,
 	node->join.inner_unique = inner_unique;
 	node->join.joinqual = joinclauses;
 	node->nestParams = nestParams;
+	node->hashclauses = hashclauses;
 
 	return node;
 }
@@ -50,6 +50,7 @@
 #include "parser/analyze.h"
 #include "parser/parsetree.h"
 #include "parser/parse_agg.h"
+#include "parser/parse_oper.h"
 #include "rewrite/rewriteManip.h"
 #include "storage/dsm_impl.h"
 #include "utils/rel.h"
@@ -205,6 +206,32 @@ static void add_partial_paths_to_grouping_rel(PlannerInfo *root,
 								  List *havingQual);
 static bool can_parallel_agg(PlannerInfo *root, RelOptInfo *input_rel,
 				 RelOptInfo *grouped_rel, const AggClauseCosts *agg_costs);
+static void add_eager_agg_paths_to_grouping_rel(PlannerInfo *root,
+									RelOptInfo *input_rel,
+									RelOptInfo *grouped_rel,
+									PathTarget *target,
+									const AggClauseCosts *agg_costs,
+									bool can_sort, bool can_hash,
+									double dNumGroups, List *havingQual);
+static void try_eager_agg_join(PlannerInfo *root, RelOptInfo *input_rel,
+				   RelOptInfo *grouped_rel, RelOptInfo *aggrel,
+				   RelOptInfo *otherrel, PathTarget *target,
+				   PathTarget *join_target,
+				   const AggClauseCosts *agg_final_costs,
+				   bool can_sort, bool can_hash,
+				   double dNumGroups, List *havingQual);
+static bool eager_agg_key_type_ok(Oid typid);
+static RelOptInfo *make_eager_agg_rel(PlannerInfo *root, RelOptInfo *rel,
+				   RelOptKind reloptkind, PathTarget *target,
+				   double rows);
+static void add_partition_wise_agg_paths(PlannerInfo *root,
+							 RelOptInfo *input_rel,
+							 RelOptInfo *grouped_rel,
+							 PathTarget *target,
+							 const AggClauseCosts *agg_costs,
+							 bool can_sort, bool can_hash,
+							 double dNumGroups, List *havingQual);
+static bool group_by_has_partkey(PlannerInfo *root, RelOptInfo *input_rel);
 
 
 /*****************************************************************************
@@ -264,6 +291,7 @@ standard_planner(Query *parse, int cursorOptions, ParamListInfo boundParams)
 	glob->rootResultRelations = NIL;
 	glob->relationOids = NIL;
 	glob->invalItems = NIL;
+	glob->fkeyJoinRelOids = NIL;
 	glob->paramExecTypes = NIL;
 	glob->lastPHId = 0;
 	glob->lastRowMarkId = 0;
@@ -495,6 +523,7 @@ standard_planner(Query *parse, int cursorOptions, ParamListInfo boundParams)
 	result->rowMarks = glob->finalrowmarks;
 	result->relationOids = glob->relationOids;
 	result->invalItems = glob->invalItems;
+	result->fkeyJoinRelOids = glob->fkeyJoinRelOids;
 	result->paramExecTypes = glob->paramExecTypes;
 	/* utilityStmt should be null, but we might as well copy it */
 	result->utilityStmt = parse->utilityStmt;
@@ -898,6 +927,13 @@ subquery_planner(PlannerGlobal *glob, Query *parse,
 	if (hasOuterJoins)
 		reduce_outer_joins(root);
 
+	/*
+	 * Remove inner joins that can't change the result.  This too is easiest
+	 * after expression preprocessing, and after reducing outer joins, which
+	 * may produce more inner joins to consider.
+	 */
+	remove_redundant_inner_joins(root);
+
 	/*
 	 * Do the main planning.  If we have an inherited target relation, that
 	 * needs special processing, else go straight to grouping_planner.
@@ -3830,6 +3866,30 @@ create_grouping_paths(PlannerInfo *root,
 							  &agg_final_costs, gd, can_sort, can_hash,
 							  dNumGroups, (List *) parse->havingQual);
 
+	/*
+	 * Also consider partially aggregating one side of the join before
+	 * joining, if that's possible.
+	 */
+	if (enable_eager_aggregate && parse->hasAggs && parse->groupClause &&
+		!parse->groupingSets && !agg_costs->hasNonPartial &&
+		!agg_costs->hasNonSerial)
+		add_eager_agg_paths_to_grouping_rel(root, input_rel, grouped_rel,
+											target, agg_costs,
+											can_sort, can_hash, dNumGroups,
+											(List *) parse->havingQual);
+
+	/*
+	 * Also consider aggregating each partition of a partitioned input
+	 * relation separately.
+	 */
+	if (enable_partition_wise_agg && IS_PARTITIONED_REL(input_rel) &&
+		!parse->groupingSets && !parse->hasTargetSRFs &&
+		!IS_DUMMY_REL(input_rel))
+		add_partition_wise_agg_paths(root, input_rel, grouped_rel,
+									 target, agg_costs,
+									 can_sort, can_hash, dNumGroups,
+									 (List *) parse->havingQual);
+
 	/* Give a helpful error if we failed to find any implementation */
 	if (grouped_rel->pathlist == NIL)
 		ereport(ERROR,
@@ -6434,3 +6494,710 @@ can_parallel_agg(PlannerInfo *root, RelOptInfo *input_rel,
 	/* Everything looks good. */
 	return true;
 }
+
+/*
+ * add_eager_agg_paths_to_grouping_rel
+ *
+ * Add paths to grouped_rel that partially aggregate one input of the join
+ * before the join is performed, and finalize the aggregation on top of the
+ * join.  When a big relation is joined to a small one on a column with few
+ * distinct values, this lets the join process one row per group instead of
+ * every row of the big relation.
+ *
+ * This is correct whenever all the aggregates' arguments come from the
+ * partially aggregated relation and it's grouped by every column of it that
+ * is needed above the join: all rows of such a group join to the same rows
+ * of the other relation, so the final aggregation step combines exactly the
+ * transition values it would have accumulated from the joined rows.  No
+ * functional dependency between the grouping and join keys is required,
+ * though that is the case in which the partial aggregation reduces the
+ * most rows.
+ *
+ * The partial groups are formed with the grouping columns' equality
+ * operators, though, which merges values that are equal but can still be
+ * told apart, like numeric 1.0 and 1.00; an expression above the join such
+ * as "GROUP BY f.k::text" would then see only one of them.  So all the
+ * grouping columns must be of types whose equal values are identical.
+ *
+ * For now we only handle an inner join between two base relations.
+ */
+static void
+add_eager_agg_paths_to_grouping_rel(PlannerInfo *root, RelOptInfo *input_rel,
+									RelOptInfo *grouped_rel,
+									PathTarget *target,
+									const AggClauseCosts *agg_costs,
+									bool can_sort, bool can_hash,
+									double dNumGroups, List *havingQual)
+{
+	PathTarget *join_target;
+	AggClauseCosts agg_final_costs;
+	RelOptInfo *rel1;
+	RelOptInfo *rel2;
+	int			relid;
+
+	if (input_rel->reloptkind != RELOPT_JOINREL ||
+		bms_num_members(input_rel->relids) != 2 ||
+		IS_DUMMY_REL(input_rel))
+		return;
+
+	/* No outer joins, semijoins, LATERAL references or PlaceHolderVars */
+	if (root->join_info_list != NIL || root->hasLateralRTEs ||
+		root->placeholder_list != NIL)
+		return;
+
+	relid = bms_next_member(input_rel->relids, -1);
+	rel1 = find_base_rel(root, relid);
+	relid = bms_next_member(input_rel->relids, relid);
+	rel2 = find_base_rel(root, relid);
+	if (rel1->reloptkind != RELOPT_BASEREL ||
+		rel2->reloptkind != RELOPT_BASEREL ||
+		IS_DUMMY_REL(rel1) || IS_DUMMY_REL(rel2))
+		return;
+
+	/*
+	 * The join emits what a partial aggregation step would have emitted:
+	 * the grouping expressions, any other Vars needed above, and partial
+	 * Aggrefs.
+	 */
+	join_target = make_partial_grouping_target(root, target);
+
+	MemSet(&agg_final_costs, 0, sizeof(AggClauseCosts));
+	get_agg_clause_costs(root, (Node *) target->exprs,
+						 AGGSPLIT_FINAL_DESERIAL, &agg_final_costs);
+	get_agg_clause_costs(root, (Node *) havingQual,
+						 AGGSPLIT_FINAL_DESERIAL, &agg_final_costs);
+
+	try_eager_agg_join(root, input_rel, grouped_rel, rel1, rel2,
+					   target, join_target, &agg_final_costs,
+					   can_sort, can_hash, dNumGroups, havingQual);
+	try_eager_agg_join(root, input_rel, grouped_rel, rel2, rel1,
+					   target, join_target, &agg_final_costs,
+					   can_sort, can_hash, dNumGroups, havingQual);
+}
+
+/*
+ * try_eager_agg_join
+ *
+ * Workhorse for add_eager_agg_paths_to_grouping_rel: try partially
+ * aggregating aggrel before joining it to otherrel.
+ */
+static void
+try_eager_agg_join(PlannerInfo *root, RelOptInfo *input_rel,
+				   RelOptInfo *grouped_rel, RelOptInfo *aggrel,
+				   RelOptInfo *otherrel, PathTarget *target,
+				   PathTarget *join_target,
+				   const AggClauseCosts *agg_final_costs,
+				   bool can_sort, bool can_hash,
+				   double dNumGroups, List *havingQual)
+{
+	Query	   *parse = root->parse;
+	List	   *aggrefs = NIL;
+	List	   *keyexprs = NIL;
+	List	   *keyclauses = NIL;
+	List	   *vars;
+	PathTarget *input_target;
+	PathTarget *partial_target;
+	AggClauseCosts agg_partial_costs;
+	RelOptInfo *partial_rel;
+	RelOptInfo *joinrel;
+	SpecialJoinInfo sjinfo;
+	List	   *restrictlist;
+	Path	   *path;
+	Index		maxref = 0;
+	double		numPartialGroups;
+	ListCell   *lc;
+
+	/*
+	 * All the aggregates must be computable from aggrel alone, and they must
+	 * not be volatile, since each one is now evaluated once per aggrel row
+	 * rather than once per joined row.
+	 */
+	foreach(lc, join_target->exprs)
+	{
+		Node	   *expr = (Node *) lfirst(lc);
+
+		if (!IsA(expr, Aggref))
+			continue;
+		if (!bms_is_subset(pull_varnos(expr), aggrel->relids) ||
+			contain_volatile_functions(expr))
+			return;
+		aggrefs = lappend(aggrefs, expr);
+	}
+
+	/*
+	 * Group by all of aggrel's Vars that are used above the join outside of
+	 * aggregates, which includes its part of the grouping expressions, and
+	 * by all of them that appear in join clauses, whether explicit or
+	 * implied by equivalence classes.  The Aggrefs themselves are included
+	 * in pull_var_clause's output, so skip them.
+	 */
+	vars = pull_var_clause((Node *) join_target->exprs,
+						   PVC_INCLUDE_AGGREGATES |
+						   PVC_RECURSE_WINDOWFUNCS |
+						   PVC_RECURSE_PLACEHOLDERS);
+	foreach(lc, aggrel->joininfo)
+	{
+		RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
+
+		vars = list_concat(vars,
+						   pull_var_clause((Node *) rinfo->clause,
+										   PVC_RECURSE_PLACEHOLDERS));
+	}
+	foreach(lc, root->eq_classes)
+	{
+		EquivalenceClass *ec = (EquivalenceClass *) lfirst(lc);
+		ListCell   *lc2;
+
+		if (!bms_overlap(ec->ec_relids, aggrel->relids) ||
+			!bms_overlap(ec->ec_relids, otherrel->relids))
+			continue;
+		foreach(lc2, ec->ec_members)
+		{
+			EquivalenceMember *em = (EquivalenceMember *) lfirst(lc2);
+
+			if (!em->em_is_child && !em->em_is_const &&
+				bms_is_subset(em->em_relids, aggrel->relids))
+				vars = list_concat(vars,
+								   pull_var_clause((Node *) em->em_expr,
+												   PVC_RECURSE_PLACEHOLDERS));
+		}
+	}
+	foreach(lc, vars)
+	{
+		Var		   *var = (Var *) lfirst(lc);
+
+		if (IsA(var, Var) && bms_is_member(var->varno, aggrel->relids))
+			keyexprs = list_append_unique(keyexprs, var);
+	}
+	list_free(vars);
+
+	/* Without any grouping columns there's nothing to gain */
+	if (keyexprs == NIL)
+		return;
+
+	/* Give up unless the partial aggregation reduces the rows noticeably */
+	numPartialGroups = estimate_num_groups(root, keyexprs, aggrel->rows, NULL);
+	if (numPartialGroups * 2 > aggrel->rows)
+		return;
+
+	/*
+	 * Build the input target for the partial aggregation: aggrel's own
+	 * target, with the grouping columns labeled with fresh sortgroupref
+	 * numbers, and a matching list of grouping clauses.
+	 */
+	foreach(lc, root->processed_tlist)
+	{
+		TargetEntry *tle = (TargetEntry *) lfirst(lc);
+
+		maxref = Max(maxref, tle->ressortgroupref);
+	}
+
+	input_target = copy_pathtarget(aggrel->reltarget);
+	if (input_target->sortgrouprefs == NULL)
+		input_target->sortgrouprefs = (Index *)
+			palloc0(list_length(input_target->exprs) * sizeof(Index));
+	partial_target = create_empty_pathtarget();
+	foreach(lc, keyexprs)
+	{
+		Expr	   *expr = (Expr *) lfirst(lc);
+		SortGroupClause *grpcl;
+		Oid			sortop;
+		Oid			eqop;
+		bool		hashable;
+		ListCell   *lc2;
+		int			i;
+
+		if (!eager_agg_key_type_ok(exprType((Node *) expr)))
+			return;
+		get_sort_group_operators(exprType((Node *) expr),
+								 false, true, false,
+								 &sortop, &eqop, NULL,
+								 &hashable);
+		if (!OidIsValid(eqop) || !hashable)
+			return;
+
+		i = 0;
+		foreach(lc2, input_target->exprs)
+		{
+			if (equal(lfirst(lc2), expr))
+				break;
+			i++;
+		}
+		if (lc2 == NULL)
+			return;				/* shouldn't happen */
+
+		grpcl = makeNode(SortGroupClause);
+		grpcl->tleSortGroupRef = ++maxref;
+		grpcl->eqop = eqop;
+		grpcl->sortop = sortop;
+		grpcl->nulls_first = false;
+		grpcl->hashable = true;
+		keyclauses = lappend(keyclauses, grpcl);
+
+		input_target->sortgrouprefs[i] = maxref;
+		add_column_to_pathtarget(partial_target, expr, maxref);
+	}
+	foreach(lc, aggrefs)
+		add_column_to_pathtarget(partial_target, (Expr *) lfirst(lc), 0);
+	set_pathtarget_cost_width(root, partial_target);
+
+	MemSet(&agg_partial_costs, 0, sizeof(AggClauseCosts));
+	get_agg_clause_costs(root, (Node *) aggrefs, AGGSPLIT_INITIAL_SERIAL,
+						 &agg_partial_costs);
+
+	/*
+	 * Make an upper relation representing the partially aggregated aggrel.
+	 * We only consider hashed partial aggregation of the cheapest path, on
+	 * the theory that it is the case where this is a win; if the hash table
+	 * wouldn't fit in work_mem, give up.
+	 */
+	partial_rel = make_eager_agg_rel(root, aggrel, RELOPT_UPPER_REL,
+									 partial_target, numPartialGroups);
+
+	path = (Path *) create_projection_path(root, partial_rel,
+										   aggrel->cheapest_total_path,
+										   input_target);
+	if (estimate_hashagg_tablesize(path, &agg_partial_costs,
+								   numPartialGroups) >= work_mem * 1024L)
+		return;
+	add_path(partial_rel, (Path *)
+			 create_agg_path(root,
+							 partial_rel,
+							 path,
+							 partial_target,
+							 AGG_HASHED,
+							 AGGSPLIT_INITIAL_SERIAL,
+							 keyclauses,
+							 NIL,
+							 &agg_partial_costs,
+							 numPartialGroups));
+	set_cheapest(partial_rel);
+
+	/*
+	 * Now join it to otherrel.  The join relation emits join_target, and
+	 * its size is that of the ordinary one scaled down by the reduction
+	 * achieved by the partial aggregation.
+	 */
+	joinrel = make_eager_agg_rel(root, input_rel, RELOPT_JOINREL,
+								 join_target,
+								 clamp_row_est(input_rel->rows *
+											   numPartialGroups / aggrel->rows));
+
+	/* Fake up a SpecialJoinInfo, as make_join_rel does for inner joins */
+	sjinfo.type = T_SpecialJoinInfo;
+	sjinfo.min_lefthand = aggrel->relids;
+	sjinfo.min_righthand = otherrel->relids;
+	sjinfo.syn_lefthand = aggrel->relids;
+	sjinfo.syn_righthand = otherrel->relids;
+	sjinfo.jointype = JOIN_INNER;
+	sjinfo.lhs_strict = false;
+	sjinfo.delay_upper_joins = false;
+	sjinfo.semi_can_btree = false;
+	sjinfo.semi_can_hash = false;
+	sjinfo.semi_operators = NIL;
+	sjinfo.semi_rhs_exprs = NIL;
+
+	/* This just looks up input_rel and computes the restriction list */
+	(void) build_join_rel(root, input_rel->relids, aggrel, otherrel,
+						  &sjinfo, &restrictlist);
+
+	add_paths_to_joinrel(root, joinrel, partial_rel, otherrel,
+						 JOIN_INNER, &sjinfo, restrictlist);
+	add_paths_to_joinrel(root, joinrel, otherrel, partial_rel,
+						 JOIN_INNER, &sjinfo, restrictlist);
+	if (joinrel->pathlist == NIL)
+		return;
+	set_cheapest(joinrel);
+
+	/* Finally, finalize the aggregation on top of the join */
+	if (can_sort)
+	{
+		foreach(lc, joinrel->pathlist)
+		{
+			bool		is_sorted;
+
+			path = (Path *) lfirst(lc);
+			is_sorted = pathkeys_contained_in(root->group_pathkeys,
+											  path->pathkeys);
+			if (path == joinrel->cheapest_total_path || is_sorted)
+			{
+				if (!is_sorted)
+					path = (Path *) create_sort_path(root,
+													 grouped_rel,
+													 path,
+													 root->group_pathkeys,
+													 -1.0);
+				add_path(grouped_rel, (Path *)
+						 create_agg_path(root,
+										 grouped_rel,
+										 path,
+										 target,
+										 AGG_SORTED,
+										 AGGSPLIT_FINAL_DESERIAL,
+										 parse->groupClause,
+										 havingQual,
+										 agg_final_costs,
+										 dNumGroups));
+			}
+		}
+	}
+
+	if (can_hash)
+	{
+		path = joinrel->cheapest_total_path;
+		if (estimate_hashagg_tablesize(path, agg_final_costs,
+									   dNumGroups) < work_mem * 1024L)
+			add_path(grouped_rel, (Path *)
+					 create_agg_path(root,
+									 grouped_rel,
+									 path,
+									 target,
+									 AGG_HASHED,
+									 AGGSPLIT_FINAL_DESERIAL,
+									 parse->groupClause,
+									 havingQual,
+									 agg_final_costs,
+									 dNumGroups));
+	}
+}
+
+/*
+ * eager_agg_key_type_ok
+ *
+ * Can values of the given type be partially grouped below a join?  Only if
+ * the type's default equality operator never considers two values equal
+ * that an expression evaluated above the join could distinguish.  There's
+ * no catalog support to tell, so we only accept a few built-in types known
+ * to compare their whole binary representation.  Notably, numeric (1.0 and
+ * 1.00), float (0 and -0), bpchar (trailing spaces) and interval (1 day and
+ * 24 hours) are not among them.
+ */
+static bool
+eager_agg_key_type_ok(Oid typid)
+{
+	switch (getBaseType(typid))
+	{
+		case BOOLOID:
+		case CHAROID:
+		case INT2OID:
+		case INT4OID:
+		case INT8OID:
+		case OIDOID:
+		case DATEOID:
+		case TIMEOID:
+		case TIMESTAMPOID:
+		case TIMESTAMPTZOID:
+		case TEXTOID:
+		case VARCHAROID:
+		case UUIDOID:
+			return true;
+		default:
+			return false;
+	}
+}
+
+/*
+ * make_eager_agg_rel
+ *
+ * Build a relation standing in for "rel" in eager aggregation planning, with
+ * the given kind, target and size.  It has rel's relids and join clauses, so
+ * that join planning treats it like rel, but no paths yet, and none of the
+ * scan details (indexes, restriction clauses, statistics) of a base relation.
+ * It's not entered into any of the planner's lists of relations.
+ */
+static RelOptInfo *
+make_eager_agg_rel(PlannerInfo *root, RelOptInfo *rel, RelOptKind reloptkind,
+				   PathTarget *target, double rows)
+{
+	RelOptInfo *newrel = makeNode(RelOptInfo);
+
+	newrel->reloptkind = reloptkind;
+	newrel->relids = bms_copy(rel->relids);
+	newrel->rows = rows;
+	/* cheap startup cost is interesting iff not all tuples to be retrieved */
+	newrel->consider_startup = (root->tuple_fraction > 0);
+	newrel->consider_param_startup = false;
+	newrel->consider_parallel = false;
+	newrel->reltarget = target;
+	newrel->pathlist = NIL;
+	newrel->ppilist = NIL;
+	newrel->partial_pathlist = NIL;
+	newrel->cheapest_startup_path = NULL;
+	newrel->cheapest_total_path = NULL;
+	newrel->cheapest_unique_path = NULL;
+	newrel->cheapest_parameterized_paths = NIL;
+	newrel->direct_lateral_relids = bms_copy(rel->direct_lateral_relids);
+	newrel->lateral_relids = bms_copy(rel->lateral_relids);
+	newrel->relid = 0;			/* indicates not a baserel */
+	newrel->rtekind = rel->rtekind;
+	newrel->rel_parallel_workers = -1;
+	newrel->serverid = InvalidOid;
+	newrel->userid = InvalidOid;
+	newrel->fdwroutine = NULL;
+	newrel->baserestrict_min_security = UINT_MAX;
+	newrel->joininfo = rel->joininfo;
+	newrel->has_eclass_joins = rel->has_eclass_joins;
+	newrel->part_scheme = NULL;
+
+	return newrel;
+}
+
+/*
+ * add_partition_wise_agg_paths
+ *
+ * Consider aggregating each partition of a partitioned input relation
+ * separately, below an Append; a technique called "partition-wise
+ * aggregation".  If the grouping clause includes all the partition keys, no
+ * group can span partitions, so each partition is aggregated completely and
+ * the Append emits the final result.  Otherwise each partition is partially
+ * aggregated, and the aggregation is finalized above the Append, the same
+ * way as in parallel aggregation.
+ *
+ * For now the partitions are only aggregated by hashing their cheapest
+ * paths, or without grouping if there's no GROUP BY; sorting a partition's
+ * rows would need the grouping pathkeys translated for it.
+ */
+static void
+add_partition_wise_agg_paths(PlannerInfo *root, RelOptInfo *input_rel,
+							 RelOptInfo *grouped_rel,
+							 PathTarget *target,
+							 const AggClauseCosts *agg_costs,
+							 bool can_sort, bool can_hash,
+							 double dNumGroups, List *havingQual)
+{
+	Query	   *parse = root->parse;
+	PathTarget *input_target = input_rel->cheapest_total_path->pathtarget;
+	PathTarget *append_target;
+	AggStrategy child_strategy;
+	AggClauseCosts agg_partial_costs;
+	AggClauseCosts agg_final_costs;
+	const AggClauseCosts *child_costs;
+	List	   *partitioned_rels;
+	List	   *subpaths = NIL;
+	bool		full_agg;
+	Path	   *path;
+	int			cnt_parts;
+
+	if (parse->groupClause != NIL)
+	{
+		if (!can_hash)
+			return;
+		child_strategy = AGG_HASHED;
+	}
+	else
+		child_strategy = AGG_PLAIN;
+
+	full_agg = group_by_has_partkey(root, input_rel);
+	if (full_agg)
+	{
+		append_target = target;
+		child_costs = agg_costs;
+	}
+	else
+	{
+		/* The partial results must be combined above the Append */
+		if (agg_costs->hasNonPartial || agg_costs->hasNonSerial)
+			return;
+
+		append_target = make_partial_grouping_target(root, target);
+
+		MemSet(&agg_partial_costs, 0, sizeof(AggClauseCosts));
+		MemSet(&agg_final_costs, 0, sizeof(AggClauseCosts));
+		if (parse->hasAggs)
+		{
+			get_agg_clause_costs(root, (Node *) append_target->exprs,
+								 AGGSPLIT_INITIAL_SERIAL,
+								 &agg_partial_costs);
+			get_agg_clause_costs(root, (Node *) target->exprs,
+								 AGGSPLIT_FINAL_DESERIAL,
+								 &agg_final_costs);
+			get_agg_clause_costs(root, (Node *) havingQual,
+								 AGGSPLIT_FINAL_DESERIAL,
+								 &agg_final_costs);
+		}
+		child_costs = &agg_partial_costs;
+	}
+
+	for (cnt_parts = 0; cnt_parts < input_rel->nparts; cnt_parts++)
+	{
+		RelOptInfo *child_rel = input_rel->part_rels[cnt_parts];
+		PathTarget *child_input_target;
+		PathTarget *child_target;
+		List	   *child_having = NIL;
+		double		child_groups;
+
+		/* Child joins are only built if partition-wise join succeeded */
+		if (child_rel == NULL)
+			return;
+
+		/* Dummy children will not be scanned, so ignore those. */
+		if (IS_DUMMY_REL(child_rel))
+			continue;
+
+		if (child_rel->cheapest_total_path == NULL)
+			return;
+
+		/* Translate the targets and the HAVING qual for this partition */
+		child_input_target = copy_pathtarget(input_target);
+		child_input_target->exprs = (List *)
+			adjust_appendrel_attrs_multilevel(root,
+											  (Node *) input_target->exprs,
+											  child_rel->relids,
+											  input_rel->relids);
+		child_target = copy_pathtarget(append_target);
+		child_target->exprs = (List *)
+			adjust_appendrel_attrs_multilevel(root,
+											  (Node *) append_target->exprs,
+											  child_rel->relids,
+											  input_rel->relids);
+		if (full_agg)
+			child_having = (List *)
+				adjust_appendrel_attrs_multilevel(root,
+												  (Node *) havingQual,
+												  child_rel->relids,
+												  input_rel->relids);
+
+		path = (Path *) create_projection_path(root, child_rel,
+											   child_rel->cheapest_total_path,
+											   child_input_target);
+
+		/*
+		 * Each group is in exactly one partition if we're aggregating them
+		 * completely; otherwise, assume a partition has as many groups as
+		 * its rows would have if they were the whole input.
+		 */
+		if (child_strategy == AGG_PLAIN)
+			child_groups = 1;
+		else if (full_agg)
+			child_groups = clamp_row_est(dNumGroups * path->rows /
+										 Max(input_rel->rows, 1.0));
+		else
+			child_groups = get_number_of_groups(root, path->rows, NULL);
+
+		if (child_strategy == AGG_HASHED &&
+			estimate_hashagg_tablesize(path, child_costs,
+									   child_groups) >= work_mem * 1024L)
+			return;
+
+		subpaths = lappend(subpaths, (Path *)
+						   create_agg_path(root,
+										   grouped_rel,
+										   path,
+										   child_target,
+										   child_strategy,
+										   full_agg ? AGGSPLIT_SIMPLE :
+										   AGGSPLIT_INITIAL_SERIAL,
+										   parse->groupClause,
+										   child_having,
+										   child_costs,
+										   child_groups));
+	}
+
+	if (subpaths == NIL)
+		return;
+
+	if (IS_SIMPLE_REL(input_rel))
+		partitioned_rels = get_partitioned_child_rels(root, input_rel->relid,
+													  NULL);
+	else
+		partitioned_rels = get_partitioned_child_rels_for_join(root,
+															   input_rel->relids);
+
+	path = (Path *) create_append_path(grouped_rel, subpaths, NIL, NULL,
+									   0, false, partitioned_rels, -1);
+	path->pathtarget = append_target;
+
+	if (full_agg)
+	{
+		add_path(grouped_rel, path);
+		return;
+	}
+
+	/* Finalize the aggregation on top of the Append */
+	if (parse->groupClause == NIL)
+	{
+		add_path(grouped_rel, (Path *)
+				 create_agg_path(root,
+								 grouped_rel,
+								 path,
+								 target,
+								 AGG_PLAIN,
+								 AGGSPLIT_FINAL_DESERIAL,
+								 NIL,
+								 havingQual,
+								 &agg_final_costs,
+								 dNumGroups));
+		return;
+	}
+
+	if (can_sort)
+		add_path(grouped_rel, (Path *)
+				 create_agg_path(root,
+								 grouped_rel,
+								 (Path *) create_sort_path(root,
+														   grouped_rel,
+														   path,
+														   root->group_pathkeys,
+														   -1.0),
+								 target,
+								 AGG_SORTED,
+								 AGGSPLIT_FINAL_DESERIAL,
+								 parse->groupClause,
+								 havingQual,
+								 &agg_final_costs,
+								 dNumGroups));
+
+	if (estimate_hashagg_tablesize(path, &agg_final_costs,
+								   dNumGroups) < work_mem * 1024L)
+		add_path(grouped_rel, (Path *)
+				 create_agg_path(root,
+								 grouped_rel,
+								 path,
+								 target,
+								 AGG_HASHED,
+								 AGGSPLIT_FINAL_DESERIAL,
+								 parse->groupClause,
+								 havingQual,
+								 &agg_final_costs,
+								 dNumGroups));
+}
+
+/*
+ * group_by_has_partkey
+ *
+ * Returns true if each of the input relation's partition keys is one of the
+ * grouping expressions, so that all the rows of a group are in the same
+ * partition.  Only the authentic partition key expressions count here; the
+ * nullable ones of an outer join may be NULL in rows of any partition.
+ */
+static bool
+group_by_has_partkey(PlannerInfo *root, RelOptInfo *input_rel)
+{
+	List	   *groupexprs;
+	int			cnt;
+
+	if (root->parse->groupClause == NIL)
+		return false;
+
+	groupexprs = get_sortgrouplist_exprs(root->parse->groupClause,
+										 root->processed_tlist);
+
+	for (cnt = 0; cnt < input_rel->part_scheme->partnatts; cnt++)
+	{
+		ListCell   *lc;
+		bool		found = false;
+
+		foreach(lc, input_rel->partexprs[cnt])
+		{
+			if (list_member(groupexprs, lfirst(lc)))
+			{
+				found = true;
+				break;
+			}
+		}
+		if (!found)
+			return false;
+	}
+
+	return true;
+}
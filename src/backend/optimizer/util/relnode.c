@@ -1600,6 +1600,8 @@ build_joinrel_partition_info(RelOptInfo *joinrel, RelOptInfo *outer_rel,
 	int			partnatts;
 	int			cnt;
 	PartitionScheme part_scheme;
+	PartitionBoundInfo boundinfo;
+	int			nparts;
 
 	/* Nothing to do if partition-wise join technique is disabled. */
 	if (!enable_partition_wise_join)
@@ -1633,18 +1635,39 @@ build_joinrel_partition_info(RelOptInfo *joinrel, RelOptInfo *outer_rel,
 		   REL_HAS_ALL_PART_PROPS(inner_rel));
 
 	/*
-	 * For now, our partition matching algorithm can match partitions only
-	 * when the partition bounds of the joining relations are exactly same.
-	 * So, bail out otherwise.
+	 * If the partition bounds of the joining relations are exactly same, so
+	 * are those of the join.  Otherwise, see if the partitions can still be
+	 * matched up one to one; if not, bail out.
 	 */
-	if (outer_rel->nparts != inner_rel->nparts ||
-		!partition_bounds_equal(part_scheme->partnatts,
-								part_scheme->parttyplen,
-								part_scheme->parttypbyval,
-								outer_rel->boundinfo, inner_rel->boundinfo))
+	if (outer_rel->nparts == inner_rel->nparts &&
+		partition_bounds_equal(part_scheme->partnatts,
+							   part_scheme->parttyplen,
+							   part_scheme->parttypbyval,
+							   outer_rel->boundinfo, inner_rel->boundinfo))
 	{
-		Assert(!IS_PARTITIONED_REL(joinrel));
-		return;
+		boundinfo = outer_rel->boundinfo;
+		nparts = outer_rel->nparts;
+	}
+	else
+	{
+		int		   *outer_parts;
+		int		   *inner_parts;
+
+		boundinfo = partition_bounds_merge(part_scheme->partnatts,
+										   part_scheme->partsupfunc,
+										   part_scheme->partcollation,
+										   outer_rel->boundinfo,
+										   outer_rel->nparts,
+										   inner_rel->boundinfo,
+										   inner_rel->nparts,
+										   jointype,
+										   &outer_parts, &inner_parts,
+										   &nparts);
+		if (boundinfo == NULL)
+		{
+			Assert(!IS_PARTITIONED_REL(joinrel));
+			return;
+		}
 	}
 
 	/*
@@ -1658,11 +1681,11 @@ build_joinrel_partition_info(RelOptInfo *joinrel, RelOptInfo *outer_rel,
 
 	/*
 	 * Join relation is partitioned using the same partitioning scheme as the
-	 * joining relations and has same bounds.
+	 * joining relations.
 	 */
 	joinrel->part_scheme = part_scheme;
-	joinrel->boundinfo = outer_rel->boundinfo;
-	joinrel->nparts = outer_rel->nparts;
+	joinrel->boundinfo = boundinfo;
+	joinrel->nparts = nparts;
 	partnatts = joinrel->part_scheme->partnatts;
 	joinrel->partexprs = (List **) palloc0(sizeof(List *) * partnatts);
 	joinrel->nullable_partexprs =
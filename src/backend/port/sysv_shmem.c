@@ -398,7 +398,7 @@ PGSharedMemoryIsInUse(unsigned long id1, unsigned long id2)
  * that support it, we might OR in additional bits to specify a particular
  * non-default huge page size.
  */
-static void
+void
 GetHugePageSize(Size *hugepagesize, int *mmap_flags)
 {
 	/*
@@ -95,6 +95,7 @@
 
 #include "access/transam.h"
 #include "access/xlog.h"
+#include "access/xlogredo.h"
 #include "bootstrap/bootstrap.h"
 #include "catalog/pg_control.h"
 #include "common/ip.h"
@@ -115,6 +116,7 @@
 #include "postmaster/syslogger.h"
 #include "replication/logicallauncher.h"
 #include "replication/walsender.h"
+#include "storage/aio.h"
 #include "storage/fd.h"
 #include "storage/ipc.h"
 #include "storage/pg_shmem.h"
@@ -973,6 +975,16 @@ PostmasterMain(int argc, char *argv[])
 	 */
 	ApplyLauncherRegister();
 
+	/*
+	 * Likewise, register the I/O workers if io_method needs them.
+	 */
+	AioPostmasterInit();
+
+	/*
+	 * And the redo workers, for parallel WAL replay.
+	 */
+	ParallelRedoRegisterWorkers();
+
 	/*
 	 * process any libraries that should be preloaded at postmaster start
 	 */
@@ -19,10 +19,13 @@
 #include "access/genam.h"
 #include "access/heapam.h"
 #include "access/htup_details.h"
+#include "access/tuptoaster.h"
 #include "catalog/indexing.h"
 #include "catalog/pg_collation.h"
 #include "catalog/pg_statistic_ext.h"
 #include "nodes/relation.h"
+#include "optimizer/clauses.h"
+#include "optimizer/cost.h"
 #include "postmaster/autovacuum.h"
 #include "statistics/extended_stats_internal.h"
 #include "statistics/statistics.h"
@@ -31,8 +34,16 @@
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
 #include "utils/rel.h"
+#include "utils/selfuncs.h"
 #include "utils/syscache.h"
+#include "utils/typcache.h"
 
+/*
+ * To avoid consuming too much memory during analysis and/or too much space
+ * in the resulting pg_statistic_ext rows, we ignore sampled rows containing
+ * varlena values wider than this (same threshold as in analyze.c).
+ */
+#define WIDTH_THRESHOLD  1024
 
 /*
  * Used internally to refer to an individual statistics object, i.e.,
@@ -53,7 +64,12 @@ static VacAttrStats **lookup_var_attr_stats(Relation rel, Bitmapset *attrs,
 					  int nvacatts, VacAttrStats **vacatts);
 static void statext_store(Relation pg_stext, Oid relid,
 			  MVNDistinct *ndistinct, MVDependencies *dependencies,
+			  MVMCVList *mcvlist, MVHistogram *histogram,
 			  VacAttrStats **stats);
+static bool statext_is_compatible_clause(Node *clause, Index relid,
+							 AttrNumber *attnum);
+static StatisticExtInfo *find_statistics_of_kind(List *stats, Oid statOid,
+						char requiredkind);
 
 
 /*
@@ -86,6 +102,9 @@ BuildRelationExtStatistics(Relation onerel, double totalrows,
 		StatExtEntry *stat = (StatExtEntry *) lfirst(lc);
 		MVNDistinct *ndistinct = NULL;
 		MVDependencies *dependencies = NULL;
+		MVMCVList  *mcvlist = NULL;
+		MVHistogram *histogram = NULL;
+		bool		build_histogram = false;
 		VacAttrStats **stats;
 		ListCell   *lc2;
 
@@ -123,10 +142,24 @@ BuildRelationExtStatistics(Relation onerel, double totalrows,
 			else if (t == STATS_EXT_DEPENDENCIES)
 				dependencies = statext_dependencies_build(numrows, rows,
 														  stat->columns, stats);
+			else if (t == STATS_EXT_MCV)
+				mcvlist = statext_mcv_build(numrows, rows, stat->columns,
+											stats, totalrows);
+			else if (t == STATS_EXT_HISTOGRAM)
+				build_histogram = true;
 		}
 
+		/*
+		 * The histogram only describes rows not already covered by the MCV
+		 * list, so it has to be built after the MCV list (if any).
+		 */
+		if (build_histogram)
+			histogram = statext_histogram_build(numrows, rows, stat->columns,
+												stats, mcvlist);
+
 		/* store the statistics in the catalog */
-		statext_store(pg_stext, stat->statOid, ndistinct, dependencies, stats);
+		statext_store(pg_stext, stat->statOid, ndistinct, dependencies,
+					  mcvlist, histogram, stats);
 	}
 
 	heap_close(pg_stext, RowExclusiveLock);
@@ -154,6 +187,14 @@ statext_is_kind_built(HeapTuple htup, char type)
 			attnum = Anum_pg_statistic_ext_stxdependencies;
 			break;
 
+		case STATS_EXT_MCV:
+			attnum = Anum_pg_statistic_ext_stxmcv;
+			break;
+
+		case STATS_EXT_HISTOGRAM:
+			attnum = Anum_pg_statistic_ext_stxhistogram;
+			break;
+
 		default:
 			elog(ERROR, "unexpected statistics type requested: %d", type);
 	}
@@ -218,7 +259,9 @@ fetch_statentries_for_relation(Relation pg_statext, Oid relid)
 		for (i = 0; i < ARR_DIMS(arr)[0]; i++)
 		{
 			Assert((enabled[i] == STATS_EXT_NDISTINCT) ||
-				   (enabled[i] == STATS_EXT_DEPENDENCIES));
+				   (enabled[i] == STATS_EXT_DEPENDENCIES) ||
+				   (enabled[i] == STATS_EXT_MCV) ||
+				   (enabled[i] == STATS_EXT_HISTOGRAM));
 			entry->types = lappend_int(entry->types, (int) enabled[i]);
 		}
 
@@ -293,6 +336,7 @@ lookup_var_attr_stats(Relation rel, Bitmapset *attrs,
 static void
 statext_store(Relation pg_stext, Oid statOid,
 			  MVNDistinct *ndistinct, MVDependencies *dependencies,
+			  MVMCVList *mcvlist, MVHistogram *histogram,
 			  VacAttrStats **stats)
 {
 	HeapTuple	stup,
@@ -324,9 +368,27 @@ statext_store(Relation pg_stext, Oid statOid,
 		values[Anum_pg_statistic_ext_stxdependencies - 1] = PointerGetDatum(data);
 	}
 
+	if (mcvlist != NULL)
+	{
+		bytea	   *data = statext_mcv_serialize(mcvlist, stats);
+
+		nulls[Anum_pg_statistic_ext_stxmcv - 1] = (data == NULL);
+		values[Anum_pg_statistic_ext_stxmcv - 1] = PointerGetDatum(data);
+	}
+
+	if (histogram != NULL)
+	{
+		bytea	   *data = statext_histogram_serialize(histogram, stats);
+
+		nulls[Anum_pg_statistic_ext_stxhistogram - 1] = (data == NULL);
+		values[Anum_pg_statistic_ext_stxhistogram - 1] = PointerGetDatum(data);
+	}
+
 	/* always replace the value (either by bytea or NULL) */
 	replaces[Anum_pg_statistic_ext_stxndistinct - 1] = true;
 	replaces[Anum_pg_statistic_ext_stxdependencies - 1] = true;
+	replaces[Anum_pg_statistic_ext_stxmcv - 1] = true;
+	replaces[Anum_pg_statistic_ext_stxhistogram - 1] = true;
 
 	/* there should already be a pg_statistic_ext tuple */
 	oldtup = SearchSysCache1(STATEXTOID, ObjectIdGetDatum(statOid));
@@ -433,6 +495,268 @@ multi_sort_compare_dims(int start, int end,
 	return 0;
 }
 
+/*
+ * build_attnums
+ *		Transform a bitmap into an array of attnums, so that accessing the
+ *		i-th member is easier.
+ */
+int *
+build_attnums(Bitmapset *attrs)
+{
+	int			i,
+				j;
+	int			numattrs = bms_num_members(attrs);
+	int		   *attnums;
+
+	attnums = (int *) palloc(sizeof(int) * numattrs);
+
+	i = 0;
+	j = -1;
+	while ((j = bms_next_member(attrs, j)) >= 0)
+		attnums[i++] = j;
+
+	return attnums;
+}
+
+/*
+ * build_multi_sort
+ *		Prepare sort support for all the columns of a statistics object,
+ *		using the default ordering operator of each column's data type.
+ */
+MultiSortSupport
+build_multi_sort(int numattrs, VacAttrStats **stats)
+{
+	int			i;
+	MultiSortSupport mss = multi_sort_init(numattrs);
+
+	for (i = 0; i < numattrs; i++)
+	{
+		TypeCacheEntry *type;
+
+		type = lookup_type_cache(stats[i]->attrtypid, TYPECACHE_LT_OPR);
+		if (type->lt_opr == InvalidOid) /* shouldn't happen */
+			elog(ERROR, "cache lookup failed for ordering operator for type %u",
+				 stats[i]->attrtypid);
+
+		multi_sort_add_dimension(mss, i, type->lt_opr);
+	}
+
+	return mss;
+}
+
+/*
+ * build_sorted_items
+ *		Build a sorted array of SortItem with values from the sampled rows.
+ *
+ * Rows containing varlena values wider than WIDTH_THRESHOLD are skipped, and
+ * the remaining varlena values are detoasted, so that the caller may copy
+ * them directly into the statistics.  The number of items actually built is
+ * returned in *nitems; the result is NULL when no rows remain.
+ */
+SortItem *
+build_sorted_items(int numrows, int *nitems, HeapTuple *rows, TupleDesc tdesc,
+				   MultiSortSupport mss, int numattrs, int *attnums)
+{
+	int			i,
+				j,
+				nrows;
+	int			nvalues = numrows * numattrs;
+	SortItem   *items;
+	Datum	   *values;
+	bool	   *isnull;
+	char	   *ptr;
+
+	/* Compute the total amount of memory we need (both items and values). */
+	Size		len = numrows * sizeof(SortItem) + nvalues * (sizeof(Datum) + sizeof(bool));
+
+	/* Allocate the memory and split it into the pieces. */
+	ptr = palloc0(len);
+
+	/* items to sort */
+	items = (SortItem *) ptr;
+	ptr += numrows * sizeof(SortItem);
+
+	/* values and null flags */
+	values = (Datum *) ptr;
+	ptr += nvalues * sizeof(Datum);
+
+	isnull = (bool *) ptr;
+	ptr += nvalues * sizeof(bool);
+
+	/* make sure we consumed the whole buffer exactly */
+	Assert((ptr - (char *) items) == len);
+
+	/* fix the pointers to Datum and bool arrays */
+	nrows = 0;
+	for (i = 0; i < numrows; i++)
+	{
+		bool		toowide = false;
+
+		items[nrows].values = &values[nrows * numattrs];
+		items[nrows].isnull = &isnull[nrows * numattrs];
+
+		/* load the values/null flags from sample rows */
+		for (j = 0; j < numattrs; j++)
+		{
+			Datum		value;
+			bool		isnull;
+			Form_pg_attribute attr = TupleDescAttr(tdesc, attnums[j] - 1);
+
+			value = heap_getattr(rows[i], attnums[j], tdesc, &isnull);
+
+			/* skip rows with overly wide values, detoast the others */
+			if (!isnull && attr->attlen == -1)
+			{
+				if (toast_raw_datum_size(value) > WIDTH_THRESHOLD)
+				{
+					toowide = true;
+					break;
+				}
+
+				value = PointerGetDatum(PG_DETOAST_DATUM(value));
+			}
+
+			items[nrows].values[j] = value;
+			items[nrows].isnull[j] = isnull;
+		}
+
+		if (toowide)
+			continue;
+
+		nrows++;
+	}
+
+	/* store the actual number of items (ignoring the too-wide ones) */
+	*nitems = nrows;
+
+	/* all rows were too wide */
+	if (nrows == 0)
+	{
+		pfree(items);
+		return NULL;
+	}
+
+	/* do the sort, using the multi-sort */
+	qsort_arg((void *) items, nrows, sizeof(SortItem),
+			  multi_sort_compare, mss);
+
+	return items;
+}
+
+/*
+ * statext_stattarget
+ *		Determine the statistics target for a statistics object, which is
+ *		the largest target of the columns it covers.
+ */
+int
+statext_stattarget(int numattrs, VacAttrStats **stats)
+{
+	int			i;
+	int			stattarget = 0;
+
+	for (i = 0; i < numattrs; i++)
+	{
+		if (stats[i]->attr->attstattarget > stattarget)
+			stattarget = stats[i]->attr->attstattarget;
+	}
+
+	return stattarget;
+}
+
+/*
+ * statext_datum_size
+ *		Number of bytes needed to store a datum in serialized statistics.
+ *
+ * Pass-by-value datums are stored as a whole Datum, pass-by-reference ones
+ * as their raw bytes (varlena values must not be toasted).
+ */
+Size
+statext_datum_size(Datum value, int16 typlen, bool typbyval)
+{
+	if (typbyval)
+		return sizeof(Datum);
+	else if (typlen > 0)
+		return typlen;
+	else if (typlen == -1)
+	{
+		Assert(!VARATT_IS_EXTERNAL(DatumGetPointer(value)) &&
+			   !VARATT_IS_COMPRESSED(DatumGetPointer(value)));
+		return VARSIZE_ANY(DatumGetPointer(value));
+	}
+	else if (typlen == -2)
+		return strlen(DatumGetCString(value)) + 1;
+
+	elog(ERROR, "unexpected typlen %d", typlen);
+	return 0;					/* keep compiler quiet */
+}
+
+/*
+ * statext_datum_write
+ *		Store a datum into serialized statistics, returning pointer to the
+ *		first byte after it.
+ */
+char *
+statext_datum_write(char *ptr, Datum value, int16 typlen, bool typbyval)
+{
+	Size		len = statext_datum_size(value, typlen, typbyval);
+
+	if (typbyval)
+		memcpy(ptr, &value, len);
+	else
+		memcpy(ptr, DatumGetPointer(value), len);
+
+	return ptr + len;
+}
+
+/*
+ * statext_datum_read
+ *		Read a datum stored by statext_datum_write, returning pointer to the
+ *		first byte after it.
+ *
+ * The serialized data is not aligned, so pass-by-reference values are copied
+ * into freshly palloc'd memory.
+ */
+char *
+statext_datum_read(char *ptr, Datum *value, int16 typlen, bool typbyval)
+{
+	Size		len;
+	char	   *copy;
+
+	if (typbyval)
+	{
+		memcpy(value, ptr, sizeof(Datum));
+		return ptr + sizeof(Datum);
+	}
+	else if (typlen > 0)
+		len = typlen;
+	else if (typlen == -1)
+	{
+		/* the varlena header is not aligned either, so copy it first */
+		if (VARATT_IS_1B(ptr))
+			len = VARSIZE_1B(ptr);
+		else
+		{
+			varattrib_4b hdr;
+
+			memcpy(&hdr, ptr, sizeof(varattrib_4b));
+			len = VARSIZE_4B(&hdr);
+		}
+	}
+	else if (typlen == -2)
+		len = strlen(ptr) + 1;
+	else
+	{
+		elog(ERROR, "unexpected typlen %d", typlen);
+		len = 0;				/* keep compiler quiet */
+	}
+
+	copy = palloc(len);
+	memcpy(copy, ptr, len);
+	*value = PointerGetDatum(copy);
+
+	return ptr + len;
+}
+
 /*
  * has_stats_of_kind
  *		Check whether the list contains statistic of a given kind
@@ -513,3 +837,342 @@ choose_best_statistics(List *stats, Bitmapset *attnums, char requiredkind)
 
 	return best_match;
 }
+
+/*
+ * find_statistics_of_kind
+ *		Look for statistics of the given kind, belonging to the same
+ *		statistics object.
+ */
+static StatisticExtInfo *
+find_statistics_of_kind(List *stats, Oid statOid, char requiredkind)
+{
+	ListCell   *lc;
+
+	foreach(lc, stats)
+	{
+		StatisticExtInfo *info = (StatisticExtInfo *) lfirst(lc);
+
+		if (info->statOid == statOid && info->kind == requiredkind)
+			return info;
+	}
+
+	return NULL;
+}
+
+/*
+ * examine_opclause_expression
+ *		Split an operator expression's arguments into Var and Const parts.
+ *
+ * Returns true when the expression has the form (Var op Const) or
+ * (Const op Var), with an optional RelabelType on top of the Var, and
+ * stores the pieces into the output arguments.
+ */
+bool
+examine_opclause_expression(OpExpr *expr, Var **varp, Const **cstp,
+							bool *varonleftp)
+{
+	Node	   *leftop,
+			   *rightop;
+
+	/* Only expressions with two arguments are candidates. */
+	if (list_length(expr->args) != 2)
+		return false;
+
+	leftop = linitial(expr->args);
+	rightop = lsecond(expr->args);
+
+	/*
+	 * We may ignore any RelabelType node above the operands.  (There won't be
+	 * more than one, since eval_const_expressions has been applied already.)
+	 */
+	if (IsA(leftop, RelabelType))
+		leftop = (Node *) ((RelabelType *) leftop)->arg;
+
+	if (IsA(rightop, RelabelType))
+		rightop = (Node *) ((RelabelType *) rightop)->arg;
+
+	if (IsA(leftop, Var) && IsA(rightop, Const))
+	{
+		*varp = (Var *) leftop;
+		*cstp = (Const *) rightop;
+		*varonleftp = true;
+	}
+	else if (IsA(leftop, Const) && IsA(rightop, Var))
+	{
+		*varp = (Var *) rightop;
+		*cstp = (Const *) leftop;
+		*varonleftp = false;
+	}
+	else
+		return false;
+
+	return true;
+}
+
+/*
+ * statext_is_compatible_clause
+ *		Determines if the clause is compatible with MCV lists and histograms
+ *
+ * Only clauses of the form (Var op Const) or (Const op Var), where the
+ * operator is an equality or inequality estimated by the usual selectivity
+ * functions, and (Var IS [NOT] NULL) are accepted.  The Var must be a plain
+ * user attribute of the specified relation, whose attribute number we return
+ * in *attnum on success.
+ */
+static bool
+statext_is_compatible_clause(Node *clause, Index relid, AttrNumber *attnum)
+{
+	RestrictInfo *rinfo = (RestrictInfo *) clause;
+	Var		   *var;
+
+	if (!IsA(rinfo, RestrictInfo))
+		return false;
+
+	/* Pseudoconstants are not interesting (they couldn't contain a Var) */
+	if (rinfo->pseudoconstant)
+		return false;
+
+	/* Clauses referencing multiple, or no, varnos are incompatible */
+	if (bms_membership(rinfo->clause_relids) != BMS_SINGLETON)
+		return false;
+
+	if (is_opclause(rinfo->clause))
+	{
+		OpExpr	   *expr = (OpExpr *) rinfo->clause;
+		Const	   *cst;
+		bool		varonleft;
+
+		if (!examine_opclause_expression(expr, &var, &cst, &varonleft))
+			return false;
+
+		/* NULL constants are handled just fine by the regular estimates */
+		if (cst->constisnull)
+			return false;
+
+		/*
+		 * Only equality and inequality operators are supported.  As in
+		 * dependencies.c we look at the selectivity estimator rather than the
+		 * operator itself.
+		 */
+		switch (get_oprrest(expr->opno))
+		{
+			case F_EQSEL:
+			case F_SCALARLTSEL:
+			case F_SCALARLESEL:
+			case F_SCALARGTSEL:
+			case F_SCALARGESEL:
+				break;
+
+			default:
+				return false;
+		}
+	}
+	else if (IsA(rinfo->clause, NullTest))
+	{
+		NullTest   *nt = (NullTest *) rinfo->clause;
+
+		/* row-wise NULL tests are not supported */
+		if (nt->argisrow)
+			return false;
+
+		var = (Var *) nt->arg;
+
+		if (IsA(var, RelabelType))
+			var = (Var *) ((RelabelType *) var)->arg;
+	}
+	else
+		return false;
+
+	/* We only support plain Vars for now */
+	if (!IsA(var, Var))
+		return false;
+
+	/* Ensure Var is from the correct relation */
+	if (var->varno != relid)
+		return false;
+
+	/* We also better ensure the Var is from the current level */
+	if (var->varlevelsup != 0)
+		return false;
+
+	/* Also ignore system attributes (we don't allow stats on those) */
+	if (!AttrNumberIsForUserDefinedAttr(var->varattno))
+		return false;
+
+	*attnum = var->varattno;
+	return true;
+}
+
+/*
+ * statext_clauselist_selectivity
+ *		Estimate clauses using the best multi-column MCV list and/or histogram.
+ *
+ * Returns the combined selectivity of the clauses estimated this way, or 1.0
+ * if no suitable statistics exist.  The (zero-based) list positions of the
+ * estimated clauses are added to *estimatedclauses, and clauses already
+ * present in that set are skipped.
+ *
+ * The statistics object covering the most attributes referenced by
+ * compatible clauses is chosen.  The MCV list estimates the fraction of rows
+ * matching the most common combinations exactly.  If the object also has a
+ * histogram, that describes all the remaining rows, so the two estimates are
+ * simply added.  Otherwise the remaining fraction is estimated from the
+ * per-column statistics, using the "base" frequencies of the MCV items
+ * (computed as if the columns were independent) to correct for the part
+ * already covered by the MCV list:
+ *
+ *	   P = mcv_sel + clamp(simple_sel - mcv_basesel, 0, 1 - mcv_totalsel)
+ */
+Selectivity
+statext_clauselist_selectivity(PlannerInfo *root, List *clauses, int varRelid,
+							   JoinType jointype, SpecialJoinInfo *sjinfo,
+							   RelOptInfo *rel, Bitmapset **estimatedclauses)
+{
+	ListCell   *l;
+	Bitmapset  *clauses_attnums = NULL;
+	StatisticExtInfo *stat;
+	StatisticExtInfo *mcvstat = NULL;
+	StatisticExtInfo *histstat = NULL;
+	AttrNumber *list_attnums;
+	List	   *stat_clauses = NIL;
+	List	   *stat_rinfos = NIL;
+	int			listidx;
+	Selectivity sel;
+
+	/* check if there's any stats that might be useful for us. */
+	if (!has_stats_of_kind(rel->statlist, STATS_EXT_MCV) &&
+		!has_stats_of_kind(rel->statlist, STATS_EXT_HISTOGRAM))
+		return 1.0;
+
+	list_attnums = (AttrNumber *) palloc(sizeof(AttrNumber) *
+										 list_length(clauses));
+
+	/*
+	 * Pre-process the clauses list to extract the attnums seen in each item,
+	 * the same way dependencies_clauselist_selectivity does it.
+	 */
+	listidx = 0;
+	foreach(l, clauses)
+	{
+		Node	   *clause = (Node *) lfirst(l);
+		AttrNumber	attnum;
+
+		if (!bms_is_member(listidx, *estimatedclauses) &&
+			statext_is_compatible_clause(clause, rel->relid, &attnum))
+		{
+			list_attnums[listidx] = attnum;
+			clauses_attnums = bms_add_member(clauses_attnums, attnum);
+		}
+		else
+			list_attnums[listidx] = InvalidAttrNumber;
+
+		listidx++;
+	}
+
+	/* We need at least two attributes for multivariate statistics. */
+	if (bms_num_members(clauses_attnums) < 2)
+	{
+		pfree(list_attnums);
+		return 1.0;
+	}
+
+	/*
+	 * Find the best suited statistics object for these attnums, preferring
+	 * MCV lists when a histogram does not cover more attributes.
+	 */
+	mcvstat = choose_best_statistics(rel->statlist, clauses_attnums,
+									 STATS_EXT_MCV);
+	histstat = choose_best_statistics(rel->statlist, clauses_attnums,
+									  STATS_EXT_HISTOGRAM);
+
+	if (mcvstat && histstat)
+	{
+		int			nmcv = bms_num_members(bms_intersect(mcvstat->keys,
+														 clauses_attnums));
+		int			nhist = bms_num_members(bms_intersect(histstat->keys,
+														  clauses_attnums));
+
+		if (nhist > nmcv)
+			mcvstat = NULL;
+	}
+
+	stat = (mcvstat != NULL) ? mcvstat : histstat;
+
+	/* if no matching stats could be found then we've nothing to do */
+	if (!stat)
+	{
+		pfree(list_attnums);
+		return 1.0;
+	}
+
+	/* use the other kind of statistics from the same object, if built */
+	if (stat->kind == STATS_EXT_MCV)
+		histstat = find_statistics_of_kind(rel->statlist, stat->statOid,
+										   STATS_EXT_HISTOGRAM);
+	else
+		mcvstat = find_statistics_of_kind(rel->statlist, stat->statOid,
+										  STATS_EXT_MCV);
+
+	/* now collect the clauses covered by the statistics object */
+	listidx = -1;
+	foreach(l, clauses)
+	{
+		RestrictInfo *rinfo = (RestrictInfo *) lfirst(l);
+
+		listidx++;
+
+		if (list_attnums[listidx] == InvalidAttrNumber ||
+			!bms_is_member(list_attnums[listidx], stat->keys))
+			continue;
+
+		stat_clauses = lappend(stat_clauses, rinfo->clause);
+		stat_rinfos = lappend(stat_rinfos, rinfo);
+
+		*estimatedclauses = bms_add_member(*estimatedclauses, listidx);
+	}
+
+	if (mcvstat != NULL && histstat != NULL)
+	{
+		Selectivity mcv_basesel,
+					mcv_totalsel;
+
+		/* the histogram describes exactly the rows not in the MCV list */
+		sel = mcv_clauselist_selectivity(root, mcvstat, stat_clauses,
+										 &mcv_basesel, &mcv_totalsel);
+		sel += histogram_clauselist_selectivity(root, histstat, stat_clauses);
+	}
+	else if (mcvstat != NULL)
+	{
+		Selectivity mcv_sel,
+					mcv_basesel,
+					mcv_totalsel,
+					simple_sel,
+					other_sel;
+
+		mcv_sel = mcv_clauselist_selectivity(root, mcvstat, stat_clauses,
+											 &mcv_basesel, &mcv_totalsel);
+
+		/* estimate of the remaining rows, assuming independence */
+		simple_sel = clauselist_selectivity_simple(root, stat_rinfos, varRelid,
+												   jointype, sjinfo, NULL);
+
+		other_sel = simple_sel - mcv_basesel;
+
+		if (other_sel > 1.0 - mcv_totalsel)
+			other_sel = 1.0 - mcv_totalsel;
+
+		CLAMP_PROBABILITY(other_sel);
+
+		sel = mcv_sel + other_sel;
+	}
+	else
+		sel = histogram_clauselist_selectivity(root, histstat, stat_clauses);
+
+	CLAMP_PROBABILITY(sel);
+
+	list_free(stat_clauses);
+	list_free(stat_rinfos);
+	pfree(list_attnums);
+
+	return sel;
+}
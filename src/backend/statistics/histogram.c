@@ -0,0 +1,987 @@
+/*-------------------------------------------------------------------------
+ *
+ * histogram.c
+ *	  POSTGRES multivariate histograms
+ *
+ * A multivariate histogram splits the space of values of the columns
+ * covered by the statistics object into buckets - hyper-rectangles with
+ * (roughly) the same number of sampled rows.  The buckets are built by
+ * recursive partitioning: we start with a single bucket containing all the
+ * sampled rows, and repeatedly split the largest bucket at the median of
+ * the dimension with the most distinct values, until we reach the maximum
+ * number of buckets or no bucket can be split any further.  Before that,
+ * buckets are split so that each dimension of each bucket contains either
+ * only NULL values or only non-NULL values.
+ *
+ * When the statistics object also contains a MCV list, the histogram is
+ * built only from rows not matching any of the MCV items, so that the two
+ * statistics complement each other.  The bucket frequencies are always
+ * relative to the whole sample.
+ *
+ * When estimating selectivity, each bucket is matched against the clauses,
+ * determining what fraction of the bucket satisfies them.  Within a bucket
+ * we assume uniform distribution and independence of the dimensions.
+ *
+ *
+ * Portions Copyright (c) 1996-2018, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  src/backend/statistics/histogram.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/htup_details.h"
+#include "access/nbtree.h"
+#include "catalog/pg_statistic_ext.h"
+#include "fmgr.h"
+#include "optimizer/clauses.h"
+#include "statistics/extended_stats_internal.h"
+#include "statistics/statistics.h"
+#include "utils/bytea.h"
+#include "utils/datum.h"
+#include "utils/fmgroids.h"
+#include "utils/fmgrprotos.h"
+#include "utils/lsyscache.h"
+#include "utils/syscache.h"
+#include "utils/typcache.h"
+
+/* minimum number of sampled rows in a bucket we're willing to split */
+#define HIST_MIN_BUCKET_ROWS	10
+
+/* fraction of a bucket assumed to match a range clause partially */
+#define HIST_PARTIAL_MATCH		0.5
+
+/*
+ * Bucket being built - a contiguous range of the sampled items.
+ */
+typedef struct HistogramBuildBucket
+{
+	int			start;			/* first item of the bucket */
+	int			nitems;			/* number of items in the bucket */
+	bool		splittable;		/* may the bucket be split further? */
+} HistogramBuildBucket;
+
+/* Internal state for sorting the items by a single dimension. */
+typedef struct DimensionSortContext
+{
+	MultiSortSupport mss;		/* sort support for all dimensions */
+	int			dim;			/* dimension to sort by */
+} DimensionSortContext;
+
+static SortItem *remove_mcv_items(SortItem *items, int *nitems,
+				 MVMCVList *mcvlist, MultiSortSupport mss);
+static void sort_bucket_dimension(SortItem *items, HistogramBuildBucket *bucket,
+					  int dim, MultiSortSupport mss);
+static int	count_bucket_distinct(SortItem *items, HistogramBuildBucket *bucket,
+					  int dim, MultiSortSupport mss);
+static int	partition_bucket_nulls(SortItem *items, HistogramBuildBucket *bucket,
+					   int dim);
+static bool split_bucket(SortItem *items, HistogramBuildBucket *bucket,
+			 HistogramBuildBucket *newbucket, int ndims,
+			 MultiSortSupport mss);
+static int	compare_sort_item_dim(const void *a, const void *b, void *arg);
+static double bucket_clause_fraction(MVBucket *bucket, int idx,
+					   OpExpr *expr, Var *var, Const *cst,
+					   bool varonleft, FmgrInfo *opproc);
+
+
+/*
+ * statext_histogram_build
+ *		Build a multivariate histogram from the sampled rows.
+ *
+ * If a MCV list is supplied, the rows matching its items are not included
+ * in the histogram.  Returns NULL if there are no rows left.
+ */
+MVHistogram *
+statext_histogram_build(int numrows, HeapTuple *rows, Bitmapset *attrs,
+						VacAttrStats **stats, MVMCVList *mcvlist)
+{
+	int			i,
+				j;
+	int			numattrs = bms_num_members(attrs);
+	int			nitems;
+	int			nbuckets;
+	int			maxbuckets;
+	int			allocated;
+	int		   *attnums = build_attnums(attrs);
+	MultiSortSupport mss = build_multi_sort(numattrs, stats);
+	SortItem   *items;
+	HistogramBuildBucket *buckets;
+	MVHistogram *histogram;
+
+	/* sort the rows, ignoring the too-wide ones */
+	items = build_sorted_items(numrows, &nitems, rows, stats[0]->tupDesc,
+							   mss, numattrs, attnums);
+
+	if (!items)
+		return NULL;
+
+	/* ignore rows represented by the MCV list */
+	if (mcvlist != NULL)
+		items = remove_mcv_items(items, &nitems, mcvlist, mss);
+
+	if (!items)
+		return NULL;
+
+	/* maximum number of buckets, based on the statistics target */
+	maxbuckets = Min(10 * statext_stattarget(numattrs, stats),
+					 STATS_HIST_MAX_BUCKETS);
+
+	/* start with a single bucket containing all the items */
+	allocated = 32;
+	buckets = (HistogramBuildBucket *)
+		palloc(allocated * sizeof(HistogramBuildBucket));
+
+	buckets[0].start = 0;
+	buckets[0].nitems = nitems;
+	buckets[0].splittable = true;
+	nbuckets = 1;
+
+	/*
+	 * Separate NULL and non-NULL values in all dimensions first, so that each
+	 * dimension of each bucket is either NULL-only or without NULLs.  This
+	 * may exceed the maximum number of buckets, but that's bounded by the
+	 * number of dimensions.
+	 */
+	for (j = 0; j < numattrs; j++)
+	{
+		int			n = nbuckets;
+
+		for (i = 0; i < n; i++)
+		{
+			int			nnonnull = partition_bucket_nulls(items, &buckets[i], j);
+
+			/* nothing to split - all values NULL or non-NULL */
+			if (nnonnull == 0 || nnonnull == buckets[i].nitems)
+				continue;
+
+			if (nbuckets == allocated)
+			{
+				allocated *= 2;
+				buckets = (HistogramBuildBucket *)
+					repalloc(buckets, allocated * sizeof(HistogramBuildBucket));
+			}
+
+			buckets[nbuckets].start = buckets[i].start + nnonnull;
+			buckets[nbuckets].nitems = buckets[i].nitems - nnonnull;
+			buckets[nbuckets].splittable = true;
+			buckets[i].nitems = nnonnull;
+			nbuckets++;
+		}
+	}
+
+	/* now keep splitting the largest bucket, while possible */
+	while (nbuckets < maxbuckets)
+	{
+		HistogramBuildBucket *bucket = NULL;
+
+		for (i = 0; i < nbuckets; i++)
+		{
+			if (!buckets[i].splittable)
+				continue;
+
+			if (buckets[i].nitems < 2 * HIST_MIN_BUCKET_ROWS)
+			{
+				buckets[i].splittable = false;
+				continue;
+			}
+
+			if (bucket == NULL || buckets[i].nitems > bucket->nitems)
+				bucket = &buckets[i];
+		}
+
+		/* no bucket can be split any further */
+		if (bucket == NULL)
+			break;
+
+		if (nbuckets == allocated)
+		{
+			int			idx = bucket - buckets;
+
+			allocated *= 2;
+			buckets = (HistogramBuildBucket *)
+				repalloc(buckets, allocated * sizeof(HistogramBuildBucket));
+			bucket = &buckets[idx];
+		}
+
+		if (split_bucket(items, bucket, &buckets[nbuckets], numattrs, mss))
+			nbuckets++;
+		else
+			bucket->splittable = false;
+	}
+
+	/* build the histogram from the buckets */
+	histogram = (MVHistogram *) palloc0(sizeof(MVHistogram));
+
+	histogram->magic = STATS_HIST_MAGIC;
+	histogram->type = STATS_HIST_TYPE_BASIC;
+	histogram->nbuckets = nbuckets;
+	histogram->ndimensions = numattrs;
+
+	for (j = 0; j < numattrs; j++)
+		histogram->types[j] = stats[j]->attrtypid;
+
+	histogram->buckets = (MVBucket **) palloc(nbuckets * sizeof(MVBucket *));
+
+	for (i = 0; i < nbuckets; i++)
+	{
+		HistogramBuildBucket *b = &buckets[i];
+		MVBucket   *bucket = (MVBucket *) palloc0(sizeof(MVBucket));
+
+		bucket->nullsonly = (bool *) palloc0(numattrs * sizeof(bool));
+		bucket->ndistinct = (uint32 *) palloc0(numattrs * sizeof(uint32));
+		bucket->min = (Datum *) palloc0(numattrs * sizeof(Datum));
+		bucket->max = (Datum *) palloc0(numattrs * sizeof(Datum));
+
+		/* frequency relative to the whole sample (including MCV items) */
+		bucket->frequency = (double) b->nitems / numrows;
+
+		for (j = 0; j < numattrs; j++)
+		{
+			SortItem   *first;
+			SortItem   *last;
+
+			/* NULLs were separated first, so checking one item is enough */
+			if (items[b->start].isnull[j])
+			{
+				bucket->nullsonly[j] = true;
+				continue;
+			}
+
+			sort_bucket_dimension(items, b, j, mss);
+
+			first = &items[b->start];
+			last = &items[b->start + b->nitems - 1];
+
+			bucket->ndistinct[j] = count_bucket_distinct(items, b, j, mss);
+			bucket->min[j] = datumCopy(first->values[j],
+									   stats[j]->attrtype->typbyval,
+									   stats[j]->attrtype->typlen);
+			bucket->max[j] = datumCopy(last->values[j],
+									   stats[j]->attrtype->typbyval,
+									   stats[j]->attrtype->typlen);
+		}
+
+		histogram->buckets[i] = bucket;
+	}
+
+	pfree(buckets);
+	pfree(items);
+
+	return histogram;
+}
+
+/*
+ * remove_mcv_items
+ *		Remove items matching any of the MCV list items.
+ *
+ * Both the items and the MCV list items are sorted using the multi-sort
+ * support, so that we can do this in a single merge pass.  Returns NULL
+ * (and frees the items) if no items remain.
+ */
+static SortItem *
+remove_mcv_items(SortItem *items, int *nitems, MVMCVList *mcvlist,
+				 MultiSortSupport mss)
+{
+	int			i,
+				j,
+				n;
+	SortItem   *mcvitems;
+
+	mcvitems = (SortItem *) palloc(mcvlist->nitems * sizeof(SortItem));
+
+	for (i = 0; i < mcvlist->nitems; i++)
+	{
+		mcvitems[i].values = mcvlist->items[i]->values;
+		mcvitems[i].isnull = mcvlist->items[i]->isnull;
+	}
+
+	qsort_arg((void *) mcvitems, mcvlist->nitems, sizeof(SortItem),
+			  multi_sort_compare, mss);
+
+	n = 0;
+	j = 0;
+	for (i = 0; i < *nitems; i++)
+	{
+		int			cmp = -1;
+
+		/* skip MCV items smaller than the current item */
+		while (j < mcvlist->nitems &&
+			   (cmp = multi_sort_compare(&mcvitems[j], &items[i], mss)) < 0)
+			j++;
+
+		/* matches a MCV item, so ignore it */
+		if (j < mcvlist->nitems && cmp == 0)
+			continue;
+
+		items[n++] = items[i];
+	}
+
+	pfree(mcvitems);
+
+	*nitems = n;
+
+	if (n == 0)
+	{
+		pfree(items);
+		return NULL;
+	}
+
+	return items;
+}
+
+/* compare sort items by a single dimension */
+static int
+compare_sort_item_dim(const void *a, const void *b, void *arg)
+{
+	DimensionSortContext *cxt = (DimensionSortContext *) arg;
+
+	return multi_sort_compare_dim(cxt->dim, (const SortItem *) a,
+								  (const SortItem *) b, cxt->mss);
+}
+
+/* sort items of a bucket by the given dimension */
+static void
+sort_bucket_dimension(SortItem *items, HistogramBuildBucket *bucket, int dim,
+					  MultiSortSupport mss)
+{
+	DimensionSortContext cxt;
+
+	cxt.mss = mss;
+	cxt.dim = dim;
+
+	qsort_arg((void *) &items[bucket->start], bucket->nitems,
+			  sizeof(SortItem), compare_sort_item_dim, &cxt);
+}
+
+/*
+ * count_bucket_distinct
+ *		Count distinct values in a dimension of a bucket.
+ *
+ * The items of the bucket have to be sorted by the dimension.
+ */
+static int
+count_bucket_distinct(SortItem *items, HistogramBuildBucket *bucket, int dim,
+					  MultiSortSupport mss)
+{
+	int			i;
+	int			ndistinct = 1;
+
+	for (i = bucket->start + 1; i < bucket->start + bucket->nitems; i++)
+	{
+		if (multi_sort_compare_dim(dim, &items[i - 1], &items[i], mss) != 0)
+			ndistinct++;
+	}
+
+	return ndistinct;
+}
+
+/*
+ * partition_bucket_nulls
+ *		Move items with non-NULL value in the dimension to the beginning of
+ *		the bucket, and return the number of such items.
+ */
+static int
+partition_bucket_nulls(SortItem *items, HistogramBuildBucket *bucket, int dim)
+{
+	int			i;
+	int			nnonnull = 0;
+
+	for (i = bucket->start; i < bucket->start + bucket->nitems; i++)
+	{
+		if (!items[i].isnull[dim])
+		{
+			SortItem	tmp = items[bucket->start + nnonnull];
+
+			items[bucket->start + nnonnull] = items[i];
+			items[i] = tmp;
+			nnonnull++;
+		}
+	}
+
+	return nnonnull;
+}
+
+/*
+ * split_bucket
+ *		Split the bucket on the dimension with the most distinct values.
+ *
+ * The bucket is split at the value boundary closest to the median, so that
+ * each value ends up in exactly one of the new buckets.  The upper part is
+ * stored into newbucket.  Returns false if the bucket can't be split (all
+ * dimensions have a single distinct value, or contain only NULLs).
+ */
+static bool
+split_bucket(SortItem *items, HistogramBuildBucket *bucket,
+			 HistogramBuildBucket *newbucket, int ndims, MultiSortSupport mss)
+{
+	int			i;
+	int			dim = -1;
+	int			ndistinct = 1;
+	int			start = bucket->start;
+	int			end = bucket->start + bucket->nitems;
+	int			mid = start + bucket->nitems / 2;
+	int			lower,
+				upper,
+				split;
+
+	/* find the dimension with the most distinct values */
+	for (i = 0; i < ndims; i++)
+	{
+		int			n;
+
+		/* NULL-only dimensions can't be split */
+		if (items[start].isnull[i])
+			continue;
+
+		sort_bucket_dimension(items, bucket, i, mss);
+		n = count_bucket_distinct(items, bucket, i, mss);
+
+		if (n > ndistinct)
+		{
+			ndistinct = n;
+			dim = i;
+		}
+	}
+
+	if (dim < 0)
+		return false;
+
+	sort_bucket_dimension(items, bucket, dim, mss);
+
+	/* find the closest value boundaries below and above the median */
+	lower = mid;
+	while (lower > start + 1 &&
+		   multi_sort_compare_dim(dim, &items[lower - 1], &items[lower], mss) == 0)
+		lower--;
+
+	upper = mid;
+	while (upper < end &&
+		   multi_sort_compare_dim(dim, &items[upper - 1], &items[upper], mss) == 0)
+		upper++;
+
+	/* we know there are at least two distinct values, so one has to work */
+	if (lower > start &&
+		multi_sort_compare_dim(dim, &items[lower - 1], &items[lower], mss) != 0 &&
+		(upper >= end || (mid - lower) <= (upper - mid)))
+		split = lower;
+	else
+		split = upper;
+
+	Assert(split > start && split < end);
+
+	newbucket->start = split;
+	newbucket->nitems = end - split;
+	newbucket->splittable = true;
+
+	bucket->nitems = split - start;
+
+	return true;
+}
+
+/*
+ * statext_histogram_load
+ *		Load the histogram for the indicated pg_statistic_ext tuple
+ */
+MVHistogram *
+statext_histogram_load(Oid mvoid)
+{
+	bool		isnull;
+	Datum		histogram;
+	HeapTuple	htup = SearchSysCache1(STATEXTOID, ObjectIdGetDatum(mvoid));
+
+	if (!HeapTupleIsValid(htup))
+		elog(ERROR, "cache lookup failed for statistics object %u", mvoid);
+
+	histogram = SysCacheGetAttr(STATEXTOID, htup,
+								Anum_pg_statistic_ext_stxhistogram, &isnull);
+	Assert(!isnull);
+
+	ReleaseSysCache(htup);
+
+	return statext_histogram_deserialize(DatumGetByteaP(histogram));
+}
+
+/*
+ * statext_histogram_serialize
+ *		Serialize the histogram into a bytea value.
+ *
+ * After the header (magic, type, number of buckets, number of dimensions
+ * and data types of the dimensions) each bucket is stored as the frequency,
+ * followed by the NULL-only flag and the number of distinct values for
+ * each dimension, and the boundary values of the non-NULL dimensions.
+ */
+bytea *
+statext_histogram_serialize(MVHistogram *histogram, VacAttrStats **stats)
+{
+	int			i,
+				j;
+	int			ndims = histogram->ndimensions;
+	Size		len;
+	bytea	   *output;
+	char	   *ptr;
+
+	/* header */
+	len = VARHDRSZ + 3 * sizeof(uint32) + sizeof(AttrNumber)
+		+ ndims * sizeof(Oid);
+
+	for (i = 0; i < histogram->nbuckets; i++)
+	{
+		MVBucket   *bucket = histogram->buckets[i];
+
+		len += sizeof(double) + ndims * (sizeof(bool) + sizeof(uint32));
+
+		for (j = 0; j < ndims; j++)
+		{
+			if (bucket->nullsonly[j])
+				continue;
+
+			len += statext_datum_size(bucket->min[j],
+									  stats[j]->attrtype->typlen,
+									  stats[j]->attrtype->typbyval);
+			len += statext_datum_size(bucket->max[j],
+									  stats[j]->attrtype->typlen,
+									  stats[j]->attrtype->typbyval);
+		}
+	}
+
+	output = (bytea *) palloc0(len);
+	SET_VARSIZE(output, len);
+
+	ptr = VARDATA(output);
+
+	memcpy(ptr, &histogram->magic, sizeof(uint32));
+	ptr += sizeof(uint32);
+	memcpy(ptr, &histogram->type, sizeof(uint32));
+	ptr += sizeof(uint32);
+	memcpy(ptr, &histogram->nbuckets, sizeof(uint32));
+	ptr += sizeof(uint32);
+	memcpy(ptr, &histogram->ndimensions, sizeof(AttrNumber));
+	ptr += sizeof(AttrNumber);
+	memcpy(ptr, histogram->types, ndims * sizeof(Oid));
+	ptr += ndims * sizeof(Oid);
+
+	for (i = 0; i < histogram->nbuckets; i++)
+	{
+		MVBucket   *bucket = histogram->buckets[i];
+
+		memcpy(ptr, &bucket->frequency, sizeof(double));
+		ptr += sizeof(double);
+		memcpy(ptr, bucket->nullsonly, ndims * sizeof(bool));
+		ptr += ndims * sizeof(bool);
+		memcpy(ptr, bucket->ndistinct, ndims * sizeof(uint32));
+		ptr += ndims * sizeof(uint32);
+
+		for (j = 0; j < ndims; j++)
+		{
+			if (bucket->nullsonly[j])
+				continue;
+
+			ptr = statext_datum_write(ptr, bucket->min[j],
+									  stats[j]->attrtype->typlen,
+									  stats[j]->attrtype->typbyval);
+			ptr = statext_datum_write(ptr, bucket->max[j],
+									  stats[j]->attrtype->typlen,
+									  stats[j]->attrtype->typbyval);
+		}
+
+		Assert(ptr <= ((char *) output + len));
+	}
+
+	/* we should have filled the whole bytea exactly */
+	Assert(ptr == ((char *) output + len));
+
+	return output;
+}
+
+/*
+ * statext_histogram_deserialize
+ *		Reads serialized histogram into MVHistogram structure.
+ */
+MVHistogram *
+statext_histogram_deserialize(bytea *data)
+{
+	int			i,
+				j;
+	Size		min_expected_size;
+	MVHistogram *histogram;
+	int16		typlen[STATS_MAX_DIMENSIONS];
+	bool		typbyval[STATS_MAX_DIMENSIONS];
+	char	   *ptr;
+	char	   *end;
+
+	if (data == NULL)
+		return NULL;
+
+	/* minimum size of the header (up to the data types) */
+	min_expected_size = 3 * sizeof(uint32) + sizeof(AttrNumber);
+
+	if (VARSIZE_ANY_EXHDR(data) < min_expected_size)
+		elog(ERROR, "invalid histogram size %zd (expected at least %zd)",
+			 VARSIZE_ANY_EXHDR(data), min_expected_size);
+
+	histogram = (MVHistogram *) palloc0(sizeof(MVHistogram));
+
+	ptr = VARDATA_ANY(data);
+	end = (char *) data + VARSIZE_ANY(data);
+
+	memcpy(&histogram->magic, ptr, sizeof(uint32));
+	ptr += sizeof(uint32);
+	memcpy(&histogram->type, ptr, sizeof(uint32));
+	ptr += sizeof(uint32);
+	memcpy(&histogram->nbuckets, ptr, sizeof(uint32));
+	ptr += sizeof(uint32);
+	memcpy(&histogram->ndimensions, ptr, sizeof(AttrNumber));
+	ptr += sizeof(AttrNumber);
+
+	if (histogram->magic != STATS_HIST_MAGIC)
+		elog(ERROR, "invalid histogram magic %u (expected %u)",
+			 histogram->magic, STATS_HIST_MAGIC);
+
+	if (histogram->type != STATS_HIST_TYPE_BASIC)
+		elog(ERROR, "invalid histogram type %u (expected %u)",
+			 histogram->type, STATS_HIST_TYPE_BASIC);
+
+	if (histogram->nbuckets == 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg("invalid zero-length bucket array in MVHistogram")));
+
+	if ((histogram->ndimensions < 2) ||
+		(histogram->ndimensions > STATS_MAX_DIMENSIONS))
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg("invalid number of dimensions %d in MVHistogram",
+						histogram->ndimensions)));
+
+	min_expected_size += histogram->ndimensions * sizeof(Oid) +
+		histogram->nbuckets * (sizeof(double) +
+							   histogram->ndimensions * (sizeof(bool) +
+														 sizeof(uint32)));
+
+	if (VARSIZE_ANY_EXHDR(data) < min_expected_size)
+		elog(ERROR, "invalid histogram size %zd (expected at least %zd)",
+			 VARSIZE_ANY_EXHDR(data), min_expected_size);
+
+	memcpy(histogram->types, ptr, histogram->ndimensions * sizeof(Oid));
+	ptr += histogram->ndimensions * sizeof(Oid);
+
+	for (j = 0; j < histogram->ndimensions; j++)
+		get_typlenbyval(histogram->types[j], &typlen[j], &typbyval[j]);
+
+	histogram->buckets = (MVBucket **) palloc(histogram->nbuckets *
+											  sizeof(MVBucket *));
+
+	for (i = 0; i < histogram->nbuckets; i++)
+	{
+		int			ndims = histogram->ndimensions;
+		MVBucket   *bucket = (MVBucket *) palloc0(sizeof(MVBucket));
+
+		bucket->nullsonly = (bool *) palloc(ndims * sizeof(bool));
+		bucket->ndistinct = (uint32 *) palloc(ndims * sizeof(uint32));
+		bucket->min = (Datum *) palloc0(ndims * sizeof(Datum));
+		bucket->max = (Datum *) palloc0(ndims * sizeof(Datum));
+
+		memcpy(&bucket->frequency, ptr, sizeof(double));
+		ptr += sizeof(double);
+		memcpy(bucket->nullsonly, ptr, ndims * sizeof(bool));
+		ptr += ndims * sizeof(bool);
+		memcpy(bucket->ndistinct, ptr, ndims * sizeof(uint32));
+		ptr += ndims * sizeof(uint32);
+
+		for (j = 0; j < ndims; j++)
+		{
+			if (bucket->nullsonly[j])
+				continue;
+
+			ptr = statext_datum_read(ptr, &bucket->min[j],
+									 typlen[j], typbyval[j]);
+			ptr = statext_datum_read(ptr, &bucket->max[j],
+									 typlen[j], typbyval[j]);
+		}
+
+		if (ptr > end)
+			elog(ERROR, "invalid histogram size (bucket %d extends past the end)",
+				 i);
+
+		histogram->buckets[i] = bucket;
+	}
+
+	/* we should have consumed the whole bytea exactly */
+	Assert(ptr == end);
+
+	return histogram;
+}
+
+/*
+ * pg_histogram_in		- input routine for type pg_histogram.
+ *
+ * pg_histogram is real enough to be a table column, but it has no operations
+ * of its own, and disallows input too
+ */
+Datum
+pg_histogram_in(PG_FUNCTION_ARGS)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			 errmsg("cannot accept a value of type %s", "pg_histogram")));
+
+	PG_RETURN_VOID();			/* keep compiler quiet */
+}
+
+/*
+ * pg_histogram_out		- output routine for type pg_histogram.
+ *
+ * Histograms are serialized into a bytea value, so we simply call byteaout()
+ * to serialize the value into text.
+ */
+Datum
+pg_histogram_out(PG_FUNCTION_ARGS)
+{
+	return byteaout(fcinfo);
+}
+
+/*
+ * pg_histogram_recv		- binary input routine for type pg_histogram.
+ */
+Datum
+pg_histogram_recv(PG_FUNCTION_ARGS)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			 errmsg("cannot accept a value of type %s", "pg_histogram")));
+
+	PG_RETURN_VOID();			/* keep compiler quiet */
+}
+
+/*
+ * pg_histogram_send		- binary output routine for type pg_histogram.
+ *
+ * Histograms are serialized in a bytea value (although the type is named
+ * differently), so let's just send that.
+ */
+Datum
+pg_histogram_send(PG_FUNCTION_ARGS)
+{
+	return byteasend(fcinfo);
+}
+
+/*
+ * call_bucket_operator
+ *		Evaluate the operator on a boundary value and the constant.
+ */
+static bool
+call_bucket_operator(FmgrInfo *opproc, Oid collid, bool varonleft,
+					 Datum value, Datum constvalue)
+{
+	if (varonleft)
+		return DatumGetBool(FunctionCall2Coll(opproc, collid,
+											  value, constvalue));
+
+	return DatumGetBool(FunctionCall2Coll(opproc, collid,
+										  constvalue, value));
+}
+
+/*
+ * value_outside_bucket
+ *		Check if the constant is known to lie outside the bucket boundaries
+ *		in the given dimension.
+ *
+ * We look up "<" and ">" operators matching the clause's input types in the
+ * default btree operator family of the column's type.  If there are none,
+ * we can't tell and return false.
+ */
+static bool
+value_outside_bucket(MVBucket *bucket, int idx, OpExpr *expr, Var *var,
+					 Const *cst, bool varonleft)
+{
+	TypeCacheEntry *typentry;
+	Oid			lefttype,
+				righttype;
+	Oid			ltop,
+				gtop;
+	FmgrInfo	ltproc,
+				gtproc;
+
+	typentry = lookup_type_cache(var->vartype, TYPECACHE_BTREE_OPFAMILY);
+	if (!OidIsValid(typentry->btree_opf))
+		return false;
+
+	op_input_types(expr->opno, &lefttype, &righttype);
+
+	ltop = get_opfamily_member(typentry->btree_opf, lefttype, righttype,
+							   BTLessStrategyNumber);
+	gtop = get_opfamily_member(typentry->btree_opf, lefttype, righttype,
+							   BTGreaterStrategyNumber);
+
+	if (!OidIsValid(ltop) || !OidIsValid(gtop))
+		return false;
+
+	fmgr_info(get_opcode(ltop), &ltproc);
+	fmgr_info(get_opcode(gtop), &gtproc);
+
+	if (varonleft)
+	{
+		/* (min > const) or (max < const) */
+		return call_bucket_operator(&gtproc, expr->inputcollid, true,
+									bucket->min[idx], cst->constvalue) ||
+			call_bucket_operator(&ltproc, expr->inputcollid, true,
+								 bucket->max[idx], cst->constvalue);
+	}
+
+	/* (const < min) or (const > max) */
+	return call_bucket_operator(&ltproc, expr->inputcollid, false,
+								bucket->min[idx], cst->constvalue) ||
+		call_bucket_operator(&gtproc, expr->inputcollid, false,
+							 bucket->max[idx], cst->constvalue);
+}
+
+/*
+ * bucket_clause_fraction
+ *		Estimate the fraction of the bucket matching an operator clause.
+ *
+ * For inequalities the condition is monotonic along the dimension, so we
+ * only need to evaluate it on the bucket boundaries - if it holds for both,
+ * the whole bucket matches, if it holds for neither, nothing matches, and
+ * otherwise the bucket matches partially.  For equality, a constant within
+ * the bucket boundaries matches one of the distinct values in the bucket.
+ */
+static double
+bucket_clause_fraction(MVBucket *bucket, int idx, OpExpr *expr, Var *var,
+					   Const *cst, bool varonleft, FmgrInfo *opproc)
+{
+	bool		minmatch,
+				maxmatch;
+
+	/* the operators are strict, so NULL values never match */
+	if (bucket->nullsonly[idx])
+		return 0.0;
+
+	minmatch = call_bucket_operator(opproc, expr->inputcollid, varonleft,
+									bucket->min[idx], cst->constvalue);
+
+	/* a single distinct value, so the boundary decides */
+	if (bucket->ndistinct[idx] <= 1)
+		return minmatch ? 1.0 : 0.0;
+
+	if (get_oprrest(expr->opno) == F_EQSEL)
+	{
+		if (value_outside_bucket(bucket, idx, expr, var, cst, varonleft))
+			return 0.0;
+
+		return 1.0 / bucket->ndistinct[idx];
+	}
+
+	maxmatch = call_bucket_operator(opproc, expr->inputcollid, varonleft,
+									bucket->max[idx], cst->constvalue);
+
+	if (minmatch && maxmatch)
+		return 1.0;
+	else if (!minmatch && !maxmatch)
+		return 0.0;
+
+	return HIST_PARTIAL_MATCH;
+}
+
+/*
+ * histogram_clauselist_selectivity
+ *		Estimate selectivity of clauses using the histogram.
+ *
+ * All the clauses have to be compatible with the histogram (as determined
+ * by statext_is_compatible_clause), and reference only attributes covered by
+ * the statistics object.  Each bucket contributes its frequency, multiplied
+ * by the fraction of the bucket matching each of the clauses.
+ */
+Selectivity
+histogram_clauselist_selectivity(PlannerInfo *root, StatisticExtInfo *stat,
+								 List *clauses)
+{
+	int			i;
+	ListCell   *l;
+	MVHistogram *histogram;
+	double	   *fractions;
+	Selectivity s = 0.0;
+
+	histogram = statext_histogram_load(stat->statOid);
+
+	/* by default the buckets match the clauses fully */
+	fractions = (double *) palloc(sizeof(double) * histogram->nbuckets);
+	for (i = 0; i < histogram->nbuckets; i++)
+		fractions[i] = 1.0;
+
+	foreach(l, clauses)
+	{
+		Node	   *clause = (Node *) lfirst(l);
+
+		if (is_opclause(clause))
+		{
+			OpExpr	   *expr = (OpExpr *) clause;
+			FmgrInfo	opproc;
+			Var		   *var;
+			Const	   *cst;
+			bool		varonleft;
+			int			idx;
+
+			if (!examine_opclause_expression(expr, &var, &cst, &varonleft))
+				elog(ERROR, "incompatible clause");
+
+			idx = bms_member_index(stat->keys, var->varattno);
+			Assert(idx >= 0);
+
+			fmgr_info(get_opcode(expr->opno), &opproc);
+
+			for (i = 0; i < histogram->nbuckets; i++)
+			{
+				/* skip buckets already eliminated by other clauses */
+				if (fractions[i] == 0.0)
+					continue;
+
+				if (cst->constisnull)
+				{
+					fractions[i] = 0.0;
+					continue;
+				}
+
+				fractions[i] *= bucket_clause_fraction(histogram->buckets[i],
+													   idx, expr, var, cst,
+													   varonleft, &opproc);
+			}
+		}
+		else if (IsA(clause, NullTest))
+		{
+			NullTest   *expr = (NullTest *) clause;
+			Node	   *arg = (Node *) expr->arg;
+			Var		   *var;
+			int			idx;
+
+			if (IsA(arg, RelabelType))
+				arg = (Node *) ((RelabelType *) arg)->arg;
+
+			var = (Var *) arg;
+			Assert(IsA(var, Var));
+
+			idx = bms_member_index(stat->keys, var->varattno);
+			Assert(idx >= 0);
+
+			for (i = 0; i < histogram->nbuckets; i++)
+			{
+				bool		nullsonly = histogram->buckets[i]->nullsonly[idx];
+
+				if ((expr->nulltesttype == IS_NULL) != nullsonly)
+					fractions[i] = 0.0;
+			}
+		}
+		else
+			elog(ERROR, "unknown clause type: %d", clause->type);
+	}
+
+	for (i = 0; i < histogram->nbuckets; i++)
+		s += histogram->buckets[i]->frequency * fractions[i];
+
+	pfree(fractions);
+
+	return s;
+}
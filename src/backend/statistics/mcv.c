@@ -0,0 +1,857 @@
+/*-------------------------------------------------------------------------
+ *
+ * mcv.c
+ *	  POSTGRES multivariate MCV lists
+ *
+ * A multivariate MCV (most-common values) list is a straightforward
+ * extension of the per-column MCV list - it's a list of the most common
+ * combinations of values in the columns covered by the statistics object,
+ * along with the frequency of each combination in the sample.
+ *
+ * For each item we also keep the "base" frequency, i.e. the frequency the
+ * combination would have if the columns were independent (computed as a
+ * product of per-column frequencies of the values).  That allows correcting
+ * the estimate for the part of the data not covered by the MCV list, see
+ * statext_clauselist_selectivity.
+ *
+ *
+ * Portions Copyright (c) 1996-2018, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  src/backend/statistics/mcv.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/htup_details.h"
+#include "catalog/pg_statistic_ext.h"
+#include "catalog/pg_type.h"
+#include "fmgr.h"
+#include "funcapi.h"
+#include "optimizer/clauses.h"
+#include "statistics/extended_stats_internal.h"
+#include "statistics/statistics.h"
+#include "utils/array.h"
+#include "utils/builtins.h"
+#include "utils/bytea.h"
+#include "utils/datum.h"
+#include "utils/fmgroids.h"
+#include "utils/fmgrprotos.h"
+#include "utils/lsyscache.h"
+#include "utils/syscache.h"
+#include "utils/typcache.h"
+
+/*
+ * Internal state for sorting the sampled items by a single dimension, used
+ * when computing base frequencies of the MCV items.
+ */
+typedef struct DimensionSortContext
+{
+	MultiSortSupport mss;		/* sort support for all dimensions */
+	int			dim;			/* dimension to sort by */
+} DimensionSortContext;
+
+static SortItem *build_distinct_groups(int numrows, SortItem *items,
+					  MultiSortSupport mss, int *ndistinct);
+static int	compare_sort_item_count(const void *a, const void *b);
+static int	compare_sort_item_dim(const void *a, const void *b, void *arg);
+static int	count_dimension_value(SortItem *items, int nitems, Datum value,
+					  bool isnull, int dim, MultiSortSupport mss);
+
+
+/*
+ * statext_mcv_build
+ *		Build a multivariate MCV list from the sampled rows.
+ *
+ * The sampled rows are sorted and grouped into distinct combinations of
+ * values; the most frequent groups are then kept as MCV items.  If all the
+ * groups fit into the list and we seem to have seen all of them (either the
+ * sample covers the whole table, or no group was seen just once), we keep
+ * all of them.  Otherwise we only keep groups that are notably more frequent
+ * than an average group, similarly to how compute_scalar_stats() decides
+ * which values to keep in the per-column MCV list.
+ *
+ * Returns NULL when there are no groups worth keeping.
+ */
+MVMCVList *
+statext_mcv_build(int numrows, HeapTuple *rows, Bitmapset *attrs,
+				  VacAttrStats **stats, double totalrows)
+{
+	int			i,
+				j;
+	int			numattrs = bms_num_members(attrs);
+	int			nitems;
+	int			ngroups;
+	int			nmcv;
+	int			maxitems;
+	int			mincount;
+	bool		have_singletons;
+	int		   *attnums = build_attnums(attrs);
+	MultiSortSupport mss = build_multi_sort(numattrs, stats);
+	SortItem   *items;
+	SortItem   *groups;
+	MVMCVList  *mcvlist;
+
+	/* sort the rows, ignoring the too-wide ones */
+	items = build_sorted_items(numrows, &nitems, rows, stats[0]->tupDesc,
+							   mss, numattrs, attnums);
+
+	if (!items)
+		return NULL;
+
+	/* transform the sorted rows into groups (sorted by frequency) */
+	groups = build_distinct_groups(nitems, items, mss, &ngroups);
+
+	/* maximum number of MCV items, based on the statistics target */
+	maxitems = Min(statext_stattarget(numattrs, stats), STATS_MCVLIST_MAX_ITEMS);
+
+	/* the groups are sorted by frequency, so the last one is the rarest */
+	have_singletons = (groups[ngroups - 1].count == 1);
+
+	if (ngroups <= maxitems &&
+		(numrows == totalrows || !have_singletons))
+	{
+		/* we have all the groups, so keep all of them */
+		mincount = 1;
+	}
+	else
+	{
+		/*
+		 * Only keep groups that are at least 25% more common than an average
+		 * group, and always require at least two occurrences (a group seen
+		 * just once is not really "common").
+		 */
+		mincount = (int) (1.25 * nitems / ngroups);
+		mincount = Max(mincount, 2);
+	}
+
+	nmcv = 0;
+	while (nmcv < Min(ngroups, maxitems) && groups[nmcv].count >= mincount)
+		nmcv++;
+
+	/* no groups frequent enough */
+	if (nmcv == 0)
+	{
+		pfree(items);
+		pfree(groups);
+		return NULL;
+	}
+
+	/* Allocate the MCV list structure, set the global parameters. */
+	mcvlist = (MVMCVList *) palloc0(sizeof(MVMCVList));
+
+	mcvlist->magic = STATS_MCV_MAGIC;
+	mcvlist->type = STATS_MCV_TYPE_BASIC;
+	mcvlist->ndimensions = numattrs;
+	mcvlist->nitems = nmcv;
+
+	for (i = 0; i < numattrs; i++)
+		mcvlist->types[i] = stats[i]->attrtypid;
+
+	mcvlist->items = (MVMCVItem **) palloc(sizeof(MVMCVItem *) * nmcv);
+
+	/* Copy the first chunk of groups into the result. */
+	for (i = 0; i < nmcv; i++)
+	{
+		MVMCVItem  *item = (MVMCVItem *) palloc0(sizeof(MVMCVItem));
+
+		item->values = (Datum *) palloc(sizeof(Datum) * numattrs);
+		item->isnull = (bool *) palloc(sizeof(bool) * numattrs);
+
+		for (j = 0; j < numattrs; j++)
+		{
+			item->isnull[j] = groups[i].isnull[j];
+
+			if (item->isnull[j])
+				item->values[j] = (Datum) 0;
+			else
+				item->values[j] = datumCopy(groups[i].values[j],
+											stats[j]->attrtype->typbyval,
+											stats[j]->attrtype->typlen);
+		}
+
+		/* frequency relative to the whole sample (including too-wide rows) */
+		item->frequency = (double) groups[i].count / numrows;
+		item->base_frequency = 1.0;
+
+		mcvlist->items[i] = item;
+	}
+
+	/*
+	 * Compute the base frequencies, i.e. the frequencies the items would
+	 * have if the columns were independent.  For each dimension we sort the
+	 * items by that dimension alone, and look up the per-column frequency of
+	 * each MCV item's value using binary search.
+	 */
+	for (j = 0; j < numattrs; j++)
+	{
+		DimensionSortContext cxt;
+
+		cxt.mss = mss;
+		cxt.dim = j;
+
+		qsort_arg((void *) items, nitems, sizeof(SortItem),
+				  compare_sort_item_dim, &cxt);
+
+		for (i = 0; i < nmcv; i++)
+		{
+			MVMCVItem  *item = mcvlist->items[i];
+			int			count;
+
+			count = count_dimension_value(items, nitems, item->values[j],
+										  item->isnull[j], j, mss);
+
+			item->base_frequency *= (double) count / numrows;
+		}
+	}
+
+	pfree(items);
+	pfree(groups);
+
+	return mcvlist;
+}
+
+/*
+ * build_distinct_groups
+ *		Build an array of SortItems for distinct groups, with counts, sorted
+ *		by frequency (descending).
+ *
+ * The input items have to be sorted using the multi-sort support.
+ */
+static SortItem *
+build_distinct_groups(int numrows, SortItem *items, MultiSortSupport mss,
+					  int *ndistinct)
+{
+	int			i,
+				j;
+	int			ngroups = 1;
+	SortItem   *groups;
+
+	/* count the distinct groups first */
+	for (i = 1; i < numrows; i++)
+	{
+		if (multi_sort_compare(&items[i], &items[i - 1], mss) != 0)
+			ngroups++;
+	}
+
+	groups = (SortItem *) palloc(ngroups * sizeof(SortItem));
+
+	j = 0;
+	groups[0] = items[0];
+	groups[0].count = 1;
+
+	for (i = 1; i < numrows; i++)
+	{
+		/* Assume sorted in ascending order. */
+		Assert(multi_sort_compare(&items[i], &items[i - 1], mss) >= 0);
+
+		/* New distinct group detected. */
+		if (multi_sort_compare(&items[i], &items[i - 1], mss) != 0)
+		{
+			groups[++j] = items[i];
+			groups[j].count = 0;
+		}
+
+		groups[j].count++;
+	}
+
+	/* ensure we filled the expected number of distinct groups */
+	Assert(j + 1 == ngroups);
+
+	/* Sort the distinct groups by frequency (in descending order). */
+	pg_qsort((void *) groups, ngroups, sizeof(SortItem),
+			 compare_sort_item_count);
+
+	*ndistinct = ngroups;
+	return groups;
+}
+
+/* compare sort items (groups) by count, in descending order */
+static int
+compare_sort_item_count(const void *a, const void *b)
+{
+	SortItem   *ia = (SortItem *) a;
+	SortItem   *ib = (SortItem *) b;
+
+	if (ia->count == ib->count)
+		return 0;
+	else if (ia->count > ib->count)
+		return -1;
+
+	return 1;
+}
+
+/* compare sort items by a single dimension */
+static int
+compare_sort_item_dim(const void *a, const void *b, void *arg)
+{
+	DimensionSortContext *cxt = (DimensionSortContext *) arg;
+
+	return multi_sort_compare_dim(cxt->dim, (const SortItem *) a,
+								  (const SortItem *) b, cxt->mss);
+}
+
+/*
+ * count_dimension_value
+ *		Count items with the given value in a dimension.
+ *
+ * The items have to be sorted by the dimension, so that we can simply do a
+ * binary search for the first and the last matching item.
+ */
+static int
+count_dimension_value(SortItem *items, int nitems, Datum value, bool isnull,
+					  int dim, MultiSortSupport mss)
+{
+	int			lo,
+				hi;
+	int			first;
+
+	/* find the first item not smaller than the value */
+	lo = 0;
+	hi = nitems;
+	while (lo < hi)
+	{
+		int			mid = (lo + hi) / 2;
+
+		if (ApplySortComparator(items[mid].values[dim], items[mid].isnull[dim],
+								value, isnull, &mss->ssup[dim]) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	first = lo;
+
+	/* find the first item greater than the value */
+	hi = nitems;
+	while (lo < hi)
+	{
+		int			mid = (lo + hi) / 2;
+
+		if (ApplySortComparator(items[mid].values[dim], items[mid].isnull[dim],
+								value, isnull, &mss->ssup[dim]) <= 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo - first;
+}
+
+/*
+ * statext_mcv_load
+ *		Load the MCV list for the indicated pg_statistic_ext tuple
+ */
+MVMCVList *
+statext_mcv_load(Oid mvoid)
+{
+	bool		isnull;
+	Datum		mcvlist;
+	HeapTuple	htup = SearchSysCache1(STATEXTOID, ObjectIdGetDatum(mvoid));
+
+	if (!HeapTupleIsValid(htup))
+		elog(ERROR, "cache lookup failed for statistics object %u", mvoid);
+
+	mcvlist = SysCacheGetAttr(STATEXTOID, htup,
+							  Anum_pg_statistic_ext_stxmcv, &isnull);
+	Assert(!isnull);
+
+	ReleaseSysCache(htup);
+
+	return statext_mcv_deserialize(DatumGetByteaP(mcvlist));
+}
+
+/*
+ * statext_mcv_serialize
+ *		Serialize MCV list into a bytea value.
+ *
+ * The format is simple - after the header (magic, type, number of items,
+ * number of dimensions and data types of the dimensions) each item is
+ * stored as the frequency, base frequency and NULL flags, followed by the
+ * values of non-NULL dimensions (see statext_datum_write).
+ */
+bytea *
+statext_mcv_serialize(MVMCVList *mcvlist, VacAttrStats **stats)
+{
+	int			i,
+				j;
+	int			ndims = mcvlist->ndimensions;
+	Size		len;
+	bytea	   *output;
+	char	   *ptr;
+
+	/* header */
+	len = VARHDRSZ + 3 * sizeof(uint32) + sizeof(AttrNumber)
+		+ ndims * sizeof(Oid);
+
+	/* items (frequencies, NULL flags and values) */
+	for (i = 0; i < mcvlist->nitems; i++)
+	{
+		MVMCVItem  *item = mcvlist->items[i];
+
+		len += 2 * sizeof(double) + ndims * sizeof(bool);
+
+		for (j = 0; j < ndims; j++)
+		{
+			if (item->isnull[j])
+				continue;
+
+			len += statext_datum_size(item->values[j],
+									  stats[j]->attrtype->typlen,
+									  stats[j]->attrtype->typbyval);
+		}
+	}
+
+	output = (bytea *) palloc0(len);
+	SET_VARSIZE(output, len);
+
+	ptr = VARDATA(output);
+
+	/* Store the base struct values (magic, type, nitems, ndimensions) */
+	memcpy(ptr, &mcvlist->magic, sizeof(uint32));
+	ptr += sizeof(uint32);
+	memcpy(ptr, &mcvlist->type, sizeof(uint32));
+	ptr += sizeof(uint32);
+	memcpy(ptr, &mcvlist->nitems, sizeof(uint32));
+	ptr += sizeof(uint32);
+	memcpy(ptr, &mcvlist->ndimensions, sizeof(AttrNumber));
+	ptr += sizeof(AttrNumber);
+	memcpy(ptr, mcvlist->types, ndims * sizeof(Oid));
+	ptr += ndims * sizeof(Oid);
+
+	for (i = 0; i < mcvlist->nitems; i++)
+	{
+		MVMCVItem  *item = mcvlist->items[i];
+
+		memcpy(ptr, &item->frequency, sizeof(double));
+		ptr += sizeof(double);
+		memcpy(ptr, &item->base_frequency, sizeof(double));
+		ptr += sizeof(double);
+		memcpy(ptr, item->isnull, ndims * sizeof(bool));
+		ptr += ndims * sizeof(bool);
+
+		for (j = 0; j < ndims; j++)
+		{
+			if (item->isnull[j])
+				continue;
+
+			ptr = statext_datum_write(ptr, item->values[j],
+									  stats[j]->attrtype->typlen,
+									  stats[j]->attrtype->typbyval);
+		}
+
+		Assert(ptr <= ((char *) output + len));
+	}
+
+	/* we should have filled the whole bytea exactly */
+	Assert(ptr == ((char *) output + len));
+
+	return output;
+}
+
+/*
+ * statext_mcv_deserialize
+ *		Reads serialized MCV list into MVMCVList structure.
+ */
+MVMCVList *
+statext_mcv_deserialize(bytea *data)
+{
+	int			i,
+				j;
+	Size		min_expected_size;
+	MVMCVList  *mcvlist;
+	int16		typlen[STATS_MAX_DIMENSIONS];
+	bool		typbyval[STATS_MAX_DIMENSIONS];
+	char	   *ptr;
+	char	   *end;
+
+	if (data == NULL)
+		return NULL;
+
+	/* minimum size of the header (up to the data types) */
+	min_expected_size = 3 * sizeof(uint32) + sizeof(AttrNumber);
+
+	if (VARSIZE_ANY_EXHDR(data) < min_expected_size)
+		elog(ERROR, "invalid MCV list size %zd (expected at least %zd)",
+			 VARSIZE_ANY_EXHDR(data), min_expected_size);
+
+	mcvlist = (MVMCVList *) palloc0(sizeof(MVMCVList));
+
+	/* initialize pointer to the data part (skip the varlena header) */
+	ptr = VARDATA_ANY(data);
+	end = (char *) data + VARSIZE_ANY(data);
+
+	/* read the header fields and perform basic sanity checks */
+	memcpy(&mcvlist->magic, ptr, sizeof(uint32));
+	ptr += sizeof(uint32);
+	memcpy(&mcvlist->type, ptr, sizeof(uint32));
+	ptr += sizeof(uint32);
+	memcpy(&mcvlist->nitems, ptr, sizeof(uint32));
+	ptr += sizeof(uint32);
+	memcpy(&mcvlist->ndimensions, ptr, sizeof(AttrNumber));
+	ptr += sizeof(AttrNumber);
+
+	if (mcvlist->magic != STATS_MCV_MAGIC)
+		elog(ERROR, "invalid MCV magic %u (expected %u)",
+			 mcvlist->magic, STATS_MCV_MAGIC);
+
+	if (mcvlist->type != STATS_MCV_TYPE_BASIC)
+		elog(ERROR, "invalid MCV type %u (expected %u)",
+			 mcvlist->type, STATS_MCV_TYPE_BASIC);
+
+	if (mcvlist->nitems == 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg("invalid zero-length item array in MVMCVList")));
+
+	if ((mcvlist->ndimensions < 2) ||
+		(mcvlist->ndimensions > STATS_MAX_DIMENSIONS))
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg("invalid number of dimensions %d in MVMCVList",
+						mcvlist->ndimensions)));
+
+	/* what minimum bytea size do we expect for those parameters */
+	min_expected_size += mcvlist->ndimensions * sizeof(Oid) +
+		mcvlist->nitems * (2 * sizeof(double) +
+						   mcvlist->ndimensions * sizeof(bool));
+
+	if (VARSIZE_ANY_EXHDR(data) < min_expected_size)
+		elog(ERROR, "invalid MCV list size %zd (expected at least %zd)",
+			 VARSIZE_ANY_EXHDR(data), min_expected_size);
+
+	memcpy(mcvlist->types, ptr, mcvlist->ndimensions * sizeof(Oid));
+	ptr += mcvlist->ndimensions * sizeof(Oid);
+
+	for (j = 0; j < mcvlist->ndimensions; j++)
+		get_typlenbyval(mcvlist->types[j], &typlen[j], &typbyval[j]);
+
+	mcvlist->items = (MVMCVItem **) palloc(sizeof(MVMCVItem *) *
+										   mcvlist->nitems);
+
+	for (i = 0; i < mcvlist->nitems; i++)
+	{
+		MVMCVItem  *item = (MVMCVItem *) palloc0(sizeof(MVMCVItem));
+
+		item->values = (Datum *) palloc0(sizeof(Datum) * mcvlist->ndimensions);
+		item->isnull = (bool *) palloc(sizeof(bool) * mcvlist->ndimensions);
+
+		memcpy(&item->frequency, ptr, sizeof(double));
+		ptr += sizeof(double);
+		memcpy(&item->base_frequency, ptr, sizeof(double));
+		ptr += sizeof(double);
+		memcpy(item->isnull, ptr, sizeof(bool) * mcvlist->ndimensions);
+		ptr += sizeof(bool) * mcvlist->ndimensions;
+
+		for (j = 0; j < mcvlist->ndimensions; j++)
+		{
+			if (item->isnull[j])
+				continue;
+
+			ptr = statext_datum_read(ptr, &item->values[j],
+									 typlen[j], typbyval[j]);
+		}
+
+		/* still within the bytea */
+		if (ptr > end)
+			elog(ERROR, "invalid MCV list size (item %d extends past the end)",
+				 i);
+
+		mcvlist->items[i] = item;
+	}
+
+	/* we should have consumed the whole bytea exactly */
+	Assert(ptr == end);
+
+	return mcvlist;
+}
+
+/*
+ * pg_mcv_list_in		- input routine for type pg_mcv_list.
+ *
+ * pg_mcv_list is real enough to be a table column, but it has no operations
+ * of its own, and disallows input too
+ */
+Datum
+pg_mcv_list_in(PG_FUNCTION_ARGS)
+{
+	/*
+	 * pg_mcv_list stores the data in binary form and parsing text input is
+	 * not needed, so disallow this.
+	 */
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			 errmsg("cannot accept a value of type %s", "pg_mcv_list")));
+
+	PG_RETURN_VOID();			/* keep compiler quiet */
+}
+
+/*
+ * pg_mcv_list_out		- output routine for type pg_mcv_list.
+ *
+ * MCV lists are serialized into a bytea value, so we simply call byteaout()
+ * to serialize the value into text. But it'd be nice to serialize that into
+ * a meaningful representation (e.g. for inspection by people).  Use the
+ * pg_mcv_list_items() function for that.
+ */
+Datum
+pg_mcv_list_out(PG_FUNCTION_ARGS)
+{
+	return byteaout(fcinfo);
+}
+
+/*
+ * pg_mcv_list_recv		- binary input routine for type pg_mcv_list.
+ */
+Datum
+pg_mcv_list_recv(PG_FUNCTION_ARGS)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			 errmsg("cannot accept a value of type %s", "pg_mcv_list")));
+
+	PG_RETURN_VOID();			/* keep compiler quiet */
+}
+
+/*
+ * pg_mcv_list_send		- binary output routine for type pg_mcv_list.
+ *
+ * MCV lists are serialized in a bytea value (although the type is named
+ * differently), so let's just send that.
+ */
+Datum
+pg_mcv_list_send(PG_FUNCTION_ARGS)
+{
+	return byteasend(fcinfo);
+}
+
+/*
+ * pg_mcv_list_items
+ *		SRF returning the items of a MCV list, with values converted to text
+ */
+Datum
+pg_mcv_list_items(PG_FUNCTION_ARGS)
+{
+	FuncCallContext *funcctx;
+	MVMCVList  *mcvlist;
+
+	/* stuff done only on the first call of the function */
+	if (SRF_IS_FIRSTCALL())
+	{
+		MemoryContext oldcontext;
+		TupleDesc	tupdesc;
+
+		/* create a function context for cross-call persistence */
+		funcctx = SRF_FIRSTCALL_INIT();
+
+		/* switch to memory context appropriate for multiple function calls */
+		oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+
+		mcvlist = statext_mcv_deserialize(PG_GETARG_BYTEA_P(0));
+
+		funcctx->user_fctx = mcvlist;
+		funcctx->max_calls = mcvlist->nitems;
+
+		/* Build a tuple descriptor for our result type */
+		if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("function returning record called in context "
+							"that cannot accept type record")));
+
+		funcctx->tuple_desc = BlessTupleDesc(tupdesc);
+
+		MemoryContextSwitchTo(oldcontext);
+	}
+
+	/* stuff done on every call of the function */
+	funcctx = SRF_PERCALL_SETUP();
+	mcvlist = (MVMCVList *) funcctx->user_fctx;
+
+	if (funcctx->call_cntr < funcctx->max_calls)	/* do when there is more
+													 * left to send */
+	{
+		MVMCVItem  *item = mcvlist->items[funcctx->call_cntr];
+		int			ndims = mcvlist->ndimensions;
+		Datum		values[5];
+		bool		nulls[5];
+		Datum	   *textvalues;
+		Datum	   *nullflags;
+		int			dims[1];
+		int			lbs[1];
+		int			i;
+		HeapTuple	tuple;
+
+		textvalues = (Datum *) palloc0(sizeof(Datum) * ndims);
+		nullflags = (Datum *) palloc(sizeof(Datum) * ndims);
+
+		for (i = 0; i < ndims; i++)
+		{
+			nullflags[i] = BoolGetDatum(item->isnull[i]);
+
+			if (!item->isnull[i])
+			{
+				Oid			outfunc;
+				bool		isvarlena;
+
+				getTypeOutputInfo(mcvlist->types[i], &outfunc, &isvarlena);
+				textvalues[i] = CStringGetTextDatum(
+							OidOutputFunctionCall(outfunc, item->values[i]));
+			}
+		}
+
+		dims[0] = ndims;
+		lbs[0] = 1;
+
+		values[0] = Int32GetDatum(funcctx->call_cntr);
+		values[1] = PointerGetDatum(construct_md_array(textvalues, item->isnull,
+													   1, dims, lbs, TEXTOID,
+													   -1, false, 'i'));
+		values[2] = PointerGetDatum(construct_array(nullflags, ndims, BOOLOID,
+													1, true, 'c'));
+		values[3] = Float8GetDatum(item->frequency);
+		values[4] = Float8GetDatum(item->base_frequency);
+
+		memset(nulls, 0, sizeof(nulls));
+
+		/* build a tuple */
+		tuple = heap_form_tuple(funcctx->tuple_desc, values, nulls);
+
+		SRF_RETURN_NEXT(funcctx, HeapTupleGetDatum(tuple));
+	}
+	else						/* do when there is no more left */
+	{
+		SRF_RETURN_DONE(funcctx);
+	}
+}
+
+/*
+ * mcv_clauselist_selectivity
+ *		Estimate selectivity of clauses using the MCV list.
+ *
+ * All the clauses have to be compatible with the MCV list (as determined by
+ * statext_is_compatible_clause), and reference only attributes covered by
+ * the statistics object.  Returns the sum of frequencies of items matching
+ * all the clauses; the sum of their base frequencies is returned in
+ * *basesel and the total frequency of all items in *totalsel.
+ */
+Selectivity
+mcv_clauselist_selectivity(PlannerInfo *root, StatisticExtInfo *stat,
+						   List *clauses, Selectivity *basesel,
+						   Selectivity *totalsel)
+{
+	int			i;
+	ListCell   *l;
+	MVMCVList  *mcvlist;
+	bool	   *matches;
+	Selectivity s = 0.0;
+
+	mcvlist = statext_mcv_load(stat->statOid);
+
+	/* by default all the MCV items match the clauses fully */
+	matches = (bool *) palloc(sizeof(bool) * mcvlist->nitems);
+	memset(matches, true, sizeof(bool) * mcvlist->nitems);
+
+	foreach(l, clauses)
+	{
+		Node	   *clause = (Node *) lfirst(l);
+
+		if (is_opclause(clause))
+		{
+			OpExpr	   *expr = (OpExpr *) clause;
+			FmgrInfo	opproc;
+			Var		   *var;
+			Const	   *cst;
+			bool		varonleft;
+			int			idx;
+
+			if (!examine_opclause_expression(expr, &var, &cst, &varonleft))
+				elog(ERROR, "incompatible clause");
+
+			idx = bms_member_index(stat->keys, var->varattno);
+			Assert(idx >= 0);
+
+			fmgr_info(get_opcode(expr->opno), &opproc);
+
+			for (i = 0; i < mcvlist->nitems; i++)
+			{
+				MVMCVItem  *item = mcvlist->items[i];
+				bool		match;
+
+				/* skip items already eliminated by other clauses */
+				if (!matches[i])
+					continue;
+
+				/* the operators are strict, so NULL never matches */
+				if (item->isnull[idx] || cst->constisnull)
+				{
+					matches[i] = false;
+					continue;
+				}
+
+				if (varonleft)
+					match = DatumGetBool(FunctionCall2Coll(&opproc,
+														   expr->inputcollid,
+														   item->values[idx],
+														   cst->constvalue));
+				else
+					match = DatumGetBool(FunctionCall2Coll(&opproc,
+														   expr->inputcollid,
+														   cst->constvalue,
+														   item->values[idx]));
+
+				matches[i] = match;
+			}
+		}
+		else if (IsA(clause, NullTest))
+		{
+			NullTest   *expr = (NullTest *) clause;
+			Node	   *arg = (Node *) expr->arg;
+			Var		   *var;
+			int			idx;
+
+			if (IsA(arg, RelabelType))
+				arg = (Node *) ((RelabelType *) arg)->arg;
+
+			var = (Var *) arg;
+			Assert(IsA(var, Var));
+
+			idx = bms_member_index(stat->keys, var->varattno);
+			Assert(idx >= 0);
+
+			for (i = 0; i < mcvlist->nitems; i++)
+			{
+				MVMCVItem  *item = mcvlist->items[i];
+
+				if (!matches[i])
+					continue;
+
+				if (expr->nulltesttype == IS_NULL)
+					matches[i] = item->isnull[idx];
+				else
+					matches[i] = !item->isnull[idx];
+			}
+		}
+		else
+			elog(ERROR, "unknown clause type: %d", clause->type);
+	}
+
+	*basesel = 0.0;
+	*totalsel = 0.0;
+
+	for (i = 0; i < mcvlist->nitems; i++)
+	{
+		*totalsel += mcvlist->items[i]->frequency;
+
+		if (matches[i])
+		{
+			s += mcvlist->items[i]->frequency;
+			*basesel += mcvlist->items[i]->base_frequency;
+		}
+	}
+
+	pfree(matches);
+
+	return s;
+}
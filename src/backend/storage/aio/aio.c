@@ -0,0 +1,642 @@
+/*-------------------------------------------------------------------------
+ *
+ * aio.c
+ *	  Asynchronous I/O on shared buffers
+ *
+ * The buffer manager uses this module to read into and write out shared
+ * buffers without waiting for the I/O to finish.  Each I/O transfers a run
+ * of contiguous blocks of one relation fork, and is described by a handle
+ * in shared memory.  Every process owns io_max_concurrency handles: it
+ * defines ("stages") I/Os on them, submits them in batches, and reclaims
+ * the handles once the I/Os have completed.
+ *
+ * How the I/O is actually performed depends on io_method:
+ *
+ * - sync: this module isn't used at all; the buffer manager performs all
+ *	 I/O synchronously, as it always did.
+ * - worker: submitted I/Os are queued in shared memory and executed by I/O
+ *	 worker processes, see aio_worker.c.
+ * - io_uring: each process submits its I/Os to its own io_uring instance,
+ *	 see aio_uring.c.
+ *
+ * Whichever process finds out that an I/O has finished (the I/O worker that
+ * executed it, or any process reaping an io_uring) completes it: it marks
+ * the buffers valid or clean, or failed (see CompleteBufferIO), and wakes up
+ * the processes waiting for them.  Processes needing a buffer that is being
+ * read or written wait for the buffer, just like for synchronous I/O.  The
+ * owner of an I/O only waits for the handle itself to reuse it, or to clean
+ * up after an error.
+ *
+ * Writes are performed from "bounce buffers", copies of the pages taken
+ * while they were share-locked, so that the buffer content lock need not be
+ * held until the write completes.
+ *
+ * Failed I/Os just leave the buffers marked BM_IO_ERROR and not valid, or
+ * still dirty.  The buffer manager then repeats the I/O synchronously, to
+ * report the error in the process that needs the block.
+ *
+ * Portions Copyright (c) 1996-2018, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/storage/aio/aio.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/twophase.h"
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "storage/aio.h"
+#include "storage/aio_internal.h"
+#include "storage/buf_internals.h"
+#include "storage/proc.h"
+#include "storage/shmem.h"
+#include "storage/smgr.h"
+#include "storage/spin.h"
+#include "utils/guc.h"
+
+
+const struct config_enum_entry io_method_options[] = {
+	{"sync", IOMETHOD_SYNC, false},
+	{"worker", IOMETHOD_WORKER, false},
+#ifdef USE_IO_URING
+	{"io_uring", IOMETHOD_IO_URING, false},
+#endif
+	{NULL, 0, false}
+};
+
+/* GUC variables */
+int			io_method = IOMETHOD_SYNC;
+int			io_workers = 3;
+int			io_max_concurrency = 32;
+
+PgAioCtlData *AioCtl = NULL;
+PgAioHandle *AioHandles = NULL;
+
+/* bounce buffers, and the links of their free list */
+static char *AioBounceBuffers = NULL;
+static int *AioBounceNext = NULL;
+
+/* this process's handles, and the number of them in PGAIO_STAGED state */
+static PgAioHandle *MyAioHandles = NULL;
+static int	num_staged = 0;
+
+/* handle to wait for when all of ours are busy */
+static int	next_to_wait = 0;
+
+static int	AioNumHandles(void);
+static int	AioNumBounceBuffers(void);
+static PgAioHandle *pgaio_get_handle(void);
+static bool pgaio_get_bounce_buffers(int n, int *bounce_ids);
+static void pgaio_wait_io(PgAioHandle *ioh);
+static void pgaio_perform_inline(int nios, PgAioHandle **ios);
+
+
+/*
+ * Every process that can have a PGPROC gets its own set of handles.
+ */
+static int
+AioNumHandles(void)
+{
+	return (MaxBackends + NUM_AUXILIARY_PROCS + max_prepared_xacts) *
+		io_max_concurrency;
+}
+
+/*
+ * Bounce buffers are only needed for writes in progress, so a small
+ * fraction of shared_buffers is plenty.
+ */
+static int
+AioNumBounceBuffers(void)
+{
+	return Min(Max(NBuffers / 64, 4 * PGAIO_MAX_BLOCKS), 4096);
+}
+
+/*
+ * Report shared-memory space needed by AioShmemInit
+ */
+Size
+AioShmemSize(void)
+{
+	Size		size = 0;
+
+	if (!pgaio_enabled())
+		return 0;
+
+	/* control struct, including the worker queue */
+	size = add_size(size, offsetof(PgAioCtlData, queue));
+	size = add_size(size, mul_size(AioNumHandles(), sizeof(int)));
+
+	/* handles */
+	size = add_size(size, mul_size(AioNumHandles(), sizeof(PgAioHandle)));
+
+	/* bounce buffers and their free list */
+	size = add_size(size, mul_size(AioNumBounceBuffers(), sizeof(int)));
+	size = add_size(size, mul_size(AioNumBounceBuffers(), BLCKSZ));
+	/* to allow aligning the bounce buffers */
+	size = add_size(size, BLCKSZ);
+
+#ifdef USE_IO_URING
+	if (io_method == IOMETHOD_IO_URING)
+		size = add_size(size, pgaio_uring_shmem_size());
+#endif
+
+	return size;
+}
+
+/*
+ * Initialize the AIO subsystem's shared memory
+ */
+void
+AioShmemInit(void)
+{
+	int			nhandles = AioNumHandles();
+	int			nbounce = AioNumBounceBuffers();
+	bool		foundCtl,
+				foundHandles,
+				foundBounce,
+				foundBounceNext;
+	int			i;
+
+	if (!pgaio_enabled())
+		return;
+
+	AioCtl = (PgAioCtlData *)
+		ShmemInitStruct("AIO Control",
+						add_size(offsetof(PgAioCtlData, queue),
+								 mul_size(nhandles, sizeof(int))),
+						&foundCtl);
+	AioHandles = (PgAioHandle *)
+		ShmemInitStruct("AIO Handles",
+						mul_size(nhandles, sizeof(PgAioHandle)),
+						&foundHandles);
+	AioBounceNext = (int *)
+		ShmemInitStruct("AIO Bounce Buffer Links",
+						mul_size(nbounce, sizeof(int)),
+						&foundBounceNext);
+	AioBounceBuffers = (char *)
+		ShmemInitStruct("AIO Bounce Buffers",
+						add_size(mul_size(nbounce, BLCKSZ), BLCKSZ),
+						&foundBounce);
+	AioBounceBuffers = (char *) TYPEALIGN(BLCKSZ, AioBounceBuffers);
+
+	if (!foundCtl)
+	{
+		Assert(!foundHandles && !foundBounce && !foundBounceNext);
+
+		SpinLockInit(&AioCtl->mutex);
+
+		for (i = 0; i < nbounce; i++)
+			AioBounceNext[i] = (i + 1 < nbounce) ? i + 1 : -1;
+		AioCtl->bounce_free = 0;
+		AioCtl->bounce_nfree = nbounce;
+
+		AioCtl->nworkers = 0;
+		AioCtl->next_wakeup = 0;
+		for (i = 0; i < MAX_IO_WORKERS; i++)
+			AioCtl->worker_latches[i] = NULL;
+
+		AioCtl->queue_size = nhandles;
+		AioCtl->queue_head = 0;
+		AioCtl->queue_tail = 0;
+
+		for (i = 0; i < nhandles; i++)
+		{
+			PgAioHandle *ioh = &AioHandles[i];
+
+			pg_atomic_init_u32(&ioh->state, PGAIO_IDLE);
+			ioh->owner = i / io_max_concurrency;
+			ConditionVariableInit(&ioh->cv);
+		}
+	}
+
+#ifdef USE_IO_URING
+	if (io_method == IOMETHOD_IO_URING)
+		pgaio_uring_shmem_init(foundCtl);
+#endif
+}
+
+/*
+ * Prepare the AIO subsystem in the postmaster, before shared memory is
+ * created.
+ *
+ * If io_uring was requested but is not usable, for example because the
+ * kernel is too old or it has been disabled, fall back to I/O workers.
+ */
+void
+AioPostmasterInit(void)
+{
+#ifdef USE_IO_URING
+	if (io_method == IOMETHOD_IO_URING && !pgaio_uring_probe())
+	{
+		ereport(LOG,
+				(errmsg("could not create io_uring instance: %m"),
+				 errdetail("Using I/O workers instead.")));
+		SetConfigOption("io_method", "worker",
+						PGC_POSTMASTER, PGC_S_OVERRIDE);
+	}
+#endif
+
+	if (io_method == IOMETHOD_WORKER)
+		AioRegisterWorkers();
+}
+
+/*
+ * Get an idle handle of ours, waiting for one to complete if needed.
+ */
+static PgAioHandle *
+pgaio_get_handle(void)
+{
+	if (MyAioHandles == NULL)
+	{
+		Assert(MyProc != NULL);
+		MyAioHandles = &AioHandles[MyProc->pgprocno * io_max_concurrency];
+	}
+
+	for (;;)
+	{
+		PgAioHandle *ioh;
+		int			i;
+
+		for (i = 0; i < io_max_concurrency; i++)
+		{
+			uint32		state;
+
+			ioh = &MyAioHandles[i];
+			state = pg_atomic_read_u32(&ioh->state);
+			if (state == PGAIO_DONE)
+			{
+				pg_atomic_write_u32(&ioh->state, PGAIO_IDLE);
+				state = PGAIO_IDLE;
+			}
+			if (state == PGAIO_IDLE)
+				return ioh;
+		}
+
+		/* All in use; wait for them in turn, so that we don't starve any */
+		ioh = &MyAioHandles[next_to_wait];
+		next_to_wait = (next_to_wait + 1) % io_max_concurrency;
+		pgaio_wait_io(ioh);
+	}
+}
+
+/*
+ * Take n bounce buffers from the free list, if that many are available.
+ */
+static bool
+pgaio_get_bounce_buffers(int n, int *bounce_ids)
+{
+	int			i;
+
+	SpinLockAcquire(&AioCtl->mutex);
+	if (AioCtl->bounce_nfree < n)
+	{
+		SpinLockRelease(&AioCtl->mutex);
+		return false;
+	}
+	for (i = 0; i < n; i++)
+	{
+		bounce_ids[i] = AioCtl->bounce_free;
+		AioCtl->bounce_free = AioBounceNext[bounce_ids[i]];
+	}
+	AioCtl->bounce_nfree -= n;
+	SpinLockRelease(&AioCtl->mutex);
+
+	return true;
+}
+
+/*
+ * pgaio_start_read -- stage a read of nblocks blocks into shared buffers
+ *
+ * buf_ids[i] is the buffer to read block blocknum + i into.  The blocks must
+ * be in the same segment file.  The read isn't started until pgaio_submit()
+ * is called.  Returns the ID of the handle.
+ */
+int
+pgaio_start_read(RelFileNode rnode, ForkNumber forknum,
+				 BlockNumber blocknum, int nblocks, const int *buf_ids)
+{
+	PgAioHandle *ioh;
+
+	Assert(nblocks > 0 && nblocks <= PGAIO_MAX_BLOCKS);
+
+	ioh = pgaio_get_handle();
+
+	ioh->op = PGAIO_OP_READ;
+	ioh->rnode = rnode;
+	ioh->forknum = forknum;
+	ioh->blocknum = blocknum;
+	ioh->nblocks = nblocks;
+	memcpy(ioh->buf_ids, buf_ids, nblocks * sizeof(int));
+
+	pg_atomic_write_u32(&ioh->state, PGAIO_STAGED);
+	num_staged++;
+
+	return ioh - AioHandles;
+}
+
+/*
+ * pgaio_start_write -- stage a write of nblocks blocks from shared buffers
+ *
+ * pages[i] is the content to write for block blocknum + i, which is in
+ * buffer buf_ids[i]; it is copied right away.  The blocks must be in the
+ * same segment file.  The write isn't started until pgaio_submit() is
+ * called.  Returns the ID of the handle, or -1 if there's no room for the
+ * copies, in which case the caller should write the pages synchronously.
+ */
+int
+pgaio_start_write(RelFileNode rnode, ForkNumber forknum,
+				  BlockNumber blocknum, int nblocks, const int *buf_ids,
+				  char **pages)
+{
+	PgAioHandle *ioh;
+	int			bounce_ids[PGAIO_MAX_BLOCKS];
+	int			i;
+
+	Assert(nblocks > 0 && nblocks <= PGAIO_MAX_BLOCKS);
+
+	if (!pgaio_get_bounce_buffers(nblocks, bounce_ids))
+	{
+		/* Our own writes in progress might be holding them */
+		pgaio_wait_all();
+		if (!pgaio_get_bounce_buffers(nblocks, bounce_ids))
+			return -1;
+	}
+
+	ioh = pgaio_get_handle();
+
+	ioh->op = PGAIO_OP_WRITE;
+	ioh->rnode = rnode;
+	ioh->forknum = forknum;
+	ioh->blocknum = blocknum;
+	ioh->nblocks = nblocks;
+	memcpy(ioh->buf_ids, buf_ids, nblocks * sizeof(int));
+	memcpy(ioh->bounce_ids, bounce_ids, nblocks * sizeof(int));
+	for (i = 0; i < nblocks; i++)
+		memcpy(pgaio_io_block(ioh, i), pages[i], BLCKSZ);
+
+	pg_atomic_write_u32(&ioh->state, PGAIO_STAGED);
+	num_staged++;
+
+	return ioh - AioHandles;
+}
+
+/*
+ * pgaio_submit -- start all the I/Os we have staged
+ */
+void
+pgaio_submit(void)
+{
+	PgAioHandle *ios[PGAIO_MAX_CONCURRENCY];
+	int			nios = 0;
+	int			i;
+
+	if (num_staged == 0)
+		return;
+
+	for (i = 0; i < io_max_concurrency; i++)
+	{
+		PgAioHandle *ioh = &MyAioHandles[i];
+
+		if (pg_atomic_read_u32(&ioh->state) == PGAIO_STAGED)
+		{
+			pg_atomic_write_u32(&ioh->state, PGAIO_SUBMITTED);
+			ios[nios++] = ioh;
+		}
+	}
+	Assert(nios == num_staged);
+	num_staged = 0;
+
+	switch (io_method)
+	{
+		case IOMETHOD_WORKER:
+			if (!pgaio_worker_submit(nios, ios))
+			{
+				/* No I/O worker is running, do it ourselves */
+				pgaio_perform_inline(nios, ios);
+			}
+			break;
+#ifdef USE_IO_URING
+		case IOMETHOD_IO_URING:
+			pgaio_uring_submit(nios, ios);
+			break;
+#endif
+		default:
+			elog(ERROR, "unrecognized io_method: %d", io_method);
+	}
+}
+
+/*
+ * pgaio_io_progress -- help along an I/O that somebody is waiting for
+ *
+ * Called while waiting for a buffer that the I/O with the given ID is
+ * reading or writing.  If we can make progress on it, do so, and return true;
+ * the caller should then recheck the buffer.  Otherwise, return false, and
+ * the caller should wait for the buffer to be released.
+ */
+bool
+pgaio_io_progress(int io_id)
+{
+	PgAioHandle *ioh = &AioHandles[io_id];
+	uint32		state = pg_atomic_read_u32(&ioh->state);
+
+	if (state == PGAIO_STAGED && ioh->owner == MyProc->pgprocno)
+	{
+		pgaio_submit();
+		return true;
+	}
+
+#ifdef USE_IO_URING
+	if (io_method == IOMETHOD_IO_URING)
+	{
+		/*
+		 * Nobody reaps completions on behalf of other processes, so wait for
+		 * the owner to submit the I/O, and then reap it ourselves.
+		 */
+		if (state == PGAIO_STAGED)
+		{
+			while (pg_atomic_read_u32(&ioh->state) == PGAIO_STAGED)
+				ConditionVariableSleep(&ioh->cv, WAIT_EVENT_BUFFER_IO);
+			ConditionVariableCancelSleep();
+			return true;
+		}
+		if (state == PGAIO_SUBMITTED)
+		{
+			pgaio_uring_wait(ioh);
+			return true;
+		}
+	}
+#endif
+
+	return false;
+}
+
+/*
+ * Wait for an I/O of ours to complete.
+ */
+static void
+pgaio_wait_io(PgAioHandle *ioh)
+{
+	Assert(ioh->owner == MyProc->pgprocno);
+
+	if (pg_atomic_read_u32(&ioh->state) == PGAIO_STAGED)
+		pgaio_submit();
+
+#ifdef USE_IO_URING
+	if (io_method == IOMETHOD_IO_URING)
+	{
+		pgaio_uring_wait(ioh);
+		return;
+	}
+#endif
+
+	while (pg_atomic_read_u32(&ioh->state) == PGAIO_SUBMITTED)
+		ConditionVariableSleep(&ioh->cv, WAIT_EVENT_AIO_IO_COMPLETION);
+	ConditionVariableCancelSleep();
+}
+
+/*
+ * pgaio_wait_all -- submit our staged I/Os, and wait for all our I/Os
+ */
+void
+pgaio_wait_all(void)
+{
+	int			i;
+
+	if (MyAioHandles == NULL)
+		return;
+
+	pgaio_submit();
+
+	for (i = 0; i < io_max_concurrency; i++)
+	{
+		PgAioHandle *ioh = &MyAioHandles[i];
+
+		if (pg_atomic_read_u32(&ioh->state) == PGAIO_SUBMITTED)
+			pgaio_wait_io(ioh);
+		if (pg_atomic_read_u32(&ioh->state) == PGAIO_DONE)
+			pg_atomic_write_u32(&ioh->state, PGAIO_IDLE);
+	}
+}
+
+/*
+ * pgaio_at_error -- clean up our I/Os after an error
+ *
+ * The buffers involved are about to be unpinned, so we must not leave any
+ * I/O running.  Staged I/Os are failed without being performed, since that
+ * could raise another error; the others are waited for.
+ */
+void
+pgaio_at_error(void)
+{
+	int			i;
+
+	if (MyAioHandles == NULL)
+		return;
+
+	for (i = 0; i < io_max_concurrency; i++)
+	{
+		PgAioHandle *ioh = &MyAioHandles[i];
+
+		if (pg_atomic_read_u32(&ioh->state) == PGAIO_STAGED)
+			pgaio_complete(ioh, false);
+	}
+	num_staged = 0;
+
+	pgaio_wait_all();
+}
+
+/*
+ * pgaio_io_block -- memory of the i'th block transferred by an I/O
+ */
+char *
+pgaio_io_block(PgAioHandle *ioh, int i)
+{
+	if (ioh->op == PGAIO_OP_READ)
+		return BufferGetBlock(ioh->buf_ids[i] + 1);
+	else
+		return AioBounceBuffers + (Size) ioh->bounce_ids[i] * BLCKSZ;
+}
+
+/*
+ * pgaio_perform_io -- perform an I/O synchronously
+ *
+ * Errors are thrown as usual; the caller is responsible for completing the
+ * I/O either way.
+ */
+void
+pgaio_perform_io(PgAioHandle *ioh)
+{
+	SMgrRelation reln = smgropen(ioh->rnode, InvalidBackendId);
+	char	   *blocks[PGAIO_MAX_BLOCKS];
+	int			i;
+
+	for (i = 0; i < ioh->nblocks; i++)
+		blocks[i] = pgaio_io_block(ioh, i);
+
+	if (ioh->op == PGAIO_OP_READ)
+		smgrreadv(reln, ioh->forknum, ioh->blocknum, blocks, ioh->nblocks);
+	else
+		smgrwritev(reln, ioh->forknum, ioh->blocknum, blocks, ioh->nblocks,
+				   false);
+}
+
+/*
+ * Perform submitted I/Os in the submitting process.
+ */
+static void
+pgaio_perform_inline(int nios, PgAioHandle **ios)
+{
+	volatile int i = 0;
+
+	PG_TRY();
+	{
+		for (i = 0; i < nios; i++)
+		{
+			pgaio_perform_io(ios[i]);
+			pgaio_complete(ios[i], true);
+		}
+	}
+	PG_CATCH();
+	{
+		/* Fail this and the remaining I/Os, nobody may wait for them forever */
+		for (; i < nios; i++)
+			pgaio_complete(ios[i], false);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+}
+
+/*
+ * pgaio_complete -- finish an I/O, successful or not
+ *
+ * This updates the buffers and wakes up anyone waiting for them or for the
+ * handle.  It can be called by any process.
+ */
+void
+pgaio_complete(PgAioHandle *ioh, bool success)
+{
+	int			i;
+
+	for (i = 0; i < ioh->nblocks; i++)
+		CompleteBufferIO(ioh->buf_ids[i], ioh->op == PGAIO_OP_WRITE, success);
+
+	if (ioh->op == PGAIO_OP_WRITE)
+	{
+		SpinLockAcquire(&AioCtl->mutex);
+		for (i = 0; i < ioh->nblocks; i++)
+		{
+			AioBounceNext[ioh->bounce_ids[i]] = AioCtl->bounce_free;
+			AioCtl->bounce_free = ioh->bounce_ids[i];
+		}
+		AioCtl->bounce_nfree += ioh->nblocks;
+		SpinLockRelease(&AioCtl->mutex);
+	}
+
+	pg_write_barrier();
+	pg_atomic_write_u32(&ioh->state, PGAIO_DONE);
+	ConditionVariableBroadcast(&ioh->cv);
+}
@@ -0,0 +1,473 @@
+/*-------------------------------------------------------------------------
+ *
+ * aio_uring.c
+ *	  Asynchronous I/O with io_uring, used with io_method = io_uring
+ *
+ * Every process gets its own io_uring instance, to which it submits its
+ * I/Os.  The instances are created by the postmaster and inherited by all
+ * child processes, so that any process can reap the completions of any
+ * instance: a process that needs a buffer being read by another process,
+ * which may be busy with something else, reaps the completion itself rather
+ * than waiting for the owner to do it.  Reaping an instance's completions
+ * requires holding its completion lock.
+ *
+ * We use the system calls directly rather than depending on liburing.
+ *
+ * Portions Copyright (c) 1996-2018, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/storage/aio/aio_uring.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "storage/aio.h"
+
+#ifdef USE_IO_URING
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+
+#include "access/twophase.h"
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "storage/aio_internal.h"
+#include "storage/lwlock.h"
+#include "storage/proc.h"
+#include "storage/shmem.h"
+#include "storage/smgr.h"
+#include "utils/memutils.h"
+
+
+/* Process-local view of an io_uring instance */
+typedef struct PgAioUring
+{
+	int			fd;
+
+	/* submission queue */
+	unsigned   *sq_head;
+	unsigned   *sq_tail;
+	unsigned	sq_mask;
+	unsigned   *sq_array;
+	struct io_uring_sqe *sqes;
+
+	/* completion queue */
+	unsigned   *cq_head;
+	unsigned   *cq_tail;
+	unsigned	cq_mask;
+	struct io_uring_cqe *cqes;
+
+	/* the mappings, to undo them */
+	void	   *sq_ring;
+	size_t		sq_ring_size;
+	void	   *cq_ring;
+	size_t		cq_ring_size;
+	size_t		sqes_size;
+} PgAioUring;
+
+/* all instances, one per PGPROC, inherited from the postmaster */
+static PgAioUring *AioUrings = NULL;
+static int	AioNumUrings = 0;
+
+/* completion locks, one per instance */
+static LWLockPadded *AioUringLocks = NULL;
+
+/* I/O vectors, PGAIO_MAX_BLOCKS per handle */
+static struct iovec *AioUringIovecs = NULL;
+
+static int	AioNumProcs(void);
+static bool pgaio_uring_create(PgAioUring *ring, unsigned entries);
+static void pgaio_uring_destroy(PgAioUring *ring);
+static void pgaio_uring_enter(PgAioUring *ring, int nqueued);
+static int	pgaio_uring_get_fd(PgAioHandle *ioh, off_t *offset);
+static int	pgaio_uring_reap(PgAioUring *ring);
+
+
+static int
+sys_io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+	return (int) syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int
+sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+				   unsigned flags)
+{
+	return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+						 flags, NULL, 0);
+}
+
+static int
+AioNumProcs(void)
+{
+	return MaxBackends + NUM_AUXILIARY_PROCS + max_prepared_xacts;
+}
+
+/*
+ * Set up an io_uring instance with room for the given number of I/Os.
+ * Returns false, with errno set, on failure.
+ */
+static bool
+pgaio_uring_create(PgAioUring *ring, unsigned entries)
+{
+	struct io_uring_params p;
+	int			save_errno;
+
+	memset(ring, 0, sizeof(PgAioUring));
+	memset(&p, 0, sizeof(p));
+
+	ring->fd = sys_io_uring_setup(entries, &p);
+	if (ring->fd < 0)
+		return false;
+
+	ring->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	ring->cq_ring_size = p.cq_off.cqes +
+		p.cq_entries * sizeof(struct io_uring_cqe);
+	ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+
+	ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+						 MAP_SHARED | MAP_POPULATE, ring->fd,
+						 IORING_OFF_SQ_RING);
+	if (ring->sq_ring == MAP_FAILED)
+		goto fail;
+	ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+						 MAP_SHARED | MAP_POPULATE, ring->fd,
+						 IORING_OFF_CQ_RING);
+	if (ring->cq_ring == MAP_FAILED)
+		goto fail;
+	ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+					  MAP_SHARED | MAP_POPULATE, ring->fd,
+					  IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED)
+		goto fail;
+
+	ring->sq_head = (unsigned *) ((char *) ring->sq_ring + p.sq_off.head);
+	ring->sq_tail = (unsigned *) ((char *) ring->sq_ring + p.sq_off.tail);
+	ring->sq_mask = *(unsigned *) ((char *) ring->sq_ring + p.sq_off.ring_mask);
+	ring->sq_array = (unsigned *) ((char *) ring->sq_ring + p.sq_off.array);
+
+	ring->cq_head = (unsigned *) ((char *) ring->cq_ring + p.cq_off.head);
+	ring->cq_tail = (unsigned *) ((char *) ring->cq_ring + p.cq_off.tail);
+	ring->cq_mask = *(unsigned *) ((char *) ring->cq_ring + p.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *) ((char *) ring->cq_ring + p.cq_off.cqes);
+
+	return true;
+
+fail:
+	save_errno = errno;
+	pgaio_uring_destroy(ring);
+	errno = save_errno;
+	return false;
+}
+
+static void
+pgaio_uring_destroy(PgAioUring *ring)
+{
+	if (ring->sqes != NULL && ring->sqes != MAP_FAILED)
+		munmap(ring->sqes, ring->sqes_size);
+	if (ring->cq_ring != NULL && ring->cq_ring != MAP_FAILED)
+		munmap(ring->cq_ring, ring->cq_ring_size);
+	if (ring->sq_ring != NULL && ring->sq_ring != MAP_FAILED)
+		munmap(ring->sq_ring, ring->sq_ring_size);
+	if (ring->fd >= 0)
+		close(ring->fd);
+	memset(ring, 0, sizeof(PgAioUring));
+	ring->fd = -1;
+}
+
+/*
+ * Check whether io_uring can be used.  Returns false, with errno set, if not.
+ */
+bool
+pgaio_uring_probe(void)
+{
+	PgAioUring	ring;
+
+	if (!pgaio_uring_create(&ring, io_max_concurrency))
+		return false;
+	pgaio_uring_destroy(&ring);
+	return true;
+}
+
+Size
+pgaio_uring_shmem_size(void)
+{
+	Size		size = 0;
+
+	size = add_size(size, mul_size(AioNumProcs(), sizeof(LWLockPadded)));
+	size = add_size(size, mul_size(mul_size(AioNumProcs(), io_max_concurrency),
+								   PGAIO_MAX_BLOCKS * sizeof(struct iovec)));
+	return size;
+}
+
+void
+pgaio_uring_shmem_init(bool found)
+{
+	int			nprocs = AioNumProcs();
+	bool		foundLocks,
+				foundIovecs;
+	int			i;
+
+	AioUringLocks = (LWLockPadded *)
+		ShmemInitStruct("AIO io_uring Completion Locks",
+						mul_size(nprocs, sizeof(LWLockPadded)),
+						&foundLocks);
+	AioUringIovecs = (struct iovec *)
+		ShmemInitStruct("AIO io_uring Vectors",
+						mul_size(mul_size(nprocs, io_max_concurrency),
+								 PGAIO_MAX_BLOCKS * sizeof(struct iovec)),
+						&foundIovecs);
+
+	if (!found)
+	{
+		for (i = 0; i < nprocs; i++)
+			LWLockInitialize(&AioUringLocks[i].lock,
+							 LWTRANCHE_AIO_URING_COMPLETION);
+	}
+
+	/*
+	 * The postmaster (or a standalone backend) creates the instances, child
+	 * processes inherit them.  After a crash, start over with new ones.
+	 */
+	if (!IsUnderPostmaster)
+	{
+		if (AioUrings != NULL)
+		{
+			for (i = 0; i < AioNumUrings; i++)
+				pgaio_uring_destroy(&AioUrings[i]);
+			pfree(AioUrings);
+		}
+
+		AioUrings = MemoryContextAllocZero(TopMemoryContext,
+										   nprocs * sizeof(PgAioUring));
+		AioNumUrings = nprocs;
+		for (i = 0; i < nprocs; i++)
+		{
+			if (!pgaio_uring_create(&AioUrings[i], io_max_concurrency))
+				ereport(FATAL,
+						(errmsg("could not create io_uring instance: %m"),
+						 errhint("Consider setting io_method to \"worker\".")));
+		}
+	}
+}
+
+/*
+ * pgaio_uring_submit -- submit I/Os to our io_uring instance
+ */
+void
+pgaio_uring_submit(int nios, PgAioHandle **ios)
+{
+	PgAioUring *ring = &AioUrings[MyProc->pgprocno];
+	volatile unsigned tail = *ring->sq_tail;
+	volatile int nqueued = 0;
+	volatile int i = 0;
+	PgAioHandle *prev = NULL;
+
+	PG_TRY();
+	{
+		for (i = 0; i < nios; i++)
+		{
+			PgAioHandle *ioh = ios[i];
+			int			io_id = ioh - AioHandles;
+			struct iovec *iov = &AioUringIovecs[io_id * PGAIO_MAX_BLOCKS];
+			struct io_uring_sqe *sqe;
+			unsigned	idx;
+			off_t		offset;
+			int			fd;
+			int			j;
+
+			/*
+			 * Looking up a different file might open it, and close the files
+			 * whose descriptors the queued entries refer to, to stay within
+			 * max_files_per_process.  So hand those to the kernel first.
+			 * (md.c keeps every RELSEG_SIZE blocks in a separate file.)
+			 */
+			if (nqueued > 0 &&
+				(!RelFileNodeEquals(ioh->rnode, prev->rnode) ||
+				 ioh->forknum != prev->forknum ||
+				 ioh->blocknum / RELSEG_SIZE != prev->blocknum / RELSEG_SIZE))
+			{
+				pg_write_barrier();
+				*ring->sq_tail = tail;
+				pgaio_uring_enter(ring, nqueued);
+				nqueued = 0;
+			}
+			prev = ioh;
+
+			fd = pgaio_uring_get_fd(ioh, &offset);
+
+			for (j = 0; j < ioh->nblocks; j++)
+			{
+				iov[j].iov_base = pgaio_io_block(ioh, j);
+				iov[j].iov_len = BLCKSZ;
+			}
+
+			idx = tail & ring->sq_mask;
+			sqe = &ring->sqes[idx];
+			memset(sqe, 0, sizeof(*sqe));
+			sqe->opcode = (ioh->op == PGAIO_OP_READ) ?
+				IORING_OP_READV : IORING_OP_WRITEV;
+			sqe->fd = fd;
+			sqe->off = offset;
+			sqe->addr = (unsigned long) iov;
+			sqe->len = ioh->nblocks;
+			sqe->user_data = io_id;
+			ring->sq_array[idx] = idx;
+
+			tail++;
+			nqueued++;
+		}
+	}
+	PG_CATCH();
+	{
+		/*
+		 * Submit what we queued before the failure; the entries refer to
+		 * descriptors that are still open.  Fail this and the remaining I/Os,
+		 * so that nobody waits for them forever, and whoever needs the blocks
+		 * retries them synchronously.
+		 */
+		if (nqueued > 0)
+		{
+			pg_write_barrier();
+			*ring->sq_tail = tail;
+			pgaio_uring_enter(ring, nqueued);
+		}
+		for (; i < nios; i++)
+			pgaio_complete(ios[i], false);
+		for (i = 0; i < nios; i++)
+			ConditionVariableBroadcast(&ios[i]->cv);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	if (nqueued > 0)
+	{
+		/* Make the entries visible before the new tail */
+		pg_write_barrier();
+		*ring->sq_tail = tail;
+		pgaio_uring_enter(ring, nqueued);
+	}
+
+	/* Let processes waiting for the I/Os to be submitted reap them now */
+	for (i = 0; i < nios; i++)
+		ConditionVariableBroadcast(&ios[i]->cv);
+}
+
+/*
+ * Hand queued entries to the kernel.
+ */
+static void
+pgaio_uring_enter(PgAioUring *ring, int nqueued)
+{
+	while (nqueued > 0)
+	{
+		int			ret;
+
+		ret = sys_io_uring_enter(ring->fd, nqueued, 0, 0);
+		if (ret < 0)
+		{
+			if (errno == EINTR)
+				continue;
+
+			/* Out of resources for the time being; make room and retry */
+			if (errno == EAGAIN || errno == EBUSY)
+			{
+				LWLock	   *lock = &AioUringLocks[MyProc->pgprocno].lock;
+
+				LWLockAcquire(lock, LW_EXCLUSIVE);
+				(void) pgaio_uring_reap(ring);
+				LWLockRelease(lock);
+				pg_usleep(1000L);
+				continue;
+			}
+
+			/* The entries are already in the ring, there's no way back */
+			ereport(PANIC,
+					(errmsg("could not submit I/O to io_uring: %m")));
+		}
+		nqueued -= ret;
+	}
+}
+
+/*
+ * Resolve the file descriptor and offset for an I/O.  Errors are thrown as
+ * usual.
+ */
+static int
+pgaio_uring_get_fd(PgAioHandle *ioh, off_t *offset)
+{
+	SMgrRelation reln = smgropen(ioh->rnode, InvalidBackendId);
+
+	return smgrfd(reln, ioh->forknum, ioh->blocknum,
+				  ioh->op == PGAIO_OP_WRITE, offset);
+}
+
+/*
+ * Complete the I/Os whose completions have arrived on a ring.  The caller
+ * must hold the ring's completion lock.  Returns the number of I/Os
+ * completed.
+ */
+static int
+pgaio_uring_reap(PgAioUring *ring)
+{
+	unsigned	head = *ring->cq_head;
+	unsigned	tail;
+	int			ncompleted = 0;
+
+	tail = *(volatile unsigned *) ring->cq_tail;
+	pg_read_barrier();
+
+	while (head != tail)
+	{
+		struct io_uring_cqe *cqe = &ring->cqes[head & ring->cq_mask];
+		PgAioHandle *ioh = &AioHandles[cqe->user_data];
+		int32		res = cqe->res;
+
+		/* Release the entry before completing, the kernel may reuse it */
+		head++;
+		pg_memory_barrier();
+		*(volatile unsigned *) ring->cq_head = head;
+
+		/* A short transfer is treated as a failure, see mdread() */
+		pgaio_complete(ioh, res == ioh->nblocks * BLCKSZ);
+		ncompleted++;
+	}
+
+	return ncompleted;
+}
+
+/*
+ * pgaio_uring_wait -- wait for a submitted I/O of any process to complete
+ */
+void
+pgaio_uring_wait(PgAioHandle *ioh)
+{
+	PgAioUring *ring = &AioUrings[ioh->owner];
+	LWLock	   *lock = &AioUringLocks[ioh->owner].lock;
+
+	LWLockAcquire(lock, LW_EXCLUSIVE);
+	while (pg_atomic_read_u32(&ioh->state) == PGAIO_SUBMITTED)
+	{
+		int			ret;
+
+		if (pgaio_uring_reap(ring) > 0)
+			continue;
+
+		pgstat_report_wait_start(WAIT_EVENT_AIO_IO_COMPLETION);
+		ret = sys_io_uring_enter(ring->fd, 0, 1, IORING_ENTER_GETEVENTS);
+		pgstat_report_wait_end();
+
+		if (ret < 0 && errno != EINTR && errno != EAGAIN)
+			ereport(ERROR,
+					(errmsg("could not wait for I/O completion: %m")));
+	}
+	LWLockRelease(lock);
+}
+
+#endif							/* USE_IO_URING */
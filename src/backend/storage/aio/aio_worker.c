@@ -0,0 +1,306 @@
+/*-------------------------------------------------------------------------
+ *
+ * aio_worker.c
+ *	  I/O worker processes, used with io_method = worker
+ *
+ * I/O workers are background workers that perform the I/Os submitted by
+ * other processes, using the regular synchronous smgr routines.  Submitted
+ * handles are put in a queue in shared memory, and idle workers are woken
+ * up through their latches.
+ *
+ * If no worker is running, as in a standalone backend or during the
+ * shutdown checkpoint (which is written after all background workers have
+ * exited), the submitting process performs its I/Os itself.  A worker
+ * asked to shut down first drains the queue, so that nothing submitted
+ * while it was running is left behind.
+ *
+ * Portions Copyright (c) 1996-2018, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/storage/aio/aio_worker.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <signal.h>
+
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "postmaster/bgworker.h"
+#include "storage/aio.h"
+#include "storage/aio_internal.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "storage/proc.h"
+#include "storage/smgr.h"
+#include "storage/spin.h"
+#include "utils/guc.h"
+#include "utils/memutils.h"
+
+
+/* flags set by signal handlers */
+static volatile sig_atomic_t got_SIGHUP = false;
+static volatile sig_atomic_t got_SIGTERM = false;
+
+/* this worker's slot, and the I/O it is performing, if any */
+static int	MyIoWorkerId = -1;
+static PgAioHandle *CurrentIo = NULL;
+
+static PgAioHandle *io_worker_dequeue(void);
+static void io_worker_sighup(SIGNAL_ARGS);
+static void io_worker_sigterm(SIGNAL_ARGS);
+static void io_worker_shutdown(int code, Datum arg);
+
+
+/*
+ * Register the I/O workers with the postmaster.
+ */
+void
+AioRegisterWorkers(void)
+{
+	BackgroundWorker bgw;
+	int			i;
+
+	for (i = 0; i < io_workers; i++)
+	{
+		memset(&bgw, 0, sizeof(bgw));
+		bgw.bgw_flags = BGWORKER_SHMEM_ACCESS;
+		bgw.bgw_start_time = BgWorkerStart_PostmasterStart;
+		snprintf(bgw.bgw_library_name, BGW_MAXLEN, "postgres");
+		snprintf(bgw.bgw_function_name, BGW_MAXLEN, "IoWorkerMain");
+		snprintf(bgw.bgw_name, BGW_MAXLEN, "io worker %d", i);
+		snprintf(bgw.bgw_type, BGW_MAXLEN, "io worker");
+		bgw.bgw_restart_time = 1;
+		bgw.bgw_notify_pid = 0;
+		bgw.bgw_main_arg = Int32GetDatum(i);
+
+		RegisterBackgroundWorker(&bgw);
+	}
+}
+
+/*
+ * pgaio_worker_submit -- queue I/Os for the I/O workers
+ *
+ * Returns false, without queuing anything, if no worker is accepting I/O.
+ */
+bool
+pgaio_worker_submit(int nios, PgAioHandle **ios)
+{
+	Latch	   *wakeup[MAX_IO_WORKERS];
+	int			nwakeup = 0;
+	int			i;
+
+	SpinLockAcquire(&AioCtl->mutex);
+	if (AioCtl->nworkers == 0)
+	{
+		SpinLockRelease(&AioCtl->mutex);
+		return false;
+	}
+
+	/* The queue can hold every handle, so it can't overflow */
+	for (i = 0; i < nios; i++)
+		AioCtl->queue[AioCtl->queue_tail++ % AioCtl->queue_size] =
+			ios[i] - AioHandles;
+
+	/* Wake up as many workers as there are new I/Os, round-robin */
+	for (i = 0; i < MAX_IO_WORKERS && nwakeup < nios; i++)
+	{
+		Latch	   *latch = AioCtl->worker_latches[AioCtl->next_wakeup];
+
+		if (latch != NULL)
+			wakeup[nwakeup++] = latch;
+		AioCtl->next_wakeup = (AioCtl->next_wakeup + 1) % MAX_IO_WORKERS;
+	}
+	SpinLockRelease(&AioCtl->mutex);
+
+	for (i = 0; i < nwakeup; i++)
+		SetLatch(wakeup[i]);
+
+	return true;
+}
+
+/*
+ * Take the next I/O from the queue, or return NULL if it's empty.
+ *
+ * If we've been asked to shut down and there's nothing left to do, stop
+ * accepting I/O.
+ */
+static PgAioHandle *
+io_worker_dequeue(void)
+{
+	PgAioHandle *ioh = NULL;
+
+	SpinLockAcquire(&AioCtl->mutex);
+	if (AioCtl->queue_head != AioCtl->queue_tail)
+		ioh = &AioHandles[AioCtl->queue[AioCtl->queue_head++ %
+										AioCtl->queue_size]];
+	else if (got_SIGTERM)
+	{
+		AioCtl->worker_latches[MyIoWorkerId] = NULL;
+		AioCtl->nworkers--;
+	}
+	SpinLockRelease(&AioCtl->mutex);
+
+	return ioh;
+}
+
+/*
+ * Main entry point for an I/O worker
+ */
+void
+IoWorkerMain(Datum main_arg)
+{
+	MemoryContext io_context;
+	bool		closed_files = true;
+
+	MyIoWorkerId = DatumGetInt32(main_arg);
+	Assert(MyIoWorkerId >= 0 && MyIoWorkerId < MAX_IO_WORKERS);
+
+	pqsignal(SIGHUP, io_worker_sighup);
+	pqsignal(SIGTERM, io_worker_sigterm);
+	BackgroundWorkerUnblockSignals();
+
+	io_context = AllocSetContextCreate(TopMemoryContext,
+									   "I/O worker",
+									   ALLOCSET_DEFAULT_SIZES);
+
+	before_shmem_exit(io_worker_shutdown, (Datum) 0);
+
+	SpinLockAcquire(&AioCtl->mutex);
+	AioCtl->worker_latches[MyIoWorkerId] = MyLatch;
+	AioCtl->nworkers++;
+	SpinLockRelease(&AioCtl->mutex);
+
+	for (;;)
+	{
+		PgAioHandle *ioh;
+		volatile bool failed = false;
+
+		ResetLatch(MyLatch);
+
+		if (got_SIGHUP)
+		{
+			got_SIGHUP = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
+
+		ioh = io_worker_dequeue();
+		if (ioh == NULL)
+		{
+			int			rc;
+
+			if (got_SIGTERM)
+				break;
+
+			/*
+			 * Don't keep files open while idle, the relations might get
+			 * dropped meanwhile.
+			 */
+			if (!closed_files)
+			{
+				smgrcloseall();
+				closed_files = true;
+			}
+
+			rc = WaitLatch(MyLatch,
+						   WL_LATCH_SET | WL_POSTMASTER_DEATH,
+						   -1L,
+						   WAIT_EVENT_IO_WORKER_MAIN);
+			if (rc & WL_POSTMASTER_DEATH)
+				proc_exit(1);
+			continue;
+		}
+
+		CurrentIo = ioh;
+		closed_files = false;
+
+		MemoryContextSwitchTo(io_context);
+		PG_TRY();
+		{
+			pgaio_perform_io(ioh);
+		}
+		PG_CATCH();
+		{
+			/* Report the error, and let the requester retry the I/O */
+			MemoryContextSwitchTo(io_context);
+			EmitErrorReport();
+			FlushErrorState();
+			failed = true;
+		}
+		PG_END_TRY();
+		MemoryContextReset(io_context);
+
+		CurrentIo = NULL;
+		pgaio_complete(ioh, !failed);
+	}
+
+	proc_exit(1);
+}
+
+/*
+ * Before exiting, make sure nobody is left waiting for an I/O that won't
+ * be performed.
+ */
+static void
+io_worker_shutdown(int code, Datum arg)
+{
+	bool		last = false;
+
+	if (CurrentIo != NULL)
+	{
+		pgaio_complete(CurrentIo, false);
+		CurrentIo = NULL;
+	}
+
+	SpinLockAcquire(&AioCtl->mutex);
+	if (AioCtl->worker_latches[MyIoWorkerId] == MyLatch)
+	{
+		AioCtl->worker_latches[MyIoWorkerId] = NULL;
+		AioCtl->nworkers--;
+		last = (AioCtl->nworkers == 0);
+	}
+	SpinLockRelease(&AioCtl->mutex);
+
+	/* If we were the last worker, fail whatever is still queued */
+	while (last)
+	{
+		PgAioHandle *ioh = NULL;
+
+		SpinLockAcquire(&AioCtl->mutex);
+		if (AioCtl->nworkers == 0 && AioCtl->queue_head != AioCtl->queue_tail)
+			ioh = &AioHandles[AioCtl->queue[AioCtl->queue_head++ %
+											AioCtl->queue_size]];
+		SpinLockRelease(&AioCtl->mutex);
+
+		if (ioh == NULL)
+			break;
+		pgaio_complete(ioh, false);
+	}
+}
+
+/* SIGHUP: set flag to reload the configuration file */
+static void
+io_worker_sighup(SIGNAL_ARGS)
+{
+	int			save_errno = errno;
+
+	got_SIGHUP = true;
+	SetLatch(MyLatch);
+
+	errno = save_errno;
+}
+
+/* SIGTERM: set flag to exit once the queue is empty */
+static void
+io_worker_sigterm(SIGNAL_ARGS)
+{
+	int			save_errno = errno;
+
+	got_SIGTERM = true;
+	SetLatch(MyLatch);
+
+	errno = save_errno;
+}
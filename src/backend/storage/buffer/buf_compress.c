@@ -0,0 +1,764 @@
+/*-------------------------------------------------------------------------
+ *
+ * buf_compress.c
+ *	  compressed buffer tier, a second-level cache of clean pages
+ *
+ * With compressed_buffers set, clean pages evicted from shared buffers are
+ * compressed and kept in a separate area of shared memory, and a page read
+ * while it's still there is decompressed instead of being read from disk.
+ * As a compressed page takes a fraction of a block, this makes the cache
+ * effectively larger than the memory it takes.
+ *
+ * The tier is exclusive of shared buffers: a page is removed from it when
+ * it's read back into a buffer, and stored again when that buffer is evicted
+ * again.  So a page in the tier never has a buffer holding a newer version,
+ * and as only clean pages are stored, the disk holds the same version.  The
+ * pages of dropped or truncated relations are removed by bufmgr.c, along
+ * with their buffers.  Pages evicted by a buffer access strategy are not
+ * stored; they're recycled in a small ring for a reason.
+ *
+ * Pages are compressed with pglz, leaving out the hole between pd_lower and
+ * pd_upper as full-page images in WAL do.  A page is only stored if that
+ * takes no more than three quarters of a block, stored uncompressed if it
+ * only fits once the hole is left out.
+ *
+ * The tier is divided into partitions by the hash of the buffer tag, each
+ * with its own lock, entries, hash table and space, so that they can be
+ * used concurrently.  A partition's space is divided into chunks of
+ * CBUF_CHUNK_SIZE bytes, and each page is stored in a chain of them, so the
+ * space doesn't fragment.  When a partition runs out of entries or chunks,
+ * entries are replaced in ring order, first stored first out.  Nothing is
+ * learned by tracking how entries are used, as using one removes it.
+ *
+ * Storing a page is done in three steps, so that bufmgr.c can compress the
+ * page while it holds nothing more than a share lock on the buffer's
+ * contents, and copy it into the tier after letting go of the buffer mapping
+ * locks: CompressedBufferPrepare() compresses it into backend-private memory,
+ * CompressedBufferLockStash() locks the partition while bufmgr.c still holds
+ * the mapping lock, so that nobody can read the page from disk before it's
+ * stored, and CompressedBufferFinishStash() stores it.
+ *
+ * Portions Copyright (c) 1996-2018, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/storage/buffer/buf_compress.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "common/pg_lzcompress.h"
+#include "storage/bufmgr.h"
+#include "storage/buf_internals.h"
+#include "storage/bufpage.h"
+#include "storage/shmem.h"
+
+
+/* pages are stored in chains of chunks of this size */
+#define CBUF_CHUNK_SIZE			(BLCKSZ / 16)
+
+/* most a page may take when stored, and the number of chunks that is */
+#define CBUF_MAX_STORED_SIZE	(BLCKSZ / 4 * 3)
+#define CBUF_MAX_CHUNKS			(CBUF_MAX_STORED_SIZE / CBUF_CHUNK_SIZE)
+
+/* fewest chunks a partition has, whatever compressed_buffers is */
+#define CBUF_MIN_CHUNKS			(CBUF_MAX_CHUNKS * 4)
+
+/* one compressed page */
+typedef struct CBufEntry
+{
+	BufferTag	tag;			/* tag of the page, if used */
+	int32		hashNext;		/* next entry in hash chain, or -1; or next
+								 * free entry, if not used */
+	int32		firstChunk;		/* first chunk of the page's data */
+	uint16		nbytes;			/* length of the stored data */
+	uint16		holeOffset;		/* where the left-out hole was, and */
+	uint16		holeLength;		/* its length */
+	bool		compressed;		/* is the data compressed? */
+	bool		used;			/* does the entry hold a page? */
+} CBufEntry;
+
+typedef struct CBufPartition
+{
+	LWLock		lock;			/* protects everything in the partition */
+	int32		freeEntry;		/* head of the list of free entries */
+	int32		freeChunk;		/* head of the list of free chunks */
+	int32		nfreeChunks;	/* number of free chunks */
+	int32		hand;			/* next entry to replace */
+
+	/* statistics, see CompressedBufferStats */
+	uint64		pages;
+	uint64		bytes;
+	uint64		hits;
+	uint64		misses;
+	uint64		stored;
+	uint64		evicted;
+	pg_atomic_uint64 rejected;	/* updated without the lock */
+} CBufPartition;
+
+/* keep partitions, and their locks, on separate cache lines */
+#define CBUF_PARTITION_PADDED_SIZE	128
+
+typedef union CBufPartitionPadded
+{
+	CBufPartition part;
+	char		pad[CBUF_PARTITION_PADDED_SIZE];
+} CBufPartitionPadded;
+
+/* GUC variable */
+int			compressed_buffers = 0;
+
+/*
+ * Partitions, and their entries, hash buckets, chunk links and chunks, each
+ * an array of per-partition arrays.
+ */
+static CBufPartitionPadded *CBufPartitions = NULL;
+static CBufEntry *CBufEntries = NULL;
+static int32 *CBufBuckets = NULL;
+static int32 *CBufChunkNext = NULL;
+static char *CBufChunks = NULL;
+
+/* per-partition sizes; the number of buckets is a power of 2 */
+static int	CBufNumChunks = 0;
+static int	CBufNumEntries = 0;
+static int	CBufNumBuckets = 0;
+
+#define CBufPartitionOf(hashcode)	((hashcode) % NUM_CBUF_PARTITIONS)
+#define CBufGetPartition(partno)	(&CBufPartitions[partno].part)
+#define CBufGetEntry(partno, i) \
+	(&CBufEntries[(Size) (partno) * CBufNumEntries + (i)])
+#define CBufGetBucket(partno, hashcode) \
+	(&CBufBuckets[(Size) (partno) * CBufNumBuckets + \
+				  (((hashcode) / NUM_CBUF_PARTITIONS) & (CBufNumBuckets - 1))])
+#define CBufGetChunkNext(partno, i) \
+	(&CBufChunkNext[(Size) (partno) * CBufNumChunks + (i)])
+#define CBufGetChunk(partno, i) \
+	(&CBufChunks[((Size) (partno) * CBufNumChunks + (i)) * CBUF_CHUNK_SIZE])
+
+/*
+ * The page prepared by CompressedBufferPrepare() for storing, in
+ * backend-private memory.
+ */
+static struct
+{
+	bool		valid;			/* is a page prepared? */
+	bool		locked;			/* do we hold its partition lock? */
+	BufferTag	tag;
+	uint32		hashcode;
+	uint16		nbytes;
+	uint16		holeOffset;
+	uint16		holeLength;
+	bool		compressed;
+	char		data[PGLZ_MAX_OUTPUT(BLCKSZ)];
+} CBufStash;
+
+static void CompressedBufferSizes(int *nchunks, int *nentries, int *nbuckets);
+static int32 CompressedBufferLookup(int partno, BufferTag *tag,
+					   uint32 hashcode, int32 **prevp);
+static void CompressedBufferRemove(int partno, int32 entno, int32 *prevp);
+static bool CompressedBufferEvictOne(int partno);
+
+
+/*
+ * Compute the per-partition sizes of the tier
+ */
+static void
+CompressedBufferSizes(int *nchunks, int *nentries, int *nbuckets)
+{
+	int64		total = (int64) compressed_buffers * (BLCKSZ / CBUF_CHUNK_SIZE);
+	int			chunks;
+	int			buckets = 1;
+
+	chunks = (int) Min(total / NUM_CBUF_PARTITIONS, INT_MAX / 2);
+	chunks = Max(chunks, CBUF_MIN_CHUNKS);
+
+	/* Allow for pages compressing to two chunks on average */
+	while (buckets < chunks / 2)
+		buckets <<= 1;
+
+	*nchunks = chunks;
+	*nentries = chunks / 2;
+	*nbuckets = buckets;
+}
+
+/*
+ * Estimate space needed for the compressed buffer tier
+ */
+Size
+CompressedBufferShmemSize(void)
+{
+	Size		size = 0;
+	int			nchunks;
+	int			nentries;
+	int			nbuckets;
+
+	if (!CompressedBuffersEnabled())
+		return 0;
+
+	CompressedBufferSizes(&nchunks, &nentries, &nbuckets);
+
+	size = add_size(size, mul_size(NUM_CBUF_PARTITIONS,
+								   sizeof(CBufPartitionPadded)));
+	size = add_size(size, PG_CACHE_LINE_SIZE);
+	size = add_size(size, mul_size(mul_size(NUM_CBUF_PARTITIONS, nentries),
+								   sizeof(CBufEntry)));
+	size = add_size(size, mul_size(mul_size(NUM_CBUF_PARTITIONS, nbuckets),
+								   sizeof(int32)));
+	size = add_size(size, mul_size(mul_size(NUM_CBUF_PARTITIONS, nchunks),
+								   sizeof(int32)));
+	size = add_size(size, mul_size(mul_size(NUM_CBUF_PARTITIONS, nchunks),
+								   CBUF_CHUNK_SIZE));
+
+	return size;
+}
+
+/*
+ * Initialize the compressed buffer tier
+ */
+void
+InitCompressedBuffers(void)
+{
+	char	   *ptr;
+	bool		found;
+	int			partno;
+
+	if (!CompressedBuffersEnabled())
+		return;
+
+	CompressedBufferSizes(&CBufNumChunks, &CBufNumEntries, &CBufNumBuckets);
+
+	ptr = ShmemInitStruct("Compressed Buffers", CompressedBufferShmemSize(),
+						  &found);
+
+	ptr = (char *) CACHELINEALIGN(ptr);
+	CBufPartitions = (CBufPartitionPadded *) ptr;
+	ptr += NUM_CBUF_PARTITIONS * sizeof(CBufPartitionPadded);
+	CBufEntries = (CBufEntry *) ptr;
+	ptr += (Size) NUM_CBUF_PARTITIONS * CBufNumEntries * sizeof(CBufEntry);
+	CBufBuckets = (int32 *) ptr;
+	ptr += (Size) NUM_CBUF_PARTITIONS * CBufNumBuckets * sizeof(int32);
+	CBufChunkNext = (int32 *) ptr;
+	ptr += (Size) NUM_CBUF_PARTITIONS * CBufNumChunks * sizeof(int32);
+	CBufChunks = ptr;
+
+	if (found)
+		return;
+
+	for (partno = 0; partno < NUM_CBUF_PARTITIONS; partno++)
+	{
+		CBufPartition *part = CBufGetPartition(partno);
+		int			i;
+
+		LWLockInitialize(&part->lock, LWTRANCHE_COMPRESSED_BUFFERS);
+
+		for (i = 0; i < CBufNumEntries; i++)
+		{
+			CBufEntry  *ent = CBufGetEntry(partno, i);
+
+			ent->used = false;
+			ent->hashNext = (i + 1 < CBufNumEntries) ? i + 1 : -1;
+		}
+		part->freeEntry = 0;
+
+		for (i = 0; i < CBufNumBuckets; i++)
+			CBufBuckets[(Size) partno * CBufNumBuckets + i] = -1;
+
+		for (i = 0; i < CBufNumChunks; i++)
+			*CBufGetChunkNext(partno, i) = (i + 1 < CBufNumChunks) ? i + 1 : -1;
+		part->freeChunk = 0;
+		part->nfreeChunks = CBufNumChunks;
+
+		part->hand = 0;
+		part->pages = 0;
+		part->bytes = 0;
+		part->hits = 0;
+		part->misses = 0;
+		part->stored = 0;
+		part->evicted = 0;
+		pg_atomic_init_u64(&part->rejected, 0);
+	}
+}
+
+/*
+ * Find the entry of the page with the given tag in a partition, whose lock
+ * the caller holds.  Returns -1 if there is none.  *prevp is set to the link
+ * pointing to the entry, for CompressedBufferRemove.
+ */
+static int32
+CompressedBufferLookup(int partno, BufferTag *tag, uint32 hashcode,
+					   int32 **prevp)
+{
+	int32	   *prev = CBufGetBucket(partno, hashcode);
+
+	while (*prev >= 0)
+	{
+		CBufEntry  *ent = CBufGetEntry(partno, *prev);
+
+		if (BUFFERTAGS_EQUAL(ent->tag, *tag))
+		{
+			*prevp = prev;
+			return *prev;
+		}
+		prev = &ent->hashNext;
+	}
+
+	return -1;
+}
+
+/*
+ * Remove an entry, found by CompressedBufferLookup, freeing its chunks.
+ */
+static void
+CompressedBufferRemove(int partno, int32 entno, int32 *prevp)
+{
+	CBufPartition *part = CBufGetPartition(partno);
+	CBufEntry  *ent = CBufGetEntry(partno, entno);
+	int32		chunk = ent->firstChunk;
+	int			nchunks = 0;
+
+	Assert(ent->used && *prevp == entno);
+
+	/* Unlink it from its hash chain */
+	*prevp = ent->hashNext;
+
+	/* Put its chunks on the freelist */
+	for (;;)
+	{
+		int32	   *next = CBufGetChunkNext(partno, chunk);
+
+		nchunks++;
+		if (*next < 0)
+		{
+			*next = part->freeChunk;
+			break;
+		}
+		chunk = *next;
+	}
+	part->freeChunk = ent->firstChunk;
+	part->nfreeChunks += nchunks;
+
+	part->pages--;
+	part->bytes -= ent->nbytes;
+
+	ent->used = false;
+	ent->hashNext = part->freeEntry;
+	part->freeEntry = entno;
+}
+
+/*
+ * Evict the next entry in ring order from a partition whose lock the caller
+ * holds exclusively.  Returns false if the partition is empty.
+ */
+static bool
+CompressedBufferEvictOne(int partno)
+{
+	CBufPartition *part = CBufGetPartition(partno);
+	int			n;
+
+	for (n = 0; n < CBufNumEntries; n++)
+	{
+		int32		entno = part->hand;
+		CBufEntry  *ent = CBufGetEntry(partno, entno);
+
+		part->hand = (part->hand + 1) % CBufNumEntries;
+
+		if (ent->used)
+		{
+			int32	   *prev;
+
+			if (CompressedBufferLookup(partno, &ent->tag,
+									   BufTableHashCode(&ent->tag),
+									   &prev) != entno)
+				elog(ERROR, "compressed buffer table corrupted");
+			CompressedBufferRemove(partno, entno, prev);
+			part->evicted++;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * CompressedBufferRead -- get a page from the compressed buffer tier
+ *
+ * If the page with the given tag is in the tier, decompress it into page,
+ * remove it from the tier, and return true.  Otherwise return false, and the
+ * caller must read the page from disk.
+ */
+bool
+CompressedBufferRead(BufferTag *tag, char *page)
+{
+	uint32		hashcode;
+	int			partno;
+	CBufPartition *part;
+	CBufEntry  *ent;
+	int32		entno;
+	int32	   *prev;
+	int32		chunk;
+	uint16		nbytes;
+	uint16		holeOffset;
+	uint16		holeLength;
+	bool		compressed;
+	char		data[PGLZ_MAX_OUTPUT(BLCKSZ)];
+	char		image[BLCKSZ];
+	char	   *src;
+	int			off;
+
+	if (!CompressedBuffersEnabled())
+		return false;
+
+	hashcode = BufTableHashCode(tag);
+	partno = CBufPartitionOf(hashcode);
+	part = CBufGetPartition(partno);
+
+	LWLockAcquire(&part->lock, LW_EXCLUSIVE);
+
+	entno = CompressedBufferLookup(partno, tag, hashcode, &prev);
+	if (entno < 0)
+	{
+		part->misses++;
+		LWLockRelease(&part->lock);
+		return false;
+	}
+
+	/* Copy the data out, so that decompressing needn't hold the lock */
+	ent = CBufGetEntry(partno, entno);
+	nbytes = ent->nbytes;
+	holeOffset = ent->holeOffset;
+	holeLength = ent->holeLength;
+	compressed = ent->compressed;
+	chunk = ent->firstChunk;
+	for (off = 0; off < nbytes; off += CBUF_CHUNK_SIZE)
+	{
+		Assert(chunk >= 0);
+		memcpy(data + off, CBufGetChunk(partno, chunk),
+			   Min(CBUF_CHUNK_SIZE, nbytes - off));
+		chunk = *CBufGetChunkNext(partno, chunk);
+	}
+
+	/* The page is going into a buffer, so it mustn't stay here too */
+	CompressedBufferRemove(partno, entno, prev);
+	part->hits++;
+
+	LWLockRelease(&part->lock);
+
+	if (compressed)
+	{
+		src = (holeLength == 0) ? page : image;
+		if (pglz_decompress(data, nbytes, src, BLCKSZ - holeLength) !=
+			BLCKSZ - holeLength)
+		{
+			/* Shouldn't happen, but the disk has the page anyway */
+			elog(WARNING, "could not decompress page %u of relation %u/%u/%u from compressed buffers",
+				 tag->blockNum, tag->rnode.spcNode, tag->rnode.dbNode,
+				 tag->rnode.relNode);
+			return false;
+		}
+	}
+	else
+		src = data;
+
+	/* Put the hole back, or just copy the page into place */
+	if (holeLength == 0)
+	{
+		if (src != page)
+			memcpy(page, src, BLCKSZ);
+	}
+	else
+	{
+		memcpy(page, src, holeOffset);
+		MemSet(page + holeOffset, 0, holeLength);
+		memcpy(page + holeOffset + holeLength, src + holeOffset,
+			   BLCKSZ - (holeOffset + holeLength));
+	}
+
+	return true;
+}
+
+/*
+ * CompressedBufferForget -- remove a page from the compressed buffer tier
+ *
+ * For when the page's buffer is zeroed rather than read.
+ */
+void
+CompressedBufferForget(BufferTag *tag)
+{
+	uint32		hashcode;
+	int			partno;
+	CBufPartition *part;
+	int32		entno;
+	int32	   *prev;
+
+	if (!CompressedBuffersEnabled())
+		return;
+
+	hashcode = BufTableHashCode(tag);
+	partno = CBufPartitionOf(hashcode);
+	part = CBufGetPartition(partno);
+
+	LWLockAcquire(&part->lock, LW_EXCLUSIVE);
+	entno = CompressedBufferLookup(partno, tag, hashcode, &prev);
+	if (entno >= 0)
+		CompressedBufferRemove(partno, entno, prev);
+	LWLockRelease(&part->lock);
+}
+
+/*
+ * CompressedBufferPrepare -- compress a page, to store it in the tier
+ *
+ * The caller must hold at least a share lock on the buffer's contents.
+ * Returns false if the page doesn't compress well enough to be worth
+ * storing; otherwise the caller must call CompressedBufferLockStash next.
+ */
+bool
+CompressedBufferPrepare(BufferTag *tag, char *page)
+{
+	PageHeader	phdr = (PageHeader) page;
+	char		image[BLCKSZ];
+	char	   *src = page;
+	uint16		holeOffset = 0;
+	uint16		holeLength = 0;
+	int32		len;
+
+	Assert(CompressedBuffersEnabled());
+
+	CBufStash.valid = false;
+	CBufStash.locked = false;
+	CBufStash.tag = *tag;
+	CBufStash.hashcode = BufTableHashCode(tag);
+
+	/* Leave out the hole in the middle of the page, if it's a sane one */
+	if (phdr->pd_lower >= SizeOfPageHeaderData &&
+		phdr->pd_lower < phdr->pd_upper &&
+		phdr->pd_upper <= BLCKSZ)
+	{
+		holeOffset = phdr->pd_lower;
+		holeLength = phdr->pd_upper - phdr->pd_lower;
+		memcpy(image, page, holeOffset);
+		memcpy(image + holeOffset, page + holeOffset + holeLength,
+			   BLCKSZ - (holeOffset + holeLength));
+		src = image;
+	}
+
+	len = pglz_compress(src, BLCKSZ - holeLength, CBufStash.data,
+						PGLZ_strategy_default);
+	if (len >= 0 && len <= CBUF_MAX_STORED_SIZE)
+		CBufStash.compressed = true;
+	else if (BLCKSZ - holeLength <= CBUF_MAX_STORED_SIZE)
+	{
+		/* Too little to compress, or incompressible, but small enough */
+		len = BLCKSZ - holeLength;
+		memcpy(CBufStash.data, src, len);
+		CBufStash.compressed = false;
+	}
+	else
+	{
+		CBufPartition *part;
+
+		part = CBufGetPartition(CBufPartitionOf(CBufStash.hashcode));
+		pg_atomic_fetch_add_u64(&part->rejected, 1);
+		return false;
+	}
+
+	CBufStash.nbytes = (uint16) len;
+	CBufStash.holeOffset = holeOffset;
+	CBufStash.holeLength = holeLength;
+	CBufStash.valid = true;
+
+	return true;
+}
+
+/*
+ * CompressedBufferLockStash -- lock the partition for the prepared page
+ *
+ * The caller holds the buffer mapping lock for the page, and must not wait
+ * for the partition lock while doing so, so we give up and forget about the
+ * page if someone else holds it, returning false.  Otherwise the caller must
+ * call CompressedBufferFinishStash next.
+ */
+bool
+CompressedBufferLockStash(void)
+{
+	CBufPartition *part;
+
+	Assert(CBufStash.valid && !CBufStash.locked);
+
+	part = CBufGetPartition(CBufPartitionOf(CBufStash.hashcode));
+	if (!LWLockConditionalAcquire(&part->lock, LW_EXCLUSIVE))
+	{
+		CBufStash.valid = false;
+		return false;
+	}
+
+	CBufStash.locked = true;
+	return true;
+}
+
+/*
+ * CompressedBufferFinishStash -- store the prepared page, if store is true,
+ * and release the partition lock
+ *
+ * The caller must call this as soon as its buffer has been evicted, or if
+ * it turned out that it couldn't be.
+ */
+void
+CompressedBufferFinishStash(bool store)
+{
+	int			partno = CBufPartitionOf(CBufStash.hashcode);
+	CBufPartition *part = CBufGetPartition(partno);
+	int			nchunks;
+	int32		entno;
+	int32	   *prev;
+	CBufEntry  *ent;
+	int32	   *link;
+	int			off;
+
+	Assert(CBufStash.valid && CBufStash.locked);
+	Assert(LWLockHeldByMeInMode(&part->lock, LW_EXCLUSIVE));
+
+	CBufStash.valid = false;
+	CBufStash.locked = false;
+
+	if (!store)
+	{
+		LWLockRelease(&part->lock);
+		return;
+	}
+
+	nchunks = (CBufStash.nbytes + CBUF_CHUNK_SIZE - 1) / CBUF_CHUNK_SIZE;
+
+	/*
+	 * There shouldn't be an entry for the page already, as it was in a
+	 * buffer, but replace it if there is.
+	 */
+	entno = CompressedBufferLookup(partno, &CBufStash.tag, CBufStash.hashcode,
+								   &prev);
+	if (entno >= 0)
+		CompressedBufferRemove(partno, entno, prev);
+
+	/*
+	 * Make room.  This runs while evicting a buffer for some query, so if
+	 * the partition can't hold the page even when empty, just don't keep it.
+	 */
+	while (part->freeEntry < 0 || part->nfreeChunks < nchunks)
+	{
+		if (!CompressedBufferEvictOne(partno))
+		{
+			pg_atomic_fetch_add_u64(&part->rejected, 1);
+			LWLockRelease(&part->lock);
+			return;
+		}
+	}
+
+	entno = part->freeEntry;
+	ent = CBufGetEntry(partno, entno);
+	part->freeEntry = ent->hashNext;
+
+	ent->tag = CBufStash.tag;
+	ent->nbytes = CBufStash.nbytes;
+	ent->holeOffset = CBufStash.holeOffset;
+	ent->holeLength = CBufStash.holeLength;
+	ent->compressed = CBufStash.compressed;
+	ent->used = true;
+
+	/* Copy the data into a chain of free chunks */
+	link = &ent->firstChunk;
+	for (off = 0; off < CBufStash.nbytes; off += CBUF_CHUNK_SIZE)
+	{
+		int32		chunk = part->freeChunk;
+
+		part->freeChunk = *CBufGetChunkNext(partno, chunk);
+		memcpy(CBufGetChunk(partno, chunk), CBufStash.data + off,
+			   Min(CBUF_CHUNK_SIZE, CBufStash.nbytes - off));
+		*link = chunk;
+		link = CBufGetChunkNext(partno, chunk);
+	}
+	*link = -1;
+	part->nfreeChunks -= nchunks;
+
+	prev = CBufGetBucket(partno, CBufStash.hashcode);
+	ent->hashNext = *prev;
+	*prev = entno;
+
+	part->pages++;
+	part->bytes += ent->nbytes;
+	part->stored++;
+
+	LWLockRelease(&part->lock);
+}
+
+/*
+ * CompressedBufferDrop -- remove the pages for which match returns true
+ *
+ * Used when relations are dropped or truncated, like the buffers of the same
+ * pages.  The same rules apply: nobody else may be loading such pages.
+ */
+void
+CompressedBufferDrop(CompressedBufferMatch match, void *arg)
+{
+	int			partno;
+
+	if (!CompressedBuffersEnabled())
+		return;
+
+	for (partno = 0; partno < NUM_CBUF_PARTITIONS; partno++)
+	{
+		CBufPartition *part = CBufGetPartition(partno);
+		int32		i;
+
+		LWLockAcquire(&part->lock, LW_EXCLUSIVE);
+
+		for (i = 0; i < CBufNumBuckets; i++)
+		{
+			int32	   *prev = &CBufBuckets[(Size) partno * CBufNumBuckets + i];
+
+			while (*prev >= 0)
+			{
+				CBufEntry  *ent = CBufGetEntry(partno, *prev);
+
+				if (match(&ent->tag, arg))
+					CompressedBufferRemove(partno, *prev, prev);
+				else
+					prev = &ent->hashNext;
+			}
+		}
+
+		LWLockRelease(&part->lock);
+	}
+}
+
+/*
+ * CompressedBufferStats -- return statistics of each partition of the tier
+ *
+ * Returns the number of partitions, which is 0 if the tier is disabled.
+ * stats must have room for NUM_CBUF_PARTITIONS entries.
+ */
+int
+CompressedBufferStats(CompressedBufferPartitionStats *stats)
+{
+	int			partno;
+
+	if (!CompressedBuffersEnabled())
+		return 0;
+
+	for (partno = 0; partno < NUM_CBUF_PARTITIONS; partno++)
+	{
+		CBufPartition *part = CBufGetPartition(partno);
+
+		LWLockAcquire(&part->lock, LW_SHARED);
+		stats[partno].pages = part->pages;
+		stats[partno].bytes = part->bytes;
+		stats[partno].capacity = (uint64) CBufNumChunks * CBUF_CHUNK_SIZE;
+		stats[partno].hits = part->hits;
+		stats[partno].misses = part->misses;
+		stats[partno].stored = part->stored;
+		stats[partno].evicted = part->evicted;
+		LWLockRelease(&part->lock);
+		stats[partno].rejected = pg_atomic_read_u64(&part->rejected);
+	}
+
+	return NUM_CBUF_PARTITIONS;
+}
@@ -20,7 +20,7 @@
 
 BufferDescPadded *BufferDescriptors;
 char	   *BufferBlocks;
-LWLockMinimallyPadded *BufferIOLWLockArray = NULL;
+ConditionVariableMinimallyPadded *BufferIOCVArray = NULL;
 WritebackContext BackendWritebackContext;
 CkptSortItem *CkptBufferIds;
 
@@ -69,26 +69,30 @@ InitBufferPool(void)
 {
 	bool		foundBufs,
 				foundDescs,
-				foundIOLocks,
+				foundIOCV,
 				foundBufCkpt;
 
+	/* Divide the buffers into buffer nodes, see buf_numa.c */
+	InitBufferNodes();
+
 	/* Align descriptors to a cacheline boundary. */
 	BufferDescriptors = (BufferDescPadded *)
 		ShmemInitStruct("Buffer Descriptors",
 						NBuffers * sizeof(BufferDescPadded),
 						&foundDescs);
 
+	/* Align data pages for direct I/O, see io_direct */
 	BufferBlocks = (char *)
-		ShmemInitStruct("Buffer Blocks",
-						NBuffers * (Size) BLCKSZ, &foundBufs);
+		IOALIGN(ShmemInitStruct("Buffer Blocks",
+								NBuffers * (Size) BLCKSZ + PG_IO_ALIGN_SIZE,
+								&foundBufs));
 
-	/* Align lwlocks to cacheline boundary */
-	BufferIOLWLockArray = (LWLockMinimallyPadded *)
-		ShmemInitStruct("Buffer IO Locks",
-						NBuffers * (Size) sizeof(LWLockMinimallyPadded),
-						&foundIOLocks);
+	/* Align condition variables to cacheline boundary */
+	BufferIOCVArray = (ConditionVariableMinimallyPadded *)
+		ShmemInitStruct("Buffer IO Condition Variables",
+						NBuffers * (Size) sizeof(ConditionVariableMinimallyPadded),
+						&foundIOCV);
 
-	LWLockRegisterTranche(LWTRANCHE_BUFFER_IO_IN_PROGRESS, "buffer_io");
 	LWLockRegisterTranche(LWTRANCHE_BUFFER_CONTENT, "buffer_content");
 
 	/*
@@ -102,16 +106,26 @@ InitBufferPool(void)
 		ShmemInitStruct("Checkpoint BufferIds",
 						NBuffers * sizeof(CkptSortItem), &foundBufCkpt);
 
-	if (foundDescs || foundBufs || foundIOLocks || foundBufCkpt)
+	if (foundDescs || foundBufs || foundIOCV || foundBufCkpt)
 	{
 		/* should find all of these, or none of them */
-		Assert(foundDescs && foundBufs && foundIOLocks && foundBufCkpt);
+		Assert(foundDescs && foundBufs && foundIOCV && foundBufCkpt);
 		/* note: this path is only taken in EXEC_BACKEND case */
 	}
 	else
 	{
 		int			i;
 
+		/*
+		 * Place the buffer nodes' memory before touching it for the first
+		 * time.
+		 */
+		PlaceBufferNodesMemory((char *) BufferDescriptors,
+							   sizeof(BufferDescPadded));
+		PlaceBufferNodesMemory(BufferBlocks, BLCKSZ);
+		PlaceBufferNodesMemory((char *) BufferIOCVArray,
+							   sizeof(ConditionVariableMinimallyPadded));
+
 		/*
 		 * Initialize all the buffer headers.
 		 */
@@ -123,28 +137,31 @@ InitBufferPool(void)
 
 			pg_atomic_init_u32(&buf->state, 0);
 			buf->wait_backend_pid = 0;
+			buf->io_handle = -1;
 
 			buf->buf_id = i;
 
 			/*
-			 * Initially link all the buffers together as unused. Subsequent
-			 * management of this list is done by freelist.c.
+			 * Initially link all the buffers of each buffer node together as
+			 * unused. Subsequent management of these lists is done by
+			 * freelist.c.
 			 */
-			buf->freeNext = i + 1;
+			if (i == BufferNodeFirst(BufferNodeOf(i)) +
+				BufferNodeSize(BufferNodeOf(i)) - 1)
+				buf->freeNext = FREENEXT_END_OF_LIST;
+			else
+				buf->freeNext = i + 1;
 
 			LWLockInitialize(BufferDescriptorGetContentLock(buf),
 							 LWTRANCHE_BUFFER_CONTENT);
 
-			LWLockInitialize(BufferDescriptorGetIOLock(buf),
-							 LWTRANCHE_BUFFER_IO_IN_PROGRESS);
+			ConditionVariableInit(BufferDescriptorGetIOCV(buf));
 		}
-
-		/* Correct last entry of linked list */
-		GetBufferDescriptor(NBuffers - 1)->freeNext = FREENEXT_END_OF_LIST;
 	}
 
 	/* Init other shared buffer-management stuff */
 	StrategyInitialize(!foundDescs);
+	InitCompressedBuffers();
 
 	/* Initialize per-backend file flush context */
 	WritebackContextInit(&BackendWritebackContext,
@@ -162,6 +179,9 @@ BufferShmemSize(void)
 {
 	Size		size = 0;
 
+	/* size of the buffer node layout */
+	size = add_size(size, BufferNodesShmemSize());
+
 	/* size of buffer descriptors */
 	size = add_size(size, mul_size(NBuffers, sizeof(BufferDescPadded)));
 	/* to allow aligning buffer descriptors */
@@ -169,25 +189,30 @@ BufferShmemSize(void)
 
 	/* size of data pages */
 	size = add_size(size, mul_size(NBuffers, BLCKSZ));
+	/* to allow aligning data pages */
+	size = add_size(size, PG_IO_ALIGN_SIZE);
 
 	/* size of stuff controlled by freelist.c */
 	size = add_size(size, StrategyShmemSize());
 
 	/*
-	 * It would be nice to include the I/O locks in the BufferDesc, but that
-	 * would increase the size of a BufferDesc to more than one cache line,
-	 * and benchmarking has shown that keeping every BufferDesc aligned on a
-	 * cache line boundary is important for performance.  So, instead, the
-	 * array of I/O locks is allocated in a separate tranche.  Because those
-	 * locks are not highly contentended, we lay out the array with minimal
-	 * padding.
+	 * It would be nice to include the I/O condition variables in the
+	 * BufferDesc, but that would increase the size of a BufferDesc to more
+	 * than one cache line, and benchmarking has shown that keeping every
+	 * BufferDesc aligned on a cache line boundary is important for
+	 * performance.  So, instead, the array of I/O condition variables is
+	 * allocated separately.  Because they are not highly contended, we lay
+	 * out the array with minimal padding.
 	 */
-	size = add_size(size, mul_size(NBuffers, sizeof(LWLockMinimallyPadded)));
+	size = add_size(size, mul_size(NBuffers, sizeof(ConditionVariableMinimallyPadded)));
 	/* to allow aligning the above */
 	size = add_size(size, PG_CACHE_LINE_SIZE);
 
 	/* size of checkpoint sort array in bufmgr.c */
 	size = add_size(size, mul_size(NBuffers, sizeof(CkptSortItem)));
 
+	/* size of the compressed buffer tier */
+	size = add_size(size, CompressedBufferShmemSize());
+
 	return size;
 }
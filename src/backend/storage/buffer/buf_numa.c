@@ -0,0 +1,322 @@
+/*-------------------------------------------------------------------------
+ *
+ * buf_numa.c
+ *	  placement of shared buffers on NUMA nodes
+ *
+ * On a machine with several NUMA nodes, memory of a node other than the one
+ * a process runs on is slower to access.  Without any placement, the kernel
+ * puts each page of shared memory on the node of whichever process happens
+ * to touch it first, which at startup is the postmaster, so all of shared
+ * buffers tends to end up on one node.
+ *
+ * With numa_buffers, the buffers are divided into one "buffer node" per NUMA
+ * node, a range of consecutive buffers whose data pages, descriptors and
+ * I/O condition variables are all placed on that NUMA node's memory.  Each
+ * buffer node has its own freelist and clock sweep (see freelist.c), and a
+ * process looking for a buffer to use prefers the buffer node of the NUMA
+ * node it's running on.  The ranges are made a whole number of memory
+ * pages, huge pages if they're used, so that no page is shared by two
+ * buffer nodes.
+ *
+ * We use the mbind() and getcpu() system calls directly rather than
+ * depending on libnuma.  Without numa_buffers, or where those aren't
+ * available, there's a single buffer node covering all buffers.
+ *
+ * For testing on machines with a single NUMA node, debug_buffer_nodes
+ * divides shared buffers into that many buffer nodes without placing them
+ * anywhere, and spreads processes over them by process ID.
+ *
+ * Portions Copyright (c) 1996-2018, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/storage/buffer/buf_numa.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#ifdef HAVE_LINUX_MEMPOLICY_H
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/mempolicy.h>
+#endif
+
+#include "miscadmin.h"
+#include "storage/bufmgr.h"
+#include "storage/buf_internals.h"
+#include "storage/fd.h"
+#include "storage/pg_shmem.h"
+#include "storage/shmem.h"
+
+
+/* highest NUMA node number we can place memory on, plus one */
+#define MAX_NUMA_NODE_ID	1024
+
+/* GUC variables */
+bool		numa_buffers = false;
+int			debug_buffer_nodes = 0;
+
+BufferNodeLayout *BufferNodes = NULL;
+
+#ifdef USE_NUMA_BUFFERS
+/* size of the memory pages the buffer node ranges are aligned to */
+static Size BufferNodePageSize = 0;
+
+static int	GetOnlineNumaNodes(int *nodes, int max_nodes);
+#endif
+
+
+/*
+ * Estimate space needed for the buffer node layout
+ */
+Size
+BufferNodesShmemSize(void)
+{
+	return MAXALIGN(sizeof(BufferNodeLayout));
+}
+
+#ifdef USE_NUMA_BUFFERS
+/*
+ * Get the numbers of the online NUMA nodes, up to max_nodes of them, from
+ * sysfs.  Returns the number of nodes found, or 0 if that fails.
+ */
+static int
+GetOnlineNumaNodes(int *nodes, int max_nodes)
+{
+	FILE	   *fp;
+	char		buf[1024];
+	char	   *p;
+	int			n = 0;
+
+	fp = AllocateFile("/sys/devices/system/node/online", "r");
+	if (fp == NULL)
+		return 0;
+	if (fgets(buf, sizeof(buf), fp) == NULL)
+	{
+		FreeFile(fp);
+		return 0;
+	}
+	FreeFile(fp);
+
+	/* The format is a list of ranges, like "0-3,6" */
+	p = buf;
+	while (*p != '\0' && *p != '\n')
+	{
+		char	   *end;
+		long		first;
+		long		last;
+
+		first = strtol(p, &end, 10);
+		if (end == p)
+			return 0;
+		last = first;
+		p = end;
+		if (*p == '-')
+		{
+			p++;
+			last = strtol(p, &end, 10);
+			if (end == p)
+				return 0;
+			p = end;
+		}
+		if (*p == ',')
+			p++;
+
+		for (; first <= last && first < MAX_NUMA_NODE_ID; first++)
+		{
+			if (n >= max_nodes)
+				return n;
+			nodes[n++] = (int) first;
+		}
+	}
+
+	return n;
+}
+#endif							/* USE_NUMA_BUFFERS */
+
+/*
+ * Initialize the buffer node layout
+ *
+ * This must be done before anything else in shared buffers is initialized,
+ * as everything depends on the layout.
+ */
+void
+InitBufferNodes(void)
+{
+	bool		found;
+
+	BufferNodes = (BufferNodeLayout *)
+		ShmemInitStruct("Buffer Node Layout", sizeof(BufferNodeLayout),
+						&found);
+	if (found)
+		return;
+
+	/* Default: a single buffer node, not placed anywhere in particular */
+	BufferNodes->numNodes = 1;
+	BufferNodes->buffersPerNode = NBuffers;
+	BufferNodes->numaNode[0] = -1;
+
+	/* Or as many as requested for testing, not placed either */
+	if (debug_buffer_nodes > 1 && !numa_buffers)
+	{
+		int			nnodes = Min(debug_buffer_nodes, NBuffers);
+		int			i;
+
+		BufferNodes->numNodes = nnodes;
+		BufferNodes->buffersPerNode = NBuffers / nnodes;
+		for (i = 0; i < nnodes; i++)
+			BufferNodes->numaNode[i] = -1;
+		return;
+	}
+
+#ifdef USE_NUMA_BUFFERS
+	if (numa_buffers)
+	{
+		int			nodes[MAX_BUFFER_NODES];
+		int			nnodes;
+		int			per_page;
+		int			per_node;
+		int			i;
+
+		nnodes = GetOnlineNumaNodes(nodes, MAX_BUFFER_NODES);
+		if (nnodes < 2)
+		{
+			ereport(LOG,
+					(errmsg("not placing shared buffers on NUMA nodes, as only one NUMA node is online")));
+			return;
+		}
+
+		/*
+		 * Each buffer node's data pages must span whole memory pages.  We
+		 * don't know whether huge pages could actually be allocated when
+		 * huge_pages is "try", but a huge page boundary is a boundary of a
+		 * normal page too.
+		 */
+		BufferNodePageSize = sysconf(_SC_PAGESIZE);
+#if defined(MAP_HUGETLB) && !defined(EXEC_BACKEND)
+		if (huge_pages != HUGE_PAGES_OFF)
+		{
+			int			mmap_flags;
+
+			GetHugePageSize(&BufferNodePageSize, &mmap_flags);
+		}
+#endif
+		per_page = Max(BufferNodePageSize / BLCKSZ, 1);
+		per_node = (NBuffers / nnodes) / per_page * per_page;
+		if (per_node == 0)
+		{
+			ereport(LOG,
+					(errmsg("not placing shared buffers on NUMA nodes, as shared_buffers is too small")));
+			return;
+		}
+
+		BufferNodes->numNodes = nnodes;
+		BufferNodes->buffersPerNode = per_node;
+		for (i = 0; i < nnodes; i++)
+			BufferNodes->numaNode[i] = nodes[i];
+
+		ereport(LOG,
+				(errmsg("placing shared buffers on %d NUMA nodes", nnodes)));
+	}
+#endif							/* USE_NUMA_BUFFERS */
+}
+
+/*
+ * Place an array with an element of the given size for every buffer on the
+ * NUMA nodes, each buffer node's elements on its own NUMA node.
+ *
+ * This only sets the memory policy; the pages are allocated on the NUMA node
+ * when they're first touched, so this must be done before the array is
+ * initialized.  Pages that also hold elements of the neighbouring buffer
+ * node are left alone.
+ */
+void
+PlaceBufferNodesMemory(char *base, Size stride)
+{
+#ifdef USE_NUMA_BUFFERS
+	int			node;
+
+	for (node = 0; node < NumBufferNodes(); node++)
+	{
+		unsigned long nodemask[MAX_NUMA_NODE_ID / (8 * sizeof(unsigned long))];
+		int			numa_node = BufferNodes->numaNode[node];
+		uintptr_t	start;
+		uintptr_t	end;
+
+		if (numa_node < 0)
+			continue;
+
+		start = TYPEALIGN(BufferNodePageSize,
+						  base + BufferNodeFirst(node) * stride);
+		end = TYPEALIGN_DOWN(BufferNodePageSize,
+							 base + (BufferNodeFirst(node) +
+									 BufferNodeSize(node)) * stride);
+		if (end <= start)
+			continue;
+
+		memset(nodemask, 0, sizeof(nodemask));
+		nodemask[numa_node / (8 * sizeof(unsigned long))] |=
+			1UL << (numa_node % (8 * sizeof(unsigned long)));
+
+		/*
+		 * Prefer the node, rather than insist on it, so that we don't fail
+		 * when its memory runs out.  The kernel ignores the last bit of the
+		 * mask, hence the + 1.
+		 */
+		if (syscall(SYS_mbind, (void *) start, (unsigned long) (end - start),
+					MPOL_PREFERRED, nodemask, MAX_NUMA_NODE_ID + 1, 0) != 0)
+		{
+			ereport(WARNING,
+					(errmsg("could not place shared buffers on NUMA node %d: %m",
+							numa_node)));
+			return;
+		}
+	}
+#endif							/* USE_NUMA_BUFFERS */
+}
+
+/*
+ * Return the number of buffer nodes, for use outside the buffer manager
+ */
+int
+BufferNodeCount(void)
+{
+	return NumBufferNodes();
+}
+
+/*
+ * Return the buffer node of the NUMA node the calling process is currently
+ * running on, or 0 if that isn't known.  With buffer nodes that aren't
+ * placed on NUMA nodes (debug_buffer_nodes), pick one by process ID.
+ */
+int
+CurrentBufferNode(void)
+{
+#ifdef USE_NUMA_BUFFERS
+	unsigned	cpu;
+	unsigned	numa_node;
+	int			node;
+#endif
+
+	if (NumBufferNodes() == 1)
+		return 0;
+
+	if (BufferNodes->numaNode[0] < 0)
+		return MyProcPid % NumBufferNodes();
+
+#ifdef USE_NUMA_BUFFERS
+	if (syscall(SYS_getcpu, &cpu, &numa_node, NULL) != 0)
+		return 0;
+
+	for (node = 0; node < NumBufferNodes(); node++)
+	{
+		if (BufferNodes->numaNode[node] == (int) numa_node)
+			return node;
+	}
+#endif							/* USE_NUMA_BUFFERS */
+
+	return 0;
+}
@@ -7,7 +7,19 @@
  * must hold a suitable lock on the appropriate BufMappingLock, as specified
  * in the comments.  We can't do the locking inside these functions because
  * in most cases the caller needs to adjust the buffer header contents
- * before the lock is released (see notes in README).
+ * before the lock is released (see notes in README).  The exception is
+ * BufTableLookupUnlocked, which can be used without any lock, but may give
+ * a wrong answer.
+ *
+ * The table is a fixed-size open-addressing hash table in shared memory,
+ * made of one region per BufMappingLock partition, so that each region is
+ * only ever modified under its own partition lock.  Within a region we use
+ * linear probing, and entries are deleted by shifting the following entries
+ * of the same probe sequence back, so there are no tombstones and a lookup
+ * can stop at the first unused slot.  Entries are copied around with plain
+ * stores; a reader that doesn't hold the lock can see a half-written entry,
+ * or miss an entry that's being moved, but never sees a buffer ID that isn't
+ * valid.
  *
  *
  * Portions Copyright (c) 1996-2018, PostgreSQL Global Development Group
@@ -21,19 +33,61 @@
  */
 #include "postgres.h"
 
+#include "access/hash.h"
 #include "storage/bufmgr.h"
 #include "storage/buf_internals.h"
+#include "storage/shmem.h"
 
 
 /* entry for buffer lookup hashtable */
 typedef struct
 {
 	BufferTag	key;			/* Tag of a disk page */
-	int			id;				/* Associated buffer ID */
+	uint32		hashcode;		/* hash code of key */
+	int			id;				/* Associated buffer ID, or -1 if unused */
 } BufferLookupEnt;
 
-static HTAB *SharedBufHash;
+/* shared state: number of entries in each partition, then the entries */
+typedef struct
+{
+	int			nentries[NUM_BUFFER_PARTITIONS];
+	BufferLookupEnt entries[FLEXIBLE_ARRAY_MEMBER];
+} BufferLookupTable;
+
+static BufferLookupTable *SharedBufTable;
+
+/* slots per partition, minus one; a power of 2 minus one */
+static uint32 BufTableMask;
+
+static uint32 BufTableSlotsPerPartition(int size);
+
+/* the first slot of hashcode's partition, and its first slot to probe */
+#define BufTablePartitionSlots(hashcode) \
+	(&SharedBufTable->entries[(Size) BufTableHashPartition(hashcode) * \
+							  (BufTableMask + 1)])
+#define BufTableHomeSlot(hashcode) \
+	(((hashcode) / NUM_BUFFER_PARTITIONS) & BufTableMask)
+
 
+/*
+ * Number of slots to allocate per partition, for a table of size entries.
+ *
+ * The tags are spread over the partitions by their hash code, so a partition
+ * can get somewhat more than its share; leave room for that, and keep the
+ * load factor below 3/4 even then.
+ */
+static uint32
+BufTableSlotsPerPartition(int size)
+{
+	uint32		per_partition = size / NUM_BUFFER_PARTITIONS + 1;
+	uint32		slots = 1;
+
+	per_partition += per_partition / 4 + 64;
+	while (slots < per_partition + per_partition / 3)
+		slots <<= 1;
+
+	return slots;
+}
 
 /*
  * Estimate space needed for mapping hashtable
@@ -42,7 +96,10 @@ static HTAB *SharedBufHash;
 Size
 BufTableShmemSize(int size)
 {
-	return hash_estimate_size(size, sizeof(BufferLookupEnt));
+	return add_size(offsetof(BufferLookupTable, entries),
+					mul_size(mul_size(BufTableSlotsPerPartition(size),
+									  NUM_BUFFER_PARTITIONS),
+							 sizeof(BufferLookupEnt)));
 }
 
 /*
@@ -52,19 +109,25 @@ BufTableShmemSize(int size)
 void
 InitBufTable(int size)
 {
-	HASHCTL		info;
+	uint32		nslots = BufTableSlotsPerPartition(size);
+	bool		found;
 
 	/* assume no locking is needed yet */
 
-	/* BufferTag maps to Buffer */
-	info.keysize = sizeof(BufferTag);
-	info.entrysize = sizeof(BufferLookupEnt);
-	info.num_partitions = NUM_BUFFER_PARTITIONS;
+	SharedBufTable = (BufferLookupTable *)
+		ShmemInitStruct("Shared Buffer Lookup Table",
+						BufTableShmemSize(size), &found);
+	BufTableMask = nslots - 1;
 
-	SharedBufHash = ShmemInitHash("Shared Buffer Lookup Table",
-								  size, size,
-								  &info,
-								  HASH_ELEM | HASH_BLOBS | HASH_PARTITION);
+	if (!found)
+	{
+		Size		i;
+
+		for (i = 0; i < NUM_BUFFER_PARTITIONS; i++)
+			SharedBufTable->nentries[i] = 0;
+		for (i = 0; i < (Size) nslots * NUM_BUFFER_PARTITIONS; i++)
+			SharedBufTable->entries[i].id = -1;
+	}
 }
 
 /*
@@ -79,7 +142,8 @@ InitBufTable(int size)
 uint32
 BufTableHashCode(BufferTag *tagPtr)
 {
-	return get_hash_value(SharedBufHash, (void *) tagPtr);
+	return DatumGetUInt32(hash_any((unsigned char *) tagPtr,
+								   sizeof(BufferTag)));
 }
 
 /*
@@ -91,19 +155,51 @@ BufTableHashCode(BufferTag *tagPtr)
 int
 BufTableLookup(BufferTag *tagPtr, uint32 hashcode)
 {
-	BufferLookupEnt *result;
+	BufferLookupEnt *slots = BufTablePartitionSlots(hashcode);
+	uint32		i = BufTableHomeSlot(hashcode);
+
+	for (;;)
+	{
+		BufferLookupEnt *ent = &slots[i];
+
+		if (ent->id < 0)
+			return -1;
+		if (ent->hashcode == hashcode && BUFFERTAGS_EQUAL(ent->key, *tagPtr))
+			return ent->id;
+		i = (i + 1) & BufTableMask;
+	}
+}
+
+/*
+ * BufTableLookupUnlocked
+ *		Lookup the given BufferTag without holding the BufMappingLock
+ *
+ * Like BufTableLookup, but concurrent insertions and deletions can make the
+ * result wrong either way.  A caller that finds a buffer must pin it and
+ * check that it holds the tag, and must repeat the lookup with the lock held
+ * if the tag isn't found, unless a wrong answer is harmless.
+ */
+int
+BufTableLookupUnlocked(BufferTag *tagPtr, uint32 hashcode)
+{
+	volatile BufferLookupEnt *slots = BufTablePartitionSlots(hashcode);
+	uint32		i = BufTableHomeSlot(hashcode);
+	uint32		n;
 
-	result = (BufferLookupEnt *)
-		hash_search_with_hash_value(SharedBufHash,
-									(void *) tagPtr,
-									hashcode,
-									HASH_FIND,
-									NULL);
+	/* Entries keep moving, so don't trust that we'll reach a free slot */
+	for (n = 0; n <= BufTableMask; n++)
+	{
+		volatile BufferLookupEnt *ent = &slots[i];
+		int			id = ent->id;
 
-	if (!result)
-		return -1;
+		if (id < 0)
+			return -1;
+		if (ent->hashcode == hashcode && BUFFERTAGS_EQUAL(ent->key, *tagPtr))
+			return id;
+		i = (i + 1) & BufTableMask;
+	}
 
-	return result->id;
+	return -1;
 }
 
 /*
@@ -119,23 +215,37 @@ BufTableLookup(BufferTag *tagPtr, uint32 hashcode)
 int
 BufTableInsert(BufferTag *tagPtr, uint32 hashcode, int buf_id)
 {
-	BufferLookupEnt *result;
-	bool		found;
+	BufferLookupEnt *slots = BufTablePartitionSlots(hashcode);
+	int		   *nentries = &SharedBufTable->nentries[BufTableHashPartition(hashcode)];
+	uint32		i = BufTableHomeSlot(hashcode);
+	BufferLookupEnt *ent;
 
 	Assert(buf_id >= 0);		/* -1 is reserved for not-in-table */
 	Assert(tagPtr->blockNum != P_NEW);	/* invalid tag */
 
-	result = (BufferLookupEnt *)
-		hash_search_with_hash_value(SharedBufHash,
-									(void *) tagPtr,
-									hashcode,
-									HASH_ENTER,
-									&found);
+	for (;;)
+	{
+		ent = &slots[i];
+		if (ent->id < 0)
+			break;
+		if (ent->hashcode == hashcode && BUFFERTAGS_EQUAL(ent->key, *tagPtr))
+			return ent->id;		/* found something already in the table */
+		i = (i + 1) & BufTableMask;
+	}
 
-	if (found)					/* found something already in the table */
-		return result->id;
+	/* Always leave a free slot, so that lookups terminate */
+	if (*nentries >= (int) BufTableMask)
+		ereport(ERROR,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of shared memory"),
+				 errdetail("The shared buffer lookup table is full.")));
 
-	result->id = buf_id;
+	/* Fill in the entry before making it visible to unlocked readers */
+	ent->key = *tagPtr;
+	ent->hashcode = hashcode;
+	pg_write_barrier();
+	ent->id = buf_id;
+	(*nentries)++;
 
 	return -1;
 }
@@ -149,15 +259,47 @@ BufTableInsert(BufferTag *tagPtr, uint32 hashcode, int buf_id)
 void
 BufTableDelete(BufferTag *tagPtr, uint32 hashcode)
 {
-	BufferLookupEnt *result;
+	BufferLookupEnt *slots = BufTablePartitionSlots(hashcode);
+	uint32		hole = BufTableHomeSlot(hashcode);
+	uint32		i;
+
+	for (;;)
+	{
+		BufferLookupEnt *ent = &slots[hole];
+
+		if (ent->id < 0)		/* shouldn't happen */
+			elog(ERROR, "shared buffer hash table corrupted");
+		if (ent->hashcode == hashcode && BUFFERTAGS_EQUAL(ent->key, *tagPtr))
+			break;
+		hole = (hole + 1) & BufTableMask;
+	}
+
+	/*
+	 * Move later entries of the probe sequence into the hole, as long as that
+	 * doesn't put them before their home slot.
+	 */
+	i = hole;
+	for (;;)
+	{
+		BufferLookupEnt *ent;
+		uint32		home;
+
+		i = (i + 1) & BufTableMask;
+		ent = &slots[i];
+		if (ent->id < 0)
+			break;
 
-	result = (BufferLookupEnt *)
-		hash_search_with_hash_value(SharedBufHash,
-									(void *) tagPtr,
-									hashcode,
-									HASH_REMOVE,
-									NULL);
+		home = BufTableHomeSlot(ent->hashcode);
+		if (hole <= i ? (home <= hole || home > i) : (home <= hole && home > i))
+		{
+			slots[hole].key = ent->key;
+			slots[hole].hashcode = ent->hashcode;
+			pg_write_barrier();
+			slots[hole].id = ent->id;
+			hole = i;
+		}
+	}
 
-	if (!result)				/* shouldn't happen */
-		elog(ERROR, "shared buffer hash table corrupted");
+	slots[hole].id = -1;
+	SharedBufTable->nentries[BufTableHashPartition(hashcode)]--;
 }
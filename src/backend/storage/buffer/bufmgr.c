@@ -42,12 +42,14 @@
 #include "pg_trace.h"
 #include "pgstat.h"
 #include "postmaster/bgwriter.h"
+#include "storage/aio.h"
 #include "storage/buf_internals.h"
 #include "storage/bufmgr.h"
 #include "storage/ipc.h"
 #include "storage/proc.h"
 #include "storage/smgr.h"
 #include "storage/standby.h"
+#include "utils/memutils.h"
 #include "utils/rel.h"
 #include "utils/resowner_private.h"
 #include "utils/timestamp.h"
@@ -67,6 +69,14 @@
 
 #define DROP_RELS_BSEARCH_THRESHOLD		20
 
+/* the relations being dropped, for DropRelFileNodesMatch */
+typedef struct DropRelFileNodesArg
+{
+	RelFileNode *nodes;
+	int			nnodes;
+	bool		use_bsearch;
+} DropRelFileNodesArg;
+
 typedef struct PrivateRefCountEntry
 {
 	Buffer		buffer;
@@ -76,6 +86,25 @@ typedef struct PrivateRefCountEntry
 /* 64 bytes, about the size of a cache line on common systems */
 #define REFCOUNT_ARRAY_ENTRIES 8
 
+/*
+ * Information BgBufferSyncNode saves between calls for each buffer node, so
+ * it can determine the strategy point's advance rate and avoid scanning
+ * already-cleaned buffers.
+ */
+typedef struct BgWriterNodeState
+{
+	bool		initialized;
+	bool		saved_info_valid;
+	int			prev_strategy_buf_id;
+	uint32		prev_strategy_passes;
+	int			next_to_clean;
+	uint32		next_passes;
+
+	/* Moving averages of allocation rate and clean-buffer density */
+	float		smoothed_alloc;
+	float		smoothed_density;
+} BgWriterNodeState;
+
 /*
  * Status of buffers to checkpoint for a particular tablespace, used
  * internally in BufferSync.
@@ -108,6 +137,7 @@ typedef struct CkptTsStatus
 bool		zero_damaged_pages = false;
 int			bgwriter_lru_maxpages = 100;
 double		bgwriter_lru_multiplier = 2.0;
+bool		bgwriter_evict = false;
 bool		track_io_timing = false;
 int			effective_io_concurrency = 0;
 
@@ -132,6 +162,24 @@ int			target_prefetch_pages = 0;
 static BufferDesc *InProgressBuf = NULL;
 static bool IsForInput;
 
+/*
+ * Buffers marked BM_IO_IN_PROGRESS by StartReadBuffers, whose reads haven't
+ * been handed to the AIO subsystem (or performed, with io_method = sync) yet.
+ * They hold consecutive blocks.
+ */
+static int	PendingReadBufIds[PGAIO_MAX_BLOCKS];
+static int	nPendingReads = 0;
+
+/*
+ * Buffers of consecutive blocks marked BM_IO_IN_PROGRESS by SyncBufferRun,
+ * whose write hasn't been performed or handed to the AIO subsystem yet.
+ */
+static int	PendingWriteBufIds[PGAIO_MAX_BLOCKS];
+static int	nPendingWrites = 0;
+
+/* Space for the page images written by SyncBufferRun */
+static char *WriteRunPages = NULL;
+
 /* local state for LockBufferForCleanup */
 static BufferDesc *PinCountWaitBuf = NULL;
 
@@ -171,6 +219,9 @@ static int32 PrivateRefCountOverflowed = 0;
 static uint32 PrivateRefCountClock = 0;
 static PrivateRefCountEntry *ReservedRefCountEntry = NULL;
 
+/* bgwriter state for each buffer node, see BgBufferSyncNode */
+static BgWriterNodeState BgNodeState[MAX_BUFFER_NODES];
+
 static void ReservePrivateRefCountEntry(void);
 static PrivateRefCountEntry *NewPrivateRefCountEntry(Buffer buffer);
 static PrivateRefCountEntry *GetPrivateRefCountEntry(Buffer buffer, bool do_move);
@@ -438,8 +489,20 @@ static void UnpinBuffer(BufferDesc *buf, bool fixOwner);
 static void BufferSync(int flags);
 static uint32 WaitBufHdrUnlocked(BufferDesc *buf);
 static int	SyncOneBuffer(int buf_id, bool skip_recently_used, WritebackContext *flush_context);
+static bool BgBufferSyncNode(WritebackContext *wb_context, int node,
+				 int max_pages);
+static bool BgBufferEvict(WritebackContext *wb_context, int node, int target,
+			  int max_pages);
+static int	SyncBufferRun(CkptSortItem *items, int nitems,
+			  WritebackContext *wb_context, int *written, int *nwritten,
+			  bool *pending);
+static void FinishBufferWrite(int buf_id, WritebackContext *wb_context);
 static void WaitIO(BufferDesc *buf);
 static bool StartBufferIO(BufferDesc *buf, bool forInput);
+static void StartPendingReads(void);
+static void ReadPendingBuffers(void);
+static void FinishBufferIO(BufferDesc *buf, bool clear_dirty,
+			   uint32 set_flag_bits);
 static void TerminateBufferIO(BufferDesc *buf, bool clear_dirty,
 				  uint32 set_flag_bits);
 static void shared_buffer_write_error_callback(void *arg);
@@ -450,10 +513,14 @@ static BufferDesc *BufferAlloc(SMgrRelation smgr,
 			BlockNumber blockNum,
 			BufferAccessStrategy strategy,
 			bool *foundPtr);
+static bool EvictBuffer(BufferDesc *buf, uint32 usage_count);
 static void FlushBuffer(BufferDesc *buf, SMgrRelation reln);
 static void AtProcExit_Buffers(int code, Datum arg);
 static void CheckForBufferLeaks(void);
 static int	rnode_comparator(const void *p1, const void *p2);
+static bool DropRelFileNodeMatch(const BufferTag *tag, void *arg);
+static bool DropRelFileNodesMatch(const BufferTag *tag, void *arg);
+static bool DropDatabaseMatch(const BufferTag *tag, void *arg);
 static int	buffertag_comparator(const void *p1, const void *p2);
 static int	ckpt_buforder_comparator(const void *pa, const void *pb);
 static int	ts_ckpt_progress_comparator(Datum a, Datum b, void *arg);
@@ -517,6 +584,64 @@ ComputeIoConcurrency(int io_concurrency, double *target)
 	return (new_prefetch_pages >= 0.0 && new_prefetch_pages < (double) INT_MAX);
 }
 
+/*
+ * PrefetchSharedBuffer -- initiate asynchronous read of a block of a relation
+ *		that uses shared buffers, given only its smgr handle
+ *
+ * This is the guts of PrefetchBuffer for non-temporary relations.  It is
+ * also used by the WAL prefetcher during recovery, where there is no
+ * relcache entry to hand.  The result tells the caller whether a read was
+ * initiated, the block was found in buffers already, or the relation's
+ * file doesn't exist (which is only reported during recovery).
+ */
+PrefetchBufferResult
+PrefetchSharedBuffer(SMgrRelation smgr_reln, ForkNumber forkNum,
+					 BlockNumber blockNum)
+{
+#ifdef USE_PREFETCH
+	BufferTag	newTag;			/* identity of requested block */
+	uint32		newHash;		/* hash value for newTag */
+	int			buf_id;
+
+	Assert(BlockNumberIsValid(blockNum));
+
+	/* create a tag so we can lookup the buffer */
+	INIT_BUFFERTAG(newTag, smgr_reln->smgr_rnode.node, forkNum, blockNum);
+
+	/* determine its hash code */
+	newHash = BufTableHashCode(&newTag);
+
+	/*
+	 * See if the block is in the buffer pool already.  A wrong answer only
+	 * costs a needless or a missed prefetch, so don't bother with the
+	 * mapping lock.
+	 */
+	buf_id = BufTableLookupUnlocked(&newTag, newHash);
+
+	/*
+	 * If the block *is* in buffers, we do nothing.  This is not really
+	 * ideal: the block might be just about to be evicted, which would be
+	 * stupid since we know we are going to need it soon.  But the only easy
+	 * answer is to bump the usage_count, which does not seem like a great
+	 * solution: when the caller does ultimately touch the block, usage_count
+	 * would get bumped again, resulting in too much favoritism for blocks
+	 * that are involved in a prefetch sequence. A real fix would involve
+	 * some additional per-buffer state, and it's not clear that there's
+	 * enough of a problem to justify that.
+	 */
+	if (buf_id >= 0)
+		return PREFETCH_BUFFER_HIT;
+
+	/* Not in buffers, so initiate prefetch */
+	if (!smgrprefetch(smgr_reln, forkNum, blockNum))
+		return PREFETCH_BUFFER_NOFILE;
+
+	return PREFETCH_BUFFER_STARTED;
+#else
+	return PREFETCH_BUFFER_HIT;
+#endif							/* USE_PREFETCH */
+}
+
 /*
  * PrefetchBuffer -- initiate asynchronous read of a block of a relation
  *
@@ -547,41 +672,7 @@ PrefetchBuffer(Relation reln, ForkNumber forkNum, BlockNumber blockNum)
 		LocalPrefetchBuffer(reln->rd_smgr, forkNum, blockNum);
 	}
 	else
-	{
-		BufferTag	newTag;		/* identity of requested block */
-		uint32		newHash;	/* hash value for newTag */
-		LWLock	   *newPartitionLock;	/* buffer partition lock for it */
-		int			buf_id;
-
-		/* create a tag so we can lookup the buffer */
-		INIT_BUFFERTAG(newTag, reln->rd_smgr->smgr_rnode.node,
-					   forkNum, blockNum);
-
-		/* determine its hash code and partition lock ID */
-		newHash = BufTableHashCode(&newTag);
-		newPartitionLock = BufMappingPartitionLock(newHash);
-
-		/* see if the block is in the buffer pool already */
-		LWLockAcquire(newPartitionLock, LW_SHARED);
-		buf_id = BufTableLookup(&newTag, newHash);
-		LWLockRelease(newPartitionLock);
-
-		/* If not in buffers, initiate prefetch */
-		if (buf_id < 0)
-			smgrprefetch(reln->rd_smgr, forkNum, blockNum);
-
-		/*
-		 * If the block *is* in buffers, we do nothing.  This is not really
-		 * ideal: the block might be just about to be evicted, which would be
-		 * stupid since we know we are going to need it soon.  But the only
-		 * easy answer is to bump the usage_count, which does not seem like a
-		 * great solution: when the caller does ultimately touch the block,
-		 * usage_count would get bumped again, resulting in too much
-		 * favoritism for blocks that are involved in a prefetch sequence. A
-		 * real fix would involve some additional per-buffer state, and it's
-		 * not clear that there's enough of a problem to justify that.
-		 */
-	}
+		(void) PrefetchSharedBuffer(reln->rd_smgr, forkNum, blockNum);
 #endif							/* USE_PREFETCH */
 }
 
@@ -693,6 +784,191 @@ ReadBufferWithoutRelcache(RelFileNode rnode, ForkNumber forkNum,
 							 mode, strategy, &hit);
 }
 
+/*
+ * StartReadBuffers -- begin reading a range of blocks of a relation
+ *
+ * Pins the buffers for blocks blockNum .. blockNum + nblocks - 1 and stores
+ * them in buffers[], starting asynchronous reads for the ones that aren't in
+ * the buffer cache.  The caller must call WaitReadBuffers on the buffers
+ * before looking at their contents.  The blocks must exist; this is the
+ * equivalent of calling ReadBufferExtended in RBM_NORMAL mode for each.
+ *
+ * With io_method = sync, the blocks that weren't found are read synchronously
+ * before returning, each run of consecutive blocks with a single smgrreadv()
+ * call.  Temporary relations are read block by block.
+ *
+ * Returns the number of blocks that weren't found in the buffer cache.
+ */
+int
+StartReadBuffers(Relation reln, ForkNumber forkNum, BlockNumber blockNum,
+				 int nblocks, BufferAccessStrategy strategy, Buffer *buffers)
+{
+	SMgrRelation smgr;
+	int			nmisses = 0;
+	int			i;
+
+	/* Open it at the smgr level if not already done */
+	RelationOpenSmgr(reln);
+	smgr = reln->rd_smgr;
+
+	/* See ReadBufferExtended */
+	if (RELATION_IS_OTHER_TEMP(reln))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("cannot access temporary tables of other sessions")));
+
+	if (SmgrIsTemp(smgr))
+	{
+		for (i = 0; i < nblocks; i++)
+		{
+			bool		hit;
+
+			pgstat_count_buffer_read(reln);
+			buffers[i] = ReadBuffer_common(smgr, reln->rd_rel->relpersistence,
+										   forkNum, blockNum + i, RBM_NORMAL,
+										   strategy, &hit);
+			if (hit)
+				pgstat_count_buffer_hit(reln);
+			else
+				nmisses++;
+		}
+		return nmisses;
+	}
+
+	Assert(nPendingReads == 0);
+
+	for (i = 0; i < nblocks; i++)
+	{
+		BufferDesc *bufHdr;
+		bool		found;
+
+		/* Make sure we will have room to remember the buffer pin */
+		ResourceOwnerEnlargeBuffers(CurrentResourceOwner);
+
+		pgstat_count_buffer_read(reln);
+		bufHdr = BufferAlloc(smgr, reln->rd_rel->relpersistence, forkNum,
+							 blockNum + i, strategy, &found);
+		buffers[i] = BufferDescriptorGetBuffer(bufHdr);
+
+		if (found)
+		{
+			pgstat_count_buffer_hit(reln);
+			pgBufferUsage.shared_blks_hit++;
+			VacuumPageHit++;
+			if (VacuumCostActive)
+				VacuumCostBalance += VacuumCostPageHit;
+
+			/* Reads must be of consecutive blocks */
+			StartPendingReads();
+			continue;
+		}
+
+		pgBufferUsage.shared_blks_read++;
+		VacuumPageMiss++;
+		if (VacuumCostActive)
+			VacuumCostBalance += VacuumCostPageMiss;
+		nmisses++;
+
+		/* The page might be in the compressed buffer tier */
+		if (CompressedBufferRead(&bufHdr->tag, (char *) BufHdrGetBlock(bufHdr)))
+		{
+			TerminateBufferIO(bufHdr, false, BM_VALID);
+			StartPendingReads();
+			continue;
+		}
+
+		/*
+		 * BufferAlloc started I/O on the buffer for us.  It is finished by
+		 * CompleteBufferIO or ReadPendingBuffers, so forget about it here.
+		 */
+		Assert(InProgressBuf == bufHdr);
+		InProgressBuf = NULL;
+
+		/* A single read can't span segment files */
+		if (nPendingReads == PGAIO_MAX_BLOCKS ||
+			(nPendingReads > 0 && (blockNum + i) % RELSEG_SIZE == 0))
+			StartPendingReads();
+		PendingReadBufIds[nPendingReads++] = bufHdr->buf_id;
+	}
+
+	StartPendingReads();
+	if (pgaio_enabled())
+		pgaio_submit();
+
+	return nmisses;
+}
+
+/*
+ * WaitReadBuffers -- wait for reads started by StartReadBuffers
+ *
+ * On return, the buffers hold valid pages.  If an asynchronous read failed,
+ * the block is read again synchronously, which reports the error (or zeroes
+ * the page if zero_damaged_pages is set).
+ */
+void
+WaitReadBuffers(Buffer *buffers, int nbuffers)
+{
+	int			i;
+
+	for (i = 0; i < nbuffers; i++)
+	{
+		BufferDesc *bufHdr;
+		SMgrRelation smgr;
+		Buffer		buffer;
+		bool		hit;
+
+		Assert(BufferIsPinned(buffers[i]));
+
+		if (BufferIsLocal(buffers[i]))
+			continue;
+
+		bufHdr = GetBufferDescriptor(buffers[i] - 1);
+		if (pg_atomic_read_u32(&bufHdr->state) & BM_VALID)
+			continue;
+
+		WaitIO(bufHdr);
+		if (pg_atomic_read_u32(&bufHdr->state) & BM_VALID)
+			continue;
+
+		/* The read failed; retry it.  We hold a pin, so the tag is stable */
+		smgr = smgropen(bufHdr->tag.rnode, InvalidBackendId);
+		buffer = ReadBuffer_common(smgr,
+								   (pg_atomic_read_u32(&bufHdr->state) & BM_PERMANENT) ?
+								   RELPERSISTENCE_PERMANENT : RELPERSISTENCE_UNLOGGED,
+								   bufHdr->tag.forkNum, bufHdr->tag.blockNum,
+								   RBM_NORMAL, NULL, &hit);
+		Assert(buffer == buffers[i]);
+		ReleaseBuffer(buffer);
+	}
+}
+
+/*
+ * DiscardReadBuffers -- release buffers returned by StartReadBuffers
+ *
+ * For callers that turn out not to need the blocks after all.  Any read
+ * still in progress must finish before we let go of the buffer, but unlike
+ * WaitReadBuffers we don't care whether it succeeded.
+ */
+void
+DiscardReadBuffers(Buffer *buffers, int nbuffers)
+{
+	int			i;
+
+	for (i = 0; i < nbuffers; i++)
+	{
+		Assert(BufferIsPinned(buffers[i]));
+
+		if (!BufferIsLocal(buffers[i]))
+		{
+			BufferDesc *bufHdr = GetBufferDescriptor(buffers[i] - 1);
+
+			if (!(pg_atomic_read_u32(&bufHdr->state) & BM_VALID))
+				WaitIO(bufHdr);
+		}
+		ReleaseBuffer(buffers[i]);
+	}
+}
+
 
 /*
  * ReadBuffer_common -- common logic for all ReadBuffer variants
@@ -875,11 +1151,18 @@ ReadBuffer_common(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 	{
 		/*
 		 * Read in the page, unless the caller intends to overwrite it and
-		 * just wants us to allocate a buffer.
+		 * just wants us to allocate a buffer.  A page found in the
+		 * compressed buffer tier needn't be read, or verified either.
 		 */
 		if (mode == RBM_ZERO_AND_LOCK || mode == RBM_ZERO_AND_CLEANUP_LOCK)
+		{
 			MemSet((char *) bufBlock, 0, BLCKSZ);
-		else
+			/* an old version in the compressed buffer tier is obsolete */
+			if (!isLocalBuf)
+				CompressedBufferForget(&bufHdr->tag);
+		}
+		else if (isLocalBuf ||
+				 !CompressedBufferRead(&bufHdr->tag, (char *) bufBlock))
 		{
 			instr_time	io_start,
 						io_time;
@@ -999,6 +1282,7 @@ BufferAlloc(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 	int			buf_id;
 	BufferDesc *buf;
 	bool		valid;
+	bool		stash;			/* storing old page in compressed tier? */
 	uint32		buf_state;
 
 	/* create a tag so we can lookup the buffer */
@@ -1008,23 +1292,52 @@ BufferAlloc(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 	newHash = BufTableHashCode(&newTag);
 	newPartitionLock = BufMappingPartitionLock(newHash);
 
-	/* see if the block is in the buffer pool already */
-	LWLockAcquire(newPartitionLock, LW_SHARED);
-	buf_id = BufTableLookup(&newTag, newHash);
+	/*
+	 * See if the block is in the buffer pool already.  Look without the
+	 * mapping lock first.  If that finds a buffer, pin it, so no one can give
+	 * it a new identity, and then check that it still holds the block; if
+	 * not, or if nothing was found, look again with the lock held.
+	 */
+	buf = NULL;
+	buf_id = BufTableLookupUnlocked(&newTag, newHash);
 	if (buf_id >= 0)
 	{
-		/*
-		 * Found it.  Now, pin the buffer so no one can steal it from the
-		 * buffer pool, and check to see if the correct data has been loaded
-		 * into the buffer.
-		 */
 		buf = GetBufferDescriptor(buf_id);
 
 		valid = PinBuffer(buf, strategy);
 
+		buf_state = pg_atomic_read_u32(&buf->state);
+		if (!(buf_state & BM_TAG_VALID) || !BUFFERTAGS_EQUAL(buf->tag, newTag))
+		{
+			UnpinBuffer(buf, true);
+			buf = NULL;
+		}
+	}
+
+	if (buf == NULL)
+	{
+		LWLockAcquire(newPartitionLock, LW_SHARED);
+		buf_id = BufTableLookup(&newTag, newHash);
+		if (buf_id >= 0)
+		{
+			/*
+			 * Found it.  Now, pin the buffer so no one can steal it from the
+			 * buffer pool.
+			 */
+			buf = GetBufferDescriptor(buf_id);
+
+			valid = PinBuffer(buf, strategy);
+		}
+
 		/* Can release the mapping lock as soon as we've pinned it */
 		LWLockRelease(newPartitionLock);
+	}
+
+	if (buf != NULL)
+	{
+		StrategyNoteHit(buf);
 
+		/* Check to see if the correct data has been loaded into the buffer */
 		*foundPtr = true;
 
 		if (!valid)
@@ -1051,9 +1364,8 @@ BufferAlloc(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 
 	/*
 	 * Didn't find it in the buffer pool.  We'll have to initialize a new
-	 * buffer.  Remember to unlock the mapping lock while doing the work.
+	 * buffer.
 	 */
-	LWLockRelease(newPartitionLock);
 
 	/* Loop here in case we have to try another victim buffer */
 	for (;;)
@@ -1159,6 +1471,25 @@ BufferAlloc(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 			}
 		}
 
+		/*
+		 * If the old page is valid, and we're not recycling buffers in a
+		 * strategy's ring, compress it for the compressed buffer tier.  We
+		 * keep the share lock until the buffer has been renamed, so that the
+		 * page can't change in the meantime.  As above, don't wait for the
+		 * lock.
+		 */
+		stash = false;
+		if (CompressedBuffersEnabled() && strategy == NULL &&
+			(oldFlags & BM_VALID) &&
+			LWLockConditionalAcquire(BufferDescriptorGetContentLock(buf),
+									 LW_SHARED))
+		{
+			stash = CompressedBufferPrepare(&buf->tag,
+											(char *) BufHdrGetBlock(buf));
+			if (!stash)
+				LWLockRelease(BufferDescriptorGetContentLock(buf));
+		}
+
 		/*
 		 * To change the association of a valid buffer, we'll need to have
 		 * exclusive lock on both the old and new mapping partitions.
@@ -1221,6 +1552,8 @@ BufferAlloc(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 			 * pool in the first place.  First, give up the buffer we were
 			 * planning to use.
 			 */
+			if (stash)
+				LWLockRelease(BufferDescriptorGetContentLock(buf));
 			UnpinBuffer(buf, true);
 
 			/* Can give up that buffer's mapping partition lock now */
@@ -1237,6 +1570,8 @@ BufferAlloc(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 			/* Can release the mapping lock as soon as we've pinned it */
 			LWLockRelease(newPartitionLock);
 
+			StrategyNoteHit(buf);
+
 			*foundPtr = true;
 
 			if (!valid)
@@ -1261,6 +1596,17 @@ BufferAlloc(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 			return buf;
 		}
 
+		/*
+		 * Lock the compressed buffer tier's partition for the old page
+		 * before it disappears from the mapping, so that nobody can read it
+		 * from disk before it's stored.
+		 */
+		if (stash && !CompressedBufferLockStash())
+		{
+			LWLockRelease(BufferDescriptorGetContentLock(buf));
+			stash = false;
+		}
+
 		/*
 		 * Need to lock the buffer header too in order to change its tag.
 		 */
@@ -1282,6 +1628,11 @@ BufferAlloc(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 			oldPartitionLock != newPartitionLock)
 			LWLockRelease(oldPartitionLock);
 		LWLockRelease(newPartitionLock);
+		if (stash)
+		{
+			CompressedBufferFinishStash(false);
+			LWLockRelease(BufferDescriptorGetContentLock(buf));
+		}
 		UnpinBuffer(buf, true);
 	}
 
@@ -1307,6 +1658,9 @@ BufferAlloc(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 	else
 		buf_state |= BM_TAG_VALID | BUF_USAGECOUNT_ONE;
 
+	StrategyAdmitBuffer(strategy, buf, oldPartitionLock != NULL,
+						oldHash, newHash);
+
 	UnlockBufHdr(buf, buf_state);
 
 	if (oldPartitionLock != NULL)
@@ -1318,9 +1672,16 @@ BufferAlloc(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 
 	LWLockRelease(newPartitionLock);
 
+	/* Now that nothing else needs it, store the old page */
+	if (stash)
+	{
+		LWLockRelease(BufferDescriptorGetContentLock(buf));
+		CompressedBufferFinishStash(true);
+	}
+
 	/*
-	 * Buffer contents are currently invalid.  Try to get the io_in_progress
-	 * lock.  If StartBufferIO returns false, then someone else managed to
+	 * Buffer contents are currently invalid.  Try to start I/O on it.  If
+	 * StartBufferIO returns false, then someone else managed to
 	 * read it before we did, so there's nothing left for BufferAlloc() to do.
 	 */
 	if (StartBufferIO(buf, true))
@@ -1418,6 +1779,7 @@ retry:
 	oldFlags = buf_state & BUF_FLAG_MASK;
 	CLEAR_BUFFERTAG(buf->tag);
 	buf_state &= ~(BUF_FLAG_MASK | BUF_USAGECOUNT_MASK);
+	StrategyForgetBuffer(buf);
 	UnlockBufHdr(buf, buf_state);
 
 	/*
@@ -1438,62 +1800,172 @@ retry:
 }
 
 /*
- * MarkBufferDirty
+ * EvictBuffer -- evict an unused buffer's page and put it on the freelist
  *
- *		Marks buffer contents as dirty (actual write happens later).
+ * Like InvalidateBuffer, but for a buffer chosen by StrategySweepBuffer() to
+ * be recycled, when it had the given usage count: nothing happens, and we
+ * return false, if the buffer has been pinned, used or dirtied since, or has
+ * been given a new page.  The page is stored in the compressed buffer tier,
+ * as in BufferAlloc.
  *
- * Buffer must be pinned and exclusive-locked.  (If caller does not hold
- * exclusive lock, then somebody could be in process of writing the buffer,
- * leading to risk of bad data written to disk.)
+ * The buffer header spinlock must be held at entry.  We drop it before
+ * returning.  The caller must have done ReservePrivateRefCountEntry and
+ * ResourceOwnerEnlargeBuffers, in case we pin the buffer.
  */
-void
-MarkBufferDirty(Buffer buffer)
+static bool
+EvictBuffer(BufferDesc *buf, uint32 usage_count)
 {
-	BufferDesc *bufHdr;
+	BufferTag	oldTag;
+	uint32		oldHash;		/* hash value for oldTag */
+	LWLock	   *oldPartitionLock;	/* buffer partition lock for it */
 	uint32		buf_state;
-	uint32		old_buf_state;
+	bool		pinned = false;
+	bool		stash = false;
 
-	if (!BufferIsValid(buffer))
-		elog(ERROR, "bad buffer ID: %d", buffer);
+	buf_state = pg_atomic_read_u32(&buf->state);
+	Assert(buf_state & BM_LOCKED);
 
-	if (BufferIsLocal(buffer))
+	/* If it doesn't hold a page, it just needs to go on the freelist */
+	if (!(buf_state & BM_TAG_VALID))
 	{
-		MarkLocalBufferDirty(buffer);
-		return;
+		UnlockBufHdr(buf, buf_state);
+		StrategyFreeBuffer(buf);
+		return true;
 	}
 
-	bufHdr = GetBufferDescriptor(buffer - 1);
-
-	Assert(BufferIsPinned(buffer));
-	Assert(LWLockHeldByMeInMode(BufferDescriptorGetContentLock(bufHdr),
-								LW_EXCLUSIVE));
+	oldTag = buf->tag;
 
-	old_buf_state = pg_atomic_read_u32(&bufHdr->state);
-	for (;;)
+	/*
+	 * To compress the page for the compressed buffer tier, we need a pin and
+	 * a share lock on its contents, which we hold until the buffer has been
+	 * cleared.
+	 */
+	if (CompressedBuffersEnabled() &&
+		BUF_STATE_GET_REFCOUNT(buf_state) == 0 &&
+		(buf_state & BM_VALID) && !(buf_state & BM_DIRTY))
 	{
-		if (old_buf_state & BM_LOCKED)
-			old_buf_state = WaitBufHdrUnlocked(bufHdr);
-
-		buf_state = old_buf_state;
+		PinBuffer_Locked(buf);
+		pinned = true;
+		if (LWLockConditionalAcquire(BufferDescriptorGetContentLock(buf),
+									 LW_SHARED))
+		{
+			stash = CompressedBufferPrepare(&oldTag,
+											(char *) BufHdrGetBlock(buf));
+			if (!stash)
+				LWLockRelease(BufferDescriptorGetContentLock(buf));
+		}
+	}
+	else
+		UnlockBufHdr(buf, buf_state);
 
-		Assert(BUF_STATE_GET_REFCOUNT(buf_state) > 0);
-		buf_state |= BM_DIRTY | BM_JUST_DIRTIED;
+	oldHash = BufTableHashCode(&oldTag);
+	oldPartitionLock = BufMappingPartitionLock(oldHash);
 
-		if (pg_atomic_compare_exchange_u32(&bufHdr->state, &old_buf_state,
-										   buf_state))
-			break;
+	LWLockAcquire(oldPartitionLock, LW_EXCLUSIVE);
+	if (stash && !CompressedBufferLockStash())
+	{
+		LWLockRelease(BufferDescriptorGetContentLock(buf));
+		stash = false;
 	}
+	buf_state = LockBufHdr(buf);
 
-	/*
-	 * If the buffer was not dirty already, do vacuum accounting.
-	 */
-	if (!(old_buf_state & BM_DIRTY))
+	if (!BUFFERTAGS_EQUAL(buf->tag, oldTag) ||
+		!(buf_state & BM_TAG_VALID) ||
+		BUF_STATE_GET_REFCOUNT(buf_state) != (pinned ? 1 : 0) ||
+		BUF_STATE_GET_USAGECOUNT(buf_state) > usage_count ||
+		(buf_state & BM_DIRTY))
 	{
-		VacuumPageDirty++;
-		pgBufferUsage.shared_blks_dirtied++;
-		if (VacuumCostActive)
-			VacuumCostBalance += VacuumCostPageDirty;
-	}
+		UnlockBufHdr(buf, buf_state);
+		LWLockRelease(oldPartitionLock);
+		if (stash)
+		{
+			CompressedBufferFinishStash(false);
+			LWLockRelease(BufferDescriptorGetContentLock(buf));
+		}
+		if (pinned)
+			UnpinBuffer(buf, true);
+		return false;
+	}
+
+	CLEAR_BUFFERTAG(buf->tag);
+	buf_state &= ~(BUF_FLAG_MASK | BUF_USAGECOUNT_MASK);
+	StrategyEvictBuffer(buf, oldHash);
+	UnlockBufHdr(buf, buf_state);
+
+	BufTableDelete(&oldTag, oldHash);
+
+	LWLockRelease(oldPartitionLock);
+
+	if (stash)
+	{
+		LWLockRelease(BufferDescriptorGetContentLock(buf));
+		CompressedBufferFinishStash(true);
+	}
+	if (pinned)
+		UnpinBuffer(buf, true);
+
+	StrategyFreeBuffer(buf);
+
+	return true;
+}
+
+/*
+ * MarkBufferDirty
+ *
+ *		Marks buffer contents as dirty (actual write happens later).
+ *
+ * Buffer must be pinned and exclusive-locked.  (If caller does not hold
+ * exclusive lock, then somebody could be in process of writing the buffer,
+ * leading to risk of bad data written to disk.)
+ */
+void
+MarkBufferDirty(Buffer buffer)
+{
+	BufferDesc *bufHdr;
+	uint32		buf_state;
+	uint32		old_buf_state;
+
+	if (!BufferIsValid(buffer))
+		elog(ERROR, "bad buffer ID: %d", buffer);
+
+	if (BufferIsLocal(buffer))
+	{
+		MarkLocalBufferDirty(buffer);
+		return;
+	}
+
+	bufHdr = GetBufferDescriptor(buffer - 1);
+
+	Assert(BufferIsPinned(buffer));
+	Assert(LWLockHeldByMeInMode(BufferDescriptorGetContentLock(bufHdr),
+								LW_EXCLUSIVE));
+
+	old_buf_state = pg_atomic_read_u32(&bufHdr->state);
+	for (;;)
+	{
+		if (old_buf_state & BM_LOCKED)
+			old_buf_state = WaitBufHdrUnlocked(bufHdr);
+
+		buf_state = old_buf_state;
+
+		Assert(BUF_STATE_GET_REFCOUNT(buf_state) > 0);
+		buf_state |= BM_DIRTY | BM_JUST_DIRTIED;
+
+		if (pg_atomic_compare_exchange_u32(&bufHdr->state, &old_buf_state,
+										   buf_state))
+			break;
+	}
+
+	/*
+	 * If the buffer was not dirty already, do vacuum accounting.
+	 */
+	if (!(old_buf_state & BM_DIRTY))
+	{
+		VacuumPageDirty++;
+		pgBufferUsage.shared_blks_dirtied++;
+		if (VacuumCostActive)
+			VacuumCostBalance += VacuumCostPageDirty;
+	}
 }
 
 /*
@@ -1712,7 +2184,6 @@ UnpinBuffer(BufferDesc *buf, bool fixOwner)
 
 		/* I'd better not still hold any locks on the buffer */
 		Assert(!LWLockHeldByMe(BufferDescriptorGetContentLock(buf)));
-		Assert(!LWLockHeldByMe(BufferDescriptorGetIOLock(buf)));
 
 		/*
 		 * Decrement the shared reference count.
@@ -1789,9 +2260,10 @@ BufferSync(int flags)
 	int			i;
 	int			mask = BM_DIRTY;
 	WritebackContext wb_context;
-
-	/* Make sure we can handle the pin inside SyncOneBuffer */
-	ResourceOwnerEnlargeBuffers(CurrentResourceOwner);
+	int		   *pending_writes = NULL;
+	int			max_pending = 0;
+	int			pending_head = 0;
+	int			npending = 0;
 
 	/*
 	 * Unless this is a shutdown checkpoint or we have been explicitly told,
@@ -1946,6 +2418,17 @@ BufferSync(int flags)
 
 	binaryheap_build(ts_heap);
 
+	/*
+	 * With asynchronous I/O, keep up to io_max_concurrency writes of the
+	 * largest size in flight.  The buffers being written stay pinned until
+	 * we're done with them; they are tracked in a ring, oldest first.
+	 */
+	if (pgaio_enabled())
+	{
+		max_pending = io_max_concurrency * PGAIO_MAX_BLOCKS;
+		pending_writes = (int *) palloc(sizeof(int) * max_pending);
+	}
+
 	/*
 	 * Iterate through to-be-checkpointed buffers and write the ones (still)
 	 * marked with BM_CHECKPOINT_NEEDED. The writes are balanced between
@@ -1959,43 +2442,83 @@ BufferSync(int flags)
 		BufferDesc *bufHdr = NULL;
 		CkptTsStatus *ts_stat = (CkptTsStatus *)
 		DatumGetPointer(binaryheap_first(ts_heap));
+		CkptSortItem *items = &CkptBufferIds[ts_stat->index];
+		int			nitems;
 
-		buf_id = CkptBufferIds[ts_stat->index].buf_id;
+		buf_id = items[0].buf_id;
 		Assert(buf_id != -1);
 
 		bufHdr = GetBufferDescriptor(buf_id);
 
-		num_processed++;
+		/*
+		 * The buffers following this one in the sort order may hold the next
+		 * blocks of the same relation fork, in the same segment file.  Such a
+		 * run can be written with a single I/O.
+		 */
+		nitems = 1;
+		while (nitems < PGAIO_MAX_BLOCKS &&
+			   ts_stat->num_scanned + nitems < ts_stat->num_to_scan &&
+			   items[nitems].relNode == items[0].relNode &&
+			   items[nitems].forkNum == items[0].forkNum &&
+			   items[nitems].blockNum == items[0].blockNum + nitems &&
+			   items[nitems].blockNum % RELSEG_SIZE != 0)
+			nitems++;
 
 		/*
 		 * We don't need to acquire the lock here, because we're only looking
 		 * at a single bit. It's possible that someone else writes the buffer
 		 * and clears the flag right after we check, but that doesn't matter
-		 * since SyncOneBuffer will then do nothing.  However, there is a
+		 * since SyncBufferRun will then do nothing.  However, there is a
 		 * further race condition: it's conceivable that between the time we
-		 * examine the bit here and the time SyncOneBuffer acquires the lock,
+		 * examine the bit here and the time SyncBufferRun acquires the lock,
 		 * someone else not only wrote the buffer but replaced it with another
-		 * page and dirtied it.  In that improbable case, SyncOneBuffer will
+		 * page and dirtied it.  In that improbable case, SyncBufferRun will
 		 * write the buffer though we didn't need to.  It doesn't seem worth
 		 * guarding against this, though.
 		 */
 		if (pg_atomic_read_u32(&bufHdr->state) & BM_CHECKPOINT_NEEDED)
 		{
-			if (SyncOneBuffer(buf_id, false, &wb_context) & BUF_WRITTEN)
+			int			written[PGAIO_MAX_BLOCKS];
+			int			nwritten;
+			bool		pending;
+
+			/* Make room for the largest possible write in the ring */
+			while (npending > max_pending - PGAIO_MAX_BLOCKS)
+			{
+				FinishBufferWrite(pending_writes[pending_head], &wb_context);
+				pending_head = (pending_head + 1) % max_pending;
+				npending--;
+			}
+
+			nitems = SyncBufferRun(items, nitems, &wb_context,
+								   written, &nwritten, &pending);
+
+			for (i = 0; i < nwritten; i++)
 			{
-				TRACE_POSTGRESQL_BUFFER_SYNC_WRITTEN(buf_id);
+				if (pending)
+				{
+					pending_writes[(pending_head + npending) % max_pending] =
+						written[i];
+					npending++;
+				}
+
+				TRACE_POSTGRESQL_BUFFER_SYNC_WRITTEN(written[i]);
 				BgWriterStats.m_buf_written_checkpoints++;
 				num_written++;
 			}
 		}
+		else
+			nitems = 1;
+
+		num_processed += nitems;
 
 		/*
 		 * Measure progress independent of actually having to flush the buffer
 		 * - otherwise writing become unbalanced.
 		 */
-		ts_stat->progress += ts_stat->progress_slice;
-		ts_stat->num_scanned++;
-		ts_stat->index++;
+		ts_stat->progress += ts_stat->progress_slice * nitems;
+		ts_stat->num_scanned += nitems;
+		ts_stat->index += nitems;
 
 		/* Have all the buffers from the tablespace been processed? */
 		if (ts_stat->num_scanned == ts_stat->num_to_scan)
@@ -2014,6 +2537,16 @@ BufferSync(int flags)
 		CheckpointWriteDelay(flags, (double) num_processed / num_to_scan);
 	}
 
+	/* wait for the writes still in progress */
+	while (npending > 0)
+	{
+		FinishBufferWrite(pending_writes[pending_head], &wb_context);
+		pending_head = (pending_head + 1) % max_pending;
+		npending--;
+	}
+	if (pending_writes != NULL)
+		pfree(pending_writes);
+
 	/* issue all pending flushes */
 	IssuePendingWritebacks(&wb_context);
 
@@ -2033,7 +2566,10 @@ BufferSync(int flags)
 /*
  * BgBufferSync -- Write out some dirty buffers in the pool.
  *
- * This is called periodically by the background writer process.
+ * This is called periodically by the background writer process.  If
+ * bgwriter_evict is set, it also evicts the buffers to the freelists.  Each
+ * buffer node is handled separately, as it has its own clock sweep, and
+ * gets an equal share of bgwriter_lru_maxpages.
  *
  * Returns true if it's appropriate for the bgwriter process to go into
  * low-power hibernation mode.  (This happens if the strategy clock sweep
@@ -2043,25 +2579,41 @@ BufferSync(int flags)
  */
 bool
 BgBufferSync(WritebackContext *wb_context)
+{
+	int			max_pages;
+	int			node;
+	bool		hibernate = true;
+
+	max_pages = (bgwriter_lru_maxpages + NumBufferNodes() - 1) /
+		NumBufferNodes();
+
+	for (node = 0; node < NumBufferNodes(); node++)
+	{
+		if (!BgBufferSyncNode(wb_context, node, max_pages))
+			hibernate = false;
+	}
+
+	return hibernate;
+}
+
+/*
+ * BgBufferSyncNode -- BgBufferSync for one buffer node
+ *
+ * Writes out no more than max_pages buffers.  Buffer indexes are relative to
+ * the node's first buffer, as returned by StrategySyncStart().
+ */
+static bool
+BgBufferSyncNode(WritebackContext *wb_context, int node, int max_pages)
 {
 	/* info obtained from freelist.c */
 	int			strategy_buf_id;
 	uint32		strategy_passes;
 	uint32		recent_alloc;
 
-	/*
-	 * Information saved between calls so we can determine the strategy
-	 * point's advance rate and avoid scanning already-cleaned buffers.
-	 */
-	static bool saved_info_valid = false;
-	static int	prev_strategy_buf_id;
-	static uint32 prev_strategy_passes;
-	static int	next_to_clean;
-	static uint32 next_passes;
-
-	/* Moving averages of allocation rate and clean-buffer density */
-	static float smoothed_alloc = 0;
-	static float smoothed_density = 10.0;
+	/* Information saved between calls, see BgWriterNodeState */
+	BgWriterNodeState *state = &BgNodeState[node];
+	int			first = BufferNodeFirst(node);
+	int			nbuffers = BufferNodeSize(node);
 
 	/* Potentially these could be tunables, but for now, not */
 	float		smoothing_samples = 16;
@@ -2089,11 +2641,19 @@ BgBufferSync(WritebackContext *wb_context)
 	 * Find out where the freelist clock sweep currently is, and how many
 	 * buffer allocations have happened since our last call.
 	 */
-	strategy_buf_id = StrategySyncStart(&strategy_passes, &recent_alloc);
+	strategy_buf_id = StrategySyncStart(node, &strategy_passes, &recent_alloc);
 
 	/* Report buffer alloc counts to pgstat */
 	BgWriterStats.m_buf_alloc += recent_alloc;
 
+	if (!state->initialized)
+	{
+		state->saved_info_valid = false;
+		state->smoothed_alloc = 0;
+		state->smoothed_density = 10.0;
+		state->initialized = true;
+	}
+
 	/*
 	 * If we're not running the LRU scan, just stop after doing the stats
 	 * stuff.  We mark the saved state invalid so that we can recover sanely
@@ -2101,7 +2661,7 @@ BgBufferSync(WritebackContext *wb_context)
 	 */
 	if (bgwriter_lru_maxpages <= 0)
 	{
-		saved_info_valid = false;
+		state->saved_info_valid = false;
 		return true;
 	}
 
@@ -2113,34 +2673,34 @@ BgBufferSync(WritebackContext *wb_context)
 	 * weird-looking coding of xxx_passes comparisons are to avoid bogus
 	 * behavior when the passes counts wrap around.
 	 */
-	if (saved_info_valid)
+	if (state->saved_info_valid)
 	{
-		int32		passes_delta = strategy_passes - prev_strategy_passes;
+		int32		passes_delta = strategy_passes - state->prev_strategy_passes;
 
-		strategy_delta = strategy_buf_id - prev_strategy_buf_id;
-		strategy_delta += (long) passes_delta * NBuffers;
+		strategy_delta = strategy_buf_id - state->prev_strategy_buf_id;
+		strategy_delta += (long) passes_delta * nbuffers;
 
 		Assert(strategy_delta >= 0);
 
-		if ((int32) (next_passes - strategy_passes) > 0)
+		if ((int32) (state->next_passes - strategy_passes) > 0)
 		{
 			/* we're one pass ahead of the strategy point */
-			bufs_to_lap = strategy_buf_id - next_to_clean;
+			bufs_to_lap = strategy_buf_id - state->next_to_clean;
 #ifdef BGW_DEBUG
 			elog(DEBUG2, "bgwriter ahead: bgw %u-%u strategy %u-%u delta=%ld lap=%d",
-				 next_passes, next_to_clean,
+				 state->next_passes, state->next_to_clean,
 				 strategy_passes, strategy_buf_id,
 				 strategy_delta, bufs_to_lap);
 #endif
 		}
-		else if (next_passes == strategy_passes &&
-				 next_to_clean >= strategy_buf_id)
+		else if (state->next_passes == strategy_passes &&
+				 state->next_to_clean >= strategy_buf_id)
 		{
 			/* on same pass, but ahead or at least not behind */
-			bufs_to_lap = NBuffers - (next_to_clean - strategy_buf_id);
+			bufs_to_lap = nbuffers - (state->next_to_clean - strategy_buf_id);
 #ifdef BGW_DEBUG
 			elog(DEBUG2, "bgwriter ahead: bgw %u-%u strategy %u-%u delta=%ld lap=%d",
-				 next_passes, next_to_clean,
+				 state->next_passes, state->next_to_clean,
 				 strategy_passes, strategy_buf_id,
 				 strategy_delta, bufs_to_lap);
 #endif
@@ -2153,13 +2713,13 @@ BgBufferSync(WritebackContext *wb_context)
 			 */
 #ifdef BGW_DEBUG
 			elog(DEBUG2, "bgwriter behind: bgw %u-%u strategy %u-%u delta=%ld",
-				 next_passes, next_to_clean,
+				 state->next_passes, state->next_to_clean,
 				 strategy_passes, strategy_buf_id,
 				 strategy_delta);
 #endif
-			next_to_clean = strategy_buf_id;
-			next_passes = strategy_passes;
-			bufs_to_lap = NBuffers;
+			state->next_to_clean = strategy_buf_id;
+			state->next_passes = strategy_passes;
+			bufs_to_lap = nbuffers;
 		}
 	}
 	else
@@ -2173,15 +2733,15 @@ BgBufferSync(WritebackContext *wb_context)
 			 strategy_passes, strategy_buf_id);
 #endif
 		strategy_delta = 0;
-		next_to_clean = strategy_buf_id;
-		next_passes = strategy_passes;
-		bufs_to_lap = NBuffers;
+		state->next_to_clean = strategy_buf_id;
+		state->next_passes = strategy_passes;
+		bufs_to_lap = nbuffers;
 	}
 
 	/* Update saved info for next time */
-	prev_strategy_buf_id = strategy_buf_id;
-	prev_strategy_passes = strategy_passes;
-	saved_info_valid = true;
+	state->prev_strategy_buf_id = strategy_buf_id;
+	state->prev_strategy_passes = strategy_passes;
+	state->saved_info_valid = true;
 
 	/*
 	 * Compute how many buffers had to be scanned for each new allocation, ie,
@@ -2192,7 +2752,7 @@ BgBufferSync(WritebackContext *wb_context)
 	if (strategy_delta > 0 && recent_alloc > 0)
 	{
 		scans_per_alloc = (float) strategy_delta / (float) recent_alloc;
-		smoothed_density += (scans_per_alloc - smoothed_density) /
+		state->smoothed_density += (scans_per_alloc - state->smoothed_density) /
 			smoothing_samples;
 	}
 
@@ -2201,22 +2761,22 @@ BgBufferSync(WritebackContext *wb_context)
 	 * strategy point and where we've scanned ahead to, based on the smoothed
 	 * density estimate.
 	 */
-	bufs_ahead = NBuffers - bufs_to_lap;
-	reusable_buffers_est = (float) bufs_ahead / smoothed_density;
+	bufs_ahead = nbuffers - bufs_to_lap;
+	reusable_buffers_est = (float) bufs_ahead / state->smoothed_density;
 
 	/*
 	 * Track a moving average of recent buffer allocations.  Here, rather than
 	 * a true average we want a fast-attack, slow-decline behavior: we
 	 * immediately follow any increase.
 	 */
-	if (smoothed_alloc <= (float) recent_alloc)
-		smoothed_alloc = recent_alloc;
+	if (state->smoothed_alloc <= (float) recent_alloc)
+		state->smoothed_alloc = recent_alloc;
 	else
-		smoothed_alloc += ((float) recent_alloc - smoothed_alloc) /
+		state->smoothed_alloc += ((float) recent_alloc - state->smoothed_alloc) /
 			smoothing_samples;
 
 	/* Scale the estimate by a GUC to allow more aggressive tuning. */
-	upcoming_alloc_est = (int) (smoothed_alloc * bgwriter_lru_multiplier);
+	upcoming_alloc_est = (int) (state->smoothed_alloc * bgwriter_lru_multiplier);
 
 	/*
 	 * If recent_alloc remains at zero for many cycles, smoothed_alloc will
@@ -2227,7 +2787,20 @@ BgBufferSync(WritebackContext *wb_context)
 	 * syndrome.  It will pop back up as soon as recent_alloc increases.
 	 */
 	if (upcoming_alloc_est == 0)
-		smoothed_alloc = 0;
+		state->smoothed_alloc = 0;
+
+	/*
+	 * If we're to evict buffers ourselves, run the clock sweep until the
+	 * freelist holds enough buffers for the next cycle's allocations.  That
+	 * moves the strategy point, so the LRU scan's state would be stale.
+	 */
+	if (bgwriter_evict)
+	{
+		state->saved_info_valid = false;
+		return BgBufferEvict(wb_context, node, upcoming_alloc_est,
+							 max_pages) &&
+			recent_alloc == 0;
+	}
 
 	/*
 	 * Even in cases where there's been little or no buffer allocation
@@ -2239,7 +2812,7 @@ BgBufferSync(WritebackContext *wb_context)
 	 * the BGW will be called during the scan_whole_pool time; slice the
 	 * buffer pool into that many sections.
 	 */
-	min_scan_buffers = (int) (NBuffers / (scan_whole_pool_milliseconds / BgWriterDelay));
+	min_scan_buffers = (int) (nbuffers / (scan_whole_pool_milliseconds / BgWriterDelay));
 
 	if (upcoming_alloc_est < (min_scan_buffers + reusable_buffers_est))
 	{
@@ -2267,141 +2840,478 @@ BgBufferSync(WritebackContext *wb_context)
 	/* Execute the LRU scan */
 	while (num_to_scan > 0 && reusable_buffers < upcoming_alloc_est)
 	{
-		int			sync_state = SyncOneBuffer(next_to_clean, true,
+		int			sync_state = SyncOneBuffer(first + state->next_to_clean, true,
 											   wb_context);
 
-		if (++next_to_clean >= NBuffers)
-		{
-			next_to_clean = 0;
-			next_passes++;
-		}
-		num_to_scan--;
+		if (++state->next_to_clean >= nbuffers)
+		{
+			state->next_to_clean = 0;
+			state->next_passes++;
+		}
+		num_to_scan--;
+
+		if (sync_state & BUF_WRITTEN)
+		{
+			reusable_buffers++;
+			if (++num_written >= max_pages)
+			{
+				BgWriterStats.m_maxwritten_clean++;
+				break;
+			}
+		}
+		else if (sync_state & BUF_REUSABLE)
+			reusable_buffers++;
+	}
+
+	BgWriterStats.m_buf_written_clean += num_written;
+
+#ifdef BGW_DEBUG
+	elog(DEBUG1, "bgwriter: recent_alloc=%u smoothed=%.2f delta=%ld ahead=%d density=%.2f reusable_est=%d upcoming_est=%d scanned=%d wrote=%d reusable=%d",
+		 recent_alloc, state->smoothed_alloc, strategy_delta, bufs_ahead,
+		 state->smoothed_density, reusable_buffers_est, upcoming_alloc_est,
+		 bufs_to_lap - num_to_scan,
+		 num_written,
+		 reusable_buffers - reusable_buffers_est);
+#endif
+
+	/*
+	 * Consider the above scan as being like a new allocation scan.
+	 * Characterize its density and update the smoothed one based on it. This
+	 * effectively halves the moving average period in cases where both the
+	 * strategy and the background writer are doing some useful scanning,
+	 * which is helpful because a long memory isn't as desirable on the
+	 * density estimates.
+	 */
+	new_strategy_delta = bufs_to_lap - num_to_scan;
+	new_recent_alloc = reusable_buffers - reusable_buffers_est;
+	if (new_strategy_delta > 0 && new_recent_alloc > 0)
+	{
+		scans_per_alloc = (float) new_strategy_delta / (float) new_recent_alloc;
+		state->smoothed_density += (scans_per_alloc - state->smoothed_density) /
+			smoothing_samples;
+
+#ifdef BGW_DEBUG
+		elog(DEBUG2, "bgwriter: cleaner density alloc=%u scan=%ld density=%.2f new smoothed=%.2f",
+			 new_recent_alloc, new_strategy_delta,
+			 scans_per_alloc, state->smoothed_density);
+#endif
+	}
+
+	/* Return true if OK to hibernate */
+	return (bufs_to_lap == 0 && recent_alloc == 0);
+}
+
+/*
+ * BgBufferEvict -- refill a buffer node's freelist, for BgBufferSyncNode
+ *
+ * Runs the node's clock sweep on behalf of the backends that will allocate
+ * buffers next, writing out the dirty buffers it picks, and puts the buffers
+ * on the freelist until it holds target buffers, so that those backends find
+ * clean buffers there instead of writing out victims themselves.  No more
+ * than max_pages buffers are written, and no more than an eighth of the
+ * node's buffers is kept on the freelist, so that a burst of allocations
+ * doesn't empty much of the cache.
+ *
+ * Returns true if there was nothing to do.
+ */
+static bool
+BgBufferEvict(WritebackContext *wb_context, int node, int target,
+			  int max_pages)
+{
+	int			num_free = StrategyFreeListLength(node);
+	int			num_to_scan = BufferNodeSize(node);
+	int			num_written = 0;
+	int			num_evicted = 0;
+
+	target = Min(target, Max(BufferNodeSize(node) / 8, 1));
+
+	/* Make sure we can handle the pin below */
+	ResourceOwnerEnlargeBuffers(CurrentResourceOwner);
+
+	while (num_free + num_evicted < target && num_to_scan-- > 0)
+	{
+		BufferDesc *bufHdr;
+		uint32		buf_state;
+		uint32		usage_count;
+
+		ReservePrivateRefCountEntry();
+
+		bufHdr = StrategySweepBuffer(node, &buf_state);
+		usage_count = BUF_STATE_GET_USAGECOUNT(buf_state);
+
+		if ((buf_state & BM_VALID) && (buf_state & BM_DIRTY))
+		{
+			BufferTag	tag;
+
+			if (num_written >= max_pages)
+			{
+				UnlockBufHdr(bufHdr, buf_state);
+				BgWriterStats.m_maxwritten_clean++;
+				break;
+			}
+
+			/* Pin it, share-lock it, write it, as in SyncOneBuffer */
+			PinBuffer_Locked(bufHdr);
+			LWLockAcquire(BufferDescriptorGetContentLock(bufHdr), LW_SHARED);
+			FlushBuffer(bufHdr, NULL);
+			LWLockRelease(BufferDescriptorGetContentLock(bufHdr));
+			tag = bufHdr->tag;
+			UnpinBuffer(bufHdr, true);
+			ScheduleBufferTagForWriteback(wb_context, &tag);
+			num_written++;
+
+			/* EvictBuffer may pin it again */
+			ReservePrivateRefCountEntry();
+			buf_state = LockBufHdr(bufHdr);
+		}
+
+		if (EvictBuffer(bufHdr, usage_count))
+			num_evicted++;
+	}
+
+	BgWriterStats.m_buf_written_clean += num_written;
+
+#ifdef BGW_DEBUG
+	elog(DEBUG1, "bgwriter: free=%d target=%d wrote=%d evicted=%d",
+		 num_free, target, num_written, num_evicted);
+#endif
+
+	return num_evicted == 0;
+}
+
+/*
+ * SyncOneBuffer -- process a single buffer during syncing.
+ *
+ * If skip_recently_used is true, we don't write currently-pinned buffers, nor
+ * buffers marked recently used, as these are not replacement candidates.
+ *
+ * Returns a bitmask containing the following flag bits:
+ *	BUF_WRITTEN: we wrote the buffer.
+ *	BUF_REUSABLE: buffer is available for replacement, ie, it has
+ *		pin count 0 and usage count 0.
+ *
+ * (BUF_WRITTEN could be set in error if FlushBuffers finds the buffer clean
+ * after locking it, but we don't care all that much.)
+ *
+ * Note: caller must have done ResourceOwnerEnlargeBuffers.
+ */
+static int
+SyncOneBuffer(int buf_id, bool skip_recently_used, WritebackContext *wb_context)
+{
+	BufferDesc *bufHdr = GetBufferDescriptor(buf_id);
+	int			result = 0;
+	uint32		buf_state;
+	BufferTag	tag;
+
+	ReservePrivateRefCountEntry();
+
+	/*
+	 * Check whether buffer needs writing.
+	 *
+	 * We can make this check without taking the buffer content lock so long
+	 * as we mark pages dirty in access methods *before* logging changes with
+	 * XLogInsert(): if someone marks the buffer dirty just after our check we
+	 * don't worry because our checkpoint.redo points before log record for
+	 * upcoming changes and so we are not required to write such dirty buffer.
+	 */
+	buf_state = LockBufHdr(bufHdr);
+
+	if (BUF_STATE_GET_REFCOUNT(buf_state) == 0 &&
+		BUF_STATE_GET_USAGECOUNT(buf_state) == 0)
+	{
+		result |= BUF_REUSABLE;
+	}
+	else if (skip_recently_used)
+	{
+		/* Caller told us not to write recently-used buffers */
+		UnlockBufHdr(bufHdr, buf_state);
+		return result;
+	}
+
+	if (!(buf_state & BM_VALID) || !(buf_state & BM_DIRTY))
+	{
+		/* It's clean, so nothing to do */
+		UnlockBufHdr(bufHdr, buf_state);
+		return result;
+	}
+
+	/*
+	 * Pin it, share-lock it, write it.  (FlushBuffer will do nothing if the
+	 * buffer is clean by the time we've locked it.)
+	 */
+	PinBuffer_Locked(bufHdr);
+	LWLockAcquire(BufferDescriptorGetContentLock(bufHdr), LW_SHARED);
+
+	FlushBuffer(bufHdr, NULL);
+
+	LWLockRelease(BufferDescriptorGetContentLock(bufHdr));
+
+	tag = bufHdr->tag;
+
+	UnpinBuffer(bufHdr, true);
+
+	ScheduleBufferTagForWriteback(wb_context, &tag);
+
+	return result | BUF_WRITTEN;
+}
+
+/*
+ * SyncBufferRun -- write out a run of buffers, for BufferSync
+ *
+ * items[] are the next nitems entries of CkptBufferIds, which held
+ * consecutive blocks of one relation fork, in one segment file, when they
+ * were collected.  We write as many of them as still hold those blocks and
+ * are dirty, starting with the first, with a single vectored write.  The run
+ * ends early at a buffer that doesn't qualify, or that we can't lock without
+ * waiting; we mustn't wait for a lock while holding others.  Returns the
+ * number of entries dealt with, at least one; the rest are left for the next
+ * call.
+ *
+ * Like SyncOneBuffer with skip_recently_used = false, this writes from a copy
+ * of the pages if checksums are enabled.  The ids of the buffers written are
+ * stored in written[] and their number in *nwritten.  With asynchronous I/O,
+ * *pending is set to true, and the buffers are left pinned; the caller must
+ * then pass each of them to FinishBufferWrite.  If there's no room to copy
+ * the pages for that, we write them synchronously instead.
+ */
+static int
+SyncBufferRun(CkptSortItem *items, int nitems, WritebackContext *wb_context,
+			  int *written, int *nwritten, bool *pending)
+{
+	BufferDesc *first = NULL;
+	char	   *pages[PGAIO_MAX_BLOCKS];
+	XLogRecPtr	recptr = InvalidXLogRecPtr;
+	bool		permanent = false;
+	int			io_id = -1;
+	int			n;
+	int			i;
+
+	Assert(nitems > 0 && nitems <= PGAIO_MAX_BLOCKS);
+	Assert(nPendingWrites == 0);
+
+	*nwritten = 0;
+	*pending = false;
+
+	for (i = 0; i < nitems; i++)
+	{
+		BufferDesc *bufHdr = GetBufferDescriptor(items[i].buf_id);
+		uint32		buf_state;
+
+		/* Make sure we can handle the pin */
+		ResourceOwnerEnlargeBuffers(CurrentResourceOwner);
+		ReservePrivateRefCountEntry();
+
+		/* See SyncOneBuffer */
+		buf_state = LockBufHdr(bufHdr);
+
+		if (!(buf_state & BM_VALID) || !(buf_state & BM_DIRTY))
+		{
+			/* It's clean, so nothing to do */
+			UnlockBufHdr(bufHdr, buf_state);
+			break;
+		}
+
+		/*
+		 * The later buffers must still hold the following blocks, and mustn't
+		 * make us wait for I/O either.
+		 */
+		if (i > 0 &&
+			(!RelFileNodeEquals(bufHdr->tag.rnode, first->tag.rnode) ||
+			 bufHdr->tag.forkNum != first->tag.forkNum ||
+			 bufHdr->tag.blockNum != first->tag.blockNum + i ||
+			 !(buf_state & BM_CHECKPOINT_NEEDED) ||
+			 (buf_state & BM_IO_IN_PROGRESS)))
+		{
+			UnlockBufHdr(bufHdr, buf_state);
+			break;
+		}
+
+		PinBuffer_Locked(bufHdr);
+		if (i == 0)
+			LWLockAcquire(BufferDescriptorGetContentLock(bufHdr), LW_SHARED);
+		else if (!LWLockConditionalAcquire(BufferDescriptorGetContentLock(bufHdr),
+										   LW_SHARED))
+		{
+			UnpinBuffer(bufHdr, true);
+			break;
+		}
+
+		/* As in FlushBuffer, stop if someone else wrote it meanwhile */
+		if (!StartBufferIO(bufHdr, false))
+		{
+			LWLockRelease(BufferDescriptorGetContentLock(bufHdr));
+			UnpinBuffer(bufHdr, true);
+			break;
+		}
+
+		/* It's in PendingWriteBufIds for AbortBufferIO to fail from now on */
+		InProgressBuf = NULL;
+		PendingWriteBufIds[nPendingWrites++] = bufHdr->buf_id;
+		if (i == 0)
+			first = bufHdr;
+	}
+
+	n = nPendingWrites;
+	if (n == 0)
+		return 1;
+
+	/*
+	 * WAL must be flushed up to the newest page's LSN before the data pages
+	 * are written, see FlushBuffer.
+	 */
+	for (i = 0; i < n; i++)
+	{
+		BufferDesc *bufHdr = GetBufferDescriptor(PendingWriteBufIds[i]);
+		XLogRecPtr	lsn;
+		uint32		buf_state;
+
+		buf_state = LockBufHdr(bufHdr);
+		lsn = BufferGetLSN(bufHdr);
+		buf_state &= ~BM_JUST_DIRTIED;
+		UnlockBufHdr(bufHdr, buf_state);
+
+		if (buf_state & BM_PERMANENT)
+		{
+			permanent = true;
+			if (lsn > recptr)
+				recptr = lsn;
+		}
+	}
+	if (permanent)
+		XLogFlush(recptr);
+
+	/*
+	 * Set the checksums on copies of the pages, as PageSetChecksumCopy does,
+	 * since other processes might be updating hint bits in them.
+	 */
+	if (WriteRunPages == NULL)
+		WriteRunPages = (char *)
+			IOALIGN(MemoryContextAlloc(TopMemoryContext,
+									   PGAIO_MAX_BLOCKS * BLCKSZ +
+									   PG_IO_ALIGN_SIZE));
+	for (i = 0; i < n; i++)
+	{
+		BufferDesc *bufHdr = GetBufferDescriptor(PendingWriteBufIds[i]);
+
+		if (DataChecksumsEnabled())
+		{
+			pages[i] = WriteRunPages + i * BLCKSZ;
+			memcpy(pages[i], BufHdrGetBlock(bufHdr), BLCKSZ);
+			PageSetChecksumInplace((Page) pages[i], bufHdr->tag.blockNum);
+		}
+		else
+			pages[i] = BufHdrGetBlock(bufHdr);
+	}
+
+	memcpy(written, PendingWriteBufIds, sizeof(int) * n);
+	*nwritten = n;
+
+	if (pgaio_enabled())
+		io_id = pgaio_start_write(first->tag.rnode, first->tag.forkNum,
+								  first->tag.blockNum, n, PendingWriteBufIds,
+								  pages);
+
+	if (io_id >= 0)
+	{
+		for (i = 0; i < n; i++)
+		{
+			BufferDesc *bufHdr = GetBufferDescriptor(PendingWriteBufIds[i]);
+			uint32		buf_state;
+
+			buf_state = LockBufHdr(bufHdr);
+			bufHdr->io_handle = io_id;
+			UnlockBufHdr(bufHdr, buf_state);
+		}
+		nPendingWrites = 0;
+
+		/* The pages have been copied, so we're done with their content */
+		for (i = 0; i < n; i++)
+		{
+			BufferDesc *bufHdr = GetBufferDescriptor(written[i]);
+
+			LWLockRelease(BufferDescriptorGetContentLock(bufHdr));
+		}
+
+		pgaio_submit();
+		*pending = true;
+	}
+	else
+	{
+		ErrorContextCallback errcallback;
+		instr_time	io_start,
+					io_time;
+
+		/* Setup error traceback support for ereport() */
+		errcallback.callback = shared_buffer_write_error_callback;
+		errcallback.arg = (void *) first;
+		errcallback.previous = error_context_stack;
+		error_context_stack = &errcallback;
+
+		if (track_io_timing)
+			INSTR_TIME_SET_CURRENT(io_start);
 
-		if (sync_state & BUF_WRITTEN)
+		smgrwritev(smgropen(first->tag.rnode, InvalidBackendId),
+				   first->tag.forkNum, first->tag.blockNum, pages, n, false);
+
+		if (track_io_timing)
 		{
-			reusable_buffers++;
-			if (++num_written >= bgwriter_lru_maxpages)
-			{
-				BgWriterStats.m_maxwritten_clean++;
-				break;
-			}
+			INSTR_TIME_SET_CURRENT(io_time);
+			INSTR_TIME_SUBTRACT(io_time, io_start);
+			pgstat_count_buffer_write_time(INSTR_TIME_GET_MICROSEC(io_time));
+			INSTR_TIME_ADD(pgBufferUsage.blk_write_time, io_time);
 		}
-		else if (sync_state & BUF_REUSABLE)
-			reusable_buffers++;
-	}
 
-	BgWriterStats.m_buf_written_clean += num_written;
+		/* Mark the buffers clean, unless BM_JUST_DIRTIED has become set */
+		for (i = 0; i < n; i++)
+			FinishBufferIO(GetBufferDescriptor(PendingWriteBufIds[i]), true, 0);
+		nPendingWrites = 0;
 
-#ifdef BGW_DEBUG
-	elog(DEBUG1, "bgwriter: recent_alloc=%u smoothed=%.2f delta=%ld ahead=%d density=%.2f reusable_est=%d upcoming_est=%d scanned=%d wrote=%d reusable=%d",
-		 recent_alloc, smoothed_alloc, strategy_delta, bufs_ahead,
-		 smoothed_density, reusable_buffers_est, upcoming_alloc_est,
-		 bufs_to_lap - num_to_scan,
-		 num_written,
-		 reusable_buffers - reusable_buffers_est);
-#endif
+		error_context_stack = errcallback.previous;
 
-	/*
-	 * Consider the above scan as being like a new allocation scan.
-	 * Characterize its density and update the smoothed one based on it. This
-	 * effectively halves the moving average period in cases where both the
-	 * strategy and the background writer are doing some useful scanning,
-	 * which is helpful because a long memory isn't as desirable on the
-	 * density estimates.
-	 */
-	new_strategy_delta = bufs_to_lap - num_to_scan;
-	new_recent_alloc = reusable_buffers - reusable_buffers_est;
-	if (new_strategy_delta > 0 && new_recent_alloc > 0)
-	{
-		scans_per_alloc = (float) new_strategy_delta / (float) new_recent_alloc;
-		smoothed_density += (scans_per_alloc - smoothed_density) /
-			smoothing_samples;
+		for (i = 0; i < n; i++)
+		{
+			BufferDesc *bufHdr = GetBufferDescriptor(written[i]);
+			BufferTag	tag;
 
-#ifdef BGW_DEBUG
-		elog(DEBUG2, "bgwriter: cleaner density alloc=%u scan=%ld density=%.2f new smoothed=%.2f",
-			 new_recent_alloc, new_strategy_delta,
-			 scans_per_alloc, smoothed_density);
-#endif
+			LWLockRelease(BufferDescriptorGetContentLock(bufHdr));
+			tag = bufHdr->tag;
+			UnpinBuffer(bufHdr, true);
+			ScheduleBufferTagForWriteback(wb_context, &tag);
+		}
 	}
 
-	/* Return true if OK to hibernate */
-	return (bufs_to_lap == 0 && recent_alloc == 0);
+	pgBufferUsage.shared_blks_written += n;
+
+	return n;
 }
 
 /*
- * SyncOneBuffer -- process a single buffer during syncing.
- *
- * If skip_recently_used is true, we don't write currently-pinned buffers, nor
- * buffers marked recently used, as these are not replacement candidates.
- *
- * Returns a bitmask containing the following flag bits:
- *	BUF_WRITTEN: we wrote the buffer.
- *	BUF_REUSABLE: buffer is available for replacement, ie, it has
- *		pin count 0 and usage count 0.
- *
- * (BUF_WRITTEN could be set in error if FlushBuffers finds the buffer clean
- * after locking it, but we don't care all that much.)
+ * FinishBufferWrite -- wait for a write started by SyncBufferRun
  *
- * Note: caller must have done ResourceOwnerEnlargeBuffers.
+ * If the write failed, it's retried synchronously, so that the error is
+ * reported.  Releases the pin SyncBufferRun left on the buffer.
  */
-static int
-SyncOneBuffer(int buf_id, bool skip_recently_used, WritebackContext *wb_context)
+static void
+FinishBufferWrite(int buf_id, WritebackContext *wb_context)
 {
 	BufferDesc *bufHdr = GetBufferDescriptor(buf_id);
-	int			result = 0;
 	uint32		buf_state;
 	BufferTag	tag;
 
-	ReservePrivateRefCountEntry();
-
-	/*
-	 * Check whether buffer needs writing.
-	 *
-	 * We can make this check without taking the buffer content lock so long
-	 * as we mark pages dirty in access methods *before* logging changes with
-	 * XLogInsert(): if someone marks the buffer dirty just after our check we
-	 * don't worry because our checkpoint.redo points before log record for
-	 * upcoming changes and so we are not required to write such dirty buffer.
-	 */
-	buf_state = LockBufHdr(bufHdr);
-
-	if (BUF_STATE_GET_REFCOUNT(buf_state) == 0 &&
-		BUF_STATE_GET_USAGECOUNT(buf_state) == 0)
-	{
-		result |= BUF_REUSABLE;
-	}
-	else if (skip_recently_used)
-	{
-		/* Caller told us not to write recently-used buffers */
-		UnlockBufHdr(bufHdr, buf_state);
-		return result;
-	}
+	WaitIO(bufHdr);
 
-	if (!(buf_state & BM_VALID) || !(buf_state & BM_DIRTY))
+	buf_state = pg_atomic_read_u32(&bufHdr->state);
+	if ((buf_state & (BM_IO_ERROR | BM_DIRTY)) == (BM_IO_ERROR | BM_DIRTY))
 	{
-		/* It's clean, so nothing to do */
-		UnlockBufHdr(bufHdr, buf_state);
-		return result;
+		LWLockAcquire(BufferDescriptorGetContentLock(bufHdr), LW_SHARED);
+		FlushBuffer(bufHdr, NULL);
+		LWLockRelease(BufferDescriptorGetContentLock(bufHdr));
 	}
 
-	/*
-	 * Pin it, share-lock it, write it.  (FlushBuffer will do nothing if the
-	 * buffer is clean by the time we've locked it.)
-	 */
-	PinBuffer_Locked(bufHdr);
-	LWLockAcquire(BufferDescriptorGetContentLock(bufHdr), LW_SHARED);
-
-	FlushBuffer(bufHdr, NULL);
-
-	LWLockRelease(BufferDescriptorGetContentLock(bufHdr));
-
 	tag = bufHdr->tag;
-
 	UnpinBuffer(bufHdr, true);
 
 	ScheduleBufferTagForWriteback(wb_context, &tag);
-
-	return result | BUF_WRITTEN;
 }
 
 /*
@@ -2475,6 +3385,9 @@ AtProcExit_Buffers(int code, Datum arg)
 
 	CheckForBufferLeaks();
 
+	/* Don't lose the buffer hits counted for StrategyGetNodeStats() */
+	StrategyFlushHits();
+
 	/* localbuf.c needs a chance too */
 	AtProcExit_LocalBuffers();
 }
@@ -2673,8 +3586,8 @@ FlushBuffer(BufferDesc *buf, SMgrRelation reln)
 	uint32		buf_state;
 
 	/*
-	 * Acquire the buffer's io_in_progress lock.  If StartBufferIO returns
-	 * false, then someone else flushed the buffer before we could, so we need
+	 * Mark the buffer as I/O busy.  If StartBufferIO returns false, then
+	 * someone else flushed the buffer before we could, so we need
 	 * not do anything.
 	 */
 	if (!StartBufferIO(buf, false))
@@ -2731,7 +3644,7 @@ FlushBuffer(BufferDesc *buf, SMgrRelation reln)
 	/*
 	 * Now it's safe to write buffer to disk. Note that no one else should
 	 * have been able to write it while we were busy with log flushing because
-	 * we have the io_in_progress lock.
+	 * we have set BM_IO_IN_PROGRESS.
 	 */
 	bufBlock = BufHdrGetBlock(buf);
 
@@ -2766,7 +3679,7 @@ FlushBuffer(BufferDesc *buf, SMgrRelation reln)
 
 	/*
 	 * Mark the buffer as clean (unless BM_JUST_DIRTIED has become set) and
-	 * end the io_in_progress state.
+	 * end the I/O in progress state.
 	 */
 	TerminateBufferIO(buf, true, 0);
 
@@ -2925,6 +3838,29 @@ DropRelFileNodeBuffers(RelFileNodeBackend rnode, ForkNumber forkNum,
 		else
 			UnlockBufHdr(bufHdr, buf_state);
 	}
+
+	/* The pages may be in the compressed buffer tier too */
+	if (CompressedBuffersEnabled())
+	{
+		BufferTag	firstTag;
+
+		INIT_BUFFERTAG(firstTag, rnode.node, forkNum, firstDelBlock);
+		CompressedBufferDrop(DropRelFileNodeMatch, &firstTag);
+	}
+}
+
+/*
+ * CompressedBufferDrop match for DropRelFileNodeBuffers: is the page in the
+ * fork of firstTag, at or after its block?
+ */
+static bool
+DropRelFileNodeMatch(const BufferTag *tag, void *arg)
+{
+	BufferTag  *firstTag = (BufferTag *) arg;
+
+	return RelFileNodeEquals(tag->rnode, firstTag->rnode) &&
+		tag->forkNum == firstTag->forkNum &&
+		tag->blockNum >= firstTag->blockNum;
 }
 
 /* ---------------------------------------------------------------------
@@ -3025,9 +3961,43 @@ DropRelFileNodesAllBuffers(RelFileNodeBackend *rnodes, int nnodes)
 			UnlockBufHdr(bufHdr, buf_state);
 	}
 
+	/* The pages may be in the compressed buffer tier too */
+	if (CompressedBuffersEnabled())
+	{
+		DropRelFileNodesArg arg;
+
+		arg.nodes = nodes;
+		arg.nnodes = n;
+		arg.use_bsearch = use_bsearch;
+		CompressedBufferDrop(DropRelFileNodesMatch, &arg);
+	}
+
 	pfree(nodes);
 }
 
+/*
+ * CompressedBufferDrop match for DropRelFileNodesAllBuffers: is the page in
+ * one of the relations?
+ */
+static bool
+DropRelFileNodesMatch(const BufferTag *tag, void *arg)
+{
+	DropRelFileNodesArg *dropArg = (DropRelFileNodesArg *) arg;
+	int			j;
+
+	if (dropArg->use_bsearch)
+		return bsearch((const void *) &tag->rnode,
+					   dropArg->nodes, dropArg->nnodes, sizeof(RelFileNode),
+					   rnode_comparator) != NULL;
+
+	for (j = 0; j < dropArg->nnodes; j++)
+	{
+		if (RelFileNodeEquals(tag->rnode, dropArg->nodes[j]))
+			return true;
+	}
+	return false;
+}
+
 /* ---------------------------------------------------------------------
  *		DropDatabaseBuffers
  *
@@ -3067,6 +4037,20 @@ DropDatabaseBuffers(Oid dbid)
 		else
 			UnlockBufHdr(bufHdr, buf_state);
 	}
+
+	/* The pages may be in the compressed buffer tier too */
+	if (CompressedBuffersEnabled())
+		CompressedBufferDrop(DropDatabaseMatch, &dbid);
+}
+
+/*
+ * CompressedBufferDrop match for DropDatabaseBuffers: is the page in the
+ * database?
+ */
+static bool
+DropDatabaseMatch(const BufferTag *tag, void *arg)
+{
+	return tag->rnode.dbNode == *(Oid *) arg;
 }
 
 /* -----------------------------------------------------------------
@@ -3815,28 +4799,36 @@ IsBufferCleanupOK(Buffer buffer)
 /*
  *	Functions for buffer I/O handling
  *
- *	Note: We assume that nested buffer I/O never occurs.
- *	i.e at most one io_in_progress lock is held per proc.
+ *	Note: We assume that nested synchronous buffer I/O never occurs.
+ *	i.e at most one buffer is InProgressBuf per proc.  Asynchronous reads
+ *	and writes are not tracked in InProgressBuf; they are completed by
+ *	CompleteBufferIO, in whichever process notices their completion.
  *
  *	Also note that these are used only for shared buffers, not local ones.
  */
 
 /*
  * WaitIO -- Block until the IO_IN_PROGRESS flag on 'buf' is cleared.
+ *
+ * If the I/O is an asynchronous one, we help it along where we can: our own
+ * I/Os are submitted before we go to sleep, since the process that started
+ * an I/O we're waiting for might in turn be waiting for one of ours.
  */
 static void
 WaitIO(BufferDesc *buf)
 {
+	ConditionVariable *cv = BufferDescriptorGetIOCV(buf);
+
 	/*
 	 * Changed to wait until there's no IO - Inoue 01/13/2000
 	 *
 	 * Note this is *necessary* because an error abort in the process doing
-	 * I/O could release the io_in_progress_lock prematurely. See
-	 * AbortBufferIO.
+	 * I/O could wake us up before the I/O is terminated. See AbortBufferIO.
 	 */
 	for (;;)
 	{
 		uint32		buf_state;
+		int			io_handle;
 
 		/*
 		 * It may not be necessary to acquire the spinlock to check the flag
@@ -3844,13 +4836,28 @@ WaitIO(BufferDesc *buf)
 		 * play it safe.
 		 */
 		buf_state = LockBufHdr(buf);
+		io_handle = buf->io_handle;
 		UnlockBufHdr(buf, buf_state);
 
 		if (!(buf_state & BM_IO_IN_PROGRESS))
 			break;
-		LWLockAcquire(BufferDescriptorGetIOLock(buf), LW_SHARED);
-		LWLockRelease(BufferDescriptorGetIOLock(buf));
+
+		if (io_handle >= 0 && pgaio_io_progress(io_handle))
+			continue;
+
+		if (pgaio_enabled())
+		{
+			StartPendingReads();
+			pgaio_submit();
+		}
+
+		/*
+		 * The first call only prepares to sleep, so that we don't miss a
+		 * wakeup that happens before we recheck the flag.
+		 */
+		ConditionVariableSleep(cv, WAIT_EVENT_BUFFER_IO);
 	}
+	ConditionVariableCancelSleep();
 }
 
 /*
@@ -3861,8 +4868,8 @@ WaitIO(BufferDesc *buf)
  *
  * In some scenarios there are race conditions in which multiple backends
  * could attempt the same I/O operation concurrently.  If someone else
- * has already started I/O on this buffer then we will block on the
- * io_in_progress lock until he's done.
+ * has already started I/O on this buffer then we will wait on the buffer's
+ * I/O condition variable until he's done.
  *
  * Input operations are only attempted on buffers that are not BM_VALID,
  * and output operations only on buffers that are BM_VALID and BM_DIRTY,
@@ -3880,25 +4887,11 @@ StartBufferIO(BufferDesc *buf, bool forInput)
 
 	for (;;)
 	{
-		/*
-		 * Grab the io_in_progress lock so that other processes can wait for
-		 * me to finish the I/O.
-		 */
-		LWLockAcquire(BufferDescriptorGetIOLock(buf), LW_EXCLUSIVE);
-
 		buf_state = LockBufHdr(buf);
 
 		if (!(buf_state & BM_IO_IN_PROGRESS))
 			break;
-
-		/*
-		 * The only way BM_IO_IN_PROGRESS could be set when the io_in_progress
-		 * lock isn't held is if the process doing the I/O is recovering from
-		 * an error (see AbortBufferIO).  If that's the case, we must wait for
-		 * him to get unwedged.
-		 */
 		UnlockBufHdr(buf, buf_state);
-		LWLockRelease(BufferDescriptorGetIOLock(buf));
 		WaitIO(buf);
 	}
 
@@ -3908,7 +4901,6 @@ StartBufferIO(BufferDesc *buf, bool forInput)
 	{
 		/* someone else already did the I/O */
 		UnlockBufHdr(buf, buf_state);
-		LWLockRelease(BufferDescriptorGetIOLock(buf));
 		return false;
 	}
 
@@ -3921,12 +4913,145 @@ StartBufferIO(BufferDesc *buf, bool forInput)
 	return true;
 }
 
+/*
+ * StartPendingReads: hand the reads collected by StartReadBuffers to the AIO
+ * subsystem.  They are submitted by the next pgaio_submit() call.  With
+ * io_method = sync, they're performed right away instead.
+ */
+static void
+StartPendingReads(void)
+{
+	BufferDesc *first;
+	int			io_id;
+	int			i;
+
+	if (nPendingReads == 0)
+		return;
+
+	if (!pgaio_enabled())
+	{
+		ReadPendingBuffers();
+		return;
+	}
+
+	/*
+	 * If we error out while waiting for a free handle, the buffers are still
+	 * in PendingReadBufIds for AbortBufferIO to fail.  Once the I/O is
+	 * staged, they're pgaio_at_error's responsibility.
+	 */
+	first = GetBufferDescriptor(PendingReadBufIds[0]);
+	io_id = pgaio_start_read(first->tag.rnode, first->tag.forkNum,
+							 first->tag.blockNum, nPendingReads,
+							 PendingReadBufIds);
+
+	for (i = 0; i < nPendingReads; i++)
+	{
+		BufferDesc *buf = GetBufferDescriptor(PendingReadBufIds[i]);
+		uint32		buf_state;
+
+		buf_state = LockBufHdr(buf);
+		buf->io_handle = io_id;
+		UnlockBufHdr(buf, buf_state);
+	}
+	nPendingReads = 0;
+}
+
+/*
+ * ReadPendingBuffers: read the blocks collected by StartReadBuffers
+ * synchronously, with one smgrreadv() call.
+ *
+ * If a page fails verification, we error out with all of them still in
+ * PendingReadBufIds, so AbortBufferIO fails them all, and they'll be read
+ * again by whoever needs them.
+ */
+static void
+ReadPendingBuffers(void)
+{
+	BufferDesc *first = GetBufferDescriptor(PendingReadBufIds[0]);
+	SMgrRelation smgr = smgropen(first->tag.rnode, InvalidBackendId);
+	char	   *blocks[PGAIO_MAX_BLOCKS];
+	instr_time	io_start,
+				io_time;
+	int			i;
+
+	for (i = 0; i < nPendingReads; i++)
+		blocks[i] = BufHdrGetBlock(GetBufferDescriptor(PendingReadBufIds[i]));
+
+	if (track_io_timing)
+		INSTR_TIME_SET_CURRENT(io_start);
+
+	smgrreadv(smgr, first->tag.forkNum, first->tag.blockNum, blocks,
+			  nPendingReads);
+
+	if (track_io_timing)
+	{
+		INSTR_TIME_SET_CURRENT(io_time);
+		INSTR_TIME_SUBTRACT(io_time, io_start);
+		pgstat_count_buffer_read_time(INSTR_TIME_GET_MICROSEC(io_time));
+		INSTR_TIME_ADD(pgBufferUsage.blk_read_time, io_time);
+	}
+
+	/* check for garbage data, as in ReadBuffer_common */
+	for (i = 0; i < nPendingReads; i++)
+	{
+		BlockNumber blockNum = first->tag.blockNum + i;
+
+		if (!PageIsVerified((Page) blocks[i], blockNum))
+		{
+			if (zero_damaged_pages)
+			{
+				ereport(WARNING,
+						(errcode(ERRCODE_DATA_CORRUPTED),
+						 errmsg("invalid page in block %u of relation %s; zeroing out page",
+								blockNum,
+								relpath(smgr->smgr_rnode, first->tag.forkNum))));
+				MemSet(blocks[i], 0, BLCKSZ);
+			}
+			else
+				ereport(ERROR,
+						(errcode(ERRCODE_DATA_CORRUPTED),
+						 errmsg("invalid page in block %u of relation %s",
+								blockNum,
+								relpath(smgr->smgr_rnode, first->tag.forkNum))));
+		}
+	}
+
+	for (i = 0; i < nPendingReads; i++)
+		FinishBufferIO(GetBufferDescriptor(PendingReadBufIds[i]), false,
+					   BM_VALID);
+	nPendingReads = 0;
+}
+
+/*
+ * FinishBufferIO: common part of TerminateBufferIO and CompleteBufferIO
+ *
+ * Clears the buffer's I/O state and wakes up anyone waiting for it.
+ */
+static void
+FinishBufferIO(BufferDesc *buf, bool clear_dirty, uint32 set_flag_bits)
+{
+	uint32		buf_state;
+
+	buf_state = LockBufHdr(buf);
+
+	Assert(buf_state & BM_IO_IN_PROGRESS);
+
+	buf_state &= ~(BM_IO_IN_PROGRESS | BM_IO_ERROR);
+	if (clear_dirty && !(buf_state & BM_JUST_DIRTIED))
+		buf_state &= ~(BM_DIRTY | BM_CHECKPOINT_NEEDED);
+
+	buf_state |= set_flag_bits;
+	buf->io_handle = -1;
+	UnlockBufHdr(buf, buf_state);
+
+	ConditionVariableBroadcast(BufferDescriptorGetIOCV(buf));
+}
+
 /*
  * TerminateBufferIO: release a buffer we were doing I/O on
  *	(Assumptions)
  *	My process is executing IO for the buffer
  *	BM_IO_IN_PROGRESS bit is set for the buffer
- *	We hold the buffer's io_in_progress lock
  *	The buffer is Pinned
  *
  * If clear_dirty is true and BM_JUST_DIRTIED is not set, we clear the
@@ -3941,24 +5066,35 @@ StartBufferIO(BufferDesc *buf, bool forInput)
 static void
 TerminateBufferIO(BufferDesc *buf, bool clear_dirty, uint32 set_flag_bits)
 {
-	uint32		buf_state;
-
 	Assert(buf == InProgressBuf);
 
-	buf_state = LockBufHdr(buf);
-
-	Assert(buf_state & BM_IO_IN_PROGRESS);
-
-	buf_state &= ~(BM_IO_IN_PROGRESS | BM_IO_ERROR);
-	if (clear_dirty && !(buf_state & BM_JUST_DIRTIED))
-		buf_state &= ~(BM_DIRTY | BM_CHECKPOINT_NEEDED);
-
-	buf_state |= set_flag_bits;
-	UnlockBufHdr(buf, buf_state);
-
 	InProgressBuf = NULL;
 
-	LWLockRelease(BufferDescriptorGetIOLock(buf));
+	FinishBufferIO(buf, clear_dirty, set_flag_bits);
+}
+
+/*
+ * CompleteBufferIO: finish an asynchronous I/O on a buffer
+ *
+ * Called by the process that notices the completion of the I/O, which need
+ * not be the one that started it.  The buffer is still pinned by the latter.
+ * A page read in is verified here; if it's damaged, or the I/O failed, the
+ * buffer is left with BM_IO_ERROR set, and it's up to the process that
+ * wants the page to retry the I/O synchronously, which reports the error.
+ */
+void
+CompleteBufferIO(int buf_id, bool is_write, bool success)
+{
+	BufferDesc *buf = GetBufferDescriptor(buf_id);
+
+	if (!success)
+		FinishBufferIO(buf, false, BM_IO_ERROR);
+	else if (is_write)
+		FinishBufferIO(buf, true, 0);
+	else if (PageIsVerified((Page) BufHdrGetBlock(buf), buf->tag.blockNum))
+		FinishBufferIO(buf, false, BM_VALID);
+	else
+		FinishBufferIO(buf, false, BM_IO_ERROR);
 }
 
 /*
@@ -3969,24 +5105,20 @@ TerminateBufferIO(BufferDesc *buf, bool clear_dirty, uint32 set_flag_bits)
  *
  *	If I/O was in progress, we always set BM_IO_ERROR, even though it's
  *	possible the error condition wasn't related to the I/O.
+ *
+ *	Reads that were set up but not yet started are failed the same way, and
+ *	we wait for our asynchronous I/Os, whose buffers we still have pinned.
  */
 void
 AbortBufferIO(void)
 {
 	BufferDesc *buf = InProgressBuf;
+	int			i;
 
 	if (buf)
 	{
 		uint32		buf_state;
 
-		/*
-		 * Since LWLockReleaseAll has already been called, we're not holding
-		 * the buffer's io_in_progress_lock. We have to re-acquire it so that
-		 * we can use TerminateBufferIO. Anyone who's executing WaitIO on the
-		 * buffer will be in a busy spin until we succeed in doing this.
-		 */
-		LWLockAcquire(BufferDescriptorGetIOLock(buf), LW_EXCLUSIVE);
-
 		buf_state = LockBufHdr(buf);
 		Assert(buf_state & BM_IO_IN_PROGRESS);
 		if (IsForInput)
@@ -4018,6 +5150,18 @@ AbortBufferIO(void)
 		}
 		TerminateBufferIO(buf, false, BM_IO_ERROR);
 	}
+
+	for (i = 0; i < nPendingReads; i++)
+		FinishBufferIO(GetBufferDescriptor(PendingReadBufIds[i]), false,
+					   BM_IO_ERROR);
+	nPendingReads = 0;
+	for (i = 0; i < nPendingWrites; i++)
+		FinishBufferIO(GetBufferDescriptor(PendingWriteBufIds[i]), false,
+					   BM_IO_ERROR);
+	nPendingWrites = 0;
+
+	if (pgaio_enabled())
+		pgaio_at_error();
 }
 
 /*
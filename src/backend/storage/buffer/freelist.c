@@ -19,12 +19,45 @@
 #include "storage/buf_internals.h"
 #include "storage/bufmgr.h"
 #include "storage/proc.h"
+#include "utils/guc.h"
 
 #define INT_ACCESS_ONCE(var)	((int)(*((volatile int *)&(var))))
 
+/*
+ * Under the 2Q policy, the protected tier may hold at most this many buffers
+ * before the clock sweep starts demoting them.
+ */
+#define MaxProtectedBuffers()	(NBuffers - NBuffers / 4)
+
+/* Number of ghost entries kept for the 2Q policy */
+#define NumGhostEntries()		Max(NBuffers / 2, 16)
+
+/*
+ * The value stored in a ghost entry for a page with the given hash code.
+ * Zero marks an unused entry, so a hash code of zero is stored as one
+ * instead; that only makes the two collide, like any other pair of pages
+ * whose hash codes are equal.
+ */
+#define GhostHashValue(hashcode)	((hashcode) != 0 ? (hashcode) : 1)
+
+/* GUC variable */
+int			buffer_replacement_policy = BUFFER_REPLACEMENT_CLOCK;
+
+const struct config_enum_entry buffer_replacement_policy_options[] = {
+	{"clock", BUFFER_REPLACEMENT_CLOCK, false},
+	{"2q", BUFFER_REPLACEMENT_2Q, false},
+	{NULL, 0, false}
+};
 
 /*
- * The shared freelist control information.
+ * Number of buffer hits a process counts locally before adding them to the
+ * shared counters.
+ */
+#define PENDING_HITS_MAX		64
+
+/*
+ * The shared freelist control information of a buffer node.  Each buffer
+ * node has its own freelist and clock sweep, covering its own buffers.
  */
 typedef struct
 {
@@ -32,14 +65,16 @@ typedef struct
 	slock_t		buffer_strategy_lock;
 
 	/*
-	 * Clock sweep hand: index of next buffer to consider grabbing. Note that
-	 * this isn't a concrete buffer - we only ever increase the value. So, to
-	 * get an actual buffer, it needs to be used modulo NBuffers.
+	 * Clock sweep hand: index of next buffer to consider grabbing, relative
+	 * to the node's first buffer. Note that this isn't a concrete buffer -
+	 * we only ever increase the value. So, to get an actual buffer, it needs
+	 * to be used modulo the node's number of buffers.
 	 */
 	pg_atomic_uint32 nextVictimBuffer;
 
 	int			firstFreeBuffer;	/* Head of list of unused buffers */
 	int			lastFreeBuffer; /* Tail of list of unused buffers */
+	int			numFreeBuffers; /* Length of the list */
 
 	/*
 	 * NOTE: lastFreeBuffer is undefined when firstFreeBuffer is -1 (that is,
@@ -53,16 +88,73 @@ typedef struct
 	uint32		completePasses; /* Complete cycles of the clock sweep */
 	pg_atomic_uint32 numBufferAllocs;	/* Buffers allocated since last reset */
 
+	/* Counters for StrategyGetNodeStats() */
+	pg_atomic_uint64 numHits;
+	pg_atomic_uint64 numRemoteHits;
+	pg_atomic_uint64 numMisses;
+	pg_atomic_uint64 numRemoteMisses;
+} BufferStrategyNode;
+
+/* Buffer nodes are used on different NUMA nodes; don't share cache lines */
+typedef union BufferStrategyNodePadded
+{
+	BufferStrategyNode node;
+	char		pad[2 * PG_CACHE_LINE_SIZE];
+} BufferStrategyNodePadded;
+
+/*
+ * The shared replacement strategy control block.
+ */
+typedef struct
+{
+	/* Per buffer node information, NumBufferNodes() entries used */
+	BufferStrategyNodePadded nodes[MAX_BUFFER_NODES];
+
+	/* Spinlock: protects bgwprocno */
+	slock_t		buffer_strategy_lock;
+
 	/*
 	 * Bgworker process to be notified upon activity or -1 if none. See
 	 * StrategyNotifyBgWriter.
 	 */
 	int			bgwprocno;
+
+	/*
+	 * State of the 2Q policy, not used with the clock policy.  numProtected
+	 * is the number of buffers in the protected tier; the rest are counters
+	 * for StrategyGetTierStats().
+	 */
+	pg_atomic_uint32 numProtected;
+	pg_atomic_uint64 numAdmitted[NUM_BUF_TIERS];
+	pg_atomic_uint64 numEvicted[NUM_BUF_TIERS];
+	pg_atomic_uint64 numPromoted;
+	pg_atomic_uint64 numDemoted;
 } BufferStrategyControl;
 
 /* Pointers to shared state */
 static BufferStrategyControl *StrategyControl = NULL;
 
+#define GetStrategyNode(n)	(&StrategyControl->nodes[(n)].node)
+
+/*
+ * The buffer node of the NUMA node this process was last seen running on,
+ * or -1 if not known yet, and the buffer hits it has counted but not yet
+ * added to the shared counters.
+ */
+static int	MyBufferNode = -1;
+static uint32 PendingHits[MAX_BUFFER_NODES];
+static uint32 PendingRemoteHits[MAX_BUFFER_NODES];
+static int	NumPendingHits = 0;
+
+/*
+ * For the 2Q policy, the tier of each buffer, protected by the buffer header
+ * lock, and the hash codes of recently evicted pages ("ghost entries").  The
+ * ghost entries are read and written without any locking; a lost update only
+ * means a page is admitted to the wrong tier.
+ */
+static uint8 *BufferTiers = NULL;
+static uint32 *GhostHashes = NULL;
+
 /*
  * Private (non-shared) state for managing a ring of shared buffers to re-use.
  * This is currently the only kind of BufferAccessStrategy object, but someday
@@ -102,16 +194,21 @@ static BufferDesc *GetBufferFromRing(BufferAccessStrategy strategy,
 				  uint32 *buf_state);
 static void AddBufferToRing(BufferAccessStrategy strategy,
 				BufferDesc *buf);
+static int	ChooseBufferNode(void);
+static BufferDesc *ClockSweep(int node, uint32 *buf_state);
+static BufferDesc *TieredClockSweep(int node, uint32 *buf_state);
 
 /*
  * ClockSweepTick - Helper routine for StrategyGetBuffer()
  *
- * Move the clock hand one buffer ahead of its current position and return the
- * id of the buffer now under the hand.
+ * Move the clock hand of the given buffer node one buffer ahead of its
+ * current position and return the id of the buffer now under the hand.
  */
 static inline uint32
-ClockSweepTick(void)
+ClockSweepTick(int node)
 {
+	BufferStrategyNode *snode = GetStrategyNode(node);
+	uint32		nbuffers = BufferNodeSize(node);
 	uint32		victim;
 
 	/*
@@ -120,14 +217,14 @@ ClockSweepTick(void)
 	 * apparent order.
 	 */
 	victim =
-		pg_atomic_fetch_add_u32(&StrategyControl->nextVictimBuffer, 1);
+		pg_atomic_fetch_add_u32(&snode->nextVictimBuffer, 1);
 
-	if (victim >= NBuffers)
+	if (victim >= nbuffers)
 	{
 		uint32		originalVictim = victim;
 
 		/* always wrap what we look up in BufferDescriptors */
-		victim = victim % NBuffers;
+		victim = victim % nbuffers;
 
 		/*
 		 * If we're the one that just caused a wraparound, force
@@ -153,19 +250,61 @@ ClockSweepTick(void)
 				 * could lead to an overflow of nextVictimBuffers, but that's
 				 * highly unlikely and wouldn't be particularly harmful.
 				 */
-				SpinLockAcquire(&StrategyControl->buffer_strategy_lock);
+				SpinLockAcquire(&snode->buffer_strategy_lock);
 
-				wrapped = expected % NBuffers;
+				wrapped = expected % nbuffers;
 
-				success = pg_atomic_compare_exchange_u32(&StrategyControl->nextVictimBuffer,
+				success = pg_atomic_compare_exchange_u32(&snode->nextVictimBuffer,
 														 &expected, wrapped);
 				if (success)
-					StrategyControl->completePasses++;
-				SpinLockRelease(&StrategyControl->buffer_strategy_lock);
+					snode->completePasses++;
+				SpinLockRelease(&snode->buffer_strategy_lock);
 			}
 		}
 	}
-	return victim;
+	return BufferNodeFirst(node) + victim;
+}
+
+/*
+ * ChooseBufferNode - Helper routine for StrategyGetBuffer()
+ *
+ * Choose the buffer node to look for a buffer in first: the one of the NUMA
+ * node we're running on, unless its clock sweep has got a whole pass ahead
+ * of another node's, in which case the node furthest behind.  Without that,
+ * processes all running on the same NUMA node would only ever use that
+ * node's part of shared buffers.
+ */
+static int
+ChooseBufferNode(void)
+{
+	int			node;
+	int			slowest = 0;
+	double		my_passes = 0;
+	double		min_passes = 0;
+
+	MyBufferNode = CurrentBufferNode();
+	if (NumBufferNodes() == 1)
+		return MyBufferNode;
+
+	for (node = 0; node < NumBufferNodes(); node++)
+	{
+		BufferStrategyNode *snode = GetStrategyNode(node);
+		double		passes;
+
+		/* unlocked reads are good enough here */
+		passes = (double) snode->completePasses +
+			(double) pg_atomic_read_u32(&snode->nextVictimBuffer) /
+			BufferNodeSize(node);
+		if (node == MyBufferNode)
+			my_passes = passes;
+		if (node == 0 || passes < min_passes)
+		{
+			min_passes = passes;
+			slowest = node;
+		}
+	}
+
+	return (my_passes >= min_passes + 1.0) ? slowest : MyBufferNode;
 }
 
 /*
@@ -179,10 +318,14 @@ ClockSweepTick(void)
 bool
 have_free_buffer()
 {
-	if (StrategyControl->firstFreeBuffer >= 0)
-		return true;
-	else
-		return false;
+	int			node;
+
+	for (node = 0; node < NumBufferNodes(); node++)
+	{
+		if (GetStrategyNode(node)->firstFreeBuffer >= 0)
+			return true;
+	}
+	return false;
 }
 
 /*
@@ -202,7 +345,8 @@ StrategyGetBuffer(BufferAccessStrategy strategy, uint32 *buf_state)
 {
 	BufferDesc *buf;
 	int			bgwprocno;
-	int			trycounter;
+	int			node;
+	int			i;
 	uint32		local_buf_state;	/* to avoid repeated (de-)referencing */
 
 	/*
@@ -243,11 +387,13 @@ StrategyGetBuffer(BufferAccessStrategy strategy, uint32 *buf_state)
 	}
 
 	/*
-	 * We count buffer allocation requests so that the bgwriter can estimate
+	 * Prefer buffers of the NUMA node we're running on.  We count buffer
+	 * allocation requests, per buffer node, so that the bgwriter can estimate
 	 * the rate of buffer consumption.  Note that buffers recycled by a
 	 * strategy object are intentionally not counted here.
 	 */
-	pg_atomic_fetch_add_u32(&StrategyControl->numBufferAllocs, 1);
+	node = ChooseBufferNode();
+	pg_atomic_fetch_add_u32(&GetStrategyNode(node)->numBufferAllocs, 1);
 
 	/*
 	 * First check, without acquiring the lock, whether there's buffers in the
@@ -264,32 +410,42 @@ StrategyGetBuffer(BufferAccessStrategy strategy, uint32 *buf_state)
 	 * Note that the freeNext fields are considered to be protected by the
 	 * buffer_strategy_lock not the individual buffer spinlocks, so it's OK to
 	 * manipulate them without holding the spinlock.
+	 *
+	 * Free buffers of other buffer nodes are still better than evicting a
+	 * page from ours, so try their freelists too before the clock sweep.
 	 */
-	if (StrategyControl->firstFreeBuffer >= 0)
+	for (i = 0; i < NumBufferNodes(); i++)
 	{
+		BufferStrategyNode *snode;
+
+		snode = GetStrategyNode((node + i) % NumBufferNodes());
+		if (snode->firstFreeBuffer < 0)
+			continue;
+
 		while (true)
 		{
 			/* Acquire the spinlock to remove element from the freelist */
-			SpinLockAcquire(&StrategyControl->buffer_strategy_lock);
+			SpinLockAcquire(&snode->buffer_strategy_lock);
 
-			if (StrategyControl->firstFreeBuffer < 0)
+			if (snode->firstFreeBuffer < 0)
 			{
-				SpinLockRelease(&StrategyControl->buffer_strategy_lock);
+				SpinLockRelease(&snode->buffer_strategy_lock);
 				break;
 			}
 
-			buf = GetBufferDescriptor(StrategyControl->firstFreeBuffer);
+			buf = GetBufferDescriptor(snode->firstFreeBuffer);
 			Assert(buf->freeNext != FREENEXT_NOT_IN_LIST);
 
 			/* Unconditionally remove buffer from freelist */
-			StrategyControl->firstFreeBuffer = buf->freeNext;
+			snode->firstFreeBuffer = buf->freeNext;
+			snode->numFreeBuffers--;
 			buf->freeNext = FREENEXT_NOT_IN_LIST;
 
 			/*
 			 * Release the lock so someone else can access the freelist while
 			 * we check out this buffer.
 			 */
-			SpinLockRelease(&StrategyControl->buffer_strategy_lock);
+			SpinLockRelease(&snode->buffer_strategy_lock);
 
 			/*
 			 * If the buffer is pinned or has a nonzero usage_count, we cannot
@@ -312,11 +468,67 @@ StrategyGetBuffer(BufferAccessStrategy strategy, uint32 *buf_state)
 		}
 	}
 
-	/* Nothing on the freelist, so run the "clock sweep" algorithm */
-	trycounter = NBuffers;
+	/* Nothing on the freelists, so run the "clock sweep" algorithm */
+	buf = StrategySweepBuffer(node, buf_state);
+	if (strategy != NULL)
+		AddBufferToRing(strategy, buf);
+	return buf;
+}
+
+/*
+ * StrategySweepBuffer
+ *
+ *	Run the clock sweep of the given buffer node until it finds a buffer
+ *	that can be evicted, and return that buffer with its header spinlock
+ *	held.  If all of the node's buffers are pinned, try the other nodes.
+ *	This is used by StrategyGetBuffer() when the freelists are empty, and by
+ *	the background writer to refill the freelists ahead of allocations.
+ */
+BufferDesc *
+StrategySweepBuffer(int node, uint32 *buf_state)
+{
+	int			i;
+
+	for (i = 0; i < NumBufferNodes(); i++)
+	{
+		int			n = (node + i) % NumBufferNodes();
+		BufferDesc *buf;
+
+		if (buffer_replacement_policy == BUFFER_REPLACEMENT_2Q)
+			buf = TieredClockSweep(n, buf_state);
+		else
+			buf = ClockSweep(n, buf_state);
+		if (buf != NULL)
+			return buf;
+	}
+
+	/*
+	 * We've scanned all the buffers without making any state changes, so all
+	 * the buffers are pinned (or were when we looked at them).  We could hope
+	 * that someone will free one eventually, but it's probably better to fail
+	 * than to risk getting stuck in an infinite loop.
+	 */
+	elog(ERROR, "no unpinned buffers available");
+	return NULL;				/* keep compiler quiet */
+}
+
+/*
+ * ClockSweep -- the clock sweep of the clock policy, for one buffer node
+ *
+ * Returns a buffer with its header spinlock held, or NULL if all of the
+ * node's buffers are pinned.
+ */
+static BufferDesc *
+ClockSweep(int node, uint32 *buf_state)
+{
+	BufferDesc *buf;
+	int			trycounter;
+	uint32		local_buf_state;	/* to avoid repeated (de-)referencing */
+
+	trycounter = BufferNodeSize(node);
 	for (;;)
 	{
-		buf = GetBufferDescriptor(ClockSweepTick());
+		buf = GetBufferDescriptor(ClockSweepTick(node));
 
 		/*
 		 * If the buffer is pinned or has a nonzero usage_count, we cannot use
@@ -330,40 +542,328 @@ StrategyGetBuffer(BufferAccessStrategy strategy, uint32 *buf_state)
 			{
 				local_buf_state -= BUF_USAGECOUNT_ONE;
 
-				trycounter = NBuffers;
+				trycounter = BufferNodeSize(node);
 			}
 			else
 			{
 				/* Found a usable buffer */
-				if (strategy != NULL)
-					AddBufferToRing(strategy, buf);
 				*buf_state = local_buf_state;
 				return buf;
 			}
 		}
 		else if (--trycounter == 0)
+		{
+			/* We've scanned all the node's buffers without any change */
+			UnlockBufHdr(buf, local_buf_state);
+			return NULL;
+		}
+		UnlockBufHdr(buf, local_buf_state);
+	}
+}
+
+/*
+ * TieredClockSweep -- the clock sweep of the 2Q policy
+ *
+ * Buffers are in one of two tiers.  A page read into shared buffers starts
+ * out in the probation tier, and the clock sweep evicts it on its next pass
+ * unless it has been used again in the meantime, in which case it's promoted
+ * to the protected tier instead.  That way, pages touched just once, as by a
+ * large scan, can only displace each other and not the working set.  Buffers
+ * in the protected tier are left alone while that tier is within its size
+ * limit; above it, the sweep decrements their usage counts and demotes them
+ * to probation when they reach zero.
+ *
+ * Like ClockSweep, sweeps the buffers of one buffer node, and returns the
+ * buffer with its header spinlock held, or NULL if they're all pinned.
+ */
+static BufferDesc *
+TieredClockSweep(int node, uint32 *buf_state)
+{
+	int			trycounter = BufferNodeSize(node);
+	bool		age_protected = false;
+
+	for (;;)
+	{
+		BufferDesc *buf = GetBufferDescriptor(ClockSweepTick(node));
+		uint8	   *tier = &BufferTiers[buf->buf_id];
+		uint32		local_buf_state = LockBufHdr(buf);
+
+		if (BUF_STATE_GET_REFCOUNT(local_buf_state) != 0)
+		{
+			/* pinned, keep scanning */
+		}
+		else if (*tier == BUF_TIER_PROBATION)
+		{
+			if (BUF_STATE_GET_USAGECOUNT(local_buf_state) <= 1)
+			{
+				/* Found a usable buffer */
+				*buf_state = local_buf_state;
+				return buf;
+			}
+
+			/* Used again since it was read in, so promote it */
+			*tier = BUF_TIER_PROTECTED;
+			local_buf_state &= ~BUF_USAGECOUNT_MASK;
+			local_buf_state += BUF_USAGECOUNT_ONE;
+			pg_atomic_fetch_add_u32(&StrategyControl->numProtected, 1);
+			pg_atomic_fetch_add_u64(&StrategyControl->numPromoted, 1);
+			trycounter = BufferNodeSize(node);
+		}
+		else if (age_protected ||
+				 pg_atomic_read_u32(&StrategyControl->numProtected) >
+				 MaxProtectedBuffers())
+		{
+			if (BUF_STATE_GET_USAGECOUNT(local_buf_state) != 0)
+				local_buf_state -= BUF_USAGECOUNT_ONE;
+			else
+			{
+				/* Demote it, giving it one more pass to be used again */
+				*tier = BUF_TIER_PROBATION;
+				local_buf_state += BUF_USAGECOUNT_ONE;
+				pg_atomic_fetch_sub_u32(&StrategyControl->numProtected, 1);
+				pg_atomic_fetch_add_u64(&StrategyControl->numDemoted, 1);
+			}
+			trycounter = BufferNodeSize(node);
+		}
+
+		if (--trycounter == 0)
 		{
 			/*
-			 * We've scanned all the buffers without making any state changes,
-			 * so all the buffers are pinned (or were when we looked at them).
-			 * We could hope that someone will free one eventually, but it's
-			 * probably better to fail than to risk getting stuck in an
-			 * infinite loop.
+			 * A whole pass without a usable buffer.  If we've been leaving the
+			 * protected tier alone, age it after all; otherwise every buffer
+			 * is pinned.
 			 */
-			UnlockBufHdr(buf, local_buf_state);
-			elog(ERROR, "no unpinned buffers available");
+			if (!age_protected)
+			{
+				age_protected = true;
+				trycounter = BufferNodeSize(node);
+			}
+			else
+			{
+				UnlockBufHdr(buf, local_buf_state);
+				return NULL;
+			}
 		}
 		UnlockBufHdr(buf, local_buf_state);
 	}
 }
 
 /*
- * StrategyFreeBuffer: put a buffer on the freelist
+ * StrategyAdmitBuffer -- note that a buffer is being given a new page
+ *
+ * Called by BufferAlloc() with the buffer header spinlock held, once it's
+ * committed to retagging buf.  If evicted is true, the buffer held a valid
+ * page before, with hash code oldHash; newHash is the new page's hash code.
+ *
+ * With the 2Q policy, the evicted page is remembered in a ghost entry, and
+ * the new page goes straight to the protected tier if it was evicted
+ * recently enough to still have one.  Pages read through a buffer access
+ * strategy always go to the probation tier, and pages evicted on behalf of
+ * one aren't remembered, so that repeated bulk scans don't promote each
+ * other's pages.
+ */
+void
+StrategyAdmitBuffer(BufferAccessStrategy strategy, BufferDesc *buf,
+					bool evicted, uint32 oldHash, uint32 newHash)
+{
+	uint8	   *tier;
+	uint32	   *ghost;
+	int			node = BufferNodeOf(buf->buf_id);
+
+	/* A new page is a buffer miss; count it for StrategyGetNodeStats() */
+	if (MyBufferNode >= 0 && node != MyBufferNode)
+		pg_atomic_fetch_add_u64(&GetStrategyNode(node)->numRemoteMisses, 1);
+	else
+		pg_atomic_fetch_add_u64(&GetStrategyNode(node)->numMisses, 1);
+
+	if (buffer_replacement_policy != BUFFER_REPLACEMENT_2Q)
+		return;
+
+	tier = &BufferTiers[buf->buf_id];
+	if (evicted)
+	{
+		pg_atomic_fetch_add_u64(&StrategyControl->numEvicted[*tier], 1);
+		if (strategy == NULL)
+			GhostHashes[oldHash % NumGhostEntries()] = GhostHashValue(oldHash);
+	}
+	if (*tier == BUF_TIER_PROTECTED)
+		pg_atomic_fetch_sub_u32(&StrategyControl->numProtected, 1);
+
+	ghost = &GhostHashes[newHash % NumGhostEntries()];
+	if (strategy == NULL && *ghost == GhostHashValue(newHash))
+	{
+		*ghost = 0;
+		*tier = BUF_TIER_PROTECTED;
+		pg_atomic_fetch_add_u32(&StrategyControl->numProtected, 1);
+	}
+	else
+		*tier = BUF_TIER_PROBATION;
+	pg_atomic_fetch_add_u64(&StrategyControl->numAdmitted[*tier], 1);
+}
+
+/*
+ * StrategyEvictBuffer -- note that a buffer's page has been evicted
+ *
+ * Called with the buffer header spinlock held, when a buffer chosen by
+ * StrategySweepBuffer() is emptied to be put on the freelist.  hashcode is
+ * the hash code of the page it held.
+ */
+void
+StrategyEvictBuffer(BufferDesc *buf, uint32 hashcode)
+{
+	uint8	   *tier;
+
+	if (buffer_replacement_policy != BUFFER_REPLACEMENT_2Q)
+		return;
+
+	tier = &BufferTiers[buf->buf_id];
+	pg_atomic_fetch_add_u64(&StrategyControl->numEvicted[*tier], 1);
+	GhostHashes[hashcode % NumGhostEntries()] = GhostHashValue(hashcode);
+	if (*tier == BUF_TIER_PROTECTED)
+	{
+		*tier = BUF_TIER_PROBATION;
+		pg_atomic_fetch_sub_u32(&StrategyControl->numProtected, 1);
+	}
+}
+
+/*
+ * StrategyForgetBuffer -- note that a buffer's page has been invalidated
+ *
+ * Called with the buffer header spinlock held.
+ */
+void
+StrategyForgetBuffer(BufferDesc *buf)
+{
+	if (buffer_replacement_policy != BUFFER_REPLACEMENT_2Q)
+		return;
+
+	if (BufferTiers[buf->buf_id] == BUF_TIER_PROTECTED)
+	{
+		BufferTiers[buf->buf_id] = BUF_TIER_PROBATION;
+		pg_atomic_fetch_sub_u32(&StrategyControl->numProtected, 1);
+	}
+}
+
+/*
+ * StrategyGetTierStats -- report statistics about the buffer tiers
+ *
+ * Fills stats[], which has NUM_BUF_TIERS elements.  The counters are only
+ * maintained under the 2Q policy; under the clock policy, all buffers are
+ * reported in the probation tier.
+ */
+void
+StrategyGetTierStats(BufferTierStats *stats)
+{
+	uint32		nprotected = pg_atomic_read_u32(&StrategyControl->numProtected);
+	int			i;
+
+	for (i = 0; i < NUM_BUF_TIERS; i++)
+	{
+		stats[i].admitted = pg_atomic_read_u64(&StrategyControl->numAdmitted[i]);
+		stats[i].evicted = pg_atomic_read_u64(&StrategyControl->numEvicted[i]);
+		stats[i].promoted = 0;
+		stats[i].demoted = 0;
+	}
+	stats[BUF_TIER_PROBATION].buffers = NBuffers - nprotected;
+	stats[BUF_TIER_PROBATION].promoted =
+		pg_atomic_read_u64(&StrategyControl->numPromoted);
+	stats[BUF_TIER_PROTECTED].buffers = nprotected;
+	stats[BUF_TIER_PROTECTED].demoted =
+		pg_atomic_read_u64(&StrategyControl->numDemoted);
+}
+
+/*
+ * StrategyGetNodeStats -- report statistics about the buffer nodes
+ *
+ * Fills stats[], which must have room for MAX_BUFFER_NODES elements, and
+ * returns the number of buffer nodes.  Hits counted by other backends but
+ * not yet flushed by them aren't included.
+ */
+int
+StrategyGetNodeStats(BufferNodeStats *stats)
+{
+	int			node;
+
+	StrategyFlushHits();
+
+	for (node = 0; node < NumBufferNodes(); node++)
+	{
+		BufferStrategyNode *snode = GetStrategyNode(node);
+
+		stats[node].numaNode = BufferNodes->numaNode[node];
+		stats[node].buffers = BufferNodeSize(node);
+		stats[node].hits = pg_atomic_read_u64(&snode->numHits);
+		stats[node].remoteHits = pg_atomic_read_u64(&snode->numRemoteHits);
+		stats[node].misses = pg_atomic_read_u64(&snode->numMisses);
+		stats[node].remoteMisses = pg_atomic_read_u64(&snode->numRemoteMisses);
+	}
+
+	return NumBufferNodes();
+}
+
+/*
+ * StrategyNoteHit -- count a buffer hit for StrategyGetNodeStats()
+ *
+ * To keep processes on different NUMA nodes from fighting over the cache
+ * lines of the shared counters, hits are counted locally and added to the
+ * shared counters in batches.
+ */
+void
+StrategyNoteHit(BufferDesc *buf)
+{
+	int			node = BufferNodeOf(buf->buf_id);
+
+	if (MyBufferNode < 0)
+		MyBufferNode = CurrentBufferNode();
+
+	if (node == MyBufferNode)
+		PendingHits[node]++;
+	else
+		PendingRemoteHits[node]++;
+
+	if (++NumPendingHits >= PENDING_HITS_MAX)
+		StrategyFlushHits();
+}
+
+/*
+ * StrategyFlushHits -- add the locally counted buffer hits to the shared
+ *		counters
+ */
+void
+StrategyFlushHits(void)
+{
+	int			node;
+
+	if (NumPendingHits == 0)
+		return;
+
+	for (node = 0; node < NumBufferNodes(); node++)
+	{
+		BufferStrategyNode *snode = GetStrategyNode(node);
+
+		if (PendingHits[node] > 0)
+			pg_atomic_fetch_add_u64(&snode->numHits, PendingHits[node]);
+		if (PendingRemoteHits[node] > 0)
+			pg_atomic_fetch_add_u64(&snode->numRemoteHits,
+									PendingRemoteHits[node]);
+		PendingHits[node] = 0;
+		PendingRemoteHits[node] = 0;
+	}
+	NumPendingHits = 0;
+
+	/* The process may have been moved to another NUMA node meanwhile */
+	MyBufferNode = CurrentBufferNode();
+}
+
+/*
+ * StrategyFreeBuffer: put a buffer on its buffer node's freelist
  */
 void
 StrategyFreeBuffer(BufferDesc *buf)
 {
-	SpinLockAcquire(&StrategyControl->buffer_strategy_lock);
+	BufferStrategyNode *snode = GetStrategyNode(BufferNodeOf(buf->buf_id));
+
+	SpinLockAcquire(&snode->buffer_strategy_lock);
 
 	/*
 	 * It is possible that we are told to put something in the freelist that
@@ -371,20 +871,33 @@ StrategyFreeBuffer(BufferDesc *buf)
 	 */
 	if (buf->freeNext == FREENEXT_NOT_IN_LIST)
 	{
-		buf->freeNext = StrategyControl->firstFreeBuffer;
+		buf->freeNext = snode->firstFreeBuffer;
 		if (buf->freeNext < 0)
-			StrategyControl->lastFreeBuffer = buf->buf_id;
-		StrategyControl->firstFreeBuffer = buf->buf_id;
+			snode->lastFreeBuffer = buf->buf_id;
+		snode->firstFreeBuffer = buf->buf_id;
+		snode->numFreeBuffers++;
 	}
 
-	SpinLockRelease(&StrategyControl->buffer_strategy_lock);
+	SpinLockRelease(&snode->buffer_strategy_lock);
+}
+
+/*
+ * StrategyFreeListLength -- number of buffers on a buffer node's freelist
+ *
+ * This is read without the lock, so it's only an estimate.
+ */
+int
+StrategyFreeListLength(int node)
+{
+	return INT_ACCESS_ONCE(GetStrategyNode(node)->numFreeBuffers);
 }
 
 /*
  * StrategySyncStart -- tell BufferSync where to start syncing
  *
- * The result is the buffer index of the best buffer to sync first.
- * BufferSync() will proceed circularly around the buffer array from there.
+ * The result is the index, relative to the buffer node's first buffer, of
+ * the best buffer of the node to sync first.  BufferSync() will proceed
+ * circularly around the node's buffers from there.
  *
  * In addition, we return the completed-pass count (which is effectively
  * the higher-order bits of nextVictimBuffer) and the count of recent buffer
@@ -392,31 +905,33 @@ StrategyFreeBuffer(BufferDesc *buf)
  * being read.
  */
 int
-StrategySyncStart(uint32 *complete_passes, uint32 *num_buf_alloc)
+StrategySyncStart(int node, uint32 *complete_passes, uint32 *num_buf_alloc)
 {
+	BufferStrategyNode *snode = GetStrategyNode(node);
+	uint32		nbuffers = BufferNodeSize(node);
 	uint32		nextVictimBuffer;
 	int			result;
 
-	SpinLockAcquire(&StrategyControl->buffer_strategy_lock);
-	nextVictimBuffer = pg_atomic_read_u32(&StrategyControl->nextVictimBuffer);
-	result = nextVictimBuffer % NBuffers;
+	SpinLockAcquire(&snode->buffer_strategy_lock);
+	nextVictimBuffer = pg_atomic_read_u32(&snode->nextVictimBuffer);
+	result = nextVictimBuffer % nbuffers;
 
 	if (complete_passes)
 	{
-		*complete_passes = StrategyControl->completePasses;
+		*complete_passes = snode->completePasses;
 
 		/*
 		 * Additionally add the number of wraparounds that happened before
 		 * completePasses could be incremented. C.f. ClockSweepTick().
 		 */
-		*complete_passes += nextVictimBuffer / NBuffers;
+		*complete_passes += nextVictimBuffer / nbuffers;
 	}
 
 	if (num_buf_alloc)
 	{
-		*num_buf_alloc = pg_atomic_exchange_u32(&StrategyControl->numBufferAllocs, 0);
+		*num_buf_alloc = pg_atomic_exchange_u32(&snode->numBufferAllocs, 0);
 	}
-	SpinLockRelease(&StrategyControl->buffer_strategy_lock);
+	SpinLockRelease(&snode->buffer_strategy_lock);
 	return result;
 }
 
@@ -461,6 +976,13 @@ StrategyShmemSize(void)
 	/* size of the shared replacement strategy control block */
 	size = add_size(size, MAXALIGN(sizeof(BufferStrategyControl)));
 
+	/* size of the buffer tiers and ghost entries of the 2Q policy */
+	if (buffer_replacement_policy == BUFFER_REPLACEMENT_2Q)
+	{
+		size = add_size(size, MAXALIGN(mul_size(NBuffers, sizeof(uint8))));
+		size = add_size(size, mul_size(NumGhostEntries(), sizeof(uint32)));
+	}
+
 	return size;
 }
 
@@ -475,6 +997,7 @@ void
 StrategyInitialize(bool init)
 {
 	bool		found;
+	int			i;
 
 	/*
 	 * Initialize the shared buffer lookup hashtable.
@@ -505,25 +1028,67 @@ StrategyInitialize(bool init)
 
 		SpinLockInit(&StrategyControl->buffer_strategy_lock);
 
-		/*
-		 * Grab the whole linked list of free buffers for our strategy. We
-		 * assume it was previously set up by InitBufferPool().
-		 */
-		StrategyControl->firstFreeBuffer = 0;
-		StrategyControl->lastFreeBuffer = NBuffers - 1;
+		for (i = 0; i < NumBufferNodes(); i++)
+		{
+			BufferStrategyNode *snode = GetStrategyNode(i);
 
-		/* Initialize the clock sweep pointer */
-		pg_atomic_init_u32(&StrategyControl->nextVictimBuffer, 0);
+			SpinLockInit(&snode->buffer_strategy_lock);
 
-		/* Clear statistics */
-		StrategyControl->completePasses = 0;
-		pg_atomic_init_u32(&StrategyControl->numBufferAllocs, 0);
+			/*
+			 * Grab the linked list of the node's free buffers for our
+			 * strategy. We assume it was previously set up by
+			 * InitBufferPool().
+			 */
+			snode->firstFreeBuffer = BufferNodeFirst(i);
+			snode->lastFreeBuffer = BufferNodeFirst(i) + BufferNodeSize(i) - 1;
+			snode->numFreeBuffers = BufferNodeSize(i);
+
+			/* Initialize the clock sweep pointer */
+			pg_atomic_init_u32(&snode->nextVictimBuffer, 0);
+
+			/* Clear statistics */
+			snode->completePasses = 0;
+			pg_atomic_init_u32(&snode->numBufferAllocs, 0);
+			pg_atomic_init_u64(&snode->numHits, 0);
+			pg_atomic_init_u64(&snode->numRemoteHits, 0);
+			pg_atomic_init_u64(&snode->numMisses, 0);
+			pg_atomic_init_u64(&snode->numRemoteMisses, 0);
+		}
 
 		/* No pending notification */
 		StrategyControl->bgwprocno = -1;
+
+		/* Every buffer starts out in the probation tier */
+		pg_atomic_init_u32(&StrategyControl->numProtected, 0);
+		for (i = 0; i < NUM_BUF_TIERS; i++)
+		{
+			pg_atomic_init_u64(&StrategyControl->numAdmitted[i], 0);
+			pg_atomic_init_u64(&StrategyControl->numEvicted[i], 0);
+		}
+		pg_atomic_init_u64(&StrategyControl->numPromoted, 0);
+		pg_atomic_init_u64(&StrategyControl->numDemoted, 0);
 	}
 	else
 		Assert(!init);
+
+	/*
+	 * Get or create the state of the 2Q policy.  A zeroed entry is in the
+	 * probation tier, or is an unused ghost entry.
+	 */
+	if (buffer_replacement_policy == BUFFER_REPLACEMENT_2Q)
+	{
+		BufferTiers = (uint8 *)
+			ShmemInitStruct("Buffer Strategy Tiers",
+							NBuffers * sizeof(uint8), &found);
+		if (!found)
+			MemSet(BufferTiers, 0, NBuffers * sizeof(uint8));
+
+		GhostHashes = (uint32 *)
+			ShmemInitStruct("Buffer Strategy Ghost Entries",
+							NumGhostEntries() * sizeof(uint32), &found);
+		if (!found)
+			MemSet(GhostHashes, 0, NumGhostEntries() * sizeof(uint32));
+	}
 }
 
 
@@ -587,6 +1152,20 @@ GetAccessStrategy(BufferAccessStrategyType btype)
 	return strategy;
 }
 
+/*
+ * GetAccessStrategyBufferCount -- number of buffers in a strategy's ring
+ *
+ * Callers pinning several buffers at a time use this to avoid pinning so
+ * many that the ring can't be recycled.  Returns 0 for the default strategy.
+ */
+int
+GetAccessStrategyBufferCount(BufferAccessStrategy strategy)
+{
+	if (strategy == NULL)
+		return 0;
+	return strategy->ring_size;
+}
+
 /*
  * FreeAccessStrategy -- release a BufferAccessStrategy object
  *
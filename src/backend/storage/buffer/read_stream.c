@@ -0,0 +1,359 @@
+/*-------------------------------------------------------------------------
+ *
+ * read_stream.c
+ *	  Look-ahead reading of a sequence of relation blocks
+ *
+ * A read stream lets a scan that knows which blocks it will need next, such
+ * as a sequential scan, a bitmap heap scan, ANALYZE's block sample or
+ * VACUUM, read them ahead of time.  The scan supplies a callback returning
+ * the block numbers in order, and takes the buffers one by one with
+ * read_stream_next_buffer().
+ *
+ * Behind the scenes, the stream asks the callback for blocks ahead of the
+ * one being returned, up to a look-ahead distance.  Runs of consecutive
+ * blocks are combined and started with a single StartReadBuffers() call, so
+ * that with asynchronous I/O (see storage/aio) they're read with one I/O
+ * while the scan is busy with earlier blocks.  Without asynchronous I/O,
+ * reads are only started when the blocks are needed, but the kernel is
+ * advised of upcoming non-sequential blocks with PrefetchBuffer().
+ *
+ * The look-ahead distance adapts to the workload: it starts at one block,
+ * doubles whenever a read has to go to disk, and shrinks by one whenever all
+ * the blocks of a run were found in the buffer cache, so that scans of
+ * cached data don't pin buffers needlessly.  Its maximum is derived from
+ * effective_io_concurrency (or the tablespace's setting), and limited so
+ * that we don't pin too much of shared buffers or of the buffer access
+ * strategy's ring.
+ *
+ * Portions Copyright (c) 1996-2018, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/storage/buffer/read_stream.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <math.h>
+
+#include "miscadmin.h"
+#include "storage/aio.h"
+#include "storage/bufmgr.h"
+#include "storage/fd.h"
+#include "storage/read_stream.h"
+#include "utils/rel.h"
+#include "utils/spccache.h"
+
+
+/*
+ * The stream's queue is a ring of look-ahead entries, oldest first.  The
+ * first nstarted entries have been passed to StartReadBuffers and are
+ * pinned; the rest only have their block number known so far.
+ */
+struct ReadStream
+{
+	Relation	rel;
+	ForkNumber	forknum;
+	BufferAccessStrategy strategy;
+	ReadStreamBlockNumberCB callback;
+	void	   *callback_private_data;
+
+	bool		async;			/* start reads while looking ahead? */
+	bool		advice;			/* issue PrefetchBuffer() for new blocks? */
+	bool		finished;		/* has the callback returned the last block? */
+	int			distance;		/* current look-ahead distance */
+	int			max_distance;	/* upper limit for distance, and queue size */
+	BlockNumber last_blocknum;	/* block most recently added to the queue */
+
+	int			head;			/* index of the oldest entry */
+	int			nqueued;		/* number of entries in the queue */
+	int			nstarted;		/* number of them that have been started */
+
+	size_t		per_buffer_data_size;
+	char	   *per_buffer_data;	/* max_distance entries of that size */
+	BlockNumber *blocknums;		/* max_distance entries */
+	Buffer	   *buffers;		/* max_distance entries */
+};
+
+static int	read_stream_max_distance(Relation rel,
+						 BufferAccessStrategy strategy, bool *advice);
+static void *read_stream_entry_data(ReadStream *stream, int index);
+static int	read_stream_run_length(ReadStream *stream, int first);
+static void read_stream_start_run(ReadStream *stream, int nblocks);
+static void read_stream_look_ahead(ReadStream *stream);
+
+
+/*
+ * Compute the maximum look-ahead distance for a stream over rel.  *advice is
+ * set to false if the I/O concurrency setting disables prefetching.
+ */
+static int
+read_stream_max_distance(Relation rel, BufferAccessStrategy strategy,
+						 bool *advice)
+{
+	int			io_concurrency;
+	double		target = target_prefetch_pages;
+	int			max_distance;
+	int			ring_size;
+
+	io_concurrency = get_tablespace_io_concurrency(rel->rd_rel->reltablespace);
+	if (io_concurrency != effective_io_concurrency)
+		(void) ComputeIoConcurrency(io_concurrency, &target);
+	*advice = (rint(target) > 0);
+
+	/* Allow that many I/Os of the largest size */
+	max_distance = Max((int) rint(target), 1) * PGAIO_MAX_BLOCKS;
+
+	/* Don't take more than our share of shared buffers */
+	max_distance = Min(max_distance, Max(NBuffers / MaxBackends, 1));
+
+	/* ... or more than half the strategy's ring, so that it can be reused */
+	ring_size = GetAccessStrategyBufferCount(strategy);
+	if (ring_size > 0)
+		max_distance = Min(max_distance, Max(ring_size / 2, 1));
+
+	return max_distance;
+}
+
+/*
+ * read_stream_begin_relation -- set up a read stream on a relation fork
+ *
+ * The callback is called with callback_private_data to get each block
+ * number in turn; per_buffer_data_size bytes are reserved for each block
+ * for the callback's use.  The stream is allocated in the current memory
+ * context.
+ */
+ReadStream *
+read_stream_begin_relation(Relation rel,
+						   ForkNumber forknum,
+						   BufferAccessStrategy strategy,
+						   ReadStreamBlockNumberCB callback,
+						   void *callback_private_data,
+						   size_t per_buffer_data_size)
+{
+	ReadStream *stream;
+	int			max_distance;
+	bool		advice;
+
+	max_distance = read_stream_max_distance(rel, strategy, &advice);
+
+	stream = (ReadStream *) palloc0(sizeof(ReadStream));
+	stream->rel = rel;
+	stream->forknum = forknum;
+	stream->strategy = strategy;
+	stream->callback = callback;
+	stream->callback_private_data = callback_private_data;
+
+	/*
+	 * Local buffers are always read synchronously, so there's no point in
+	 * starting them early, and they can't be prefetched either.  Advice is
+	 * pointless if the reads are asynchronous, or bypass the kernel's cache.
+	 */
+	stream->async = pgaio_enabled() && !RelationUsesLocalBuffers(rel);
+	stream->advice = advice && !pgaio_enabled() &&
+		!(io_direct_flags & IO_DIRECT_DATA) &&
+		!RelationUsesLocalBuffers(rel);
+
+	stream->distance = 1;
+	stream->max_distance = max_distance;
+	stream->last_blocknum = InvalidBlockNumber;
+
+	stream->per_buffer_data_size = MAXALIGN(per_buffer_data_size);
+	if (per_buffer_data_size > 0)
+		stream->per_buffer_data = palloc(stream->per_buffer_data_size *
+										 max_distance);
+	stream->blocknums = (BlockNumber *) palloc(sizeof(BlockNumber) *
+											   max_distance);
+	stream->buffers = (Buffer *) palloc(sizeof(Buffer) * max_distance);
+
+	return stream;
+}
+
+/*
+ * Get the per-buffer data of a queue entry.
+ */
+static void *
+read_stream_entry_data(ReadStream *stream, int index)
+{
+	if (stream->per_buffer_data == NULL)
+		return NULL;
+	return stream->per_buffer_data + stream->per_buffer_data_size * index;
+}
+
+/*
+ * Number of consecutive blocks, up to the size of one I/O, in the queue
+ * starting with the first-th entry.
+ */
+static int
+read_stream_run_length(ReadStream *stream, int first)
+{
+	int			index = (stream->head + first) % stream->max_distance;
+	BlockNumber blocknum = stream->blocknums[index];
+	int			n = 1;
+
+	while (first + n < stream->nqueued && n < PGAIO_MAX_BLOCKS)
+	{
+		index = (index + 1) % stream->max_distance;
+		if (stream->blocknums[index] != blocknum + n)
+			break;
+		n++;
+	}
+
+	return n;
+}
+
+/*
+ * Start reading the first nblocks entries not yet started, which hold
+ * consecutive blocks, and adjust the look-ahead distance.
+ */
+static void
+read_stream_start_run(ReadStream *stream, int nblocks)
+{
+	int			index = (stream->head + stream->nstarted) % stream->max_distance;
+	Buffer		buffers[PGAIO_MAX_BLOCKS];
+	int			nmisses;
+	int			i;
+
+	Assert(nblocks > 0 && nblocks <= PGAIO_MAX_BLOCKS);
+	Assert(stream->nstarted + nblocks <= stream->nqueued);
+
+	nmisses = StartReadBuffers(stream->rel, stream->forknum,
+							   stream->blocknums[index], nblocks,
+							   stream->strategy, buffers);
+	for (i = 0; i < nblocks; i++)
+		stream->buffers[(index + i) % stream->max_distance] = buffers[i];
+	stream->nstarted += nblocks;
+
+	if (nmisses > 0)
+		stream->distance = Min(stream->distance * 2, stream->max_distance);
+	else if (stream->distance > 1)
+		stream->distance--;
+}
+
+/*
+ * Fill the queue up to the look-ahead distance, and start the reads that
+ * can't be combined with anything more.
+ */
+static void
+read_stream_look_ahead(ReadStream *stream)
+{
+	while (!stream->finished && stream->nqueued < stream->distance)
+	{
+		int			index = (stream->head + stream->nqueued) % stream->max_distance;
+		BlockNumber blocknum;
+
+		blocknum = stream->callback(stream, stream->callback_private_data,
+									read_stream_entry_data(stream, index));
+		if (blocknum == InvalidBlockNumber)
+		{
+			stream->finished = true;
+			break;
+		}
+
+		stream->blocknums[index] = blocknum;
+		stream->buffers[index] = InvalidBuffer;
+		stream->nqueued++;
+
+		/* Sequential reads are left to the kernel's own read-ahead */
+		if (stream->advice && blocknum != stream->last_blocknum + 1)
+			PrefetchBuffer(stream->rel, stream->forknum, blocknum);
+		stream->last_blocknum = blocknum;
+	}
+
+	if (!stream->async)
+		return;
+
+	/*
+	 * Start each complete run.  The last one might still grow, so leave it
+	 * for later unless it's as large as it can be, or no more blocks are
+	 * coming.  read_stream_next_buffer starts it if it's needed before then.
+	 */
+	while (stream->nstarted < stream->nqueued)
+	{
+		int			n = read_stream_run_length(stream, stream->nstarted);
+
+		if (stream->nstarted + n == stream->nqueued &&
+			n < PGAIO_MAX_BLOCKS && !stream->finished)
+			break;
+		read_stream_start_run(stream, n);
+	}
+}
+
+/*
+ * read_stream_next_buffer -- return the next block's buffer
+ *
+ * The buffer is pinned, and its page is valid; the caller must release it.
+ * Returns InvalidBuffer at the end of the stream.  If per_buffer_data isn't
+ * NULL, *per_buffer_data is set to the block's per-buffer data, which stays
+ * valid until the next call.
+ */
+Buffer
+read_stream_next_buffer(ReadStream *stream, void **per_buffer_data)
+{
+	Buffer		buffer;
+
+	read_stream_look_ahead(stream);
+
+	if (stream->nqueued == 0)
+	{
+		Assert(stream->finished);
+		return InvalidBuffer;
+	}
+
+	/* Start the read now, if that hasn't been done yet */
+	if (stream->nstarted == 0)
+		read_stream_start_run(stream, read_stream_run_length(stream, 0));
+
+	buffer = stream->buffers[stream->head];
+	WaitReadBuffers(&buffer, 1);
+
+	if (per_buffer_data != NULL)
+		*per_buffer_data = read_stream_entry_data(stream, stream->head);
+
+	stream->head = (stream->head + 1) % stream->max_distance;
+	stream->nqueued--;
+	stream->nstarted--;
+
+	return buffer;
+}
+
+/*
+ * read_stream_reset -- release the buffers read ahead and start over
+ *
+ * The callback will be called again for the next block, as though the
+ * stream had just been created.
+ */
+void
+read_stream_reset(ReadStream *stream)
+{
+	while (stream->nstarted > 0)
+	{
+		DiscardReadBuffers(&stream->buffers[stream->head], 1);
+		stream->head = (stream->head + 1) % stream->max_distance;
+		stream->nqueued--;
+		stream->nstarted--;
+	}
+
+	stream->head = 0;
+	stream->nqueued = 0;
+	stream->finished = false;
+	stream->distance = 1;
+	stream->last_blocknum = InvalidBlockNumber;
+}
+
+/*
+ * read_stream_end -- release the stream's buffers, and free it
+ */
+void
+read_stream_end(ReadStream *stream)
+{
+	read_stream_reset(stream);
+
+	if (stream->per_buffer_data != NULL)
+		pfree(stream->per_buffer_data);
+	pfree(stream->blocknums);
+	pfree(stream->buffers);
+	pfree(stream);
+}
@@ -89,6 +89,7 @@
 #include "storage/fd.h"
 #include "storage/ipc.h"
 #include "utils/guc.h"
+#include "utils/memutils.h"
 #include "utils/resowner_private.h"
 
 
@@ -138,6 +139,25 @@
  */
 int			max_files_per_process = 1000;
 
+/*
+ * Which kinds of files to open with O_DIRECT, bypassing the kernel's page
+ * cache; set from the io_direct GUC.  md.c and xlog.c act on it.
+ */
+int			io_direct_flags = 0;
+
+/*
+ * Transfers to and from files opened with O_DIRECT must use suitably aligned
+ * memory.  Shared buffers and the like are aligned, but for callers with
+ * private buffers that aren't, we copy through this bounce buffer.
+ */
+#define DIRECT_IO_BOUNCE_SIZE	(PG_IOV_MAX * BLCKSZ)
+
+static char *DirectIOBounceBuffer = NULL;
+
+#define IsDirectIOUnaligned(vfdP, ptr) \
+	(((vfdP)->fileFlags & PG_O_DIRECT) != 0 && \
+	 (uintptr_t) (ptr) % PG_IO_ALIGN_SIZE != 0)
+
 /*
  * Maximum number of file descriptors to open for either VFD entries or
  * AllocateFile/AllocateDir/OpenTransientFile operations.  This is initialized
@@ -327,6 +347,12 @@ static void RemovePgTempRelationFiles(const char *tsdirname);
 static void RemovePgTempRelationFilesInDbspace(const char *dbspacedirname);
 static bool looks_like_temp_rel_name(const char *name);
 
+static char *GetDirectIOBounceBuffer(void);
+static int	FileTransferV(File file, const struct iovec *iov, int iovcnt,
+			  off_t offset, bool is_write, uint32 wait_event_info);
+static int	FileTransferVBounce(File file, const struct iovec *iov, int iovcnt,
+					off_t offset, bool is_write, uint32 wait_event_info);
+
 static void walkdir(const char *path,
 		void (*action) (const char *fname, bool isdir, int elevel),
 		bool process_symlinks,
@@ -1890,6 +1916,20 @@ FileWriteback(File file, off_t offset, off_t nbytes, uint32 wait_event_info)
 	pgstat_report_wait_end();
 }
 
+/*
+ * Get the bounce buffer for direct I/O with unaligned memory, allocating it
+ * on first use.
+ */
+static char *
+GetDirectIOBounceBuffer(void)
+{
+	if (DirectIOBounceBuffer == NULL)
+		DirectIOBounceBuffer = (char *)
+			IOALIGN(MemoryContextAlloc(TopMemoryContext,
+									   DIRECT_IO_BOUNCE_SIZE + PG_IO_ALIGN_SIZE));
+	return DirectIOBounceBuffer;
+}
+
 int
 FileRead(File file, char *buffer, int amount, uint32 wait_event_info)
 {
@@ -1898,6 +1938,17 @@ FileRead(File file, char *buffer, int amount, uint32 wait_event_info)
 
 	Assert(FileIsValid(file));
 
+	if (IsDirectIOUnaligned(&VfdCache[file], buffer))
+	{
+		char	   *bounce = GetDirectIOBounceBuffer();
+
+		Assert(amount <= DIRECT_IO_BOUNCE_SIZE);
+		returnCode = FileRead(file, bounce, amount, wait_event_info);
+		if (returnCode > 0)
+			memcpy(buffer, bounce, returnCode);
+		return returnCode;
+	}
+
 	DO_DB(elog(LOG, "FileRead: %d (%s) " INT64_FORMAT " %d %p",
 			   file, VfdCache[file].fileName,
 			   (int64) VfdCache[file].seekPos,
@@ -1962,6 +2013,15 @@ FileWrite(File file, char *buffer, int amount, uint32 wait_event_info)
 
 	Assert(FileIsValid(file));
 
+	if (IsDirectIOUnaligned(&VfdCache[file], buffer))
+	{
+		char	   *bounce = GetDirectIOBounceBuffer();
+
+		Assert(amount <= DIRECT_IO_BOUNCE_SIZE);
+		memcpy(bounce, buffer, amount);
+		return FileWrite(file, bounce, amount, wait_event_info);
+	}
+
 	DO_DB(elog(LOG, "FileWrite: %d (%s) " INT64_FORMAT " %d %p",
 			   file, VfdCache[file].fileName,
 			   (int64) VfdCache[file].seekPos,
@@ -2075,6 +2135,209 @@ retry:
 	return returnCode;
 }
 
+/*
+ * Read or write the iovecs at offset, like preadv() and pwritev(); where
+ * those are missing, we seek and transfer one iovec at a time.
+ */
+static int
+pg_preadv(int fd, const struct iovec *iov, int iovcnt, off_t offset)
+{
+#ifdef HAVE_PREADV
+	return preadv(fd, iov, iovcnt, offset);
+#else
+	int			sum = 0;
+	int			i;
+
+	if (lseek(fd, offset, SEEK_SET) < 0)
+		return -1;
+	for (i = 0; i < iovcnt; i++)
+	{
+		int			part = read(fd, iov[i].iov_base, iov[i].iov_len);
+
+		if (part < 0)
+			return i == 0 ? -1 : sum;
+		sum += part;
+		if (part < iov[i].iov_len)
+			break;
+	}
+	return sum;
+#endif
+}
+
+static int
+pg_pwritev(int fd, const struct iovec *iov, int iovcnt, off_t offset)
+{
+#ifdef HAVE_PWRITEV
+	return pwritev(fd, iov, iovcnt, offset);
+#else
+	int			sum = 0;
+	int			i;
+
+	if (lseek(fd, offset, SEEK_SET) < 0)
+		return -1;
+	for (i = 0; i < iovcnt; i++)
+	{
+		int			part = write(fd, iov[i].iov_base, iov[i].iov_len);
+
+		if (part < 0)
+			return i == 0 ? -1 : sum;
+		sum += part;
+		if (part < iov[i].iov_len)
+			break;
+	}
+	return sum;
+#endif
+}
+
+/*
+ * FileReadV / FileWriteV -- vectored read or write at a given offset
+ *
+ * Unlike FileRead and FileWrite, these don't use or move the file's seek
+ * position.  Partial transfers are continued until everything has been
+ * transferred, or the read hits end of file; so a result less than the total
+ * length of the iovecs means EOF for a read, and an error for a write.  These
+ * are meant for relation data files, and can't be used on files subject to
+ * temp_file_limit.  With O_DIRECT, if any of the iovecs isn't aligned, the
+ * data is copied through the bounce buffer.
+ */
+static int
+FileTransferV(File file, const struct iovec *iov, int iovcnt, off_t offset,
+			  bool is_write, uint32 wait_event_info)
+{
+	struct iovec iov_copy[PG_IOV_MAX];
+	struct iovec *cur = iov_copy;
+	int			returnCode;
+	int			total = 0;
+	Vfd		   *vfdP;
+	int			i;
+
+	Assert(FileIsValid(file));
+	Assert(iovcnt > 0 && iovcnt <= PG_IOV_MAX);
+
+	for (i = 0; i < iovcnt; i++)
+	{
+		if (IsDirectIOUnaligned(&VfdCache[file], iov[i].iov_base))
+			return FileTransferVBounce(file, iov, iovcnt, offset, is_write,
+									   wait_event_info);
+	}
+
+	DO_DB(elog(LOG, "FileTransferV: %d (%s) " INT64_FORMAT " %d %s",
+			   file, VfdCache[file].fileName, (int64) offset, iovcnt,
+			   is_write ? "write" : "read"));
+
+	returnCode = FileAccess(file);
+	if (returnCode < 0)
+		return returnCode;
+
+	vfdP = &VfdCache[file];
+	Assert(!(vfdP->fdstate & FD_TEMP_FILE_LIMIT));
+
+	memcpy(iov_copy, iov, sizeof(struct iovec) * iovcnt);
+
+	while (iovcnt > 0)
+	{
+		errno = 0;
+		pgstat_report_wait_start(wait_event_info);
+		if (is_write)
+			returnCode = pg_pwritev(vfdP->fd, cur, iovcnt, offset + total);
+		else
+			returnCode = pg_preadv(vfdP->fd, cur, iovcnt, offset + total);
+		pgstat_report_wait_end();
+
+		if (returnCode < 0)
+		{
+			/* OK to retry if interrupted, see FileRead() */
+			if (errno == EINTR)
+				continue;
+			total = -1;
+			break;
+		}
+		if (returnCode == 0)
+		{
+			/* if write didn't set errno, assume problem is no disk space */
+			if (is_write && errno == 0)
+				errno = ENOSPC;
+			break;
+		}
+
+		/* Skip over what's been transferred, and go again for the rest */
+		total += returnCode;
+		while (iovcnt > 0 && returnCode >= cur->iov_len)
+		{
+			returnCode -= cur->iov_len;
+			cur++;
+			iovcnt--;
+		}
+		if (iovcnt > 0)
+		{
+			cur->iov_base = (char *) cur->iov_base + returnCode;
+			cur->iov_len -= returnCode;
+		}
+	}
+
+#if !defined(HAVE_PREADV) || !defined(HAVE_PWRITEV)
+	/* The fallback implementations have moved the kernel's file position */
+	vfdP->seekPos = FileUnknownPos;
+#endif
+
+	return total;
+}
+
+/*
+ * FileTransferV for direct I/O with unaligned iovecs: transfer the data as a
+ * whole, to or from the bounce buffer.
+ */
+static int
+FileTransferVBounce(File file, const struct iovec *iov, int iovcnt,
+					off_t offset, bool is_write, uint32 wait_event_info)
+{
+	struct iovec bounce_iov;
+	char	   *bounce = GetDirectIOBounceBuffer();
+	size_t		len = 0;
+	int			returnCode;
+	int			i;
+
+	for (i = 0; i < iovcnt; i++)
+	{
+		if (is_write)
+			memcpy(bounce + len, iov[i].iov_base, iov[i].iov_len);
+		len += iov[i].iov_len;
+	}
+	Assert(len <= DIRECT_IO_BOUNCE_SIZE);
+
+	bounce_iov.iov_base = bounce;
+	bounce_iov.iov_len = len;
+	returnCode = FileTransferV(file, &bounce_iov, 1, offset, is_write,
+							   wait_event_info);
+
+	if (!is_write && returnCode > 0)
+	{
+		len = 0;
+		for (i = 0; i < iovcnt && len < returnCode; i++)
+		{
+			memcpy(iov[i].iov_base, bounce + len,
+				   Min(iov[i].iov_len, returnCode - len));
+			len += iov[i].iov_len;
+		}
+	}
+
+	return returnCode;
+}
+
+int
+FileReadV(File file, const struct iovec *iov, int iovcnt, off_t offset,
+		  uint32 wait_event_info)
+{
+	return FileTransferV(file, iov, iovcnt, offset, false, wait_event_info);
+}
+
+int
+FileWriteV(File file, const struct iovec *iov, int iovcnt, off_t offset,
+		   uint32 wait_event_info)
+{
+	return FileTransferV(file, iov, iovcnt, offset, true, wait_event_info);
+}
+
 int
 FileSync(File file, uint32 wait_event_info)
 {
@@ -2213,6 +2476,52 @@ FileTruncate(File file, off_t offset, uint32 wait_event_info)
 	return returnCode;
 }
 
+/*
+ * FileFallocate -- allocate disk space for a range of a file
+ *
+ * The range reads as zeros afterwards, and the file is extended if the range
+ * goes beyond its end.  Returns 0 on success.  On failure, returns -1 with
+ * errno set; errno is EOPNOTSUPP if the platform or the file system can't
+ * allocate space this way, in which case the caller should write zeros
+ * instead.
+ */
+int
+FileFallocate(File file, off_t offset, off_t amount, uint32 wait_event_info)
+{
+#ifdef HAVE_POSIX_FALLOCATE
+	int			returnCode;
+
+	Assert(FileIsValid(file));
+
+	DO_DB(elog(LOG, "FileFallocate %d (%s) " INT64_FORMAT " " INT64_FORMAT,
+			   file, VfdCache[file].fileName,
+			   (int64) offset, (int64) amount));
+
+	returnCode = FileAccess(file);
+	if (returnCode < 0)
+		return returnCode;
+
+	pgstat_report_wait_start(wait_event_info);
+	do
+	{
+		returnCode = posix_fallocate(VfdCache[file].fd, offset, amount);
+	} while (returnCode == EINTR);
+	pgstat_report_wait_end();
+
+	if (returnCode == 0)
+		return 0;
+
+	/* posix_fallocate() returns the error number rather than setting errno */
+	if (returnCode == EINVAL)
+		returnCode = EOPNOTSUPP;
+	errno = returnCode;
+	return -1;
+#else
+	errno = EOPNOTSUPP;
+	return -1;
+#endif
+}
+
 /*
  * Return the pathname associated with an open file.
  *
@@ -2242,6 +2551,31 @@ FileGetRawDesc(File file)
 	return VfdCache[file].fd;
 }
 
+/*
+ * FileGetRawDescForIO - like FileGetRawDesc, but reopens the file if needed
+ *
+ * This is for callers that perform I/O on the kernel file descriptor
+ * themselves, bypassing FileRead and FileWrite.  Returns -1, with errno set,
+ * if the file could not be reopened.  The caveats of FileGetRawDesc about
+ * the lifetime of the returned descriptor apply here as well.
+ */
+int
+FileGetRawDescForIO(File file)
+{
+	int			returnCode;
+
+	Assert(FileIsValid(file));
+
+	DO_DB(elog(LOG, "FileGetRawDescForIO: %d (%s)",
+			   file, VfdCache[file].fileName));
+
+	returnCode = FileAccess(file);
+	if (returnCode < 0)
+		return returnCode;
+
+	return VfdCache[file].fd;
+}
+
 /*
  * FileGetRawFlags - returns the file flags on open(2)
  */
@@ -190,6 +190,54 @@ RecordPageWithFreeSpace(Relation rel, BlockNumber heapBlk, Size spaceAvail)
 	fsm_set_and_search(rel, addr, slot, new_cat, 0);
 }
 
+/*
+ * RecordPagesWithFreeSpace - update info about a range of pages, which all
+ *		have the same amount of free space.
+ *
+ * This is meant for recording the pages of a bulk relation extension.  Each
+ * FSM page is locked once for all of its slots in the range, rather than
+ * once per heap page, and the upper levels are updated too, so that the new
+ * pages can be found by searchers at once.
+ */
+void
+RecordPagesWithFreeSpace(Relation rel, BlockNumber firstBlk,
+						 BlockNumber nblocks, Size spaceAvail)
+{
+	int			new_cat = fsm_space_avail_to_cat(spaceAvail);
+	BlockNumber blockNum = firstBlk;
+	BlockNumber endBlk = firstBlk + nblocks;
+
+	if (nblocks == 0)
+		return;
+
+	while (blockNum < endBlk)
+	{
+		FSMAddress	addr;
+		uint16		slot;
+		Buffer		buf;
+		Page		page;
+		bool		changed = false;
+
+		addr = fsm_get_location(blockNum, &slot);
+
+		buf = fsm_readbuf(rel, addr, true);
+		LockBuffer(buf, BUFFER_LOCK_EXCLUSIVE);
+		page = BufferGetPage(buf);
+
+		for (; slot < SlotsPerFSMPage && blockNum < endBlk; slot++, blockNum++)
+		{
+			if (fsm_set_avail(page, slot, new_cat))
+				changed = true;
+		}
+
+		if (changed)
+			MarkBufferDirtyHint(buf, false);
+		UnlockReleaseBuffer(buf);
+	}
+
+	UpdateFreeSpaceMap(rel, firstBlk, endBlk - 1, spaceAvail);
+}
+
 /*
  * Update the upper levels of the free space map all the way up to the root
  * to make sure we don't lose track of new blocks we just inserted.  This is
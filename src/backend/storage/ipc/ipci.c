@@ -21,6 +21,8 @@
 #include "access/nbtree.h"
 #include "access/subtrans.h"
 #include "access/twophase.h"
+#include "access/xlogprefetch.h"
+#include "access/xlogredo.h"
 #include "commands/async.h"
 #include "miscadmin.h"
 #include "pgstat.h"
@@ -33,9 +35,11 @@
 #include "replication/walreceiver.h"
 #include "replication/walsender.h"
 #include "replication/origin.h"
+#include "storage/aio.h"
 #include "storage/bufmgr.h"
 #include "storage/dsm.h"
 #include "storage/ipc.h"
+#include "storage/lmgr.h"
 #include "storage/pg_shmem.h"
 #include "storage/pmsignal.h"
 #include "storage/predicate.h"
@@ -45,6 +49,7 @@
 #include "storage/sinvaladt.h"
 #include "storage/spin.h"
 #include "utils/backend_random.h"
+#include "utils/sharedplancache.h"
 #include "utils/snapmgr.h"
 
 
@@ -122,7 +127,11 @@ CreateSharedMemoryAndSemaphores(bool makePrivate, int port)
 		size = add_size(size, hash_estimate_size(SHMEM_INDEX_SIZE,
 												 sizeof(ShmemIndexEnt)));
 		size = add_size(size, BufferShmemSize());
+		size = add_size(size, AioShmemSize());
+		size = add_size(size, ParallelRedoShmemSize());
+		size = add_size(size, XLogPrefetchShmemSize());
 		size = add_size(size, LockShmemSize());
+		size = add_size(size, RelExtLockShmemSize());
 		size = add_size(size, PredicateLockShmemSize());
 		size = add_size(size, ProcGlobalShmemSize());
 		size = add_size(size, XLOGShmemSize());
@@ -150,6 +159,7 @@ CreateSharedMemoryAndSemaphores(bool makePrivate, int port)
 		size = add_size(size, SyncScanShmemSize());
 		size = add_size(size, AsyncShmemSize());
 		size = add_size(size, BackendRandomShmemSize());
+		size = add_size(size, SharedPlanCacheShmemSize());
 #ifdef EXEC_BACKEND
 		size = add_size(size, ShmemBackendArraySize());
 #endif
@@ -223,11 +233,15 @@ CreateSharedMemoryAndSemaphores(bool makePrivate, int port)
 	SUBTRANSShmemInit();
 	MultiXactShmemInit();
 	InitBufferPool();
+	AioShmemInit();
+	ParallelRedoShmemInit();
+	XLogPrefetchShmemInit();
 
 	/*
 	 * Set up lock manager
 	 */
 	InitLocks();
+	InitRelExtLocks();
 
 	/*
 	 * Set up predicate lock manager
@@ -270,6 +284,7 @@ CreateSharedMemoryAndSemaphores(bool makePrivate, int port)
 	SyncScanShmemInit();
 	AsyncShmemInit();
 	BackendRandomShmemInit();
+	SharedPlanCacheShmemInit();
 
 #ifdef EXEC_BACKEND
 
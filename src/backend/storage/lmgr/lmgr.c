@@ -22,6 +22,8 @@
 #include "miscadmin.h"
 #include "storage/lmgr.h"
 #include "storage/procarray.h"
+#include "storage/shmem.h"
+#include "utils/hashutils.h"
 #include "utils/inval.h"
 
 
@@ -58,6 +60,47 @@ typedef struct XactLockTableWaitInfo
 
 static void XactLockTableWaitErrorCb(void *arg);
 
+/*
+ * Relation extension locks don't go through the lock manager.  Extending a
+ * relation is frequent, the lock is held only briefly, and it can't take
+ * part in a deadlock, as no process waits for anything else that could be
+ * held by another process while holding one; so the heavyweight lock
+ * machinery is pure overhead, and under concurrent bulk loading the lock
+ * manager's partition lock becomes a bottleneck.  Instead, each relation is
+ * mapped by hashing to one of a fixed number of LWLocks in shared memory.
+ * Two relations may share a slot, in which case extending one blocks
+ * extending the other, but that's rare and harmless.
+ *
+ * A process can lock the same relation's extension lock again while holding
+ * it, such as when extending the free space map while adding pages to the
+ * heap; we just count that.  It must not lock another relation's extension
+ * lock meanwhile, as that could deadlock undetected.
+ */
+#define NUM_RELEXTLOCK_SLOTS	1024
+
+typedef struct RelExtLockSlot
+{
+	LWLock		lock;
+	pg_atomic_uint32 nwaiters;	/* processes waiting to acquire the lock */
+} RelExtLockSlot;
+
+/* pad each slot to a cache line, to avoid false sharing */
+typedef union RelExtLockSlotPadded
+{
+	RelExtLockSlot slot;
+	char		pad[PG_CACHE_LINE_SIZE];
+} RelExtLockSlotPadded;
+
+static RelExtLockSlotPadded *RelExtLockSlots = NULL;
+
+/* the slot we hold, if any, and how many times we've acquired it */
+static RelExtLockSlot *heldRelExtLock = NULL;
+static int	heldRelExtLockCount = 0;
+
+static RelExtLockSlot *RelExtLockSlotFor(Relation relation);
+static bool RelExtLockAcquire(Relation relation, LOCKMODE lockmode,
+				  bool dontWait);
+
 /*
  * RelationInitLockInfo
  *		Initializes the lock information in a relation descriptor.
@@ -318,12 +361,116 @@ UnlockRelationIdForSession(LockRelId *relid, LOCKMODE lockmode)
 	LockRelease(&tag, lockmode, true);
 }
 
+/*
+ * RelExtLockShmemSize
+ *		Estimate space needed for the relation extension locks
+ */
+Size
+RelExtLockShmemSize(void)
+{
+	return mul_size(NUM_RELEXTLOCK_SLOTS, sizeof(RelExtLockSlotPadded));
+}
+
+/*
+ * InitRelExtLocks
+ *		Allocate and initialize the relation extension locks
+ */
+void
+InitRelExtLocks(void)
+{
+	bool		found;
+	int			i;
+
+	StaticAssertStmt(sizeof(RelExtLockSlot) <= PG_CACHE_LINE_SIZE,
+					 "RelExtLockSlot doesn't fit in a cache line");
+
+	RelExtLockSlots = (RelExtLockSlotPadded *)
+		ShmemInitStruct("Relation Extension Locks", RelExtLockShmemSize(),
+						&found);
+	if (found)
+		return;
+
+	for (i = 0; i < NUM_RELEXTLOCK_SLOTS; i++)
+	{
+		LWLockInitialize(&RelExtLockSlots[i].slot.lock,
+						 LWTRANCHE_RELATION_EXTENSION);
+		pg_atomic_init_u32(&RelExtLockSlots[i].slot.nwaiters, 0);
+	}
+}
+
+/*
+ * Find the extension lock slot of a relation.
+ */
+static RelExtLockSlot *
+RelExtLockSlotFor(Relation relation)
+{
+	LockRelId  *relid = &relation->rd_lockInfo.lockRelId;
+	uint32		hash;
+
+	hash = hash_combine(murmurhash32(relid->dbId),
+						murmurhash32(relid->relId));
+
+	return &RelExtLockSlots[hash % NUM_RELEXTLOCK_SLOTS].slot;
+}
+
+/*
+ * Acquire a relation extension lock, or return false if dontWait and it
+ * can't be acquired at once.
+ */
+static bool
+RelExtLockAcquire(Relation relation, LOCKMODE lockmode, bool dontWait)
+{
+	RelExtLockSlot *slot = RelExtLockSlotFor(relation);
+	LWLockMode	mode;
+
+	Assert(lockmode == ExclusiveLock || lockmode == ShareLock);
+	mode = (lockmode == ExclusiveLock) ? LW_EXCLUSIVE : LW_SHARED;
+
+	/* After an error, LWLockReleaseAll() has released the lock behind us */
+	if (heldRelExtLock != NULL && !LWLockHeldByMe(&heldRelExtLock->lock))
+	{
+		heldRelExtLock = NULL;
+		heldRelExtLockCount = 0;
+	}
+
+	/*
+	 * A backend holds at most one relation's extension lock at a time; no
+	 * core code locks another relation while it is extending one.  Locking
+	 * the same relation again, e.g. to extend its FSM, is counted.
+	 */
+	if (heldRelExtLock != NULL)
+	{
+		Assert(heldRelExtLock == slot);
+		if (mode == LW_EXCLUSIVE &&
+			!LWLockHeldByMeInMode(&slot->lock, LW_EXCLUSIVE))
+			elog(ERROR, "cannot upgrade relation extension lock");
+		heldRelExtLockCount++;
+		return true;
+	}
+
+	if (!LWLockConditionalAcquire(&slot->lock, mode))
+	{
+		if (dontWait)
+			return false;
+
+		pg_atomic_fetch_add_u32(&slot->nwaiters, 1);
+		LWLockAcquire(&slot->lock, mode);
+		pg_atomic_fetch_sub_u32(&slot->nwaiters, 1);
+	}
+
+	heldRelExtLock = slot;
+	heldRelExtLockCount = 1;
+
+	return true;
+}
+
 /*
  *		LockRelationForExtension
  *
- * This lock tag is used to interlock addition of pages to relations.
+ * This lock is used to interlock addition of pages to relations.
  * We need such locking because bufmgr/smgr definition of P_NEW is not
- * race-condition-proof.
+ * race-condition-proof.  ExclusiveLock is taken to extend the relation, and
+ * ShareLock to wait for an extension in progress to finish.
  *
  * We assume the caller is already holding some type of regular lock on
  * the relation, so no AcceptInvalidationMessages call is needed here.
@@ -331,13 +478,7 @@ UnlockRelationIdForSession(LockRelId *relid, LOCKMODE lockmode)
 void
 LockRelationForExtension(Relation relation, LOCKMODE lockmode)
 {
-	LOCKTAG		tag;
-
-	SET_LOCKTAG_RELATION_EXTEND(tag,
-								relation->rd_lockInfo.lockRelId.dbId,
-								relation->rd_lockInfo.lockRelId.relId);
-
-	(void) LockAcquire(&tag, lockmode, false, false);
+	(void) RelExtLockAcquire(relation, lockmode, false);
 }
 
 /*
@@ -349,30 +490,21 @@ LockRelationForExtension(Relation relation, LOCKMODE lockmode)
 bool
 ConditionalLockRelationForExtension(Relation relation, LOCKMODE lockmode)
 {
-	LOCKTAG		tag;
-
-	SET_LOCKTAG_RELATION_EXTEND(tag,
-								relation->rd_lockInfo.lockRelId.dbId,
-								relation->rd_lockInfo.lockRelId.relId);
-
-	return (LockAcquire(&tag, lockmode, false, true) != LOCKACQUIRE_NOT_AVAIL);
+	return RelExtLockAcquire(relation, lockmode, true);
 }
 
 /*
  *		RelationExtensionLockWaiterCount
  *
  * Count the number of processes waiting for the given relation extension lock.
+ * Waiters for another relation that shares the lock are counted too.
  */
 int
 RelationExtensionLockWaiterCount(Relation relation)
 {
-	LOCKTAG		tag;
-
-	SET_LOCKTAG_RELATION_EXTEND(tag,
-								relation->rd_lockInfo.lockRelId.dbId,
-								relation->rd_lockInfo.lockRelId.relId);
+	RelExtLockSlot *slot = RelExtLockSlotFor(relation);
 
-	return LockWaiterCount(&tag);
+	return (int) pg_atomic_read_u32(&slot->nwaiters);
 }
 
 /*
@@ -381,13 +513,16 @@ RelationExtensionLockWaiterCount(Relation relation)
 void
 UnlockRelationForExtension(Relation relation, LOCKMODE lockmode)
 {
-	LOCKTAG		tag;
+	RelExtLockSlot *slot = RelExtLockSlotFor(relation);
 
-	SET_LOCKTAG_RELATION_EXTEND(tag,
-								relation->rd_lockInfo.lockRelId.dbId,
-								relation->rd_lockInfo.lockRelId.relId);
+	if (heldRelExtLock != slot || heldRelExtLockCount <= 0)
+		elog(ERROR, "relation extension lock is not held");
 
-	LockRelease(&tag, lockmode, false);
+	if (--heldRelExtLockCount == 0)
+	{
+		heldRelExtLock = NULL;
+		LWLockRelease(&slot->lock);
+	}
 }
 
 /*
@@ -520,6 +520,12 @@ RegisterLWLockTranches(void)
 						  "shared_tuplestore");
 	LWLockRegisterTranche(LWTRANCHE_TBM, "tbm");
 	LWLockRegisterTranche(LWTRANCHE_PARALLEL_APPEND, "parallel_append");
+	LWLockRegisterTranche(LWTRANCHE_SHARED_PLAN_CACHE, "shared_plan_cache");
+	LWLockRegisterTranche(LWTRANCHE_AIO_URING_COMPLETION,
+						  "aio_uring_completion");
+	LWLockRegisterTranche(LWTRANCHE_RELATION_EXTENSION,
+						  "relation_extension");
+	LWLockRegisterTranche(LWTRANCHE_COMPRESSED_BUFFERS, "compressed_buffers");
 
 	/* Register named tranches. */
 	for (i = 0; i < NamedLWLockTrancheRequests; i++)
@@ -187,6 +187,7 @@ InitProcGlobal(void)
 	ProcGlobal->checkpointerLatch = NULL;
 	pg_atomic_init_u32(&ProcGlobal->procArrayGroupFirst, INVALID_PGPROCNO);
 	pg_atomic_init_u32(&ProcGlobal->clogGroupFirst, INVALID_PGPROCNO);
+	pg_atomic_init_u32(&ProcGlobal->walFlushGroupFirst, INVALID_PGPROCNO);
 
 	/*
 	 * Create and initialize all the PGPROC structures we'll need.  There are
@@ -417,6 +418,11 @@ InitProcess(void)
 	MyProc->clogGroupMemberLsn = InvalidXLogRecPtr;
 	pg_atomic_init_u32(&MyProc->clogGroupNext, INVALID_PGPROCNO);
 
+	/* Initialize fields for group WAL flush. */
+	MyProc->walFlushGroupMember = false;
+	MyProc->walFlushGroupMemberLsn = InvalidXLogRecPtr;
+	pg_atomic_init_u32(&MyProc->walFlushGroupNext, INVALID_PGPROCNO);
+
 	/*
 	 * Acquire ownership of the PGPROC's latch, so that we can use WaitLatch
 	 * on it.  That allows us to repoint the process latch, which so far
@@ -581,6 +587,11 @@ InitAuxiliaryProcess(void)
 	Assert(MyProc->lockGroupLeader == NULL);
 	Assert(dlist_is_empty(&MyProc->lockGroupMembers));
 
+	/* Auxiliary processes flush WAL too, so they can join a flush group. */
+	MyProc->walFlushGroupMember = false;
+	MyProc->walFlushGroupMemberLsn = InvalidXLogRecPtr;
+	pg_atomic_init_u32(&MyProc->walFlushGroupNext, INVALID_PGPROCNO);
+
 	/*
 	 * We might be reusing a semaphore that belonged to a failed process. So
 	 * be careful and reinitialize its value here.  (This is not strictly
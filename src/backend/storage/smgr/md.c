@@ -68,6 +68,14 @@
 #define FILE_POSSIBLY_DELETED(err)	((err) == ENOENT || (err) == EACCES)
 #endif
 
+/*
+ * Flags for opening relation segment files.  With io_direct = data, they
+ * bypass the kernel's page cache.
+ */
+#define MD_OPEN_FLAGS \
+	(O_RDWR | PG_BINARY | \
+	 ((io_direct_flags & IO_DIRECT_DATA) ? PG_O_DIRECT : 0))
+
 /*
  *	The magnetic disk storage manager keeps track of open file
  *	descriptors in its own descriptor pool.  This is done to make it
@@ -114,6 +122,12 @@ typedef struct _MdfdVec
 
 static MemoryContext MdCxt;		/* context for all MdfdVec objects */
 
+/*
+ * mdzeroextend() allocates runs of more than this many blocks with
+ * posix_fallocate(), and writes zeros for shorter ones.
+ */
+#define MD_FALLOCATE_MIN_BLOCKS		8
+
 
 /*
  * In some contexts (currently, standalone backends and the checkpointer)
@@ -195,6 +209,7 @@ static MdfdVec *_mdfd_openseg(SMgrRelation reln, ForkNumber forkno,
 			  BlockNumber segno, int oflags);
 static MdfdVec *_mdfd_getseg(SMgrRelation reln, ForkNumber forkno,
 			 BlockNumber blkno, bool skipFsync, int behavior);
+static BlockNumber md_run_length(BlockNumber blocknum, BlockNumber nblocks);
 static BlockNumber _mdnblocks(SMgrRelation reln, ForkNumber forknum,
 		   MdfdVec *seg);
 
@@ -304,7 +319,7 @@ mdcreate(SMgrRelation reln, ForkNumber forkNum, bool isRedo)
 
 	path = relpath(reln->smgr_rnode, forkNum);
 
-	fd = PathNameOpenFile(path, O_RDWR | O_CREAT | O_EXCL | PG_BINARY);
+	fd = PathNameOpenFile(path, MD_OPEN_FLAGS | O_CREAT | O_EXCL);
 
 	if (fd < 0)
 	{
@@ -317,7 +332,7 @@ mdcreate(SMgrRelation reln, ForkNumber forkNum, bool isRedo)
 		 * already, even if isRedo is not set.  (See also mdopen)
 		 */
 		if (isRedo || IsBootstrapProcessingMode())
-			fd = PathNameOpenFile(path, O_RDWR | PG_BINARY);
+			fd = PathNameOpenFile(path, MD_OPEN_FLAGS);
 		if (fd < 0)
 		{
 			/* be sure to report the error reported by create, not open */
@@ -560,6 +575,187 @@ mdextend(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 	Assert(_mdnblocks(reln, forknum, v) <= ((BlockNumber) RELSEG_SIZE));
 }
 
+/*
+ *	mdextendv() -- Add a run of blocks to the specified relation.
+ *
+ *		Like mdextend() for blocks blocknum .. blocknum + nblocks - 1, but
+ *		the blocks of each segment are written with a single system call.
+ */
+void
+mdextendv(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+		  char **buffers, BlockNumber nblocks, bool skipFsync)
+{
+	/* This assert is too expensive to have on normally ... */
+#ifdef CHECK_WRITE_VS_EXTEND
+	Assert(blocknum >= mdnblocks(reln, forknum));
+#endif
+
+	/* See mdextend */
+	if (nblocks > InvalidBlockNumber - blocknum)
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("cannot extend file \"%s\" beyond %u blocks",
+						relpath(reln->smgr_rnode, forknum),
+						InvalidBlockNumber)));
+
+	while (nblocks > 0)
+	{
+		struct iovec iov[PG_IOV_MAX];
+		BlockNumber nthis;
+		off_t		seekpos;
+		int			nbytes;
+		MdfdVec    *v;
+		int			i;
+
+		nthis = md_run_length(blocknum, nblocks);
+
+		v = _mdfd_getseg(reln, forknum, blocknum, skipFsync, EXTENSION_CREATE);
+
+		seekpos = (off_t) BLCKSZ * (blocknum % ((BlockNumber) RELSEG_SIZE));
+
+		for (i = 0; i < nthis; i++)
+		{
+			iov[i].iov_base = buffers[i];
+			iov[i].iov_len = BLCKSZ;
+		}
+
+		nbytes = FileWriteV(v->mdfd_vfd, iov, nthis, seekpos,
+							WAIT_EVENT_DATA_FILE_EXTEND);
+		if (nbytes != BLCKSZ * nthis)
+		{
+			if (nbytes < 0)
+				ereport(ERROR,
+						(errcode_for_file_access(),
+						 errmsg("could not extend file \"%s\": %m",
+								FilePathName(v->mdfd_vfd)),
+						 errhint("Check free disk space.")));
+			/* short write: complain appropriately */
+			ereport(ERROR,
+					(errcode(ERRCODE_DISK_FULL),
+					 errmsg("could not extend file \"%s\": wrote only %d of %d bytes at block %u",
+							FilePathName(v->mdfd_vfd),
+							nbytes, BLCKSZ * nthis, blocknum),
+					 errhint("Check free disk space.")));
+		}
+
+		if (!skipFsync && !SmgrIsTemp(reln))
+			register_dirty_segment(reln, forknum, v);
+
+		Assert(_mdnblocks(reln, forknum, v) <= ((BlockNumber) RELSEG_SIZE));
+
+		blocknum += nthis;
+		buffers += nthis;
+		nblocks -= nthis;
+	}
+}
+
+/*
+ *	mdzeroextend() -- Add a run of zero-filled blocks to the specified
+ *		relation.
+ *
+ *		Like mdextendv() with all-zero pages, but large runs are allocated
+ *		with posix_fallocate() rather than written, which is much cheaper
+ *		and lets the file system lay out the space contiguously.  Small runs
+ *		are written, as fallocate doesn't pay off for them and some file
+ *		systems handle a mix of the two poorly.
+ */
+void
+mdzeroextend(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+			 BlockNumber nblocks, bool skipFsync)
+{
+	static char *zerobuf = NULL;
+
+	/* This assert is too expensive to have on normally ... */
+#ifdef CHECK_WRITE_VS_EXTEND
+	Assert(blocknum >= mdnblocks(reln, forknum));
+#endif
+
+	/* See mdextend */
+	if (nblocks > InvalidBlockNumber - blocknum)
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("cannot extend file \"%s\" beyond %u blocks",
+						relpath(reln->smgr_rnode, forknum),
+						InvalidBlockNumber)));
+
+	while (nblocks > 0)
+	{
+		BlockNumber segleft;
+		BlockNumber nthis;
+		off_t		seekpos;
+		MdfdVec    *v;
+		bool		allocated = false;
+
+		segleft = RELSEG_SIZE - blocknum % ((BlockNumber) RELSEG_SIZE);
+		nthis = Min(nblocks, segleft);
+
+		v = _mdfd_getseg(reln, forknum, blocknum, skipFsync, EXTENSION_CREATE);
+
+		seekpos = (off_t) BLCKSZ * (blocknum % ((BlockNumber) RELSEG_SIZE));
+
+		if (nthis > MD_FALLOCATE_MIN_BLOCKS)
+		{
+			if (FileFallocate(v->mdfd_vfd, seekpos, (off_t) BLCKSZ * nthis,
+							  WAIT_EVENT_DATA_FILE_EXTEND) == 0)
+				allocated = true;
+			else if (errno != EOPNOTSUPP)
+				ereport(ERROR,
+						(errcode_for_file_access(),
+						 errmsg("could not extend file \"%s\" with posix_fallocate(): %m",
+								FilePathName(v->mdfd_vfd)),
+						 errhint("Check free disk space.")));
+		}
+
+		if (!allocated)
+		{
+			struct iovec iov[PG_IOV_MAX];
+			int			nbytes;
+			int			i;
+
+			nthis = Min(nthis, PG_IOV_MAX);
+
+			/* Aligned, so that it can be written directly under io_direct */
+			if (zerobuf == NULL)
+				zerobuf = (char *)
+					IOALIGN(MemoryContextAllocZero(MdCxt,
+												   BLCKSZ + PG_IO_ALIGN_SIZE));
+
+			for (i = 0; i < nthis; i++)
+			{
+				iov[i].iov_base = zerobuf;
+				iov[i].iov_len = BLCKSZ;
+			}
+
+			nbytes = FileWriteV(v->mdfd_vfd, iov, nthis, seekpos,
+								WAIT_EVENT_DATA_FILE_EXTEND);
+			if (nbytes != BLCKSZ * nthis)
+			{
+				if (nbytes < 0)
+					ereport(ERROR,
+							(errcode_for_file_access(),
+							 errmsg("could not extend file \"%s\": %m",
+									FilePathName(v->mdfd_vfd)),
+							 errhint("Check free disk space.")));
+				/* short write: complain appropriately */
+				ereport(ERROR,
+						(errcode(ERRCODE_DISK_FULL),
+						 errmsg("could not extend file \"%s\": wrote only %d of %d bytes at block %u",
+								FilePathName(v->mdfd_vfd),
+								nbytes, BLCKSZ * nthis, blocknum),
+						 errhint("Check free disk space.")));
+			}
+		}
+
+		if (!skipFsync && !SmgrIsTemp(reln))
+			register_dirty_segment(reln, forknum, v);
+
+		Assert(_mdnblocks(reln, forknum, v) <= ((BlockNumber) RELSEG_SIZE));
+
+		blocknum += nthis;
+		nblocks -= nthis;
+	}
+}
+
 /*
  *	mdopen() -- Open the specified relation.
  *
@@ -583,7 +779,7 @@ mdopen(SMgrRelation reln, ForkNumber forknum, int behavior)
 
 	path = relpath(reln->smgr_rnode, forknum);
 
-	fd = PathNameOpenFile(path, O_RDWR | PG_BINARY);
+	fd = PathNameOpenFile(path, MD_OPEN_FLAGS);
 
 	if (fd < 0)
 	{
@@ -594,7 +790,7 @@ mdopen(SMgrRelation reln, ForkNumber forknum, int behavior)
 		 * substitute for mdcreate() in bootstrap mode only. (See mdcreate)
 		 */
 		if (IsBootstrapProcessingMode())
-			fd = PathNameOpenFile(path, O_RDWR | O_CREAT | O_EXCL | PG_BINARY);
+			fd = PathNameOpenFile(path, MD_OPEN_FLAGS | O_CREAT | O_EXCL);
 		if (fd < 0)
 		{
 			if ((behavior & EXTENSION_RETURN_NULL) &&
@@ -654,15 +850,25 @@ mdclose(SMgrRelation reln, ForkNumber forknum)
 
 /*
  *	mdprefetch() -- Initiate asynchronous read of the specified block of a relation
+ *
+ * Returns false if the segment file containing the block doesn't exist,
+ * which can legitimately happen when prefetching ahead of WAL replay.
  */
-void
+bool
 mdprefetch(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum)
 {
 #ifdef USE_PREFETCH
 	off_t		seekpos;
 	MdfdVec    *v;
 
-	v = _mdfd_getseg(reln, forknum, blocknum, false, EXTENSION_FAIL);
+	/* Direct reads don't look in the kernel's cache, so don't fill it */
+	if (io_direct_flags & IO_DIRECT_DATA)
+		return true;
+
+	v = _mdfd_getseg(reln, forknum, blocknum, false,
+					 InRecovery ? EXTENSION_RETURN_NULL : EXTENSION_FAIL);
+	if (v == NULL)
+		return false;
 
 	seekpos = (off_t) BLCKSZ * (blocknum % ((BlockNumber) RELSEG_SIZE));
 
@@ -670,6 +876,8 @@ mdprefetch(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum)
 
 	(void) FilePrefetch(v->mdfd_vfd, seekpos, BLCKSZ, WAIT_EVENT_DATA_FILE_PREFETCH);
 #endif							/* USE_PREFETCH */
+
+	return true;
 }
 
 /*
@@ -682,6 +890,10 @@ void
 mdwriteback(SMgrRelation reln, ForkNumber forknum,
 			BlockNumber blocknum, BlockNumber nblocks)
 {
+	/* Direct writes have gone to the device already */
+	if (io_direct_flags & IO_DIRECT_DATA)
+		return;
+
 	/*
 	 * Issue flush requests in as few requests as possible; have to split at
 	 * segment boundaries though, since those are actually separate files.
@@ -791,6 +1003,75 @@ mdread(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 	}
 }
 
+/*
+ *	mdreadv() -- Read a run of blocks from a relation.
+ *
+ *		Like mdread() for blocks blocknum .. blocknum + nblocks - 1, into
+ *		buffers[0 .. nblocks - 1], but the blocks of each segment are read
+ *		with a single system call.
+ */
+void
+mdreadv(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+		char **buffers, BlockNumber nblocks)
+{
+	while (nblocks > 0)
+	{
+		struct iovec iov[PG_IOV_MAX];
+		BlockNumber nthis;
+		off_t		seekpos;
+		int			nbytes;
+		MdfdVec    *v;
+		int			i;
+
+		nthis = md_run_length(blocknum, nblocks);
+
+		v = _mdfd_getseg(reln, forknum, blocknum, false,
+						 EXTENSION_FAIL | EXTENSION_CREATE_RECOVERY);
+
+		seekpos = (off_t) BLCKSZ * (blocknum % ((BlockNumber) RELSEG_SIZE));
+
+		for (i = 0; i < nthis; i++)
+		{
+			iov[i].iov_base = buffers[i];
+			iov[i].iov_len = BLCKSZ;
+		}
+
+		nbytes = FileReadV(v->mdfd_vfd, iov, nthis, seekpos,
+						   WAIT_EVENT_DATA_FILE_READ);
+		if (nbytes != BLCKSZ * nthis)
+		{
+			if (nbytes < 0)
+				ereport(ERROR,
+						(errcode_for_file_access(),
+						 errmsg("could not read blocks %u..%u in file \"%s\": %m",
+								blocknum, blocknum + nthis - 1,
+								FilePathName(v->mdfd_vfd))));
+
+			/*
+			 * Short read: we are at or past EOF.  See mdread(); if it's
+			 * acceptable, the blocks that weren't read completely are
+			 * returned as zeroes.
+			 */
+			if (zero_damaged_pages || InRecovery)
+			{
+				for (i = nbytes / BLCKSZ; i < nthis; i++)
+					MemSet(buffers[i], 0, BLCKSZ);
+			}
+			else
+				ereport(ERROR,
+						(errcode(ERRCODE_DATA_CORRUPTED),
+						 errmsg("could not read blocks %u..%u in file \"%s\": read only %d of %d bytes",
+								blocknum, blocknum + nthis - 1,
+								FilePathName(v->mdfd_vfd),
+								nbytes, BLCKSZ * nthis)));
+		}
+
+		blocknum += nthis;
+		buffers += nthis;
+		nblocks -= nthis;
+	}
+}
+
 /*
  *	mdwrite() -- Write the supplied block at the appropriate location.
  *
@@ -861,6 +1142,120 @@ mdwrite(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 		register_dirty_segment(reln, forknum, v);
 }
 
+/*
+ *	mdwritev() -- Write a run of blocks at the appropriate location.
+ *
+ *		Like mdwrite() for blocks blocknum .. blocknum + nblocks - 1, from
+ *		buffers[0 .. nblocks - 1], but the blocks of each segment are written
+ *		with a single system call.
+ */
+void
+mdwritev(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+		 char **buffers, BlockNumber nblocks, bool skipFsync)
+{
+	/* This assert is too expensive to have on normally ... */
+#ifdef CHECK_WRITE_VS_EXTEND
+	Assert(blocknum + nblocks <= mdnblocks(reln, forknum));
+#endif
+
+	while (nblocks > 0)
+	{
+		struct iovec iov[PG_IOV_MAX];
+		BlockNumber nthis;
+		off_t		seekpos;
+		int			nbytes;
+		MdfdVec    *v;
+		int			i;
+
+		nthis = md_run_length(blocknum, nblocks);
+
+		v = _mdfd_getseg(reln, forknum, blocknum, skipFsync,
+						 EXTENSION_FAIL | EXTENSION_CREATE_RECOVERY);
+
+		seekpos = (off_t) BLCKSZ * (blocknum % ((BlockNumber) RELSEG_SIZE));
+
+		for (i = 0; i < nthis; i++)
+		{
+			iov[i].iov_base = buffers[i];
+			iov[i].iov_len = BLCKSZ;
+		}
+
+		nbytes = FileWriteV(v->mdfd_vfd, iov, nthis, seekpos,
+							WAIT_EVENT_DATA_FILE_WRITE);
+		if (nbytes != BLCKSZ * nthis)
+		{
+			if (nbytes < 0)
+				ereport(ERROR,
+						(errcode_for_file_access(),
+						 errmsg("could not write blocks %u..%u in file \"%s\": %m",
+								blocknum, blocknum + nthis - 1,
+								FilePathName(v->mdfd_vfd))));
+			/* short write: complain appropriately */
+			ereport(ERROR,
+					(errcode(ERRCODE_DISK_FULL),
+					 errmsg("could not write blocks %u..%u in file \"%s\": wrote only %d of %d bytes",
+							blocknum, blocknum + nthis - 1,
+							FilePathName(v->mdfd_vfd),
+							nbytes, BLCKSZ * nthis),
+					 errhint("Check free disk space.")));
+		}
+
+		if (!skipFsync && !SmgrIsTemp(reln))
+			register_dirty_segment(reln, forknum, v);
+
+		blocknum += nthis;
+		buffers += nthis;
+		nblocks -= nthis;
+	}
+}
+
+/*
+ *	mdfd() -- Get the kernel file descriptor and offset of a block.
+ *
+ *		The caller is going to read or write the block itself, and must do so
+ *		before opening any other file, since that could close the returned
+ *		descriptor.  If forwrite is true, the segment is registered for fsync
+ *		as in mdwrite().
+ */
+int
+mdfd(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+	 bool forwrite, off_t *off)
+{
+	MdfdVec    *v;
+	int			fd;
+
+	v = _mdfd_getseg(reln, forknum, blocknum, false,
+					 EXTENSION_FAIL | EXTENSION_CREATE_RECOVERY);
+
+	/* Do this first, it might need to open files when forwarding fails */
+	if (forwrite && !SmgrIsTemp(reln))
+		register_dirty_segment(reln, forknum, v);
+
+	fd = FileGetRawDescForIO(v->mdfd_vfd);
+	if (fd < 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not open file \"%s\": %m",
+						FilePathName(v->mdfd_vfd))));
+
+	*off = (off_t) BLCKSZ * (blocknum % ((BlockNumber) RELSEG_SIZE));
+
+	return fd;
+}
+
+/*
+ * md_run_length() -- How many of nblocks blocks starting at blocknum can be
+ * transferred with one FileReadV or FileWriteV: they must be in the same
+ * segment, and there can't be more than PG_IOV_MAX of them.
+ */
+static BlockNumber
+md_run_length(BlockNumber blocknum, BlockNumber nblocks)
+{
+	BlockNumber segleft = RELSEG_SIZE - blocknum % ((BlockNumber) RELSEG_SIZE);
+
+	return Min(Min(nblocks, segleft), PG_IOV_MAX);
+}
+
 /*
  *	mdnblocks() -- Get the number of blocks stored in a relation.
  *
@@ -1780,7 +2175,7 @@ _mdfd_openseg(SMgrRelation reln, ForkNumber forknum, BlockNumber segno,
 	fullpath = _mdfd_segpath(reln, forknum, segno);
 
 	/* open the file */
-	fd = PathNameOpenFile(fullpath, O_RDWR | PG_BINARY | oflags);
+	fd = PathNameOpenFile(fullpath, MD_OPEN_FLAGS | oflags);
 
 	pfree(fullpath);
 
@@ -47,14 +47,28 @@ typedef struct f_smgr
 								bool isRedo);
 	void		(*smgr_extend) (SMgrRelation reln, ForkNumber forknum,
 								BlockNumber blocknum, char *buffer, bool skipFsync);
-	void		(*smgr_prefetch) (SMgrRelation reln, ForkNumber forknum,
+	void		(*smgr_extendv) (SMgrRelation reln, ForkNumber forknum,
+								 BlockNumber blocknum, char **buffers,
+								 BlockNumber nblocks, bool skipFsync);
+	void		(*smgr_zeroextend) (SMgrRelation reln, ForkNumber forknum,
+									BlockNumber blocknum, BlockNumber nblocks,
+									bool skipFsync);
+	bool		(*smgr_prefetch) (SMgrRelation reln, ForkNumber forknum,
 								  BlockNumber blocknum);
 	void		(*smgr_read) (SMgrRelation reln, ForkNumber forknum,
 							  BlockNumber blocknum, char *buffer);
+	void		(*smgr_readv) (SMgrRelation reln, ForkNumber forknum,
+							   BlockNumber blocknum, char **buffers,
+							   BlockNumber nblocks);
 	void		(*smgr_write) (SMgrRelation reln, ForkNumber forknum,
 							   BlockNumber blocknum, char *buffer, bool skipFsync);
+	void		(*smgr_writev) (SMgrRelation reln, ForkNumber forknum,
+								BlockNumber blocknum, char **buffers,
+								BlockNumber nblocks, bool skipFsync);
 	void		(*smgr_writeback) (SMgrRelation reln, ForkNumber forknum,
 								   BlockNumber blocknum, BlockNumber nblocks);
+	int			(*smgr_fd) (SMgrRelation reln, ForkNumber forknum,
+							BlockNumber blocknum, bool forwrite, off_t *off);
 	BlockNumber (*smgr_nblocks) (SMgrRelation reln, ForkNumber forknum);
 	void		(*smgr_truncate) (SMgrRelation reln, ForkNumber forknum,
 								  BlockNumber nblocks);
@@ -68,8 +82,9 @@ typedef struct f_smgr
 static const f_smgr smgrsw[] = {
 	/* magnetic disk */
 	{mdinit, NULL, mdclose, mdcreate, mdexists, mdunlink, mdextend,
-		mdprefetch, mdread, mdwrite, mdwriteback, mdnblocks, mdtruncate,
-		mdimmedsync, mdpreckpt, mdsync, mdpostckpt
+		mdextendv, mdzeroextend, mdprefetch, mdread, mdreadv, mdwrite,
+		mdwritev, mdwriteback, mdfd, mdnblocks, mdtruncate, mdimmedsync,
+		mdpreckpt, mdsync, mdpostckpt
 	}
 };
 
@@ -605,12 +620,45 @@ smgrextend(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 }
 
 /*
- *	smgrprefetch() -- Initiate asynchronous read of the specified block of a relation.
+ *	smgrextendv() -- Add a run of new blocks to a file.
+ *
+ *		Equivalent to calling smgrextend() for blocks blocknum ..
+ *		blocknum + nblocks - 1, with the contents in buffers[], but the
+ *		storage manager may transfer them with fewer system calls.
+ */
+void
+smgrextendv(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+			char **buffers, BlockNumber nblocks, bool skipFsync)
+{
+	smgrsw[reln->smgr_which].smgr_extendv(reln, forknum, blocknum,
+										  buffers, nblocks, skipFsync);
+}
+
+/*
+ *	smgrzeroextend() -- Add a run of new, zero-filled blocks to a file.
+ *
+ *		Like smgrextendv() with all-zero contents, but the storage manager
+ *		may reserve the space without writing anything.  This is meant for
+ *		extending a relation ahead of need by many blocks at a time.
  */
 void
+smgrzeroextend(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+			   BlockNumber nblocks, bool skipFsync)
+{
+	smgrsw[reln->smgr_which].smgr_zeroextend(reln, forknum, blocknum,
+											 nblocks, skipFsync);
+}
+
+/*
+ *	smgrprefetch() -- Initiate asynchronous read of the specified block of a relation.
+ *
+ *		Returns false if the relation's file doesn't exist.  Outside recovery
+ *		that is reported as an error instead.
+ */
+bool
 smgrprefetch(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum)
 {
-	smgrsw[reln->smgr_which].smgr_prefetch(reln, forknum, blocknum);
+	return smgrsw[reln->smgr_which].smgr_prefetch(reln, forknum, blocknum);
 }
 
 /*
@@ -628,6 +676,21 @@ smgrread(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 	smgrsw[reln->smgr_which].smgr_read(reln, forknum, blocknum, buffer);
 }
 
+/*
+ *	smgrreadv() -- read a run of blocks from a relation.
+ *
+ *		Equivalent to calling smgrread() for blocks blocknum ..
+ *		blocknum + nblocks - 1, into buffers[], but the storage manager may
+ *		transfer them with fewer system calls.
+ */
+void
+smgrreadv(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+		  char **buffers, BlockNumber nblocks)
+{
+	smgrsw[reln->smgr_which].smgr_readv(reln, forknum, blocknum,
+										buffers, nblocks);
+}
+
 /*
  *	smgrwrite() -- Write the supplied buffer out.
  *
@@ -651,6 +714,21 @@ smgrwrite(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 										buffer, skipFsync);
 }
 
+/*
+ *	smgrwritev() -- Write out a run of buffers.
+ *
+ *		Equivalent to calling smgrwrite() for blocks blocknum ..
+ *		blocknum + nblocks - 1, with the contents in buffers[], but the
+ *		storage manager may transfer them with fewer system calls.
+ */
+void
+smgrwritev(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+		   char **buffers, BlockNumber nblocks, bool skipFsync)
+{
+	smgrsw[reln->smgr_which].smgr_writev(reln, forknum, blocknum,
+										 buffers, nblocks, skipFsync);
+}
+
 
 /*
  *	smgrwriteback() -- Trigger kernel writeback for the supplied range of
@@ -664,6 +742,22 @@ smgrwriteback(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 											nblocks);
 }
 
+/*
+ *	smgrfd() -- Get the kernel file descriptor and offset of a block.
+ *
+ *		This is for issuing asynchronous I/O on the block directly.  The
+ *		descriptor may get closed when other files are opened, so it must be
+ *		used right away.  If forwrite is true, the block is about to be
+ *		written, and provisions are made to fsync it as in smgrwrite().
+ */
+int
+smgrfd(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+	   bool forwrite, off_t *off)
+{
+	return smgrsw[reln->smgr_which].smgr_fd(reln, forknum, blocknum,
+											forwrite, off);
+}
+
 /*
  *	smgrnblocks() -- Calculate the number of blocks in the
  *					 supplied relation.
@@ -0,0 +1,339 @@
+/*
+ * costcalibrate.c
+ *		Measuring the planner's cost parameters on the machine at hand
+ *
+ * The planner's cost parameters are ratios of the time some basic operations
+ * take: reading a page sequentially or at random, processing a tuple, and
+ * evaluating an operator.  pg_calibrate_costs() times those operations on a
+ * given table, through the buffer manager, and suggests settings from the
+ * results, taking a sequential page read as the unit of cost as usual.  The
+ * page costs belong to the table's tablespace; the CPU costs are global.
+ *
+ * Only pages that weren't in shared buffers count towards the page costs;
+ * which ones were is told by the buffer usage counters.  Nothing can be
+ * done about the kernel's cache, though, so the table should be larger than
+ * the memory available for it, or at least not read recently.
+ * src/bin/pg_test_pagecost measures page reads below the kernel's cache,
+ * where it can drop that.
+ *
+ * Copyright (c) 2018, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  src/backend/utils/adt/costcalibrate.c
+ *
+ */
+
+#include "postgres.h"
+
+#include "access/heapam.h"
+#include "access/htup_details.h"
+#include "catalog/objectaddress.h"
+#include "catalog/pg_class.h"
+#include "commands/tablespace.h"
+#include "executor/instrument.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "storage/bufmgr.h"
+#include "utils/acl.h"
+#include "utils/builtins.h"
+#include "utils/fmgroids.h"
+#include "utils/lsyscache.h"
+#include "utils/rel.h"
+#include "utils/snapmgr.h"
+#include "utils/tqual.h"
+
+/* Number of operator calls to time */
+#define CALIBRATE_OPERATOR_CALLS	1000000
+
+#define PG_CALIBRATE_COSTS_COLS		4
+
+/* Accumulated time of some operation, in microseconds */
+typedef struct CalibrationTimer
+{
+	double		usecs;
+	double		count;
+} CalibrationTimer;
+
+static long buffer_misses(void);
+static void time_page_read(Relation rel, BlockNumber blkno,
+			   BufferAccessStrategy strategy, CalibrationTimer *pages,
+			   CalibrationTimer *tuples);
+static void put_calibration_row(Tuplestorestate *tupstore, TupleDesc tupdesc,
+					const char *tablespace, const char *parameter,
+					CalibrationTimer *timer, double unit);
+
+/*
+ * Number of pages read into shared or local buffers so far
+ */
+static long
+buffer_misses(void)
+{
+	return pgBufferUsage.shared_blks_read + pgBufferUsage.local_blks_read;
+}
+
+/*
+ * Read a page, timing the read if it missed the buffer cache, and time the
+ * processing of the tuples on it: a visibility check, and deforming the ones
+ * that are visible, as a sequential scan would.  Pass tuples as NULL to skip
+ * the latter.
+ */
+static void
+time_page_read(Relation rel, BlockNumber blkno, BufferAccessStrategy strategy,
+			   CalibrationTimer *pages, CalibrationTimer *tuples)
+{
+	TupleDesc	tupdesc = RelationGetDescr(rel);
+	Snapshot	snapshot = GetActiveSnapshot();
+	long		misses = buffer_misses();
+	instr_time	start;
+	instr_time	duration;
+	Buffer		buf;
+	Page		page;
+	OffsetNumber maxoff;
+	OffsetNumber off;
+	Datum	   *values;
+	bool	   *isnull;
+
+	INSTR_TIME_SET_CURRENT(start);
+	buf = ReadBufferExtended(rel, MAIN_FORKNUM, blkno, RBM_NORMAL, strategy);
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start);
+
+	if (buffer_misses() != misses)
+	{
+		pages->usecs += INSTR_TIME_GET_MICROSEC(duration);
+		pages->count += 1;
+	}
+
+	if (tuples == NULL)
+	{
+		ReleaseBuffer(buf);
+		return;
+	}
+
+	values = (Datum *) palloc(tupdesc->natts * sizeof(Datum));
+	isnull = (bool *) palloc(tupdesc->natts * sizeof(bool));
+
+	LockBuffer(buf, BUFFER_LOCK_SHARE);
+	page = BufferGetPage(buf);
+	maxoff = PageGetMaxOffsetNumber(page);
+
+	INSTR_TIME_SET_CURRENT(start);
+	for (off = FirstOffsetNumber; off <= maxoff; off = OffsetNumberNext(off))
+	{
+		ItemId		itemid = PageGetItemId(page, off);
+		HeapTupleData tuple;
+
+		if (!ItemIdIsNormal(itemid))
+			continue;
+
+		tuple.t_data = (HeapTupleHeader) PageGetItem(page, itemid);
+		tuple.t_len = ItemIdGetLength(itemid);
+		tuple.t_tableOid = RelationGetRelid(rel);
+		ItemPointerSet(&tuple.t_self, blkno, off);
+
+		if (HeapTupleSatisfiesVisibility(&tuple, snapshot, buf))
+			heap_deform_tuple(&tuple, tupdesc, values, isnull);
+		tuples->count += 1;
+	}
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start);
+	tuples->usecs += INSTR_TIME_GET_MICROSEC(duration);
+
+	UnlockReleaseBuffer(buf);
+	pfree(values);
+	pfree(isnull);
+}
+
+/*
+ * Add a result row for one cost parameter.  The time per operation and the
+ * suggested setting are left NULL if nothing was timed.
+ */
+static void
+put_calibration_row(Tuplestorestate *tupstore, TupleDesc tupdesc,
+					const char *tablespace, const char *parameter,
+					CalibrationTimer *timer, double unit)
+{
+	Datum		values[PG_CALIBRATE_COSTS_COLS];
+	bool		nulls[PG_CALIBRATE_COSTS_COLS];
+
+	memset(nulls, 0, sizeof(nulls));
+
+	if (tablespace)
+		values[0] = DirectFunctionCall1(namein, CStringGetDatum(tablespace));
+	else
+		nulls[0] = true;
+	values[1] = CStringGetTextDatum(parameter);
+
+	if (timer->count > 0)
+		values[2] = Float8GetDatum(timer->usecs / timer->count);
+	else
+		nulls[2] = true;
+
+	if (timer->count > 0 && unit > 0)
+		values[3] = Float8GetDatum(timer->usecs / timer->count / unit);
+	else
+		nulls[3] = true;
+
+	tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+}
+
+/*
+ * pg_calibrate_costs(relation regclass, npages integer)
+ *
+ * Reads npages pages of the relation sequentially, from its start, and as
+ * many at random from the rest of it, and returns the time per operation
+ * and the suggested setting of seq_page_cost, random_page_cost,
+ * cpu_tuple_cost and cpu_operator_cost.
+ */
+Datum
+pg_calibrate_costs(PG_FUNCTION_ARGS)
+{
+	Oid			relid = PG_GETARG_OID(0);
+	int32		npages = PG_GETARG_INT32(1);
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	Relation	rel;
+	AclResult	aclresult;
+	BufferAccessStrategy strategy;
+	BlockNumber nblocks;
+	BlockNumber nseq;
+	BlockNumber blkno;
+	Oid			tablespace;
+	char	   *tablespace_name;
+	CalibrationTimer seq_pages = {0, 0};
+	CalibrationTimer random_pages = {0, 0};
+	CalibrationTimer tuples = {0, 0};
+	CalibrationTimer operators = {0, 0};
+	double		unit = 0;
+	FmgrInfo	flinfo;
+	instr_time	start;
+	instr_time	duration;
+	volatile bool result = false;
+	int			i;
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not " \
+						"allowed in this context")));
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	if (npages <= 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("number of pages must be greater than zero")));
+
+	rel = relation_open(relid, AccessShareLock);
+
+	if (rel->rd_rel->relkind != RELKIND_RELATION &&
+		rel->rd_rel->relkind != RELKIND_MATVIEW)
+		ereport(ERROR,
+				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+				 errmsg("\"%s\" is not a table or materialized view",
+						RelationGetRelationName(rel))));
+
+	if (RELATION_IS_OTHER_TEMP(rel))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("cannot access temporary tables of other sessions")));
+
+	aclresult = pg_class_aclcheck(relid, GetUserId(), ACL_SELECT);
+	if (aclresult != ACLCHECK_OK)
+		aclcheck_error(aclresult, get_relkind_objtype(rel->rd_rel->relkind),
+					   RelationGetRelationName(rel));
+
+	nblocks = RelationGetNumberOfBlocks(rel);
+	if (nblocks == 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("table \"%s\" is empty",
+						RelationGetRelationName(rel))));
+
+	/*
+	 * Read the pages through a ring buffer, so as not to flush the rest of
+	 * shared buffers; that also keeps the pages read sequentially from being
+	 * found in them again by the random reads.  Those are taken from the
+	 * part of the table the sequential ones didn't read, if it's big enough.
+	 */
+	strategy = GetAccessStrategy(BAS_BULKREAD);
+
+	nseq = Min((BlockNumber) npages, nblocks);
+	for (blkno = 0; blkno < nseq; blkno++)
+	{
+		CHECK_FOR_INTERRUPTS();
+		time_page_read(rel, blkno, strategy, &seq_pages, &tuples);
+	}
+
+	for (i = 0; i < npages; i++)
+	{
+		CHECK_FOR_INTERRUPTS();
+		if (nblocks - nseq >= (BlockNumber) npages)
+			blkno = nseq + random() % (nblocks - nseq);
+		else
+			blkno = random() % nblocks;
+		time_page_read(rel, blkno, strategy, &random_pages, NULL);
+	}
+
+	FreeAccessStrategy(strategy);
+
+	/*
+	 * Operators are timed by calling int4lt directly, which leaves out the
+	 * overhead of expression evaluation; but that's paid by cpu_tuple_cost
+	 * for the most part anyway.
+	 */
+	fmgr_info(F_INT4LT, &flinfo);
+	INSTR_TIME_SET_CURRENT(start);
+	for (i = 0; i < CALIBRATE_OPERATOR_CALLS; i++)
+		result ^= DatumGetBool(FunctionCall2(&flinfo,
+											 Int32GetDatum(i),
+											 Int32GetDatum(npages)));
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start);
+	operators.usecs = INSTR_TIME_GET_MICROSEC(duration);
+	operators.count = CALIBRATE_OPERATOR_CALLS;
+
+	tablespace = rel->rd_rel->reltablespace;
+	if (!OidIsValid(tablespace))
+		tablespace = MyDatabaseTableSpace;
+	tablespace_name = get_tablespace_name(tablespace);
+
+	relation_close(rel, AccessShareLock);
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	/* A sequential page read is the unit of cost */
+	if (seq_pages.count > 0)
+		unit = seq_pages.usecs / seq_pages.count;
+
+	put_calibration_row(tupstore, tupdesc, tablespace_name,
+						"seq_page_cost", &seq_pages, unit);
+	put_calibration_row(tupstore, tupdesc, tablespace_name,
+						"random_page_cost", &random_pages, unit);
+	put_calibration_row(tupstore, tupdesc, NULL,
+						"cpu_tuple_cost", &tuples, unit);
+	put_calibration_row(tupstore, tupdesc, NULL,
+						"cpu_operator_cost", &operators, unit);
+
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
@@ -107,6 +107,7 @@
 #include "access/sysattr.h"
 #include "catalog/index.h"
 #include "catalog/pg_am.h"
+#include "catalog/pg_class.h"
 #include "catalog/pg_collation.h"
 #include "catalog/pg_operator.h"
 #include "catalog/pg_opfamily.h"
@@ -1183,6 +1184,100 @@ scalargesel(PG_FUNCTION_ARGS)
 	return scalarineqsel_wrapper(fcinfo, true, true);
 }
 
+/*
+ * param_value_selectivity
+ *		Estimate the selectivity of "column OP value" for a given value.
+ *
+ * This is a stripped-down version of what eqsel() and the scalar inequality
+ * estimators do, for use outside the planner: the plan cache uses it to
+ * classify the parameter values of a prepared statement without building
+ * a PlannerInfo.  relid/attnum/inh identify the pg_statistic entry to use,
+ * and value is the comparison value, which must be of the operator's input
+ * type on the non-column side.  Only operators estimated by eqsel or the
+ * scalar inequality estimators are supported.
+ *
+ * Returns -1 if there are no statistics for the column or the operator is
+ * not supported.
+ */
+Selectivity
+param_value_selectivity(Oid relid, AttrNumber attnum, bool inh, Oid opno,
+						Datum value, bool isnull, Oid valuetype,
+						bool varonleft)
+{
+	VariableStatData vardata;
+	RelOptInfo *rel;
+	HeapTuple	tuple;
+	RegProcedure oprrest;
+	Oid			collid;
+	Selectivity selec;
+
+	oprrest = get_oprrest(opno);
+	if (oprrest != F_EQSEL &&
+		oprrest != F_SCALARLTSEL && oprrest != F_SCALARLESEL &&
+		oprrest != F_SCALARGTSEL && oprrest != F_SCALARGESEL)
+		return -1.0;
+
+	memset(&vardata, 0, sizeof(vardata));
+	vardata.statsTuple = SearchSysCache3(STATRELATTINH,
+										 ObjectIdGetDatum(relid),
+										 Int16GetDatum(attnum),
+										 BoolGetDatum(inh));
+	if (!HeapTupleIsValid(vardata.statsTuple))
+		return -1.0;
+	vardata.freefunc = ReleaseSysCache;
+	vardata.acl_ok =
+		(pg_class_aclcheck(relid, GetUserId(), ACL_SELECT) == ACLCHECK_OK) ||
+		(pg_attribute_aclcheck(relid, attnum, GetUserId(),
+							   ACL_SELECT) == ACLCHECK_OK);
+	get_atttypetypmodcoll(relid, attnum, &vardata.atttype,
+						  &vardata.atttypmod, &collid);
+	vardata.vartype = vardata.atttype;
+
+	/*
+	 * The estimators only look at the tuple count of the relation (to scale
+	 * a negative stadistinct) and at its index list (to probe the actual
+	 * column range), so a dummy RelOptInfo with no indexes does the job.
+	 */
+	rel = makeNode(RelOptInfo);
+	rel->reloptkind = RELOPT_BASEREL;
+	rel->rtekind = RTE_RELATION;
+	tuple = SearchSysCache1(RELOID, ObjectIdGetDatum(relid));
+	if (HeapTupleIsValid(tuple))
+	{
+		rel->tuples = ((Form_pg_class) GETSTRUCT(tuple))->reltuples;
+		ReleaseSysCache(tuple);
+	}
+	vardata.rel = rel;
+
+	if (oprrest == F_EQSEL)
+		selec = var_eq_const(&vardata, opno, value, isnull, varonleft, false);
+	else if (isnull)
+		selec = 0.0;
+	else
+	{
+		bool		isgt = (oprrest == F_SCALARGTSEL || oprrest == F_SCALARGESEL);
+		bool		iseq = (oprrest == F_SCALARLESEL || oprrest == F_SCALARGESEL);
+
+		/* Force the var to be on the left, as scalarineqsel_wrapper does */
+		if (!varonleft)
+		{
+			opno = get_commutator(opno);
+			isgt = !isgt;
+		}
+
+		if (OidIsValid(opno))
+			selec = scalarineqsel(NULL, opno, isgt, iseq, &vardata,
+								  value, valuetype);
+		else
+			selec = DEFAULT_INEQ_SEL;
+	}
+
+	ReleaseVariableStats(vardata);
+	pfree(rel);
+
+	return selec;
+}
+
 /*
  * patternsel			- Generic code for pattern-match selectivity.
  */
@@ -109,6 +109,7 @@
 #include "utils/memutils.h"
 #include "utils/rel.h"
 #include "utils/relmapper.h"
+#include "utils/sharedplancache.h"
 #include "utils/snapmgr.h"
 #include "utils/syscache.h"
 
@@ -896,6 +897,7 @@ ProcessCommittedInvalidationMessages(SharedInvalidationMessage *msgs,
 	}
 
 	SendSharedInvalidMessages(msgs, nmsgs);
+	SharedPlanCacheInvalMessages(msgs, nmsgs);
 
 	if (RelcacheInitFileInval)
 		RelationCacheInitFilePostInvalidate();
@@ -951,6 +953,13 @@ AtEOXact_Inval(bool isCommit)
 		ProcessInvalidationMessagesMulti(&transInvalInfo->PriorCmdInvalidMsgs,
 										 SendSharedInvalidMessages);
 
+		/*
+		 * Shared plans are invalidated once, by us, rather than by every
+		 * backend receiving the messages.
+		 */
+		ProcessInvalidationMessagesMulti(&transInvalInfo->PriorCmdInvalidMsgs,
+										 SharedPlanCacheInvalMessages);
+
 		if (transInvalInfo->RelcacheInitFileInval)
 			RelationCacheInitFilePostInvalidate();
 	}
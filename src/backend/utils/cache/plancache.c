@@ -9,11 +9,16 @@
  * changes in the objects they depend on.
  *
  * The logic for choosing generic or custom plans is in choose_custom_plan,
- * which see for comments.
+ * which see for comments.  If the query compares parameters with table
+ * columns, the parameter values are first classified by the estimated
+ * selectivity of those comparisons (see choose_plan_bucket), and a separate
+ * generic plan and separate cost statistics are kept for each class.  That
+ * way a statement whose best plan depends heavily on the parameter values
+ * can still avoid replanning on every execution.
  *
  * Cache invalidation is driven off sinval events.  Any CachedPlanSource
- * that matches the event is marked invalid, as is its generic CachedPlan
- * if it has one.  When (and if) the next demand for a cached plan occurs,
+ * that matches the event is marked invalid, as are its generic CachedPlans
+ * if it has any.  When (and if) the next demand for a cached plan occurs,
  * parse analysis and rewrite is repeated to build a new valid query tree,
  * and then planning is performed as normal.  We also force re-analysis and
  * re-planning if the active search_path is different from the previous time
@@ -37,6 +42,9 @@
  * just to invalidate all plans.  We expect updates on those catalogs to
  * be infrequent enough that more-detailed tracking is not worth the effort.
  *
+ * Generic plans may also be shared with other backends through the shared
+ * plan cache (see sharedplancache.c), if enabled.
+ *
  *
  * Portions Copyright (c) 1996-2018, PostgreSQL Global Development Group
  * Portions Copyright (c) 1994, Regents of the University of California
@@ -52,9 +60,11 @@
 
 #include "access/transam.h"
 #include "catalog/namespace.h"
+#include "commands/trigger.h"
 #include "executor/executor.h"
 #include "miscadmin.h"
 #include "nodes/nodeFuncs.h"
+#include "optimizer/clauses.h"
 #include "optimizer/cost.h"
 #include "optimizer/planmain.h"
 #include "optimizer/prep.h"
@@ -63,10 +73,14 @@
 #include "storage/lmgr.h"
 #include "tcop/pquery.h"
 #include "tcop/utility.h"
+#include "utils/fmgroids.h"
 #include "utils/inval.h"
+#include "utils/lsyscache.h"
 #include "utils/memutils.h"
 #include "utils/resowner_private.h"
 #include "utils/rls.h"
+#include "utils/selfuncs.h"
+#include "utils/sharedplancache.h"
 #include "utils/snapmgr.h"
 #include "utils/syscache.h"
 
@@ -87,17 +101,27 @@
  */
 static CachedPlanSource *first_saved_plan = NULL;
 
+static void InitPlanBuckets(CachedPlanSource *plansource);
 static void ReleaseGenericPlan(CachedPlanSource *plansource);
+static void ReleaseBucketPlan(CachedPlanSource *plansource, int bucket);
+static void InvalidateGenericPlans(CachedPlanSource *plansource);
 static List *RevalidateCachedQuery(CachedPlanSource *plansource,
 					  QueryEnvironment *queryEnv);
-static bool CheckCachedPlan(CachedPlanSource *plansource);
+static bool CheckCachedPlan(CachedPlanSource *plansource, int bucket);
 static CachedPlan *BuildCachedPlan(CachedPlanSource *plansource, List *qlist,
 				ParamListInfo boundParams, QueryEnvironment *queryEnv);
-static bool choose_custom_plan(CachedPlanSource *plansource,
+static CachedPlan *MakeCachedPlan(CachedPlanSource *plansource, List *plist);
+static void SetGenericPlan(CachedPlanSource *plansource, int bucket,
+			   CachedPlan *plan);
+static void FindSensitiveParams(CachedPlanSource *plansource, List *qlist);
+static int	choose_plan_bucket(CachedPlanSource *plansource,
+				   ParamListInfo boundParams);
+static bool choose_custom_plan(CachedPlanSource *plansource, int bucket,
 				   ParamListInfo boundParams);
 static double cached_plan_cost(CachedPlan *plan, bool include_planner);
 static Query *QueryListGetPrimaryStmt(List *stmts);
 static void AcquireExecutorLocks(List *stmt_list, bool acquire);
+static bool PlanHasPendingFKeyEvents(List *stmt_list);
 static void AcquirePlannerLocks(List *stmt_list, bool acquire);
 static void ScanQueryForLocks(Query *parsetree, bool acquire);
 static bool ScanQueryWalker(Node *node, bool *acquire);
@@ -197,16 +221,15 @@ CreateCachedPlan(RawStmt *raw_parse_tree,
 	plansource->rewriteRoleId = InvalidOid;
 	plansource->rewriteRowSecurity = false;
 	plansource->dependsOnRLS = false;
-	plansource->gplan = NULL;
+	plansource->sensitive_params = NULL;
+	plansource->num_sensitive_params = 0;
 	plansource->is_oneshot = false;
 	plansource->is_complete = false;
 	plansource->is_saved = false;
 	plansource->is_valid = false;
 	plansource->generation = 0;
 	plansource->next_saved = NULL;
-	plansource->generic_cost = -1;
-	plansource->total_custom_cost = 0;
-	plansource->num_custom_plans = 0;
+	InitPlanBuckets(plansource);
 
 	MemoryContextSwitchTo(oldcxt);
 
@@ -265,16 +288,15 @@ CreateOneShotCachedPlan(RawStmt *raw_parse_tree,
 	plansource->rewriteRoleId = InvalidOid;
 	plansource->rewriteRowSecurity = false;
 	plansource->dependsOnRLS = false;
-	plansource->gplan = NULL;
+	plansource->sensitive_params = NULL;
+	plansource->num_sensitive_params = 0;
 	plansource->is_oneshot = true;
 	plansource->is_complete = false;
 	plansource->is_saved = false;
 	plansource->is_valid = false;
 	plansource->generation = 0;
 	plansource->next_saved = NULL;
-	plansource->generic_cost = -1;
-	plansource->total_custom_cost = 0;
-	plansource->num_custom_plans = 0;
+	InitPlanBuckets(plansource);
 
 	return plansource;
 }
@@ -393,6 +415,9 @@ CompleteCachedPlan(CachedPlanSource *plansource,
 		 * commands, because this could result in catalog accesses.
 		 */
 		plansource->search_path = GetOverrideSearchPath(querytree_context);
+
+		/* Look for parameters worth keeping separate generic plans for */
+		FindSensitiveParams(plansource, querytree_list);
 	}
 
 	/*
@@ -523,22 +548,67 @@ DropCachedPlan(CachedPlanSource *plansource)
 }
 
 /*
- * ReleaseGenericPlan: release a CachedPlanSource's generic plan, if any.
+ * InitPlanBuckets: reset the generic plan links and cost statistics
+ */
+static void
+InitPlanBuckets(CachedPlanSource *plansource)
+{
+	int			i;
+
+	for (i = 0; i < PLANCACHE_NUM_BUCKETS; i++)
+	{
+		plansource->buckets[i].gplan = NULL;
+		plansource->buckets[i].generic_cost = -1;
+		plansource->buckets[i].total_custom_cost = 0;
+		plansource->buckets[i].num_custom_plans = 0;
+	}
+}
+
+/*
+ * ReleaseGenericPlan: release all of a CachedPlanSource's generic plans.
  */
 static void
 ReleaseGenericPlan(CachedPlanSource *plansource)
+{
+	int			i;
+
+	for (i = 0; i < PLANCACHE_NUM_BUCKETS; i++)
+		ReleaseBucketPlan(plansource, i);
+}
+
+/*
+ * ReleaseBucketPlan: release the generic plan of one bucket, if any.
+ */
+static void
+ReleaseBucketPlan(CachedPlanSource *plansource, int bucket)
 {
 	/* Be paranoid about the possibility that ReleaseCachedPlan fails */
-	if (plansource->gplan)
+	if (plansource->buckets[bucket].gplan)
 	{
-		CachedPlan *plan = plansource->gplan;
+		CachedPlan *plan = plansource->buckets[bucket].gplan;
 
 		Assert(plan->magic == CACHEDPLAN_MAGIC);
-		plansource->gplan = NULL;
+		plansource->buckets[bucket].gplan = NULL;
 		ReleaseCachedPlan(plan, false);
 	}
 }
 
+/*
+ * InvalidateGenericPlans: mark all of a CachedPlanSource's generic plans
+ * invalid.
+ */
+static void
+InvalidateGenericPlans(CachedPlanSource *plansource)
+{
+	int			i;
+
+	for (i = 0; i < PLANCACHE_NUM_BUCKETS; i++)
+	{
+		if (plansource->buckets[i].gplan)
+			plansource->buckets[i].gplan->is_valid = false;
+	}
+}
+
 /*
  * RevalidateCachedQuery: ensure validity of analyzed-and-rewritten query tree.
  *
@@ -588,10 +658,9 @@ RevalidateCachedQuery(CachedPlanSource *plansource,
 		Assert(plansource->search_path != NULL);
 		if (!OverrideSearchPathMatchesCurrent(plansource->search_path))
 		{
-			/* Invalidate the querytree and generic plan */
+			/* Invalidate the querytree and generic plans */
 			plansource->is_valid = false;
-			if (plansource->gplan)
-				plansource->gplan->is_valid = false;
+			InvalidateGenericPlans(plansource);
 		}
 	}
 
@@ -637,6 +706,8 @@ RevalidateCachedQuery(CachedPlanSource *plansource,
 	plansource->relationOids = NIL;
 	plansource->invalItems = NIL;
 	plansource->search_path = NULL;
+	plansource->sensitive_params = NULL;
+	plansource->num_sensitive_params = 0;
 
 	/*
 	 * Free the query_context.  We don't really expect MemoryContextDelete to
@@ -652,7 +723,7 @@ RevalidateCachedQuery(CachedPlanSource *plansource,
 		MemoryContextDelete(qcxt);
 	}
 
-	/* Drop the generic plan reference if any */
+	/* Drop the generic plan references if any */
 	ReleaseGenericPlan(plansource);
 
 	/*
@@ -761,6 +832,8 @@ RevalidateCachedQuery(CachedPlanSource *plansource,
 	 */
 	plansource->search_path = GetOverrideSearchPath(querytree_context);
 
+	FindSensitiveParams(plansource, qlist);
+
 	MemoryContextSwitchTo(oldcxt);
 
 	/* Now reparent the finished query_context and save the links */
@@ -785,7 +858,8 @@ RevalidateCachedQuery(CachedPlanSource *plansource,
 }
 
 /*
- * CheckCachedPlan: see if the CachedPlanSource's generic plan is valid.
+ * CheckCachedPlan: see if the CachedPlanSource's generic plan for the given
+ * bucket is valid.
  *
  * Caller must have already called RevalidateCachedQuery to verify that the
  * querytree is up to date.
@@ -794,9 +868,9 @@ RevalidateCachedQuery(CachedPlanSource *plansource,
  * (We must do this for the "true" result to be race-condition-free.)
  */
 static bool
-CheckCachedPlan(CachedPlanSource *plansource)
+CheckCachedPlan(CachedPlanSource *plansource, int bucket)
 {
-	CachedPlan *plan = plansource->gplan;
+	CachedPlan *plan = plansource->buckets[bucket].gplan;
 
 	/* Assert that caller checked the querytree */
 	Assert(plansource->is_valid);
@@ -839,6 +913,15 @@ CheckCachedPlan(CachedPlanSource *plansource)
 			!TransactionIdEquals(plan->saved_xmin, TransactionXmin))
 			plan->is_valid = false;
 
+		/*
+		 * If the planner removed joins relying on foreign keys, check that
+		 * no trigger events are pending on the tables involved, like the
+		 * planner did.  Otherwise a constraint might not hold at the moment,
+		 * and we need a new plan that keeps the joins.
+		 */
+		if (plan->is_valid && PlanHasPendingFKeyEvents(plan->stmt_list))
+			plan->is_valid = false;
+
 		/*
 		 * By now, if any invalidation has happened, the inval callback
 		 * functions will have marked the plan invalid.
@@ -856,7 +939,7 @@ CheckCachedPlan(CachedPlanSource *plansource)
 	/*
 	 * Plan has been invalidated, so unlink it from the parent and release it.
 	 */
-	ReleaseGenericPlan(plansource);
+	ReleaseBucketPlan(plansource, bucket);
 
 	return false;
 }
@@ -881,13 +964,8 @@ static CachedPlan *
 BuildCachedPlan(CachedPlanSource *plansource, List *qlist,
 				ParamListInfo boundParams, QueryEnvironment *queryEnv)
 {
-	CachedPlan *plan;
 	List	   *plist;
 	bool		snapshot_set;
-	bool		is_transient;
-	MemoryContext plan_context;
-	MemoryContext oldcxt = CurrentMemoryContext;
-	ListCell   *lc;
 
 	/*
 	 * Normally the querytree should be valid already, but if it's not,
@@ -940,6 +1018,24 @@ BuildCachedPlan(CachedPlanSource *plansource, List *qlist,
 	if (snapshot_set)
 		PopActiveSnapshot();
 
+	return MakeCachedPlan(plansource, plist);
+}
+
+/*
+ * MakeCachedPlan: construct a CachedPlan for a list of PlannedStmts.
+ *
+ * The PlannedStmts are either freshly built by BuildCachedPlan, or obtained
+ * from the shared plan cache.
+ */
+static CachedPlan *
+MakeCachedPlan(CachedPlanSource *plansource, List *plist)
+{
+	CachedPlan *plan;
+	bool		is_transient;
+	MemoryContext plan_context;
+	MemoryContext oldcxt = CurrentMemoryContext;
+	ListCell   *lc;
+
 	/*
 	 * Normally we make a dedicated memory context for the CachedPlan and its
 	 * subsidiary data.  (It's probably not going to be large, but just in
@@ -1010,14 +1106,220 @@ BuildCachedPlan(CachedPlanSource *plansource, List *qlist,
 	return plan;
 }
 
+/*
+ * SetGenericPlan: link a new generic plan into the given bucket of the
+ * plansource.
+ */
+static void
+SetGenericPlan(CachedPlanSource *plansource, int bucket, CachedPlan *plan)
+{
+	/* Just make real sure the bucket's gplan is clear */
+	ReleaseBucketPlan(plansource, bucket);
+	/* Link the new generic plan into the plansource */
+	plansource->buckets[bucket].gplan = plan;
+	plan->refcount++;
+	/* Immediately reparent into appropriate context */
+	if (plansource->is_saved)
+	{
+		/* saved plans all live under CacheMemoryContext */
+		MemoryContextSetParent(plan->context, CacheMemoryContext);
+		plan->is_saved = true;
+	}
+	else
+	{
+		/* otherwise, it should be a sibling of the plansource */
+		MemoryContextSetParent(plan->context,
+							   MemoryContextGetParent(plansource->context));
+	}
+	/* Update generic_cost whenever we make a new generic plan */
+	plansource->buckets[bucket].generic_cost = cached_plan_cost(plan, false);
+}
+
+/*
+ * FindSensitiveParams: find the parameters the plan choice depends on
+ *
+ * We look for top-level WHERE clauses of the form "column OP $n", where the
+ * column belongs to a plain table and OP is estimated by eqsel or one of the
+ * scalar inequality estimators.  Those are the cases for which we can cheaply
+ * estimate the selectivity of a parameter value from the column statistics.
+ * The result is saved in the current memory context, which should be the
+ * plansource's query_context.
+ */
+static void
+FindSensitiveParams(CachedPlanSource *plansource, List *qlist)
+{
+	List	   *found = NIL;
+	ListCell   *lc;
+	int			i;
+
+	foreach(lc, qlist)
+	{
+		Query	   *query = lfirst_node(Query, lc);
+		ListCell   *lc2;
+
+		if (query->commandType == CMD_UTILITY || query->jointree == NULL)
+			continue;
+
+		foreach(lc2, make_ands_implicit((Expr *) query->jointree->quals))
+		{
+			OpExpr	   *opexpr = (OpExpr *) lfirst(lc2);
+			Node	   *leftop;
+			Node	   *rightop;
+			Var		   *var;
+			Param	   *param;
+			RangeTblEntry *rte;
+			RegProcedure oprrest;
+			PlanCacheSensitiveParam *sp;
+			bool		varonleft;
+
+			if (!is_opclause(opexpr) || list_length(opexpr->args) != 2)
+				continue;
+			leftop = (Node *) linitial(opexpr->args);
+			rightop = (Node *) lsecond(opexpr->args);
+			while (IsA(leftop, RelabelType))
+				leftop = (Node *) ((RelabelType *) leftop)->arg;
+			while (IsA(rightop, RelabelType))
+				rightop = (Node *) ((RelabelType *) rightop)->arg;
+
+			/* The parameter must be passed to the operator as is */
+			if (IsA(leftop, Var) && IsA(lsecond(opexpr->args), Param))
+			{
+				var = (Var *) leftop;
+				param = (Param *) lsecond(opexpr->args);
+				varonleft = true;
+			}
+			else if (IsA(linitial(opexpr->args), Param) && IsA(rightop, Var))
+			{
+				param = (Param *) linitial(opexpr->args);
+				var = (Var *) rightop;
+				varonleft = false;
+			}
+			else
+				continue;
+
+			if (param->paramkind != PARAM_EXTERN ||
+				var->varlevelsup != 0 || var->varattno <= 0)
+				continue;
+			rte = rt_fetch(var->varno, query->rtable);
+			if (rte->rtekind != RTE_RELATION)
+				continue;
+
+			oprrest = get_oprrest(opexpr->opno);
+			if (oprrest != F_EQSEL &&
+				oprrest != F_SCALARLTSEL && oprrest != F_SCALARLESEL &&
+				oprrest != F_SCALARGTSEL && oprrest != F_SCALARGESEL)
+				continue;
+
+			sp = (PlanCacheSensitiveParam *) palloc(sizeof(PlanCacheSensitiveParam));
+			sp->paramid = param->paramid;
+			sp->paramtype = param->paramtype;
+			sp->relid = rte->relid;
+			sp->attnum = var->varattno;
+			sp->inh = rte->inh;
+			sp->opno = opexpr->opno;
+			sp->varonleft = varonleft;
+			found = lappend(found, sp);
+		}
+	}
+
+	plansource->num_sensitive_params = list_length(found);
+	if (found == NIL)
+	{
+		plansource->sensitive_params = NULL;
+		return;
+	}
+
+	plansource->sensitive_params = (PlanCacheSensitiveParam *)
+		palloc(list_length(found) * sizeof(PlanCacheSensitiveParam));
+	i = 0;
+	foreach(lc, found)
+		plansource->sensitive_params[i++] = *(PlanCacheSensitiveParam *) lfirst(lc);
+	list_free_deep(found);
+}
+
+/*
+ * choose_plan_bucket: classify the parameter values of an execution
+ *
+ * Returns the index of the bucket whose generic plan and cost statistics
+ * should be used.  Bucket 0 is used when the plan choice doesn't depend on
+ * the parameter values, or we can't tell how it does.  Otherwise we estimate
+ * the combined selectivity of the parameter-sensitive quals from the column
+ * statistics, and map it to one of the remaining buckets according to
+ * bucket_bounds[].  A generic plan made for one of those buckets is still
+ * valid for any parameter values, but it was costed for values of roughly
+ * that selectivity, so it's likely to be good for all of them.
+ */
+static int
+choose_plan_bucket(CachedPlanSource *plansource, ParamListInfo boundParams)
+{
+	static const Selectivity bucket_bounds[] = {0.001, 0.01, 0.1};
+	Selectivity selec = 1.0;
+	bool		found = false;
+	int			i;
+
+	StaticAssertStmt(lengthof(bucket_bounds) + 2 == PLANCACHE_NUM_BUCKETS,
+					 "bucket_bounds[] does not match PLANCACHE_NUM_BUCKETS");
+
+	if (plansource->num_sensitive_params == 0 || boundParams == NULL)
+		return 0;
+
+	/* Don't bother if caller forces the plan choice */
+	if (plansource->cursor_options &
+		(CURSOR_OPT_GENERIC_PLAN | CURSOR_OPT_CUSTOM_PLAN))
+		return 0;
+
+	for (i = 0; i < plansource->num_sensitive_params; i++)
+	{
+		PlanCacheSensitiveParam *sp = &plansource->sensitive_params[i];
+		ParamExternData *prm;
+		ParamExternData prmdata;
+		Selectivity s;
+
+		if (sp->paramid <= 0 || sp->paramid > boundParams->numParams)
+			continue;
+
+		/* give hook a chance in case parameter is dynamic */
+		if (boundParams->paramFetch != NULL)
+			prm = boundParams->paramFetch(boundParams, sp->paramid,
+										  true, &prmdata);
+		else
+			prm = &boundParams->params[sp->paramid - 1];
+
+		if (prm->ptype != sp->paramtype)
+			continue;
+
+		s = param_value_selectivity(sp->relid, sp->attnum, sp->inh, sp->opno,
+									prm->value, prm->isnull, sp->paramtype,
+									sp->varonleft);
+		if (s < 0)
+			continue;			/* no statistics */
+
+		selec *= s;
+		found = true;
+	}
+
+	if (!found)
+		return 0;
+
+	for (i = 0; i < lengthof(bucket_bounds); i++)
+	{
+		if (selec < bucket_bounds[i])
+			return i + 1;
+	}
+	return lengthof(bucket_bounds) + 1;
+}
+
 /*
  * choose_custom_plan: choose whether to use custom or generic plan
  *
- * This defines the policy followed by GetCachedPlan.
+ * This defines the policy followed by GetCachedPlan.  The statistics of the
+ * given bucket are used to make the decision.
  */
 static bool
-choose_custom_plan(CachedPlanSource *plansource, ParamListInfo boundParams)
+choose_custom_plan(CachedPlanSource *plansource, int bucket,
+				   ParamListInfo boundParams)
 {
+	CachedPlanBucket *pb = &plansource->buckets[bucket];
 	double		avg_custom_cost;
 
 	/* One-shot plans will always be considered custom */
@@ -1038,10 +1340,10 @@ choose_custom_plan(CachedPlanSource *plansource, ParamListInfo boundParams)
 		return true;
 
 	/* Generate custom plans until we have done at least 5 (arbitrary) */
-	if (plansource->num_custom_plans < 5)
+	if (pb->num_custom_plans < 5)
 		return true;
 
-	avg_custom_cost = plansource->total_custom_cost / plansource->num_custom_plans;
+	avg_custom_cost = pb->total_custom_cost / pb->num_custom_plans;
 
 	/*
 	 * Prefer generic plan if it's less expensive than the average custom
@@ -1053,7 +1355,7 @@ choose_custom_plan(CachedPlanSource *plansource, ParamListInfo boundParams)
 	 * Note that if generic_cost is -1 (indicating we've not yet determined
 	 * the generic plan cost), we'll always prefer generic at this point.
 	 */
-	if (plansource->generic_cost < avg_custom_cost)
+	if (pb->generic_cost < avg_custom_cost)
 		return false;
 
 	return true;
@@ -1137,6 +1439,7 @@ GetCachedPlan(CachedPlanSource *plansource, ParamListInfo boundParams,
 {
 	CachedPlan *plan = NULL;
 	List	   *qlist;
+	int			bucket;
 	bool		customplan;
 
 	/* Assert caller is doing things in a sane order */
@@ -1149,41 +1452,78 @@ GetCachedPlan(CachedPlanSource *plansource, ParamListInfo boundParams,
 	/* Make sure the querytree list is valid and we have parse-time locks */
 	qlist = RevalidateCachedQuery(plansource, queryEnv);
 
-	/* Decide whether to use a custom plan */
-	customplan = choose_custom_plan(plansource, boundParams);
+	/* Classify the parameter values, and decide whether to use a custom plan */
+	bucket = choose_plan_bucket(plansource, boundParams);
+	customplan = choose_custom_plan(plansource, bucket, boundParams);
 
 	if (!customplan)
 	{
-		if (CheckCachedPlan(plansource))
+		if (CheckCachedPlan(plansource, bucket))
 		{
 			/* We want a generic plan, and we already have a valid one */
-			plan = plansource->gplan;
+			plan = plansource->buckets[bucket].gplan;
 			Assert(plan->magic == CACHEDPLAN_MAGIC);
 		}
 		else
 		{
-			/* Build a new generic plan */
-			plan = BuildCachedPlan(plansource, qlist, NULL, queryEnv);
-			/* Just make real sure plansource->gplan is clear */
-			ReleaseGenericPlan(plansource);
-			/* Link the new generic plan into the plansource */
-			plansource->gplan = plan;
-			plan->refcount++;
-			/* Immediately reparent into appropriate context */
-			if (plansource->is_saved)
+			SharedPlanSnapshot snap;
+			bool		shared;
+
+			plan = NULL;
+
+			/*
+			 * If the generic plan can be shared with other backends, one of
+			 * them may have built it already.  In that case adopt it, and
+			 * revalidate it just like our own generic plan (which also
+			 * acquires the executor locks).  Otherwise remember the state of
+			 * the shared invalidation counters before planning, so that we
+			 * can publish the plan we're about to build.  Plans made for a
+			 * selectivity bucket are tuned for parameter values seen by this
+			 * backend, so only the plain generic plan is shared.
+			 */
+			shared = (bucket == 0 &&
+					  SharedPlanCacheEligible(plansource, queryEnv));
+			if (shared)
 			{
-				/* saved plans all live under CacheMemoryContext */
-				MemoryContextSetParent(plan->context, CacheMemoryContext);
-				plan->is_saved = true;
+				List	   *plist = SharedPlanCacheLookup(plansource);
+
+				if (plist != NIL)
+				{
+					SetGenericPlan(plansource, bucket,
+								   MakeCachedPlan(plansource, plist));
+
+					if (CheckCachedPlan(plansource, bucket))
+						plan = plansource->buckets[bucket].gplan;
+				}
+
+				if (plan == NULL)
+					SharedPlanCacheTakeSnapshot(&snap);
 			}
-			else
+
+			if (plan == NULL)
 			{
-				/* otherwise, it should be a sibling of the plansource */
-				MemoryContextSetParent(plan->context,
-									   MemoryContextGetParent(plansource->context));
+				ParamListInfo hintParams = NULL;
+				int			i;
+
+				/*
+				 * Build a new generic plan.  For a selectivity bucket, pass
+				 * the current parameter values to the planner, but without
+				 * PARAM_FLAG_CONST: the planner then uses them only for
+				 * estimation, so the plan remains valid for any values.
+				 */
+				if (bucket > 0)
+				{
+					hintParams = copyParamList(boundParams);
+					for (i = 0; i < hintParams->numParams; i++)
+						hintParams->params[i].pflags &= ~PARAM_FLAG_CONST;
+				}
+
+				plan = BuildCachedPlan(plansource, qlist, hintParams, queryEnv);
+				SetGenericPlan(plansource, bucket, plan);
+
+				if (shared)
+					SharedPlanCacheStore(plansource, plan->stmt_list, &snap);
 			}
-			/* Update generic_cost whenever we make a new generic plan */
-			plansource->generic_cost = cached_plan_cost(plan, false);
 
 			/*
 			 * If, based on the now-known value of generic_cost, we'd not have
@@ -1194,7 +1534,7 @@ GetCachedPlan(CachedPlanSource *plansource, ParamListInfo boundParams,
 			 * find it's a loser, but we don't want to actually execute that
 			 * plan.
 			 */
-			customplan = choose_custom_plan(plansource, boundParams);
+			customplan = choose_custom_plan(plansource, bucket, boundParams);
 
 			/*
 			 * If we choose to plan again, we need to re-copy the query_list,
@@ -1210,10 +1550,11 @@ GetCachedPlan(CachedPlanSource *plansource, ParamListInfo boundParams,
 		/* Build a custom plan */
 		plan = BuildCachedPlan(plansource, qlist, boundParams, queryEnv);
 		/* Accumulate total costs of custom plans, but 'ware overflow */
-		if (plansource->num_custom_plans < INT_MAX)
+		if (plansource->buckets[bucket].num_custom_plans < INT_MAX)
 		{
-			plansource->total_custom_cost += cached_plan_cost(plan, true);
-			plansource->num_custom_plans++;
+			plansource->buckets[bucket].total_custom_cost +=
+				cached_plan_cost(plan, true);
+			plansource->buckets[bucket].num_custom_plans++;
 		}
 	}
 
@@ -1284,6 +1625,8 @@ void
 CachedPlanSetParentContext(CachedPlanSource *plansource,
 						   MemoryContext newcontext)
 {
+	int			i;
+
 	/* Assert caller is doing things in a sane order */
 	Assert(plansource->magic == CACHEDPLANSOURCE_MAGIC);
 	Assert(plansource->is_complete);
@@ -1299,13 +1642,18 @@ CachedPlanSetParentContext(CachedPlanSource *plansource,
 
 	/*
 	 * The query_context needs no special handling, since it's a child of
-	 * plansource->context.  But if there's a generic plan, it should be
-	 * maintained as a sibling of plansource->context.
+	 * plansource->context.  But generic plans, if any, should be maintained
+	 * as siblings of plansource->context.
 	 */
-	if (plansource->gplan)
+	for (i = 0; i < PLANCACHE_NUM_BUCKETS; i++)
 	{
-		Assert(plansource->gplan->magic == CACHEDPLAN_MAGIC);
-		MemoryContextSetParent(plansource->gplan->context, newcontext);
+		CachedPlan *gplan = plansource->buckets[i].gplan;
+
+		if (gplan)
+		{
+			Assert(gplan->magic == CACHEDPLAN_MAGIC);
+			MemoryContextSetParent(gplan->context, newcontext);
+		}
 	}
 }
 
@@ -1325,6 +1673,7 @@ CopyCachedPlan(CachedPlanSource *plansource)
 	MemoryContext source_context;
 	MemoryContext querytree_context;
 	MemoryContext oldcxt;
+	int			i;
 
 	Assert(plansource->magic == CACHEDPLANSOURCE_MAGIC);
 	Assert(plansource->is_complete);
@@ -1376,13 +1725,23 @@ CopyCachedPlan(CachedPlanSource *plansource)
 	newsource->invalItems = copyObject(plansource->invalItems);
 	if (plansource->search_path)
 		newsource->search_path = CopyOverrideSearchPath(plansource->search_path);
+	if (plansource->num_sensitive_params > 0)
+	{
+		newsource->sensitive_params = (PlanCacheSensitiveParam *)
+			palloc(plansource->num_sensitive_params *
+				   sizeof(PlanCacheSensitiveParam));
+		memcpy(newsource->sensitive_params, plansource->sensitive_params,
+			   plansource->num_sensitive_params *
+			   sizeof(PlanCacheSensitiveParam));
+	}
+	else
+		newsource->sensitive_params = NULL;
+	newsource->num_sensitive_params = plansource->num_sensitive_params;
 	newsource->query_context = querytree_context;
 	newsource->rewriteRoleId = plansource->rewriteRoleId;
 	newsource->rewriteRowSecurity = plansource->rewriteRowSecurity;
 	newsource->dependsOnRLS = plansource->dependsOnRLS;
 
-	newsource->gplan = NULL;
-
 	newsource->is_oneshot = false;
 	newsource->is_complete = true;
 	newsource->is_saved = false;
@@ -1390,10 +1749,11 @@ CopyCachedPlan(CachedPlanSource *plansource)
 	newsource->generation = plansource->generation;
 	newsource->next_saved = NULL;
 
-	/* We may as well copy any acquired cost knowledge */
-	newsource->generic_cost = plansource->generic_cost;
-	newsource->total_custom_cost = plansource->total_custom_cost;
-	newsource->num_custom_plans = plansource->num_custom_plans;
+	/* We may as well copy any acquired cost knowledge, but not the plans */
+	memcpy(newsource->buckets, plansource->buckets,
+		   sizeof(plansource->buckets));
+	for (i = 0; i < PLANCACHE_NUM_BUCKETS; i++)
+		newsource->buckets[i].gplan = NULL;
 
 	MemoryContextSwitchTo(oldcxt);
 
@@ -1470,6 +1830,30 @@ QueryListGetPrimaryStmt(List *stmts)
 	return NULL;
 }
 
+/*
+ * PlanHasPendingFKeyEvents: are after-trigger events pending on any table
+ * whose foreign keys the planner used to remove joins from the plan?
+ */
+static bool
+PlanHasPendingFKeyEvents(List *stmt_list)
+{
+	ListCell   *lc1;
+
+	foreach(lc1, stmt_list)
+	{
+		PlannedStmt *plannedstmt = lfirst_node(PlannedStmt, lc1);
+		ListCell   *lc2;
+
+		foreach(lc2, plannedstmt->fkeyJoinRelOids)
+		{
+			if (AfterTriggerPendingOnRel(lfirst_oid(lc2)))
+				return true;
+		}
+	}
+
+	return false;
+}
+
 /*
  * AcquireExecutorLocks: acquire locks needed for execution of a cached plan;
  * or release them if acquire is false.
@@ -1707,6 +2091,7 @@ static void
 PlanCacheRelCallback(Datum arg, Oid relid)
 {
 	CachedPlanSource *plansource;
+	int			i;
 
 	for (plansource = first_saved_plan; plansource; plansource = plansource->next_saved)
 	{
@@ -1726,21 +2111,24 @@ PlanCacheRelCallback(Datum arg, Oid relid)
 		if ((relid == InvalidOid) ? plansource->relationOids != NIL :
 			list_member_oid(plansource->relationOids, relid))
 		{
-			/* Invalidate the querytree and generic plan */
+			/* Invalidate the querytree and generic plans */
 			plansource->is_valid = false;
-			if (plansource->gplan)
-				plansource->gplan->is_valid = false;
+			InvalidateGenericPlans(plansource);
 		}
 
 		/*
-		 * The generic plan, if any, could have more dependencies than the
-		 * querytree does, so we have to check it too.
+		 * The generic plans, if any, could have more dependencies than the
+		 * querytree does, so we have to check them too.
 		 */
-		if (plansource->gplan && plansource->gplan->is_valid)
+		for (i = 0; i < PLANCACHE_NUM_BUCKETS; i++)
 		{
+			CachedPlan *gplan = plansource->buckets[i].gplan;
 			ListCell   *lc;
 
-			foreach(lc, plansource->gplan->stmt_list)
+			if (gplan == NULL || !gplan->is_valid)
+				continue;
+
+			foreach(lc, gplan->stmt_list)
 			{
 				PlannedStmt *plannedstmt = lfirst_node(PlannedStmt, lc);
 
@@ -1750,7 +2138,7 @@ PlanCacheRelCallback(Datum arg, Oid relid)
 					list_member_oid(plannedstmt->relationOids, relid))
 				{
 					/* Invalidate the generic plan only */
-					plansource->gplan->is_valid = false;
+					gplan->is_valid = false;
 					break;		/* out of stmt_list scan */
 				}
 			}
@@ -1776,6 +2164,7 @@ PlanCacheFuncCallback(Datum arg, int cacheid, uint32 hashvalue)
 	for (plansource = first_saved_plan; plansource; plansource = plansource->next_saved)
 	{
 		ListCell   *lc;
+		int			i;
 
 		Assert(plansource->magic == CACHEDPLANSOURCE_MAGIC);
 
@@ -1799,21 +2188,25 @@ PlanCacheFuncCallback(Datum arg, int cacheid, uint32 hashvalue)
 			if (hashvalue == 0 ||
 				item->hashValue == hashvalue)
 			{
-				/* Invalidate the querytree and generic plan */
+				/* Invalidate the querytree and generic plans */
 				plansource->is_valid = false;
-				if (plansource->gplan)
-					plansource->gplan->is_valid = false;
+				InvalidateGenericPlans(plansource);
 				break;
 			}
 		}
 
 		/*
-		 * The generic plan, if any, could have more dependencies than the
-		 * querytree does, so we have to check it too.
+		 * The generic plans, if any, could have more dependencies than the
+		 * querytree does, so we have to check them too.
 		 */
-		if (plansource->gplan && plansource->gplan->is_valid)
+		for (i = 0; i < PLANCACHE_NUM_BUCKETS; i++)
 		{
-			foreach(lc, plansource->gplan->stmt_list)
+			CachedPlan *gplan = plansource->buckets[i].gplan;
+
+			if (gplan == NULL || !gplan->is_valid)
+				continue;
+
+			foreach(lc, gplan->stmt_list)
 			{
 				PlannedStmt *plannedstmt = lfirst_node(PlannedStmt, lc);
 				ListCell   *lc3;
@@ -1830,11 +2223,11 @@ PlanCacheFuncCallback(Datum arg, int cacheid, uint32 hashvalue)
 						item->hashValue == hashvalue)
 					{
 						/* Invalidate the generic plan only */
-						plansource->gplan->is_valid = false;
+						gplan->is_valid = false;
 						break;	/* out of invalItems scan */
 					}
 				}
-				if (!plansource->gplan->is_valid)
+				if (!gplan->is_valid)
 					break;		/* out of stmt_list scan */
 			}
 		}
@@ -1895,8 +2288,7 @@ ResetPlanCache(void)
 			{
 				/* non-utility statement, so invalidate */
 				plansource->is_valid = false;
-				if (plansource->gplan)
-					plansource->gplan->is_valid = false;
+				InvalidateGenericPlans(plansource);
 				/* no need to look further */
 				break;
 			}
@@ -4210,6 +4210,8 @@ RelationGetFKeyList(Relation relation)
 		info = makeNode(ForeignKeyCacheInfo);
 		info->conrelid = constraint->conrelid;
 		info->confrelid = constraint->confrelid;
+		info->convalidated = constraint->convalidated;
+		info->condeferrable = constraint->condeferrable;
 
 		/* Extract data from conkey field */
 		adatum = fastgetattr(htup, Anum_pg_constraint_conkey,
@@ -0,0 +1,840 @@
+/*-------------------------------------------------------------------------
+ *
+ * sharedplancache.c
+ *	  Cross-backend cache of generic plans.
+ *
+ * Each backend builds generic plans for its own CachedPlanSources, so with
+ * many sessions running the same prepared statements (typically behind a
+ * connection pooler) the same planning work is repeated over and over, and
+ * again after every reconnect.  When shared_plan_cache_size is set, generic
+ * plans are additionally published in shared memory, serialized using
+ * nodeToString(), and backends preparing the same statement pick them up
+ * instead of planning the query themselves.
+ *
+ * Entries are identified by the database, the current role, the query text
+ * and a "context" string describing everything else that may affect parse
+ * analysis and planning of the text - the active search_path, parameter
+ * types, cursor options, row_security, and the settings affecting parsing,
+ * constant folding and planning (TimeZone, DateStyle, planner settings and
+ * so on) that don't have their built-in defaults.  The hash table of entries has a
+ * fixed size and lives in the main shared memory segment.  The variable-
+ * length parts (texts and the plan itself) are stored in a DSA area created
+ * in place in the main shared memory segment, and not allowed to grow beyond
+ * that.
+ *
+ * Invalidation is driven by the invalidation messages a transaction sends
+ * when it commits (or that replay of its commit record sends, on a hot
+ * standby).  The committing backend bumps, once per message, one of
+ * SHARED_PLAN_COUNTERS counters, chosen by hashing the invalidated object.
+ * Changes of the catalogs that the plancache tracks as a whole (namespaces,
+ * operators and foreign servers) bump one counter per catalog, and only
+ * invalidation of all relations or of a whole catalog bumps the global
+ * generation counter.  Receivers of the messages do nothing, so a backend
+ * whose local caches are reset after a sinval queue overflow doesn't affect
+ * the shared entries.  Each entry remembers values of the counters for all
+ * objects its plan depends on, as observed before the planning started, and
+ * it becomes stale as soon as any of them changes.  Lookups simply skip
+ * stale entries, and they are discarded when we need space for new ones.
+ * Hash collisions between counters only cause unnecessary invalidations.
+ *
+ * A plan obtained from the shared cache becomes the generic plan of the
+ * local CachedPlanSource, and from then on it's treated exactly like a
+ * locally built plan (in particular, it's revalidated after acquiring the
+ * executor locks, and invalidated by local sinval callbacks).
+ *
+ * Portions Copyright (c) 1996-2018, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  src/backend/utils/cache/sharedplancache.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/hash.h"
+#include "access/htup_details.h"
+#include "catalog/namespace.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "nodes/parsenodes.h"
+#include "nodes/plannodes.h"
+#include "port/atomics.h"
+#include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "utils/builtins.h"
+#include "utils/dsa.h"
+#include "utils/guc.h"
+#include "utils/hashutils.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
+#include "utils/rls.h"
+#include "utils/sharedplancache.h"
+#include "utils/syscache.h"
+
+
+/* assumed average space needed per entry, determines size of hash table */
+#define SHARED_PLAN_KB_PER_ENTRY	4
+#define SHARED_PLAN_MIN_ENTRIES		16
+
+/* percentage of entries to evict when we run out of space */
+#define SHARED_PLAN_EVICT_PERCENT	5
+
+/*
+ * Hash key of the shared plan cache entries.  The query and context strings
+ * are compared too, so collisions are not a problem.
+ */
+typedef struct SharedPlanKey
+{
+	Oid			dbid;			/* database the plan was built in */
+	Oid			userid;			/* role the plan was built for */
+	uint32		query_hash;		/* hash of the query text */
+	uint32		context_hash;	/* hash of the context string */
+} SharedPlanKey;
+
+typedef struct SharedPlanEntry
+{
+	SharedPlanKey key;			/* hash key of entry - MUST BE FIRST */
+	uint64		generation;		/* value of the global generation counter */
+	dsa_pointer data;			/* SharedPlanData in the DSA area */
+	pg_atomic_uint64 usage;		/* number of times the entry was used */
+} SharedPlanEntry;
+
+/* an invalidation counter a plan depends on, and its expected value */
+typedef struct SharedPlanDep
+{
+	uint32		slot;
+	uint32		counter;
+} SharedPlanDep;
+
+/*
+ * Variable-length part of the entry, stored in the DSA area.  The array of
+ * dependencies is followed by the query text, the context string and the
+ * serialized plan, each of them null-terminated.
+ */
+typedef struct SharedPlanData
+{
+	int			ndeps;
+	Size		query_len;
+	Size		context_len;
+	Size		plan_len;
+	SharedPlanDep deps[FLEXIBLE_ARRAY_MEMBER];
+} SharedPlanData;
+
+#define SharedPlanDataQuery(data) \
+	((char *) &(data)->deps[(data)->ndeps])
+#define SharedPlanDataContext(data) \
+	(SharedPlanDataQuery(data) + (data)->query_len + 1)
+#define SharedPlanDataPlan(data) \
+	(SharedPlanDataContext(data) + (data)->context_len + 1)
+
+typedef struct SharedPlanCacheCtl
+{
+	pg_atomic_uint64 generation;	/* bumped when all plans are invalidated */
+	pg_atomic_uint32 counters[SHARED_PLAN_COUNTERS];
+
+	/* statistics, shown in pg_stat_shared_plan_cache */
+	pg_atomic_uint64 hits;		/* lookups that found a current plan */
+	pg_atomic_uint64 misses;	/* lookups that didn't */
+	pg_atomic_uint64 stores;	/* plans published */
+	pg_atomic_uint64 evictions; /* entries removed to make room */
+} SharedPlanCacheCtl;
+
+/* GUC parameter: size of the shared plan cache in kB, 0 disables it */
+int			shared_plan_cache_size = 0;
+
+static SharedPlanCacheCtl *SharedPlanCache = NULL;
+static HTAB *SharedPlanHash = NULL;
+static void *SharedPlanAreaPlace = NULL;
+
+/* this backend's attachment to the DSA area */
+static dsa_area *SharedPlanArea = NULL;
+
+
+static int
+shared_plan_max_entries(void)
+{
+	return Max(shared_plan_cache_size / SHARED_PLAN_KB_PER_ENTRY,
+			   SHARED_PLAN_MIN_ENTRIES);
+}
+
+static Size
+shared_plan_area_size(void)
+{
+	return Max((Size) shared_plan_cache_size * 1024, dsa_minimum_size());
+}
+
+/*
+ * Report shared-memory space needed by SharedPlanCacheShmemInit
+ */
+Size
+SharedPlanCacheShmemSize(void)
+{
+	Size		size;
+
+	if (shared_plan_cache_size <= 0)
+		return 0;
+
+	size = MAXALIGN(sizeof(SharedPlanCacheCtl));
+	size = add_size(size, hash_estimate_size(shared_plan_max_entries(),
+											 sizeof(SharedPlanEntry)));
+	size = add_size(size, shared_plan_area_size());
+
+	return size;
+}
+
+/*
+ * Allocate and initialize the shared plan cache, if enabled.
+ */
+void
+SharedPlanCacheShmemInit(void)
+{
+	HASHCTL		info;
+	bool		found;
+	int			i;
+
+	if (shared_plan_cache_size <= 0)
+		return;
+
+	SharedPlanCache = (SharedPlanCacheCtl *)
+		ShmemInitStruct("Shared Plan Cache", sizeof(SharedPlanCacheCtl),
+						&found);
+
+	if (!found)
+	{
+		pg_atomic_init_u64(&SharedPlanCache->generation, 0);
+		for (i = 0; i < SHARED_PLAN_COUNTERS; i++)
+			pg_atomic_init_u32(&SharedPlanCache->counters[i], 0);
+		pg_atomic_init_u64(&SharedPlanCache->hits, 0);
+		pg_atomic_init_u64(&SharedPlanCache->misses, 0);
+		pg_atomic_init_u64(&SharedPlanCache->stores, 0);
+		pg_atomic_init_u64(&SharedPlanCache->evictions, 0);
+	}
+
+	memset(&info, 0, sizeof(info));
+	info.keysize = sizeof(SharedPlanKey);
+	info.entrysize = sizeof(SharedPlanEntry);
+	SharedPlanHash = ShmemInitHash("Shared Plan Cache Hash",
+								   shared_plan_max_entries(),
+								   shared_plan_max_entries(),
+								   &info,
+								   HASH_ELEM | HASH_BLOBS);
+
+	SharedPlanAreaPlace = ShmemInitStruct("Shared Plan Cache Area",
+										  shared_plan_area_size(),
+										  &found);
+
+	if (!found)
+	{
+		dsa_area   *area;
+
+		/*
+		 * The creating process keeps its reference to the area forever, so
+		 * it's never released.  Backends attach to it on first use.
+		 */
+		area = dsa_create_in_place(SharedPlanAreaPlace,
+								   shared_plan_area_size(),
+								   LWTRANCHE_SHARED_PLAN_CACHE, NULL);
+		dsa_set_size_limit(area, shared_plan_area_size());
+	}
+}
+
+/*
+ * Attach to the DSA area, if not attached yet.
+ */
+static dsa_area *
+shared_plan_attach(void)
+{
+	if (SharedPlanArea == NULL)
+	{
+		MemoryContext oldcxt = MemoryContextSwitchTo(TopMemoryContext);
+
+		SharedPlanArea = dsa_attach_in_place(SharedPlanAreaPlace, NULL);
+		dsa_pin_mapping(SharedPlanArea);
+		on_shmem_exit(dsa_on_shmem_exit_release_in_place,
+					  PointerGetDatum(SharedPlanAreaPlace));
+
+		MemoryContextSwitchTo(oldcxt);
+	}
+
+	return SharedPlanArea;
+}
+
+/*
+ * Catalogs whose changes invalidate all plans in the plancache.  Each of them
+ * has a single counter, which all shared plans depend on.
+ */
+static const int shared_plan_sys_caches[] = {
+	NAMESPACEOID, OPEROID, AMOPOPID, FOREIGNSERVEROID, FOREIGNDATAWRAPPEROID
+};
+
+/*
+ * Invalidation counters for relations, PlanInvalItems and the catalogs above
+ * (with hashvalue zero).
+ */
+static inline uint32
+relation_slot(Oid relid)
+{
+	return DatumGetUInt32(hash_uint32((uint32) relid)) % SHARED_PLAN_COUNTERS;
+}
+
+static inline uint32
+invalitem_slot(int cacheid, uint32 hashvalue)
+{
+	return hash_combine((uint32) cacheid, hashvalue) % SHARED_PLAN_COUNTERS;
+}
+
+/*
+ * Build the context string for a plan source, covering everything (except
+ * the query text, database and role) that may affect the plan.
+ */
+static char *
+shared_plan_context(CachedPlanSource *plansource)
+{
+	StringInfoData buf;
+	List	   *search_path;
+	ListCell   *lc;
+	char	   *options;
+	int			i;
+
+	initStringInfo(&buf);
+
+	appendStringInfo(&buf, "options %d rls %d params",
+					 plansource->cursor_options, row_security ? 1 : 0);
+
+	for (i = 0; i < plansource->num_params; i++)
+		appendStringInfo(&buf, " %u", plansource->param_types[i]);
+
+	appendStringInfoString(&buf, " path");
+
+	search_path = fetch_search_path(true);
+	foreach(lc, search_path)
+		appendStringInfo(&buf, " %u", lfirst_oid(lc));
+	list_free(search_path);
+
+	options = GetPlannerConfigOptions();
+	appendStringInfo(&buf, " settings\n%s", options);
+	pfree(options);
+
+	return buf.data;
+}
+
+static void
+shared_plan_key(CachedPlanSource *plansource, const char *context,
+				SharedPlanKey *key)
+{
+	memset(key, 0, sizeof(SharedPlanKey));
+
+	key->dbid = MyDatabaseId;
+	key->userid = GetUserId();
+	key->query_hash = DatumGetUInt32(hash_any((const unsigned char *) plansource->query_string,
+											  strlen(plansource->query_string)));
+	key->context_hash = DatumGetUInt32(hash_any((const unsigned char *) context,
+												strlen(context)));
+}
+
+/*
+ * Check that the counters for all dependencies still have the expected
+ * values.
+ */
+static bool
+shared_plan_deps_current(uint64 generation, SharedPlanDep *deps, int ndeps)
+{
+	int			i;
+
+	if (pg_atomic_read_u64(&SharedPlanCache->generation) != generation)
+		return false;
+
+	for (i = 0; i < ndeps; i++)
+	{
+		if (pg_atomic_read_u32(&SharedPlanCache->counters[deps[i].slot]) !=
+			deps[i].counter)
+			return false;
+	}
+
+	return true;
+}
+
+static bool
+shared_plan_entry_current(dsa_area *area, SharedPlanEntry *entry)
+{
+	SharedPlanData *data = dsa_get_address(area, entry->data);
+
+	return shared_plan_deps_current(entry->generation, data->deps,
+									data->ndeps);
+}
+
+/*
+ * Remove an entry, including the data in the DSA area.  Caller must hold
+ * SharedPlanCacheLock exclusively.
+ */
+static void
+shared_plan_remove(dsa_area *area, SharedPlanEntry *entry)
+{
+	dsa_free(area, entry->data);
+	hash_search(SharedPlanHash, &entry->key, HASH_REMOVE, NULL);
+}
+
+static int
+entry_usage_cmp(const void *lhs, const void *rhs)
+{
+	uint64		l = pg_atomic_read_u64(&(*(SharedPlanEntry *const *) lhs)->usage);
+	uint64		r = pg_atomic_read_u64(&(*(SharedPlanEntry *const *) rhs)->usage);
+
+	if (l < r)
+		return -1;
+	else if (l > r)
+		return +1;
+	return 0;
+}
+
+/*
+ * Make room for new entries.  Caller must hold SharedPlanCacheLock
+ * exclusively.
+ *
+ * If there are any stale entries, we just discard all of them.  Otherwise we
+ * discard the least used SHARED_PLAN_EVICT_PERCENT entries, and halve usage
+ * counts of the remaining ones, so that plans that used to be popular can
+ * eventually be evicted too.
+ */
+static void
+shared_plan_evict(dsa_area *area)
+{
+	HASH_SEQ_STATUS hash_seq;
+	SharedPlanEntry **entries;
+	SharedPlanEntry *entry;
+	int			nentries = 0;
+	int			nstale = 0;
+	int			nvictims;
+	int			i;
+
+	entries = palloc(hash_get_num_entries(SharedPlanHash) *
+					 sizeof(SharedPlanEntry *));
+
+	hash_seq_init(&hash_seq, SharedPlanHash);
+	while ((entry = hash_seq_search(&hash_seq)) != NULL)
+	{
+		if (!shared_plan_entry_current(area, entry))
+		{
+			/* removing the just-returned entry is OK */
+			shared_plan_remove(area, entry);
+			nstale++;
+			pg_atomic_fetch_add_u64(&SharedPlanCache->evictions, 1);
+		}
+		else
+			entries[nentries++] = entry;
+	}
+
+	if (nstale > 0 || nentries == 0)
+	{
+		pfree(entries);
+		return;
+	}
+
+	qsort(entries, nentries, sizeof(SharedPlanEntry *), entry_usage_cmp);
+
+	nvictims = Max(1, nentries * SHARED_PLAN_EVICT_PERCENT / 100);
+
+	for (i = 0; i < nvictims; i++)
+		shared_plan_remove(area, entries[i]);
+	pg_atomic_fetch_add_u64(&SharedPlanCache->evictions, nvictims);
+
+	for (; i < nentries; i++)
+		pg_atomic_write_u64(&entries[i]->usage,
+							pg_atomic_read_u64(&entries[i]->usage) / 2);
+
+	pfree(entries);
+}
+
+/*
+ * Collect the invalidation counters the plans depend on, with values from
+ * the snapshot.  Returns -1 if the plans should not be shared at all.
+ */
+static int
+shared_plan_dependencies(List *stmt_list, SharedPlanSnapshot *snap,
+						 SharedPlanDep *deps)
+{
+	bool		seen[SHARED_PLAN_COUNTERS];
+	int			ndeps = 0;
+	ListCell   *lc;
+	int			i;
+
+	memset(seen, 0, sizeof(seen));
+
+	for (i = 0; i < lengthof(shared_plan_sys_caches); i++)
+	{
+		uint32		slot = invalitem_slot(shared_plan_sys_caches[i], 0);
+
+		if (!seen[slot])
+		{
+			seen[slot] = true;
+			deps[ndeps].slot = slot;
+			deps[ndeps].counter = snap->counters[slot];
+			ndeps++;
+		}
+	}
+
+	foreach(lc, stmt_list)
+	{
+		PlannedStmt *plannedstmt = lfirst_node(PlannedStmt, lc);
+		ListCell   *lc2;
+
+		/* transient plans are tied to our TransactionXmin */
+		if (plannedstmt->commandType == CMD_UTILITY ||
+			plannedstmt->transientPlan)
+			return -1;
+
+		foreach(lc2, plannedstmt->relationOids)
+		{
+			uint32		slot = relation_slot(lfirst_oid(lc2));
+
+			if (!seen[slot])
+			{
+				seen[slot] = true;
+				deps[ndeps].slot = slot;
+				deps[ndeps].counter = snap->counters[slot];
+				ndeps++;
+			}
+		}
+
+		foreach(lc2, plannedstmt->invalItems)
+		{
+			PlanInvalItem *item = (PlanInvalItem *) lfirst(lc2);
+			uint32		slot = invalitem_slot(item->cacheId, item->hashValue);
+
+			if (!seen[slot])
+			{
+				seen[slot] = true;
+				deps[ndeps].slot = slot;
+				deps[ndeps].counter = snap->counters[slot];
+				ndeps++;
+			}
+		}
+	}
+
+	return ndeps;
+}
+
+/*
+ * SharedPlanCacheEligible
+ *		Can the generic plan of this plan source be shared?
+ *
+ * The query list must be valid (i.e. after RevalidateCachedQuery).
+ */
+bool
+SharedPlanCacheEligible(CachedPlanSource *plansource,
+						QueryEnvironment *queryEnv)
+{
+	ListCell   *lc;
+
+	if (SharedPlanCache == NULL)
+		return false;
+
+	if (!plansource->is_saved || plansource->is_oneshot ||
+		plansource->raw_parse_tree == NULL)
+		return false;
+
+	/*
+	 * With parser hooks (e.g. PL/pgSQL variable references) or ephemeral
+	 * named relations, the query text alone does not determine the query.
+	 */
+	if (plansource->parserSetup != NULL || queryEnv != NULL)
+		return false;
+
+	foreach(lc, plansource->query_list)
+	{
+		Query	   *query = lfirst_node(Query, lc);
+
+		if (query->commandType == CMD_UTILITY)
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * SharedPlanCacheLookup
+ *		Look for a generic plan for the plan source, built by any backend.
+ *
+ * Returns the list of PlannedStmts, allocated in the caller's memory
+ * context, or NIL if there's no current plan in the cache.
+ */
+List *
+SharedPlanCacheLookup(CachedPlanSource *plansource)
+{
+	SharedPlanKey key;
+	SharedPlanEntry *entry;
+	dsa_area   *area;
+	char	   *context;
+	char	   *plan_str = NULL;
+	List	   *result = NIL;
+
+	Assert(SharedPlanCache != NULL);
+
+	area = shared_plan_attach();
+
+	context = shared_plan_context(plansource);
+	shared_plan_key(plansource, context, &key);
+
+	LWLockAcquire(SharedPlanCacheLock, LW_SHARED);
+
+	entry = (SharedPlanEntry *) hash_search(SharedPlanHash, &key,
+											HASH_FIND, NULL);
+
+	if (entry != NULL && shared_plan_entry_current(area, entry))
+	{
+		SharedPlanData *data = dsa_get_address(area, entry->data);
+
+		if (strcmp(SharedPlanDataQuery(data), plansource->query_string) == 0 &&
+			strcmp(SharedPlanDataContext(data), context) == 0)
+		{
+			plan_str = palloc(data->plan_len + 1);
+			memcpy(plan_str, SharedPlanDataPlan(data), data->plan_len + 1);
+
+			pg_atomic_fetch_add_u64(&entry->usage, 1);
+		}
+	}
+
+	LWLockRelease(SharedPlanCacheLock);
+
+	if (plan_str != NULL)
+	{
+		result = (List *) stringToNode(plan_str);
+		pfree(plan_str);
+		pg_atomic_fetch_add_u64(&SharedPlanCache->hits, 1);
+	}
+	else
+		pg_atomic_fetch_add_u64(&SharedPlanCache->misses, 1);
+
+	pfree(context);
+
+	return result;
+}
+
+/*
+ * SharedPlanCacheTakeSnapshot
+ *		Remember current values of the invalidation counters.
+ *
+ * This needs to happen before planning, so that invalidations processed by
+ * any backend while we're planning prevent the plan from being used.
+ */
+void
+SharedPlanCacheTakeSnapshot(SharedPlanSnapshot *snap)
+{
+	int			i;
+
+	Assert(SharedPlanCache != NULL);
+
+	snap->generation = pg_atomic_read_u64(&SharedPlanCache->generation);
+	for (i = 0; i < SHARED_PLAN_COUNTERS; i++)
+		snap->counters[i] = pg_atomic_read_u32(&SharedPlanCache->counters[i]);
+}
+
+/*
+ * SharedPlanCacheStore
+ *		Publish a generic plan built for the plan source.
+ *
+ * The snapshot must have been taken before the planning started.  Failing
+ * to store the plan (e.g. when we can't make room for it) is not an error.
+ */
+void
+SharedPlanCacheStore(CachedPlanSource *plansource, List *stmt_list,
+					 SharedPlanSnapshot *snap)
+{
+	SharedPlanKey key;
+	SharedPlanEntry *entry;
+	SharedPlanData *data;
+	SharedPlanDep *deps;
+	dsa_area   *area;
+	dsa_pointer dp;
+	char	   *context;
+	char	   *plan_str;
+	Size		query_len,
+				context_len,
+				plan_len,
+				size;
+	int			ndeps;
+	bool		found;
+
+	Assert(SharedPlanCache != NULL);
+
+	deps = palloc(SHARED_PLAN_COUNTERS * sizeof(SharedPlanDep));
+	ndeps = shared_plan_dependencies(stmt_list, snap, deps);
+
+	/*
+	 * If anything the plan depends on got invalidated since we took the
+	 * snapshot, the plan may be out of date already, so don't publish it.
+	 */
+	if (ndeps < 0 || !shared_plan_deps_current(snap->generation, deps, ndeps))
+	{
+		pfree(deps);
+		return;
+	}
+
+	area = shared_plan_attach();
+
+	context = shared_plan_context(plansource);
+	shared_plan_key(plansource, context, &key);
+	plan_str = nodeToString(stmt_list);
+
+	query_len = strlen(plansource->query_string);
+	context_len = strlen(context);
+	plan_len = strlen(plan_str);
+
+	size = offsetof(SharedPlanData, deps) + ndeps * sizeof(SharedPlanDep);
+	size = add_size(size, query_len + context_len + plan_len + 3);
+
+	LWLockAcquire(SharedPlanCacheLock, LW_EXCLUSIVE);
+
+	entry = (SharedPlanEntry *) hash_search(SharedPlanHash, &key,
+											HASH_FIND, NULL);
+	if (entry != NULL)
+	{
+		/* keep the existing entry, unless it's stale */
+		if (shared_plan_entry_current(area, entry))
+			goto done;
+
+		shared_plan_remove(area, entry);
+	}
+
+	dp = dsa_allocate_extended(area, size, DSA_ALLOC_NO_OOM);
+	if (!DsaPointerIsValid(dp))
+	{
+		shared_plan_evict(area);
+		dp = dsa_allocate_extended(area, size, DSA_ALLOC_NO_OOM);
+		if (!DsaPointerIsValid(dp))
+			goto done;
+	}
+
+	if (hash_get_num_entries(SharedPlanHash) >= shared_plan_max_entries())
+		shared_plan_evict(area);
+
+	entry = (SharedPlanEntry *) hash_search(SharedPlanHash, &key,
+											HASH_ENTER_NULL, &found);
+	if (entry == NULL)
+	{
+		dsa_free(area, dp);
+		goto done;
+	}
+	Assert(!found);
+
+	data = dsa_get_address(area, dp);
+	data->ndeps = ndeps;
+	data->query_len = query_len;
+	data->context_len = context_len;
+	data->plan_len = plan_len;
+	memcpy(data->deps, deps, ndeps * sizeof(SharedPlanDep));
+	memcpy(SharedPlanDataQuery(data), plansource->query_string, query_len + 1);
+	memcpy(SharedPlanDataContext(data), context, context_len + 1);
+	memcpy(SharedPlanDataPlan(data), plan_str, plan_len + 1);
+
+	entry->generation = snap->generation;
+	entry->data = dp;
+	pg_atomic_init_u64(&entry->usage, 1);
+
+	pg_atomic_fetch_add_u64(&SharedPlanCache->stores, 1);
+
+done:
+	LWLockRelease(SharedPlanCacheLock);
+
+	pfree(plan_str);
+	pfree(context);
+	pfree(deps);
+}
+
+/*
+ * SharedPlanCacheInvalMessages
+ *		Invalidate shared plans affected by invalidation messages sent at
+ *		commit.
+ *
+ * This is called by the committing backend, or by the startup process when
+ * replaying the commit, after the messages have been sent.
+ */
+void
+SharedPlanCacheInvalMessages(const SharedInvalidationMessage *msgs, int n)
+{
+	int			i;
+
+	if (SharedPlanCache == NULL)
+		return;
+
+	for (i = 0; i < n; i++)
+	{
+		const SharedInvalidationMessage *msg = &msgs[i];
+		int			j;
+
+		if (msg->id >= 0)
+		{
+			if (msg->cc.id == PROCOID)
+				pg_atomic_fetch_add_u32(&SharedPlanCache->counters[invalitem_slot(msg->cc.id, msg->cc.hashValue)], 1);
+			else
+			{
+				for (j = 0; j < lengthof(shared_plan_sys_caches); j++)
+				{
+					if (msg->cc.id == shared_plan_sys_caches[j])
+					{
+						pg_atomic_fetch_add_u32(&SharedPlanCache->counters[invalitem_slot(msg->cc.id, 0)], 1);
+						break;
+					}
+				}
+			}
+		}
+		else if (msg->id == SHAREDINVALRELCACHE_ID)
+		{
+			if (OidIsValid(msg->rc.relId))
+				pg_atomic_fetch_add_u32(&SharedPlanCache->counters[relation_slot(msg->rc.relId)], 1);
+			else
+				pg_atomic_fetch_add_u64(&SharedPlanCache->generation, 1);
+		}
+		else if (msg->id == SHAREDINVALCATALOG_ID)
+		{
+			/* all entries of some catalog's caches, e.g. after VACUUM FULL */
+			pg_atomic_fetch_add_u64(&SharedPlanCache->generation, 1);
+		}
+	}
+}
+
+/*
+ * Returns statistics of the shared plan cache.  All counters are zero when
+ * it's disabled.
+ */
+Datum
+pg_stat_get_shared_plan_cache(PG_FUNCTION_ARGS)
+{
+#define PG_STAT_GET_SHARED_PLAN_CACHE_COLS	5
+	TupleDesc	tupdesc;
+	Datum		values[PG_STAT_GET_SHARED_PLAN_CACHE_COLS];
+	bool		nulls[PG_STAT_GET_SHARED_PLAN_CACHE_COLS];
+	int64		entries = 0;
+	uint64		hits = 0;
+	uint64		misses = 0;
+	uint64		stores = 0;
+	uint64		evictions = 0;
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	if (SharedPlanCache != NULL)
+	{
+		LWLockAcquire(SharedPlanCacheLock, LW_SHARED);
+		entries = hash_get_num_entries(SharedPlanHash);
+		LWLockRelease(SharedPlanCacheLock);
+
+		hits = pg_atomic_read_u64(&SharedPlanCache->hits);
+		misses = pg_atomic_read_u64(&SharedPlanCache->misses);
+		stores = pg_atomic_read_u64(&SharedPlanCache->stores);
+		evictions = pg_atomic_read_u64(&SharedPlanCache->evictions);
+	}
+
+	MemSet(nulls, 0, sizeof(nulls));
+
+	values[0] = Int64GetDatum(entries);
+	values[1] = Int64GetDatum((int64) hits);
+	values[2] = Int64GetDatum((int64) misses);
+	values[3] = Int64GetDatum((int64) stores);
+	values[4] = Int64GetDatum((int64) evictions);
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
@@ -33,6 +33,8 @@
 #include "access/twophase.h"
 #include "access/xact.h"
 #include "access/xlog_internal.h"
+#include "access/xlogprefetch.h"
+#include "access/xlogredo.h"
 #include "catalog/namespace.h"
 #include "catalog/pg_authid.h"
 #include "commands/async.h"
@@ -41,6 +43,7 @@
 #include "commands/vacuum.h"
 #include "commands/variable.h"
 #include "commands/trigger.h"
+#include "executor/nodeNestloop.h"
 #include "funcapi.h"
 #include "libpq/auth.h"
 #include "libpq/libpq.h"
@@ -66,6 +69,7 @@
 #include "replication/syncrep.h"
 #include "replication/walreceiver.h"
 #include "replication/walsender.h"
+#include "storage/aio.h"
 #include "storage/bufmgr.h"
 #include "storage/dsm_impl.h"
 #include "storage/standby.h"
@@ -85,6 +89,7 @@
 #include "utils/portal.h"
 #include "utils/ps_status.h"
 #include "utils/rls.h"
+#include "utils/sharedplancache.h"
 #include "utils/snapmgr.h"
 #include "utils/tzparser.h"
 #include "utils/varlena.h"
@@ -150,6 +155,9 @@ static bool call_enum_check_hook(struct config_enum *conf, int *newval,
 static bool check_log_destination(char **newval, void **extra, GucSource source);
 static void assign_log_destination(const char *newval, void *extra);
 
+static bool check_io_direct(char **newval, void **extra, GucSource source);
+static void assign_io_direct(const char *newval, void *extra);
+
 static bool check_wal_consistency_checking(char **newval, void **extra,
 							   GucSource source);
 static void assign_wal_consistency_checking(const char *newval, void *extra);
@@ -166,6 +174,7 @@ static void assign_session_replication_role(int newval, void *extra);
 static bool check_temp_buffers(int *newval, void **extra, GucSource source);
 static bool check_bonjour(bool *newval, void **extra, GucSource source);
 static bool check_ssl(bool *newval, void **extra, GucSource source);
+static bool check_numa_buffers(bool *newval, void **extra, GucSource source);
 static bool check_stage_log_stats(bool *newval, void **extra, GucSource source);
 static bool check_log_stats(bool *newval, void **extra, GucSource source);
 static bool check_canonical_path(char **newval, void **extra, GucSource source);
@@ -185,6 +194,7 @@ static bool check_autovacuum_max_workers(int *newval, void **extra, GucSource so
 static bool check_autovacuum_work_mem(int *newval, void **extra, GucSource source);
 static bool check_effective_io_concurrency(int *newval, void **extra, GucSource source);
 static void assign_effective_io_concurrency(int newval, void *extra);
+static bool check_recovery_prefetch_distance(int *newval, void **extra, GucSource source);
 static void assign_pgstat_temp_directory(const char *newval, void *extra);
 static bool check_application_name(char **newval, void **extra, GucSource source);
 static void assign_application_name(const char *newval, void *extra);
@@ -373,6 +383,24 @@ static const struct config_enum_entry synchronous_commit_options[] = {
 	{NULL, 0, false}
 };
 
+/*
+ * "on" selects pglz, which is what the boolean wal_compression used.  We
+ * accept all the likely variants of "on" and "off".
+ */
+static const struct config_enum_entry wal_compression_options[] = {
+	{"pglz", WAL_COMPRESSION_PGLZ, false},
+	{"lz4", WAL_COMPRESSION_LZ4, false},
+	{"on", WAL_COMPRESSION_PGLZ, false},
+	{"off", WAL_COMPRESSION_NONE, false},
+	{"true", WAL_COMPRESSION_PGLZ, true},
+	{"false", WAL_COMPRESSION_NONE, true},
+	{"yes", WAL_COMPRESSION_PGLZ, true},
+	{"no", WAL_COMPRESSION_NONE, true},
+	{"1", WAL_COMPRESSION_PGLZ, true},
+	{"0", WAL_COMPRESSION_NONE, true},
+	{NULL, 0, false}
+};
+
 /*
  * Although only "on", "off", "try" are documented, we accept all the likely
  * variants of "on" and "off".
@@ -425,6 +453,8 @@ extern const struct config_enum_entry wal_level_options[];
 extern const struct config_enum_entry archive_mode_options[];
 extern const struct config_enum_entry sync_method_options[];
 extern const struct config_enum_entry dynamic_shared_memory_options[];
+extern const struct config_enum_entry io_method_options[];
+extern const struct config_enum_entry buffer_replacement_policy_options[];
 
 /*
  * GUC option variables that are exported from this module
@@ -507,6 +537,7 @@ static char *timezone_abbreviations_string;
 static char *XactIsoLevel_string;
 static char *data_directory;
 static char *session_authorization_string;
+static char *io_direct_string;
 static int	max_function_args;
 static int	max_index_keys;
 static int	max_identifier_length;
@@ -922,6 +953,24 @@ static struct config_bool ConfigureNamesBool[] =
 		false,
 		NULL, NULL, NULL
 	},
+	{
+		{"enable_partition_wise_agg", PGC_USERSET, QUERY_TUNING_METHOD,
+			gettext_noop("Enables partition-wise aggregation."),
+			NULL
+		},
+		&enable_partition_wise_agg,
+		false,
+		NULL, NULL, NULL
+	},
+	{
+		{"enable_eager_aggregate", PGC_USERSET, QUERY_TUNING_METHOD,
+			gettext_noop("Enables partial aggregation below joins."),
+			NULL
+		},
+		&enable_eager_aggregate,
+		false,
+		NULL, NULL, NULL
+	},
 	{
 		{"enable_parallel_append", PGC_USERSET, QUERY_TUNING_METHOD,
 			gettext_noop("Enables the planner's use of parallel append plans."),
@@ -950,6 +999,16 @@ static struct config_bool ConfigureNamesBool[] =
 		true,
 		NULL, NULL, NULL
 	},
+	{
+		{"analyze_merge_partition_stats", PGC_USERSET, QUERY_TUNING_OTHER,
+			gettext_noop("Builds statistics of partitioned tables from those of their partitions."),
+			gettext_noop("When enabled, ANALYZE merges the existing statistics "
+						 "of the partitions instead of sampling them again.")
+		},
+		&analyze_merge_partition_stats,
+		false,
+		NULL, NULL, NULL
+	},
 	{
 		/* Not for general use --- used by SET SESSION AUTHORIZATION */
 		{"is_superuser", PGC_INTERNAL, UNGROUPED,
@@ -1063,12 +1122,12 @@ static struct config_bool ConfigureNamesBool[] =
 	},
 
 	{
-		{"wal_compression", PGC_SUSET, WAL_SETTINGS,
-			gettext_noop("Compresses full-page writes written in WAL file."),
+		{"wal_group_flush", PGC_SUSET, WAL_SETTINGS,
+			gettext_noop("Lets one backend flush WAL on behalf of a group of waiting backends."),
 			NULL
 		},
-		&wal_compression,
-		false,
+		&wal_group_flush,
+		true,
 		NULL, NULL, NULL
 	},
 
@@ -1256,6 +1315,24 @@ static struct config_bool ConfigureNamesBool[] =
 		true,
 		NULL, NULL, NULL
 	},
+	{
+		{"numa_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Places shared buffers on the NUMA nodes of the machine."),
+			NULL
+		},
+		&numa_buffers,
+		false,
+		check_numa_buffers, NULL, NULL
+	},
+	{
+		{"bgwriter_evict", PGC_SIGHUP, RESOURCES_BGWRITER,
+			gettext_noop("Background writer evicts buffers to keep the free list filled."),
+			NULL
+		},
+		&bgwriter_evict,
+		false,
+		NULL, NULL, NULL
+	},
 	{
 		{"track_io_timing", PGC_SUSET, STATS_COLLECTOR,
 			gettext_noop("Collects timing statistics for database I/O activity."),
@@ -1897,6 +1974,17 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"compressed_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the amount of memory used to keep compressed copies of pages evicted from shared buffers."),
+			gettext_noop("0 disables the compressed buffer tier."),
+			GUC_UNIT_BLOCKS
+		},
+		&compressed_buffers,
+		0, 0, INT_MAX / 2,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"temp_buffers", PGC_USERSET, RESOURCES_MEM,
 			gettext_noop("Sets the maximum number of temporary buffers used by each session."),
@@ -1971,6 +2059,17 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"shared_plan_cache_size", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the amount of shared memory used to share generic plans between sessions."),
+			gettext_noop("Zero disables the shared plan cache."),
+			GUC_UNIT_KB
+		},
+		&shared_plan_cache_size,
+		0, 0, MAX_KILOBYTES,
+		NULL, NULL, NULL
+	},
+
 	/*
 	 * We use the hopefully-safely-small value of 100kB as the compiled-in
 	 * default for max_stack_depth.  InitializeGUCOptions will increase it if
@@ -2116,6 +2215,17 @@ static struct config_int ConfigureNamesInt[] =
 	},
 #endif
 
+	{
+		{"debug_buffer_nodes", PGC_POSTMASTER, DEVELOPER_OPTIONS,
+			gettext_noop("Divides shared buffers into this many buffer nodes, without placing them on NUMA nodes."),
+			gettext_noop("0 means not to divide them unless numa_buffers is set."),
+			GUC_NOT_IN_SAMPLE
+		},
+		&debug_buffer_nodes,
+		0, 0, MAX_BUFFER_NODES,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"statement_timeout", PGC_USERSET, CLIENT_CONN_STATEMENT,
 			gettext_noop("Sets the maximum allowed duration of any statement."),
@@ -2352,6 +2462,16 @@ static struct config_int ConfigureNamesInt[] =
 		check_wal_buffers, NULL, NULL
 	},
 
+	{
+		{"wal_insert_locks", PGC_POSTMASTER, WAL_SETTINGS,
+			gettext_noop("Sets the number of locks that allow WAL to be inserted concurrently."),
+			NULL
+		},
+		&wal_insert_locks,
+		8, 1, MAX_WAL_INSERT_LOCKS,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"wal_writer_delay", PGC_SIGHUP, WAL_SETTINGS,
 			gettext_noop("Time between WAL flushes performed in the WAL writer."),
@@ -2430,6 +2550,27 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"recovery_workers", PGC_POSTMASTER, WAL_SETTINGS,
+			gettext_noop("Number of worker processes used to replay WAL in parallel."),
+			gettext_noop("Zero replays all WAL in the startup process.")
+		},
+		&recovery_workers,
+		0, 0, MAX_RECOVERY_WORKERS,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"recovery_prefetch_distance", PGC_SIGHUP, WAL_SETTINGS,
+			gettext_noop("Sets how far ahead of replay to look for blocks to prefetch during recovery."),
+			gettext_noop("Zero disables prefetching."),
+			GUC_UNIT_BYTE
+		},
+		&recovery_prefetch_distance,
+		0, 0, INT_MAX,
+		check_recovery_prefetch_distance, NULL, NULL
+	},
+
 	{
 		{"extra_float_digits", PGC_USERSET, CLIENT_CONN_LOCALE,
 			gettext_noop("Sets the number of digits displayed for floating-point values."),
@@ -2525,6 +2666,30 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"io_workers",
+			PGC_POSTMASTER,
+			RESOURCES_ASYNCHRONOUS,
+			gettext_noop("Number of I/O worker processes, for io_method = worker."),
+			NULL,
+		},
+		&io_workers,
+		3, 1, MAX_IO_WORKERS,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"io_max_concurrency",
+			PGC_POSTMASTER,
+			RESOURCES_ASYNCHRONOUS,
+			gettext_noop("Maximum number of asynchronous I/Os each process can have in progress."),
+			NULL,
+		},
+		&io_max_concurrency,
+		32, 1, PGAIO_MAX_CONCURRENCY,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"max_worker_processes",
 			PGC_POSTMASTER,
@@ -3013,6 +3178,17 @@ static struct config_real ConfigureNamesReal[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"adaptive_nestloop_threshold", PGC_USERSET, QUERY_TUNING_OTHER,
+			gettext_noop("Sets the factor by which a nested loop's outer rows must "
+						 "exceed the estimate before it hashes its inner input."),
+			gettext_noop("Zero disables switching to hashing.")
+		},
+		&adaptive_nestloop_threshold,
+		0.0, 0.0, DBL_MAX,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"geqo_selection_bias", PGC_USERSET, QUERY_TUNING_GEQO,
 			gettext_noop("GEQO: selective pressure within the population."),
@@ -3676,6 +3852,17 @@ static struct config_string ConfigureNamesString[] =
 		check_cluster_name, NULL, NULL
 	},
 
+	{
+		{"io_direct", PGC_POSTMASTER, RESOURCES_DISK,
+			gettext_noop("Selects the kinds of files read and written with direct I/O."),
+			gettext_noop("Valid values are combinations of \"data\" and \"wal\"."),
+			GUC_LIST_INPUT
+		},
+		&io_direct_string,
+		"",
+		check_io_direct, assign_io_direct, NULL
+	},
+
 	{
 		{"wal_consistency_checking", PGC_SUSET, DEVELOPER_OPTIONS,
 			gettext_noop("Sets the WAL resource managers for which WAL consistency checks are done."),
@@ -3892,6 +4079,16 @@ static struct config_enum ConfigureNamesEnum[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"io_method", PGC_POSTMASTER, RESOURCES_ASYNCHRONOUS,
+			gettext_noop("Selects the method used for asynchronous I/O."),
+			NULL
+		},
+		&io_method,
+		IOMETHOD_SYNC, io_method_options,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"wal_sync_method", PGC_SIGHUP, WAL_SETTINGS,
 			gettext_noop("Selects the method used for forcing WAL updates to disk."),
@@ -3902,6 +4099,16 @@ static struct config_enum ConfigureNamesEnum[] =
 		NULL, assign_xlog_sync_method, NULL
 	},
 
+	{
+		{"wal_compression", PGC_SUSET, WAL_SETTINGS,
+			gettext_noop("Compresses full-page writes written in WAL file with the specified method."),
+			NULL
+		},
+		&wal_compression,
+		WAL_COMPRESSION_NONE, wal_compression_options,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"xmlbinary", PGC_USERSET, CLIENT_CONN_STATEMENT,
 			gettext_noop("Sets how binary values are to be encoded in XML."),
@@ -3923,6 +4130,16 @@ static struct config_enum ConfigureNamesEnum[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"buffer_replacement_policy", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Selects the algorithm used to choose shared buffers to evict."),
+			NULL
+		},
+		&buffer_replacement_policy,
+		BUFFER_REPLACEMENT_CLOCK, buffer_replacement_policy_options,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"huge_pages", PGC_POSTMASTER, RESOURCES_MEM,
 			gettext_noop("Use of huge pages on Linux or Windows."),
@@ -8389,6 +8606,101 @@ GetNumConfigOptions(void)
 	return num_guc_variables;
 }
 
+/*
+ * Does the setting have its built-in default value?
+ */
+static bool
+config_has_boot_value(struct config_generic *gconf)
+{
+	switch (gconf->vartype)
+	{
+		case PGC_BOOL:
+			{
+				struct config_bool *conf = (struct config_bool *) gconf;
+
+				return *conf->variable == conf->boot_val;
+			}
+		case PGC_INT:
+			{
+				struct config_int *conf = (struct config_int *) gconf;
+
+				return *conf->variable == conf->boot_val;
+			}
+		case PGC_REAL:
+			{
+				struct config_real *conf = (struct config_real *) gconf;
+
+				return *conf->variable == conf->boot_val;
+			}
+		case PGC_STRING:
+			{
+				struct config_string *conf = (struct config_string *) gconf;
+
+				if (*conf->variable == NULL || conf->boot_val == NULL)
+					return *conf->variable == NULL && conf->boot_val == NULL;
+				return strcmp(*conf->variable, conf->boot_val) == 0;
+			}
+		case PGC_ENUM:
+			{
+				struct config_enum *conf = (struct config_enum *) gconf;
+
+				return *conf->variable == conf->boot_val;
+			}
+	}
+	return false;
+}
+
+/*
+ * Return a palloc'd string describing the settings that may affect how a
+ * query text is parsed, folded and planned: "name=value" lines for those of
+ * them that don't have their built-in default value.  Sessions with equal
+ * strings interpret and plan a given query text the same way, so this is
+ * part of the key of plans shared between sessions.
+ *
+ * The settings are picked by group, which includes some that don't matter
+ * for planning; those only make sharing plans less likely.  Settings of
+ * extensions are included, as they may affect planner hooks.
+ */
+char *
+GetPlannerConfigOptions(void)
+{
+	StringInfoData buf;
+	int			i;
+
+	initStringInfo(&buf);
+
+	for (i = 0; i < num_guc_variables; i++)
+	{
+		struct config_generic *conf = guc_variables[i];
+		char	   *val;
+
+		switch (conf->group)
+		{
+			case RESOURCES_MEM:
+			case QUERY_TUNING_METHOD:
+			case QUERY_TUNING_COST:
+			case QUERY_TUNING_GEQO:
+			case QUERY_TUNING_OTHER:
+			case CLIENT_CONN_LOCALE:
+			case COMPAT_OPTIONS_PREVIOUS:
+			case COMPAT_OPTIONS_CLIENT:
+			case CUSTOM_OPTIONS:
+				break;
+			default:
+				continue;
+		}
+
+		if (config_has_boot_value(conf))
+			continue;
+
+		val = _ShowOption(conf, false);
+		appendStringInfo(&buf, "%s=%s\n", conf->name, val);
+		pfree(val);
+	}
+
+	return buf.data;
+}
+
 /*
  * show_config_by_name - equiv to SHOW X command but implemented as
  * a function.
@@ -10081,6 +10393,69 @@ assign_wal_consistency_checking(const char *newval, void *extra)
 	wal_consistency_checking = (bool *) extra;
 }
 
+static bool
+check_io_direct(char **newval, void **extra, GucSource source)
+{
+	char	   *rawstring;
+	List	   *elemlist;
+	ListCell   *l;
+	int			newflags = 0;
+	int		   *myextra;
+
+	/* Need a modifiable copy of string */
+	rawstring = pstrdup(*newval);
+
+	/* Parse string into list of identifiers */
+	if (!SplitIdentifierString(rawstring, ',', &elemlist))
+	{
+		/* syntax error in list */
+		GUC_check_errdetail("List syntax is invalid.");
+		pfree(rawstring);
+		list_free(elemlist);
+		return false;
+	}
+
+	foreach(l, elemlist)
+	{
+		char	   *tok = (char *) lfirst(l);
+
+		if (pg_strcasecmp(tok, "data") == 0)
+			newflags |= IO_DIRECT_DATA;
+		else if (pg_strcasecmp(tok, "wal") == 0)
+			newflags |= IO_DIRECT_WAL;
+		else
+		{
+			GUC_check_errdetail("Unrecognized key word: \"%s\".", tok);
+			pfree(rawstring);
+			list_free(elemlist);
+			return false;
+		}
+	}
+
+	pfree(rawstring);
+	list_free(elemlist);
+
+#if PG_O_DIRECT == 0
+	if (newflags != 0)
+	{
+		GUC_check_errdetail("Direct I/O is not supported on this platform.");
+		return false;
+	}
+#endif
+
+	myextra = (int *) guc_malloc(ERROR, sizeof(int));
+	*myextra = newflags;
+	*extra = (void *) myextra;
+
+	return true;
+}
+
+static void
+assign_io_direct(const char *newval, void *extra)
+{
+	io_direct_flags = *((int *) extra);
+}
+
 static bool
 check_log_destination(char **newval, void **extra, GucSource source)
 {
@@ -10215,6 +10590,19 @@ check_ssl(bool *newval, void **extra, GucSource source)
 	return true;
 }
 
+static bool
+check_numa_buffers(bool *newval, void **extra, GucSource source)
+{
+#ifndef USE_NUMA_BUFFERS
+	if (*newval)
+	{
+		GUC_check_errmsg("placing shared buffers on NUMA nodes is not supported by this build");
+		return false;
+	}
+#endif
+	return true;
+}
+
 static bool
 check_stage_log_stats(bool *newval, void **extra, GucSource source)
 {
@@ -10458,6 +10846,19 @@ assign_effective_io_concurrency(int newval, void *extra)
 #endif							/* USE_PREFETCH */
 }
 
+static bool
+check_recovery_prefetch_distance(int *newval, void **extra, GucSource source)
+{
+#ifndef USE_PREFETCH
+	if (*newval != 0)
+	{
+		GUC_check_errdetail("recovery_prefetch_distance must be set to 0 on platforms that lack posix_fadvise().");
+		return false;
+	}
+#endif							/* USE_PREFETCH */
+	return true;
+}
+
 static void
 assign_pgstat_temp_directory(const char *newval, void *extra)
 {
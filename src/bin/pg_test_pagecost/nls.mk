@@ -0,0 +1,4 @@
+# src/bin/pg_test_pagecost/nls.mk
+CATALOG_NAME     = pg_test_pagecost
+AVAIL_LANGUAGES  =
+GETTEXT_FILES    = pg_test_pagecost.c
@@ -0,0 +1,411 @@
+/*
+ *	pg_test_pagecost.c
+ *		compares the speed of sequential and random page reads, to suggest
+ *		a random_page_cost for the file system under test
+ */
+
+#include "postgres_fe.h"
+
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <signal.h>
+
+#include "getopt_long.h"
+
+
+/*
+ * put the temp file in the local directory
+ * unless the user specifies otherwise
+ */
+#define PAGECOST_FILENAME	"./pg_test_pagecost.out"
+
+#define LABEL_FORMAT		"        %-30s"
+/* translator: maintain alignment with LABEL_FORMAT */
+#define OPS_FORMAT			gettext_noop("%13.3f ops/sec  %8.2f usecs/op\n")
+#define USECS_SEC			1000000
+
+/* These are macros to avoid timing the function call overhead. */
+#ifndef WIN32
+#define START_TIMER \
+do { \
+	alarm_triggered = false; \
+	alarm(secs_per_test); \
+	gettimeofday(&start_t, NULL); \
+} while (0)
+#else
+/* WIN32 doesn't support alarm, so we create a thread and sleep there */
+#define START_TIMER \
+do { \
+	alarm_triggered = false; \
+	if (CreateThread(NULL, 0, process_alarm, NULL, 0, NULL) == \
+		INVALID_HANDLE_VALUE) \
+	{ \
+		fprintf(stderr, _("Could not create thread for alarm\n")); \
+		exit(1); \
+	} \
+	gettimeofday(&start_t, NULL); \
+} while (0)
+#endif
+
+#define STOP_TIMER	\
+do { \
+	gettimeofday(&stop_t, NULL); \
+} while (0)
+
+
+static const char *progname;
+
+static int	secs_per_test = 5;
+static int	file_size_mb = 512;
+static int	needs_unlink = 0;
+static char full_buf[BLCKSZ * 2],
+		   *buf,
+		   *filename = PAGECOST_FILENAME;
+static struct timeval start_t,
+			stop_t;
+static bool alarm_triggered = false;
+static bool cache_dropped = false;
+
+
+static void handle_args(int argc, char *argv[]);
+static void prepare_file(void);
+static double test_sequential(void);
+static double test_random(void);
+static void drop_cache(int fd);
+
+#ifndef WIN32
+static void process_alarm(int sig);
+#else
+static DWORD WINAPI process_alarm(LPVOID param);
+#endif
+static void signal_cleanup(int sig);
+
+static double print_elapse(struct timeval start_t, struct timeval stop_t,
+			 int ops);
+static void die(const char *str);
+
+
+int
+main(int argc, char *argv[])
+{
+	double		seq_usecs;
+	double		random_usecs;
+
+	set_pglocale_pgservice(argv[0], PG_TEXTDOMAIN("pg_test_pagecost"));
+	progname = get_progname(argv[0]);
+
+	handle_args(argc, argv);
+
+	/* Prevent leaving behind the test file */
+	pqsignal(SIGINT, signal_cleanup);
+	pqsignal(SIGTERM, signal_cleanup);
+#ifndef WIN32
+	pqsignal(SIGALRM, process_alarm);
+#endif
+#ifdef SIGHUP
+	/* Not defined on win32 */
+	pqsignal(SIGHUP, signal_cleanup);
+#endif
+
+	prepare_file();
+
+	printf(_("\nCompare %dkB page reads:\n"), BLCKSZ / 1024);
+
+	seq_usecs = test_sequential();
+	random_usecs = test_random();
+
+	unlink(filename);
+
+	if (!cache_dropped)
+		printf(_("\nThe operating system's cache could not be bypassed, so unless the test\n"
+				 "file is larger than the memory available for caching, these are the\n"
+				 "speeds of cached reads.\n"));
+
+	/* Random reads can't be cheaper than sequential ones in the model */
+	printf(_("\nSuggested setting for this file system:\n"));
+	printf(LABEL_FORMAT, "random_page_cost");
+	printf("%13.2f\n", Max(random_usecs / seq_usecs, 1.0));
+	printf(_("(with seq_page_cost = 1; see pg_calibrate_costs() for the CPU costs)\n"));
+
+	return 0;
+}
+
+static void
+handle_args(int argc, char *argv[])
+{
+	static struct option long_options[] = {
+		{"filename", required_argument, NULL, 'f'},
+		{"size", required_argument, NULL, 'S'},
+		{"secs-per-test", required_argument, NULL, 's'},
+		{NULL, 0, NULL, 0}
+	};
+
+	int			option;			/* Command line option */
+	int			optindex = 0;	/* used by getopt_long */
+
+	if (argc > 1)
+	{
+		if (strcmp(argv[1], "--help") == 0 || strcmp(argv[1], "-?") == 0)
+		{
+			printf(_("Usage: %s [-f FILENAME] [-S SIZE-MB] [-s SECS-PER-TEST]\n"), progname);
+			exit(0);
+		}
+		if (strcmp(argv[1], "--version") == 0 || strcmp(argv[1], "-V") == 0)
+		{
+			puts("pg_test_pagecost (PostgreSQL) " PG_VERSION);
+			exit(0);
+		}
+	}
+
+	while ((option = getopt_long(argc, argv, "f:S:s:",
+								 long_options, &optindex)) != -1)
+	{
+		switch (option)
+		{
+			case 'f':
+				filename = strdup(optarg);
+				break;
+
+			case 'S':
+				file_size_mb = atoi(optarg);
+				break;
+
+			case 's':
+				secs_per_test = atoi(optarg);
+				break;
+
+			default:
+				fprintf(stderr, _("Try \"%s --help\" for more information.\n"),
+						progname);
+				exit(1);
+				break;
+		}
+	}
+
+	if (argc > optind)
+	{
+		fprintf(stderr,
+				_("%s: too many command-line arguments (first is \"%s\")\n"),
+				progname, argv[optind]);
+		fprintf(stderr, _("Try \"%s --help\" for more information.\n"),
+				progname);
+		exit(1);
+	}
+
+	if (file_size_mb <= 0 || secs_per_test <= 0)
+	{
+		fprintf(stderr,
+				_("%s: size and seconds per test must be positive integers\n"),
+				progname);
+		fprintf(stderr, _("Try \"%s --help\" for more information.\n"),
+				progname);
+		exit(1);
+	}
+
+	printf(ngettext("%d second per test\n",
+					"%d seconds per test\n",
+					secs_per_test),
+		   secs_per_test);
+	printf(_("%d MB test file\n"), file_size_mb);
+}
+
+static void
+prepare_file(void)
+{
+	int			tmpfile,
+				ops;
+	int			nblocks = file_size_mb * (1024 * 1024 / BLCKSZ);
+
+	/* write random data into buffer, so that compression can't help */
+	for (ops = 0; ops < BLCKSZ * 2; ops++)
+		full_buf[ops] = random();
+
+	buf = (char *) TYPEALIGN(BLCKSZ, full_buf);
+
+	if ((tmpfile = open(filename, O_RDWR | O_CREAT | PG_BINARY,
+						S_IRUSR | S_IWUSR)) == -1)
+		die("could not open output file");
+	needs_unlink = 1;
+
+	for (ops = 0; ops < nblocks; ops++)
+	{
+		/* make every page different */
+		*(int *) buf = ops;
+		if (write(tmpfile, buf, BLCKSZ) != BLCKSZ)
+			die("write failed");
+	}
+
+	/* fsync now so that dirty buffers don't skew the tests */
+	if (fsync(tmpfile) != 0)
+		die("fsync failed");
+
+	close(tmpfile);
+}
+
+/*
+ * Read the file from start to end, and wrap around if there's time left.
+ * Returns the microseconds per read.
+ */
+static double
+test_sequential(void)
+{
+	int			tmpfile,
+				ops;
+
+	printf(LABEL_FORMAT, _("sequential reads"));
+	fflush(stdout);
+
+	if ((tmpfile = open(filename, O_RDONLY | PG_BINARY, 0)) == -1)
+		die("could not open output file");
+	drop_cache(tmpfile);
+
+	START_TIMER;
+	for (ops = 0; alarm_triggered == false; ops++)
+	{
+		int			rc = read(tmpfile, buf, BLCKSZ);
+
+		if (rc == 0)
+		{
+			drop_cache(tmpfile);
+			if (lseek(tmpfile, 0, SEEK_SET) == -1)
+				die("seek failed");
+			ops--;
+			continue;
+		}
+		if (rc != BLCKSZ)
+			die("read failed");
+	}
+	STOP_TIMER;
+	close(tmpfile);
+
+	return print_elapse(start_t, stop_t, ops);
+}
+
+/*
+ * Read pages in random order.  Returns the microseconds per read.
+ *
+ * Each page is read once, in a shuffled order, so that no read is served
+ * from the kernel's cache of an earlier one.  If there's time left after
+ * the whole file, the cache is dropped and the same order is read again,
+ * like test_sequential() wraps around.
+ */
+static double
+test_random(void)
+{
+	int			tmpfile,
+				ops;
+	int			nblocks = file_size_mb * (1024 * 1024 / BLCKSZ);
+	int		   *order;
+	int			i;
+
+	printf(LABEL_FORMAT, _("random reads"));
+	fflush(stdout);
+
+	order = malloc(nblocks * sizeof(int));
+	if (order == NULL)
+		die("could not allocate memory");
+	for (i = 0; i < nblocks; i++)
+		order[i] = i;
+	for (i = nblocks - 1; i > 0; i--)
+	{
+		int			j = random() % (i + 1);
+		int			tmp = order[i];
+
+		order[i] = order[j];
+		order[j] = tmp;
+	}
+
+	if ((tmpfile = open(filename, O_RDONLY | PG_BINARY, 0)) == -1)
+		die("could not open output file");
+	drop_cache(tmpfile);
+
+	START_TIMER;
+	for (ops = 0, i = 0; alarm_triggered == false; ops++, i++)
+	{
+		off_t		offset;
+
+		if (i == nblocks)
+		{
+			drop_cache(tmpfile);
+			i = 0;
+		}
+
+		offset = (off_t) order[i] * BLCKSZ;
+		if (lseek(tmpfile, offset, SEEK_SET) == -1)
+			die("seek failed");
+		if (read(tmpfile, buf, BLCKSZ) != BLCKSZ)
+			die("read failed");
+	}
+	STOP_TIMER;
+	close(tmpfile);
+	free(order);
+
+	return print_elapse(start_t, stop_t, ops);
+}
+
+/*
+ * Ask the kernel to forget the cached pages of the file, if we can.
+ */
+static void
+drop_cache(int fd)
+{
+#if defined(USE_POSIX_FADVISE) && defined(POSIX_FADV_DONTNEED)
+	if (posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0)
+		cache_dropped = true;
+#endif
+}
+
+static void
+signal_cleanup(int signum)
+{
+	/* Delete the file if it exists. Ignore errors */
+	if (needs_unlink)
+		unlink(filename);
+	/* Finish incomplete line on stdout */
+	puts("");
+	exit(signum);
+}
+
+/*
+ * print out the reads per second for tests, and return the microseconds
+ * per operation
+ */
+static double
+print_elapse(struct timeval start_t, struct timeval stop_t, int ops)
+{
+	double		total_time = (stop_t.tv_sec - start_t.tv_sec) +
+	(stop_t.tv_usec - start_t.tv_usec) * 0.000001;
+	double		per_second = ops / total_time;
+	double		avg_op_time_us = (total_time / ops) * USECS_SEC;
+
+	printf(_(OPS_FORMAT), per_second, avg_op_time_us);
+
+	return avg_op_time_us;
+}
+
+#ifndef WIN32
+static void
+process_alarm(int sig)
+{
+	alarm_triggered = true;
+}
+#else
+static DWORD WINAPI
+process_alarm(LPVOID param)
+{
+	/* WIN32 doesn't support alarm, so we create a thread and sleep here */
+	Sleep(secs_per_test * 1000);
+	alarm_triggered = true;
+	ExitThread(0);
+}
+#endif
+
+static void
+die(const char *str)
+{
+	fprintf(stderr, _("%s: %s\n"), _(str), strerror(errno));
+	exit(1);
+}
@@ -0,0 +1,348 @@
+/* ----------
+ * pg_lz4.c -
+ *
+ *		This is an implementation of the LZ4 block format for PostgreSQL,
+ *		used to compress full-page images in WAL.  It trades some
+ *		compression ratio against pglz for being several times faster,
+ *		both compressing and decompressing, which matters when compression
+ *		happens on every WAL insertion.  It doesn't depend on liblz4; the
+ *		output is a plain LZ4 block, without the frame format around it.
+ *
+ *		Entry routines:
+ *
+ *			int32
+ *			pg_lz4_compress(const char *source, int32 slen, char *dest,
+ *							int32 dcap);
+ *
+ *				source is the input data to be compressed, at most
+ *					PG_LZ4_MAX_INPUT bytes.
+ *
+ *				dest is the output area for the compressed result, with
+ *					room for dcap bytes.  If dcap is at least
+ *					PG_LZ4_MAX_OUTPUT(slen), compression can't fail.
+ *					Otherwise compression gives up as soon as the output
+ *					would exceed dcap, which is cheaper than compressing
+ *					everything just to find out it didn't help.
+ *
+ *				The return value is the number of bytes written in the
+ *				buffer dest, or -1 if compression fails; in the latter
+ *				case the contents of dest are undefined.
+ *
+ *			int32
+ *			pg_lz4_decompress(const char *source, int32 slen, char *dest,
+ *							  int32 rawsize)
+ *
+ *				source is the compressed input, of slen bytes.
+ *
+ *				dest is the area where exactly rawsize bytes of
+ *					uncompressed data are written to.
+ *
+ *				The return value is rawsize, or -1 if the input is corrupt
+ *				or doesn't decompress to exactly rawsize bytes.  The input
+ *				is fully checked, and nothing is ever written outside
+ *				dest.
+ *
+ *		The data format:
+ *
+ *			The compressed data is a series of sequences, each consisting
+ *			of a run of literal bytes followed by a match, a copy of earlier
+ *			output.  A sequence starts with a token byte, whose high four
+ *			bits are the literal length and low four bits the match length
+ *			minus 4.  A value of 15 in either means that more length bytes
+ *			follow, each of which is added to the length, until one that
+ *			isn't 255.  The literal length bytes come right after the token,
+ *			followed by the literals, a 2-byte little endian offset back
+ *			into the output where the match is copied from, and finally the
+ *			match length bytes.
+ *
+ *			The last sequence has only literals.  As in LZ4, the last 5
+ *			bytes are always literals, and no match starts within the last
+ *			12 bytes.  The decompressor doesn't rely on that, but it keeps
+ *			the output readable by other LZ4 decoders.
+ *
+ *		The compression algorithm:
+ *
+ *			A hash table maps the hash of 4 bytes of input to the last
+ *			position those bytes were seen.  At each position we look up
+ *			the 4 bytes there, and if they match at the remembered position
+ *			we extend the match as far as it goes, backwards as well as
+ *			forwards, and emit a sequence.  Otherwise we move on, taking
+ *			larger steps the longer we go without finding a match, so that
+ *			incompressible data is skipped over quickly.  There is no
+ *			search for the best match; the first one is taken.
+ *
+ * Portions Copyright (c) 1996-2018, PostgreSQL Global Development Group
+ *
+ * src/common/pg_lz4.c
+ * ----------
+ */
+#ifndef FRONTEND
+#include "postgres.h"
+#else
+#include "postgres_fe.h"
+#endif
+
+#include "common/pg_lz4.h"
+
+
+#define LZ4_MIN_MATCH		4	/* shortest match */
+#define LZ4_LAST_LITERALS	5	/* bytes at the end that are always literal */
+#define LZ4_MF_LIMIT		12	/* no match starts within this many bytes of
+								 * the end */
+#define LZ4_MAX_OFFSET		65535
+
+#define LZ4_HASH_BITS		12
+#define LZ4_HASH_SIZE		(1 << LZ4_HASH_BITS)
+
+/* One more step for every this-many positions without a match */
+#define LZ4_SKIP_TRIGGER	6
+
+
+static inline uint32
+lz4_read32(const unsigned char *p)
+{
+	uint32		v;
+
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint32
+lz4_hash(uint32 seq)
+{
+	return (seq * 2654435761U) >> (32 - LZ4_HASH_BITS);
+}
+
+/*
+ * Append a length of 15 or more: the part in the token is 15 already, and
+ * the rest follows in bytes of up to 255.
+ */
+static inline unsigned char *
+lz4_put_length(unsigned char *op, int32 len)
+{
+	len -= 15;
+	while (len >= 255)
+	{
+		*op++ = 255;
+		len -= 255;
+	}
+	*op++ = (unsigned char) len;
+	return op;
+}
+
+/*
+ * Append a sequence of litlen literals starting at lit, followed by a match
+ * of matchlen bytes at the given offset, or no match if matchlen is 0.
+ * Returns NULL if it doesn't fit before oend.
+ */
+static unsigned char *
+lz4_put_sequence(unsigned char *op, unsigned char *oend,
+				 const unsigned char *lit, int32 litlen,
+				 int32 offset, int32 matchlen)
+{
+	unsigned char *token;
+
+	/* worst case: token, length bytes, literals and offset */
+	if (oend - op < 1 + litlen / 255 + 1 + litlen + 2 + matchlen / 255 + 1)
+		return NULL;
+
+	token = op++;
+	if (litlen >= 15)
+	{
+		*token = 15 << 4;
+		op = lz4_put_length(op, litlen);
+	}
+	else
+		*token = (unsigned char) (litlen << 4);
+	memcpy(op, lit, litlen);
+	op += litlen;
+
+	if (matchlen > 0)
+	{
+		*op++ = (unsigned char) (offset & 0xff);
+		*op++ = (unsigned char) (offset >> 8);
+
+		matchlen -= LZ4_MIN_MATCH;
+		if (matchlen >= 15)
+		{
+			*token |= 15;
+			op = lz4_put_length(op, matchlen);
+		}
+		else
+			*token |= (unsigned char) matchlen;
+	}
+
+	return op;
+}
+
+/* ----------
+ * pg_lz4_compress -
+ *
+ *		Compresses source into dest.  Returns the number of bytes written
+ *		in dest, or -1 if the output didn't fit in dcap bytes.
+ * ----------
+ */
+int32
+pg_lz4_compress(const char *source, int32 slen, char *dest, int32 dcap)
+{
+	uint16		hashtab[LZ4_HASH_SIZE];
+	const unsigned char *src = (const unsigned char *) source;
+	const unsigned char *send = src + slen;
+	const unsigned char *ip = src;
+	const unsigned char *anchor = src;
+	unsigned char *op = (unsigned char *) dest;
+	unsigned char *oend = op + dcap;
+
+	if (slen < 0 || slen > PG_LZ4_MAX_INPUT || dcap < 0)
+		return -1;
+
+	/* Too short for any match?  Then it's all literals. */
+	if (slen > LZ4_MF_LIMIT)
+	{
+		const unsigned char *mflimit = send - LZ4_MF_LIMIT;
+		const unsigned char *matchlimit = send - LZ4_LAST_LITERALS;
+		int32		misses = 0;
+
+		memset(hashtab, 0, sizeof(hashtab));
+		ip++;
+
+		while (ip <= mflimit)
+		{
+			uint32		seq = lz4_read32(ip);
+			uint32		h = lz4_hash(seq);
+			const unsigned char *ref = src + hashtab[h];
+			const unsigned char *mp;
+
+			hashtab[h] = (uint16) (ip - src);
+
+			if (ref >= ip || ip - ref > LZ4_MAX_OFFSET ||
+				lz4_read32(ref) != seq)
+			{
+				ip += 1 + (misses++ >> LZ4_SKIP_TRIGGER);
+				continue;
+			}
+			misses = 0;
+
+			/* Extend the match backwards over pending literals ... */
+			while (ip > anchor && ref > src && ip[-1] == ref[-1])
+			{
+				ip--;
+				ref--;
+			}
+
+			/* ... and forwards, as far as the last literals */
+			mp = ip + LZ4_MIN_MATCH;
+			ref += LZ4_MIN_MATCH;
+			while (mp < matchlimit && *mp == *ref)
+			{
+				mp++;
+				ref++;
+			}
+
+			op = lz4_put_sequence(op, oend, anchor, (int32) (ip - anchor),
+								  (int32) (mp - ref), (int32) (mp - ip));
+			if (op == NULL)
+				return -1;
+
+			ip = anchor = mp;
+
+			/* Remember a position inside the match, too */
+			if (ip <= mflimit)
+				hashtab[lz4_hash(lz4_read32(ip - 2))] = (uint16) (ip - 2 - src);
+		}
+	}
+
+	/* The rest is literals */
+	op = lz4_put_sequence(op, oend, anchor, (int32) (send - anchor), 0, 0);
+	if (op == NULL)
+		return -1;
+
+	return (int32) (op - (unsigned char *) dest);
+}
+
+/* ----------
+ * pg_lz4_decompress -
+ *
+ *		Decompresses source into dest.  Returns rawsize, or -1 if the
+ *		compressed data is corrupt.
+ * ----------
+ */
+int32
+pg_lz4_decompress(const char *source, int32 slen, char *dest, int32 rawsize)
+{
+	const unsigned char *ip = (const unsigned char *) source;
+	const unsigned char *iend = ip + slen;
+	unsigned char *op = (unsigned char *) dest;
+	unsigned char *oend = op + rawsize;
+
+	while (ip < iend)
+	{
+		int32		token = *ip++;
+		int32		litlen = token >> 4;
+		int32		matchlen = token & 15;
+		int32		offset;
+		unsigned char b;
+
+		/* literals */
+		if (litlen == 15)
+		{
+			do
+			{
+				if (ip >= iend)
+					return -1;
+				b = *ip++;
+				litlen += b;
+			} while (b == 255);
+		}
+		if (litlen > iend - ip || litlen > oend - op)
+			return -1;
+		memcpy(op, ip, litlen);
+		op += litlen;
+		ip += litlen;
+
+		/* the last sequence has no match */
+		if (ip >= iend)
+			break;
+
+		/* match */
+		if (iend - ip < 2)
+			return -1;
+		offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (offset == 0 || offset > op - (unsigned char *) dest)
+			return -1;
+
+		if (matchlen == 15)
+		{
+			do
+			{
+				if (ip >= iend)
+					return -1;
+				b = *ip++;
+				matchlen += b;
+			} while (b == 255);
+		}
+		matchlen += LZ4_MIN_MATCH;
+		if (matchlen > oend - op)
+			return -1;
+
+		if (offset >= matchlen)
+		{
+			memcpy(op, op - offset, matchlen);
+			op += matchlen;
+		}
+		else
+		{
+			/* overlapping copy, a repeated pattern */
+			const unsigned char *ref = op - offset;
+
+			while (matchlen-- > 0)
+				*op++ = *ref++;
+		}
+	}
+
+	if (op != oend)
+		return -1;
+
+	return rawsize;
+}
@@ -26,12 +26,19 @@
  * If current_buf isn't InvalidBuffer, then we are holding an extra pin
  * on that buffer.
  *
+ * When we extend the relation, we add many pages at a time; next_free ..
+ * last_free are the ones we haven't used yet, or InvalidBlockNumber if none
+ * are left.  extend_blocks is how many pages to add the next time.
+ *
  * "typedef struct BulkInsertStateData *BulkInsertState" is in heapam.h
  */
 typedef struct BulkInsertStateData
 {
 	BufferAccessStrategy strategy;	/* our BULKWRITE strategy object */
 	Buffer		current_buf;	/* current insertion target page */
+	BlockNumber next_free;		/* next page added in bulk to use */
+	BlockNumber last_free;		/* last page added in bulk */
+	BlockNumber extend_blocks;	/* number of pages to extend by next */
 }			BulkInsertStateData;
 
 
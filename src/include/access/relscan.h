@@ -19,6 +19,7 @@
 #include "access/htup_details.h"
 #include "access/itup.h"
 #include "access/tupdesc.h"
+#include "storage/read_stream.h"
 #include "storage/spin.h"
 
 /*
@@ -73,6 +74,12 @@ typedef struct HeapScanDescData
 	/* NB: if rs_cbuf is not InvalidBuffer, we hold a pin on that buffer */
 	ParallelHeapScanDesc rs_parallel;	/* parallel scan information */
 
+	/* read-ahead state of forward scans, see heap_scan_begin_stream */
+	ReadStream *rs_read_stream; /* stream of pages to scan, or NULL */
+	Buffer		rs_nextbuf;		/* page taken from the stream, not yet used */
+	BlockNumber rs_stream_block;	/* next page for the stream to return */
+	BlockNumber rs_stream_left; /* number of pages it has left to return */
+
 	/* these fields only used in page-at-a-time mode and for bitmap scans */
 	int			rs_cindex;		/* current tuple's index in vistuples */
 	int			rs_ntuples;		/* number of visible tuples on page */
@@ -93,22 +93,37 @@ extern PGDLLIMPORT XLogRecPtr XactLastCommitEnd;
 
 extern bool reachedConsistency;
 
+/*
+ * Upper limit for wal_insert_locks.  Some operations hold all of them at
+ * once, and may take other LWLocks meanwhile, so this must stay well below
+ * MAX_SIMUL_LWLOCKS (200).
+ */
+#define MAX_WAL_INSERT_LOCKS	64
+
+/*
+ * Number of buckets in the histogram of WAL flush group sizes.  Bucket 0
+ * counts groups of one, and bucket n > 0 groups of 2^(n-1)+1 to 2^n members;
+ * the last bucket also counts all larger groups.
+ */
+#define NUM_WAL_FLUSH_GROUP_BUCKETS	9
+
 /* these variables are GUC parameters related to XLOG */
 extern int	wal_segment_size;
 extern int	min_wal_size_mb;
 extern int	max_wal_size_mb;
 extern int	wal_keep_segments;
 extern int	XLOGbuffers;
+extern int	wal_insert_locks;
 extern int	XLogArchiveTimeout;
 extern int	wal_retrieve_retry_interval;
 extern char *XLogArchiveCommand;
 extern bool EnableHotStandby;
 extern bool fullPageWrites;
 extern bool wal_log_hints;
-extern bool wal_compression;
 extern bool *wal_consistency_checking;
 extern char *wal_consistency_checking_string;
 extern bool log_checkpoints;
+extern bool wal_group_flush;
 
 extern int	CheckPointSegments;
 
@@ -121,6 +136,15 @@ typedef enum ArchiveMode
 } ArchiveMode;
 extern int	XLogArchiveMode;
 
+/* Compression methods for full-page images */
+typedef enum WalCompression
+{
+	WAL_COMPRESSION_NONE = 0,
+	WAL_COMPRESSION_PGLZ,
+	WAL_COMPRESSION_LZ4
+} WalCompression;
+extern int	wal_compression;
+
 /* WAL levels */
 typedef enum WalLevel
 {
@@ -248,6 +272,7 @@ extern void GetXLogReceiptTime(TimestampTz *rtime, bool *fromStream);
 extern XLogRecPtr GetXLogReplayRecPtr(TimeLineID *replayTLI);
 extern XLogRecPtr GetXLogInsertRecPtr(void);
 extern XLogRecPtr GetXLogWriteRecPtr(void);
+extern void GetWalFlushGroupStats(uint64 *groups);
 extern bool RecoveryIsPaused(void);
 extern void SetRecoveryPause(bool recoveryPause);
 extern TimestampTz GetLatestXTime(void);
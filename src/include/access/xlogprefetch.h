@@ -0,0 +1,30 @@
+/*
+ * xlogprefetch.h
+ *
+ * Prefetching of blocks referenced by upcoming WAL records during recovery.
+ *
+ * Portions Copyright (c) 1996-2018, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/access/xlogprefetch.h
+ */
+#ifndef XLOGPREFETCH_H
+#define XLOGPREFETCH_H
+
+#include "access/xlogreader.h"
+
+/* GUC variable */
+extern int	recovery_prefetch_distance;
+
+typedef struct XLogPrefetcher XLogPrefetcher;
+
+extern Size XLogPrefetchShmemSize(void);
+extern void XLogPrefetchShmemInit(void);
+
+/* in the startup process */
+extern XLogPrefetcher *XLogPrefetcherAllocate(int wal_segment_size);
+extern void XLogPrefetcherFree(XLogPrefetcher *prefetcher);
+extern void XLogPrefetcherReadAhead(XLogPrefetcher *prefetcher,
+						XLogReaderState *replay);
+
+#endif							/* XLOGPREFETCH_H */
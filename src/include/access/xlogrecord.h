@@ -115,9 +115,10 @@ typedef struct XLogRecordBlockHeader
  * present is BLCKSZ - the length of "hole" bytes.
  *
  * When wal_compression is enabled, a full page image which "hole" was
- * removed is additionally compressed using PGLZ compression algorithm.
- * This can reduce the WAL volume, but at some extra cost of CPU spent
- * on the compression during WAL logging. In this case, since the "hole"
+ * removed is additionally compressed using the PGLZ or LZ4 compression
+ * algorithm, as recorded in bimg_info for each image.  This can reduce the
+ * WAL volume, but at some extra cost of CPU spent on the compression during
+ * WAL logging. In this case, since the "hole"
  * length cannot be calculated by subtracting the number of page image bytes
  * from BLCKSZ, basically it needs to be stored as an extra information.
  * But when no "hole" exists, we can assume that the "hole" length is zero
@@ -148,6 +149,8 @@ typedef struct XLogRecordBlockImageHeader
 #define BKPIMAGE_IS_COMPRESSED		0x02	/* page image is compressed */
 #define BKPIMAGE_APPLY		0x04	/* page image should be restored during
 									 * replay */
+#define BKPIMAGE_COMPRESS_LZ4	0x08	/* compressed with LZ4 rather than
+										 * PGLZ, only with IS_COMPRESSED */
 
 /*
  * Extra header information used when page image has "hole" and
@@ -0,0 +1,48 @@
+/*
+ * xlogredo.h
+ *
+ * Parallel replay of WAL records by redo worker processes.
+ *
+ * Portions Copyright (c) 1996-2018, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/access/xlogredo.h
+ */
+#ifndef XLOGREDO_H
+#define XLOGREDO_H
+
+#include "access/xlogreader.h"
+#include "storage/block.h"
+#include "storage/relfilenode.h"
+
+/* upper limit for recovery_workers */
+#define MAX_RECOVERY_WORKERS		32
+
+/* How the startup process should replay a record */
+typedef enum
+{
+	REDO_SERIAL,				/* wait for the workers, then replay here */
+	REDO_LOCAL,					/* replay here without waiting */
+	REDO_DISPATCH				/* hand to a redo worker */
+} RedoDisposition;
+
+/* GUC variable */
+extern int	recovery_workers;
+
+extern Size ParallelRedoShmemSize(void);
+extern void ParallelRedoShmemInit(void);
+extern void ParallelRedoRegisterWorkers(void);
+
+/* in the startup process */
+extern RedoDisposition ParallelRedoClassify(XLogReaderState *record);
+extern bool ParallelRedoDispatch(XLogReaderState *record);
+extern bool ParallelRedoPending(void);
+extern bool ParallelRedoWaitAll(void);
+
+/* in a redo worker */
+extern bool AmRedoWorker(void);
+extern void ParallelRedoReportInvalidPage(RelFileNode node, ForkNumber forkno,
+							  BlockNumber blkno, bool present);
+extern void RedoWorkerMain(Datum main_arg) pg_attribute_noreturn();
+
+#endif							/* XLOGREDO_H */
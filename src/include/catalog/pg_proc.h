@@ -2835,6 +2835,27 @@ DESCR("I/O");
 DATA(insert OID = 3407 (  pg_dependencies_send	PGNSP PGUID 12 1 0 0 0 f f f f t f s s 1 0 17 "3402" _null_ _null_ _null_ _null_ _null_ pg_dependencies_send _null_ _null_ _null_ ));
 DESCR("I/O");
 
+DATA(insert OID = 3421 (  pg_mcv_list_in	PGNSP PGUID 12 1 0 0 0 f f f f t f i s 1 0 3419 "2275" _null_ _null_ _null_ _null_ _null_ pg_mcv_list_in _null_ _null_ _null_ ));
+DESCR("I/O");
+DATA(insert OID = 3422 (  pg_mcv_list_out	PGNSP PGUID 12 1 0 0 0 f f f f t f i s 1 0 2275 "3419" _null_ _null_ _null_ _null_ _null_ pg_mcv_list_out _null_ _null_ _null_ ));
+DESCR("I/O");
+DATA(insert OID = 3423 (  pg_mcv_list_recv	PGNSP PGUID 12 1 0 0 0 f f f f t f s s 1 0 3419 "2281" _null_ _null_ _null_ _null_ _null_ pg_mcv_list_recv _null_ _null_ _null_ ));
+DESCR("I/O");
+DATA(insert OID = 3424 (  pg_mcv_list_send	PGNSP PGUID 12 1 0 0 0 f f f f t f s s 1 0 17 "3419" _null_ _null_ _null_ _null_ _null_ pg_mcv_list_send _null_ _null_ _null_ ));
+DESCR("I/O");
+
+DATA(insert OID = 3429 (  pg_mcv_list_items PGNSP PGUID 12 1 1000 0 0 f f f f t t s s 1 0 2249 "3419" "{3419,23,1009,1000,701,701}" "{i,o,o,o,o,o}" "{mcv_list,index,values,nulls,frequency,base_frequency}" _null_ _null_ pg_mcv_list_items _null_ _null_ _null_ ));
+DESCR("details about MCV list items");
+
+DATA(insert OID = 3425 (  pg_histogram_in	PGNSP PGUID 12 1 0 0 0 f f f f t f i s 1 0 3420 "2275" _null_ _null_ _null_ _null_ _null_ pg_histogram_in _null_ _null_ _null_ ));
+DESCR("I/O");
+DATA(insert OID = 3426 (  pg_histogram_out	PGNSP PGUID 12 1 0 0 0 f f f f t f i s 1 0 2275 "3420" _null_ _null_ _null_ _null_ _null_ pg_histogram_out _null_ _null_ _null_ ));
+DESCR("I/O");
+DATA(insert OID = 3427 (  pg_histogram_recv	PGNSP PGUID 12 1 0 0 0 f f f f t f s s 1 0 3420 "2281" _null_ _null_ _null_ _null_ _null_ pg_histogram_recv _null_ _null_ _null_ ));
+DESCR("I/O");
+DATA(insert OID = 3428 (  pg_histogram_send	PGNSP PGUID 12 1 0 0 0 f f f f t f s s 1 0 17 "3420" _null_ _null_ _null_ _null_ _null_ pg_histogram_send _null_ _null_ _null_ ));
+DESCR("I/O");
+
 DATA(insert OID = 1928 (  pg_stat_get_numscans			PGNSP PGUID 12 1 0 0 0 f f f f t f s r 1 0 20 "26" _null_ _null_ _null_ _null_ _null_ pg_stat_get_numscans _null_ _null_ _null_ ));
 DESCR("statistics: number of scans done for table/index");
 DATA(insert OID = 1929 (  pg_stat_get_tuples_returned	PGNSP PGUID 12 1 0 0 0 f f f f t f s r 1 0 20 "26" _null_ _null_ _null_ _null_ _null_ pg_stat_get_tuples_returned _null_ _null_ _null_ ));
@@ -2885,6 +2906,12 @@ DATA(insert OID = 3099 (  pg_stat_get_wal_senders	PGNSP PGUID 12 1 10 0 0 f f f
 DESCR("statistics: information about currently active replication");
 DATA(insert OID = 3317 (  pg_stat_get_wal_receiver	PGNSP PGUID 12 1 0 0 0 f f f f f f s r 0 0 2249 "" "{23,25,3220,23,3220,23,1184,1184,3220,1184,25,25}" "{o,o,o,o,o,o,o,o,o,o,o,o}" "{pid,status,receive_start_lsn,receive_start_tli,received_lsn,received_tli,last_msg_send_time,last_msg_receipt_time,latest_end_lsn,latest_end_time,slot_name,conninfo}" _null_ _null_ pg_stat_get_wal_receiver _null_ _null_ _null_ ));
 DESCR("statistics: information about WAL receiver");
+DATA(insert OID = 4216 (  pg_stat_get_shared_plan_cache	PGNSP PGUID 12 1 0 0 0 f f f f f f v r 0 0 2249 "" "{20,20,20,20,20}" "{o,o,o,o,o}" "{entries,hits,misses,stores,evictions}" _null_ _null_ pg_stat_get_shared_plan_cache _null_ _null_ _null_ ));
+DESCR("statistics: information about the shared plan cache");
+DATA(insert OID = 4214 (  pg_stat_get_recovery_prefetch	PGNSP PGUID 12 1 0 0 0 f f f f f f v r 0 0 2249 "" "{20,20,20,20,20,23,23}" "{o,o,o,o,o,o,o}" "{prefetch,hit,skip_new,skip_fpw,skip_rep,wal_distance,block_distance}" _null_ _null_ pg_stat_get_recovery_prefetch _null_ _null_ _null_ ));
+DESCR("statistics: information about WAL prefetching in recovery");
+DATA(insert OID = 4215 (  pg_stat_get_wal_flush_groups	PGNSP PGUID 12 1 9 0 0 f f f f f t v r 0 0 2249 "" "{23,23,20}" "{o,o,o}" "{min_size,max_size,groups}" _null_ _null_ pg_stat_get_wal_flush_groups _null_ _null_ _null_ ));
+DESCR("statistics: histogram of WAL flush group sizes");
 DATA(insert OID = 6118 (  pg_stat_get_subscription	PGNSP PGUID 12 1 0 0 0 f f f f f f s r 1 0 2249 "26" "{26,26,26,23,3220,1184,1184,3220,1184}" "{i,o,o,o,o,o,o,o,o}" "{subid,subid,relid,pid,received_lsn,last_msg_send_time,last_msg_receipt_time,latest_end_lsn,latest_end_time}" _null_ _null_ pg_stat_get_subscription _null_ _null_ _null_ ));
 DESCR("statistics: information about subscription");
 DATA(insert OID = 2026 (  pg_backend_pid				PGNSP PGUID 12 1 0 0 0 f f f f t f s r 0 0 23 "" _null_ _null_ _null_ _null_ _null_ pg_backend_pid _null_ _null_ _null_ ));
@@ -5528,6 +5555,8 @@ DATA(insert OID = 3353 (  pg_ls_logdir				 PGNSP PGUID 12 10 20 0 0 f f f f t t
 DESCR("list files in the log directory");
 DATA(insert OID = 3354 (  pg_ls_waldir				 PGNSP PGUID 12 10 20 0 0 f f f f t t v s 0 0 2249 "" "{25,20,1184}" "{o,o,o}" "{name,size,modification}" _null_ _null_ pg_ls_waldir _null_ _null_ _null_ ));
 DESCR("list of files in the WAL directory");
+DATA(insert OID = 4213 (  pg_calibrate_costs			PGNSP PGUID 12 1 4 0 0 f f f f t t v u 2 0 2249 "2205 23" "{2205,23,19,25,701,701}" "{i,i,o,o,o,o}" "{relation,npages,tablespace,parameter,usecs,setting}" _null_ _null_ pg_calibrate_costs _null_ _null_ _null_ ));
+DESCR("measure the planner's cost parameters on a table");
 
 /* hash partitioning constraint function */
 DATA(insert OID = 5028 ( satisfies_hash_partition PGNSP PGUID 12 1 0 2276 0 f f f f f f i s 4 0 16 "26 23 23 2276" _null_ "{i,i,i,v}" _null_ _null_ _null_ satisfies_hash_partition _null_ _null_ _null_ ));
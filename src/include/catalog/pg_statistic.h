@@ -289,4 +289,19 @@ typedef FormData_pg_statistic *Form_pg_statistic;
  */
 #define STATISTIC_KIND_BOUNDS_HISTOGRAM  7
 
+/*
+ * A "distinct sketch" slot holds a HyperLogLog sketch of the non-null column
+ * values that ANALYZE looked at, hashed with the hash function of the
+ * type's default hash opclass.  staop is the equality operator of that
+ * opclass.  stavalues is not used and should be NULL.  stanumbers holds the
+ * 2^k registers of the sketch, followed by two extra members: the number of
+ * values that were hashed into it, and 1 if those were all of the table's
+ * values or 0 if they were a sample.  A sketch of the whole table is built by
+ * operations that read all of it, like CREATE INDEX and CLUSTER, and is kept
+ * up to date by adding ANALYZE's samples to it; stadistinct is then derived
+ * from it.  Sketches of different relations can be merged to estimate the
+ * number of distinct values in their union.
+ */
+#define STATISTIC_KIND_DISTINCT_SKETCH  8
+
 #endif							/* PG_STATISTIC_H */
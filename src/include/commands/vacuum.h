@@ -17,9 +17,12 @@
 #include "access/htup.h"
 #include "catalog/pg_statistic.h"
 #include "catalog/pg_type.h"
+#include "lib/hyperloglog.h"
 #include "nodes/parsenodes.h"
 #include "storage/buf.h"
+#include "storage/dsm.h"
 #include "storage/lock.h"
+#include "storage/shm_toc.h"
 #include "utils/relcache.h"
 
 
@@ -149,6 +152,7 @@ typedef struct VacuumParams
 
 /* GUC parameters */
 extern PGDLLIMPORT int default_statistics_target;	/* PGDLLIMPORT for PostGIS */
+extern bool analyze_merge_partition_stats;
 extern int	vacuum_freeze_min_age;
 extern int	vacuum_freeze_table_age;
 extern int	vacuum_multixact_freeze_min_age;
@@ -195,6 +199,19 @@ extern void analyze_rel(Oid relid, RangeVar *relation, int options,
 			VacuumParams *params, List *va_cols, bool in_outer_xact,
 			BufferAccessStrategy bstrategy);
 extern bool std_typanalyze(VacAttrStats *stats);
+extern void parallel_analyze_main(dsm_segment *seg, shm_toc *toc);
+extern bool fetch_distinct_sketch(HeapTuple statstuple,
+					  hyperLogLogState *sketch, double *nvalues,
+					  bool *wholetable);
+
+/* Opaque state for building distinct sketches during a full-table scan */
+typedef struct ColumnSketchState ColumnSketchState;
+
+extern ColumnSketchState *begin_column_sketches(Relation rel, int ncolumns,
+					  const AttrNumber *attnums);
+extern void add_column_sketches(ColumnSketchState *state,
+					Datum *values, bool *isnull);
+extern void end_column_sketches(ColumnSketchState *state);
 
 /* in utils/misc/sampling.c --- duplicate of declarations in utils/sampling.h */
 extern double anl_random_fract(void);
@@ -0,0 +1,42 @@
+/* ----------
+ * pg_lz4.h -
+ *
+ *	Definitions for the builtin LZ4 block format compressor
+ *
+ * src/include/common/pg_lz4.h
+ * ----------
+ */
+
+#ifndef _PG_LZ4_H_
+#define _PG_LZ4_H_
+
+
+/* ----------
+ * PG_LZ4_MAX_INPUT -
+ *
+ *		Largest input pg_lz4_compress() accepts.  Positions within the input
+ *		are kept in 16 bits, and LZ4 offsets can't exceed that anyway.
+ * ----------
+ */
+#define PG_LZ4_MAX_INPUT				65535
+
+/* ----------
+ * PG_LZ4_MAX_OUTPUT -
+ *
+ *		Macro to compute the size of incompressible input once compressed,
+ *		which is the buffer size needed for pg_lz4_compress() to never fail.
+ * ----------
+ */
+#define PG_LZ4_MAX_OUTPUT(_slen)		((_slen) + (_slen) / 255 + 16)
+
+
+/* ----------
+ * Global function declarations
+ * ----------
+ */
+extern int32 pg_lz4_compress(const char *source, int32 slen, char *dest,
+				int32 dcap);
+extern int32 pg_lz4_decompress(const char *source, int32 slen, char *dest,
+				  int32 rawsize);
+
+#endif							/* _PG_LZ4_H_ */
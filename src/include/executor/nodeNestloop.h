@@ -16,6 +16,9 @@
 
 #include "nodes/execnodes.h"
 
+/* GUC parameter */
+extern double adaptive_nestloop_threshold;
+
 extern NestLoopState *ExecInitNestLoop(NestLoop *node, EState *estate, int eflags);
 extern void ExecEndNestLoop(NestLoopState *node);
 extern void ExecReScanNestLoop(NestLoopState *node);
@@ -89,6 +89,9 @@ typedef struct PlannedStmt
 
 	List	   *invalItems;		/* other dependencies, as PlanInvalItems */
 
+	List	   *fkeyJoinRelOids;	/* OIDs of tables whose foreign keys let
+									 * the planner remove joins */
+
 	List	   *paramExecTypes; /* type OIDs for PARAM_EXEC Params */
 
 	Node	   *utilityStmt;	/* non-null if this is utility stmt */
@@ -680,12 +683,19 @@ typedef struct Join
  * Vars, but perhaps someday that'd be worth relaxing.  (Note: during plan
  * creation, the paramval can actually be a PlaceHolderVar expression; but it
  * must be a Var with varno OUTER_VAR by the time it gets to the executor.)
+ *
+ * If there are no nestParams, hashclauses lists the hashjoinable join
+ * clauses (which also appear in joinqual), commuted if necessary so that the
+ * outer relation's expression is on the left.  The executor may use them to
+ * switch to hashing the inner input when the outer input is much larger than
+ * estimated.
  * ----------------
  */
 typedef struct NestLoop
 {
 	Join		join;
 	List	   *nestParams;		/* list of NestLoopParam nodes */
+	List	   *hashclauses;	/* hashjoinable join clauses, outer on left */
 } NestLoop;
 
 typedef struct NestLoopParam
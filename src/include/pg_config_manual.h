@@ -109,6 +109,14 @@
  */
 #define ALIGNOF_BUFFER	32
 
+/*
+ * Alignment of buffers used for direct I/O (io_direct).  O_DIRECT transfers
+ * must start at memory addresses, and have file offsets and lengths, that
+ * are multiples of the device's logical block size; 4kB covers the common
+ * devices.
+ */
+#define PG_IO_ALIGN_SIZE	4096
+
 /*
  * Disable UNIX sockets for certain operating systems.
  */
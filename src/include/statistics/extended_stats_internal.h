@@ -44,6 +44,7 @@ typedef struct SortItem
 {
 	Datum	   *values;
 	bool	   *isnull;
+	int			count;
 } SortItem;
 
 extern MVNDistinct *statext_ndistinct_build(double totalrows,
@@ -57,6 +58,19 @@ extern MVDependencies *statext_dependencies_build(int numrows, HeapTuple *rows,
 extern bytea *statext_dependencies_serialize(MVDependencies *dependencies);
 extern MVDependencies *statext_dependencies_deserialize(bytea *data);
 
+extern MVMCVList *statext_mcv_build(int numrows, HeapTuple *rows,
+				  Bitmapset *attrs, VacAttrStats **stats,
+				  double totalrows);
+extern bytea *statext_mcv_serialize(MVMCVList *mcvlist, VacAttrStats **stats);
+extern MVMCVList *statext_mcv_deserialize(bytea *data);
+
+extern MVHistogram *statext_histogram_build(int numrows, HeapTuple *rows,
+						Bitmapset *attrs, VacAttrStats **stats,
+						MVMCVList *mcvlist);
+extern bytea *statext_histogram_serialize(MVHistogram *histogram,
+							VacAttrStats **stats);
+extern MVHistogram *statext_histogram_deserialize(bytea *data);
+
 extern MultiSortSupport multi_sort_init(int ndims);
 extern void multi_sort_add_dimension(MultiSortSupport mss, int sortdim,
 						 Oid oper);
@@ -66,4 +80,30 @@ extern int multi_sort_compare_dim(int dim, const SortItem *a,
 extern int multi_sort_compare_dims(int start, int end, const SortItem *a,
 						const SortItem *b, MultiSortSupport mss);
 
+
+extern int *build_attnums(Bitmapset *attrs);
+extern MultiSortSupport build_multi_sort(int numattrs, VacAttrStats **stats);
+extern SortItem *build_sorted_items(int numrows, int *nitems, HeapTuple *rows,
+				   TupleDesc tdesc, MultiSortSupport mss,
+				   int numattrs, int *attnums);
+extern int	statext_stattarget(int numattrs, VacAttrStats **stats);
+
+extern Size statext_datum_size(Datum value, int16 typlen, bool typbyval);
+extern char *statext_datum_write(char *ptr, Datum value,
+					int16 typlen, bool typbyval);
+extern char *statext_datum_read(char *ptr, Datum *value,
+				   int16 typlen, bool typbyval);
+
+extern bool examine_opclause_expression(OpExpr *expr, Var **varp,
+							Const **cstp, bool *varonleftp);
+
+extern Selectivity mcv_clauselist_selectivity(PlannerInfo *root,
+						   StatisticExtInfo *stat,
+						   List *clauses,
+						   Selectivity *basesel,
+						   Selectivity *totalsel);
+extern Selectivity histogram_clauselist_selectivity(PlannerInfo *root,
+								 StatisticExtInfo *stat,
+								 List *clauses);
+
 #endif							/* EXTENDED_STATS_INTERNAL_H */
@@ -78,8 +78,76 @@ typedef struct MVDependencies
 /* size of the struct excluding the deps array */
 #define SizeOfDependencies	(offsetof(MVDependencies, ndeps) + sizeof(uint32))
 
+#define STATS_MCV_MAGIC			0xE1A651C2	/* marks serialized bytea */
+#define STATS_MCV_TYPE_BASIC	1	/* basic MCV list type */
+
+/* max items in MCV list (mostly arbitrary number) */
+#define STATS_MCVLIST_MAX_ITEMS	8192
+
+/*
+ * Multivariate MCV (most-common value) lists
+ *
+ * A straightforward extension of MCV items - i.e. a list (array) of
+ * combinations of attribute values, together with a frequency and null flags.
+ */
+typedef struct MVMCVItem
+{
+	double		frequency;		/* frequency of this combination */
+	double		base_frequency; /* frequency if independent */
+	bool	   *isnull;			/* NULL flags */
+	Datum	   *values;			/* item values */
+} MVMCVItem;
+
+/* multivariate MCV list - essentially an array of MCV items */
+typedef struct MVMCVList
+{
+	uint32		magic;			/* magic constant marker */
+	uint32		type;			/* type of MCV list (BASIC) */
+	uint32		nitems;			/* number of MCV items in the array */
+	AttrNumber	ndimensions;	/* number of dimensions */
+	Oid			types[STATS_MAX_DIMENSIONS];	/* OIDs of data types */
+	MVMCVItem **items;			/* array of MCV items */
+} MVMCVList;
+
+#define STATS_HIST_MAGIC		0x7F8C5670	/* marks serialized bytea */
+#define STATS_HIST_TYPE_BASIC	1	/* basic histogram type */
+
+/* max number of histogram buckets (mostly arbitrary number) */
+#define STATS_HIST_MAX_BUCKETS	16384
+
+/*
+ * Multivariate histograms
+ *
+ * Each bucket is a hyper-rectangle, described by the minimum and maximum
+ * value (both inclusive) in each dimension.  A dimension of a bucket may
+ * contain only NULL values, in which case the boundaries are not defined.
+ * We also keep the number of distinct values in each dimension of the
+ * bucket, which helps when estimating equality clauses.
+ */
+typedef struct MVBucket
+{
+	double		frequency;		/* fraction of sampled rows in the bucket */
+	bool	   *nullsonly;		/* the dimension contains only NULLs */
+	uint32	   *ndistinct;		/* distinct values in the dimension */
+	Datum	   *min;			/* lower boundaries (inclusive) */
+	Datum	   *max;			/* upper boundaries (inclusive) */
+} MVBucket;
+
+/* multivariate histogram - essentially an array of buckets */
+typedef struct MVHistogram
+{
+	uint32		magic;			/* magic constant marker */
+	uint32		type;			/* type of histogram (BASIC) */
+	uint32		nbuckets;		/* number of buckets in the array */
+	AttrNumber	ndimensions;	/* number of dimensions */
+	Oid			types[STATS_MAX_DIMENSIONS];	/* OIDs of data types */
+	MVBucket  **buckets;		/* array of buckets */
+} MVHistogram;
+
 extern MVNDistinct *statext_ndistinct_load(Oid mvoid);
 extern MVDependencies *statext_dependencies_load(Oid mvoid);
+extern MVMCVList *statext_mcv_load(Oid mvoid);
+extern MVHistogram *statext_histogram_load(Oid mvoid);
 
 extern void BuildRelationExtStatistics(Relation onerel, double totalrows,
 						   int numrows, HeapTuple *rows,
@@ -92,6 +160,13 @@ extern Selectivity dependencies_clauselist_selectivity(PlannerInfo *root,
 									SpecialJoinInfo *sjinfo,
 									RelOptInfo *rel,
 									Bitmapset **estimatedclauses);
+extern Selectivity statext_clauselist_selectivity(PlannerInfo *root,
+							   List *clauses,
+							   int varRelid,
+							   JoinType jointype,
+							   SpecialJoinInfo *sjinfo,
+							   RelOptInfo *rel,
+							   Bitmapset **estimatedclauses);
 extern bool has_stats_of_kind(List *stats, char requiredkind);
 extern StatisticExtInfo *choose_best_statistics(List *stats,
 					   Bitmapset *attnums, char requiredkind);
@@ -0,0 +1,66 @@
+/*-------------------------------------------------------------------------
+ *
+ * aio.h
+ *	  Asynchronous I/O on shared buffers
+ *
+ *
+ * Portions Copyright (c) 1996-2018, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/storage/aio.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef AIO_H
+#define AIO_H
+
+#include "storage/block.h"
+#include "storage/relfilenode.h"
+
+/*
+ * io_uring instances are created by the postmaster and inherited by its
+ * children, which doesn't work if they are started with exec().
+ */
+#if defined(HAVE_LINUX_IO_URING_H) && !defined(EXEC_BACKEND)
+#define USE_IO_URING
+#endif
+
+/* Possible values for io_method */
+typedef enum IoMethod
+{
+	IOMETHOD_SYNC,				/* no asynchronous I/O */
+	IOMETHOD_WORKER,			/* I/O performed by I/O worker processes */
+	IOMETHOD_IO_URING			/* I/O performed by the kernel */
+} IoMethod;
+
+/* Largest number of contiguous blocks transferred by one I/O */
+#define PGAIO_MAX_BLOCKS	16
+
+/* Upper limits for io_workers and io_max_concurrency */
+#define MAX_IO_WORKERS		32
+#define PGAIO_MAX_CONCURRENCY	1024
+
+/* GUC variables */
+extern PGDLLIMPORT int io_method;
+extern int	io_workers;
+extern int	io_max_concurrency;
+
+#define pgaio_enabled()		(io_method != IOMETHOD_SYNC)
+
+extern Size AioShmemSize(void);
+extern void AioShmemInit(void);
+extern void AioPostmasterInit(void);
+
+extern int pgaio_start_read(RelFileNode rnode, ForkNumber forknum,
+				 BlockNumber blocknum, int nblocks, const int *buf_ids);
+extern int pgaio_start_write(RelFileNode rnode, ForkNumber forknum,
+				  BlockNumber blocknum, int nblocks, const int *buf_ids,
+				  char **pages);
+extern void pgaio_submit(void);
+extern bool pgaio_io_progress(int io_id);
+extern void pgaio_wait_all(void);
+extern void pgaio_at_error(void);
+
+extern void IoWorkerMain(Datum main_arg) pg_attribute_noreturn();
+
+#endif							/* AIO_H */
@@ -0,0 +1,96 @@
+/*-------------------------------------------------------------------------
+ *
+ * aio_internal.h
+ *	  Internal definitions shared by the asynchronous I/O implementations
+ *
+ *
+ * Portions Copyright (c) 1996-2018, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/storage/aio_internal.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef AIO_INTERNAL_H
+#define AIO_INTERNAL_H
+
+#include "port/atomics.h"
+#include "storage/aio.h"
+#include "storage/condition_variable.h"
+#include "storage/latch.h"
+#include "storage/s_lock.h"
+
+typedef enum PgAioOp
+{
+	PGAIO_OP_READ,
+	PGAIO_OP_WRITE
+} PgAioOp;
+
+/*
+ * Life cycle of an I/O handle.  Only the owning process moves a handle out
+ * of IDLE, STAGED and DONE; any process may complete a SUBMITTED I/O.
+ */
+typedef enum PgAioState
+{
+	PGAIO_IDLE,					/* not in use */
+	PGAIO_STAGED,				/* defined, but not yet submitted */
+	PGAIO_SUBMITTED,			/* handed to an I/O worker or the kernel */
+	PGAIO_DONE					/* completed, not yet reclaimed by the owner */
+} PgAioState;
+
+typedef struct PgAioHandle
+{
+	pg_atomic_uint32 state;		/* a PgAioState */
+	PgAioOp		op;
+	int			owner;			/* pgprocno of the owning process */
+	RelFileNode rnode;
+	ForkNumber	forknum;
+	BlockNumber blocknum;		/* first block to transfer */
+	int			nblocks;
+	int			buf_ids[PGAIO_MAX_BLOCKS];	/* shared buffers involved */
+	int			bounce_ids[PGAIO_MAX_BLOCKS];	/* page copies, for writes */
+	ConditionVariable cv;		/* broadcast when the I/O leaves a state */
+} PgAioHandle;
+
+typedef struct PgAioCtlData
+{
+	slock_t		mutex;			/* protects all the fields below */
+
+	/* free list of bounce buffers */
+	int			bounce_free;	/* head of the list, or -1 */
+	int			bounce_nfree;	/* length of the list */
+
+	/* I/O worker state */
+	int			nworkers;		/* number of workers accepting I/O */
+	int			next_wakeup;	/* worker to wake up next */
+	Latch	   *worker_latches[MAX_IO_WORKERS];
+
+	/* queue of submitted handles waiting for a worker, as a ring buffer */
+	uint32		queue_size;
+	uint32		queue_head;		/* next entry to take */
+	uint32		queue_tail;		/* next entry to fill */
+	int			queue[FLEXIBLE_ARRAY_MEMBER];
+} PgAioCtlData;
+
+extern PgAioCtlData *AioCtl;
+extern PgAioHandle *AioHandles;
+
+/* aio.c */
+extern char *pgaio_io_block(PgAioHandle *ioh, int i);
+extern void pgaio_perform_io(PgAioHandle *ioh);
+extern void pgaio_complete(PgAioHandle *ioh, bool success);
+
+/* aio_worker.c */
+extern void AioRegisterWorkers(void);
+extern bool pgaio_worker_submit(int nios, PgAioHandle **ios);
+
+/* aio_uring.c */
+#ifdef USE_IO_URING
+extern Size pgaio_uring_shmem_size(void);
+extern void pgaio_uring_shmem_init(bool found);
+extern bool pgaio_uring_probe(void);
+extern void pgaio_uring_submit(int nios, PgAioHandle **ios);
+extern void pgaio_uring_wait(PgAioHandle *ioh);
+#endif
+
+#endif							/* AIO_INTERNAL_H */
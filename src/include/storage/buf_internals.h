@@ -17,6 +17,7 @@
 
 #include "storage/buf.h"
 #include "storage/bufmgr.h"
+#include "storage/condition_variable.h"
 #include "storage/latch.h"
 #include "storage/lwlock.h"
 #include "storage/shmem.h"
@@ -159,6 +160,11 @@ typedef struct buftag
  * lock the buffer header; this is generally for situations where we don't
  * expect the flag bit being tested to be changing.
  *
+ * io_handle identifies the asynchronous I/O that's reading or writing the
+ * buffer, if BM_IO_IN_PROGRESS is set and the I/O was started through the
+ * AIO subsystem (see storage/aio.h).  It is protected by the buffer header
+ * lock.
+ *
  * We can't physically remove items from a disk page if another backend has
  * the buffer pinned.  Hence, a backend may need to wait for all other pins
  * to go away.  This is signaled by storing its own PID into
@@ -185,6 +191,7 @@ typedef struct BufferDesc
 
 	int			wait_backend_pid;	/* backend PID of pin-count waiter */
 	int			freeNext;		/* link in freelist chain */
+	int			io_handle;		/* AIO handle of I/O in progress, or -1 */
 
 	LWLock		content_lock;	/* to lock access to buffer contents */
 } BufferDesc;
@@ -222,12 +229,12 @@ typedef union BufferDescPadded
 
 #define BufferDescriptorGetBuffer(bdesc) ((bdesc)->buf_id + 1)
 
-#define BufferDescriptorGetIOLock(bdesc) \
-	(&(BufferIOLWLockArray[(bdesc)->buf_id]).lock)
+#define BufferDescriptorGetIOCV(bdesc) \
+	(&(BufferIOCVArray[(bdesc)->buf_id]).cv)
 #define BufferDescriptorGetContentLock(bdesc) \
 	((LWLock*) (&(bdesc)->content_lock))
 
-extern PGDLLIMPORT LWLockMinimallyPadded *BufferIOLWLockArray;
+extern PGDLLIMPORT ConditionVariableMinimallyPadded *BufferIOCVArray;
 
 /*
  * The freeNext field is either the index of the next freelist entry,
@@ -278,6 +285,43 @@ extern PGDLLIMPORT WritebackContext BackendWritebackContext;
 /* in localbuf.c */
 extern BufferDesc *LocalBufferDescriptors;
 
+/*
+ * Shared buffers are divided into "buffer nodes", ranges of consecutive
+ * buffers that each have their own freelist and clock sweep, see buf_numa.c.
+ * With numa_buffers, there's one buffer node per NUMA node, and its buffers
+ * are placed in that NUMA node's memory; otherwise there's just one, unless
+ * debug_buffer_nodes asks for more.  There are at most MAX_BUFFER_NODES.
+ */
+
+typedef struct BufferNodeLayout
+{
+	int			numNodes;		/* number of buffer nodes */
+	int			buffersPerNode; /* buffers per node, except the last */
+	int			numaNode[MAX_BUFFER_NODES]; /* NUMA node, or -1 if not placed */
+} BufferNodeLayout;
+
+/* in buf_numa.c */
+extern PGDLLIMPORT BufferNodeLayout *BufferNodes;
+
+#define NumBufferNodes()	(BufferNodes->numNodes)
+#define BufferNodeOf(buf_id) \
+	Min((buf_id) / BufferNodes->buffersPerNode, BufferNodes->numNodes - 1)
+#define BufferNodeFirst(node)	((node) * BufferNodes->buffersPerNode)
+#define BufferNodeSize(node) \
+	((node) == BufferNodes->numNodes - 1 ? \
+	 NBuffers - BufferNodeFirst(node) : BufferNodes->buffersPerNode)
+
+/* Statistics about one buffer node, as returned by StrategyGetNodeStats() */
+typedef struct BufferNodeStats
+{
+	int			numaNode;		/* NUMA node, or -1 if not placed */
+	uint64		buffers;		/* buffers in the node */
+	uint64		hits;			/* hits by processes running on the node */
+	uint64		remoteHits;		/* hits by processes on other nodes */
+	uint64		misses;			/* pages read by processes on the node */
+	uint64		remoteMisses;	/* pages read by processes on other nodes */
+} BufferNodeStats;
+
 /* in bufmgr.c */
 
 /*
@@ -297,6 +341,46 @@ typedef struct CkptSortItem
 
 extern CkptSortItem *CkptBufferIds;
 
+/*
+ * Tiers of the 2Q buffer replacement policy, see freelist.c.  Every buffer is
+ * in the probation tier under the clock policy.
+ */
+#define BUF_TIER_PROBATION	0
+#define BUF_TIER_PROTECTED	1
+#define NUM_BUF_TIERS		2
+
+/* Statistics about one tier, as returned by StrategyGetTierStats() */
+typedef struct BufferTierStats
+{
+	uint64		buffers;		/* buffers currently in the tier */
+	uint64		admitted;		/* pages read into the tier */
+	uint64		promoted;		/* buffers moved from it to the protected tier */
+	uint64		demoted;		/* buffers moved from it to the probation tier */
+	uint64		evicted;		/* pages evicted from it */
+} BufferTierStats;
+
+/*
+ * The compressed buffer tier, see buf_compress.c, is divided into this many
+ * partitions.
+ */
+#define NUM_CBUF_PARTITIONS		32
+
+/* Statistics about one partition, as returned by CompressedBufferStats() */
+typedef struct CompressedBufferPartitionStats
+{
+	uint64		pages;			/* pages currently stored */
+	uint64		bytes;			/* bytes they take */
+	uint64		capacity;		/* bytes of space in the partition */
+	uint64		hits;			/* pages read from it */
+	uint64		misses;			/* pages looked for, but not found */
+	uint64		stored;			/* pages stored */
+	uint64		rejected;		/* pages that didn't compress well enough */
+	uint64		evicted;		/* pages replaced to make room */
+} CompressedBufferPartitionStats;
+
+/* Matches pages for CompressedBufferDrop() */
+typedef bool (*CompressedBufferMatch) (const BufferTag *tag, void *arg);
+
 /*
  * Internal buffer management routines
  */
@@ -304,15 +388,46 @@ extern CkptSortItem *CkptBufferIds;
 extern void WritebackContextInit(WritebackContext *context, int *max_pending);
 extern void IssuePendingWritebacks(WritebackContext *context);
 extern void ScheduleBufferTagForWriteback(WritebackContext *context, BufferTag *tag);
+extern void CompleteBufferIO(int buf_id, bool is_write, bool success);
+
+/* buf_compress.c */
+extern Size CompressedBufferShmemSize(void);
+extern void InitCompressedBuffers(void);
+extern bool CompressedBufferRead(BufferTag *tag, char *page);
+extern void CompressedBufferForget(BufferTag *tag);
+extern bool CompressedBufferPrepare(BufferTag *tag, char *page);
+extern bool CompressedBufferLockStash(void);
+extern void CompressedBufferFinishStash(bool store);
+extern void CompressedBufferDrop(CompressedBufferMatch match, void *arg);
+extern int	CompressedBufferStats(CompressedBufferPartitionStats *stats);
+
+#define CompressedBuffersEnabled()	(compressed_buffers > 0)
+
+/* buf_numa.c */
+extern Size BufferNodesShmemSize(void);
+extern void InitBufferNodes(void);
+extern void PlaceBufferNodesMemory(char *base, Size stride);
 
 /* freelist.c */
 extern BufferDesc *StrategyGetBuffer(BufferAccessStrategy strategy,
 				  uint32 *buf_state);
+extern BufferDesc *StrategySweepBuffer(int node, uint32 *buf_state);
 extern void StrategyFreeBuffer(BufferDesc *buf);
+extern int	StrategyFreeListLength(int node);
 extern bool StrategyRejectBuffer(BufferAccessStrategy strategy,
 					 BufferDesc *buf);
-
-extern int	StrategySyncStart(uint32 *complete_passes, uint32 *num_buf_alloc);
+extern void StrategyAdmitBuffer(BufferAccessStrategy strategy,
+					BufferDesc *buf, bool evicted,
+					uint32 oldHash, uint32 newHash);
+extern void StrategyEvictBuffer(BufferDesc *buf, uint32 hashcode);
+extern void StrategyForgetBuffer(BufferDesc *buf);
+extern void StrategyGetTierStats(BufferTierStats *stats);
+extern void StrategyNoteHit(BufferDesc *buf);
+extern void StrategyFlushHits(void);
+extern int	StrategyGetNodeStats(BufferNodeStats *stats);
+
+extern int	StrategySyncStart(int node, uint32 *complete_passes,
+				  uint32 *num_buf_alloc);
 extern void StrategyNotifyBgWriter(int bgwprocno);
 
 extern Size StrategyShmemSize(void);
@@ -324,6 +439,7 @@ extern Size BufTableShmemSize(int size);
 extern void InitBufTable(int size);
 extern uint32 BufTableHashCode(BufferTag *tagPtr);
 extern int	BufTableLookup(BufferTag *tagPtr, uint32 hashcode);
+extern int	BufTableLookupUnlocked(BufferTag *tagPtr, uint32 hashcode);
 extern int	BufTableInsert(BufferTag *tagPtr, uint32 hashcode, int buf_id);
 extern void BufTableDelete(BufferTag *tagPtr, uint32 hashcode);
 
@@ -47,9 +47,27 @@ typedef enum
 								 * replay; otherwise same as RBM_NORMAL */
 } ReadBufferMode;
 
+/* Possible values for buffer_replacement_policy */
+typedef enum BufferReplacementPolicy
+{
+	BUFFER_REPLACEMENT_CLOCK,	/* single clock sweep over all buffers */
+	BUFFER_REPLACEMENT_2Q		/* probation and protected tiers */
+} BufferReplacementPolicy;
+
+/* Possible results of PrefetchSharedBuffer() */
+typedef enum PrefetchBufferResult
+{
+	PREFETCH_BUFFER_HIT,		/* block was already in shared buffers */
+	PREFETCH_BUFFER_STARTED,	/* read of the block was initiated */
+	PREFETCH_BUFFER_NOFILE		/* relation file doesn't exist (recovery) */
+} PrefetchBufferResult;
+
 /* forward declared, to avoid having to expose buf_internals.h here */
 struct WritebackContext;
 
+/* forward declared, to avoid having to expose smgr.h here */
+struct SMgrRelationData;
+
 /* in globals.c ... this duplicates miscadmin.h */
 extern PGDLLIMPORT int NBuffers;
 
@@ -57,6 +75,7 @@ extern PGDLLIMPORT int NBuffers;
 extern bool zero_damaged_pages;
 extern int	bgwriter_lru_maxpages;
 extern double bgwriter_lru_multiplier;
+extern bool bgwriter_evict;
 extern bool track_io_timing;
 extern int	target_prefetch_pages;
 
@@ -67,6 +86,16 @@ extern int	bgwriter_flush_after;
 /* in buf_init.c */
 extern PGDLLIMPORT char *BufferBlocks;
 
+/* in buf_compress.c */
+extern int	compressed_buffers;
+
+/* in buf_numa.c */
+extern bool numa_buffers;
+extern int	debug_buffer_nodes;
+
+/* in freelist.c */
+extern int	buffer_replacement_policy;
+
 /* in guc.c */
 extern int	effective_io_concurrency;
 
@@ -75,6 +104,17 @@ extern PGDLLIMPORT int NLocBuffer;
 extern PGDLLIMPORT Block *LocalBufferBlockPointers;
 extern PGDLLIMPORT int32 *LocalRefCount;
 
+/*
+ * Placing shared buffers on NUMA nodes needs the mbind() and getcpu() system
+ * calls of Linux.
+ */
+#if defined(__linux__) && defined(HAVE_LINUX_MEMPOLICY_H)
+#define USE_NUMA_BUFFERS
+#endif
+
+/* upper limit for the number of buffer nodes, see buf_internals.h */
+#define MAX_BUFFER_NODES	64
+
 /* upper limit for effective_io_concurrency */
 #define MAX_IO_CONCURRENCY 1000
 
@@ -163,6 +203,8 @@ extern PGDLLIMPORT int32 *LocalRefCount;
  * prototypes for functions in bufmgr.c
  */
 extern bool ComputeIoConcurrency(int io_concurrency, double *target);
+extern PrefetchBufferResult PrefetchSharedBuffer(struct SMgrRelationData *smgr_reln,
+					 ForkNumber forkNum, BlockNumber blockNum);
 extern void PrefetchBuffer(Relation reln, ForkNumber forkNum,
 			   BlockNumber blockNum);
 extern Buffer ReadBuffer(Relation reln, BlockNumber blockNum);
@@ -172,6 +214,11 @@ extern Buffer ReadBufferExtended(Relation reln, ForkNumber forkNum,
 extern Buffer ReadBufferWithoutRelcache(RelFileNode rnode,
 						  ForkNumber forkNum, BlockNumber blockNum,
 						  ReadBufferMode mode, BufferAccessStrategy strategy);
+extern int StartReadBuffers(Relation reln, ForkNumber forkNum,
+				 BlockNumber blockNum, int nblocks,
+				 BufferAccessStrategy strategy, Buffer *buffers);
+extern void WaitReadBuffers(Buffer *buffers, int nbuffers);
+extern void DiscardReadBuffers(Buffer *buffers, int nbuffers);
 extern void ReleaseBuffer(Buffer buffer);
 extern void UnlockReleaseBuffer(Buffer buffer);
 extern void MarkBufferDirty(Buffer buffer);
@@ -230,8 +277,13 @@ extern void TestForOldSnapshot_impl(Snapshot snapshot, Relation relation);
 
 /* in freelist.c */
 extern BufferAccessStrategy GetAccessStrategy(BufferAccessStrategyType btype);
+extern int	GetAccessStrategyBufferCount(BufferAccessStrategy strategy);
 extern void FreeAccessStrategy(BufferAccessStrategy strategy);
 
+/* in buf_numa.c */
+extern int	BufferNodeCount(void);
+extern int	CurrentBufferNode(void);
+
 
 /* inline functions */
 
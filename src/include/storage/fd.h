@@ -40,6 +40,15 @@
 #define FD_H
 
 #include <dirent.h>
+#ifndef WIN32
+#include <sys/uio.h>
+#else
+struct iovec
+{
+	void	   *iov_base;
+	size_t		iov_len;
+};
+#endif
 
 
 /*
@@ -48,9 +57,17 @@
 
 typedef int File;
 
+/* Maximum number of iovecs FileReadV and FileWriteV accept */
+#define PG_IOV_MAX		32
 
-/* GUC parameter */
+
+/* Flags for io_direct */
+#define IO_DIRECT_DATA		0x01	/* relation data files */
+#define IO_DIRECT_WAL		0x02	/* WAL segments being written */
+
+/* GUC parameters */
 extern PGDLLIMPORT int max_files_per_process;
+extern int	io_direct_flags;	/* set from io_direct */
 
 /*
  * This is private to fd.c, but exported for save/restore_backend_variables()
@@ -70,12 +87,19 @@ extern void FileClose(File file);
 extern int	FilePrefetch(File file, off_t offset, int amount, uint32 wait_event_info);
 extern int	FileRead(File file, char *buffer, int amount, uint32 wait_event_info);
 extern int	FileWrite(File file, char *buffer, int amount, uint32 wait_event_info);
+extern int	FileReadV(File file, const struct iovec *iov, int iovcnt,
+		  off_t offset, uint32 wait_event_info);
+extern int	FileWriteV(File file, const struct iovec *iov, int iovcnt,
+		   off_t offset, uint32 wait_event_info);
 extern int	FileSync(File file, uint32 wait_event_info);
 extern off_t FileSeek(File file, off_t offset, int whence);
 extern int	FileTruncate(File file, off_t offset, uint32 wait_event_info);
+extern int	FileFallocate(File file, off_t offset, off_t amount,
+			  uint32 wait_event_info);
 extern void FileWriteback(File file, off_t offset, off_t nbytes, uint32 wait_event_info);
 extern char *FilePathName(File file);
 extern int	FileGetRawDesc(File file);
+extern int	FileGetRawDescForIO(File file);
 extern int	FileGetRawFlags(File file);
 extern mode_t FileGetRawMode(File file);
 extern off_t FileGetSize(File file);
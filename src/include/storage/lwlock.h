@@ -204,7 +204,6 @@ typedef enum BuiltinTrancheIds
 	LWTRANCHE_OLDSERXID_BUFFERS,
 	LWTRANCHE_WAL_INSERT,
 	LWTRANCHE_BUFFER_CONTENT,
-	LWTRANCHE_BUFFER_IO_IN_PROGRESS,
 	LWTRANCHE_REPLICATION_ORIGIN,
 	LWTRANCHE_REPLICATION_SLOT_IO_IN_PROGRESS,
 	LWTRANCHE_PROC,
@@ -219,6 +218,10 @@ typedef enum BuiltinTrancheIds
 	LWTRANCHE_SHARED_TUPLESTORE,
 	LWTRANCHE_TBM,
 	LWTRANCHE_PARALLEL_APPEND,
+	LWTRANCHE_SHARED_PLAN_CACHE,
+	LWTRANCHE_AIO_URING_COMPLETION,
+	LWTRANCHE_RELATION_EXTENSION,
+	LWTRANCHE_COMPRESSED_BUFFERS,
 	LWTRANCHE_FIRST_USER_DEFINED
 }			BuiltinTrancheIds;
 
@@ -69,4 +69,7 @@ extern PGShmemHeader *PGSharedMemoryCreate(Size size, bool makePrivate,
 extern bool PGSharedMemoryIsInUse(unsigned long id1, unsigned long id2);
 extern void PGSharedMemoryDetach(void);
 
+/* only available with MAP_HUGETLB, and without EXEC_BACKEND */
+extern void GetHugePageSize(Size *hugepagesize, int *mmap_flags);
+
 #endif							/* PG_SHMEM_H */
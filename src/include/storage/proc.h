@@ -183,6 +183,12 @@ struct PGPROC
 	XLogRecPtr	clogGroupMemberLsn; /* WAL location of commit record for clog
 									 * group member */
 
+	/* Support for group WAL flush. */
+	bool		walFlushGroupMember;	/* true, if member of WAL flush group */
+	pg_atomic_uint32 walFlushGroupNext; /* next WAL flush group member */
+	XLogRecPtr	walFlushGroupMemberLsn; /* WAL location the member needs
+										 * flushed */
+
 	/* Per-backend LWLock.  Protects fields below (but not group fields). */
 	LWLock		backendLock;
 
@@ -256,6 +262,8 @@ typedef struct PROC_HDR
 	pg_atomic_uint32 procArrayGroupFirst;
 	/* First pgproc waiting for group transaction status update */
 	pg_atomic_uint32 clogGroupFirst;
+	/* First pgproc waiting for group WAL flush */
+	pg_atomic_uint32 walFlushGroupFirst;
 	/* WALWriter process's latch */
 	Latch	   *walwriterLatch;
 	/* Checkpointer process's latch */
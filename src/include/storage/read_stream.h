@@ -0,0 +1,44 @@
+/*-------------------------------------------------------------------------
+ *
+ * read_stream.h
+ *	  Look-ahead reading of a sequence of relation blocks
+ *
+ *
+ * Portions Copyright (c) 1996-2018, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/storage/read_stream.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef READ_STREAM_H
+#define READ_STREAM_H
+
+#include "storage/buf.h"
+#include "storage/bufmgr.h"
+#include "utils/relcache.h"
+
+typedef struct ReadStream ReadStream;
+
+/*
+ * Callback returning the next block number to read, or InvalidBlockNumber
+ * at the end of the stream.  per_buffer_data points to the space reserved
+ * for the block's caller-defined data, which is handed back along with the
+ * buffer.
+ */
+typedef BlockNumber (*ReadStreamBlockNumberCB) (ReadStream *stream,
+												void *callback_private_data,
+												void *per_buffer_data);
+
+extern ReadStream *read_stream_begin_relation(Relation rel,
+						   ForkNumber forknum,
+						   BufferAccessStrategy strategy,
+						   ReadStreamBlockNumberCB callback,
+						   void *callback_private_data,
+						   size_t per_buffer_data_size);
+extern Buffer read_stream_next_buffer(ReadStream *stream,
+						void **per_buffer_data);
+extern void read_stream_reset(ReadStream *stream);
+extern void read_stream_end(ReadStream *stream);
+
+#endif							/* READ_STREAM_H */
@@ -94,14 +94,26 @@ extern void smgrdounlinkall(SMgrRelation *rels, int nrels, bool isRedo);
 extern void smgrdounlinkfork(SMgrRelation reln, ForkNumber forknum, bool isRedo);
 extern void smgrextend(SMgrRelation reln, ForkNumber forknum,
 		   BlockNumber blocknum, char *buffer, bool skipFsync);
-extern void smgrprefetch(SMgrRelation reln, ForkNumber forknum,
+extern void smgrextendv(SMgrRelation reln, ForkNumber forknum,
+			BlockNumber blocknum, char **buffers, BlockNumber nblocks,
+			bool skipFsync);
+extern void smgrzeroextend(SMgrRelation reln, ForkNumber forknum,
+			   BlockNumber blocknum, BlockNumber nblocks, bool skipFsync);
+extern bool smgrprefetch(SMgrRelation reln, ForkNumber forknum,
 			 BlockNumber blocknum);
 extern void smgrread(SMgrRelation reln, ForkNumber forknum,
 		 BlockNumber blocknum, char *buffer);
+extern void smgrreadv(SMgrRelation reln, ForkNumber forknum,
+		  BlockNumber blocknum, char **buffers, BlockNumber nblocks);
 extern void smgrwrite(SMgrRelation reln, ForkNumber forknum,
 		  BlockNumber blocknum, char *buffer, bool skipFsync);
+extern void smgrwritev(SMgrRelation reln, ForkNumber forknum,
+		   BlockNumber blocknum, char **buffers, BlockNumber nblocks,
+		   bool skipFsync);
 extern void smgrwriteback(SMgrRelation reln, ForkNumber forknum,
 			  BlockNumber blocknum, BlockNumber nblocks);
+extern int	smgrfd(SMgrRelation reln, ForkNumber forknum,
+	   BlockNumber blocknum, bool forwrite, off_t *off);
 extern BlockNumber smgrnblocks(SMgrRelation reln, ForkNumber forknum);
 extern void smgrtruncate(SMgrRelation reln, ForkNumber forknum,
 			 BlockNumber nblocks);
@@ -122,14 +134,26 @@ extern bool mdexists(SMgrRelation reln, ForkNumber forknum);
 extern void mdunlink(RelFileNodeBackend rnode, ForkNumber forknum, bool isRedo);
 extern void mdextend(SMgrRelation reln, ForkNumber forknum,
 		 BlockNumber blocknum, char *buffer, bool skipFsync);
-extern void mdprefetch(SMgrRelation reln, ForkNumber forknum,
+extern void mdextendv(SMgrRelation reln, ForkNumber forknum,
+		  BlockNumber blocknum, char **buffers, BlockNumber nblocks,
+		  bool skipFsync);
+extern void mdzeroextend(SMgrRelation reln, ForkNumber forknum,
+			 BlockNumber blocknum, BlockNumber nblocks, bool skipFsync);
+extern bool mdprefetch(SMgrRelation reln, ForkNumber forknum,
 		   BlockNumber blocknum);
 extern void mdread(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 	   char *buffer);
+extern void mdreadv(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+		char **buffers, BlockNumber nblocks);
 extern void mdwrite(SMgrRelation reln, ForkNumber forknum,
 		BlockNumber blocknum, char *buffer, bool skipFsync);
+extern void mdwritev(SMgrRelation reln, ForkNumber forknum,
+		 BlockNumber blocknum, char **buffers, BlockNumber nblocks,
+		 bool skipFsync);
 extern void mdwriteback(SMgrRelation reln, ForkNumber forknum,
 			BlockNumber blocknum, BlockNumber nblocks);
+extern int	mdfd(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+	 bool forwrite, off_t *off);
 extern BlockNumber mdnblocks(SMgrRelation reln, ForkNumber forknum);
 extern void mdtruncate(SMgrRelation reln, ForkNumber forknum,
 		   BlockNumber nblocks);
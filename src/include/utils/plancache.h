@@ -25,6 +25,40 @@ struct RawStmt;
 #define CACHEDPLANSOURCE_MAGIC		195726186
 #define CACHEDPLAN_MAGIC			953717834
 
+/*
+ * Number of generic plans a CachedPlanSource can keep: one that doesn't
+ * depend on the parameter values at all, plus one per range of estimated
+ * selectivity of the parameter-sensitive quals (see choose_plan_bucket).
+ */
+#define PLANCACHE_NUM_BUCKETS		5
+
+/*
+ * PlanCacheSensitiveParam describes a top-level WHERE clause of the form
+ * "column OP $n", which makes the best plan depend on the value of $n.
+ */
+typedef struct PlanCacheSensitiveParam
+{
+	int			paramid;		/* number of the PARAM_EXTERN parameter */
+	Oid			paramtype;		/* its data type */
+	Oid			relid;			/* table the parameter is compared with */
+	AttrNumber	attnum;			/* column the parameter is compared with */
+	bool		inh;			/* use inheritance-tree statistics? */
+	Oid			opno;			/* comparison operator */
+	bool		varonleft;		/* is the column the left-hand input? */
+} PlanCacheSensitiveParam;
+
+/*
+ * CachedPlanBucket holds a generic plan, and the statistics used to decide
+ * whether to use it, for one selectivity bucket of a CachedPlanSource.
+ */
+typedef struct CachedPlanBucket
+{
+	struct CachedPlan *gplan;	/* generic plan, or NULL if not valid */
+	double		generic_cost;	/* cost of generic plan, or -1 if not known */
+	double		total_custom_cost;	/* total cost of custom plans so far */
+	int			num_custom_plans;	/* number of plans included in total */
+} CachedPlanBucket;
+
 /*
  * CachedPlanSource (which might better have been called CachedQuery)
  * represents a SQL query that we expect to use multiple times.  It stores
@@ -39,7 +73,9 @@ struct RawStmt;
  * specific set of parameters).  plancache.c contains the logic that decides
  * which way to do it for any particular execution.  If we are using a generic
  * cached plan then it is meant to be re-used across multiple executions, so
- * callers must always treat CachedPlans as read-only.
+ * callers must always treat CachedPlans as read-only.  A CachedPlanSource may
+ * hold several generic plans, each one tuned for parameter values of a
+ * different estimated selectivity.
  *
  * Once successfully built and "saved", CachedPlanSources typically live
  * for the life of the backend, although they can be dropped explicitly.
@@ -101,8 +137,8 @@ typedef struct CachedPlanSource
 	Oid			rewriteRoleId;	/* Role ID we did rewriting for */
 	bool		rewriteRowSecurity; /* row_security used during rewrite */
 	bool		dependsOnRLS;	/* is rewritten query specific to the above? */
-	/* If we have a generic plan, this is a reference-counted link to it: */
-	struct CachedPlan *gplan;	/* generic plan, or NULL if not valid */
+	PlanCacheSensitiveParam *sensitive_params;	/* array in query_context */
+	int			num_sensitive_params;	/* length of that array */
 	/* Some state flags: */
 	bool		is_oneshot;		/* is it a "oneshot" plan? */
 	bool		is_complete;	/* has CompleteCachedPlan been done? */
@@ -111,10 +147,12 @@ typedef struct CachedPlanSource
 	int			generation;		/* increments each time we create a plan */
 	/* If CachedPlanSource has been saved, it is a member of a global list */
 	struct CachedPlanSource *next_saved;	/* list link, if so */
-	/* State kept to help decide whether to use custom or generic plans: */
-	double		generic_cost;	/* cost of generic plan, or -1 if not known */
-	double		total_custom_cost;	/* total cost of custom plans so far */
-	int			num_custom_plans;	/* number of plans included in total */
+	/*
+	 * Generic plans, as reference-counted links, and the state kept to help
+	 * decide whether to use custom or generic plans.  Statements without
+	 * parameter-sensitive quals only use the first bucket.
+	 */
+	CachedPlanBucket buckets[PLANCACHE_NUM_BUCKETS];
 } CachedPlanSource;
 
 /*
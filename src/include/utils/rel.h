@@ -238,6 +238,8 @@ typedef struct ForeignKeyCacheInfo
 	NodeTag		type;
 	Oid			conrelid;		/* relation constrained by the foreign key */
 	Oid			confrelid;		/* relation referenced by the foreign key */
+	bool		convalidated;	/* has the constraint been validated? */
+	bool		condeferrable;	/* is the constraint deferrable? */
 	int			nkeys;			/* number of columns in the foreign key */
 	/* these arrays each have nkeys valid entries: */
 	AttrNumber	conkey[INDEX_MAX_KEYS]; /* cols in referencing table */
@@ -173,6 +173,10 @@ extern double histogram_selectivity(VariableStatData *vardata, FmgrInfo *opproc,
 					  Datum constval, bool varonleft,
 					  int min_hist_size, int n_skip,
 					  int *hist_size);
+extern Selectivity param_value_selectivity(Oid relid, AttrNumber attnum,
+						bool inh, Oid opno,
+						Datum value, bool isnull, Oid valuetype,
+						bool varonleft);
 
 extern Pattern_Prefix_Status pattern_fixed_prefix(Const *patt,
 					 Pattern_Type ptype,
@@ -0,0 +1,50 @@
+/*-------------------------------------------------------------------------
+ *
+ * sharedplancache.h
+ *	  Cross-backend cache of generic plans.
+ *
+ * See sharedplancache.c for comments.
+ *
+ * Portions Copyright (c) 1996-2018, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/utils/sharedplancache.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef SHAREDPLANCACHE_H
+#define SHAREDPLANCACHE_H
+
+#include "storage/sinval.h"
+#include "utils/plancache.h"
+
+/* number of invalidation counters tracked in shared memory */
+#define SHARED_PLAN_COUNTERS		1024
+
+/*
+ * Values of the invalidation counters, taken before building a plan that is
+ * going to be published in the shared plan cache.
+ */
+typedef struct SharedPlanSnapshot
+{
+	uint64		generation;
+	uint32		counters[SHARED_PLAN_COUNTERS];
+} SharedPlanSnapshot;
+
+/* GUC parameter */
+extern int	shared_plan_cache_size;
+
+extern Size SharedPlanCacheShmemSize(void);
+extern void SharedPlanCacheShmemInit(void);
+
+extern bool SharedPlanCacheEligible(CachedPlanSource *plansource,
+						QueryEnvironment *queryEnv);
+extern List *SharedPlanCacheLookup(CachedPlanSource *plansource);
+extern void SharedPlanCacheTakeSnapshot(SharedPlanSnapshot *snap);
+extern void SharedPlanCacheStore(CachedPlanSource *plansource,
+					 List *stmt_list, SharedPlanSnapshot *snap);
+
+extern void SharedPlanCacheInvalMessages(const SharedInvalidationMessage *msgs,
+							 int n);
+
+#endif							/* SHAREDPLANCACHE_H */
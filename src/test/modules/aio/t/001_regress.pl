@@ -0,0 +1,73 @@
+# Run the main regression tests with each asynchronous io_method
+use strict;
+use warnings;
+use PostgresNode;
+use TestLib;
+use Test::More tests => 2;
+
+# Locations of the regression tests; we run from the source directory
+my $srcdir   = '../../regress';
+my $builddir = "$ENV{TESTDIR}/../../regress";
+
+sub run_regress
+{
+	my ($node, $io_method) = @_;
+	my $outputdir = "$ENV{TESTDIR}/tmp_check/regress_$io_method";
+
+	# The tablespace test wants this directory to exist
+	mkdir $outputdir;
+	mkdir "$outputdir/testtablespace";
+
+	my $rc = system(
+		$ENV{PG_REGRESS},
+		"--dlpath=$builddir",
+		'--bindir=',
+		"--host=" . $node->host,
+		"--port=" . $node->port,
+		"--inputdir=$srcdir",
+		"--outputdir=$outputdir",
+		"--schedule=$srcdir/parallel_schedule",
+		'--max-concurrent-tests=20');
+	if ($rc != 0)
+	{
+		# Dump the diffs to the log, to see what went wrong
+		my $diffs = "$outputdir/regression.diffs";
+		print "=== dumping $diffs ===\n";
+		print slurp_file($diffs) if -e $diffs;
+	}
+	is($rc, 0, "regression tests pass with io_method = $io_method");
+}
+
+my $node = get_new_node('worker');
+$node->init;
+$node->append_conf('postgresql.conf', "io_method = worker\n");
+$node->start;
+run_regress($node, 'worker');
+
+# Skip io_uring if the server doesn't support it
+my $have_uring = $node->safe_psql('postgres',
+	"SELECT 'io_uring' = ANY(enumvals) FROM pg_settings WHERE name = 'io_method'"
+);
+$node->stop;
+
+SKIP:
+{
+	skip "io_method = io_uring is not supported by this build", 1
+	  unless $have_uring eq 't';
+
+	my $node_uring = get_new_node('io_uring');
+	$node_uring->init;
+	$node_uring->append_conf('postgresql.conf', "io_method = io_uring\n");
+	$node_uring->start;
+
+	# The server falls back to I/O workers if the kernel refuses io_uring
+	my $method = $node_uring->safe_psql('postgres', 'SHOW io_method');
+	if ($method ne 'io_uring')
+	{
+		$node_uring->stop;
+		skip "io_uring is not usable on this system", 1;
+	}
+
+	run_regress($node_uring, 'io_uring');
+	$node_uring->stop;
+}
@@ -0,0 +1,96 @@
+# Basic operation with direct I/O for data files and WAL
+use strict;
+use warnings;
+use Fcntl;
+use PostgresNode;
+use TestLib;
+use Test::More;
+
+# The server refuses io_direct if the platform has no O_DIRECT, and opening
+# files fails if the file system doesn't support it (e.g. tmpfs on older
+# kernels).  Find out by opening a file next to where the data will live.
+my $have_o_direct = 0;
+if (defined &Fcntl::O_DIRECT)
+{
+	my $probe = "$TestLib::tmp_check/o_direct_probe";
+
+	if (sysopen(my $fh, $probe, O_RDWR | O_CREAT | &Fcntl::O_DIRECT))
+	{
+		close $fh;
+		$have_o_direct = 1;
+	}
+	unlink $probe;
+}
+
+if (!$have_o_direct)
+{
+	plan skip_all => 'direct I/O is not supported here';
+}
+else
+{
+	plan tests => 6;
+}
+
+my $node = get_new_node('main');
+$node->init;
+$node->append_conf(
+	'postgresql.conf', qq{
+io_direct = 'data,wal'
+shared_buffers = 1MB
+});
+$node->start;
+
+is($node->safe_psql('postgres', 'SHOW io_direct'),
+	'data,wal', 'io_direct is set');
+
+# A table and an index much larger than shared buffers, so that their
+# pages are written out and read back.
+$node->safe_psql(
+	'postgres', q{
+CREATE TABLE t (id int, filler text);
+INSERT INTO t SELECT g, repeat('x', 100) FROM generate_series(1, 50000) g;
+CREATE INDEX t_id_idx ON t (id);
+UPDATE t SET filler = repeat('y', 100) WHERE id % 10 = 0;
+VACUUM t;
+});
+is( $node->safe_psql(
+		'postgres',
+		"SELECT count(*), sum(id), count(*) FILTER (WHERE filler = repeat('y', 100)) FROM t"
+	),
+	'50000|1250025000|5000',
+	'heap contents are intact');
+is( $node->safe_psql(
+		'postgres', q{
+SET enable_seqscan = off;
+SET enable_bitmapscan = off;
+SELECT count(*), sum(id) FROM t WHERE id BETWEEN 1001 AND 2000;
+}),
+	'1000|1500500',
+	'index scan works');
+
+# Temporary tables use local buffers
+is( $node->safe_psql(
+		'postgres', q{
+SET temp_buffers = '800kB';
+CREATE TEMP TABLE tt AS SELECT g AS id, repeat('z', 100) AS filler FROM generate_series(1, 20000) g;
+SELECT count(*), sum(id) FROM tt;
+}),
+	'20000|200010000',
+	'temporary table contents are intact');
+
+# After a crash, replay has to read back WAL written with direct I/O
+$node->safe_psql('postgres',
+	"INSERT INTO t SELECT g, repeat('z', 100) FROM generate_series(50001, 60000) g"
+);
+$node->stop('immediate');
+$node->start;
+is( $node->safe_psql('postgres', 'SELECT count(*), sum(id) FROM t'),
+	'60000|1800030000', 'data survives crash recovery');
+
+# And a clean restart, after a checkpoint has written everything
+$node->safe_psql('postgres', 'CHECKPOINT');
+$node->restart;
+is( $node->safe_psql('postgres', 'SELECT count(*), sum(id) FROM t'),
+	'60000|1800030000', 'data survives restart');
+
+$node->stop;
@@ -0,0 +1,78 @@
+# Test that the background writer refills the buffer free list when
+# bgwriter_evict is on, and only then.
+use strict;
+use warnings;
+use PostgresNode;
+use TestLib;
+use Test::More tests => 6;
+
+my $node = get_new_node('main');
+$node->init;
+$node->append_conf(
+	'postgresql.conf', qq{
+shared_buffers = 1MB
+bgwriter_delay = 10ms
+bgwriter_lru_maxpages = 100
+autovacuum = off
+});
+$node->start;
+
+# A table three times as large as shared buffers, with one row per page
+$node->safe_psql(
+	'postgres', q{
+CREATE EXTENSION pg_buffercache;
+CREATE TABLE bw_tab (id int PRIMARY KEY, val int,
+                     pad text DEFAULT repeat('-', 700)) WITH (fillfactor = 10);
+INSERT INTO bw_tab (id, val) SELECT g, 0 FROM generate_series(1, 384) g;
+});
+
+# Update every row through the index, so that every page is read into a
+# buffer taken without a buffer access strategy, and dirtied.  That uses
+# up the buffers that were free at startup.
+my $workload = q{
+DO $$
+BEGIN
+  FOR i IN 1..384 LOOP
+    UPDATE bw_tab SET val = val + 1 WHERE id = i;
+  END LOOP;
+END
+$$;
+};
+my $free_buffers =
+  'SELECT count(*) FROM pg_buffercache WHERE relfilenode IS NULL';
+
+# Without bgwriter_evict, nothing puts buffers back on the free list
+$node->safe_psql('postgres', $workload);
+is($node->safe_psql('postgres', $free_buffers),
+	'0', 'no free buffers without bgwriter_evict');
+
+# With it, the background writer writes out and evicts buffers ahead of the
+# backends' needs
+$node->safe_psql('postgres',
+	'ALTER SYSTEM SET bgwriter_evict = on; SELECT pg_reload_conf();');
+my $clean_before =
+  $node->safe_psql('postgres', 'SELECT buffers_clean FROM pg_stat_bgwriter');
+$node->safe_psql('postgres', $workload);
+
+ok($node->poll_query_until('postgres', "SELECT ($free_buffers) > 0"),
+	'background writer puts buffers on the free list');
+ok( $node->poll_query_until(
+		'postgres',
+		"SELECT buffers_clean > $clean_before FROM pg_stat_bgwriter"),
+	'background writer writes out the buffers it evicts');
+
+# No more than an eighth of shared buffers is kept free
+cmp_ok($node->safe_psql('postgres', $free_buffers),
+	'<=', 128 / 8, 'free list stays within its limit');
+
+# The updates all went through
+is($node->safe_psql('postgres', 'SELECT count(*), sum(val) FROM bw_tab'),
+	'384|768', 'table contents are intact');
+
+# And survive a crash
+$node->stop('immediate');
+$node->start;
+is($node->safe_psql('postgres', 'SELECT count(*), sum(val) FROM bw_tab'),
+	'384|768', 'table contents are intact after crash recovery');
+
+$node->stop;
@@ -0,0 +1,111 @@
+# Look up blocks in the buffer mapping table while entries are being
+# deleted from it, and the following entries shifted back.
+#
+# BufferAlloc first looks for a block without holding the mapping partition
+# lock, and only trusts what it finds after pinning the buffer and checking
+# its tag.  With shared buffers much smaller than the tables, every lookup
+# races with evictions, and with buffers being dropped for relations that
+# are dropped concurrently.  Every read checks that it got the right row.
+use strict;
+use warnings;
+use PostgresNode;
+use TestLib;
+use Test::More tests => 11;
+
+my $node = get_new_node('main');
+$node->init;
+$node->append_conf(
+	'postgresql.conf', qq{
+shared_buffers = 1MB
+max_connections = 20
+autovacuum = off
+});
+$node->start;
+
+# Two tables of about 4MB, with one row per page, and their indexes
+$node->safe_psql(
+	'postgres', q{
+CREATE TABLE bm_a (id int PRIMARY KEY, val text,
+                   pad text DEFAULT repeat('-', 700)) WITH (fillfactor = 10);
+INSERT INTO bm_a SELECT g, md5(g::text) FROM generate_series(1, 500) g;
+CREATE TABLE bm_b (LIKE bm_a INCLUDING ALL) WITH (fillfactor = 10);
+INSERT INTO bm_b SELECT g, md5(g::text) FROM generate_series(1, 500) g;
+});
+
+# invoke pgbench, with scripts to write to the node's directory
+sub pgbench
+{
+	my ($opts, $name, $files) = @_;
+	my @cmd = ('pgbench', split /\s+/, $opts);
+
+	for my $fn (sort keys %$files)
+	{
+		my $filename = $node->basedir . '/' . $fn;
+		push @cmd, '-f', $filename;
+		$filename =~ s/\@\d+$//;
+		append_to_file($filename, $$files{$fn});
+	}
+	$node->command_checks_all(\@cmd, 0, [qr{processed: 3000/3000}],
+		[qr{^$}], $name);
+}
+
+# A lookup that finds the wrong buffer returns no row or another row; divide
+# by zero then, to make the client fail.
+my $lookup = q{
+\set id random(1, 500)
+SELECT 1 / count(*) FILTER (WHERE id = :id AND val = md5(:id::text))
+  FROM bm_a WHERE id = :id;
+SELECT 1 / count(*) FILTER (WHERE id = :id AND val = md5(:id::text))
+  FROM bm_b WHERE id = :id;
+};
+
+# Sequential scans, which evict buffers in the same partitions
+my $scan = q{
+SELECT 1 / (count(*) = 500 AND sum(id) = 125250)::int FROM bm_a;
+};
+
+# Relations created and dropped, whose buffers are removed from the table
+my $ddl = q{
+CREATE TABLE bm_tmp_:client_id AS SELECT g AS id FROM generate_series(1, 2000) g;
+SELECT 1 / (count(*) = 2000)::int FROM bm_tmp_:client_id;
+DROP TABLE bm_tmp_:client_id;
+};
+
+pgbench(
+	'--no-vacuum --client=8 --jobs=4 --transactions=375',
+	'concurrent lookups and evictions',
+	{   '001_bm_lookup@8' => $lookup,
+		'001_bm_scan@1'   => $scan });
+
+pgbench(
+	'--no-vacuum --client=8 --jobs=4 --transactions=375',
+	'concurrent lookups and dropped relations',
+	{   '002_bm_lookup@4' => $lookup,
+		'002_bm_ddl@1'    => $ddl });
+
+# Updates move rows, so lookups see buffers being dirtied and written out
+# by other backends before they are evicted
+my $update = q{
+\set id random(1, 500)
+UPDATE bm_b SET val = md5(:id::text) WHERE id = :id;
+};
+
+pgbench(
+	'--no-vacuum --client=8 --jobs=4 --transactions=375',
+	'concurrent lookups and updates',
+	{   '003_bm_lookup@2' => $lookup,
+		'003_bm_update@1' => $update });
+
+# The tables are intact
+is( $node->safe_psql(
+		'postgres',
+		'SELECT count(*), sum(id) FROM bm_a WHERE val = md5(id::text)'),
+	'500|125250',
+	'first table is intact');
+is( $node->safe_psql(
+		'postgres',
+		'SELECT count(*), sum(id) FROM bm_b WHERE val = md5(id::text)'),
+	'500|125250',
+	'second table is intact');
+
+$node->stop;
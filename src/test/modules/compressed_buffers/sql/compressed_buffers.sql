@@ -0,0 +1,120 @@
+--
+-- Compressed buffer tier
+--
+CREATE EXTENSION pg_buffercache;
+
+SHOW compressed_buffers;
+SELECT count(*) AS partitions,
+       sum(capacity) = 8 * 1024 * 1024 AS capacity
+FROM pg_buffercache_compressed;
+
+CREATE VIEW cbuf_stats AS
+  SELECT sum(pages) AS pages, sum(hits) AS hits, sum(stored) AS stored
+  FROM pg_buffercache_compressed;
+
+-- Read every page of a table once, without a buffer access strategy, so
+-- that the pages evicted meanwhile are stored in the compressed tier.
+-- (Scans of tables larger than a quarter of shared buffers use a strategy,
+-- and pages evicted from its ring aren't stored.)
+CREATE FUNCTION cbuf_touch(rel regclass) RETURNS void LANGUAGE plpgsql AS $$
+BEGIN
+  FOR b IN 0..pg_relation_size(rel) / current_setting('block_size')::int - 1 LOOP
+    EXECUTE format('SELECT FROM %s WHERE ctid = %L', rel, format('(%s,1)', b));
+  END LOOP;
+END
+$$;
+
+-- One row per page, in a table three times as large as shared buffers
+CREATE TABLE cbuf_tab (id int, filler text) WITH (fillfactor = 10);
+INSERT INTO cbuf_tab SELECT g, repeat(md5(g::text), 15) FROM generate_series(1, 384) g;
+
+-- Evict the pages into the tier
+CREATE TABLE cbuf_before AS SELECT * FROM cbuf_stats;
+SELECT cbuf_touch('cbuf_tab');
+SELECT s.stored > b.stored + 100 AS stored,
+       s.pages > 200 AS pages
+FROM cbuf_stats s, cbuf_before b;
+
+-- Read them back from it
+DROP TABLE cbuf_before;
+CREATE TABLE cbuf_before AS SELECT * FROM cbuf_stats;
+SELECT count(*), sum(id), bool_and(filler = repeat(md5(id::text), 15)) AS intact
+FROM cbuf_tab;
+SELECT s.hits > b.hits + 100 AS hits
+FROM cbuf_stats s, cbuf_before b;
+
+-- TRUNCATE removes the old pages from the tier
+SELECT cbuf_touch('cbuf_tab');
+DROP TABLE cbuf_before;
+CREATE TABLE cbuf_before AS SELECT * FROM cbuf_stats;
+TRUNCATE cbuf_tab;
+SELECT s.pages < b.pages - 100 AS dropped
+FROM cbuf_stats s, cbuf_before b;
+
+INSERT INTO cbuf_tab SELECT g, repeat(md5(g::text), 15) FROM generate_series(1001, 1384) g;
+SELECT cbuf_touch('cbuf_tab');
+SELECT count(*), sum(id), bool_and(filler = repeat(md5(id::text), 15)) AS intact
+FROM cbuf_tab;
+
+-- VACUUM truncates the empty pages at the end, and new rows extend the
+-- table over the same block numbers again
+DELETE FROM cbuf_tab WHERE id > 1192;
+SELECT cbuf_touch('cbuf_tab');
+VACUUM cbuf_tab;
+SELECT pg_relation_size('cbuf_tab') / current_setting('block_size')::int AS blocks;
+INSERT INTO cbuf_tab SELECT g, repeat(md5(g::text), 15) FROM generate_series(2001, 2192) g;
+SELECT cbuf_touch('cbuf_tab');
+SELECT count(*), sum(id), bool_and(filler = repeat(md5(id::text), 15)) AS intact
+FROM cbuf_tab;
+
+-- Dropping a table removes its pages
+SELECT cbuf_touch('cbuf_tab');
+DROP TABLE cbuf_before;
+CREATE TABLE cbuf_before AS SELECT * FROM cbuf_stats;
+DROP TABLE cbuf_tab;
+SELECT s.pages < b.pages - 100 AS dropped
+FROM cbuf_stats s, cbuf_before b;
+
+-- And so does dropping a database
+\set regress_db :DBNAME
+CREATE DATABASE regress_cbuf_db;
+\c regress_cbuf_db
+CREATE TABLE cbuf_tab (id int, filler text) WITH (fillfactor = 10);
+INSERT INTO cbuf_tab SELECT g, repeat(md5(g::text), 15) FROM generate_series(1, 384) g;
+SELECT count(*), sum(id), bool_and(filler = repeat(md5(id::text), 15)) AS intact
+FROM cbuf_tab;
+DO $$
+BEGIN
+  FOR b IN 0..383 LOOP
+    PERFORM FROM cbuf_tab WHERE ctid = format('(%s,1)', b)::tid;
+  END LOOP;
+END
+$$;
+\c :regress_db
+DROP TABLE cbuf_before;
+CREATE TABLE cbuf_before AS SELECT * FROM cbuf_stats;
+DROP DATABASE regress_cbuf_db;
+SELECT s.pages < b.pages - 100 AS dropped
+FROM cbuf_stats s, cbuf_before b;
+
+-- A new database gets the same table, with other contents
+CREATE DATABASE regress_cbuf_db;
+\c regress_cbuf_db
+CREATE TABLE cbuf_tab (id int, filler text) WITH (fillfactor = 10);
+INSERT INTO cbuf_tab SELECT g, repeat(md5(g::text), 15) FROM generate_series(3001, 3384) g;
+DO $$
+BEGIN
+  FOR b IN 0..383 LOOP
+    PERFORM FROM cbuf_tab WHERE ctid = format('(%s,1)', b)::tid;
+  END LOOP;
+END
+$$;
+SELECT count(*), sum(id), bool_and(filler = repeat(md5(id::text), 15)) AS intact
+FROM cbuf_tab;
+\c :regress_db
+DROP DATABASE regress_cbuf_db;
+
+DROP TABLE cbuf_before;
+DROP FUNCTION cbuf_touch(regclass);
+DROP VIEW cbuf_stats;
+DROP EXTENSION pg_buffercache;
@@ -0,0 +1,79 @@
+--
+-- Multi-block reads through read streams
+--
+-- The table is five times the size of shared buffers, so scans of it read
+-- most blocks from disk, in runs of up to 16 blocks started ahead of time.
+-- Each row fills a page.
+--
+CREATE TABLE rs_tab (id int, filler text) WITH (fillfactor = 10);
+INSERT INTO rs_tab SELECT g, repeat('x', 500) FROM generate_series(1, 10000) g;
+CREATE INDEX rs_tab_id_idx ON rs_tab (id);
+SELECT pg_relation_size('rs_tab') >
+	pg_size_bytes(current_setting('shared_buffers')) * 4 AS big_enough;
+
+-- sequential scan
+BEGIN;
+SELECT count(*), sum(id) FROM rs_tab;
+-- the scan must really have read blocks
+SELECT pg_stat_get_xact_blocks_fetched('rs_tab'::regclass) >
+	pg_stat_get_xact_blocks_hit('rs_tab'::regclass) AS blocks_read;
+COMMIT;
+
+-- cache every seventh row's page, and scan again, so that the runs of
+-- blocks to read are broken up by cached ones
+SET enable_seqscan = off;
+SET enable_bitmapscan = off;
+SELECT count(*) FROM rs_tab
+  WHERE id = ANY (ARRAY(SELECT generate_series(7, 10000, 7)));
+RESET enable_seqscan;
+RESET enable_bitmapscan;
+SELECT count(*), sum(id) FROM rs_tab;
+
+-- parallel sequential scan
+SET max_parallel_workers_per_gather = 2;
+SET parallel_setup_cost = 0;
+SET parallel_tuple_cost = 0;
+EXPLAIN (COSTS OFF)
+SELECT count(*), sum(id) FROM rs_tab;
+SELECT count(*), sum(id) FROM rs_tab;
+RESET max_parallel_workers_per_gather;
+RESET parallel_setup_cost;
+RESET parallel_tuple_cost;
+
+-- bitmap heap scan, with and without gaps between the pages
+SET enable_seqscan = off;
+SET enable_indexscan = off;
+SET enable_indexonlyscan = off;
+EXPLAIN (COSTS OFF)
+SELECT count(*), sum(id) FROM rs_tab WHERE id BETWEEN 100 AND 9900;
+SELECT count(*), sum(id) FROM rs_tab WHERE id BETWEEN 100 AND 9900;
+SELECT count(*), sum(id) FROM rs_tab WHERE id < 1000 OR id > 9000;
+RESET enable_seqscan;
+RESET enable_indexscan;
+RESET enable_indexonlyscan;
+
+-- ANALYZE samples blocks far apart with a low statistics target
+ALTER TABLE rs_tab ALTER id SET STATISTICS 1, ALTER filler SET STATISTICS 1;
+ANALYZE rs_tab;
+SELECT reltuples > 0 AS analyzed FROM pg_class WHERE relname = 'rs_tab';
+SELECT count(*) FROM pg_stats WHERE tablename = 'rs_tab' AND attname = 'id';
+
+-- VACUUM with dead rows on every other page, so that both heap passes
+-- read many short runs of blocks
+DELETE FROM rs_tab WHERE id % 2 = 0;
+VACUUM rs_tab;
+SELECT count(*), sum(id) FROM rs_tab;
+-- the freed pages are reused
+SELECT pg_relation_size('rs_tab') AS rs_size \gset
+INSERT INTO rs_tab SELECT g, repeat('x', 500) FROM generate_series(2, 9998, 2) g;
+SELECT pg_relation_size('rs_tab') = :rs_size AS reused;
+SELECT count(*), sum(id) FROM rs_tab;
+
+-- VACUUM skipping all-visible pages, except for a few scattered ones
+VACUUM rs_tab;
+UPDATE rs_tab SET filler = repeat('y', 500) WHERE id % 1000 = 0;
+VACUUM (FREEZE) rs_tab;
+SELECT count(*), sum(id) FROM rs_tab WHERE filler = repeat('y', 500);
+SELECT count(*), sum(id) FROM rs_tab;
+
+DROP TABLE rs_tab;
@@ -0,0 +1,59 @@
+# Concurrent bulk loads into the same table.
+#
+# The first COPY extends the table by a chunk of uninitialized pages, and
+# records the ones it doesn't use itself in the free space map.  The second
+# COPY, running while the first one's transaction is still open, must find
+# them there and use them, rather than extending the table again.  VACUUM
+# must leave the unused pages uninitialized, and in the free space map,
+# without complaining about them.  The table is large enough for VACUUM not
+# to truncate them away.
+
+setup
+{
+    CREATE EXTENSION pageinspect;
+    CREATE EXTENSION pg_freespacemap;
+    CREATE TABLE ext_tab (id int, filler text) WITH (autovacuum_enabled = off);
+    INSERT INTO ext_tab SELECT g, repeat('x', 500) FROM generate_series(1, 6000) g;
+    CREATE TABLE ext_before AS
+      SELECT pg_relation_size('ext_tab') / current_setting('block_size')::int AS pages;
+}
+
+# COPY a range of ids through a file in the data directory
+setup
+{
+    CREATE FUNCTION ext_load(first int, last int) RETURNS void LANGUAGE plpgsql AS $$
+    DECLARE
+      f text := current_setting('data_directory') || '/ext_tab_' || first || '.dat';
+    BEGIN
+      EXECUTE format('COPY (SELECT g, repeat(''x'', 500) FROM generate_series(%s, %s) g) TO %L',
+                     first, last, f);
+      EXECUTE format('COPY ext_tab FROM %L', f);
+    END
+    $$;
+}
+
+teardown
+{
+    DROP FUNCTION ext_load(int, int);
+    DROP TABLE ext_tab, ext_before;
+    DROP EXTENSION pg_freespacemap;
+    DROP EXTENSION pageinspect;
+}
+
+session "s1"
+step "s1b"		{ BEGIN; }
+step "s1load"	{ SELECT ext_load(10001, 10030); }
+step "s1c"		{ COMMIT; }
+
+session "s2"
+step "s2load"	{ SELECT ext_load(20001, 20030); }
+step "s2check"	{
+    SELECT pg_relation_size('ext_tab') / current_setting('block_size')::int - pages AS added,
+           (page_header(get_raw_page('ext_tab', pages + 15))).lower AS lower,
+           pg_freespace('ext_tab', pages + 15) > 8000 AS in_fsm
+    FROM ext_before;
+}
+step "s2count"	{ SELECT count(*), sum(id) FROM ext_tab; }
+step "s2vac"	{ VACUUM ext_tab; }
+
+permutation "s1b" "s1load" "s2load" "s1c" "s2check" "s2count" "s2vac" "s2check" "s2count"
@@ -0,0 +1,104 @@
+--
+-- Shared plan cache
+--
+-- Only generic plans of prepared statements are shared.  The statements
+-- below have no parameters, so their first execution uses a generic plan.
+-- Everything that could invalidate plans unexpectedly is done up front.
+--
+CREATE SCHEMA spc_schema;
+CREATE TABLE spc_tab (a int);
+INSERT INTO spc_tab SELECT generate_series(1, 3);
+CREATE TABLE spc_schema.spc_tab (a int);
+INSERT INTO spc_schema.spc_tab SELECT generate_series(1, 5);
+CREATE ROLE regress_spc_user;
+GRANT USAGE ON SCHEMA spc_schema TO regress_spc_user;
+GRANT SELECT ON spc_tab, spc_schema.spc_tab TO regress_spc_user;
+
+-- report changes of the counters since the last call
+CREATE TABLE spc_last AS SELECT * FROM pg_stat_shared_plan_cache;
+GRANT ALL ON spc_last TO regress_spc_user;
+CREATE FUNCTION spc_delta(OUT hits bigint, OUT misses bigint,
+						  OUT stores bigint, OUT evictions bigint)
+LANGUAGE sql AS $$
+	WITH old AS (SELECT * FROM spc_last),
+		 upd AS (UPDATE spc_last SET hits = s.hits, misses = s.misses,
+						stores = s.stores, evictions = s.evictions
+				 FROM pg_stat_shared_plan_cache s)
+	SELECT s.hits - old.hits, s.misses - old.misses,
+		   s.stores - old.stores, s.evictions - old.evictions
+	FROM pg_stat_shared_plan_cache s, old
+$$;
+
+-- the first session to execute the statement publishes its plan
+PREPARE q AS SELECT count(*) FROM spc_tab;
+EXECUTE q;
+SELECT * FROM spc_delta();
+-- later executions use the session's own copy
+EXECUTE q;
+SELECT * FROM spc_delta();
+
+-- another session uses the published plan
+\c -
+PREPARE q AS SELECT count(*) FROM spc_tab;
+EXECUTE q;
+SELECT * FROM spc_delta();
+
+-- but not with a different search_path, which may change the meaning
+DEALLOCATE q;
+SET search_path = spc_schema, public;
+PREPARE q AS SELECT count(*) FROM spc_tab;
+EXECUTE q;
+SELECT * FROM spc_delta();
+RESET search_path;
+
+-- nor as a different role
+DEALLOCATE q;
+SET ROLE regress_spc_user;
+PREPARE q AS SELECT count(*) FROM spc_tab;
+EXECUTE q;
+SELECT * FROM spc_delta();
+RESET ROLE;
+
+-- DDL makes the published plans stale
+ALTER TABLE spc_tab ADD COLUMN b int;
+DEALLOCATE q;
+PREPARE q AS SELECT count(*) FROM spc_tab;
+EXECUTE q;
+SELECT * FROM spc_delta();
+-- and the replacement is used by other sessions again
+\c -
+PREPARE q AS SELECT count(*) FROM spc_tab;
+EXECUTE q;
+SELECT * FROM spc_delta();
+
+-- nor with settings that change how the query text is interpreted
+PREPARE m1 AS SELECT extract(month FROM date '01/02/2000') AS month;
+EXECUTE m1;
+SELECT * FROM spc_delta();
+SET DateStyle = 'Postgres, DMY';
+PREPARE m2 AS SELECT extract(month FROM date '01/02/2000') AS month;
+EXECUTE m2;
+SELECT * FROM spc_delta();
+RESET DateStyle;
+
+-- filling the cache evicts plans
+DO $$
+BEGIN
+	FOR i IN 1..300 LOOP
+		EXECUTE format('PREPARE spc_fill_%s AS SELECT count(*) FROM spc_tab WHERE a <> %s', i, i);
+		EXECUTE format('EXECUTE spc_fill_%s', i);
+	END LOOP;
+END
+$$;
+SELECT hits = 0 AS no_hits, misses = 300 AS all_missed, evictions > 0 AS evicted
+FROM spc_delta();
+SELECT entries <= 256 AS fits FROM pg_stat_shared_plan_cache;
+-- plans of the session are not affected
+EXECUTE q;
+
+DEALLOCATE ALL;
+DROP FUNCTION spc_delta();
+DROP TABLE spc_last;
+DROP TABLE spc_tab;
+DROP SCHEMA spc_schema CASCADE;
+DROP ROLE regress_spc_user;
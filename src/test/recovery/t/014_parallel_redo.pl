@@ -0,0 +1,159 @@
+# Test WAL replay with redo workers (recovery_workers > 0)
+#
+# The same WAL is replayed by a streaming standby with several redo workers,
+# by one without any, and by the master itself in crash recovery with
+# several workers.  The workload has records of the types handed to the
+# workers (heap and B-tree insertions, heap updates, deletes, locks and
+# multi-inserts, full-page images) interleaved with records replayed by the
+# startup process once the workers have caught up (VACUUM, relation and
+# database creation and removal, commits dropping relations).  All of them
+# must end up with the same data, and intact indexes.
+use strict;
+use warnings;
+use PostgresNode;
+use TestLib;
+use Test::More tests => 13;
+
+# Returns the contents of the log file of a node from the given offset
+sub log_since
+{
+	my ($node, $offset) = @_;
+
+	return substr(slurp_file($node->logfile), $offset);
+}
+
+my $node_master = get_new_node('master');
+$node_master->init(allows_streaming => 1);
+$node_master->append_conf(
+	'postgresql.conf', qq(
+recovery_workers = 4
+max_worker_processes = 16
+log_min_messages = debug1
+));
+$node_master->start;
+$node_master->safe_psql('postgres', 'CREATE EXTENSION amcheck');
+
+my $backup_name = 'my_backup';
+$node_master->backup($backup_name);
+
+my $node_parallel = get_new_node('standby_parallel');
+$node_parallel->init_from_backup($node_master, $backup_name,
+	has_streaming => 1);
+$node_parallel->start;
+
+my $node_serial = get_new_node('standby_serial');
+$node_serial->init_from_backup($node_master, $backup_name,
+	has_streaming => 1);
+$node_serial->append_conf('postgresql.conf', 'recovery_workers = 0');
+$node_serial->start;
+
+like(
+	slurp_file($node_parallel->logfile),
+	qr/starting background worker process "redo worker 3"/,
+	'standby with recovery_workers = 4 starts redo workers');
+unlike(
+	slurp_file($node_serial->logfile),
+	qr/starting background worker process "redo worker/,
+	'standby with recovery_workers = 0 starts no redo workers');
+
+# Whole table contents, then the rows found through each index
+my $check_table = q(SELECT count(*), sum(id), sum(val),
+	md5(string_agg(id || ':' || val || ':' || pad, ',' ORDER BY id))
+	FROM pr_tab);
+my $check_index = q(SET enable_seqscan = off;
+	SET enable_bitmapscan = off;
+	SELECT count(*), sum(id) FROM pr_tab WHERE id > 0;
+	SELECT count(*), sum(val) FROM pr_tab WHERE val < 0;);
+my $check_amcheck = q(SELECT bt_index_check('pr_tab_pkey'),
+	bt_index_check('pr_tab_val'));
+
+# Compare a node with the master's results, which must have been computed
+# with the same workload
+sub check_node
+{
+	my ($node, $table, $index, $what) = @_;
+
+	is($node->safe_psql('postgres', $check_table),
+		$table, "$what: table contents match");
+	is($node->safe_psql('postgres', $check_index),
+		$index, "$what: index scans match");
+	is($node->safe_psql('postgres', $check_amcheck),
+		'|', "$what: indexes are intact");
+}
+
+my $datadir = $node_master->data_dir;
+
+# Rows inserted one by one, with index insertions and page splits
+$node_master->safe_psql(
+	'postgres', q(
+CREATE TABLE pr_tab (id int PRIMARY KEY, val int, pad text)
+  WITH (fillfactor = 70);
+INSERT INTO pr_tab SELECT g, g, repeat('x', 100) FROM generate_series(1, 20000) g;
+CREATE INDEX pr_tab_val ON pr_tab (val);
+));
+
+# After a checkpoint, the first change of each page is a full-page image.
+# HOT and non-HOT updates, deletes, row locks and a multi-insert follow,
+# mixed with records the startup process replays itself.
+$node_master->safe_psql(
+	'postgres', qq(
+CHECKPOINT;
+UPDATE pr_tab SET pad = repeat('y', 100) WHERE id % 3 = 0;
+UPDATE pr_tab SET val = -val WHERE id % 7 = 0;
+DELETE FROM pr_tab WHERE id % 11 = 0;
+SELECT count(*) FROM (SELECT FROM pr_tab WHERE id % 13 = 0 FOR UPDATE) s;
+COPY (SELECT g, g, repeat('z', 100) FROM generate_series(20001, 25000) g)
+  TO '$datadir/pr_copy.dat';
+COPY pr_tab FROM '$datadir/pr_copy.dat';
+VACUUM pr_tab;
+CREATE TABLE pr_tmp AS SELECT * FROM pr_tab WHERE id < 1000;
+TRUNCATE pr_tmp;
+DROP TABLE pr_tmp;
+CREATE DATABASE pr_db;
+DROP DATABASE pr_db;
+UPDATE pr_tab SET val = val + 1 WHERE id % 5 = 0;
+));
+
+my $table = $node_master->safe_psql('postgres', $check_table);
+my $index = $node_master->safe_psql('postgres', $check_index);
+
+my $lsn = $node_master->lsn('insert');
+$node_master->wait_for_catchup($node_parallel, 'replay', $lsn);
+$node_master->wait_for_catchup($node_serial,   'replay', $lsn);
+
+check_node($node_parallel, $table, $index, 'standby with redo workers');
+check_node($node_serial, $table, $index, 'standby without redo workers');
+
+# Crash the master in the middle of more changes of the same kinds, and
+# let it replay them with its redo workers.
+$node_master->safe_psql(
+	'postgres', q(
+CHECKPOINT;
+UPDATE pr_tab SET pad = repeat('w', 100) WHERE id % 4 = 0;
+DELETE FROM pr_tab WHERE id % 17 = 0;
+INSERT INTO pr_tab SELECT g, g, repeat('v', 100) FROM generate_series(25001, 30000) g;
+VACUUM pr_tab;
+UPDATE pr_tab SET val = -val WHERE id % 19 = 0;
+));
+$table = $node_master->safe_psql('postgres', $check_table);
+$index = $node_master->safe_psql('postgres', $check_index);
+
+my $log_offset = -s $node_master->logfile;
+$node_master->stop('immediate');
+$node_master->start;
+
+like(
+	log_since($node_master, $log_offset),
+	qr/starting background worker process "redo worker 3"/,
+	'master with recovery_workers = 4 starts redo workers');
+
+check_node($node_master, $table, $index, 'master after crash recovery');
+
+# The standbys replay the same WAL again, streamed from the restarted master
+$lsn = $node_master->lsn('insert');
+$node_master->wait_for_catchup($node_parallel, 'replay', $lsn);
+$node_master->wait_for_catchup($node_serial,   'replay', $lsn);
+
+is($node_parallel->safe_psql('postgres', $check_table),
+	$node_serial->safe_psql('postgres', $check_table),
+	'standbys with and without redo workers match after the crash');
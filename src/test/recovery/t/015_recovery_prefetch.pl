@@ -0,0 +1,130 @@
+# Test prefetching of data blocks during recovery
+#
+# A standby with recovery_prefetch_distance set replays updates of a table
+# much larger than its shared buffers, which must show up as prefetches in
+# pg_stat_recovery_prefetch.  Then it restarts from a restartpoint taken
+# before updates of a table whose drop it had already replayed, so that
+# the prefetcher and replay meet references to a file that no longer
+# exists, until replay gets to the drop again.
+use strict;
+use warnings;
+use PostgresNode;
+use TestLib;
+use Test::More;
+
+my $node_master = get_new_node('master');
+$node_master->init(allows_streaming => 1);
+$node_master->start;
+
+# Prefetching needs posix_fadvise()
+my $ret = $node_master->psql('postgres',
+	"ALTER SYSTEM SET recovery_prefetch_distance = '256kB'");
+$node_master->safe_psql('postgres',
+	'ALTER SYSTEM RESET recovery_prefetch_distance');
+if ($ret != 0)
+{
+	$node_master->stop;
+	plan skip_all => 'recovery prefetching is not supported on this platform';
+}
+else
+{
+	plan tests => 6;
+}
+
+$node_master->safe_psql(
+	'postgres', q(
+CREATE TABLE pf_tab (id int, val int, pad text);
+INSERT INTO pf_tab SELECT g, 0, repeat('x', 100) FROM generate_series(1, 100000) g;
+));
+
+my $backup_name = 'my_backup';
+$node_master->backup($backup_name);
+
+my $node_standby = get_new_node('standby');
+$node_standby->init_from_backup($node_master, $backup_name,
+	has_streaming => 1);
+$node_standby->append_conf(
+	'postgresql.conf', q(
+shared_buffers = 1MB
+recovery_prefetch_distance = 256kB
+));
+$node_standby->start;
+
+my $check_query = 'SELECT count(*), sum(id), sum(val) FROM pf_tab';
+
+# Hold replay back while the WAL is streamed, so that the prefetcher has
+# plenty of WAL to read ahead in once replay resumes.
+$node_standby->safe_psql('postgres', 'SELECT pg_wal_replay_pause()');
+
+# The first update of each page after the checkpoint comes with a full page
+# image, the second one doesn't, and needs the page read back in.
+$node_master->safe_psql(
+	'postgres', q(
+CHECKPOINT;
+UPDATE pf_tab SET val = val + 1 WHERE id % 10 = 0;
+UPDATE pf_tab SET val = val + 2 WHERE id % 10 = 5;
+));
+
+my $lsn = $node_master->lsn('insert');
+$node_standby->poll_query_until('postgres',
+	"SELECT pg_last_wal_receive_lsn() >= '$lsn'::pg_lsn")
+  or die "timed out waiting for the standby to receive WAL";
+$node_standby->safe_psql('postgres', 'SELECT pg_wal_replay_resume()');
+$node_master->wait_for_catchup($node_standby, 'replay', $lsn);
+
+is( $node_standby->safe_psql(
+		'postgres',
+		'SELECT prefetch > 0, skip_fpw > 0 FROM pg_stat_recovery_prefetch'),
+	't|t',
+	'blocks are prefetched, and full page images are not');
+is($node_standby->safe_psql('postgres', $check_query),
+	$node_master->safe_psql('postgres', $check_query),
+	'standby data matches after prefetching');
+
+# A table whose file exists when the standby takes a restartpoint, ...
+# Without full page images, no record after the restartpoint recreates the
+# table's pages.
+$node_master->safe_psql(
+	'postgres', q(
+CREATE TABLE pf_drop (id int, val int);
+INSERT INTO pf_drop SELECT g, 0 FROM generate_series(1, 10000) g;
+ALTER SYSTEM SET full_page_writes = off;
+SELECT pg_reload_conf();
+CHECKPOINT;
+));
+$node_master->wait_for_catchup($node_standby, 'replay',
+	$node_master->lsn('insert'));
+$node_standby->safe_psql('postgres', 'CHECKPOINT');
+
+# ... and is updated and dropped afterwards
+$node_master->safe_psql(
+	'postgres', q(
+UPDATE pf_drop SET val = val + 1;
+UPDATE pf_drop SET val = val + 1;
+DROP TABLE pf_drop;
+UPDATE pf_tab SET val = val + 3 WHERE id % 10 = 0;
+));
+$lsn = $node_master->lsn('insert');
+$node_master->wait_for_catchup($node_standby, 'replay', $lsn);
+
+# Replay from the restartpoint meets the updates after the file is gone
+my $log_offset = -s $node_standby->logfile;
+$node_standby->stop('immediate');
+$node_standby->start;
+$node_master->wait_for_catchup($node_standby, 'replay', $lsn);
+
+unlike(
+	substr(slurp_file($node_standby->logfile), $log_offset),
+	qr/PANIC|invalid pages/,
+	'standby replays references to a missing file');
+is($node_standby->safe_psql('postgres', $check_query),
+	$node_master->safe_psql('postgres', $check_query),
+	'standby data matches after the restart');
+is( $node_standby->safe_psql(
+		'postgres', "SELECT count(*) FROM pg_class WHERE relname = 'pf_drop'"),
+	'0',
+	'dropped table is gone on the standby');
+is( $node_standby->safe_psql(
+		'postgres', 'SELECT skip_new > 0 FROM pg_stat_recovery_prefetch'),
+	't',
+	'blocks of the missing file are not prefetched');
@@ -0,0 +1,94 @@
+# Test WAL insertion with the smallest and the largest number of insertion locks
+#
+# Concurrent clients insert rows and WAL messages of random sizes, so that
+# records of all sizes are reserved and copied in parallel, across WAL page
+# and segment boundaries.  The WAL written must be readable by pg_waldump,
+# replay on a standby with wal_consistency_checking, and survive a crash.
+use strict;
+use warnings;
+use PostgresNode;
+use TestLib;
+use Test::More tests => 20;
+
+# Clients insert rows whose length is that of the message they emit in the
+# same transaction
+my $script = q{
+\set n random(1, 20000)
+BEGIN;
+INSERT INTO wi_tab (client, len) VALUES (:client_id, :n);
+SELECT pg_logical_emit_message(true, 'wi', repeat('x', :n));
+COMMIT;
+};
+
+my $check_query = 'SELECT count(*), count(DISTINCT client), sum(len) FROM wi_tab';
+
+foreach my $nlocks (1, 64)
+{
+	my $node_master = get_new_node("master_$nlocks");
+	$node_master->init(allows_streaming => 1);
+	$node_master->append_conf(
+		'postgresql.conf', qq(
+wal_insert_locks = $nlocks
+wal_consistency_checking = 'heap,btree'
+wal_keep_segments = 64
+max_connections = 20
+));
+	$node_master->start;
+
+	is($node_master->safe_psql('postgres', 'SHOW wal_insert_locks'),
+		$nlocks, "wal_insert_locks = $nlocks: setting is in effect");
+
+	my $backup_name = 'my_backup';
+	$node_master->backup($backup_name);
+	my $node_standby = get_new_node("standby_$nlocks");
+	$node_standby->init_from_backup($node_master, $backup_name,
+		has_streaming => 1);
+	$node_standby->start;
+
+	$node_master->safe_psql('postgres',
+		'CREATE TABLE wi_tab (id bigserial PRIMARY KEY, client int, len int)'
+	);
+	my $start_lsn = $node_master->lsn('insert');
+
+	my $filename = $node_master->basedir . '/wi_insert.sql';
+	append_to_file($filename, $script);
+	$node_master->command_checks_all(
+		[   'pgbench', '--no-vacuum', '--client=8', '--jobs=4',
+			'--transactions=250', '-f', $filename
+		],
+		0,
+		[qr{processed: 2000/2000}],
+		[qr{^$}],
+		"wal_insert_locks = $nlocks: concurrent inserts");
+
+	my $end_lsn = $node_master->lsn('insert');
+	$node_master->safe_psql('postgres', 'SELECT pg_switch_wal()');
+	my $result = $node_master->safe_psql('postgres', $check_query);
+
+	# Every record is intact and in place, and every message is there
+	$node_master->command_like(
+		[   'pg_waldump', '--stats=record',
+			'-p', $node_master->data_dir . '/pg_wal',
+			'-s', $start_lsn, '-e', $end_lsn
+		],
+		qr{LogicalMessage/MESSAGE\s+2000\s},
+		"wal_insert_locks = $nlocks: WAL can be decoded");
+
+	# wal_consistency_checking makes replay fail on any difference
+	$node_master->wait_for_catchup($node_standby, 'replay',
+		$node_master->lsn('insert'));
+	is($node_standby->safe_psql('postgres', $check_query),
+		$result, "wal_insert_locks = $nlocks: standby has the same rows");
+	unlike(
+		slurp_file($node_standby->logfile),
+		qr/inconsistent page|PANIC/,
+		"wal_insert_locks = $nlocks: standby found no inconsistencies");
+
+	$node_master->stop('immediate');
+	$node_master->start;
+	is($node_master->safe_psql('postgres', $check_query),
+		$result, "wal_insert_locks = $nlocks: rows survive a crash");
+
+	$node_standby->stop;
+	$node_master->stop;
+}
@@ -0,0 +1,135 @@
+# Test full-page images compressed with wal_compression = lz4
+#
+# Full-page images of compressible and incompressible pages are written
+# with lz4, then with pglz, and replayed both by a streaming standby and by
+# crash recovery.  With wal_consistency_checking, every heap record carries
+# an image that replay compares with the page it reconstructed.  pg_waldump
+# must decode the images, and tell which method compressed each one.
+use strict;
+use warnings;
+use PostgresNode;
+use TestLib;
+use Test::More tests => 12;
+
+my $node_master = get_new_node('master');
+$node_master->init(allows_streaming => 1);
+$node_master->append_conf(
+	'postgresql.conf', q(
+wal_compression = lz4
+wal_consistency_checking = 'heap'
+wal_keep_segments = 64
+));
+$node_master->start;
+
+is($node_master->safe_psql('postgres', 'SHOW wal_compression'),
+	'lz4', 'wal_compression is lz4');
+
+my $backup_name = 'my_backup';
+$node_master->backup($backup_name);
+my $node_standby = get_new_node('standby');
+$node_standby->init_from_backup($node_master, $backup_name,
+	has_streaming => 1);
+$node_standby->start;
+
+# Rows of repeated text compress well.  Long rows of random hex digits
+# don't, as lz4 finds few repeated sequences in them.
+$node_master->safe_psql(
+	'postgres', q(
+CREATE TABLE wc_text (id int, val text);
+INSERT INTO wc_text SELECT g, repeat('compressible ', 20) FROM generate_series(1, 5000) g;
+CREATE TABLE wc_rand (id int, val text);
+INSERT INTO wc_rand SELECT g,
+  (SELECT string_agg(md5(random()::text || g), '') FROM generate_series(1, 60))
+  FROM generate_series(1, 2000) g;
+));
+
+my $check_query = q(SELECT
+  (SELECT md5(string_agg(id || val, ',' ORDER BY id)) FROM wc_text),
+  (SELECT md5(string_agg(id || val, ',' ORDER BY id)) FROM wc_rand));
+
+# After a checkpoint, the first change of each page comes with its image
+sub write_images
+{
+	my $suffix = shift;
+
+	$node_master->safe_psql(
+		'postgres', qq(
+CHECKPOINT;
+UPDATE wc_text SET val = val || '$suffix' WHERE id % 2 = 0;
+UPDATE wc_rand SET val = md5(val) || substr(val, 33) WHERE id % 2 = 0;
+));
+}
+
+# Returns the output of pg_waldump with block details for a range of WAL
+sub waldump
+{
+	my ($start_lsn, $end_lsn, $name) = @_;
+	my ($stdout, $stderr);
+
+	my $result = IPC::Run::run(
+		[   'pg_waldump', '--bkp-details',
+			'-p', $node_master->data_dir . '/pg_wal',
+			'-s', $start_lsn, '-e', $end_lsn
+		],
+		'>', \$stdout, '2>', \$stderr);
+	ok($result, "$name: pg_waldump decodes the WAL");
+	return $stdout;
+}
+
+my $start_lsn = $node_master->lsn('insert');
+write_images('lz4');
+my $mid_lsn = $node_master->lsn('insert');
+
+$node_master->safe_psql('postgres',
+	"ALTER SYSTEM SET wal_compression = 'pglz'; SELECT pg_reload_conf();");
+$node_master->poll_query_until('postgres',
+	"SELECT setting = 'pglz' FROM pg_settings WHERE name = 'wal_compression'")
+  or die "timed out waiting for wal_compression to change";
+write_images('pglz');
+my $end_lsn = $node_master->lsn('insert');
+$node_master->safe_psql('postgres', 'SELECT pg_switch_wal()');
+
+my $output = waldump($start_lsn, $mid_lsn, 'lz4');
+like($output, qr/compression saved: \d+, method: lz4/,
+	'lz4: images are compressed with lz4');
+unlike($output, qr/method: pglz/, 'lz4: no images are compressed with pglz');
+like($output, qr/\(FPW[^)]*\); hole: offset: \d+, length: \d+\n/,
+	'lz4: incompressible images are stored as they are');
+
+$output = waldump($mid_lsn, $end_lsn, 'pglz');
+like($output, qr/compression saved: \d+, method: pglz/,
+	'pglz: images are compressed with pglz');
+
+my $result = $node_master->safe_psql('postgres', $check_query);
+
+# Replay on the standby, where consistency checking compares every image
+$node_master->wait_for_catchup($node_standby, 'replay',
+	$node_master->lsn('insert'));
+is($node_standby->safe_psql('postgres', $check_query),
+	$result, 'standby has the same data');
+unlike(
+	slurp_file($node_standby->logfile),
+	qr/inconsistent page|invalid compressed image|PANIC/,
+	'standby decompressed every image');
+
+# Crash recovery replays images written with lz4 while the setting is pglz
+$node_master->safe_psql('postgres',
+	"ALTER SYSTEM SET wal_compression = 'lz4'; SELECT pg_reload_conf();");
+$node_master->poll_query_until('postgres',
+	"SELECT setting = 'lz4' FROM pg_settings WHERE name = 'wal_compression'")
+  or die "timed out waiting for wal_compression to change";
+write_images('crash');
+$result = $node_master->safe_psql('postgres', $check_query);
+$node_master->safe_psql('postgres',
+	"ALTER SYSTEM SET wal_compression = 'pglz'");
+
+my $log_offset = -s $node_master->logfile;
+$node_master->stop('immediate');
+$node_master->start;
+
+is($node_master->safe_psql('postgres', $check_query),
+	$result, 'data survives crash recovery');
+unlike(
+	substr(slurp_file($node_master->logfile), $log_offset),
+	qr/inconsistent page|invalid compressed image|PANIC/,
+	'crash recovery decompressed every image');
@@ -0,0 +1,69 @@
+# Test durability of commits with and without WAL flush groups
+#
+# Concurrent clients commit small transactions, with wal_group_flush on and
+# off.  With it on, the group flushes must show up in
+# pg_stat_wal_flush_groups.  Each row records the WAL insert position before
+# it was inserted, and once its commit has been acknowledged the WAL must
+# have been flushed past that position.  The WAL writer is kept mostly idle,
+# so that it's the committing backends that do the flushing.
+use strict;
+use warnings;
+use PostgresNode;
+use TestLib;
+use Test::More tests => 12;
+
+my $script = q{
+INSERT INTO gf_tab (client, lsn) VALUES (:client_id, pg_current_wal_insert_lsn());
+};
+
+# Rows whose WAL has not been flushed
+my $check_query = q(SELECT count(*), count(DISTINCT client),
+  count(*) FILTER (WHERE lsn >= pg_current_wal_flush_lsn())
+  FROM gf_tab);
+
+my $stats_query =
+  'SELECT coalesce(sum(groups), 0) > 0 FROM pg_stat_wal_flush_groups';
+
+foreach my $setting ('on', 'off')
+{
+	# commit_delay only has an effect with fsync on
+	my $node = get_new_node("node_$setting");
+	$node->init;
+	$node->append_conf(
+		'postgresql.conf', qq(
+wal_group_flush = $setting
+fsync = on
+commit_delay = 1000
+commit_siblings = 1
+max_connections = 20
+wal_writer_delay = 10s
+autovacuum = off
+));
+	$node->start;
+
+	is($node->safe_psql('postgres', 'SHOW wal_group_flush'),
+		$setting, "wal_group_flush = $setting: setting is in effect");
+
+	$node->safe_psql('postgres',
+		'CREATE TABLE gf_tab (id bigserial PRIMARY KEY, client int, lsn pg_lsn)');
+
+	my $filename = $node->basedir . '/gf_commit.sql';
+	append_to_file($filename, $script);
+	$node->command_checks_all(
+		[   'pgbench', '--no-vacuum', '--client=16', '--jobs=4',
+			'--transactions=100', '-f', $filename
+		],
+		0,
+		[qr{processed: 1600/1600}],
+		[qr{^$}],
+		"wal_group_flush = $setting: concurrent commits");
+
+	is($node->safe_psql('postgres', $check_query),
+		'1600|16|0', "wal_group_flush = $setting: commits are flushed");
+
+	is($node->safe_psql('postgres', $stats_query),
+		$setting eq 'on' ? 't' : 'f',
+		"wal_group_flush = $setting: flush groups are counted");
+
+	$node->stop;
+}
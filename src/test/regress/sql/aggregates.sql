@@ -907,3 +907,41 @@ EXPLAIN (COSTS OFF) SELECT balk(hundred) FROM tenk1;
 SELECT balk(hundred) FROM tenk1;
 
 ROLLBACK;
+
+-- eager aggregation: partially aggregate one side of a join below the join
+BEGIN;
+
+CREATE TABLE eager_dim (id int, name text);
+CREATE TABLE eager_fact (dim_id int, amount int);
+INSERT INTO eager_dim SELECT g, 'dim' || g FROM generate_series(1, 100) g;
+INSERT INTO eager_fact SELECT g % 10 + 1, g FROM generate_series(1, 10000) g;
+ANALYZE eager_dim;
+ANALYZE eager_fact;
+
+SET LOCAL enable_eager_aggregate = on;
+SET LOCAL enable_nestloop = off;
+SET LOCAL enable_mergejoin = off;
+
+EXPLAIN (COSTS OFF)
+SELECT d.name, sum(f.amount), count(*)
+  FROM eager_fact f JOIN eager_dim d ON f.dim_id = d.id
+  GROUP BY d.name;
+SELECT d.name, sum(f.amount), count(*)
+  FROM eager_fact f JOIN eager_dim d ON f.dim_id = d.id
+  GROUP BY d.name ORDER BY d.name;
+
+-- equal numeric keys that print differently must not be grouped together
+CREATE TABLE eager_num_dim (k numeric, name text);
+CREATE TABLE eager_num_fact (k numeric, amount int);
+INSERT INTO eager_num_dim VALUES (1, 'one');
+INSERT INTO eager_num_fact
+  SELECT CASE WHEN g % 2 = 0 THEN 1.0 ELSE 1.00 END, g
+  FROM generate_series(1, 1000) g;
+ANALYZE eager_num_dim;
+ANALYZE eager_num_fact;
+
+SELECT f.k::text, sum(f.amount), count(*)
+  FROM eager_num_fact f JOIN eager_num_dim d ON f.k = d.k
+  GROUP BY f.k::text ORDER BY 1;
+
+ROLLBACK;
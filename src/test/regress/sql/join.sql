@@ -2423,3 +2423,130 @@ $$);
 rollback to settings;
 
 rollback;
+
+--
+-- nested loop switching to hashing its inner input when the outer input
+-- turns out much bigger than estimated
+--
+begin;
+
+set local enable_hashjoin = off;
+set local enable_mergejoin = off;
+set local enable_material = off;
+set local adaptive_nestloop_threshold = 100;
+
+create function nl_series(n int) returns setof int
+language plpgsql rows 1 as
+$$ begin return query select generate_series(1, n); end $$;
+create temp table nl_inner as select g as a from generate_series(1, 100) g;
+
+explain (analyze, costs off, timing off, summary off)
+select * from nl_series(1000) as s(x) left join nl_inner t on s.x = t.a;
+select count(*), count(t.a), sum(s.x - t.a)
+  from nl_series(1000) as s(x) left join nl_inner t on s.x = t.a;
+
+set local adaptive_nestloop_threshold = 0;
+explain (analyze, costs off, timing off, summary off)
+select * from nl_series(1000) as s(x) left join nl_inner t on s.x = t.a;
+
+rollback;
+
+--
+-- removal of inner self-joins on a unique key, and of joins to a foreign
+-- key's referenced table that contributes nothing else to the query
+--
+begin;
+
+create temp table sj (a int primary key, b int, c int);
+insert into sj values (1, 1, 10), (2, 1, 20), (3, 2, 30);
+create temp table sj_nullable (a int unique, b int);
+insert into sj_nullable values (1, 1), (null, 2), (null, 3);
+
+explain (costs off)
+select t1.* from sj t1 join sj t2 on t1.a = t2.a where t2.b = 1;
+select t1.* from sj t1 join sj t2 on t1.a = t2.a where t2.b = 1;
+
+explain (costs off)
+select * from sj_nullable t1 join sj_nullable t2 on t1.a = t2.a;
+select * from sj_nullable t1 join sj_nullable t2 on t1.a = t2.a;
+
+create temp table fk_parent (id int primary key, v text);
+create temp table fk_child (id int, pid int not null references fk_parent,
+                            pid2 int references fk_parent);
+insert into fk_parent values (1, 'one'), (2, 'two');
+insert into fk_child values (1, 1, 1), (2, 2, null), (3, 1, 2);
+
+explain (costs off)
+select c.* from fk_child c join fk_parent p on c.pid = p.id;
+explain (costs off)
+select c.* from fk_child c join fk_parent p on p.id = c.pid2;
+select c.* from fk_child c join fk_parent p on p.id = c.pid2;
+-- the referenced table is needed when its other columns are used
+select c.id, p.v from fk_child c join fk_parent p on c.pid = p.id
+  order by c.id;
+
+rollback;
+
+--
+-- a cached plan that relies on a foreign key to skip a join must not be
+-- reused while trigger events are pending on the tables, because the
+-- constraint may not hold at that moment
+--
+create temp table fk_parent2 (id int primary key);
+create temp table fk_child2 (id int,
+  pid int not null references fk_parent2 on delete cascade,
+  pid2 int references fk_parent2 deferrable initially deferred);
+insert into fk_parent2 values (1), (2);
+insert into fk_child2 values (1, 1, null), (2, 2, null);
+
+prepare fk_join as
+  select c.id from fk_child2 c join fk_parent2 p on c.pid = p.id order by c.id;
+
+-- does the plan of fk_join scan the referenced table?
+create function fk_join_planned() returns bool language plpgsql as
+$$
+declare
+  ln text;
+begin
+  for ln in execute 'explain (costs off) execute fk_join' loop
+    if ln like '%fk_parent2%' then
+      return true;
+    end if;
+  end loop;
+  return false;
+end;
+$$;
+
+execute fk_join;
+execute fk_join;
+select fk_join_planned();
+
+begin;
+-- the check of the deferred constraint stays pending until commit
+insert into fk_child2 values (3, 2, 2);
+select fk_join_planned();
+execute fk_join;
+execute fk_join;
+commit;
+execute fk_join;
+
+-- a cached plan used while the statement that called it has pending
+-- cascades must not see the rows that are about to be deleted
+create function fk_join_count() returns bigint language plpgsql as
+$$
+declare
+  n bigint;
+begin
+  select count(*) into n from fk_child2 c join fk_parent2 p on c.pid = p.id;
+  return n;
+end;
+$$;
+
+select fk_join_count();
+delete from fk_parent2 where id = 1 returning fk_join_count();
+select id, pid from fk_child2 order by id;
+
+deallocate fk_join;
+drop function fk_join_planned();
+drop function fk_join_count();
+drop table fk_child2, fk_parent2;
@@ -29,3 +29,13 @@ SELECT num_nulls(VARIADIC '{}'::int[]);
 -- should fail, one or more arguments is required
 SELECT num_nonnulls();
 SELECT num_nulls();
+
+--
+-- pg_calibrate_costs()
+--
+SELECT tablespace, parameter, usecs IS NULL OR usecs >= 0 AS ok
+  FROM pg_calibrate_costs('tenk1', 10);
+
+-- should fail
+SELECT * FROM pg_calibrate_costs('tenk1_unique1', 10);
+SELECT * FROM pg_calibrate_costs('tenk1', 0);
@@ -0,0 +1,47 @@
+--
+-- PARTITION_AGGREGATE
+-- Test partition-wise aggregation on partitioned tables
+--
+
+-- Enable partition-wise aggregation, which by default is disabled.
+SET enable_partition_wise_agg TO true;
+
+CREATE TABLE pagg_tab (a int, b int) PARTITION BY RANGE(a);
+CREATE TABLE pagg_tab_p1 PARTITION OF pagg_tab FOR VALUES FROM (0) TO (300);
+CREATE TABLE pagg_tab_p2 PARTITION OF pagg_tab FOR VALUES FROM (300) TO (600);
+CREATE TABLE pagg_tab_p3 PARTITION OF pagg_tab FOR VALUES FROM (600) TO (900);
+INSERT INTO pagg_tab SELECT i % 900, i % 7 FROM generate_series(0, 2699) i;
+ANALYZE pagg_tab;
+
+-- When GROUP BY includes the partition key, each partition is aggregated
+-- completely.  With little work_mem, the hash table for a single partition
+-- fits while the one for the whole table wouldn't.
+SET work_mem = '64kB';
+EXPLAIN (COSTS OFF)
+SELECT a, sum(b), count(*) FROM pagg_tab GROUP BY a ORDER BY 1;
+SELECT count(*), sum(s), sum(n) FROM (SELECT a, sum(b) s, count(*) n FROM pagg_tab GROUP BY a) ss;
+SELECT a, sum(b), count(*) FROM pagg_tab GROUP BY a HAVING sum(b) > 12 ORDER BY 1 LIMIT 5;
+RESET work_mem;
+
+-- Otherwise, each partition is aggregated partially, and the aggregation is
+-- finalized above the Append
+SELECT b, sum(a), count(*) FROM pagg_tab GROUP BY b ORDER BY 1;
+SELECT b, count(*) FROM pagg_tab GROUP BY b HAVING sum(a) > 173500 ORDER BY 1;
+SELECT count(*), sum(a), sum(b) FROM pagg_tab;
+
+-- Aggregation over a partition-wise join, with different partition bounds
+SET enable_partition_wise_join TO true;
+CREATE TABLE pagg_tab2 (x int, y int) PARTITION BY RANGE(x);
+CREATE TABLE pagg_tab2_p1 PARTITION OF pagg_tab2 FOR VALUES FROM (0) TO (300);
+CREATE TABLE pagg_tab2_p2 PARTITION OF pagg_tab2 FOR VALUES FROM (300) TO (600);
+CREATE TABLE pagg_tab2_p3 PARTITION OF pagg_tab2 FOR VALUES FROM (600) TO (900);
+CREATE TABLE pagg_tab2_p4 PARTITION OF pagg_tab2 FOR VALUES FROM (900) TO (1000);
+INSERT INTO pagg_tab2 SELECT i, i % 5 FROM generate_series(0, 999) i;
+ANALYZE pagg_tab2;
+
+SELECT count(*), sum(n), sum(s) FROM (SELECT t1.a, count(*) n, sum(t2.y) s FROM pagg_tab t1 JOIN pagg_tab2 t2 ON t1.a = t2.x GROUP BY t1.a) ss;
+SELECT t2.y, count(*) FROM pagg_tab t1 JOIN pagg_tab2 t2 ON t1.a = t2.x GROUP BY t2.y ORDER BY 1;
+RESET enable_partition_wise_join;
+
+DROP TABLE pagg_tab;
+DROP TABLE pagg_tab2;
@@ -319,6 +319,31 @@ SELECT * FROM prt1_l t1 LEFT JOIN LATERAL
 EXPLAIN (COSTS OFF)
 SELECT t1.a, t1.c, t2.b, t2.c FROM (SELECT * FROM prt1_l WHERE a = 1 AND a = 2) t1 RIGHT JOIN prt2_l t2 ON t1.a = t2.b AND t1.b = t2.a AND t1.c = t2.c;
 
+--
+-- partition-wise join between tables with different partition bounds
+--
+CREATE TABLE prt2_ad (a int, b int, c varchar) PARTITION BY RANGE(b);
+CREATE TABLE prt2_ad_p1 PARTITION OF prt2_ad FOR VALUES FROM (0) TO (250);
+CREATE TABLE prt2_ad_p2 PARTITION OF prt2_ad FOR VALUES FROM (250) TO (500);
+CREATE TABLE prt2_ad_p3 PARTITION OF prt2_ad FOR VALUES FROM (500) TO (600);
+CREATE TABLE prt2_ad_p4 PARTITION OF prt2_ad FOR VALUES FROM (600) TO (700);
+INSERT INTO prt2_ad SELECT i % 25, i, to_char(i, 'FM0000') FROM generate_series(0, 699) i WHERE i % 3 = 0;
+ANALYZE prt2_ad;
+
+-- inner join: the partition of prt2_ad without a counterpart is left out
+EXPLAIN (COSTS OFF)
+SELECT t1.a, t1.c, t2.b, t2.c FROM prt1 t1, prt2_ad t2 WHERE t1.a = t2.b AND t1.b = 0 ORDER BY t1.a, t2.b;
+SELECT t1.a, t1.c, t2.b, t2.c FROM prt1 t1, prt2_ad t2 WHERE t1.a = t2.b AND t1.b = 0 ORDER BY t1.a, t2.b;
+
+-- left join: every partition of the outer side has a counterpart
+EXPLAIN (COSTS OFF)
+SELECT t1, t2 FROM prt1 t1 LEFT JOIN prt2_ad t2 ON t1.a = t2.b WHERE t1.b = 0 ORDER BY t1.a, t2.b;
+SELECT t1, t2 FROM prt1 t1 LEFT JOIN prt2_ad t2 ON t1.a = t2.b WHERE t1.b = 0 ORDER BY t1.a, t2.b;
+
+-- full join: not possible, since a partition of prt2_ad has no counterpart
+EXPLAIN (COSTS OFF)
+SELECT t1.a, t2.b FROM prt1 t1 FULL JOIN prt2_ad t2 ON t1.a = t2.b;
+
 --
 -- negative testcases
 --
@@ -177,3 +177,30 @@ drop table list_part_1;
 execute pstmt_def_insert(1);
 drop table list_parted, list_part_null;
 deallocate pstmt_def_insert;
+
+-- Check that parameter values of very different selectivity get their own
+-- generic plans
+create table pcskew (a int, b text);
+insert into pcskew select 1, 'x' from generate_series(1, 9000);
+insert into pcskew select i, 'x' from generate_series(2, 1001) i;
+create index pcskew_a_idx on pcskew (a);
+analyze pcskew;
+prepare pcskew_q(int) as select count(b) from pcskew where a = $1;
+-- the first five executions in each selectivity range get custom plans
+execute pcskew_q(1);
+execute pcskew_q(1);
+execute pcskew_q(1);
+execute pcskew_q(1);
+execute pcskew_q(1);
+explain (costs off) execute pcskew_q(1);
+execute pcskew_q(2);
+execute pcskew_q(3);
+execute pcskew_q(4);
+execute pcskew_q(5);
+execute pcskew_q(6);
+explain (costs off) execute pcskew_q(7);
+-- both generic plans are kept
+explain (costs off) execute pcskew_q(1);
+explain (costs off) execute pcskew_q(8);
+deallocate pcskew_q;
+drop table pcskew;
@@ -282,3 +282,151 @@ EXPLAIN (COSTS OFF)
  SELECT * FROM functional_dependencies WHERE a = 1 AND b = '1' AND c = 1;
 
 RESET random_page_cost;
+
+-- check the number of estimated/actual rows in the top node
+create function check_estimated_rows(text) returns table (estimated int, actual int)
+language plpgsql as
+$$
+declare
+    ln text;
+    tmp text[];
+    first_row bool := true;
+begin
+    for ln in
+        execute format('explain analyze %s', $1)
+    loop
+        if first_row then
+            first_row := false;
+            tmp := regexp_match(ln, 'rows=(\d*) .* rows=(\d*)');
+            return query select tmp[1]::int, tmp[2]::int;
+        end if;
+    end loop;
+end;
+$$;
+
+-- MCV lists
+CREATE TABLE mcv_lists (
+    filler1 TEXT,
+    a INT,
+    b TEXT,
+    filler2 NUMERIC,
+    c INT
+);
+
+-- 100 distinct combinations, all of them in the MCV list
+INSERT INTO mcv_lists (a, b, c, filler1)
+     SELECT mod(i,100), mod(i,100), mod(i,100), i FROM generate_series(1,5000) s(i);
+
+ANALYZE mcv_lists;
+
+SELECT * FROM check_estimated_rows('SELECT * FROM mcv_lists WHERE a = 1 AND b = ''1''');
+
+SELECT * FROM check_estimated_rows('SELECT * FROM mcv_lists WHERE a = 1 AND b = ''1'' AND c = 1');
+
+-- create statistics
+CREATE STATISTICS mcv_lists_stats (mcv) ON a, b, c FROM mcv_lists;
+
+ANALYZE mcv_lists;
+
+SELECT * FROM check_estimated_rows('SELECT * FROM mcv_lists WHERE a = 1 AND b = ''1''');
+
+SELECT * FROM check_estimated_rows('SELECT * FROM mcv_lists WHERE a = 1 AND b = ''1'' AND c = 1');
+
+SELECT * FROM check_estimated_rows('SELECT * FROM mcv_lists WHERE a < 5 AND c < 5');
+
+-- check the MCV list contents
+SELECT count(*), round(sum(m.frequency)::numeric, 2) AS frequency,
+       round(sum(m.base_frequency)::numeric, 4) AS base_frequency
+  FROM pg_statistic_ext s, pg_mcv_list_items(s.stxmcv) m
+ WHERE s.stxname = 'mcv_lists_stats';
+
+SELECT m.values, m.nulls, m.frequency
+  FROM pg_statistic_ext s, pg_mcv_list_items(s.stxmcv) m
+ WHERE s.stxname = 'mcv_lists_stats' AND m.values = '{1,1,1}';
+
+-- check change of column type resets the MCV statistics
+ALTER TABLE mcv_lists ALTER COLUMN c TYPE numeric;
+
+SELECT stxmcv IS NULL AS mcv_reset
+  FROM pg_statistic_ext WHERE stxname = 'mcv_lists_stats';
+
+ANALYZE mcv_lists;
+
+SELECT * FROM check_estimated_rows('SELECT * FROM mcv_lists WHERE a = 1 AND b = ''1'' AND c = 1');
+
+-- 100 distinct combinations with NULL values, all in the MCV list
+TRUNCATE mcv_lists;
+
+INSERT INTO mcv_lists (a, b, c, filler1)
+     SELECT
+         (CASE WHEN mod(i,100) = 1 THEN NULL ELSE mod(i,100) END),
+         (CASE WHEN mod(i,100) = 1 THEN NULL ELSE mod(i,100) END),
+         (CASE WHEN mod(i,100) = 1 THEN NULL ELSE mod(i,100) END),
+         i
+     FROM generate_series(1,5000) s(i);
+
+ANALYZE mcv_lists;
+
+SELECT * FROM check_estimated_rows('SELECT * FROM mcv_lists WHERE a IS NULL AND b IS NULL');
+
+SELECT * FROM check_estimated_rows('SELECT * FROM mcv_lists WHERE a IS NULL AND b IS NULL AND c IS NULL');
+
+DROP TABLE mcv_lists;
+
+-- histograms
+CREATE TABLE histograms (
+    filler1 TEXT,
+    a INT,
+    b INT
+);
+
+-- perfectly correlated columns, 100 values with 50 rows each
+INSERT INTO histograms (a, b, filler1)
+     SELECT i/50, i/50, i FROM generate_series(0,4999) s(i);
+
+ANALYZE histograms;
+
+SELECT * FROM check_estimated_rows('SELECT * FROM histograms WHERE a = 1 AND b = 1');
+
+-- create statistics
+CREATE STATISTICS histograms_stats (histogram) ON a, b FROM histograms;
+
+ANALYZE histograms;
+
+SELECT stxkind, stxhistogram IS NOT NULL AS histogram_built
+  FROM pg_statistic_ext WHERE stxname = 'histograms_stats';
+
+SELECT * FROM check_estimated_rows('SELECT * FROM histograms WHERE a = 1 AND b = 1');
+
+SELECT * FROM check_estimated_rows('SELECT * FROM histograms WHERE a = 1 AND b = 2');
+
+SELECT * FROM check_estimated_rows('SELECT * FROM histograms WHERE a < 10 AND b < 10');
+
+SELECT * FROM check_estimated_rows('SELECT * FROM histograms WHERE a IS NULL AND b IS NULL');
+
+-- one very common combination (in the MCV list), the rest in the histogram
+TRUNCATE histograms;
+
+INSERT INTO histograms (a, b, filler1)
+     SELECT (CASE WHEN i < 5000 THEN 0 ELSE i END),
+            (CASE WHEN i < 5000 THEN 0 ELSE i END),
+            i
+     FROM generate_series(0,9999) s(i);
+
+DROP STATISTICS histograms_stats;
+
+CREATE STATISTICS histograms_stats (mcv, histogram) ON a, b FROM histograms;
+
+SELECT pg_get_statisticsobjdef(oid) FROM pg_statistic_ext WHERE stxname = 'histograms_stats';
+
+ANALYZE histograms;
+
+SELECT stxkind, stxmcv IS NOT NULL AS mcv_built,
+       stxhistogram IS NOT NULL AS histogram_built
+  FROM pg_statistic_ext WHERE stxname = 'histograms_stats';
+
+SELECT * FROM check_estimated_rows('SELECT * FROM histograms WHERE a = 0 AND b = 0');
+
+SELECT * FROM check_estimated_rows('SELECT * FROM histograms WHERE a >= 5000 AND b >= 5000');
+
+DROP TABLE histograms;
@@ -92,3 +92,54 @@ ANALYZE vactst (i), vacparted (does_not_exist);
 DROP TABLE vaccluster;
 DROP TABLE vactst;
 DROP TABLE vacparted;
+
+-- statistics of a partitioned table merged from those of its partitions
+CREATE TABLE vacmerge (a int, b int, c text) PARTITION BY RANGE (a);
+CREATE TABLE vacmerge1 PARTITION OF vacmerge FOR VALUES FROM (0) TO (1000);
+CREATE TABLE vacmerge2 PARTITION OF vacmerge FOR VALUES FROM (1000) TO (2000);
+CREATE TABLE vacmerge3 PARTITION OF vacmerge FOR VALUES FROM (2000) TO (3000);
+INSERT INTO vacmerge
+  SELECT g, g % 10, CASE WHEN g % 4 = 0 THEN NULL ELSE 'x' END
+  FROM generate_series(0, 1999) g;
+ANALYZE vacmerge1, vacmerge2;
+SET analyze_merge_partition_stats = on;
+ANALYZE VERBOSE vacmerge;
+SELECT attname, null_frac, round(n_distinct::numeric, 1) AS n_distinct,
+       most_common_vals,
+       (histogram_bounds::text::int[])[1] AS hist_min,
+       (histogram_bounds::text::int[])[101] AS hist_max,
+       array_length(histogram_bounds::text::int[], 1) AS hist_len
+  FROM pg_stats WHERE tablename = 'vacmerge' AND inherited ORDER BY attname;
+-- a partition that was not analyzed yet forces sampling
+INSERT INTO vacmerge SELECT g, 42, 'y' FROM generate_series(2000, 2999) g;
+ANALYZE vacmerge;
+SELECT attname, n_distinct FROM pg_stats
+  WHERE tablename = 'vacmerge' AND inherited AND attname = 'b';
+ANALYZE vacmerge3;
+ANALYZE vacmerge;
+SELECT attname, n_distinct, most_common_vals FROM pg_stats
+  WHERE tablename = 'vacmerge' AND inherited AND attname IN ('b', 'c')
+  ORDER BY attname;
+RESET analyze_merge_partition_stats;
+DROP TABLE vacmerge;
+
+-- distinct values counted by scans of the whole table
+CREATE TABLE vacsketch (b int, c int);
+ALTER TABLE vacsketch ALTER b SET STATISTICS 1, ALTER c SET STATISTICS 1;
+INSERT INTO vacsketch
+  SELECT CASE WHEN g <= 2000 THEN 0 ELSE g END,
+         CASE WHEN g <= 2000 THEN 0 ELSE g END
+  FROM generate_series(1, 3000) g;
+ANALYZE vacsketch;
+SELECT attname, n_distinct > 0 AS sampled FROM pg_stats
+  WHERE tablename = 'vacsketch' ORDER BY attname;
+CREATE INDEX ON vacsketch (b);
+SELECT attname, n_distinct BETWEEN -0.37 AND -0.30 AS counted FROM pg_stats
+  WHERE tablename = 'vacsketch' ORDER BY attname;
+ANALYZE vacsketch;
+SELECT attname, n_distinct BETWEEN -0.37 AND -0.30 AS counted FROM pg_stats
+  WHERE tablename = 'vacsketch' ORDER BY attname;
+VACUUM FULL vacsketch;
+SELECT attname, n_distinct BETWEEN -0.37 AND -0.30 AS counted FROM pg_stats
+  WHERE tablename = 'vacsketch' ORDER BY attname;
+DROP TABLE vacsketch;